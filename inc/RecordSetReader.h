@@ -0,0 +1,215 @@
+#pragma once
+
+#define RECORDSET_MAX_FIELDS	64					//单个记录集支持的最大字段数
+#define RECORDSET_MAX_REPLY_LEN	(64*1024*1024)		//返回报文长度上限，消息头中超过此值的长度视为损坏
+
+// CRecordSetReader
+// NET_MESSAGE_RETRECORDOFTB返回报文的只读游标，直接在接收缓冲区上按字段读取，不复制整条记录。
+// 报文结构：NetMessageHead + WORD字段数 + MessageRetRecordHead[字段数] + DWORD记录长度 + DWORD记录数 + 记录
+// Attach时按调用者给出的缓冲区字节数校验全部结构，并一次算好各字段偏移，
+// 之后每个字段的读取都只是按偏移取值，不会越过缓冲区。
+// TSSampleDataSvr和TSAlarmServer_WD共用本文件。
+//
+// 用法：
+//	CRecordSetReader rs;
+//	if (!rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), 2)) {...}
+//	while (rs.NextRecord())
+//	{
+//		int DevId = rs.GetInt(0);
+//		rs.GetString(1, szName, 65);
+//	}
+
+class CRecordSetReader
+{
+public:
+	CRecordSetReader()
+	{
+		Detach();
+	}
+
+	//GetMessage_RecordOfSql等管道接口只返回缓冲区，不返回字节数；
+	//这类缓冲区按消息头Length分配，长度取消息头加Length，Length超过上限时返回0，Attach随之失败
+	static DWORD GetReplyLen(const BYTE *pRead)
+	{
+		if (pRead == NULL)
+		{
+			return 0;
+		}
+		DWORD dwLength = (DWORD)((const NetMessageHead*)pRead)->Length;
+		if (dwLength > RECORDSET_MAX_REPLY_LEN)
+		{
+			return 0;
+		}
+		return (DWORD)sizeof(NetMessageHead) + dwLength;
+	}
+
+	//绑定返回报文，dwReadLen为pRead中实际可读的字节数，nFieldNum为期望的字段数；
+	//报文类型、字段数不符或任何结构超出dwReadLen时返回FALSE
+	BOOL Attach(const BYTE *pRead, DWORD dwReadLen, int nFieldNum)
+	{
+		Detach();
+		if (pRead == NULL || nFieldNum <= 0 || nFieldNum > RECORDSET_MAX_FIELDS || dwReadLen < sizeof(NetMessageHead))
+		{
+			return FALSE;
+		}
+		const NetMessageHead *pNetMessageHead = (const NetMessageHead*)pRead;
+		if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB || pNetMessageHead->Length < 1)
+		{
+			return FALSE;
+		}
+		const BYTE *pEnd = pRead + dwReadLen;
+		const BYTE *pByte = pRead + sizeof(NetMessageHead);
+		if (pByte + sizeof(WORD) > pEnd || (int)*((const WORD*)pByte) != nFieldNum)
+		{
+			return FALSE;
+		}
+		pByte += sizeof(WORD);
+		const MessageRetRecordHead *pHead = (const MessageRetRecordHead*)pByte;
+		if ((size_t)(pEnd - pByte) < sizeof(MessageRetRecordHead)*nFieldNum + sizeof(DWORD)*2)
+		{
+			return FALSE;
+		}
+		pByte += sizeof(MessageRetRecordHead)*nFieldNum;
+		DWORD dwRecordLen = *((const DWORD*)pByte);
+		pByte += sizeof(DWORD);
+		DWORD dwRecordNum = *((const DWORD*)pByte);
+		pByte += sizeof(DWORD);
+		if (dwRecordLen < 1)
+		{
+			return FALSE;
+		}
+
+		ULONGLONG nOffset = 0;
+		for (int i=0; i<nFieldNum; i++)
+		{
+			m_nFieldOffset[i] = (DWORD)nOffset;
+			m_nFieldLen[i] = (pHead+i)->DataLen;
+			nOffset += m_nFieldLen[i];
+		}
+		//各字段长度之和不能超过记录长度，全部记录不能超出报文
+		if (nOffset > dwRecordLen || (ULONGLONG)dwRecordLen*dwRecordNum > (ULONGLONG)(pEnd - pByte))
+		{
+			return FALSE;
+		}
+		m_pRecords = pByte;
+		m_nFieldNum = nFieldNum;
+		m_nRecordLen = dwRecordLen;
+		m_nRecordNum = dwRecordNum;
+		return TRUE;
+	}
+
+	void Detach()
+	{
+		m_pRecords = NULL;
+		m_pCurRecord = NULL;
+		m_nFieldNum = 0;
+		m_nRecordLen = 0;
+		m_nRecordNum = 0;
+		m_nCurIndex = -1;
+	}
+
+	int GetFieldNum() const { return m_nFieldNum; }
+	int GetRecordNum() const { return (int)m_nRecordNum; }
+
+	//移到下一条记录，第一次调用移到第一条；没有更多记录时返回FALSE
+	BOOL NextRecord()
+	{
+		if (m_pRecords == NULL || m_nCurIndex + 1 >= (int)m_nRecordNum)
+		{
+			return FALSE;
+		}
+		m_nCurIndex++;
+		m_pCurRecord = m_pRecords + (size_t)m_nRecordLen*m_nCurIndex;
+		return TRUE;
+	}
+
+	//字段原始数据，nLen返回字节数
+	const BYTE *GetField(int nField, int &nLen) const
+	{
+		if (m_pCurRecord == NULL || nField < 0 || nField >= m_nFieldNum)
+		{
+			nLen = 0;
+			return NULL;
+		}
+		nLen = (int)m_nFieldLen[nField];
+		return m_pCurRecord + m_nFieldOffset[nField];
+	}
+
+	//按定长类型取值：拷贝min(字段长度,sizeof(T))个字节到清零的Value中，适用于整型、浮点、TIMESTAMP_STRUCT等
+	template<class T>
+	void GetValue(int nField, T &Value) const
+	{
+		memset(&Value, 0, sizeof(T));
+		int nLen = 0;
+		const BYTE *pField = GetField(nField, nLen);
+		if (pField != NULL && nLen > 0)
+		{
+			memcpy(&Value, pField, nLen < (int)sizeof(T) ? nLen : sizeof(T));
+		}
+	}
+
+	int GetInt(int nField) const
+	{
+		DWORD dwValue = 0;
+		GetValue(nField, dwValue);
+		return (int)dwValue;
+	}
+
+	float GetFloat(int nField) const
+	{
+		float fValue = 0;
+		GetValue(nField, fValue);
+		return fValue;
+	}
+
+	//字符串字段拷贝到pDst，最多nDstLen-1个字符，保证以0结尾
+	void GetString(int nField, TCHAR *pDst, int nDstLen) const
+	{
+		if (pDst == NULL || nDstLen <= 0)
+		{
+			return;
+		}
+		int nLen = 0;
+		const BYTE *pField = GetField(nField, nLen);
+		int nChars = nLen / (int)sizeof(TCHAR);
+		if (nChars > nDstLen - 1)
+		{
+			nChars = nDstLen - 1;
+		}
+		if (pField != NULL && nChars > 0)
+		{
+			memcpy(pDst, pField, nChars*sizeof(TCHAR));
+		}
+		else
+		{
+			nChars = 0;
+		}
+		pDst[nChars] = 0;
+		//字段内容以0结尾时后面的字节不计入
+		pDst[_tcsnlen(pDst, nChars)] = 0;
+	}
+
+	void GetString(int nField, CString &strValue) const
+	{
+		int nLen = 0;
+		const BYTE *pField = GetField(nField, nLen);
+		int nChars = nLen / (int)sizeof(TCHAR);
+		if (pField == NULL || nChars <= 0)
+		{
+			strValue.Empty();
+			return;
+		}
+		const TCHAR *pStr = (const TCHAR*)pField;
+		strValue.SetString(pStr, (int)_tcsnlen(pStr, nChars));
+	}
+
+private:
+	const BYTE *m_pRecords;
+	const BYTE *m_pCurRecord;
+	int m_nFieldNum;
+	DWORD m_nRecordLen;
+	DWORD m_nRecordNum;
+	int m_nCurIndex;
+	DWORD m_nFieldOffset[RECORDSET_MAX_FIELDS];
+	DWORD m_nFieldLen[RECORDSET_MAX_FIELDS];
+};
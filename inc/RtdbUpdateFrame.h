@@ -0,0 +1,241 @@
+#pragma once
+
+#define RTDB_FRAME_MAXRECORDS	64		//默认每帧最多记录数
+
+// CRtdbUpdateFrame
+// NET_MESSAGE_UPDATARECORD更新报文的复用缓冲区，同一张表的多个点更新打包在一帧中发送。
+// 报文结构：NetMessageHead + UpdataRecordStruct(表号、ColFlag、更新类型、单条记录长度) + 记录1..记录n
+// RecordLen为单条记录长度，记录条数由实时库按(Length-sizeof(UpdataRecordStruct)+1)/RecordLen得出。
+// Init时按最大记录数一次分配缓冲区并填好消息头和ColFlag，之后每个点只需在记录区末尾按字段顺序写入，
+// 帧满或写完后整帧发送，不再为每个点分配缓冲区、等待一次应答。
+//
+// 用法：
+//	CRtdbUpdateFrame frame;
+//	int nCols[] = {7,9};
+//	if (!frame.Init(TABLE_NO_DI, sizeof(YxConfigDef), nCols, 2, 64)) {...}
+//	for (...)
+//	{
+//		frame.PutYx(iYxConfig);
+//		if (frame.IsFull()) window.Submit(frame);
+//	}
+//	window.Submit(frame);
+
+class CRtdbUpdateFrame
+{
+public:
+	CRtdbUpdateFrame()
+	{
+		m_pBuf = NULL;
+		m_dwBufLen = 0;
+		m_pRecords = NULL;
+		m_pRecord = NULL;
+		m_nRecordLen = 0;
+		m_nMaxRecords = 0;
+		m_nCount = 0;
+		m_nOffset = 0;
+	}
+
+	~CRtdbUpdateFrame()
+	{
+		if (m_pBuf != NULL)
+		{
+			delete[] m_pBuf;
+			m_pBuf = NULL;
+		}
+	}
+
+	//分配缓冲区并填好报文头，pCols为需要更新的列号，nRecordLen为单条记录长度，nMaxRecords为每帧最多记录数
+	BOOL Init(int nTableNo, int nRecordLen, const int *pCols, int nColNum, int nMaxRecords = RTDB_FRAME_MAXRECORDS)
+	{
+		if (m_pBuf != NULL)
+		{
+			delete[] m_pBuf;
+			m_pBuf = NULL;
+		}
+		m_nCount = 0;
+		m_nOffset = 0;
+		if (nRecordLen <= 0 || nMaxRecords <= 0)
+		{
+			return FALSE;
+		}
+		m_nRecordLen = nRecordLen;
+		m_nMaxRecords = nMaxRecords;
+		m_dwBufLen = (DWORD)nRecordLen*nMaxRecords + sizeof(UpdataRecordStruct) + sizeof(NetMessageHead);
+		m_pBuf = new BYTE[m_dwBufLen];
+		if (m_pBuf == NULL)
+		{
+			return FALSE;
+		}
+		memset(m_pBuf,0,m_dwBufLen);
+		NetMessageHead* pMessageHead = (NetMessageHead*)m_pBuf;
+		pMessageHead->MessageType = NET_MESSAGE_UPDATARECORD;
+		UpdataRecordStruct* pUpdataStruct = (UpdataRecordStruct*)&m_pBuf[sizeof(NetMessageHead)];
+		pUpdataStruct->TableNo = nTableNo;
+		memset(&(pUpdataStruct->ColFlag[0]),0,256);
+		//只置需要更新的列，防止把表中其他字段更新为空值
+		for (int i=0; i<nColNum; i++)
+		{
+			if (pCols[i] >= 0 && pCols[i] < 256)
+			{
+				pUpdataStruct->ColFlag[pCols[i]] = 1;
+			}
+		}
+		pUpdataStruct->UpdataType = UPDATARECORD_TYPE_UPDATA;
+		pUpdataStruct->RecordLen = nRecordLen;
+		m_pRecords = (BYTE*)&pUpdataStruct->RecordData;
+		m_pRecord = m_pRecords;
+		return TRUE;
+	}
+
+	int GetCount() const
+	{
+		return m_nCount;
+	}
+
+	BOOL IsFull() const
+	{
+		return m_nCount >= m_nMaxRecords;
+	}
+
+	//清空已写入的记录，报文头和ColFlag保留
+	void Reset()
+	{
+		m_nCount = 0;
+		m_nOffset = 0;
+		m_pRecord = m_pRecords;
+	}
+
+	//在记录区末尾开始一条新记录并清零，帧已满时返回FALSE
+	BOOL BeginRecord()
+	{
+		if (m_pBuf == NULL || m_nCount >= m_nMaxRecords)
+		{
+			return FALSE;
+		}
+		m_pRecord = m_pRecords + (DWORD)m_nCount*m_nRecordLen;
+		memset(m_pRecord,0,m_nRecordLen);
+		m_nOffset = 0;
+		m_nCount++;
+		return TRUE;
+	}
+
+	//按字段顺序写入当前记录，超出记录长度的部分丢弃
+	void PutBytes(const void *pSrc, int nLen)
+	{
+		if (m_nOffset + nLen > m_nRecordLen)
+		{
+			nLen = m_nRecordLen - m_nOffset;
+		}
+		if (nLen > 0)
+		{
+			memcpy(m_pRecord + m_nOffset, pSrc, nLen);
+			m_nOffset += nLen;
+		}
+	}
+
+	template <class T>
+	void Put(const T &Value)
+	{
+		PutBytes(&Value, sizeof(T));
+	}
+
+	//遥信记录，字段顺序与TB_DI一致；帧已满时返回FALSE，记录未写入
+	BOOL PutYx(const YxConfigDef &iYxConfig)
+	{
+		if (!BeginRecord())
+		{
+			return FALSE;
+		}
+		Put(iYxConfig.nYxIndex);
+		Put(iYxConfig.nProjectNo);
+		Put(iYxConfig.nStationNo);
+		Put(iYxConfig.nDeviceNo);
+		Put(iYxConfig.nYxNum);
+		Put(iYxConfig.cYxName);
+		Put(iYxConfig.cDescription);
+		Put(iYxConfig.bYxRaw);
+		Put(iYxConfig.bYxType);
+		Put(iYxConfig.bYxValue);
+		Put(iYxConfig.bIdentifier);
+		Put(iYxConfig.nCountExchange);
+		Put(iYxConfig.nCountTrip);
+		Put(iYxConfig.nAlarmType);
+		Put(iYxConfig.nAlarmLevel);
+		Put(iYxConfig.nYxProp);
+		return TRUE;
+	}
+
+	//遥脉记录，字段顺序与TB_PULSE一致；帧已满时返回FALSE，记录未写入
+	BOOL PutYm(const YmConfigDef &iYmDef)
+	{
+		if (!BeginRecord())
+		{
+			return FALSE;
+		}
+		Put(iYmDef.nYmIndex);
+		Put(iYmDef.nProjectNo);
+		Put(iYmDef.nStationNo);
+		Put(iYmDef.nDeviceNo);
+		Put(iYmDef.nYmNum);
+		Put(iYmDef.cYmName);
+		Put(iYmDef.cDescription);
+		Put(iYmDef.nYmRaw);
+		Put(iYmDef.dYmQuotiety);
+		Put(iYmDef.dYmValue);
+		Put(iYmDef.bIdentifier);
+		return TRUE;
+	}
+
+	//按当前记录数填好报文长度，返回整帧，dwLen为发送字节数；没有记录时返回NULL
+	const BYTE* GetFrame(DWORD &dwLen)
+	{
+		dwLen = 0;
+		if (m_pBuf == NULL || m_nCount == 0)
+		{
+			return NULL;
+		}
+		NetMessageHead* pMessageHead = (NetMessageHead*)m_pBuf;
+		pMessageHead->Length = (DWORD)m_nCount*m_nRecordLen + sizeof(UpdataRecordStruct) - 1;
+		dwLen = sizeof(NetMessageHead) + pMessageHead->Length;
+		return m_pBuf;
+	}
+
+	//发送一帧并校验应答，返回实时库是否确认成功
+	static BOOL SendFrame(HANDLE hPipe, const BYTE *pFrame, DWORD dwLen)
+	{
+		if (hPipe == NULL || pFrame == NULL)
+		{
+			return FALSE;
+		}
+		BYTE* pRead = (BYTE*)GetNetMessage(hPipe, (BYTE*)pFrame, dwLen);
+		if (pRead == NULL)
+		{
+			return FALSE;
+		}
+		BOOL bOk = IsAckOk(pRead);
+		delete[] pRead;
+		return bOk;
+	}
+
+	//实时库的应答报文是否为确认成功：只有NET_MESSAGE_ACK且应答为NET_MESSAGE_ACK_OK才算，其他报文一律算失败
+	static BOOL IsAckOk(const BYTE *pRead)
+	{
+		if (pRead == NULL)
+		{
+			return FALSE;
+		}
+		const NetMessageHead* pMessageHead = (const NetMessageHead*)pRead;
+		const MessageAck* pAck = (const MessageAck*)&pRead[sizeof(NetMessageHead)];
+		return pMessageHead->MessageType == NET_MESSAGE_ACK && pAck->wdAckType == NET_MESSAGE_ACK_OK;
+	}
+
+protected:
+	BYTE *m_pBuf;			//整条报文
+	DWORD m_dwBufLen;
+	BYTE *m_pRecords;		//报文中的记录区起点
+	BYTE *m_pRecord;		//当前记录
+	int m_nRecordLen;
+	int m_nMaxRecords;
+	int m_nCount;			//已写入的记录数
+	int m_nOffset;			//当前记录已写入的长度
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#define RTDB_WINDOW_DEFAULT		1		//默认同时等待应答的报文数
+#define RTDB_WINDOW_MAX			16
+
+// CRtdbUpdateWindow
+// 实时库更新报文的发送窗口：最多nWindow帧同时等待应答。管道接口GetNetMessage是同步的，
+// 窗口中的每个位置由一个发送线程和它独占的管道承担；调用者提交一帧后不等应答就继续组下一帧，
+// 窗口占满时才等待最早空出的位置。Flush等待全部在途报文的应答，返回此前未确认成功的记录数。
+// nWindow为0时不启动发送线程，Submit在调用线程中用一个管道同步发送。
+// 每个使用者各有一个窗口，实时库上的管道和发送线程数为使用者数×nWindow，多个处理线程时
+// 保持默认的1个位置即可：组下一帧与上一帧的应答重叠，每个线程只多占一个管道。
+// 不同位置的报文到达实时库的先后不保证，同一点在两次Flush之间只应提交一次，由调用者去重。
+//
+// 用法：
+//	m_RtdbWindow.Start(4);
+//	...
+//	if (frame.IsFull()) m_RtdbWindow.Submit(frame);
+//	...
+//	m_RtdbWindow.Submit(frame);
+//	int nFailed = m_RtdbWindow.Flush();
+
+class CRtdbUpdateWindow
+{
+protected:
+	struct WindowSlot
+	{
+		CRtdbUpdateWindow *pOwner;
+		int nIndex;
+		CWinThread *pThread;
+		HANDLE hSendEvent;		//报文已放入pBuf，发送线程开始发送
+		HANDLE hPipe;			//本位置独占的管道，发送失败后关闭，下次发送前重新打开
+		BYTE *pBuf;
+		DWORD dwBufLen;			//pBuf容量
+		DWORD dwLen;			//待发报文长度
+		int nRecords;			//待发报文中的记录数
+	};
+
+public:
+	CRtdbUpdateWindow()
+	{
+		m_nWindow = 0;
+		m_bStarted = FALSE;
+		m_bStop = FALSE;
+		m_nFailed = 0;
+		m_nFree = 0;
+		m_hFreeSemaphore = NULL;
+		memset(m_Slots,0,sizeof(m_Slots));
+		memset(&m_SyncSlot,0,sizeof(m_SyncSlot));
+		InitializeCriticalSection(&m_csFree);
+	}
+
+	~CRtdbUpdateWindow()
+	{
+		Stop();
+		DeleteCriticalSection(&m_csFree);
+	}
+
+	//启动nWindow个发送线程，nWindow为0时同步发送
+	BOOL Start(int nWindow)
+	{
+		if (m_bStarted)
+		{
+			return TRUE;
+		}
+		if (nWindow < 0 || nWindow > RTDB_WINDOW_MAX)
+		{
+			nWindow = RTDB_WINDOW_DEFAULT;
+		}
+		m_bStop = FALSE;
+		m_nFailed = 0;
+		m_nFree = 0;
+		m_nWindow = 0;
+		if (nWindow > 0)
+		{
+			m_hFreeSemaphore = CreateSemaphore(NULL, 0, nWindow, NULL);
+			if (m_hFreeSemaphore == NULL)
+			{
+				return FALSE;
+			}
+		}
+		for (int i=0; i<nWindow; i++)
+		{
+			WindowSlot &iSlot = m_Slots[i];
+			memset(&iSlot,0,sizeof(WindowSlot));
+			iSlot.pOwner = this;
+			iSlot.nIndex = i;
+			iSlot.hSendEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+			if (iSlot.hSendEvent == NULL)
+			{
+				break;
+			}
+			//Stop时要等待线程结束，线程对象不自动删除
+			iSlot.pThread = AfxBeginThread(SlotProc, &iSlot, THREAD_PRIORITY_NORMAL, 0, CREATE_SUSPENDED);
+			if (iSlot.pThread == NULL)
+			{
+				CloseHandle(iSlot.hSendEvent);
+				iSlot.hSendEvent = NULL;
+				break;
+			}
+			iSlot.pThread->m_bAutoDelete = FALSE;
+			iSlot.pThread->ResumeThread();
+			m_FreeSlots[m_nFree++] = i;
+			m_nWindow++;
+		}
+		if (m_nWindow > 0)
+		{
+			ReleaseSemaphore(m_hFreeSemaphore, m_nWindow, NULL);
+		}
+		else if (m_hFreeSemaphore != NULL)
+		{
+			CloseHandle(m_hFreeSemaphore);
+			m_hFreeSemaphore = NULL;
+		}
+		m_bStarted = TRUE;
+		return TRUE;
+	}
+
+	//等待在途报文发完，结束发送线程并关闭管道
+	void Stop()
+	{
+		if (!m_bStarted)
+		{
+			return;
+		}
+		Flush();
+		m_bStop = TRUE;
+		for (int i=0; i<m_nWindow; i++)
+		{
+			SetEvent(m_Slots[i].hSendEvent);
+		}
+		for (int i=0; i<m_nWindow; i++)
+		{
+			WindowSlot &iSlot = m_Slots[i];
+			WaitForSingleObject(iSlot.pThread->m_hThread, INFINITE);
+			delete iSlot.pThread;
+			CloseHandle(iSlot.hSendEvent);
+			ClosePipe(iSlot);
+			if (iSlot.pBuf != NULL)
+			{
+				delete[] iSlot.pBuf;
+			}
+			memset(&iSlot,0,sizeof(WindowSlot));
+		}
+		if (m_hFreeSemaphore != NULL)
+		{
+			CloseHandle(m_hFreeSemaphore);
+			m_hFreeSemaphore = NULL;
+		}
+		ClosePipe(m_SyncSlot);
+		m_nWindow = 0;
+		m_nFree = 0;
+		m_bStarted = FALSE;
+	}
+
+	//提交Frame中已写入的记录，之后Frame清空可继续写入；窗口已满时等待一个位置空出
+	void Submit(CRtdbUpdateFrame &Frame)
+	{
+		DWORD dwLen = 0;
+		const BYTE *pFrame = Frame.GetFrame(dwLen);
+		if (pFrame == NULL)
+		{
+			return;
+		}
+		int nRecords = Frame.GetCount();
+		if (m_nWindow == 0)
+		{
+			if (!SendOnSlot(m_SyncSlot, pFrame, dwLen))
+			{
+				m_nFailed += nRecords;
+			}
+			Frame.Reset();
+			return;
+		}
+		WaitForSingleObject(m_hFreeSemaphore, INFINITE);
+		EnterCriticalSection(&m_csFree);
+		WindowSlot &iSlot = m_Slots[m_FreeSlots[--m_nFree]];
+		LeaveCriticalSection(&m_csFree);
+		if (iSlot.dwBufLen < dwLen)
+		{
+			if (iSlot.pBuf != NULL)
+			{
+				delete[] iSlot.pBuf;
+			}
+			iSlot.pBuf = new BYTE[dwLen];
+			iSlot.dwBufLen = dwLen;
+		}
+		memcpy(iSlot.pBuf, pFrame, dwLen);
+		iSlot.dwLen = dwLen;
+		iSlot.nRecords = nRecords;
+		Frame.Reset();
+		SetEvent(iSlot.hSendEvent);
+	}
+
+	//等待全部在途报文应答，返回上次Flush以来未确认成功的记录数
+	int Flush()
+	{
+		for (int i=0; i<m_nWindow; i++)
+		{
+			WaitForSingleObject(m_hFreeSemaphore, INFINITE);
+		}
+		if (m_nWindow > 0)
+		{
+			ReleaseSemaphore(m_hFreeSemaphore, m_nWindow, NULL);
+		}
+		return (int)InterlockedExchange(&m_nFailed, 0);
+	}
+
+protected:
+	static void ClosePipe(WindowSlot &iSlot)
+	{
+		if (iSlot.hPipe != NULL)
+		{
+			CloseHandle(iSlot.hPipe);
+			iSlot.hPipe = NULL;
+		}
+	}
+
+	//在iSlot的管道上发送一帧，管道未打开时先打开；失败后关闭管道，下一帧重新打开
+	static BOOL SendOnSlot(WindowSlot &iSlot, const BYTE *pFrame, DWORD dwLen)
+	{
+		if (iSlot.hPipe == NULL)
+		{
+			iSlot.hPipe = OpenRealDataPipe();
+			if (iSlot.hPipe == NULL)
+			{
+				return FALSE;
+			}
+		}
+		if (!CRtdbUpdateFrame::SendFrame(iSlot.hPipe, pFrame, dwLen))
+		{
+			ClosePipe(iSlot);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	static UINT SlotProc(LPVOID pParam)
+	{
+		WindowSlot *pSlot = (WindowSlot*)pParam;
+		CRtdbUpdateWindow *pOwner = pSlot->pOwner;
+		while (WaitForSingleObject(pSlot->hSendEvent, INFINITE) == WAIT_OBJECT_0)
+		{
+			if (pOwner->m_bStop)
+			{
+				break;
+			}
+			if (!SendOnSlot(*pSlot, pSlot->pBuf, pSlot->dwLen))
+			{
+				InterlockedExchangeAdd(&pOwner->m_nFailed, pSlot->nRecords);
+			}
+			EnterCriticalSection(&pOwner->m_csFree);
+			pOwner->m_FreeSlots[pOwner->m_nFree++] = pSlot->nIndex;
+			LeaveCriticalSection(&pOwner->m_csFree);
+			ReleaseSemaphore(pOwner->m_hFreeSemaphore, 1, NULL);
+		}
+		return 0;
+	}
+
+protected:
+	int m_nWindow;						//发送线程数，0表示同步发送
+	BOOL m_bStarted;
+	volatile BOOL m_bStop;
+	volatile LONG m_nFailed;			//未确认成功的记录数
+	WindowSlot m_Slots[RTDB_WINDOW_MAX];
+	WindowSlot m_SyncSlot;				//同步发送时只用其中的管道
+	int m_FreeSlots[RTDB_WINDOW_MAX];	//空闲位置的下标
+	int m_nFree;
+	CRITICAL_SECTION m_csFree;
+	HANDLE m_hFreeSemaphore;			//空闲位置数
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdarg.h>
+
+#define SQL_TEXT_MAXLEN		400		//格式化单个值的缓冲区长度，double按%f输出最长约320字符
+#define SQL_VALUES_MAXROWS	1000	//SQL Server单条VALUES最多1000行
+
+// 拼批量SQL时格式化一个值追加到strSql：先在栈上缓冲区中格式化再整体追加，
+// 缓冲区能放下任意double的%f输出，万一仍放不下则退回CString格式化，不截断
+inline void AppendSqlText(CString& strSql, LPCTSTR szFormat, ...)
+{
+	TCHAR Text[SQL_TEXT_MAXLEN];
+	va_list args;
+	va_start(args, szFormat);
+	int nLen = _vsntprintf(Text, _countof(Text), szFormat, args);
+	va_end(args);
+	if (nLen>=0 && nLen<(int)_countof(Text))
+	{
+		strSql.Append(Text,nLen);
+		return;
+	}
+	va_start(args, szFormat);
+	strSql.AppendFormatV(szFormat, args);
+	va_end(args);
+}
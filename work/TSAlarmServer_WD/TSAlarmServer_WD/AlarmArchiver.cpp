@@ -0,0 +1,322 @@
+// AlarmArchiver.cpp : 实现文件
+//
+
+#include "stdafx.h"
+#include "TSAlarmServer_WD.h"
+#include "AlarmArchiver.h"
+
+extern CLog *g_log ;
+
+//TE_ALARM_INDEX与TE_ALARM_INDEX_BAK共有的列，与CAlarmBatchWriter写入的列一致
+static const TCHAR C_SQL_ArchiveFields[] = _T("ID,GROUP1,GROUP2,ALARMTYPE,ALARMTYPENAME,ALARMLEVEL,ALARMSOURCE,ALARMOBJTYPE,PROJECTID,\
+SYSTEMID,ALARMOBJID,DEVID,STATIONID,ALARMOBJNAME,DEVNAME,STATIONNAME,ALARMCONTENT,PROJECTNAME,RTALARM,STATUS,ALARMTIME,CONTENTTIME,\
+RESERVE1,RESERVE2,RESERVE3,RESERVE4,RESERVE5,RESERVE6");
+
+// CAlarmArchiver
+
+IMPLEMENT_DYNCREATE(CAlarmArchiver, CWinThread)
+
+CAlarmArchiver::CAlarmArchiver()
+{
+	m_nMoved = 0;
+	m_nTotalMoved = 0;
+	m_nTotalChunks = 0;
+	m_strCutoff = _T("");
+	m_strLastId = _T("");
+	m_strCheckpointPath = _T("");
+	m_hExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_StartEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	InitializeCriticalSection(&m_csJob);
+	if(NULL==g_log)
+	{
+		g_log = new CLog(_T("\\TSAlarmServer"));
+	}
+
+	//迁移参数从emscfg.ini的[ALARMARCHIVE]段读取，进度记在AlarmArchive.ini
+	m_nChunkRows = ARCHIVE_CHUNK_ROWS;
+	m_nRowsPerSec = ARCHIVE_ROWS_PER_SEC;
+	TCHAR szDirectory[MAX_PATH];
+	memset(szDirectory,0,sizeof(TCHAR)*MAX_PATH);
+	if (GetModuleFileName(NULL,szDirectory,MAX_PATH))
+	{
+		CString strPath = szDirectory;
+		int iIndex = strPath.ReverseFind('\\');
+		if (iIndex > 0)
+		{
+			CString strCountPath = strPath.Left(iIndex) + _T("\\parameter\\emscfg.ini");
+			m_nChunkRows = GetPrivateProfileInt(_T("ALARMARCHIVE"),_T("ChunkRows"),ARCHIVE_CHUNK_ROWS,strCountPath);
+			m_nRowsPerSec = GetPrivateProfileInt(_T("ALARMARCHIVE"),_T("RowsPerSec"),ARCHIVE_ROWS_PER_SEC,strCountPath);
+			m_strCheckpointPath = strPath.Left(iIndex) + _T("\\parameter\\AlarmArchive.ini");
+		}
+	}
+	if (m_nChunkRows <= 0)
+	{
+		m_nChunkRows = ARCHIVE_CHUNK_ROWS;
+	}
+	//RowsPerSec<=0表示不限速
+}
+
+CAlarmArchiver::~CAlarmArchiver()
+{
+	CloseHandle(m_hExitEvent);
+	CloseHandle(m_StartEvent);
+	DeleteCriticalSection(&m_csJob);
+}
+
+BOOL CAlarmArchiver::InitInstance()
+{
+	// TODO: 在此执行任意逐线程初始化
+	LoadCheckpoint();
+	while(1)
+	{
+		EnterCriticalSection(&m_csJob);
+		BOOL bPending = !m_strCutoff.IsEmpty();
+		LeaveCriticalSection(&m_csJob);
+		if (bPending)
+		{
+			//失败时保留进度，过一段时间从剩余的行继续
+			if (!RunArchive()&&WaitOrExit(ARCHIVE_RETRY_DELAY))
+			{
+				return FALSE;
+			}
+			continue;
+		}
+		HANDLE hEvents[2];
+		hEvents[0] = m_hExitEvent;
+		hEvents[1] = m_StartEvent;
+		DWORD dwWait = WaitForMultipleObjects(2, hEvents, FALSE, INFINITE);
+		switch (dwWait)
+		{
+		case WAIT_OBJECT_0:
+			return FALSE;
+		case WAIT_OBJECT_0+1:
+			ResetEvent(m_StartEvent);
+			break;
+		default:
+			Sleep(1000);
+			break;
+		}
+	}
+	return TRUE;
+}
+
+int CAlarmArchiver::ExitInstance()
+{
+	// TODO: 在此执行任意逐线程清理
+	return CWinThread::ExitInstance();
+}
+
+void CAlarmArchiver::Stop()
+{
+	SetEvent(m_hExitEvent);
+}
+
+//提交一次迁移任务；上一次任务未完成时直接改用新的截止日期，早于新截止日期的行会一并迁走
+void CAlarmArchiver::StartArchive(const COleDateTime &CutoffTime)
+{
+	CString strCutoff = _T("");
+	strCutoff.Format(_T("%04d-%02d-%02d"),CutoffTime.GetYear(),CutoffTime.GetMonth(),CutoffTime.GetDay());
+	EnterCriticalSection(&m_csJob);
+	if (m_strCutoff!=strCutoff)
+	{
+		if (!m_strCutoff.IsEmpty())
+		{
+			ReguTrace(SQL,"告警迁移:截止%s的任务未完成(已迁移%I64d行)，改为截止%s继续",m_strCutoff,m_nMoved,strCutoff);
+		}
+		//截止日期变了，已迁移ID之前也可能有新符合条件的行，从头开始
+		m_strCutoff = strCutoff;
+		m_strLastId = _T("");
+		m_nMoved = 0;
+		SaveCheckpoint();
+	}
+	LeaveCriticalSection(&m_csJob);
+	SetEvent(m_StartEvent);
+}
+
+//返回TRUE表示已退出
+BOOL CAlarmArchiver::WaitOrExit(DWORD dwMilliseconds)
+{
+	return WaitForSingleObject(m_hExitEvent, dwMilliseconds)==WAIT_OBJECT_0;
+}
+
+void CAlarmArchiver::LoadCheckpoint()
+{
+	if (m_strCheckpointPath.IsEmpty())
+	{
+		return;
+	}
+	TCHAR szCutoff[32];
+	memset(szCutoff,0,sizeof(szCutoff));
+	GetPrivateProfileString(_T("CHECKPOINT"),_T("Cutoff"),_T(""),szCutoff,32,m_strCheckpointPath);
+	TCHAR szLastId[ARCHIVE_ID_MAXLEN];
+	memset(szLastId,0,sizeof(szLastId));
+	GetPrivateProfileString(_T("CHECKPOINT"),_T("LastId"),_T(""),szLastId,ARCHIVE_ID_MAXLEN,m_strCheckpointPath);
+	TCHAR szMoved[32];
+	memset(szMoved,0,sizeof(szMoved));
+	GetPrivateProfileString(_T("CHECKPOINT"),_T("Moved"),_T("0"),szMoved,32,m_strCheckpointPath);
+	EnterCriticalSection(&m_csJob);
+	m_strCutoff = szCutoff;
+	m_strLastId = szLastId;
+	m_nMoved = _ttoi64(szMoved);
+	if (!m_strCutoff.IsEmpty())
+	{
+		ReguTrace(SQL,"告警迁移:发现未完成的任务，截止%s,已迁移%I64d行，从ID '%s'之后继续迁移",m_strCutoff,m_nMoved,m_strLastId);
+	}
+	LeaveCriticalSection(&m_csJob);
+}
+
+//调用者持有m_csJob
+void CAlarmArchiver::SaveCheckpoint()
+{
+	if (m_strCheckpointPath.IsEmpty())
+	{
+		return;
+	}
+	CString strMoved = _T("");
+	strMoved.Format(_T("%I64d"),m_nMoved);
+	WritePrivateProfileString(_T("CHECKPOINT"),_T("Cutoff"),m_strCutoff,m_strCheckpointPath);
+	WritePrivateProfileString(_T("CHECKPOINT"),_T("LastId"),m_strLastId,m_strCheckpointPath);
+	WritePrivateProfileString(_T("CHECKPOINT"),_T("Moved"),strMoved,m_strCheckpointPath);
+}
+
+//按ID顺序迁移strLastId之后的一块：先取本块的最大ID，再按同一ID区间插入备份表、从告警表删除，
+//在一个事务中完成，单块要么整体完成要么整体回滚，中途退出不会重复或丢行。备份表按列名写入，不依赖两表列顺序一致。
+//成功时strLastId更新为本块的最大ID，返回本块迁移的行数，0表示已迁完，-1表示失败
+int CAlarmArchiver::MoveChunk(HANDLE &hPipe, const CString &strCutoff, CString &strLastId)
+{
+	CString strAfter = strLastId;
+	strAfter.Replace(_T("'"), _T("''"));
+	CString strRange = _T("");
+	strRange.Format(_T("ALARMTIME <= '%s' AND ID > '%s'"),(LPCTSTR)strCutoff,(LPCTSTR)strAfter);
+	CString strSql = _T("");
+	strSql.Format(_T("SET NOCOUNT ON; SET XACT_ABORT ON; DECLARE @last varchar(%d), @n int; BEGIN TRAN; \
+SELECT @last=MAX(ID) FROM (SELECT TOP(%d) ID FROM TE_ALARM_INDEX WITH (UPDLOCK,HOLDLOCK) WHERE %s ORDER BY ID) c; \
+INSERT INTO TE_ALARM_INDEX_BAK (%s) SELECT %s FROM TE_ALARM_INDEX WHERE %s AND ID <= @last; \
+DELETE FROM TE_ALARM_INDEX WHERE %s AND ID <= @last; SET @n=@@ROWCOUNT; COMMIT; SELECT @n, @last;"),
+		ARCHIVE_ID_MAXLEN,m_nChunkRows,(LPCTSTR)strRange,C_SQL_ArchiveFields,C_SQL_ArchiveFields,(LPCTSTR)strRange,(LPCTSTR)strRange);
+	BYTE* pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strSql);
+	int nRows = -1;
+	CRecordSetReader rs;
+	if (rs.Attach(pRead,CRecordSetReader::GetReplyLen(pRead),2)&&rs.NextRecord())
+	{
+		nRows = rs.GetInt(0);
+		if (nRows>0)
+		{
+			rs.GetString(1,strLastId);
+		}
+	}
+	if (pRead)
+	{
+		delete[] pRead;
+		pRead = NULL;
+	}
+	return nRows;
+}
+
+//迁移当前任务直到迁完、失败或退出；只有迁完时返回TRUE
+BOOL CAlarmArchiver::RunArchive()
+{
+	HANDLE hPipe = OpenRealDataPipe();
+	int ReConnTime = 0;
+	while (hPipe == NULL)
+	{
+		if (ReConnTime>=3)
+		{
+			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
+			return FALSE;
+		}
+		ReConnTime++;
+		if (WaitOrExit(1000))
+		{
+			return FALSE;
+		}
+		hPipe = OpenRealDataPipe();
+	}
+
+	EnterCriticalSection(&m_csJob);
+	CString strCutoff = m_strCutoff;
+	CString strLastId = m_strLastId;
+	LeaveCriticalSection(&m_csJob);
+	ReguTrace(SQL,"告警迁移开始:截止%s,从ID '%s'之后,每块%d行,限速%d行/秒",strCutoff,strLastId,m_nChunkRows,m_nRowsPerSec);
+
+	DWORD dwBegin = GetTickCount();
+	__int64 nRunMoved = 0;
+	int nRunChunks = 0;
+	BOOL bDone = FALSE;
+	while (1)
+	{
+		DWORD dwChunkBegin = GetTickCount();
+		int nRows = MoveChunk(hPipe,strCutoff,strLastId);
+		if (nRows<0)
+		{
+			ReguTrace(SQLERRO,"告警迁移:截止%s的分块迁移失败，已迁移%I64d行，稍后继续",strCutoff,m_nMoved);
+			break;
+		}
+		if (nRows==0)
+		{
+			bDone = TRUE;
+			break;
+		}
+		nRunMoved += nRows;
+		nRunChunks++;
+		EnterCriticalSection(&m_csJob);
+		//迁移过程中提交了新的截止日期时不覆盖新任务的进度
+		__int64 nMoved = m_nMoved + nRows;
+		if (m_strCutoff==strCutoff)
+		{
+			m_strLastId = strLastId;
+			m_nMoved = nMoved;
+			SaveCheckpoint();
+		}
+		LeaveCriticalSection(&m_csJob);
+		m_nTotalMoved += nRows;
+		m_nTotalChunks++;
+
+		DWORD dwChunkSpan = GetTickCount() - dwChunkBegin;
+		ReguTrace(Debug,"告警迁移:本块%d行,耗时%dms,本任务已迁移%I64d行,本块最大ID '%s'",
+			nRows,dwChunkSpan,nMoved,strLastId);
+		if (nRows<m_nChunkRows)
+		{
+			bDone = TRUE;
+			break;
+		}
+		//按速率上限休眠，退出时不等本轮休眠结束
+		if (m_nRowsPerSec>0)
+		{
+			DWORD dwExpect = (DWORD)((__int64)nRows*1000/m_nRowsPerSec);
+			if (dwExpect>dwChunkSpan&&WaitOrExit(dwExpect-dwChunkSpan))
+			{
+				break;
+			}
+		}
+		else if (WaitOrExit(0))
+		{
+			break;
+		}
+	}
+	CloseHandle(hPipe);
+	hPipe = NULL;
+
+	DWORD dwSpan = GetTickCount() - dwBegin;
+	EnterCriticalSection(&m_csJob);
+	__int64 nMoved = m_nMoved;
+	//迁移过程中提交了新的截止日期时保留新任务
+	if (bDone&&m_strCutoff==strCutoff)
+	{
+		m_strCutoff = _T("");
+		m_strLastId = _T("");
+		m_nMoved = 0;
+		SaveCheckpoint();
+	}
+	LeaveCriticalSection(&m_csJob);
+	ReguTrace(SQL,"告警迁移%s:截止%s,本次迁移%I64d行/%d块,耗时%dms,%.0f行/秒;任务累计%I64d行,程序累计%I64d行/%I64d块",
+		bDone?_T("完成"):_T("中断"),strCutoff,nRunMoved,nRunChunks,dwSpan,dwSpan>0?nRunMoved*1000.0/dwSpan:(double)nRunMoved,
+		nMoved,m_nTotalMoved,m_nTotalChunks);
+	return bDone;
+}
+
+BEGIN_MESSAGE_MAP(CAlarmArchiver, CWinThread)
+END_MESSAGE_MAP()
+
+
+// CAlarmArchiver 消息处理程序
@@ -0,0 +1,48 @@
+#pragma once
+
+#define ARCHIVE_CHUNK_ROWS		2000		//每个分块迁移的告警行数
+#define ARCHIVE_ROWS_PER_SEC	5000		//迁移速率上限(行/秒)
+#define ARCHIVE_RETRY_DELAY		60000		//分块失败后的重试间隔(ms)
+#define ARCHIVE_ID_MAXLEN		64		//告警ID(UUID字符串)的最大长度
+
+// CAlarmArchiver
+// 把ALARMTIME早于截止日期的告警从TE_ALARM_INDEX迁到TE_ALARM_INDEX_BAK。
+// 按ID顺序每次迁移一块，每块的插入和删除按同一ID区间在一个事务中完成，长事务拆成许多短事务，不长时间锁住告警表；
+// 块与块之间按速率上限休眠。截止日期、已迁移的最大ID和已迁移行数记在parameter\AlarmArchive.ini，
+// 程序中途退出后重启从该ID之后继续迁完未完成的截止日期。
+
+class CAlarmArchiver : public CWinThread
+{
+	DECLARE_DYNCREATE(CAlarmArchiver)
+
+public:
+	CAlarmArchiver();           // 动态创建所使用的受保护的构造函数
+	virtual ~CAlarmArchiver();
+
+public:
+	virtual BOOL InitInstance();
+	virtual int ExitInstance();
+	void StartArchive(const COleDateTime &CutoffTime);
+	void Stop();
+protected:
+	BOOL RunArchive();
+	int MoveChunk(HANDLE &hPipe, const CString &strCutoff, CString &strLastId);
+	void LoadCheckpoint();
+	void SaveCheckpoint();
+	BOOL WaitOrExit(DWORD dwMilliseconds);
+public:
+	CString m_strCheckpointPath;
+	CString m_strCutoff;			//当前迁移任务的截止日期yyyy-mm-dd，空表示没有未完成的任务
+	CString m_strLastId;			//当前任务已迁移的最大ID，空表示从头开始
+	__int64 m_nMoved;				//当前任务已迁移行数
+	CRITICAL_SECTION m_csJob;
+	HANDLE m_StartEvent,m_hExitEvent;
+	int m_nChunkRows;
+	int m_nRowsPerSec;
+	//统计
+	__int64 m_nTotalMoved;
+	__int64 m_nTotalChunks;
+
+protected:
+	DECLARE_MESSAGE_MAP()
+};
@@ -0,0 +1,655 @@
+// AlarmBatchWriter.cpp : 实现文件
+//
+
+#include "stdafx.h"
+#include "TSAlarmServer_WD.h"
+#include "AlarmBatchWriter.h"
+
+extern CLog *g_log ;
+
+static const TCHAR C_SQL_AlarmIndex_Fields[] = _T("ID,GROUP1,GROUP2,ALARMTYPE,ALARMTYPENAME,ALARMLEVEL,ALARMSOURCE,ALARMOBJTYPE,PROJECTID,\
+SYSTEMID,ALARMOBJID,DEVID,STATIONID,ALARMOBJNAME,DEVNAME,STATIONNAME,ALARMCONTENT,PROJECTNAME,RTALARM,STATUS,ALARMTIME,CONTENTTIME,\
+RESERVE1,RESERVE2,RESERVE3,RESERVE4,RESERVE5,RESERVE6");
+static const TCHAR C_SQL_AlarmIndex_SrcFields[] = _T("s.ID,s.GROUP1,s.GROUP2,s.ALARMTYPE,s.ALARMTYPENAME,s.ALARMLEVEL,s.ALARMSOURCE,s.ALARMOBJTYPE,s.PROJECTID,\
+s.SYSTEMID,s.ALARMOBJID,s.DEVID,s.STATIONID,s.ALARMOBJNAME,s.DEVNAME,s.STATIONNAME,s.ALARMCONTENT,s.PROJECTNAME,s.RTALARM,s.STATUS,s.ALARMTIME,s.CONTENTTIME,\
+s.RESERVE1,s.RESERVE2,s.RESERVE3,s.RESERVE4,s.RESERVE5,s.RESERVE6");
+
+//一条告警的VALUES行，字段顺序与C_SQL_AlarmIndex_Fields一致
+static void AppendAlarmValues(const AlarmItemDef& ALARMDef, BOOL bFirst, CString& strSql)
+{
+	CTime dt1 = CTime(ALARMDef.alarmTime);
+	CTime dt2 = CTime(ALARMDef.contentTime);
+	CString strAlarmID(ALARMDef.alarmID);
+	strAlarmID.Replace(_T("'"), _T("''"));
+	CString strAlarmTypeName(ALARMDef.alarmTypeName);
+	strAlarmTypeName.Replace(_T("'"), _T("''"));
+	CString strAlarmSource(ALARMDef.alarmSource);
+	strAlarmSource.Replace(_T("'"), _T("''"));
+	CString strAlarmObjName(ALARMDef.alarmObjName);
+	strAlarmObjName.Replace(_T("'"), _T("''"));
+	CString strDevName(ALARMDef.devName);
+	strDevName.Replace(_T("'"), _T("''"));
+	CString strStationName(ALARMDef.stationName);
+	strStationName.Replace(_T("'"), _T("''"));
+	CString strAlarmContent(ALARMDef.alarmContent);
+	strAlarmContent.Replace(_T("'"), _T("''"));
+	CString strPrjName(ALARMDef.projectName);
+	strPrjName.Replace(_T("'"), _T("''"));
+	CString strReserve5(ALARMDef.reserve5);
+	strReserve5.Replace(_T("'"), _T("''"));
+	CString strReserve6(ALARMDef.reserve6);
+	strReserve6.Replace(_T("'"), _T("''"));
+
+	CString strValues;
+	strValues.Format(_T("%s('%s',%d,%d,%d,'%s',%d,'%s',%d,%d,%d,%d,%d,%d,'%s','%s','%s','%s','%s',\
+%d,%d,'%d-%d-%d %d:%d:%d','%d-%d-%d %d:%d:%d',%d,%d,%f,%f,'%s','%s')"),
+		bFirst?_T(""):_T(","),
+		(LPCTSTR)strAlarmID,
+		ALARMDef.groupID1,
+		ALARMDef.groupID2,
+		ALARMDef.alarmType,
+		(LPCTSTR)strAlarmTypeName,
+		ALARMDef.alarmLevel,
+		(LPCTSTR)strAlarmSource,
+		ALARMDef.alarmObjType,
+		ALARMDef.projectID,
+		ALARMDef.systemID,
+		ALARMDef.alarmObjID,
+		ALARMDef.devID,
+		ALARMDef.stationID,
+		(LPCTSTR)strAlarmObjName,
+		(LPCTSTR)strDevName,
+		(LPCTSTR)strStationName,
+		(LPCTSTR)strAlarmContent,
+		(LPCTSTR)strPrjName,
+		ALARMDef.rtAlarm,
+		ALARMDef.status,
+		dt1.GetYear(),
+		dt1.GetMonth(),
+		dt1.GetDay(),
+		dt1.GetHour(),
+		dt1.GetMinute(),
+		dt1.GetSecond(),
+		dt2.GetYear(),
+		dt2.GetMonth(),
+		dt2.GetDay(),
+		dt2.GetHour(),
+		dt2.GetMinute(),
+		dt2.GetSecond(),
+		ALARMDef.reserve1,
+		ALARMDef.reserve2,
+		ALARMDef.reserve3,
+		ALARMDef.reserve4,
+		(LPCTSTR)strReserve5,
+		(LPCTSTR)strReserve6);
+	strSql.Append(strValues);
+}
+
+// CAlarmBatchWriter
+
+IMPLEMENT_DYNCREATE(CAlarmBatchWriter, CWinThread)
+
+CAlarmBatchWriter::CAlarmBatchWriter()
+{
+	m_nTotalAlarms = 0;
+	m_nTotalMerged = 0;
+	m_nTotalRoundTrips = 0;
+	m_nTotalSms = 0;
+	m_nTotalFailed = 0;
+	m_nTotalDropped = 0;
+	//退出时要等待本线程写完缓存，线程对象不能随线程结束自动删除
+	m_bAutoDelete = FALSE;
+	m_hExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_FlushEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	InitializeCriticalSection(&m_csPending);
+	InitializeCriticalSection(&m_csFlush);
+	if(NULL==g_log)
+	{
+		g_log = new CLog(_T("\\TSAlarmServer"));
+	}
+
+	//批量参数从emscfg.ini的[ALARMBATCH]段读取
+	m_nMaxBatchBytes = ALARM_BATCH_MAXBYTES;
+	m_nMaxDelay = ALARM_BATCH_MAXDELAY;
+	m_nMaxRows = ALARM_BATCH_MAXROWS;
+	TCHAR szDirectory[MAX_PATH];
+	memset(szDirectory,0,sizeof(TCHAR)*MAX_PATH);
+	if (GetModuleFileName(NULL,szDirectory,MAX_PATH))
+	{
+		CString strPath = szDirectory;
+		int iIndex = strPath.ReverseFind('\\');
+		if (iIndex > 0)
+		{
+			CString strCountPath = strPath.Left(iIndex) + _T("\\parameter\\emscfg.ini");
+			m_nMaxBatchBytes = GetPrivateProfileInt(_T("ALARMBATCH"),_T("MaxBatchBytes"),ALARM_BATCH_MAXBYTES,strCountPath);
+			m_nMaxDelay = GetPrivateProfileInt(_T("ALARMBATCH"),_T("MaxDelay"),ALARM_BATCH_MAXDELAY,strCountPath);
+			m_nMaxRows = GetPrivateProfileInt(_T("ALARMBATCH"),_T("MaxRows"),ALARM_BATCH_MAXROWS,strCountPath);
+		}
+	}
+	if (m_nMaxBatchBytes < 4096)
+	{
+		m_nMaxBatchBytes = 4096;
+	}
+	if (m_nMaxDelay <= 0)
+	{
+		m_nMaxDelay = ALARM_BATCH_MAXDELAY;
+	}
+	//SQL Server单条VALUES最多1000行
+	if (m_nMaxRows <= 0 || m_nMaxRows > 1000)
+	{
+		m_nMaxRows = ALARM_BATCH_MAXROWS;
+	}
+}
+
+CAlarmBatchWriter::~CAlarmBatchWriter()
+{
+	CloseHandle(m_FlushEvent);
+	CloseHandle(m_hExitEvent);
+	DeleteCriticalSection(&m_csFlush);
+	DeleteCriticalSection(&m_csPending);
+}
+
+BOOL CAlarmBatchWriter::InitInstance()
+{
+	// TODO: 在此执行任意逐线程初始化
+	while(1)
+	{
+		HANDLE hEvents[2];
+		hEvents[0] = m_hExitEvent;
+		hEvents[1] = m_FlushEvent;
+		DWORD dwWait = WaitForMultipleObjects(2, hEvents, FALSE, m_nMaxDelay);
+		switch (dwWait)
+		{
+		case WAIT_OBJECT_0:
+			Flush();
+			return FALSE;
+		case WAIT_OBJECT_0+1:
+			ResetEvent(m_FlushEvent);
+			Flush();
+			break;
+		case WAIT_TIMEOUT:
+			Flush();
+			break;
+		default:
+			Sleep(1000);
+			break;
+		}
+	}
+	return TRUE;
+}
+
+int CAlarmBatchWriter::ExitInstance()
+{
+	// TODO: 在此执行任意逐线程清理
+	return CWinThread::ExitInstance();
+}
+
+//通知线程把缓存写完后退出，并等待其结束。超时也不删除线程对象，其他线程此后仍可调用AddAlarm
+void CAlarmBatchWriter::Stop(DWORD dwTimeout)
+{
+	SetEvent(m_hExitEvent);
+	if (m_hThread!=NULL&&WaitForSingleObject(m_hThread,dwTimeout)!=WAIT_OBJECT_0)
+	{
+		ReguTrace(SQLERRO,"告警入库线程%dms内未退出",dwTimeout);
+	}
+}
+
+//去重键：对象类型+对象+告警类型，实时告警再加告警日期
+static void MakeWriteKey(int nMode, const AlarmItemDef& ALARMDef, AlarmWriteKey& iKey)
+{
+	memset(&iKey,0,sizeof(AlarmWriteKey));
+	iKey.alarmObjType = ALARMDef.alarmObjType;
+	iKey.alarmObjID = ALARMDef.alarmObjID;
+	iKey.alarmType = ALARMDef.alarmType;
+	if (nMode==ALARMWRITE_INSERT)
+	{
+		CTime dt1 = CTime(ALARMDef.alarmTime);
+		iKey.nDay = dt1.GetYear()*10000 + dt1.GetMonth()*100 + dt1.GetDay();
+	}
+}
+
+//把m_vecPending[nPos]登记到去重索引，调用者持有m_csPending
+void CAlarmBatchWriter::AddToIndex(int nPos)
+{
+	const AlarmWriteItem& iItem = m_vecPending[nPos];
+	AlarmWriteKey iKey;
+	MakeWriteKey(iItem.nMode,iItem.ALARMDef,iKey);
+	if (iItem.nMode==ALARMWRITE_RECOVER)
+	{
+		//恢复之后再来的同一对象告警是新告警，不能再合并到恢复之前的缓存中
+		AlarmWriteIndex::iterator it = m_PendingIndex.lower_bound(iKey);
+		while (it!=m_PendingIndex.end()&&it->first.alarmObjType==iKey.alarmObjType
+			&&it->first.alarmObjID==iKey.alarmObjID&&it->first.alarmType==iKey.alarmType)
+		{
+			m_PendingIndex.erase(it++);
+		}
+	}
+	else
+	{
+		m_PendingIndex[iKey] = nPos;
+	}
+}
+
+//缓存一条告警；同一对象同一类型(实时告警还要同一天)已在缓存中时只更新内容和时间
+void CAlarmBatchWriter::AddAlarm(int nMode, const AlarmItemDef& ALARMDef)
+{
+	AlarmWriteKey iKey;
+	MakeWriteKey(nMode,ALARMDef,iKey);
+
+	EnterCriticalSection(&m_csPending);
+	AlarmWriteIndex::iterator it = m_PendingIndex.end();
+	if (nMode!=ALARMWRITE_RECOVER)
+	{
+		it = m_PendingIndex.find(iKey);
+	}
+	if (it!=m_PendingIndex.end()&&m_vecPending[it->second].nMode==nMode)
+	{
+		AlarmItemDef& iPending = m_vecPending[it->second].ALARMDef;
+		memcpy(iPending.alarmContent,ALARMDef.alarmContent,sizeof(iPending.alarmContent));
+		iPending.contentTime = ALARMDef.contentTime;
+		m_nTotalMerged++;
+	}
+	else
+	{
+		AlarmWriteItem iItem;
+		iItem.nMode = nMode;
+		iItem.nRetry = 0;
+		iItem.ALARMDef = ALARMDef;
+		m_vecPending.push_back(iItem);
+		AddToIndex((int)m_vecPending.size() - 1);
+	}
+	BOOL bFlush = ((int)m_vecPending.size()>=m_nMaxRows);
+	LeaveCriticalSection(&m_csPending);
+
+	if (bFlush)
+	{
+		SetEvent(m_FlushEvent);
+	}
+}
+
+//缓存一条告警短信，发送时间取入缓存的时间
+void CAlarmBatchWriter::AddSmsRecord(const SMSConfigDef& iSMSCofig, const CString& strContent)
+{
+	SmsRecordItem iItem;
+	memcpy(iItem.PersonName,iSMSCofig.PersonName,sizeof(iItem.PersonName));
+	memcpy(iItem.PhoneNum,iSMSCofig.PhoneNum,sizeof(iItem.PhoneNum));
+	iItem.strContent = strContent;
+	iItem.tSendTime = CTime::GetCurrentTime().GetTime();
+	iItem.nRetry = 0;
+
+	EnterCriticalSection(&m_csPending);
+	m_vecSmsPending.push_back(iItem);
+	BOOL bFlush = ((int)m_vecSmsPending.size()>=m_nMaxRows);
+	LeaveCriticalSection(&m_csPending);
+
+	if (bFlush)
+	{
+		SetEvent(m_FlushEvent);
+	}
+}
+
+//[nBegin,nEnd)的短信记录生成一条多行插入语句追加到strSql，返回行数；列与原Insert2SMSRECORD一致
+int CAlarmBatchWriter::BuildSmsRecordSql(const vector<SmsRecordItem>& vecSms, int nBegin, int nEnd, CString& strSql)
+{
+	if (nEnd<=nBegin)
+	{
+		return 0;
+	}
+	strSql.Append(_T("INSERT INTO TE_SMSRECORD VALUES"));
+	CString strValues;
+	for (int i=nBegin;i<nEnd;i++)
+	{
+		const SmsRecordItem& iItem = vecSms[i];
+		CString strName(iItem.PersonName);
+		strName.Replace(_T("'"), _T("''"));
+		CString strPhone(iItem.PhoneNum);
+		strPhone.Replace(_T("'"), _T("''"));
+		CString strContent(iItem.strContent);
+		strContent.Replace(_T("'"), _T("''"));
+		CTime CurTime(iItem.tSendTime);
+		strValues.Format(_T("%s(1,'%s','%s','%s','%d-%d-%d %d:%d:%d',1)"),
+			i==nBegin?_T(""):_T(","),
+			(LPCTSTR)strName,(LPCTSTR)strPhone,(LPCTSTR)strContent,CurTime.GetYear(),CurTime.GetMonth(),
+			CurTime.GetDay(),CurTime.GetHour(),CurTime.GetMinute(),CurTime.GetSecond());
+		strSql.Append(strValues);
+	}
+	strSql.Append(_T("; "));
+	return nEnd - nBegin;
+}
+
+//[nBegin,nEnd)的同类告警生成一条多行语句追加到strSql，返回行数
+int CAlarmBatchWriter::BuildInsertSql(int nMode, const vector<AlarmWriteItem>& vecItem, int nBegin, int nEnd, CString& strSql)
+{
+	if (nEnd<=nBegin)
+	{
+		return 0;
+	}
+	if (nMode==ALARMWRITE_UPSERT)
+	{
+		//与C_SQL_INSERT_ALARMINDEX相同：有未恢复告警则更新内容和时间，否则插入
+		strSql.Append(_T("MERGE TE_ALARM_INDEX AS t USING (VALUES "));
+		for (int i=nBegin;i<nEnd;i++)
+		{
+			AppendAlarmValues(vecItem[i].ALARMDef,i==nBegin,strSql);
+		}
+		strSql.Append(_T(") AS s("));
+		strSql.Append(C_SQL_AlarmIndex_Fields);
+		strSql.Append(_T(") ON t.ALARMTYPE=s.ALARMTYPE AND t.ALARMOBJID=s.ALARMOBJID AND t.ALARMOBJTYPE=s.ALARMOBJTYPE AND t.STATUS=0 \
+WHEN MATCHED THEN UPDATE SET ALARMCONTENT=s.ALARMCONTENT,CONTENTTIME=s.CONTENTTIME WHEN NOT MATCHED THEN INSERT ("));
+		strSql.Append(C_SQL_AlarmIndex_Fields);
+		strSql.Append(_T(") VALUES ("));
+		strSql.Append(C_SQL_AlarmIndex_SrcFields);
+		strSql.Append(_T("); "));
+	}
+	else
+	{
+		strSql.Append(_T("insert into TE_ALARM_INDEX ("));
+		strSql.Append(C_SQL_AlarmIndex_Fields);
+		strSql.Append(_T(") values "));
+		for (int i=nBegin;i<nEnd;i++)
+		{
+			AppendAlarmValues(vecItem[i].ALARMDef,i==nBegin,strSql);
+		}
+		strSql.Append(_T("; "));
+	}
+	return nEnd - nBegin;
+}
+
+//与原ChangeAlarmStatus一致
+void CAlarmBatchWriter::BuildRecoverSql(const AlarmItemDef& ALARMDef, CString& strSql)
+{
+	CTime dt2 = CTime(ALARMDef.alarmTime);
+	CString strAlarmContent(ALARMDef.alarmContent);
+	strAlarmContent.Replace(_T("'"), _T("''"));
+	CString strUpdateSql = _T("");
+	strUpdateSql.Format(_T("update TE_ALARM_INDEX set STATUS=2,ALARMCONTENT='%s', CONTENTTIME='%d-%d-%d %d:%d:%d' where ALARMTYPE=%d and ALARMOBJID=%d and ALARMOBJTYPE=%d and STATUS=0; "),
+		(LPCTSTR)strAlarmContent,
+		dt2.GetYear(),
+		dt2.GetMonth(),
+		dt2.GetDay(),
+		dt2.GetHour(),
+		dt2.GetMinute(),
+		dt2.GetSecond(),
+		ALARMDef.alarmType,
+		ALARMDef.alarmObjID,
+		ALARMDef.alarmObjType);
+	strSql.Append(strUpdateSql);
+}
+
+//执行一批语句。无应答、实时库否定应答或应答不是确认报文都算失败，失败后关闭管道，下一次重新打开
+int CAlarmBatchWriter::WriteSql(HANDLE& hPipe, const CString& strSql)
+{
+	int ReConnTime = 0;
+	while (hPipe == NULL)
+	{
+		hPipe = OpenRealDataPipe();
+		if (hPipe!=NULL)
+		{
+			break;
+		}
+		if (ReConnTime>=3)
+		{
+			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
+			return ALARMSQL_NOPIPE;
+		}
+		ReConnTime++;
+		Sleep(1000);
+	}
+	ReguTrace(SQL,"告警记录入库SQL:<%s>",strSql);
+	CString strSqlFinal = strSql;
+	BYTE* pRead = NULL;
+	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
+	if (pRead == NULL)
+	{
+		ReguTrace(SQLERRO,"告警入库无应答:<%s>",strSql.Left(512));
+		CloseHandle(hPipe);
+		hPipe = NULL;
+		return ALARMSQL_FAILED;
+	}
+	//与CRtdbUpdateFrame::SendFrame相同，只有确认成功的应答才算写入，其他报文也按失败重试
+	BOOL bOk = CRtdbUpdateFrame::IsAckOk(pRead);
+	if (!bOk)
+	{
+		NetMessageHead* pMessageHead = (NetMessageHead*)pRead;
+		MessageAck* pAck = (MessageAck*)&pRead[sizeof(NetMessageHead)];
+		ReguTrace(SQLERRO,"告警入库执行失败(报文类型%d,应答%d):<%s>",pMessageHead->MessageType,
+			pMessageHead->MessageType==NET_MESSAGE_ACK?pAck->wdAckType:-1,strSql.Left(512));
+	}
+	delete[] pRead;
+	pRead = NULL;
+	if (!bOk)
+	{
+		CloseHandle(hPipe);
+		hPipe = NULL;
+		return ALARMSQL_FAILED;
+	}
+	return ALARMSQL_OK;
+}
+
+//一条语句没有写入：其中的告警或短信放入待重试队列。bCountRetry为TRUE时(语句已执行失败)重试次数加1，
+//超过ALARM_BATCH_MAXRETRY的丢弃；为FALSE时(管道打不开，语句未发出)原样排队
+void CAlarmBatchWriter::CollectFailed(const AlarmSqlUnit& Unit, BOOL bCountRetry, const vector<AlarmWriteItem>& vecItem, const vector<SmsRecordItem>& vecSms,
+	vector<AlarmWriteItem>& vecRetryItem, vector<SmsRecordItem>& vecRetrySms)
+{
+	int nDropped = 0;
+	for (int i=Unit.nBegin;i<Unit.nEnd;i++)
+	{
+		int nRetry = (Unit.bSms?vecSms[i].nRetry:vecItem[i].nRetry) + (bCountRetry?1:0);
+		if (nRetry>ALARM_BATCH_MAXRETRY)
+		{
+			nDropped++;
+			continue;
+		}
+		if (Unit.bSms)
+		{
+			vecRetrySms.push_back(vecSms[i]);
+			vecRetrySms.back().nRetry = nRetry;
+		}
+		else
+		{
+			vecRetryItem.push_back(vecItem[i]);
+			vecRetryItem.back().nRetry = nRetry;
+		}
+	}
+	if (nDropped>0)
+	{
+		m_nTotalDropped += nDropped;
+		ReguTrace(SQLERRO,"告警入库重试%d次仍失败,丢弃%s%d条:<%s>",ALARM_BATCH_MAXRETRY,Unit.bSms?_T("短信"):_T("告警"),nDropped,Unit.strSql.Left(512));
+	}
+}
+
+//未写入的告警和短信放回缓存最前面，保持与这期间新到告警的先后顺序，并重建去重索引
+void CAlarmBatchWriter::Requeue(vector<AlarmWriteItem>& vecRetryItem, vector<SmsRecordItem>& vecRetrySms)
+{
+	if (vecRetryItem.empty()&&vecRetrySms.empty())
+	{
+		return;
+	}
+	int nDropped = 0;
+	EnterCriticalSection(&m_csPending);
+	vecRetryItem.insert(vecRetryItem.end(),m_vecPending.begin(),m_vecPending.end());
+	m_vecPending.swap(vecRetryItem);
+	vecRetrySms.insert(vecRetrySms.end(),m_vecSmsPending.begin(),m_vecSmsPending.end());
+	m_vecSmsPending.swap(vecRetrySms);
+	//实时库长时间不可用时缓存不能无限增长，丢弃最早的
+	if ((int)m_vecPending.size()>ALARM_BATCH_MAXPENDING)
+	{
+		int nOver = (int)m_vecPending.size() - ALARM_BATCH_MAXPENDING;
+		m_vecPending.erase(m_vecPending.begin(),m_vecPending.begin()+nOver);
+		nDropped += nOver;
+	}
+	if ((int)m_vecSmsPending.size()>ALARM_BATCH_MAXPENDING)
+	{
+		int nOver = (int)m_vecSmsPending.size() - ALARM_BATCH_MAXPENDING;
+		m_vecSmsPending.erase(m_vecSmsPending.begin(),m_vecSmsPending.begin()+nOver);
+		nDropped += nOver;
+	}
+	m_PendingIndex.clear();
+	for (int i=0;i<(int)m_vecPending.size();i++)
+	{
+		AddToIndex(i);
+	}
+	int nPending = (int)m_vecPending.size();
+	int nSmsPending = (int)m_vecSmsPending.size();
+	LeaveCriticalSection(&m_csPending);
+
+	if (nDropped>0)
+	{
+		m_nTotalDropped += nDropped;
+		ReguTrace(SQLERRO,"告警入库待重试缓存已满,丢弃最早的%d条",nDropped);
+	}
+	ReguTrace(SQLERRO,"告警入库失败,重新排队:告警%d条,短信%d条",nPending,nSmsPending);
+}
+
+//把缓存的告警全部入库；诊断结束后需要基于入库结果继续处理时可直接调用。
+//写入失败的告警重新排队，由下一次Flush重试
+void CAlarmBatchWriter::Flush()
+{
+	vector<AlarmWriteItem> vecItem;
+	vector<SmsRecordItem> vecSms;
+	//与CSampleBatchWriter::Flush相同，先取m_csFlush再取缓存：两个Flush并发时，后一个要等前一个把失败的告警
+	//重新排队后才取缓存，同一对象的告警不会被两批乱序写入，重试告警也不会与新告警拆到两批中各写一次
+	EnterCriticalSection(&m_csFlush);
+	EnterCriticalSection(&m_csPending);
+	vecItem.swap(m_vecPending);
+	m_PendingIndex.clear();
+	vecSms.swap(m_vecSmsPending);
+	LeaveCriticalSection(&m_csPending);
+	if (vecItem.empty()&&vecSms.empty())
+	{
+		LeaveCriticalSection(&m_csFlush);
+		return;
+	}
+
+	DWORD dwBegin = GetTickCount();
+	//先生成全部语句：连续的同类告警合并为一条，保持与恢复语句之间的先后顺序；重试过的告警单独成句
+	vector<AlarmSqlUnit> vecUnit;
+	int nCount = (int)vecItem.size();
+	int i = 0;
+	while (i<nCount)
+	{
+		AlarmSqlUnit Unit;
+		Unit.bSms = FALSE;
+		Unit.nBegin = i;
+		int nMode = vecItem[i].nMode;
+		if (nMode==ALARMWRITE_RECOVER)
+		{
+			BuildRecoverSql(vecItem[i].ALARMDef,Unit.strSql);
+			i++;
+		}
+		else
+		{
+			int nEnd = i + 1;
+			while (vecItem[i].nRetry==0&&nEnd<nCount&&vecItem[nEnd].nMode==nMode&&vecItem[nEnd].nRetry==0&&nEnd-i<m_nMaxRows)
+			{
+				nEnd++;
+			}
+			BuildInsertSql(nMode,vecItem,i,nEnd,Unit.strSql);
+			i = nEnd;
+		}
+		Unit.nEnd = i;
+		vecUnit.push_back(Unit);
+	}
+	//短信记录接在告警之后，与最后一批告警共用往返
+	int nSmsCount = (int)vecSms.size();
+	i = 0;
+	while (i<nSmsCount)
+	{
+		AlarmSqlUnit Unit;
+		Unit.bSms = TRUE;
+		Unit.nBegin = i;
+		int nEnd = i + 1;
+		while (vecSms[i].nRetry==0&&nEnd<nSmsCount&&vecSms[nEnd].nRetry==0&&nEnd-i<m_nMaxRows)
+		{
+			nEnd++;
+		}
+		BuildSmsRecordSql(vecSms,i,nEnd,Unit.strSql);
+		i = nEnd;
+		Unit.nEnd = i;
+		vecUnit.push_back(Unit);
+	}
+
+	//多条语句拼成一批一次往返；整批失败时逐条重发，只有出错的语句重新排队
+	HANDLE hPipe = NULL;
+	CString strBatch = _T("");
+	strBatch.Preallocate(m_nMaxBatchBytes/sizeof(TCHAR) + 4096);
+	vector<AlarmWriteItem> vecRetryItem;
+	vector<SmsRecordItem> vecRetrySms;
+	int nUnits = (int)vecUnit.size();
+	int nRoundTrips = 0;
+	int nFailed = 0;
+	BOOL bNoPipe = FALSE;
+	i = 0;
+	while (i<nUnits&&!bNoPipe)
+	{
+		int nEnd = i;
+		strBatch.Truncate(0);
+		while (nEnd<nUnits&&(nEnd==i||(strBatch.GetLength()+vecUnit[nEnd].strSql.GetLength())*(int)sizeof(TCHAR)<=m_nMaxBatchBytes))
+		{
+			strBatch.Append(vecUnit[nEnd].strSql);
+			nEnd++;
+		}
+		int nRet = WriteSql(hPipe,strBatch);
+		nRoundTrips++;
+		if (nRet==ALARMSQL_NOPIPE)
+		{
+			bNoPipe = TRUE;
+			break;
+		}
+		if (nRet==ALARMSQL_FAILED&&nEnd-i==1)
+		{
+			CollectFailed(vecUnit[i],TRUE,vecItem,vecSms,vecRetryItem,vecRetrySms);
+			nFailed++;
+		}
+		else if (nRet==ALARMSQL_FAILED)
+		{
+			for (;i<nEnd;i++)
+			{
+				nRet = WriteSql(hPipe,vecUnit[i].strSql);
+				nRoundTrips++;
+				if (nRet==ALARMSQL_NOPIPE)
+				{
+					bNoPipe = TRUE;
+					break;
+				}
+				if (nRet==ALARMSQL_FAILED)
+				{
+					CollectFailed(vecUnit[i],TRUE,vecItem,vecSms,vecRetryItem,vecRetrySms);
+					nFailed++;
+				}
+			}
+			if (bNoPipe)
+			{
+				break;
+			}
+		}
+		i = nEnd;
+	}
+	//管道打不开时剩下的语句都未发出，原样排队
+	for (;i<nUnits;i++)
+	{
+		CollectFailed(vecUnit[i],FALSE,vecItem,vecSms,vecRetryItem,vecRetrySms);
+	}
+	if (hPipe != NULL)
+	{
+		CloseHandle(hPipe);
+		hPipe = NULL;
+	}
+	Requeue(vecRetryItem,vecRetrySms);
+	DWORD dwSpan = GetTickCount() - dwBegin;
+	m_nTotalAlarms += nCount;
+	m_nTotalRoundTrips += nRoundTrips;
+	m_nTotalSms += nSmsCount;
+	m_nTotalFailed += nFailed;
+	LeaveCriticalSection(&m_csFlush);
+
+	ReguTrace(SQL,"告警入库:告警%d条,短信%d条,往返%d次,失败语句%d条,耗时%dms,%.0f条/秒;累计告警%I64d条,短信%I64d条,合并重复%I64d条,往返%I64d次,失败语句%I64d条,丢弃%I64d条",
+		nCount,nSmsCount,nRoundTrips,nFailed,dwSpan,dwSpan>0?(nCount+nSmsCount)*1000.0/dwSpan:(double)(nCount+nSmsCount),
+		m_nTotalAlarms,m_nTotalSms,m_nTotalMerged,m_nTotalRoundTrips,m_nTotalFailed,m_nTotalDropped);
+}
+
+BEGIN_MESSAGE_MAP(CAlarmBatchWriter, CWinThread)
+END_MESSAGE_MAP()
+
+
+// CAlarmBatchWriter 消息处理程序
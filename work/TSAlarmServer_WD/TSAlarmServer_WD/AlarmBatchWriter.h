@@ -0,0 +1,130 @@
+#pragma once
+
+#define ALARM_BATCH_MAXROWS		200				//单条语句最大告警行数
+#define ALARM_BATCH_MAXBYTES	(256*1024)		//单批SQL最大字节数
+#define ALARM_BATCH_MAXDELAY	2000			//告警最大缓存时间(ms)
+#define ALARM_BATCH_MAXRETRY	3				//同一条告警/短信入库失败后的最多重试次数，超过后丢弃
+#define ALARM_BATCH_MAXPENDING	100000			//失败重新排队后缓存的最多告警/短信条数，超出时丢弃最早的
+#define ALARM_BATCH_EXIT_TIMEOUT	30000		//退出时等待入库线程写完缓存的最长时间(ms)
+
+//告警入库方式
+enum
+{
+	ALARMWRITE_INSERT = 0,		//直接插入，实时告警
+	ALARMWRITE_UPSERT,			//同一对象同一类型有未恢复告警时只更新内容和时间，否则插入，诊断告警
+	ALARMWRITE_RECOVER,			//告警恢复，未恢复告警置为已恢复
+};
+
+//WriteSql的结果
+enum
+{
+	ALARMSQL_OK = 0,
+	ALARMSQL_NOPIPE,			//管道打不开，语句未发出
+	ALARMSQL_FAILED,			//无应答或实时库应答执行失败
+};
+
+//去重键：对象类型+对象+告警类型+告警日期
+struct AlarmWriteKey
+{
+	int alarmObjType;
+	int alarmObjID;
+	int alarmType;
+	int nDay;			//yyyymmdd，ALARMWRITE_UPSERT为0，库中按未恢复告警判断，与日期无关
+
+	bool operator<(const AlarmWriteKey& other) const
+	{
+		if (alarmObjType!=other.alarmObjType)
+		{
+			return alarmObjType<other.alarmObjType;
+		}
+		if (alarmObjID!=other.alarmObjID)
+		{
+			return alarmObjID<other.alarmObjID;
+		}
+		if (alarmType!=other.alarmType)
+		{
+			return alarmType<other.alarmType;
+		}
+		return nDay<other.nDay;
+	}
+};
+
+struct AlarmWriteItem
+{
+	int nMode;
+	int nRetry;				//入库失败次数，重试时单独成句，不再与其他告警合并
+	AlarmItemDef ALARMDef;
+};
+
+//一条待入库的短信记录，对应TE_SMSRECORD的一行
+struct SmsRecordItem
+{
+	TCHAR PersonName[65];
+	TCHAR PhoneNum[65];
+	CString strContent;
+	__time64_t tSendTime;
+	int nRetry;
+};
+
+//一条待执行的语句及其对应的告警或短信下标范围[nBegin,nEnd)，入库失败时按此重新排队
+struct AlarmSqlUnit
+{
+	BOOL bSms;
+	int nBegin;
+	int nEnd;
+	CString strSql;
+};
+
+typedef std::map<AlarmWriteKey,int> AlarmWriteIndex;
+
+// CAlarmBatchWriter
+// 诊断告警和实时告警统一在此缓存，相同(对象,类型,日期)的告警只保留一条，
+// 连续的同类告警合并成一条多行语句，按条数或时延批量入库，每次入库只打开一个管道；
+// 告警短信记录(TE_SMSRECORD)也在此缓存，随告警一起批量插入。
+// 整批执行失败时逐条语句重发，失败语句中的告警重新排队、下次单独成句，重试ALARM_BATCH_MAXRETRY次后丢弃
+
+class CAlarmBatchWriter : public CWinThread
+{
+	DECLARE_DYNCREATE(CAlarmBatchWriter)
+
+public:
+	CAlarmBatchWriter();           // 动态创建所使用的受保护的构造函数
+	virtual ~CAlarmBatchWriter();
+
+public:
+	virtual BOOL InitInstance();
+	virtual int ExitInstance();
+	void AddAlarm(int nMode, const AlarmItemDef& ALARMDef);
+	void AddSmsRecord(const SMSConfigDef& iSMSCofig, const CString& strContent);
+	void Flush();
+	void Stop(DWORD dwTimeout = ALARM_BATCH_EXIT_TIMEOUT);
+protected:
+	int BuildInsertSql(int nMode, const vector<AlarmWriteItem>& vecItem, int nBegin, int nEnd, CString& strSql);
+	void BuildRecoverSql(const AlarmItemDef& ALARMDef, CString& strSql);
+	int BuildSmsRecordSql(const vector<SmsRecordItem>& vecSms, int nBegin, int nEnd, CString& strSql);
+	int WriteSql(HANDLE& hPipe, const CString& strSql);
+	void CollectFailed(const AlarmSqlUnit& Unit, BOOL bCountRetry, const vector<AlarmWriteItem>& vecItem, const vector<SmsRecordItem>& vecSms,
+		vector<AlarmWriteItem>& vecRetryItem, vector<SmsRecordItem>& vecRetrySms);
+	void Requeue(vector<AlarmWriteItem>& vecRetryItem, vector<SmsRecordItem>& vecRetrySms);
+	void AddToIndex(int nPos);
+public:
+	vector<AlarmWriteItem> m_vecPending;		//按到达顺序缓存
+	AlarmWriteIndex m_PendingIndex;				//去重键 -> m_vecPending下标
+	vector<SmsRecordItem> m_vecSmsPending;		//待入库短信记录，与告警共用m_csPending
+	CRITICAL_SECTION m_csPending;
+	CRITICAL_SECTION m_csFlush;
+	HANDLE m_FlushEvent,m_hExitEvent;
+	int m_nMaxBatchBytes;
+	int m_nMaxDelay;
+	int m_nMaxRows;
+	//统计
+	__int64 m_nTotalAlarms;
+	__int64 m_nTotalMerged;
+	__int64 m_nTotalRoundTrips;
+	__int64 m_nTotalSms;
+	__int64 m_nTotalFailed;		//执行失败的语句数
+	__int64 m_nTotalDropped;	//重试超限或排队溢出丢弃的告警和短信条数
+
+protected:
+	DECLARE_MESSAGE_MAP()
+};
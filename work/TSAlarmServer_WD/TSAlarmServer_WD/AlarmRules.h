@@ -0,0 +1,186 @@
+#pragma once
+#include <vector>
+
+//每台设备的规则命中标志
+#define ALARMRULE_HASVALUE			0x01	//有当日账单
+#define ALARMRULE_RUSH				0x02	//能耗突增
+#define ALARMRULE_CONTRACTEND		0x04	//合同到期还挂表
+#define ALARMRULE_BRAND_LOW			0x08	//电表挂品牌用电少
+#define ALARMRULE_BUSSINESS_HIGH	0x10	//电表挂商管下用电多
+
+// CAlarmRules
+// ProcessData的用电规则判断：按设备下标对齐的列数据，一次遍历算出各品牌用电量合计，
+// 再逐条规则整列判断。只用到基本类型，不依赖MFC和数据库，可单独测试。
+//
+// 用法：
+//	rules.Resize(nDevCount);
+//	rules.SetDevice(i, iBrandId, Occupied, nContractEnd);
+//	rules.SetDayValue(i, DayValue, last7Value);		//有当日账单的设备
+//	rules.Evaluate(nCurrDate);
+//	rules.m_vecAlarmFlag[i] & ALARMRULE_xxx
+
+class CAlarmRules
+{
+public:
+	CAlarmRules()
+	{
+		m_nMinValue = 0;
+		m_nMaxValue = 0;
+		m_fMagnifyNum = 0;
+		m_fRushMinValue = 1;
+	}
+
+	//清空列数据，设备数改为nDevCount
+	void Resize(int nDevCount)
+	{
+		m_vecBrandId.assign(nDevCount, 0);
+		m_vecOccupied.assign(nDevCount, 0);
+		m_vecContractEnd.assign(nDevCount, 0);
+		m_vecDayValue.assign(nDevCount, 0.0f);
+		m_vecLast7Value.assign(nDevCount, 0.0f);
+		m_vecBrandConsume.assign(nDevCount, 0.0f);
+		m_vecAlarmFlag.assign(nDevCount, 0);
+	}
+
+	int GetCount() const
+	{
+		return (int)m_vecAlarmFlag.size();
+	}
+
+	//nContractEnd为合同到期日yyyymmdd，不判断合同到期的设备(未挂品牌、无合同或无到期日)给0
+	void SetDevice(int i, int iBrandId, int nOccupied, int nContractEnd)
+	{
+		m_vecBrandId[i] = iBrandId;
+		m_vecOccupied[i] = nOccupied;
+		m_vecContractEnd[i] = nContractEnd;
+	}
+
+	void SetDayValue(int i, float fDayValue, float fLast7Value)
+	{
+		m_vecDayValue[i] = fDayValue;
+		m_vecLast7Value[i] = fLast7Value;
+		m_vecAlarmFlag[i] |= ALARMRULE_HASVALUE;
+	}
+
+	//nCurrDate为当天日期yyyymmdd；返回命中任一告警规则的设备数
+	int Evaluate(int nCurrDate)
+	{
+		int nDevCount = GetCount();
+		SumBrandConsume();
+		int i = 0;
+
+		//能耗突变异常判断
+		for (i=0; i<nDevCount; i++)
+		{
+			if ((m_vecAlarmFlag[i]&ALARMRULE_HASVALUE)&&m_vecOccupied[i]==0
+				&&m_vecDayValue[i]>=m_fRushMinValue&&m_vecDayValue[i]>m_vecLast7Value[i]*m_fMagnifyNum)
+			{
+				m_vecAlarmFlag[i] |= ALARMRULE_RUSH;
+			}
+		}
+
+		//合同到期还挂表
+		for (i=0; i<nDevCount; i++)
+		{
+			if (m_vecContractEnd[i]!=0&&nCurrDate>m_vecContractEnd[i])
+			{
+				m_vecAlarmFlag[i] |= ALARMRULE_CONTRACTEND;
+			}
+		}
+
+		//电表挂品牌用电少
+		for (i=0; i<nDevCount; i++)
+		{
+			if (m_vecBrandId[i]!=0&&(m_vecAlarmFlag[i]&ALARMRULE_HASVALUE)&&m_vecBrandConsume[i]<m_nMinValue)
+			{
+				m_vecAlarmFlag[i] |= ALARMRULE_BRAND_LOW;
+			}
+		}
+
+		//电表挂商管下用电多 只诊断商管下未占用的备用电表
+		for (i=0; i<nDevCount; i++)
+		{
+			if ((m_vecAlarmFlag[i]&ALARMRULE_HASVALUE)&&m_vecOccupied[i]==0&&m_vecDayValue[i]>m_nMaxValue)
+			{
+				m_vecAlarmFlag[i] |= ALARMRULE_BUSSINESS_HIGH;
+			}
+		}
+
+		int nAlarmDev = 0;
+		for (i=0; i<nDevCount; i++)
+		{
+			if (m_vecAlarmFlag[i]&~ALARMRULE_HASVALUE)
+			{
+				nAlarmDev++;
+			}
+		}
+		return nAlarmDev;
+	}
+
+	//规则阈值
+	int m_nMinValue;			//品牌用电量下限
+	int m_nMaxValue;			//备用电表用电量上限
+	float m_fMagnifyNum;		//突增倍数
+	float m_fRushMinValue;		//突增判断的最小用电量
+
+	//按设备下标对齐的列数据
+	std::vector<int> m_vecBrandId;
+	std::vector<int> m_vecOccupied;
+	std::vector<int> m_vecContractEnd;
+	std::vector<float> m_vecDayValue;
+	std::vector<float> m_vecLast7Value;
+	std::vector<float> m_vecBrandConsume;	//Evaluate算出的所属品牌用电量合计
+	std::vector<BYTE> m_vecAlarmFlag;
+
+protected:
+	//品牌用电量合计，只遍历一次设备：开放寻址表给每个品牌分配一个合计槽位，
+	//设备记下槽位号，累加后按槽位号回填，不再每台设备查两次CMap
+	void SumBrandConsume()
+	{
+		int nDevCount = GetCount();
+		DWORD nTableSize = 16;
+		while (nTableSize < (DWORD)nDevCount*2)
+		{
+			nTableSize <<= 1;
+		}
+		DWORD nMask = nTableSize - 1;
+		m_vecBrandKey.assign(nTableSize, 0);
+		m_vecBrandSlot.assign(nTableSize, -1);
+		m_vecBrandSum.clear();
+		m_vecDevSlot.assign(nDevCount, -1);
+		int i = 0;
+		for (i=0; i<nDevCount; i++)
+		{
+			int iBrandId = m_vecBrandId[i];
+			if (iBrandId == 0)
+			{
+				continue;
+			}
+			DWORD nPos = ((DWORD)iBrandId*2654435761u) & nMask;
+			while (m_vecBrandSlot[nPos] >= 0 && m_vecBrandKey[nPos] != iBrandId)
+			{
+				nPos = (nPos + 1) & nMask;
+			}
+			if (m_vecBrandSlot[nPos] < 0)
+			{
+				m_vecBrandKey[nPos] = iBrandId;
+				m_vecBrandSlot[nPos] = (int)m_vecBrandSum.size();
+				m_vecBrandSum.push_back(0.0f);
+			}
+			m_vecDevSlot[i] = m_vecBrandSlot[nPos];
+			if (m_vecAlarmFlag[i]&ALARMRULE_HASVALUE)
+			{
+				m_vecBrandSum[m_vecDevSlot[i]] += m_vecDayValue[i];
+			}
+		}
+		for (i=0; i<nDevCount; i++)
+		{
+			m_vecBrandConsume[i] = m_vecDevSlot[i] >= 0 ? m_vecBrandSum[m_vecDevSlot[i]] : 0.0f;
+		}
+	}
+
+	std::vector<int> m_vecBrandKey;
+	std::vector<int> m_vecBrandSlot;
+	std::vector<float> m_vecBrandSum;
+	std::vector<int> m_vecDevSlot;
+};
@@ -1,9 +1,10 @@
-// AlarmTask.cpp : ʵļ
+// AlarmTask.cpp : 实现文件
 //
 
 #include "stdafx.h"
 #include "TSAlarmServer_WD.h"
 #include "AlarmTask.h"
+#include "TSAlarmServer_WDDlg.h"
 
 
 // CAlarmTask
@@ -21,23 +22,44 @@ CAlarmTask::CAlarmTask()
 	m_iReduceNum = 0;
 	m_iMagnifyNum = 0;
 	m_iValidDays = 30;
+	m_fRushMinValue = 1;
+	m_nDiagHour = 5;
+	m_nDiagMinute = 0;
+	m_nDiagWindow = DIAG_DEFAULT_WINDOW;
+	m_nDiagWorkerNum = DIAG_DEFAULT_WORKERS;
+	m_nBillShardNum = DIAG_DEFAULT_BILL_SHARDS;
+	m_bBillSetQuery = TRUE;
+	memset(&m_DiagTime,0,sizeof(SYSTEMTIME));
+	m_pDeviceInfoMap = new DeviceInfoMap;
+	InitializeCriticalSection(&m_csDeviceInfo);
 }
 
 CAlarmTask::~CAlarmTask()
 {
+	delete m_pDeviceInfoMap;
+	m_pDeviceInfoMap = NULL;
+	DeleteCriticalSection(&m_csDeviceInfo);
 	
 }
 
+//设备信息查询，未加载或不存在时返回FALSE，iDeviceInfo保持不变
+BOOL CAlarmTask::GetDeviceInfo(int iDevId,DeviceInfoData &iDeviceInfo)
+{
+	EnterCriticalSection(&m_csDeviceInfo);
+	BOOL bFind = m_pDeviceInfoMap->Lookup(iDevId,iDeviceInfo);
+	LeaveCriticalSection(&m_csDeviceInfo);
+	return bFind;
+}
+
+//重新加载设备信息：先在局部表中建好，全部读取成功后再替换，失败时保留原表
 BOOL CAlarmTask::InitDevInfo()
 {
-	m_vecDeviceInfo.clear();
-	m_DeviceInfoMap.RemoveAll();
-	m_BrandDevMap.RemoveAll();
-	int iFdCount = 13;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	vector<DeviceInfoData> vecDeviceInfo;
+	DeviceInfoMap* pDeviceInfoMap = new DeviceInfoMap;
+	int iFdCount = 13;	//	查询的字段数
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -45,6 +67,7 @@ BOOL CAlarmTask::InitDevInfo()
 	if (hPipe == NULL) 
 	{
 		MYERROR(_T("InitDevInfo hPipe null"));
+		delete pDeviceInfoMap;
 		return FALSE;
 	}
 
@@ -55,195 +78,79 @@ BOOL CAlarmTask::InitDevInfo()
 		strQuery.Format(C_SQL_QUERY_DEVINFO,tempId);
 		pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-		if (NULL == pRead)	// δѯ¼
+		if (NULL == pRead)	// 未查询到记录
 		{
 			CloseHandle(hPipe);
 			MYERROR(_T("InitDevInfo pRead null"));
+			delete pDeviceInfoMap;
 			return FALSE;
 		}
-		// صĽ
-		NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
-		if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-			//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			MYERROR(_T("InitDevInfo pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB null"));
-			return FALSE;
-		}	
-
-		if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
-		{
-			//MYWARN(_T("յջظģ޷ѯ"));
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			MYERROR(_T("InitDevInfo pNetMessageHead->Length < 1 null"));
-			return FALSE;
-		}
-
-		// ȡѯֶ
-		WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
-		int nFieldNum = (int)*pWord;
-		if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+		// 解析返回的结果，直接在接收缓冲区上按字段偏移读取
+		CRecordSetReader rs;
+		if (!rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), iFdCount))
 		{
-			//	MYWARN(_T("ѯֶȣѯ쳣˳"));
 			delete[] pRead;
 			pRead = NULL;
 			CloseHandle(hPipe);
-			MYERROR(_T("InitDevInfo nFieldNum != iFdCount null"));
+			MYERROR(_T("InitDevInfo 返回记录集异常"));
+			delete pDeviceInfoMap;
 			return FALSE;
 		}
-		pWord++;
+		DWORD dwRecordNum = (DWORD)rs.GetRecordNum();
 
-		// ¼
-		MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
-		BYTE *pByte = (BYTE*)&pHead[nFieldNum];
-		DWORD dwRecordLen = *((DWORD*)pByte);
-		if (dwRecordLen < 1)
-		{
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return FALSE;
-		}
-		pByte += sizeof(DWORD);
-
-		// ¼
-		DWORD dwRecordNum = *((int*)pByte);
-		if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
-		{
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return FALSE;
-		}
-		pByte += sizeof(DWORD);
-
-		TCHAR *tValue = new TCHAR[1024+1];
-		if (tValue == NULL)
-		{
-			//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
-			MYERROR(_T("InitDevInfo tValue == NULL"));
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return FALSE;
-		}
-
-		// ѯд뵽
-		LZGRECORDSET rs;
-		for (int i=0;i<(int)dwRecordNum;i++)
+		// 将查询结果写入到缓存
+		while (rs.NextRecord())
 		{
 			DeviceInfoData iDeviceInfo;
-			memset(&iDeviceInfo,0,sizeof(DeviceInfo));
-
-			// iDevId
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, pHead->DataLen);
-			iDeviceInfo.iDevId = (int)*((DWORD *)tValue);
-			pByte += pHead->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+1)->DataLen);
-			memcpy(iDeviceInfo.DevName, tValue, sizeof(TCHAR)*65);
-			pByte += (pHead+1)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+2)->DataLen);
-			iDeviceInfo.iStationId = (int)*((DWORD *)tValue);
-			pByte += (pHead+2)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+3)->DataLen);
-			iDeviceInfo.iPlazaId = (int)*(DWORD*)tValue;
-			pByte += (pHead+3)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+4)->DataLen);
-			memcpy(iDeviceInfo.PlazaName, tValue, sizeof(TCHAR)*128);
-			pByte += (pHead+4)->DataLen;
-
-			rs.clear();
-			memcpy(rs.buf,pByte, (pHead+5)->DataLen);
-			iDeviceInfo.Occupied = rs.iRs;
-			pByte += (pHead+5)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+6)->DataLen);
-			iDeviceInfo.iBrandId = (int)*(DWORD*)tValue;
-			pByte += (pHead+6)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+7)->DataLen);
-			CString csBrand = _T("");
-			/*memcpy(csBrand.GetBuffer(), tValue, (pHead+7)->DataLen);
-			csBrand.ReleaseBuffer();*/
-			csBrand.Format(_T("%s"),tValue);
-			csBrand.Replace(_T("'"),_T("\""));
-			memcpy(iDeviceInfo.BrandName, csBrand.GetBuffer(), sizeof(TCHAR)*128);
-			pByte += (pHead+7)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+8)->DataLen);
-			memcpy(iDeviceInfo.BrandCode, tValue, sizeof(TCHAR)*128);
-			pByte += (pHead+8)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+9)->DataLen);
-			iDeviceInfo.iContractId = (int)*(DWORD*)tValue;
-			pByte += (pHead+9)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+10)->DataLen);
-			iDeviceInfo.iContractType = (int)*(DWORD*)tValue;
-			pByte += (pHead+10)->DataLen;
-
-			rs.clear();
-			memcpy(rs.buf,pByte, (pHead+11)->DataLen);
-			iDeviceInfo.startTime = rs.timeRs;
-			pByte += (pHead+11)->DataLen;
-
-			rs.clear();
-			memcpy(rs.buf,pByte, (pHead+12)->DataLen);
-			iDeviceInfo.endTime = rs.timeRs;
-			pByte += (pHead+12)->DataLen;
+			memset(&iDeviceInfo,0,sizeof(DeviceInfoData));
+
+			iDeviceInfo.iDevId = rs.GetInt(0);
+			rs.GetString(1, iDeviceInfo.DevName, 65);
+			iDeviceInfo.iStationId = rs.GetInt(2);
+			iDeviceInfo.iPlazaId = rs.GetInt(3);
+			rs.GetString(4, iDeviceInfo.PlazaName, 128);
+			iDeviceInfo.Occupied = rs.GetInt(5);
+			iDeviceInfo.iBrandId = rs.GetInt(6);
+			rs.GetString(7, iDeviceInfo.BrandName, 128);
+			for (TCHAR *p = iDeviceInfo.BrandName; *p; p++)
+			{
+				if (*p == _T('\''))
+				{
+					*p = _T('"');
+				}
+			}
+			rs.GetString(8, iDeviceInfo.BrandCode, 128);
+			iDeviceInfo.iContractId = rs.GetInt(9);
+			iDeviceInfo.iContractType = rs.GetInt(10);
+			rs.GetValue(11, iDeviceInfo.startTime);
+			rs.GetValue(12, iDeviceInfo.endTime);
 
 			if (iDeviceInfo.iDevId>tempId)
 			{
 				tempId = iDeviceInfo.iDevId;
 			}
 			//m_DeviceInfoMap.SetAt(iDeviceInfo.iDevId,iDeviceInfo);
-			m_vecDeviceInfo.push_back(iDeviceInfo);
-			m_DeviceInfoMap.SetAt(iDeviceInfo.iDevId,iDeviceInfo);
-			if (iDeviceInfo.iBrandId!=0)
-			{
-				vector<int> vecDev;
-				if (m_BrandDevMap.Lookup(iDeviceInfo.iBrandId,vecDev))
-				{
-					vecDev.push_back(iDeviceInfo.iDevId);
-				}
-				else
-				{
-					vecDev.push_back(iDeviceInfo.iDevId);
-				}
-				m_BrandDevMap.SetAt(iDeviceInfo.iBrandId,vecDev);
-			}
+			vecDeviceInfo.push_back(iDeviceInfo);
+			pDeviceInfoMap->SetAt(iDeviceInfo.iDevId,iDeviceInfo);
 		}
-		delete []tValue;
-		tValue = NULL;
+		delete[] pRead;
+		pRead = NULL;
 		if (dwRecordNum<5000)
 		{
 			break;
 		}
 	}
 
-	int num = m_vecDeviceInfo.capacity();
-
-	delete[] pRead;
-	pRead = NULL;
 	CloseHandle(hPipe);
 
+	//m_vecDeviceInfo只在依赖DIAGTASK_DEVINFO的诊断任务中使用，m_pDeviceInfoMap告警接收线程随时查询
+	EnterCriticalSection(&m_csDeviceInfo);
+	m_vecDeviceInfo.swap(vecDeviceInfo);
+	DeviceInfoMap* pOldMap = m_pDeviceInfoMap;
+	m_pDeviceInfoMap = pDeviceInfoMap;
+	LeaveCriticalSection(&m_csDeviceInfo);
+	delete pOldMap;
+
 	return TRUE;
 }
 
@@ -255,7 +162,7 @@ BOOL CAlarmTask::LoadStationTable()
 	NetMessageHead* pNetMessageHead = NULL;
 	MessageQueryRecord mqr;
 
-	//ȡվϢ
+	//读取厂站信息表
 	mqr.BaseNo = BASE_NO_RTDB;
 	mqr.TableNo = TABLE_NO_STATION;
 	mqr.FilterFieldNo = 0;
@@ -346,7 +253,7 @@ BOOL CAlarmTask::LoadStationTable()
 		nNum--;
 	}
 
-	//
+	//清理
 	if(hPipe != NULL)			{CloseHandle(hPipe); hPipe = NULL;}
 	if(pNetMessageHead != NULL){delete [](BYTE *)pNetMessageHead; pNetMessageHead=NULL;}
 
@@ -355,7 +262,7 @@ BOOL CAlarmTask::LoadStationTable()
 
 BOOL CAlarmTask::InitInstance()
 {
-	// TODO: ڴִ̳߳ʼ
+	// TODO: 在此执行任意逐线程初始化
 	InitCfgInfo();
 	
 	if (!LoadSMSTemplate())
@@ -368,73 +275,166 @@ BOOL CAlarmTask::InitInstance()
 		ReguTrace(Config,"LoadSMSConfig err!");
 		return FALSE;
 	}
-	BOOL beDone = FALSE;
+	int nLastDiagDate = 0;
+	int nLastBackupDate = 0;
+	int nDiagStart = m_nDiagHour*3600 + m_nDiagMinute*60;
 	while(1)
 	{
 		SYSTEMTIME sys_time;
 		GetLocalTime(&sys_time);
-		if (sys_time.wHour>=5&&sys_time.wHour<=6&&beDone==FALSE)
-		{			
-			SYSLOG(LOG_DEBUG,L"׼ʼ豸Ϣ");
-			ReguTrace(Config,"׼ʼ豸Ϣ");
-			if (!InitDevInfo())
-			{
-				ReguTrace(Config,"InitDevInfo err!");
-				return FALSE;
-			}
-			GetNoDevContract();
-			//豸ǷѸ澯
-			ReguTrace(Config,"ʼҵ澯");
-			if(!GetOverDraft())
-			{
-				ReguTrace(Config,"豸ǷѸ澯ʧܣ");
-			}
-			m_DevSampleCfgArray.RemoveAll();
-			//ȡղ
-			GetSampleDayConfig();
-			//쳣澯
-			CheckBillAlarm();
-			m_DevSampleCfgArray.RemoveAll();
+		int nToday = sys_time.wYear*10000 + sys_time.wMonth*100 + sys_time.wDay;
+		int nNowSec = sys_time.wHour*3600 + sys_time.wMinute*60 + sys_time.wSecond;
+
+		//零点备份告警数据
+		if (nLastBackupDate!=nToday&&nNowSec<DIAG_BACKUP_WINDOW*60)
+		{
+			nLastBackupDate = nToday;
+			BackupData();  //备份告警数据
+		}
+		//每天诊断一次，程序在触发时间之后的窗口内启动时补做当天的诊断
+		if (nLastDiagDate!=nToday&&nNowSec>=nDiagStart&&nNowSec<nDiagStart+m_nDiagWindow*60)
+		{
+			nLastDiagDate = nToday;
+			RunDailyDiagnosis(sys_time);
+		}
+
+		//睡到下一个触发时间，最长1分钟，避免系统校时后错过触发
+		GetLocalTime(&sys_time);
+		nNowSec = sys_time.wHour*3600 + sys_time.wMinute*60 + sys_time.wSecond;
+		int nWaitSec = (86400 - nNowSec) % 86400;
+		int nDiagWait = (nDiagStart - nNowSec + 86400) % 86400;
+		if (nDiagWait > 0 && nDiagWait < nWaitSec)
+		{
+			nWaitSec = nDiagWait;
+		}
+		DWORD dwWait = (nWaitSec > 0) ? nWaitSec*1000 - sys_time.wMilliseconds : 1000;
+		if (dwWait > 60000)
+		{
+			dwWait = 60000;
+		}
+		Sleep(dwWait);
+	}
+	return TRUE;
+}
+
+//每日业务告警诊断：各加载/诊断步骤按依赖关系登记到m_DiagScheduler，由m_nDiagWorkerNum个工作线程并发执行
+void CAlarmTask::RunDailyDiagnosis(const SYSTEMTIME &sys_time)
+{
+	SYSLOG(LOG_DEBUG,L"准备初始化设备信息");
+	ReguTrace(Config,"开始诊断业务告警！");
+	DWORD dwBegin = GetTickCount();
+	m_DiagTime = sys_time;
+
+	m_DiagScheduler.Reset();
+	m_DiagScheduler.AddTask(DIAGTASK_DEVINFO,0,0);
+	m_DiagScheduler.AddTask(DIAGTASK_NODEVCONTRACT,0,0);
+	m_DiagScheduler.AddTask(DIAGTASK_SAMPLEDAYCONFIG,0,0);
+	m_DiagScheduler.AddTask(DIAGTASK_DAYVALUE,0,0);
+	m_DiagScheduler.AddTask(DIAGTASK_STATION,0,0);
+	m_DiagScheduler.AddTask(DIAGTASK_OVERDRAFT,0,DIAGTASK_BIT(DIAGTASK_DEVINFO));
+	m_DiagScheduler.AddTask(DIAGTASK_PROCESSDATA,0,DIAGTASK_BIT(DIAGTASK_DEVINFO)|DIAGTASK_BIT(DIAGTASK_DAYVALUE));
+	//账龄诊断按采样表(逐台查询时按设备)分片并发
+	for (int i=0;i<m_nBillShardNum;i++)
+	{
+		m_DiagScheduler.AddTask(DIAGTASK_BILLALARM,i,DIAGTASK_BIT(DIAGTASK_DEVINFO)|DIAGTASK_BIT(DIAGTASK_SAMPLEDAYCONFIG));
+	}
+	m_DiagScheduler.Run(m_nDiagWorkerNum,DiagTaskProc,this);
+	for (int i=0;i<m_DiagScheduler.GetTaskNum();i++)
+	{
+		const DiagTask &iTask = m_DiagScheduler.GetTask(i);
+		if (iTask.nState==DIAGSTATE_SKIPPED)
+		{
+			ReguTrace(ERRO,"诊断任务%s[%d]因依赖失败跳过",GetDiagTaskName(iTask.nTaskId),iTask.nShard);
+		}
+	}
+	m_DevSampleCfgArray.RemoveAll();
+
+	//告警状态按入库后的CONTENTTIME更新，先把缓存的告警写完
+	CTSAlarmServer_WDDlg* pDlg = (CTSAlarmServer_WDDlg*)AfxGetApp()->m_pMainWnd;
+	pDlg->m_pAlarmBatchWriter->Flush();
+	UpdateAlarmStatus();
+	ReguTrace(Config,"业务告警诊断结束！总耗时%dms",GetTickCount()-dwBegin);
+}
+
+//诊断工作线程执行一个任务
+BOOL CAlarmTask::DiagTaskProc(LPVOID pParam,int nTaskId,int nShard)
+{
+	CAlarmTask *pTask = (CAlarmTask*)pParam;
+	DWORD dwBegin = GetTickCount();
+	BOOL bResult = pTask->RunDiagTask(nTaskId,nShard);
+	DWORD dwSpan = GetTickCount() - dwBegin;
+	ReguTrace(Config,"诊断任务%s[%d]%s,耗时%dms",GetDiagTaskName(nTaskId),nShard,bResult?_T("完成"):_T("失败"),dwSpan);
+	return bResult;
+}
+
+BOOL CAlarmTask::RunDiagTask(int nTaskId,int nShard)
+{
+	switch (nTaskId)
+	{
+	case DIAGTASK_DEVINFO:
+		return InitDevInfo();
+	case DIAGTASK_NODEVCONTRACT:
+		return GetNoDevContract();
+	case DIAGTASK_SAMPLEDAYCONFIG:
+		//读取日采样配置
+		m_DevSampleCfgArray.RemoveAll();
+		return GetSampleDayConfig();
+	case DIAGTASK_DAYVALUE:
+		{
 			CString strTime = _T("");
 			CString strlastTime = _T("");
-			CTime ttCurTime = CTime(sys_time.wYear,sys_time.wMonth,sys_time.wDay,0,0,0);
+			CTime ttCurTime = CTime(m_DiagTime.wYear,m_DiagTime.wMonth,m_DiagTime.wDay,0,0,0);
 			CTime ttLastTime = ttCurTime - CTimeSpan(1,0,0,0);
 			CTime ttLastLastTime = ttCurTime - CTimeSpan(2,0,0,0);
 			strTime.Format(_T("%04d-%02d-%02d 00:00:00"),ttLastTime.GetYear(),
 				ttLastTime.GetMonth(),ttLastTime.GetDay());
 			strlastTime.Format(_T("%04d-%02d-%02d 00:00:00"),ttLastLastTime.GetYear(),
 				ttLastLastTime.GetMonth(),ttLastLastTime.GetDay());
-			
+
 			m_DevDayValueMap.RemoveAll();
 			LoadDayValue(strTime,SUMCOUNT);
 			LoadDayValue(strlastTime,MEANELEC);
 			int num = m_DevDayValueMap.GetCount();
-			ReguTrace(Config,"ȡ˵ݽNUM=%d!",num);
-			ProcessData();
-			beDone = TRUE;
-			
-			
-			//GetNoDevContract();
-			
-			LoadStationTable();
-			CheckDevStateByStationId();
-			ReguTrace(Config,"ҵ澯Ͻ");
-			//if (sys_time.wDayOfWeek==2)  //кͬޱ쳣
-			//{
-			//	
-			//}
-			UpdateAlarmStatus();
+			ReguTrace(Config,"读取账单数据结束NUM=%d!",num);
+			return TRUE;
 		}
-		
-		if (sys_time.wHour==0&&sys_time.wMinute==0)
+	case DIAGTASK_STATION:
+		m_StationArray.RemoveAll();
+		if (!LoadStationTable())
 		{
-			beDone = FALSE;
-			BackupData();  //ݸ澯
+			return FALSE;
 		}
-		Sleep(20000);
-		
+		CheckDevStateByStationId();
+		return TRUE;
+	case DIAGTASK_OVERDRAFT:
+		//诊断设备欠费告警
+		return GetOverDraft();
+	case DIAGTASK_PROCESSDATA:
+		ProcessData();
+		return TRUE;
+	case DIAGTASK_BILLALARM:
+		//诊断账龄异常告警
+		CheckBillAlarm(nShard,m_nBillShardNum);
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+LPCTSTR CAlarmTask::GetDiagTaskName(int nTaskId)
+{
+	switch (nTaskId)
+	{
+	case DIAGTASK_DEVINFO:			return _T("InitDevInfo");
+	case DIAGTASK_NODEVCONTRACT:	return _T("GetNoDevContract");
+	case DIAGTASK_SAMPLEDAYCONFIG:	return _T("GetSampleDayConfig");
+	case DIAGTASK_DAYVALUE:			return _T("LoadDayValue");
+	case DIAGTASK_STATION:			return _T("CheckDevStateByStationId");
+	case DIAGTASK_OVERDRAFT:		return _T("GetOverDraft");
+	case DIAGTASK_PROCESSDATA:		return _T("ProcessData");
+	case DIAGTASK_BILLALARM:		return _T("CheckBillAlarm");
+	default:						return _T("Unknow");
 	}
-	return TRUE;
 }
 
 void CAlarmTask::CheckDevStateByStationId()
@@ -450,22 +450,22 @@ void CAlarmTask::CheckDevStateByStationId()
 	}
 	for (int i=0;i<m_StationArray.GetSize();i++)
 	{
-		int iFdCount = 2;	     //	ѯֶ
-		int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+		int iFdCount = 2;	     //	查询的字段数
+		int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 		CString strQuery  = _T("");
 		strQuery.Format(_T("select ID from TB_DI where STATIONNUM=%d and NUM=0 and YXVALUE=1;"),m_StationArray[i]);
 		pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-		if (NULL == pRead)	// δѯ¼
+		if (NULL == pRead)	// 未查询到记录
 		{
 			CloseHandle(hPipe);
 			MYERROR(_T("CheckDevStateByStationId pRead null"));
 			return ;
 		}
-		// صĽ
+		// 解析返回的结果
 		NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 		if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-			//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+			//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 			delete[] pRead;
 			pRead = NULL;
 			CloseHandle(hPipe);
@@ -473,9 +473,9 @@ void CAlarmTask::CheckDevStateByStationId()
 			return ;
 		}	
 
-		if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+		if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 		{
-			//MYWARN(_T("յջظģ޷ѯ"));
+			//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 			delete[] pRead;
 			pRead = NULL;
 			CloseHandle(hPipe);
@@ -483,12 +483,12 @@ void CAlarmTask::CheckDevStateByStationId()
 			return ;
 		}
 
-		// ȡѯֶ
+		// 获取查询的字段数
 		WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 		int nFieldNum = (int)*pWord;
-		if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+		if (nFieldNum != iFdCount)	// 查询字段数量，不相等，曾查询结果异常退出
 		{
-			//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+			//	MYWARN(_T("查询字段数量，不相等，曾查询结果异常退出"));
 			delete[] pRead;
 			pRead = NULL;
 			CloseHandle(hPipe);
@@ -497,7 +497,7 @@ void CAlarmTask::CheckDevStateByStationId()
 		}
 		pWord++;
 
-		// ¼
+		// 记录集长度
 		MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 		BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 		DWORD dwRecordLen = *((DWORD*)pByte);
@@ -510,7 +510,7 @@ void CAlarmTask::CheckDevStateByStationId()
 		}
 		pByte += sizeof(DWORD);
 
-		// ¼
+		// 记录数
 		DWORD dwRecordNum = *((int*)pByte);
 		if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 		{
@@ -524,7 +524,7 @@ void CAlarmTask::CheckDevStateByStationId()
 		{
 			continue;
 		}
-		//Ƿѳ15澯
+		//欠费超过15天产生告警
 		AlarmItemDef ALARMDef;
 		memset(&ALARMDef, 0, sizeof(AlarmItemDef));
 		CreateUuid(ALARMDef.alarmID);
@@ -533,7 +533,7 @@ void CAlarmTask::CheckDevStateByStationId()
 		ALARMDef.alarmObjID = m_StationArray[i];
 		ALARMDef.devID = 0;
 		ALARMDef.stationID = m_StationArray[i];
-		memcpy(ALARMDef.alarmTypeName,_T("쳣"),sizeof(ALARMDef.alarmTypeName));
+		memcpy(ALARMDef.alarmTypeName,_T("集中器数据异常"),sizeof(ALARMDef.alarmTypeName));
 		//memcpy(ALARMDef.alarmObjName,iDeviceInfo.DevName,sizeof(ALARMDef.alarmObjName));
 
 		ALARMDef.alarmObjType = 33; 
@@ -544,18 +544,18 @@ void CAlarmTask::CheckDevStateByStationId()
 
 		ALARMDef.status = 0;
 
-		ALARMDef.projectID = 1;    //̺
-		ALARMDef.systemID = 1;    //ϵͳ
-		ALARMDef.rtAlarm = 0;    //¼ʵʱ澯
+		ALARMDef.projectID = 1;    //工程号
+		ALARMDef.systemID = 1;    //子系统号
+		ALARMDef.rtAlarm = 0;    //不记录实时告警
 		memset(ALARMDef.stationName, 0, sizeof(ALARMDef.stationName));
 		memset(ALARMDef.projectName, 0, sizeof(ALARMDef.projectName));
 		//memset(ALARMDef.alarmSource, 0, sizeof(ALARMDef.alarmSource));
 		//_tcsncpy_s(ALARMDef.alarmSource, _countof(ALARMDef.alarmSource), C_ALARMRESORCE, C_ALARMRESORCE.GetLength());
-		memcpy(ALARMDef.alarmSource,_T("Ӧ÷澯"),sizeof(ALARMDef.alarmSource));
+		memcpy(ALARMDef.alarmSource,_T("应用服务告警"),sizeof(ALARMDef.alarmSource));
 		ALARMDef.groupID1 = 1;
 		ALARMDef.groupID2 = 2;
 		CString strAlarmContent = _T("");
-		strAlarmContent.Format(_T("ID=%d豸ͨѶжϣȷ!"),
+		strAlarmContent.Format(_T("集中器ID=%d下所有设备通讯中断，请确认!"),
 			m_StationArray[i]);
 		memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
 		AddAlarm2DB(ALARMDef);	
@@ -599,6 +599,38 @@ BOOL CAlarmTask::InitCfgInfo()
 		m_MaxValue = 5;
 	}
 	
+	//能耗突增只诊断日用电量不小于该值的设备
+	TCHAR chRushMin[64]={0};
+	GetPrivateProfileString(_T("UPRUSHCONFIG"),_T("MinValue"),_T("1"),chRushMin,64,strCountPath);
+	m_fRushMinValue = (float)_wtof(chRushMin);
+
+	//每日诊断时间(时:分)、补做窗口(分钟)、工作线程数、账龄诊断分片数
+	TCHAR chDiagTime[64]={0};
+	GetPrivateProfileString(_T("ALARMWD"),_T("DiagTime"),_T("05:00"),chDiagTime,64,strCountPath);
+	int nDiagHour = 5, nDiagMinute = 0;
+	if (_stscanf_s(chDiagTime,_T("%d:%d"),&nDiagHour,&nDiagMinute)==2&&nDiagHour>=0&&nDiagHour<24&&nDiagMinute>=0&&nDiagMinute<60)
+	{
+		m_nDiagHour = nDiagHour;
+		m_nDiagMinute = nDiagMinute;
+	}
+	m_nDiagWindow = GetPrivateProfileInt(_T("ALARMWD"),_T("DiagWindow"),DIAG_DEFAULT_WINDOW,strCountPath);
+	if (m_nDiagWindow <= 0)
+	{
+		m_nDiagWindow = DIAG_DEFAULT_WINDOW;
+	}
+	m_nDiagWorkerNum = GetPrivateProfileInt(_T("ALARMWD"),_T("DiagWorkers"),DIAG_DEFAULT_WORKERS,strCountPath);
+	if (m_nDiagWorkerNum <= 0 || m_nDiagWorkerNum > DIAG_MAX_WORKERS)
+	{
+		m_nDiagWorkerNum = DIAG_DEFAULT_WORKERS;
+	}
+	m_nBillShardNum = GetPrivateProfileInt(_T("ALARMWD"),_T("BillShards"),DIAG_DEFAULT_BILL_SHARDS,strCountPath);
+	if (m_nBillShardNum <= 0 || m_nBillShardNum > DIAG_MAX_TASKS - DIAGTASK_BILLALARM)
+	{
+		m_nBillShardNum = DIAG_DEFAULT_BILL_SHARDS;
+	}
+	//账龄诊断方式：1-按采样表批量查询 0-逐台设备查询
+	m_bBillSetQuery = (GetPrivateProfileInt(_T("ALARMWD"),_T("BillSetQuery"),1,strCountPath) != 0);
+
 	TCHAR chNumcfg[64]={0};
 	GetPrivateProfileString(_T("UPRUSHCONFIG"),_T("MagnifyNum"),_T("1,0.2"),chNumcfg,64,strCountPath);
 	CString csNumcfg = chNumcfg;
@@ -631,145 +663,229 @@ void CAlarmTask::CreateUuid(TCHAR* csID)
 	RpcStringFree((RPC_WSTR*)&pszUuid);
 }
 
-void CAlarmTask::CheckBillAlarm()
+//账龄诊断。按表查询模式下处理m_vecBillTable中下标模nShardNum为nShard的采样表，
+//否则按原方式逐台设备查询，处理m_DevSampleCfgArray中下标模nShardNum为nShard的设备
+void CAlarmTask::CheckBillAlarm(int nShard,int nShardNum)
 {
-	BYTE* pRead = NULL;
-
+	if (!m_bBillSetQuery)
+	{
+		CheckBillAlarmByDevice(nShard,nShardNum);
+		return;
+	}
 	HANDLE hPipe =OpenRealDataPipe();
-
 	if (hPipe == NULL) 
 	{
 		MYERROR(_T("CheckBillAlarm hPipe null"));
 		return ;
 	}
-	for (int i = 0;i<m_DevSampleCfgArray.GetSize();i++)
+	DWORD dwBegin = GetTickCount();
+	int nTables = 0;
+	int nFailTables = 0;
+	int nDevices = 0;
+	int nAlarms = 0;
+	for (int i = nShard;i<(int)m_vecBillTable.size();i+=nShardNum)
+	{
+		const BillTableGroup &iGroup = m_vecBillTable[i];
+		nTables++;
+		nDevices += iGroup.nCount;
+		if (CheckBillTable(hPipe,iGroup,nAlarms))
+		{
+			continue;
+		}
+		//单张表失败只跳过该表，重新打开管道后继续诊断其余表
+		nFailTables++;
+		ReguTrace(ERRO,"账龄诊断:采样表%s查询失败,跳过%d台设备",iGroup.TableName,iGroup.nCount);
+		CloseHandle(hPipe);
+		hPipe = OpenRealDataPipe();
+		if (hPipe == NULL)
+		{
+			MYERROR(_T("CheckBillAlarm hPipe null"));
+			break;
+		}
+	}
+	if (hPipe != NULL)
 	{
-		int iFdCount = 2;	     //	ѯֶ
-		int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
-		CString strQuery  = _T("");
-		strQuery.Format(_T("select top(15) TIMEID, %s from %s where %s>0 order by TIMEID desc;"),
-			m_DevSampleCfgArray[i].ColumnName,m_DevSampleCfgArray[i].TableName,m_DevSampleCfgArray[i].ColumnName);
-		pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
+		CloseHandle(hPipe);
+		hPipe = NULL;
+	}
+	ReguTrace(Config,"账龄诊断分片%d:采样表%d张(失败%d张),设备%d台,告警%d条,耗时%dms",
+		nShard,nTables,nFailTables,nDevices,nAlarms,GetTickCount()-dwBegin);
+}
 
-		if (NULL == pRead)	// δѯ¼
+//一张采样表的所有设备列一起取最近BILL_ALARM_DAYS个TIMEID，列数超过BILL_MAX_COLUMNS时分几条语句，
+//每条语句的应答由CBillAgeRule在内存中判断
+BOOL CAlarmTask::CheckBillTable(HANDLE hPipe,const BillTableGroup &iGroup,int &nAlarmNum)
+{
+	LPCTSTR pColumns[BILL_MAX_COLUMNS];
+	BOOL bAlarm[BILL_MAX_COLUMNS];
+	for (int nBegin=0;nBegin<iGroup.nCount;nBegin+=BILL_MAX_COLUMNS)
+	{
+		int nCols = min(iGroup.nCount-nBegin,BILL_MAX_COLUMNS);
+		for (int k=0;k<nCols;k++)
 		{
-			CloseHandle(hPipe);
-			MYERROR(_T("CheckBillAlarm pRead null"));
-			return ;
+			pColumns[k] = m_DevSampleCfgArray[m_vecBillCfgIndex[iGroup.nFirst+nBegin+k]].ColumnName;
 		}
-		// صĽ
-		NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
-		if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-			//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			MYERROR(_T("CheckBillAlarm pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB null"));
-			return ;
-		}	
+		CString strQuery = _T("");
+		CBillAgeRule::BuildQuery(strQuery,iGroup.TableName,pColumns,nCols,BILL_ALARM_DAYS);
 
-		if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+		BYTE* pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
+		if (NULL == pRead)
 		{
-			//MYWARN(_T("յջظģ޷ѯ"));
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			MYERROR(_T("CheckBillAlarm pNetMessageHead->Length < 1 null"));
-			return ;
+			MYERROR(_T("CheckBillTable pRead null"));
+			return FALSE;
 		}
-
-		// ȡѯֶ
-		WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
-		int nFieldNum = (int)*pWord;
-		if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+		CRecordSetReader rs;
+		if (!rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), nCols+1))
 		{
-			//	MYWARN(_T("ѯֶȣѯ쳣˳"));
 			delete[] pRead;
 			pRead = NULL;
-			CloseHandle(hPipe);
-			MYERROR(_T("CheckBillAlarm nFieldNum != iFdCount null"));
-			return ;
+			MYERROR(_T("CheckBillTable 返回记录集异常"));
+			return FALSE;
 		}
-		pWord++;
-
-		// ¼
-		MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
-		BYTE *pByte = (BYTE*)&pHead[nFieldNum];
-		DWORD dwRecordLen = *((DWORD*)pByte);
-		if (dwRecordLen < 1)
+		int nRecordNum = rs.GetRecordNum();
+		CBillAgeRule::Evaluate(rs,nCols,BILL_ALARM_DAYS,bAlarm);
+		delete[] pRead;
+		pRead = NULL;
+		if (nRecordNum < BILL_ALARM_DAYS)
 		{
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return;
+			//采样表不足BILL_ALARM_DAYS天，表内所有设备都不可能连续欠费
+			return TRUE;
 		}
-		pByte += sizeof(DWORD);
 
-		// ¼
-		DWORD dwRecordNum = *((int*)pByte);
-		if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
+		for (int k=0;k<nCols;k++)
 		{
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return;
+			if (bAlarm[k])
+			{
+				AddBillAlarm(m_DevSampleCfgArray[m_vecBillCfgIndex[iGroup.nFirst+nBegin+k]].iDevId);
+				nAlarmNum++;
+			}
 		}
-		pByte += sizeof(DWORD);
-		if (dwRecordNum<15)
+	}
+	return TRUE;
+}
+
+//原逐台设备查询方式，单台设备查询失败时跳过该设备
+void CAlarmTask::CheckBillAlarmByDevice(int nShard,int nShardNum)
+{
+	HANDLE hPipe =OpenRealDataPipe();
+
+	if (hPipe == NULL) 
+	{
+		MYERROR(_T("CheckBillAlarm hPipe null"));
+		return ;
+	}
+	for (int i = nShard;i<m_DevSampleCfgArray.GetSize();i+=nShardNum)
+	{
+		CString strQuery  = _T("");
+		strQuery.Format(_T("select top(%d) TIMEID, %s from %s where %s>0 order by TIMEID desc;"),BILL_ALARM_DAYS,
+			m_DevSampleCfgArray[i].ColumnName,m_DevSampleCfgArray[i].TableName,m_DevSampleCfgArray[i].ColumnName);
+		BYTE* pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
+		if (NULL == pRead)	// 未查询到记录
 		{
+			MYERROR(_T("CheckBillAlarm pRead null"));
 			continue;
 		}
-		//Ƿѳ15澯
-		int iDevId = m_DevSampleCfgArray[i].iDevId;
-		AlarmItemDef ALARMDef;
-		memset(&ALARMDef, 0, sizeof(AlarmItemDef));
-		CreateUuid(ALARMDef.alarmID);
-		DeviceInfoData iDeviceInfo;
-		memset(&iDeviceInfo,0,sizeof(DeviceInfoData));
-		m_DeviceInfoMap.Lookup(iDevId,iDeviceInfo);
-		ALARMDef.alarmType = ALARMTYPE_BILLOVERTIME;
-		ALARMDef.alarmLevel = 10;
-		ALARMDef.alarmObjID = iDevId;
-		ALARMDef.devID = iDevId;
-		ALARMDef.stationID = iDeviceInfo.iStationId;
-		memcpy(ALARMDef.alarmTypeName,_T("쳣澯"),sizeof(ALARMDef.alarmTypeName));
-		memcpy(ALARMDef.alarmObjName,iDeviceInfo.DevName,sizeof(ALARMDef.alarmObjName));
+		CRecordSetReader rs;
+		BOOL bAlarm = (rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), 2) && rs.GetRecordNum() >= BILL_ALARM_DAYS);
+		delete[] pRead;
+		pRead = NULL;
+		if (bAlarm)
+		{
+			AddBillAlarm(m_DevSampleCfgArray[i].iDevId);
+		}
+	}
+	CloseHandle(hPipe);
+}
 
-		ALARMDef.alarmObjType = 31; 
-		CTime curTime = CTime::GetCurrentTime();
-		ALARMDef.contentTime = curTime.GetTime();
-		//curTime = CTime(curTime.GetYear(),curTime.GetMonth(),curTime.GetDay(),0,0,0);
-		ALARMDef.alarmTime = curTime.GetTime();
+//欠费超过BILL_ALARM_DAYS天产生告警
+void CAlarmTask::AddBillAlarm(int iDevId)
+{
+	AlarmItemDef ALARMDef;
+	memset(&ALARMDef, 0, sizeof(AlarmItemDef));
+	CreateUuid(ALARMDef.alarmID);
+	DeviceInfoData iDeviceInfo;
+	memset(&iDeviceInfo,0,sizeof(DeviceInfoData));
+	GetDeviceInfo(iDevId,iDeviceInfo);
+	ALARMDef.alarmType = ALARMTYPE_BILLOVERTIME;
+	ALARMDef.alarmLevel = 10;
+	ALARMDef.alarmObjID = iDevId;
+	ALARMDef.devID = iDevId;
+	ALARMDef.stationID = iDeviceInfo.iStationId;
+	memcpy(ALARMDef.alarmTypeName,_T("账龄异常告警"),sizeof(ALARMDef.alarmTypeName));
+	memcpy(ALARMDef.alarmObjName,iDeviceInfo.DevName,sizeof(ALARMDef.alarmObjName));
 
-		ALARMDef.status = 0;
+	ALARMDef.alarmObjType = 31; 
+	CTime curTime = CTime::GetCurrentTime();
+	ALARMDef.contentTime = curTime.GetTime();
+	//curTime = CTime(curTime.GetYear(),curTime.GetMonth(),curTime.GetDay(),0,0,0);
+	ALARMDef.alarmTime = curTime.GetTime();
 
-		ALARMDef.projectID = 1;    //̺
-		ALARMDef.systemID = 1;    //ϵͳ
-		ALARMDef.rtAlarm = 0;    //¼ʵʱ澯
-		memset(ALARMDef.stationName, 0, sizeof(ALARMDef.stationName));
-		memset(ALARMDef.projectName, 0, sizeof(ALARMDef.projectName));
-		//memset(ALARMDef.alarmSource, 0, sizeof(ALARMDef.alarmSource));
-		//_tcsncpy_s(ALARMDef.alarmSource, _countof(ALARMDef.alarmSource), C_ALARMRESORCE, C_ALARMRESORCE.GetLength());
-		memcpy(ALARMDef.alarmSource,_T("Ӧ÷澯"),sizeof(ALARMDef.alarmSource));
-		ALARMDef.groupID1 = 1;
-		ALARMDef.groupID2 = 2;
-		CString strAlarmContent = _T("");
-		strAlarmContent.Format(_T("豸%sǷ15죬ȷ!"),
-			iDeviceInfo.DevName);
-		memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
-		AddAlarm2DB(ALARMDef);	
+	ALARMDef.status = 0;
+
+	ALARMDef.projectID = 1;    //工程号
+	ALARMDef.systemID = 1;    //子系统号
+	ALARMDef.rtAlarm = 0;    //不记录实时告警
+	memset(ALARMDef.stationName, 0, sizeof(ALARMDef.stationName));
+	memset(ALARMDef.projectName, 0, sizeof(ALARMDef.projectName));
+	//memset(ALARMDef.alarmSource, 0, sizeof(ALARMDef.alarmSource));
+	//_tcsncpy_s(ALARMDef.alarmSource, _countof(ALARMDef.alarmSource), C_ALARMRESORCE, C_ALARMRESORCE.GetLength());
+	memcpy(ALARMDef.alarmSource,_T("应用服务告警"),sizeof(ALARMDef.alarmSource));
+	ALARMDef.groupID1 = 1;
+	ALARMDef.groupID2 = 2;
+	CString strAlarmContent = _T("");
+	strAlarmContent.Format(_T("设备%s已连续欠费%d天，请确认!"),
+		iDeviceInfo.DevName,BILL_ALARM_DAYS);
+	memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
+	AddAlarm2DB(ALARMDef);	
+}
+
+//按采样表把m_DevSampleCfgArray分组，组内设备下标连续存放在m_vecBillCfgIndex中
+void CAlarmTask::GroupBillTables()
+{
+	m_vecBillTable.clear();
+	m_vecBillCfgIndex.clear();
+	int nCfgNum = (int)m_DevSampleCfgArray.GetSize();
+	vector<int> vecGroupOfCfg(nCfgNum);
+	CMap<CString,LPCTSTR,int,int> TableGroupMap;
+	TableGroupMap.InitHashTable(1021);
+	for (int i=0;i<nCfgNum;i++)
+	{
+		int nGroup = 0;
+		if (!TableGroupMap.Lookup(m_DevSampleCfgArray[i].TableName,nGroup))
+		{
+			BillTableGroup iGroup;
+			memset(&iGroup,0,sizeof(BillTableGroup));
+			_tcsncpy_s(iGroup.TableName,_countof(iGroup.TableName),m_DevSampleCfgArray[i].TableName,_TRUNCATE);
+			nGroup = (int)m_vecBillTable.size();
+			m_vecBillTable.push_back(iGroup);
+			TableGroupMap.SetAt(m_DevSampleCfgArray[i].TableName,nGroup);
+		}
+		vecGroupOfCfg[i] = nGroup;
+		m_vecBillTable[nGroup].nCount++;
 	}
-	delete[] pRead;
-	pRead = NULL;
-	CloseHandle(hPipe);
+	int nFirst = 0;
+	for (size_t g=0;g<m_vecBillTable.size();g++)
+	{
+		m_vecBillTable[g].nFirst = nFirst;
+		nFirst += m_vecBillTable[g].nCount;
+		m_vecBillTable[g].nCount = 0;
+	}
+	m_vecBillCfgIndex.resize(nCfgNum);
+	for (int i=0;i<nCfgNum;i++)
+	{
+		BillTableGroup &iGroup = m_vecBillTable[vecGroupOfCfg[i]];
+		m_vecBillCfgIndex[iGroup.nFirst+iGroup.nCount] = i;
+		iGroup.nCount++;
+	}
+	ReguTrace(Config,"账龄诊断:设备%d台,采样表%d张",nCfgNum,(int)m_vecBillTable.size());
 }
 BOOL CAlarmTask::GetSampleDayConfig()
 {
-	int iFdCount = 3;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 3;	//	查询的字段数
+	int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -784,16 +900,16 @@ BOOL CAlarmTask::GetSampleDayConfig()
 						   DEVICEID in(select DEVICENUM from TB_PULSE where num=1 and YMVALUE>0) and RECORDNO%10=1;");
 	pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-	if (NULL == pRead)	// δѯ¼
+	if (NULL == pRead)	// 未查询到记录
 	{
 		CloseHandle(hPipe);
 		MYERROR(_T("GetOverDraft pRead null"));
 		return FALSE;
 	}
-	// صĽ
+	// 解析返回的结果
 	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-		//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+		//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -801,9 +917,9 @@ BOOL CAlarmTask::GetSampleDayConfig()
 		return FALSE;
 	}	
 
-	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+	if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 	{
-		//MYWARN(_T("յջظģ޷ѯ"));
+		//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -811,12 +927,12 @@ BOOL CAlarmTask::GetSampleDayConfig()
 		return FALSE;
 	}
 
-	// ȡѯֶ
+	// 获取查询的字段数
 	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 	int nFieldNum = (int)*pWord;
-	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	if (nFieldNum != iFdCount)	// 查询字段数量，不相等，曾查询结果异常退出
 	{
-		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+		//	MYWARN(_T("查询字段数量，不相等，曾查询结果异常退出"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -825,7 +941,7 @@ BOOL CAlarmTask::GetSampleDayConfig()
 	}
 	pWord++;
 
-	// ¼
+	// 记录集长度
 	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 	DWORD dwRecordLen = *((DWORD*)pByte);
@@ -838,7 +954,7 @@ BOOL CAlarmTask::GetSampleDayConfig()
 	}
 	pByte += sizeof(DWORD);
 
-	// ¼
+	// 记录数
 	DWORD dwRecordNum = *((int*)pByte);
 	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 	{
@@ -849,7 +965,7 @@ BOOL CAlarmTask::GetSampleDayConfig()
 	}
 	pByte += sizeof(DWORD);
 
-	// ѯд뵽
+	// 将查询结果写入到缓存
 	LZGRECORDSET rs;
 	for (int i=0;i<(int)dwRecordNum;i++)
 	{
@@ -876,15 +992,16 @@ BOOL CAlarmTask::GetSampleDayConfig()
 	pRead = NULL;
 	CloseHandle(hPipe);
 
+	GroupBillTables();
 	return TRUE;
 }
 BOOL CAlarmTask::GetOverDraft()
 {
-	int iFdCount = 3;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 3;	//	查询的字段数
+	int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -898,16 +1015,16 @@ BOOL CAlarmTask::GetOverDraft()
 	CString strQuery  = _T("select STATIONNUM,DEVICENUM,YMVALUE from TB_PULSE where num=1 and YMVALUE>0;");
 	pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-	if (NULL == pRead)	// δѯ¼
+	if (NULL == pRead)	// 未查询到记录
 	{
 		CloseHandle(hPipe);
 		MYERROR(_T("GetOverDraft pRead null"));
 		return FALSE;
 	}
-	// صĽ
+	// 解析返回的结果
 	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-		//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+		//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -915,9 +1032,9 @@ BOOL CAlarmTask::GetOverDraft()
 		return FALSE;
 	}	
 
-	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+	if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 	{
-		//MYWARN(_T("յջظģ޷ѯ"));
+		//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -925,12 +1042,12 @@ BOOL CAlarmTask::GetOverDraft()
 		return FALSE;
 	}
 
-	// ȡѯֶ
+	// 获取查询的字段数
 	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 	int nFieldNum = (int)*pWord;
-	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	if (nFieldNum != iFdCount)	// 查询字段数量，不相等，曾查询结果异常退出
 	{
-		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+		//	MYWARN(_T("查询字段数量，不相等，曾查询结果异常退出"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -939,7 +1056,7 @@ BOOL CAlarmTask::GetOverDraft()
 	}
 	pWord++;
 
-	// ¼
+	// 记录集长度
 	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 	DWORD dwRecordLen = *((DWORD*)pByte);
@@ -952,7 +1069,7 @@ BOOL CAlarmTask::GetOverDraft()
 	}
 	pByte += sizeof(DWORD);
 
-	// ¼
+	// 记录数
 	DWORD dwRecordNum = *((int*)pByte);
 	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 	{
@@ -963,7 +1080,7 @@ BOOL CAlarmTask::GetOverDraft()
 	}
 	pByte += sizeof(DWORD);
 
-	// ѯд뵽
+	// 将查询结果写入到缓存
 	LZGRECORDSET rs;
 	for (int i=0;i<(int)dwRecordNum;i++)
 	{
@@ -991,13 +1108,13 @@ BOOL CAlarmTask::GetOverDraft()
 
 		DeviceInfoData iDeviceInfo;
 		memset(&iDeviceInfo,0,sizeof(DeviceInfoData));
-		m_DeviceInfoMap.Lookup(iDevId,iDeviceInfo);
+		GetDeviceInfo(iDevId,iDeviceInfo);
 		ALARMDef.alarmType = ALARMTYPE_DEV_OVERDRAFT;
 		ALARMDef.alarmLevel = 10;
 		ALARMDef.alarmObjID = iDevId;
 		ALARMDef.devID = iDevId;
 		ALARMDef.stationID = iStationId;
-		memcpy(ALARMDef.alarmTypeName,_T("ǷѸ澯"),sizeof(ALARMDef.alarmTypeName));
+		memcpy(ALARMDef.alarmTypeName,_T("电表欠费告警"),sizeof(ALARMDef.alarmTypeName));
 		memcpy(ALARMDef.alarmObjName,iDeviceInfo.DevName,sizeof(ALARMDef.alarmObjName));
 
 		ALARMDef.alarmObjType = 31; 
@@ -1008,18 +1125,18 @@ BOOL CAlarmTask::GetOverDraft()
 
 		ALARMDef.status = 0;
 
-		ALARMDef.projectID = 1;    //̺
-		ALARMDef.systemID = 1;    //ϵͳ
-		ALARMDef.rtAlarm = 0;    //¼ʵʱ澯
+		ALARMDef.projectID = 1;    //工程号
+		ALARMDef.systemID = 1;    //子系统号
+		ALARMDef.rtAlarm = 0;    //不记录实时告警
 		memset(ALARMDef.stationName, 0, sizeof(ALARMDef.stationName));
 		memset(ALARMDef.projectName, 0, sizeof(ALARMDef.projectName));
 		//memset(ALARMDef.alarmSource, 0, sizeof(ALARMDef.alarmSource));
 		//_tcsncpy_s(ALARMDef.alarmSource, _countof(ALARMDef.alarmSource), C_ALARMRESORCE, C_ALARMRESORCE.GetLength());
-		memcpy(ALARMDef.alarmSource,_T("Ӧ÷澯"),sizeof(ALARMDef.alarmSource));
+		memcpy(ALARMDef.alarmSource,_T("应用服务告警"),sizeof(ALARMDef.alarmSource));
 		ALARMDef.groupID1 = 1;
 		ALARMDef.groupID2 = 3;
 		CString strAlarmContent = _T("");
-		strAlarmContent.Format(_T("豸%sǷѣǷѽΪ%.2f,ȷ!"),
+		strAlarmContent.Format(_T("设备%s已欠费，欠费金额为%.2f,请确认!"),
 			iDeviceInfo.DevName,YmValue);
 		memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
 		//_tcsncpy_s(ALARMDef.alarmContent, _countof(ALARMDef.alarmContent), strAlarmContent, strAlarmContent.GetLength());
@@ -1034,11 +1151,11 @@ BOOL CAlarmTask::GetOverDraft()
 }
 BOOL CAlarmTask::GetNoDevContract()
 {
-	int iFdCount = 6;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 6;	//	查询的字段数
+	int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -1057,16 +1174,16 @@ BOOL CAlarmTask::GetNoDevContract()
 		and (PACTENDDATE > GETDATE()) and ContractType != 0 ;");
 	pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-	if (NULL == pRead)	// δѯ¼
+	if (NULL == pRead)	// 未查询到记录
 	{
 		CloseHandle(hPipe);
 		MYERROR(_T("GetNoDevContract pRead null"));
 		return FALSE;
 	}
-	// صĽ
+	// 解析返回的结果
 	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-		//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+		//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -1074,9 +1191,9 @@ BOOL CAlarmTask::GetNoDevContract()
 		return FALSE;
 	}	
 
-	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+	if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 	{
-		//MYWARN(_T("յջظģ޷ѯ"));
+		//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -1084,12 +1201,12 @@ BOOL CAlarmTask::GetNoDevContract()
 		return FALSE;
 	}
 
-	// ȡѯֶ
+	// 获取查询的字段数
 	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 	int nFieldNum = (int)*pWord;
-	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	if (nFieldNum != iFdCount)	// 查询字段数量，不相等，曾查询结果异常退出
 	{
-		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+		//	MYWARN(_T("查询字段数量，不相等，曾查询结果异常退出"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -1098,7 +1215,7 @@ BOOL CAlarmTask::GetNoDevContract()
 	}
 	pWord++;
 
-	// ¼
+	// 记录集长度
 	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 	DWORD dwRecordLen = *((DWORD*)pByte);
@@ -1111,7 +1228,7 @@ BOOL CAlarmTask::GetNoDevContract()
 	}
 	pByte += sizeof(DWORD);
 
-	// ¼
+	// 记录数
 	DWORD dwRecordNum = *((int*)pByte);
 	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 	{
@@ -1122,7 +1239,7 @@ BOOL CAlarmTask::GetNoDevContract()
 	}
 	pByte += sizeof(DWORD);
 
-	// ѯд뵽
+	// 将查询结果写入到缓存
 	LZGRECORDSET rs;
 	for (int i=0;i<(int)dwRecordNum;i++)
 	{
@@ -1174,10 +1291,10 @@ BOOL CAlarmTask::GetNoDevContract()
 		ALARMDef.alarmLevel = 10;
 		ALARMDef.alarmObjID = ContractId;
 		//ALARMDef.stationID = iDeviceInfo.iStationId;
-		memcpy(ALARMDef.alarmTypeName,_T("Ʒȱʧ"),sizeof(ALARMDef.alarmTypeName));
+		memcpy(ALARMDef.alarmTypeName,_T("品牌缺失电表"),sizeof(ALARMDef.alarmTypeName));
 		memcpy(ALARMDef.alarmObjName,AccoutName,sizeof(AccoutName));
 
-		ALARMDef.alarmObjType = 36;  //35 澯ΪƷƣ36Ϊͬ
+		ALARMDef.alarmObjType = 36;  //35 代表告警对象为品牌，36为合同
 		//ALARMDef.devID = iDeviceInfo.iDevId;
 		CTime curTime = CTime::GetCurrentTime();
 		ALARMDef.contentTime = curTime.GetTime();
@@ -1186,18 +1303,18 @@ BOOL CAlarmTask::GetNoDevContract()
 
 		ALARMDef.status = 0;
 
-		ALARMDef.projectID = 1;    //̺
-		ALARMDef.systemID = 1;    //ϵͳ
-		ALARMDef.rtAlarm = 0;    //¼ʵʱ澯
+		ALARMDef.projectID = 1;    //工程号
+		ALARMDef.systemID = 1;    //子系统号
+		ALARMDef.rtAlarm = 0;    //不记录实时告警
 		memset(ALARMDef.stationName, 0, sizeof(ALARMDef.stationName));
 		memset(ALARMDef.projectName, 0, sizeof(ALARMDef.projectName));
 		//memset(ALARMDef.alarmSource, 0, sizeof(ALARMDef.alarmSource));
 		//_tcsncpy_s(ALARMDef.alarmSource, _countof(ALARMDef.alarmSource), C_ALARMRESORCE, C_ALARMRESORCE.GetLength());
-		memcpy(ALARMDef.alarmSource,_T("Ӧ÷澯"),sizeof(ALARMDef.alarmSource));
+		memcpy(ALARMDef.alarmSource,_T("应用服务告警"),sizeof(ALARMDef.alarmSource));
 		ALARMDef.groupID1 = 1;
 		ALARMDef.groupID2 = 2;
 		CString strAlarmContent = _T("");
-		strAlarmContent.Format(_T("%s%sƷºͬΪ%d,û豸ȷ!"),
+		strAlarmContent.Format(_T("%s%s品牌下合同号为%d,没有所属设备，请确认!"),
 			PlazaName,AccoutName,ContractId);
 		memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
 		AddAlarm2DB(ALARMDef);		
@@ -1211,11 +1328,10 @@ BOOL CAlarmTask::GetNoDevContract()
 }
 BOOL CAlarmTask::LoadSMSConfig()
 {
-	int iFdCount = 6;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 6;	//	查询的字段数
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -1229,124 +1345,36 @@ BOOL CAlarmTask::LoadSMSConfig()
 	CString strQuery  = _T("select PLAZAIDS,[TYPE],TEMPLATENUM,ISSHIELD,REALNAME,PHONE from TE_PAYMENT_NOSMS;");
 	pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-	if (NULL == pRead)	// δѯ¼
+	if (NULL == pRead)	// 未查询到记录
 	{
 		CloseHandle(hPipe);
 		MYERROR(_T("LoadSMSConfig pRead null"));
 		return FALSE;
 	}
-	// صĽ
-	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
-	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-		//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
-		delete[] pRead;
-		pRead = NULL;
-		CloseHandle(hPipe);
-		MYERROR(_T("LoadSMSConfig pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB null"));
-		return FALSE;
-	}	
-
-	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
-	{
-		//MYWARN(_T("յջظģ޷ѯ"));
-		delete[] pRead;
-		pRead = NULL;
-		CloseHandle(hPipe);
-		MYERROR(_T("LoadSMSConfig pNetMessageHead->Length < 1 null"));
-		return FALSE;
-	}
-
-	// ȡѯֶ
-	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
-	int nFieldNum = (int)*pWord;
-	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	// 解析返回的结果，直接在接收缓冲区上按字段偏移读取
+	CRecordSetReader rs;
+	if (!rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), iFdCount))
 	{
-		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
-		MYERROR(_T("LoadSMSConfig nFieldNum != iFdCount null"));
+		MYERROR(_T("LoadSMSConfig 返回记录集异常"));
 		return FALSE;
 	}
-	pWord++;
 
-	// ¼
-	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
-	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
-	DWORD dwRecordLen = *((DWORD*)pByte);
-	if (dwRecordLen < 1)
-	{
-		delete[] pRead;
-		pRead = NULL;
-		CloseHandle(hPipe);
-		return FALSE;
-	}
-	pByte += sizeof(DWORD);
-
-	// ¼
-	DWORD dwRecordNum = *((int*)pByte);
-	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
-	{
-		delete[] pRead;
-		pRead = NULL;
-		CloseHandle(hPipe);
-		return FALSE;
-	}
-	pByte += sizeof(DWORD);
-
-	TCHAR *tValue = new TCHAR[2048+1];
-	if (tValue == NULL)
-	{
-		//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
-		MYERROR(_T("GetPlazaId tValue == NULL"));
-		delete[] pRead;
-		pRead = NULL;
-		CloseHandle(hPipe);
-		return FALSE;
-	}
-
-	// ѯд뵽
-	LZGRECORDSET rs;
-	for (int i=0;i<(int)dwRecordNum;i++)
+	// 将查询结果写入到缓存
+	TCHAR PersonName[65];
+	TCHAR PhoneNum[65];
+	while (rs.NextRecord())
 	{
-		rs.clear();
 		CString csPlazaId = _T("");
-		ZeroMemory(tValue,2048+1);
-		memcpy(tValue, pByte, pHead->DataLen);
-		
-		csPlazaId.Format(_T("%s"),tValue);
-		//iSMSCfg.iPlazaId = rs.iRs;
-		pByte += pHead->DataLen;
-
-		memcpy(rs.buf, pByte, (pHead+1)->DataLen);
-		int iType = rs.iRs;
-		pByte += (pHead+1)->DataLen;
-		rs.clear();
-
-		memcpy(rs.buf, pByte, (pHead+2)->DataLen);
-		int TemplateNum = rs.iRs;
-		pByte += (pHead+2)->DataLen;
-		rs.clear();
-
-		memcpy(rs.buf, pByte, (pHead+3)->DataLen);
-		int IsShield = rs.iRs;
-		pByte += (pHead+3)->DataLen;
-		rs.clear();
-
-		memcpy(rs.buf, pByte, (pHead+4)->DataLen);
-		CString PersonName = _T("");
-		PersonName.Format(_T("%s"),rs.cBuf);
-		//memcpy(iSMSCfg.PersonName,rs.cBuf,sizeof(TCHAR)*65);
-		pByte += (pHead+4)->DataLen;
-		rs.clear();
+		rs.GetString(0, csPlazaId);
+		int iType = rs.GetInt(1);
+		int TemplateNum = rs.GetInt(2);
+		int IsShield = rs.GetInt(3);
+		rs.GetString(4, PersonName, 65);
+		rs.GetString(5, PhoneNum, 65);
 
-		memcpy(rs.buf, pByte, (pHead+5)->DataLen);
-		CString PhoneNum = _T("");
-		PhoneNum.Format(_T("%s"),rs.cBuf);
-		//memcpy(iSMSCfg.PhoneNum,rs.cBuf,sizeof(TCHAR)*65);
-		pByte += (pHead+5)->DataLen;
-		rs.clear();
-		
 		int iPos = csPlazaId.Find(_T(","));
 		while(iPos!=-1)
 		{
@@ -1357,13 +1385,11 @@ BOOL CAlarmTask::LoadSMSConfig()
 			memset(&iSMSCfg,0,sizeof(SMSConfigDef));
 			iSMSCfg.iPlazaId = iPlazaId;
 			iSMSCfg.IsShield = IsShield;
-			memcpy(iSMSCfg.PersonName,PersonName.GetBuffer(),sizeof(TCHAR)*PersonName.GetLength());
-			memcpy(iSMSCfg.PhoneNum,PhoneNum.GetBuffer(),sizeof(TCHAR)*PhoneNum.GetLength());
+			memcpy(iSMSCfg.PersonName,PersonName,sizeof(PersonName));
+			memcpy(iSMSCfg.PhoneNum,PhoneNum,sizeof(PhoneNum));
 			iSMSCfg.TemplateNum = TemplateNum;
 			iSMSCfg.type = iType;
-			CString ikey = _T("");
-			ikey.Format(_T("%d_%d"),iSMSCfg.iPlazaId,iSMSCfg.type);
-			m_SMSConfigMap.SetAt(ikey,iSMSCfg);
+			m_SMSConfigMap[MAKE_SMSCFG_KEY(iSMSCfg.iPlazaId,iSMSCfg.type)] = iSMSCfg;
 			iPos = csPlazaId.Find(_T(","));
 		}
 
@@ -1372,17 +1398,13 @@ BOOL CAlarmTask::LoadSMSConfig()
 		memset(&iSMSCfg,0,sizeof(SMSConfigDef));
 		iSMSCfg.iPlazaId = iPlazaId;
 		iSMSCfg.IsShield = IsShield;
-		memcpy(iSMSCfg.PersonName,PersonName.GetBuffer(),sizeof(TCHAR)*PersonName.GetLength());
-		memcpy(iSMSCfg.PhoneNum,PhoneNum.GetBuffer(),sizeof(TCHAR)*PhoneNum.GetLength());
+		memcpy(iSMSCfg.PersonName,PersonName,sizeof(PersonName));
+		memcpy(iSMSCfg.PhoneNum,PhoneNum,sizeof(PhoneNum));
 		iSMSCfg.TemplateNum = TemplateNum;
 		iSMSCfg.type = iType;
-		CString ikey = _T("");
-		ikey.Format(_T("%d_%d"),iSMSCfg.iPlazaId,iSMSCfg.type);
-		m_SMSConfigMap.SetAt(ikey,iSMSCfg);
+		m_SMSConfigMap[MAKE_SMSCFG_KEY(iSMSCfg.iPlazaId,iSMSCfg.type)] = iSMSCfg;
 	}
 
-	delete []tValue;
-	tValue = NULL;
 	delete[] pRead;
 	pRead = NULL;
 	CloseHandle(hPipe);
@@ -1391,11 +1413,11 @@ BOOL CAlarmTask::LoadSMSConfig()
 }
 BOOL CAlarmTask::LoadSMSTemplate()
 {
-	int iFdCount = 2;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 2;	//	查询的字段数
+	int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -1409,16 +1431,16 @@ BOOL CAlarmTask::LoadSMSTemplate()
 	CString strQuery  = _T("SELECT NUM,TEMPLATE FROM TB_PAYMENT_SMSTEMPLATE; ");
 	pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-	if (NULL == pRead)	// δѯ¼
+	if (NULL == pRead)	// 未查询到记录
 	{
 		CloseHandle(hPipe);
 		MYERROR(_T("LoadSMSTemplate pRead null"));
 		return FALSE;
 	}
-	// صĽ
+	// 解析返回的结果
 	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-		//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+		//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -1426,9 +1448,9 @@ BOOL CAlarmTask::LoadSMSTemplate()
 		return FALSE;
 	}	
 
-	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+	if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 	{
-		//MYWARN(_T("յջظģ޷ѯ"));
+		//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -1436,12 +1458,12 @@ BOOL CAlarmTask::LoadSMSTemplate()
 		return FALSE;
 	}
 
-	// ȡѯֶ
+	// 获取查询的字段数
 	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 	int nFieldNum = (int)*pWord;
-	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	if (nFieldNum != iFdCount)	// 查询字段数量，不相等，曾查询结果异常退出
 	{
-		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+		//	MYWARN(_T("查询字段数量，不相等，曾查询结果异常退出"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -1450,7 +1472,7 @@ BOOL CAlarmTask::LoadSMSTemplate()
 	}
 	pWord++;
 
-	// ¼
+	// 记录集长度
 	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 	DWORD dwRecordLen = *((DWORD*)pByte);
@@ -1463,7 +1485,7 @@ BOOL CAlarmTask::LoadSMSTemplate()
 	}
 	pByte += sizeof(DWORD);
 
-	// ¼
+	// 记录数
 	DWORD dwRecordNum = *((int*)pByte);
 	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 	{
@@ -1474,7 +1496,7 @@ BOOL CAlarmTask::LoadSMSTemplate()
 	}
 	pByte += sizeof(DWORD);
 
-	// ѯд뵽
+	// 将查询结果写入到缓存
 	LZGRECORDSET rs;
 	for (int i=0;i<(int)dwRecordNum;i++)
 	{
@@ -1490,7 +1512,7 @@ BOOL CAlarmTask::LoadSMSTemplate()
 		pByte += (pHead+1)->DataLen;
 		rs.clear();
 
-		m_SMSTemplateMap.SetAt(TemplateNum,Template);
+		m_SMSTemplateMap[TemplateNum].Compile(Template);
 	}
 
 	delete[] pRead;
@@ -1500,105 +1522,100 @@ BOOL CAlarmTask::LoadSMSTemplate()
 	return TRUE;
 }
 
+//按列装载设备日用电量，由CAlarmRules一次遍历算出各品牌用电量合计并逐条规则整列判断，最后按设备顺序生成告警
 void CAlarmTask::ProcessData()
 {
 	CTime CurrTime = CTime::GetCurrentTime();
-	CurrTime = CTime(CurrTime.GetYear(),CurrTime.GetMonth(),CurrTime.GetDay(),0,0,0);
-	vector<DeviceInfoData>::iterator iterDeviceInfoB = m_vecDeviceInfo.begin();
-	vector<DeviceInfoData>::iterator iterDeviceInfoE = m_vecDeviceInfo.end();
-	for (; iterDeviceInfoB != iterDeviceInfoE; iterDeviceInfoB++)
-	{
-		DeviceInfoData& iDeviceInfo = *iterDeviceInfoB;
+	int nCurrDate = CurrTime.GetYear()*10000 + CurrTime.GetMonth()*100 + CurrTime.GetDay();
+	int nDevCount = (int)m_vecDeviceInfo.size();
+	m_AlarmRules.m_nMinValue = m_MinValue;
+	m_AlarmRules.m_nMaxValue = m_MaxValue;
+	m_AlarmRules.m_fMagnifyNum = m_iMagnifyNum;
+	m_AlarmRules.m_fRushMinValue = m_fRushMinValue;
+	m_AlarmRules.Resize(nDevCount);
+
+	//装载：有账单的设备置ALARMRULE_HASVALUE
+	int nNoValue = 0;
+	int i = 0;
+	for (i=0; i<nDevCount; i++)
+	{
+		const DeviceInfoData& iDeviceInfo = m_vecDeviceInfo[i];
+		int nContractEnd = 0;
+		if (iDeviceInfo.iBrandId!=0&&iDeviceInfo.iContractId!=0&&iDeviceInfo.endTime.year!=0)
+		{
+			nContractEnd = iDeviceInfo.endTime.year*10000 + iDeviceInfo.endTime.month*100 + iDeviceInfo.endTime.day;
+		}
+		m_AlarmRules.SetDevice(i, iDeviceInfo.iBrandId, iDeviceInfo.Occupied, nContractEnd);
 		DevDayValue iDevValue;
-		BOOL bresult = m_DevDayValueMap.Lookup(iDeviceInfo.iDevId,iDevValue);
-		if (!bresult)
+		if (m_DevDayValueMap.Lookup(iDeviceInfo.iDevId,iDevValue))
+		{
+			m_AlarmRules.SetDayValue(i, iDevValue.DayValue, iDevValue.last7Value);
+		}
+		else
 		{
-			ReguTrace(ERR,"δҵDevId=%d˵",iDeviceInfo.iDevId);
-			//continue;
+			nNoValue++;
 		}
+	}
+	if (nNoValue > 0)
+	{
+		ReguTrace(ERR,"%d个设备未找到账单",nNoValue);
+	}
+	m_AlarmRules.Evaluate(nCurrDate);
 
-		//ܺͻ쳣ж
-		if(bresult&&iDevValue.DayValue>=1&&iDeviceInfo.Occupied==0)
+	//生成告警
+	for (i=0; i<nDevCount; i++)
+	{
+		BYTE nFlag = m_AlarmRules.m_vecAlarmFlag[i];
+		if ((nFlag&~ALARMRULE_HASVALUE)==0)
 		{
-			if(iDevValue.DayValue>iDevValue.last7Value*m_iMagnifyNum)
-			{
-				AlarmItemDef ALARMDef;
-				memset(&ALARMDef, 0, sizeof(AlarmItemDef));
-				CreateAlarmDef(iDeviceInfo,ALARMTYPE_RUSH,ALARMDef);
-				CString strAlarmContent = _T("");
-				strAlarmContent.Format(_T("豸%sܺͻ澯,ǰֵ%.2f,ƽֵ%.2f"),
-					iDeviceInfo.DevName,iDevValue.DayValue,iDevValue.last7Value);
-				memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
-				AddAlarm2DB(ALARMDef);
-			}
+			continue;
 		}
-		
-		//ͬڻұ
-		if (iDeviceInfo.iBrandId!=0&&iDeviceInfo.iContractId!=0)
+		DeviceInfoData& iDeviceInfo = m_vecDeviceInfo[i];
+		if (nFlag&ALARMRULE_RUSH)
 		{
-			CTime ContractEndLine = CTime(iDeviceInfo.endTime.year,iDeviceInfo.endTime.month,iDeviceInfo.endTime.day,0,0,0);
-
-			if(CurrTime>ContractEndLine)
-			{
-				AlarmItemDef ALARMDef;
-				memset(&ALARMDef, 0, sizeof(AlarmItemDef));
-				CreateAlarmDef(iDeviceInfo,ALARMTYPE_CONTRACTEND,ALARMDef);
-				CString strAlarmContent = _T("");
-				strAlarmContent.Format(_T("豸%s̺ͬѵ,%d-%d-%d 00:00:00"),
-					iDeviceInfo.DevName,iDeviceInfo.endTime.year,iDeviceInfo.endTime.month,iDeviceInfo.endTime.day);
-				memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
-				AddAlarm2DB(ALARMDef);
-			}
+			AlarmItemDef ALARMDef;
+			memset(&ALARMDef, 0, sizeof(AlarmItemDef));
+			CreateAlarmDef(iDeviceInfo,ALARMTYPE_RUSH,ALARMDef);
+			CString strAlarmContent = _T("");
+			strAlarmContent.Format(_T("设备%s产生能耗突增告警,当前值%.2f,平均值%.2f。"),
+				iDeviceInfo.DevName,m_AlarmRules.m_vecDayValue[i],m_AlarmRules.m_vecLast7Value[i]);
+			memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
+			AddAlarm2DB(ALARMDef);
 		}
-		
-
-		//Ʒõ
-		if(iDeviceInfo.iBrandId!=0&&bresult)
+		if (nFlag&ALARMRULE_CONTRACTEND)
 		{
-			vector<int> vecDev;
-			m_BrandDevMap.Lookup(iDeviceInfo.iBrandId,vecDev);
-			float fBrandConsume = 0;
-			vector<int>::iterator iterB = vecDev.begin();
-			vector<int>::iterator iterE = vecDev.end();
-			for (; iterB != iterE; iterB++)
-			{
-				int& iDevId = *iterB;
-				DevDayValue iDevValue1;
-				BOOL bresult1 = m_DevDayValueMap.Lookup(iDevId,iDevValue1);
-				if (bresult1)
-				{
-					fBrandConsume += iDevValue1.DayValue;
-				}
-			}
-			if (fBrandConsume<m_MinValue)
-			{
-				AlarmItemDef ALARMDef;
-				memset(&ALARMDef, 0, sizeof(AlarmItemDef));
-				CreateAlarmDef(iDeviceInfo,ALARMTYPE_BRAND_LOW,ALARMDef);
-				CString strAlarmContent = _T("");
-				strAlarmContent.Format(_T("%s%sõƫС,ʵõ%.2f,׼ֵ%d"),
-					iDeviceInfo.PlazaName,iDeviceInfo.BrandName,fBrandConsume,m_MinValue);
-				memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
-				ALARMDef.alarmObjID = iDeviceInfo.iBrandId;
-				ALARMDef.alarmObjType = 35;
-				AddAlarm2DB(ALARMDef);
-			}
+			AlarmItemDef ALARMDef;
+			memset(&ALARMDef, 0, sizeof(AlarmItemDef));
+			CreateAlarmDef(iDeviceInfo,ALARMTYPE_CONTRACTEND,ALARMDef);
+			CString strAlarmContent = _T("");
+			strAlarmContent.Format(_T("设备%s所在商铺合同已到期,到期日%d-%d-%d 00:00:00。"),
+				iDeviceInfo.DevName,iDeviceInfo.endTime.year,iDeviceInfo.endTime.month,iDeviceInfo.endTime.day);
+			memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
+			AddAlarm2DB(ALARMDef);
 		}
-
-		//̹õ ֻ̹δռõıõ
-		if(iDeviceInfo.Occupied==0)    //(iDeviceInfo.iBrandId==0&&iDeviceInfo.iContractId==0)
+		if (nFlag&ALARMRULE_BRAND_LOW)
 		{
-			if (iDevValue.DayValue>m_MaxValue)
-			{
-				AlarmItemDef ALARMDef;
-				memset(&ALARMDef, 0, sizeof(AlarmItemDef));
-				CreateAlarmDef(iDeviceInfo,ALARMTYPE_BUSSINESS_HIGH,ALARMDef);
-				CString strAlarmContent = _T("");
-				strAlarmContent.Format(_T("豸%sδƷõƫ,ʵֵ%.2f,׼ֵ%d"),
-					iDeviceInfo.DevName,iDevValue.DayValue,m_MaxValue);
-				memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
-				AddAlarm2DB(ALARMDef);
-			}
+			AlarmItemDef ALARMDef;
+			memset(&ALARMDef, 0, sizeof(AlarmItemDef));
+			CreateAlarmDef(iDeviceInfo,ALARMTYPE_BRAND_LOW,ALARMDef);
+			CString strAlarmContent = _T("");
+			strAlarmContent.Format(_T("%s下商铺%s用电量偏小,实际用电量%.2f,标准值%d。"),
+				iDeviceInfo.PlazaName,iDeviceInfo.BrandName,m_AlarmRules.m_vecBrandConsume[i],m_MinValue);
+			memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
+			ALARMDef.alarmObjID = iDeviceInfo.iBrandId;
+			ALARMDef.alarmObjType = 35;
+			AddAlarm2DB(ALARMDef);
+		}
+		if (nFlag&ALARMRULE_BUSSINESS_HIGH)
+		{
+			AlarmItemDef ALARMDef;
+			memset(&ALARMDef, 0, sizeof(AlarmItemDef));
+			CreateAlarmDef(iDeviceInfo,ALARMTYPE_BUSSINESS_HIGH,ALARMDef);
+			CString strAlarmContent = _T("");
+			strAlarmContent.Format(_T("设备%s未挂品牌用电量偏高,实际值%.2f,标准值%d。"),
+				iDeviceInfo.DevName,m_AlarmRules.m_vecDayValue[i],m_MaxValue);
+			memcpy(ALARMDef.alarmContent,strAlarmContent.GetBuffer(),sizeof(ALARMDef.alarmContent));
+			AddAlarm2DB(ALARMDef);
 		}
 	}
 }
@@ -1609,52 +1626,31 @@ void CAlarmTask::CreateAlarmDef(DeviceInfoData iDeviceInfo,int AlarmType,AlarmIt
 	ALARMDef.alarmType = AlarmType;
 	CString strAlarmTypeName = _T("");
 	CString strAlarmContent = _T("");
-	if (AlarmType==ALARMTYPE_RUSH)  //ܺͻ쳣
+	if (AlarmType==ALARMTYPE_RUSH)  //能耗突变异常
 	{
-		strAlarmTypeName = _T("ܺͻ澯");
+		strAlarmTypeName = _T("能耗突增告警");
 	} 
-	else if(AlarmType==ALARMTYPE_CONTRACTNODEV)  //кͬޱ
+	else if(AlarmType==ALARMTYPE_CONTRACTNODEV)  //有合同无表
 	{
-		strAlarmTypeName = _T("Ʒȱʧ");
+		strAlarmTypeName = _T("品牌缺失电表");
 	}
-	else if(AlarmType==ALARMTYPE_CONTRACTEND)   //ͬڻұ
+	else if(AlarmType==ALARMTYPE_CONTRACTEND)   //合同到期还挂表
 	{
-		strAlarmTypeName = _T("ƷƳ澯");
+		strAlarmTypeName = _T("品牌撤场告警");
 	}
-	else if(AlarmType==ALARMTYPE_BRAND_LOW)  //Ʒõ
+	else if(AlarmType==ALARMTYPE_BRAND_LOW)  //电表挂品牌用电少
 	{
-		strAlarmTypeName = _T("Ʒõ澯");
+		strAlarmTypeName = _T("品牌用电告警");
 	}
-	else if(AlarmType==ALARMTYPE_BUSSINESS_HIGH)  //̹õ
+	else if(AlarmType==ALARMTYPE_BUSSINESS_HIGH)  //电表挂商管下用电多
 	{
-		strAlarmTypeName = _T("̹õ澯");
+		strAlarmTypeName = _T("商管用电告警");
 	}
 	else
 	{
 		return;
 	}
-	CString iKey = _T("");
-	iKey.Format(_T("%d_%d"),iDeviceInfo.iPlazaId,AlarmType);
-	SMSConfigDef iSMSCofig;
-	memset(&iSMSCofig,0,sizeof(SMSConfigDef));
-	if(m_SMSConfigMap.Lookup(iKey,iSMSCofig))
-	{
-		if (iSMSCofig.IsShield==0)
-		{
-			CString TemplateContent = _T("");
-			m_SMSTemplateMap.Lookup(iSMSCofig.TemplateNum,TemplateContent);
-			CString Owner = _T("");
-			CString AlarmObject = _T("");
-			CString strAlarmType = _T("");
-			Owner.Format(_T("%s"),iSMSCofig.PersonName);
-			AlarmObject.Format(_T("%s%sƷµ%s"),iDeviceInfo.PlazaName,iDeviceInfo.BrandName,iDeviceInfo.DevName);
-			strAlarmType.Format(_T("%s"),strAlarmTypeName);
-			TemplateContent.Replace(_T("[owner]"),Owner);
-			TemplateContent.Replace(_T("[object]"),AlarmObject);
-			TemplateContent.Replace(_T("[alarmtype]"),strAlarmType);
-			Insert2SMSRECORD(iSMSCofig,TemplateContent);
-		}
-	}
+	AddAlarmSMS(iDeviceInfo,AlarmType,strAlarmTypeName);
 
 	ALARMDef.alarmLevel = 10;
 	ALARMDef.alarmObjID = iDeviceInfo.iDevId;
@@ -1671,221 +1667,59 @@ void CAlarmTask::CreateAlarmDef(DeviceInfoData iDeviceInfo,int AlarmType,AlarmIt
 
 	ALARMDef.status = 0;
 
-	ALARMDef.projectID = 1;    //̺
-	ALARMDef.systemID = 1;    //ϵͳ
-	ALARMDef.rtAlarm = 0;    //¼ʵʱ澯
+	ALARMDef.projectID = 1;    //工程号
+	ALARMDef.systemID = 1;    //子系统号
+	ALARMDef.rtAlarm = 0;    //不记录实时告警
 	memset(ALARMDef.stationName, 0, sizeof(ALARMDef.stationName));
 	memset(ALARMDef.projectName, 0, sizeof(ALARMDef.projectName));
 	//memset(ALARMDef.alarmSource, 0, sizeof(ALARMDef.alarmSource));
 	//_tcsncpy_s(ALARMDef.alarmSource, _countof(ALARMDef.alarmSource), C_ALARMRESORCE, C_ALARMRESORCE.GetLength());
-	memcpy(ALARMDef.alarmSource,_T("Ӧ÷澯"),sizeof(ALARMDef.alarmSource));
+	memcpy(ALARMDef.alarmSource,_T("应用服务告警"),sizeof(ALARMDef.alarmSource));
 	ALARMDef.groupID1 = 1;
 	ALARMDef.groupID2 = 2;
 	//_tcsncpy_s(ALARMDef.alarmContent, _countof(ALARMDef.alarmContent), cstrWarnMsg, cstrWarnMsg.GetLength());
-	//memcpy(ALARMDef.alarmContent,_T("澯"),sizeof(ALARMDef.alarmContent));
+	//memcpy(ALARMDef.alarmContent,_T("产生告警"),sizeof(ALARMDef.alarmContent));
 }
 
-void CAlarmTask::Insert2SMSRECORD(SMSConfigDef iSMSCofig,CString TemplateContent)
+//按场站+告警类型查短信配置，用编译好的模板生成短信内容，交给批量入库线程写TE_SMSRECORD
+void CAlarmTask::AddAlarmSMS(const DeviceInfoData &iDeviceInfo,int AlarmType,const CString &strAlarmTypeName)
 {
-	HANDLE hPipe = OpenRealDataPipe();
-	int ReConnTime = 0;
-	while (hPipe == NULL)
+	SMSConfigMap::const_iterator itCfg = m_SMSConfigMap.find(MAKE_SMSCFG_KEY(iDeviceInfo.iPlazaId,AlarmType));
+	if (itCfg==m_SMSConfigMap.end()||itCfg->second.IsShield!=0)
 	{
-		if (ReConnTime>=3)
-		{
-			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
-			return ;
-		}
-		ReConnTime++;
-		Sleep(1000);
-		hPipe = OpenRealDataPipe();
-
-	}
-	BYTE* pRead = NULL;
-
-	CTime CurTime = CTime::GetCurrentTime();
-
-	CString strSqlFinal = _T("");
-	strSqlFinal.Format(_T("INSERT INTO TE_SMSRECORD VALUES(1,'%s','%s','%s','%d-%d-%d %d:%d:%d',1)"),
-		iSMSCofig.PersonName,iSMSCofig.PhoneNum,TemplateContent,CurTime.GetYear(),CurTime.GetMonth(),
-		CurTime.GetDay(),CurTime.GetHour(),CurTime.GetMinute(),CurTime.GetSecond());
-	ReguTrace(SQL,"ż¼SQL:<%s>",strSqlFinal);
-	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
-	if (pRead)
-	{
-		delete[] pRead;
-		pRead = NULL;
+		return;
 	}
-	if (hPipe != NULL)
+	const SMSConfigDef &iSMSCofig = itCfg->second;
+	CString TemplateContent = _T("");
+	SMSTemplateMap::const_iterator itTemplate = m_SMSTemplateMap.find(iSMSCofig.TemplateNum);
+	if (itTemplate!=m_SMSTemplateMap.end())
 	{
-		CloseHandle(hPipe);
-		hPipe = NULL;
+		CString strFields[SMSFIELD_NUM];
+		strFields[SMSFIELD_OWNER] = iSMSCofig.PersonName;
+		strFields[SMSFIELD_OBJECT].Format(_T("%s%s品牌下的%s"),iDeviceInfo.PlazaName,iDeviceInfo.BrandName,iDeviceInfo.DevName);
+		strFields[SMSFIELD_ALARMTYPE] = strAlarmTypeName;
+		itTemplate->second.Render(strFields,TemplateContent);
 	}
-
+	CTSAlarmServer_WDDlg* pDlg = (CTSAlarmServer_WDDlg*)AfxGetApp()->m_pMainWnd;
+	pDlg->m_pAlarmBatchWriter->AddSmsRecord(iSMSCofig,TemplateContent);
 }
 
+//零点把m_iValidDays天之前的告警交给迁移线程分块移到备份表，本线程不等待迁移完成
 void CAlarmTask::BackupData()
 {
-	HANDLE hPipe = OpenRealDataPipe();
-	int ReConnTime = 0;
-	while (hPipe == NULL)
-	{
-		if (ReConnTime>=3)
-		{
-			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
-			return ;
-		}
-		ReConnTime++;
-		Sleep(1000);
-		hPipe = OpenRealDataPipe();
-
-	}
-	BYTE* pRead = NULL;
 	COleDateTimeSpan DaysSpan;
 	DaysSpan.SetDateTimeSpan(m_iValidDays,0,0,0);
 
 	COleDateTime NowTime = COleDateTime::GetCurrentTime();
 	COleDateTime DelTime = NowTime - DaysSpan;
-	CString cstrBakSql = _T("");
-	//ȱҪɾ
-	cstrBakSql.Format(_T("insert into TE_ALARM_INDEX_BAK select * FROM TE_ALARM_INDEX WHERE ALARMTIME <= '%d-%d-%d'"),DelTime.GetYear(),DelTime.GetMonth(),DelTime.GetDay());
-	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, cstrBakSql);
-	if (pRead)
-	{
-		delete[] pRead;
-		pRead = NULL;
-	}
-	CString cstrDelSql = _T("");
-	cstrDelSql.Format(_T("DELETE FROM TE_ALARM_INDEX WHERE ALARMTIME <= '%d-%d-%d'"),DelTime.GetYear(),DelTime.GetMonth(),DelTime.GetDay());
-	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, cstrDelSql);
-	if (pRead)
-	{
-		delete[] pRead;
-		pRead = NULL;
-	}
-	if (hPipe != NULL)
-	{
-		CloseHandle(hPipe);
-		hPipe = NULL;
-	}
+	CTSAlarmServer_WDDlg* pDlg = (CTSAlarmServer_WDDlg*)AfxGetApp()->m_pMainWnd;
+	pDlg->m_pAlarmArchiver->StartArchive(DelTime);
 }
+//诊断告警交给批量入库线程，同一对象同一类型已有未恢复告警时只更新内容和时间
 void CAlarmTask::AddAlarm2DB(AlarmItemDef ALARMDef)
 {
-	HANDLE hPipe = OpenRealDataPipe();
-	int ReConnTime = 0;
-	while (hPipe == NULL)
-	{
-		if (ReConnTime>=3)
-		{
-			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
-			return ;
-		}
-		ReConnTime++;
-		Sleep(1000);
-		hPipe = OpenRealDataPipe();
-
-	}
-	BYTE* pRead = NULL;
-
-	
-	CString strSql;
-	CTime dt1 = CTime(ALARMDef.alarmTime);
-	CTime dt2 = CTime(ALARMDef.contentTime);
-
-	CString ctrAlarmTime = _T("");
-	ctrAlarmTime.Format(_T("%d-%d-%d %d:%d:%d"),dt1.GetYear(),
-		dt1.GetMonth(),
-		dt1.GetDay(),
-		dt1.GetHour(),
-		dt1.GetMinute(),
-		dt1.GetSecond());
-	CString ctrContentTime = _T("");
-	ctrContentTime.Format(_T("%d-%d-%d %d:%d:%d"),dt2.GetYear(),
-		dt2.GetMonth(),
-		dt2.GetDay(),
-		dt2.GetHour(),
-		dt2.GetMinute(),
-		dt2.GetSecond());
-	CString strAlarmID(ALARMDef.alarmID);
-	strAlarmID.Replace(_T("'"), _T("''"));
-	CString strAlarmTypeName(ALARMDef.alarmTypeName);
-	strAlarmTypeName.Replace(_T("'"), _T("''"));
-	CString strAlarmSource(ALARMDef.alarmSource);
-	strAlarmSource.Replace(_T("'"), _T("''"));
-	CString strAlarmObjName(ALARMDef.alarmObjName);
-	strAlarmObjName.Replace(_T("'"), _T("''"));
-	CString strDevName(ALARMDef.devName);
-	strDevName.Replace(_T("'"), _T("''"));
-	CString strStationName(ALARMDef.stationName);
-	strStationName.Replace(_T("'"), _T("''"));
-	CString strAlarmContent(ALARMDef.alarmContent);
-	strAlarmContent.Replace(_T("'"), _T("''"));
-	CString strPrjName(ALARMDef.projectName);
-	strPrjName.Replace(_T("'"), _T("''"));
-	CString strReserve5(ALARMDef.reserve5);
-	strReserve5.Replace(_T("'"), _T("''"));
-	CString strReserve6(ALARMDef.reserve6);
-	strReserve6.Replace(_T("'"), _T("''"));
-
-
-	strSql.Format(_T("insert into TE_ALARM_INDEX (ID,GROUP1,GROUP2,ALARMTYPE,ALARMTYPENAME,ALARMLEVEL,ALARMSOURCE,ALARMOBJTYPE,PROJECTID,\
-					 SYSTEMID,ALARMOBJID,DEVID,STATIONID,ALARMOBJNAME,DEVNAME,STATIONNAME,ALARMCONTENT,PROJECTNAME,RTALARM,STATUS,ALARMTIME,CONTENTTIME,\
-					 RESERVE1,RESERVE2,RESERVE3,RESERVE4,RESERVE5,RESERVE6) values ('%s',%d,%d,%d,'%s',%d,'%s',%d,%d,%d,%d,%d,%d,'%s','%s','%s','%s','%s',\
-					 %d,%d,'%d-%d-%d %d:%d:%d','%d-%d-%d %d:%d:%d',%d,%d,%f,%f,'%s','%s') "),
-					 strAlarmID,
-					 ALARMDef.groupID1,
-					 ALARMDef.groupID2,
-					 ALARMDef.alarmType,
-					 strAlarmTypeName,
-					 ALARMDef.alarmLevel,
-					 strAlarmSource,
-					 ALARMDef.alarmObjType,
-					 ALARMDef.projectID,
-					 ALARMDef.systemID,
-					 ALARMDef.alarmObjID,
-					 ALARMDef.devID,
-					 ALARMDef.stationID,
-					 strAlarmObjName,
-					 strDevName,
-					 strStationName,
-					 strAlarmContent,
-					 strPrjName,
-					 ALARMDef.rtAlarm,
-					 ALARMDef.status,
-					 dt1.GetYear(),
-					 dt1.GetMonth(),
-					 dt1.GetDay(),
-					 dt1.GetHour(),
-					 dt1.GetMinute(),
-					 dt1.GetSecond(),
-					 dt2.GetYear(),
-					 dt2.GetMonth(),
-					 dt2.GetDay(),
-					 dt2.GetHour(),
-					 dt2.GetMinute(),
-					 dt2.GetSecond(),
-					 ALARMDef.reserve1,
-					 ALARMDef.reserve2,
-					 ALARMDef.reserve3,
-					 ALARMDef.reserve4,
-					 strReserve5,
-					 strReserve6);
-	//*****************************
-	CString strSqlFinal = _T("");
-	strSqlFinal.Format(C_SQL_INSERT_ALARMINDEX,ALARMDef.alarmType,ALARMDef.alarmObjID,ALARMDef.alarmObjType,strSql,strAlarmContent,ctrContentTime,
-		ALARMDef.alarmType,ALARMDef.alarmObjID,ALARMDef.alarmObjType);
-	ReguTrace(SQL,"澯¼SQL:<%s>",strSqlFinal);
-	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
-	if (pRead)
-	{
-		delete[] pRead;
-		pRead = NULL;
-	}
-	if (hPipe != NULL)
-	{
-		CloseHandle(hPipe);
-		hPipe = NULL;
-	}
+	CTSAlarmServer_WDDlg* pDlg = (CTSAlarmServer_WDDlg*)AfxGetApp()->m_pMainWnd;
+	pDlg->m_pAlarmBatchWriter->AddAlarm(ALARMWRITE_UPSERT,ALARMDef);
 
 	//AddRealAlarm(ALARMDef);
 }
@@ -1914,7 +1748,7 @@ void CAlarmTask::UpdateAlarmStatus()
 	BYTE* pRead = NULL;
 	CString strSqlFinal = _T("");
 	strSqlFinal.Format(_T("UPDATE TE_ALARM_INDEX SET STATUS=2 WHERE GROUP2=2 AND CONTENTTIME<'%s';"),ctrContentTime);
-	//ReguTrace(SQL,"澯¼SQL:<%s>",strSqlFinal);
+	//ReguTrace(SQL,"告警记录入库SQL:<%s>",strSqlFinal);
 	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
 	if (pRead)
 	{
@@ -1929,10 +1763,9 @@ void CAlarmTask::UpdateAlarmStatus()
 }
 BOOL CAlarmTask::LoadDayValue(CString strTime,DataType iDataType)
 {
-	int iFdCount = 2;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 2;	//	查询的字段数
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -1958,96 +1791,31 @@ BOOL CAlarmTask::LoadDayValue(CString strTime,DataType iDataType)
 		
 		pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-		if (NULL == pRead)	// δѯ¼
+		if (NULL == pRead)	// 未查询到记录
 		{
 			CloseHandle(hPipe);
 			MYERROR(_T("LoadDayValue pRead null"));
 			return FALSE;
 		}
-		// صĽ
-		NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
-		if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-			//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			MYERROR(_T("LoadDayValue pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB null"));
-			return FALSE;
-		}	
-
-		if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
-		{
-			//MYWARN(_T("յջظģ޷ѯ"));
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			MYERROR(_T("LoadDayValue pNetMessageHead->Length < 1 null"));
-			return FALSE;
-		}
-
-		// ȡѯֶ
-		WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
-		int nFieldNum = (int)*pWord;
-		if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+		// 解析返回的结果，直接在接收缓冲区上按字段偏移读取
+		CRecordSetReader rs;
+		if (!rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), iFdCount))
 		{
 			delete[] pRead;
 			pRead = NULL;
 			CloseHandle(hPipe);
-			MYERROR(_T("LoadDayValue nFieldNum != iFdCount null"));
+			MYERROR(_T("LoadDayValue 返回记录集异常"));
 			return FALSE;
 		}
-		pWord++;
+		DWORD dwRecordNum = (DWORD)rs.GetRecordNum();
 
-		// ¼
-		MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
-		BYTE *pByte = (BYTE*)&pHead[nFieldNum];
-		DWORD dwRecordLen = *((DWORD*)pByte);
-		if (dwRecordLen < 1)
-		{
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return FALSE;
-		}
-		pByte += sizeof(DWORD);
-
-		// ¼
-		DWORD dwRecordNum = *((int*)pByte);
-		if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
-		{
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return FALSE;
-		}
-		pByte += sizeof(DWORD);
-
-		//TCHAR *tValue = new TCHAR[1024+1];
-		//if (tValue == NULL)
-		//{
-		//	//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
-		//	MYERROR(_T("LoadDayValue tValue == NULL"));
-		//	delete[] pRead;
-		//	pRead = NULL;
-		//	CloseHandle(hPipe);
-		//	return FALSE;
-		//}
-
-		// ѯд뵽
-		LZGRECORDSET rs;
-		for (int i=0;i<(int)dwRecordNum;i++)
+		// 将查询结果写入到缓存
+		while (rs.NextRecord())
 		{
 			DevDayValue iDevDayValue;
 			memset(&iDevDayValue,0,sizeof(DevDayValue));
-			rs.clear();
-			memcpy(rs.buf,pByte, pHead->DataLen);
-			int DevId = rs.iRs;
-			pByte += pHead->DataLen;
-
-			rs.clear();
-			memcpy(rs.buf,pByte, (pHead+1)->DataLen);
-			float DayValue = rs.fRs;
-			pByte += (pHead+1)->DataLen;
+			int DevId = rs.GetInt(0);
+			float DayValue = rs.GetFloat(1);
 
 			if (DevId>tempId)
 			{
@@ -2070,20 +1838,20 @@ BOOL CAlarmTask::LoadDayValue(CString strTime,DataType iDataType)
 			
 			m_DevDayValueMap.SetAt(DevId,iDevDayValue);
 		}
+		delete[] pRead;
+		pRead = NULL;
 		if (dwRecordNum<10000)
 		{
 			break;
 		}
 	}
-	delete[] pRead;
-	pRead = NULL;
 	CloseHandle(hPipe);
 	return TRUE;
 }
 
 int CAlarmTask::ExitInstance()
 {
-	// TODO: ڴִ߳
+	// TODO: 在此执行任意逐线程清理
 	return CWinThread::ExitInstance();
 }
 
@@ -2091,4 +1859,4 @@ BEGIN_MESSAGE_MAP(CAlarmTask, CWinThread)
 END_MESSAGE_MAP()
 
 
-// CAlarmTask Ϣ
+// CAlarmTask 消息处理程序
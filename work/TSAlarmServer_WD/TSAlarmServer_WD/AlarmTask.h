@@ -1,12 +1,16 @@
 #pragma once
+#include "SmsTemplate.h"
+#include "AlarmRules.h"
+#include "DiagScheduler.h"
+#include "BillAgeRule.h"
 
 
 
 // CAlarmTask
 enum DataType
 {
-	SUMCOUNT = 1,   //õ
-	MEANELEC		//ƽõ
+	SUMCOUNT = 1,   //当日用电量
+	MEANELEC		//平均用电量
 };
 struct DeviceInfoData
 {
@@ -24,6 +28,7 @@ struct DeviceInfoData
 	TIMESTAMP_STRUCT startTime;
 	TIMESTAMP_STRUCT endTime;
 };
+typedef CMap<int,int,DeviceInfoData,DeviceInfoData&> DeviceInfoMap;
 
 struct DevDayValue
 {
@@ -32,20 +37,47 @@ struct DevDayValue
 	float last7Value;
 };
 
+//每日诊断任务，任务号同时是依赖位的序号
+enum DiagTaskId
+{
+	DIAGTASK_DEVINFO = 0,		//设备信息
+	DIAGTASK_NODEVCONTRACT,		//有合同无表
+	DIAGTASK_SAMPLEDAYCONFIG,	//日采样配置
+	DIAGTASK_DAYVALUE,			//日用电量
+	DIAGTASK_STATION,			//集中器通讯状态
+	DIAGTASK_OVERDRAFT,			//欠费，依赖设备信息
+	DIAGTASK_PROCESSDATA,		//用电规则，依赖设备信息和日用电量
+	DIAGTASK_BILLALARM,			//账龄，依赖设备信息和日采样配置，分片执行
+};
+
+#define DIAG_DEFAULT_WORKERS		3		//诊断工作线程数，同时也是同时打开的管道数上限
+#define DIAG_DEFAULT_BILL_SHARDS	4		//账龄诊断分片数
+#define DIAG_DEFAULT_WINDOW			120		//诊断触发后允许补做的时间(分钟)
+#define DIAG_BACKUP_WINDOW			10		//零点备份允许补做的时间(分钟)
+
 struct DevSampleConfig
 {
 	int iDevId;
 	TCHAR TableName[50];
 	TCHAR ColumnName[50];
 };
+
+//账龄诊断按采样表分组，组内设备为m_vecBillCfgIndex[nFirst,nFirst+nCount)指向的m_DevSampleCfgArray下标
+struct BillTableGroup
+{
+	TCHAR TableName[50];
+	int nFirst;
+	int nCount;
+};
 class CAlarmTask : public CWinThread
 {
 	DECLARE_DYNCREATE(CAlarmTask)
 
 public:
-	CAlarmTask();           // ̬ʹõܱĹ캯
+	CAlarmTask();           // 动态创建所使用的受保护的构造函数
 	virtual ~CAlarmTask();
 	BOOL InitDevInfo();
+	BOOL GetDeviceInfo(int iDevId,DeviceInfoData &iDeviceInfo);
 	BOOL LoadDayValue(CString strTime,DataType iDataType);
 	void ProcessData();
 	void AddAlarm2DB(AlarmItemDef ALARMDef);
@@ -54,33 +86,56 @@ public:
 	void CreateAlarmDef(DeviceInfoData iDeviceInfo,int AlarmType,AlarmItemDef &ALARMDef);
 	BOOL LoadSMSTemplate();
 	BOOL LoadSMSConfig();
-	void Insert2SMSRECORD(SMSConfigDef iSMSCofig,CString TemplateContent);
+	void AddAlarmSMS(const DeviceInfoData &iDeviceInfo,int AlarmType,const CString &strAlarmTypeName);
 	void BackupData();
 	BOOL GetNoDevContract();
 	BOOL GetOverDraft();
 	BOOL GetSampleDayConfig();
-	void CheckBillAlarm();
+	void CheckBillAlarm(int nShard,int nShardNum);
+	BOOL CheckBillTable(HANDLE hPipe,const BillTableGroup &iGroup,int &nAlarmNum);
+	void CheckBillAlarmByDevice(int nShard,int nShardNum);
+	void AddBillAlarm(int iDevId);
+	void GroupBillTables();
 	BOOL LoadStationTable();
 	void CheckDevStateByStationId();
 	void UpdateAlarmStatus();
+	void RunDailyDiagnosis(const SYSTEMTIME &sys_time);
+	BOOL RunDiagTask(int nTaskId,int nShard);
+	static BOOL DiagTaskProc(LPVOID pParam,int nTaskId,int nShard);
+	static LPCTSTR GetDiagTaskName(int nTaskId);
 public:
 	virtual BOOL InitInstance();
 	virtual int ExitInstance();
 public:
 	//CMap<int,int,DeviceInfoData,DeviceInfoData&> m_DeviceInfoMap;
 	vector<DeviceInfoData> m_vecDeviceInfo;
-	CMap<int,int,DeviceInfoData,DeviceInfoData&> m_DeviceInfoMap;
+	//设备信息表，告警接收线程并发查询；InitDevInfo建好新表后在m_csDeviceInfo内替换指针，只能通过GetDeviceInfo访问
+	DeviceInfoMap* m_pDeviceInfoMap;
+	CRITICAL_SECTION m_csDeviceInfo;
 	CMap<int,int,DevDayValue,DevDayValue&> m_DevDayValueMap;
-	CMap<CString,LPCTSTR,SMSConfigDef,SMSConfigDef&> m_SMSConfigMap;
-	CMap<int,int,CString,LPCTSTR> m_SMSTemplateMap;
+	SMSConfigMap m_SMSConfigMap;
+	SMSTemplateMap m_SMSTemplateMap;		//加载时已编译的短信模板
 	CArray<DevSampleConfig,DevSampleConfig&> m_DevSampleCfgArray;
-	CMap<int,int,vector<int>,vector<int>> m_BrandDevMap;
+	vector<BillTableGroup> m_vecBillTable;
+	vector<int> m_vecBillCfgIndex;
+	BOOL m_bBillSetQuery;
 	CArray<short,short&> m_StationArray;
 	int m_MinValue;
 	int m_MaxValue;
 	float m_iMagnifyNum;
 	float m_iReduceNum;
 	int m_iValidDays;
+	float m_fRushMinValue;
+	//ProcessData按m_vecDeviceInfo下标对齐的列数据和规则判断
+	CAlarmRules m_AlarmRules;
+	//每日诊断调度
+	int m_nDiagHour;
+	int m_nDiagMinute;
+	int m_nDiagWindow;
+	int m_nDiagWorkerNum;
+	int m_nBillShardNum;
+	SYSTEMTIME m_DiagTime;
+	CDiagScheduler m_DiagScheduler;
 protected:
 	DECLARE_MESSAGE_MAP()
 };
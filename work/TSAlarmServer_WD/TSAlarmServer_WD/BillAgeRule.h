@@ -0,0 +1,60 @@
+#pragma once
+
+#define BILL_ALARM_DAYS				15		//连续欠费天数
+#define BILL_MAX_COLUMNS			(RECORDSET_MAX_FIELDS-1)	//按表查询时单条语句最多的设备列数(另有TIMEID列)
+
+// CBillAgeRule
+// 按采样表批量查询时的账龄判断：一张表的若干设备列一起取最近nDays个TIMEID，各列在SQL中先折算成
+// 是否欠费(0/1)，在内存中逐列相与，全部为1即连续欠费；表内记录不足nDays条时所有列都不告警。
+// 拼语句和解析应答放在一起，保证两边列序一致。
+//
+// 用法：
+//	CBillAgeRule::BuildQuery(strQuery, szTable, pColumns, nCols, BILL_ALARM_DAYS);
+//	rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), nCols+1);
+//	CBillAgeRule::Evaluate(rs, nCols, BILL_ALARM_DAYS, bAlarm);
+
+class CBillAgeRule
+{
+public:
+	//select top(nDays) TIMEID,<各列欠费标志> from 表 order by TIMEID desc
+	static void BuildQuery(CString &strQuery, LPCTSTR szTableName, const LPCTSTR *pColumns, int nCols, int nDays)
+	{
+		strQuery.Format(_T("select top(%d) TIMEID"),nDays);
+		for (int k=0;k<nCols;k++)
+		{
+			strQuery.AppendFormat(_T(",CASE WHEN %s>0 THEN 1 ELSE 0 END"),pColumns[k]);
+		}
+		strQuery.AppendFormat(_T(" from %s order by TIMEID desc;"),szTableName);
+	}
+
+	//rs已Attach到BuildQuery语句的应答(nCols+1个字段)；pAlarm[k]为第k列是否连续欠费，返回告警列数
+	static int Evaluate(CRecordSetReader &rs, int nCols, int nDays, BOOL *pAlarm)
+	{
+		int k = 0;
+		BOOL bEnough = (rs.GetRecordNum() >= nDays);
+		for (k=0;k<nCols;k++)
+		{
+			pAlarm[k] = bEnough;
+		}
+		if (!bEnough)
+		{
+			return 0;
+		}
+		while (rs.NextRecord())
+		{
+			for (k=0;k<nCols;k++)
+			{
+				pAlarm[k] = pAlarm[k] && rs.GetInt(k+1) != 0;
+			}
+		}
+		int nAlarm = 0;
+		for (k=0;k<nCols;k++)
+		{
+			if (pAlarm[k])
+			{
+				nAlarm++;
+			}
+		}
+		return nAlarm;
+	}
+};
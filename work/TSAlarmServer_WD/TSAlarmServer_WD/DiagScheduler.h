@@ -0,0 +1,203 @@
+#pragma once
+
+#define DIAGTASK_BIT(id)			((DWORD)1<<(id))
+
+enum
+{
+	DIAGSTATE_WAIT = 0,
+	DIAGSTATE_RUNNING,
+	DIAGSTATE_DONE,
+	DIAGSTATE_FAILED,		//执行失败
+	DIAGSTATE_SKIPPED,		//因依赖失败未执行，对依赖它的任务同失败
+};
+
+#define DIAG_MAX_TASKS				32
+#define DIAG_MAX_WORKERS			8
+
+struct DiagTask
+{
+	int nTaskId;
+	int nShard;
+	DWORD dwDepends;		//依赖的任务位
+	int nState;
+};
+
+//执行一个任务，返回是否成功
+typedef BOOL (*DIAGTASK_PROC)(LPVOID pParam, int nTaskId, int nShard);
+
+// CDiagScheduler
+// 每日诊断任务表：各加载/诊断步骤按依赖关系登记为任务，由若干工作线程并发执行。
+// 任务号同时是依赖位的序号，同一任务号可以登记多个分片，全部分片完成才算该任务完成，
+// 任一分片失败即算失败，依赖它的任务不再执行。任务完成时释放信号量，唤醒等待依赖的工作线程。
+//
+// 用法：
+//	scheduler.Reset();
+//	scheduler.AddTask(TASK_A, 0, 0);
+//	scheduler.AddTask(TASK_B, 0, DIAGTASK_BIT(TASK_A));
+//	scheduler.Run(nWorkers, RunTaskProc, this);
+
+class CDiagScheduler
+{
+public:
+	CDiagScheduler()
+	{
+		m_nTaskNum = 0;
+		m_nWorkerNum = 1;
+		m_pfnRun = NULL;
+		m_pParam = NULL;
+		InitializeCriticalSection(&m_csDiag);
+		m_hSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	}
+
+	~CDiagScheduler()
+	{
+		CloseHandle(m_hSemaphore);
+		DeleteCriticalSection(&m_csDiag);
+	}
+
+	void Reset()
+	{
+		m_nTaskNum = 0;
+	}
+
+	void AddTask(int nTaskId, int nShard, DWORD dwDepends)
+	{
+		if (m_nTaskNum >= DIAG_MAX_TASKS)
+		{
+			return;
+		}
+		DiagTask &iTask = m_Tasks[m_nTaskNum++];
+		iTask.nTaskId = nTaskId;
+		iTask.nShard = nShard;
+		iTask.dwDepends = dwDepends;
+		iTask.nState = DIAGSTATE_WAIT;
+	}
+
+	int GetTaskNum() const
+	{
+		return m_nTaskNum;
+	}
+
+	const DiagTask &GetTask(int nIndex) const
+	{
+		return m_Tasks[nIndex];
+	}
+
+	//用nWorkers个工作线程执行全部任务，返回时所有任务都已结束；线程创建失败时在本线程顺序执行
+	void Run(int nWorkers, DIAGTASK_PROC pfnRun, LPVOID pParam)
+	{
+		if (nWorkers <= 0 || nWorkers > DIAG_MAX_WORKERS)
+		{
+			nWorkers = 1;
+		}
+		m_nWorkerNum = nWorkers;
+		m_pfnRun = pfnRun;
+		m_pParam = pParam;
+		CWinThread* pWorkers[DIAG_MAX_WORKERS];
+		int nStarted = 0;
+		for (int i=0;i<nWorkers;i++)
+		{
+			CWinThread* pThread = AfxBeginThread(WorkerProc, this, THREAD_PRIORITY_NORMAL, 0, CREATE_SUSPENDED);
+			if (pThread == NULL)
+			{
+				continue;
+			}
+			pThread->m_bAutoDelete = FALSE;
+			pThread->ResumeThread();
+			pWorkers[nStarted++] = pThread;
+		}
+		if (nStarted == 0)
+		{
+			WorkerProc(this);
+		}
+		for (int i=0;i<nStarted;i++)
+		{
+			WaitForSingleObject(pWorkers[i]->m_hThread, INFINITE);
+			delete pWorkers[i];
+		}
+	}
+
+	//取一个依赖已完成的任务；依赖失败的任务置为DIAGSTATE_SKIPPED；全部结束返回-1
+	int Take()
+	{
+		while (1)
+		{
+			BOOL bPending = FALSE;
+			EnterCriticalSection(&m_csDiag);
+			DWORD dwAll = 0, dwNotDone = 0, dwFailed = 0;
+			int i = 0;
+			for (i=0;i<m_nTaskNum;i++)
+			{
+				DWORD dwBit = DIAGTASK_BIT(m_Tasks[i].nTaskId);
+				dwAll |= dwBit;
+				if (m_Tasks[i].nState!=DIAGSTATE_DONE)
+				{
+					dwNotDone |= dwBit;
+				}
+				if (m_Tasks[i].nState==DIAGSTATE_FAILED||m_Tasks[i].nState==DIAGSTATE_SKIPPED)
+				{
+					dwFailed |= dwBit;
+				}
+			}
+			DWORD dwDone = dwAll & ~dwNotDone;
+			for (i=0;i<m_nTaskNum;i++)
+			{
+				DiagTask &iTask = m_Tasks[i];
+				if (iTask.nState==DIAGSTATE_WAIT&&(iTask.dwDepends&dwFailed))
+				{
+					iTask.nState = DIAGSTATE_SKIPPED;
+					ReleaseSemaphore(m_hSemaphore, m_nWorkerNum, NULL);
+					continue;
+				}
+				if (iTask.nState==DIAGSTATE_WAIT&&(iTask.dwDepends&dwDone)==iTask.dwDepends)
+				{
+					iTask.nState = DIAGSTATE_RUNNING;
+					LeaveCriticalSection(&m_csDiag);
+					return i;
+				}
+				if (iTask.nState==DIAGSTATE_WAIT||iTask.nState==DIAGSTATE_RUNNING)
+				{
+					bPending = TRUE;
+				}
+			}
+			LeaveCriticalSection(&m_csDiag);
+			if (!bPending)
+			{
+				return -1;
+			}
+			//等待其他任务完成
+			WaitForSingleObject(m_hSemaphore, 1000);
+		}
+	}
+
+	void Finish(int nIndex, BOOL bResult)
+	{
+		EnterCriticalSection(&m_csDiag);
+		m_Tasks[nIndex].nState = bResult ? DIAGSTATE_DONE : DIAGSTATE_FAILED;
+		LeaveCriticalSection(&m_csDiag);
+		ReleaseSemaphore(m_hSemaphore, m_nWorkerNum, NULL);
+	}
+
+protected:
+	static UINT WorkerProc(LPVOID pParam)
+	{
+		CDiagScheduler *pScheduler = (CDiagScheduler*)pParam;
+		int nIndex = -1;
+		while ((nIndex = pScheduler->Take()) >= 0)
+		{
+			int nTaskId = pScheduler->m_Tasks[nIndex].nTaskId;
+			int nShard = pScheduler->m_Tasks[nIndex].nShard;
+			BOOL bResult = pScheduler->m_pfnRun(pScheduler->m_pParam, nTaskId, nShard);
+			pScheduler->Finish(nIndex, bResult);
+		}
+		return 0;
+	}
+
+	DiagTask m_Tasks[DIAG_MAX_TASKS];
+	int m_nTaskNum;
+	int m_nWorkerNum;
+	DIAGTASK_PROC m_pfnRun;
+	LPVOID m_pParam;
+	CRITICAL_SECTION m_csDiag;
+	HANDLE m_hSemaphore;
+};
@@ -1,4 +1,4 @@
-// MessageTask.cpp : ʵļ
+// MessageTask.cpp : 实现文件
 //
 
 #include "stdafx.h"
@@ -19,21 +19,86 @@ CMessageTask::CMessageTask()
 	{
 		g_log = new CLog(_T("\\TSAlarmServer"));
 	}
+	LoadSendConfig();
+	m_nNextMsg = 0;
+	m_nActiveWorkers = 0;
+	m_nRetryCount = 0;
+	m_hSendSemaphore = CreateSemaphore(NULL, 0, MSGSEND_MAX_WORKERS, NULL);
+	m_hSendDoneEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_hExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	memset(m_pSendThreads,0,sizeof(m_pSendThreads));
+	m_bStopWorkers = FALSE;
 }
 
 CMessageTask::~CMessageTask()
 {
+	//发送线程还在等待m_hSendSemaphore时不能关闭它
+	StopWorkers();
+	BOOL bAllStopped = TRUE;
+	for (int i=0;i<MSGSEND_MAX_WORKERS;i++)
+	{
+		if (m_pSendThreads[i] != NULL)
+		{
+			bAllStopped = FALSE;
+		}
+	}
+	if (bAllStopped)
+	{
+		CloseHandle(m_hSendSemaphore);
+		CloseHandle(m_hSendDoneEvent);
+	}
+	CloseHandle(m_hExitEvent);
+}
+
+//通知扫描线程退出，扫描线程发完本轮信息后停止发送线程
+void CMessageTask::Stop()
+{
+	SetEvent(m_hExitEvent);
+}
+
+//唤醒全部发送线程退出并等待其结束；超时未结束的线程对象保留在m_pSendThreads中，析构时据此不关闭其使用的句柄
+void CMessageTask::StopWorkers()
+{
+	int nThreads = 0;
+	HANDLE hThreads[MSGSEND_MAX_WORKERS];
+	for (int i=0;i<MSGSEND_MAX_WORKERS;i++)
+	{
+		if (m_pSendThreads[i] != NULL)
+		{
+			hThreads[nThreads++] = m_pSendThreads[i]->m_hThread;
+		}
+	}
+	if (nThreads == 0)
+	{
+		return;
+	}
+	m_bStopWorkers = TRUE;
+	ReleaseSemaphore(m_hSendSemaphore,nThreads,NULL);
+	DWORD dwWait = WaitForMultipleObjects(nThreads,hThreads,TRUE,MSGSEND_EXIT_TIMEOUT);
+	if (dwWait < WAIT_OBJECT_0 || dwWait >= WAIT_OBJECT_0+nThreads)
+	{
+		ReguTrace(ERRO,"信息发送线程%dms内未全部退出",MSGSEND_EXIT_TIMEOUT);
+		return;
+	}
+	for (int i=0;i<MSGSEND_MAX_WORKERS;i++)
+	{
+		if (m_pSendThreads[i] != NULL)
+		{
+			delete m_pSendThreads[i];
+			m_pSendThreads[i] = NULL;
+		}
+	}
 }
 
 BOOL CMessageTask::InitMesInfo()
 {
 	m_vecMesInfo.clear();
 	//m_MesInfoMap.RemoveAll();
-	int iFdCount = 4;	    //ѯֶ 
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 4;	    //查询的字段数 
+	int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -48,17 +113,17 @@ BOOL CMessageTask::InitMesInfo()
 	CString strQuery = _T("");
 	strQuery.Format(C_SQL_QUERY_MESINFO);
 	pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
-	ReguTrace(SQL,"serverӿsql=%s!",strQuery);
-	if (NULL == pRead)	// δѯ¼
+	ReguTrace(SQL,"调用server接口sql=%s!",strQuery);
+	if (NULL == pRead)	// 未查询到记录
 	{
 		CloseHandle(hPipe);
 		MYERROR(_T("InitMesInfo pRead null"));
 		return FALSE;
 	}
-	// صĽ
+	// 解析返回的结果
 	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-		//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+		//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -66,9 +131,9 @@ BOOL CMessageTask::InitMesInfo()
 		return FALSE;
 	}	
 
-	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+	if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 	{
-		//MYWARN(_T("յջظģ޷ѯ"));
+		//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -76,12 +141,12 @@ BOOL CMessageTask::InitMesInfo()
 		return FALSE;
 	}
 
-	// ȡѯֶ
+	// 获取查询的字段数
 	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 	int nFieldNum = (int)*pWord;
-	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	if (nFieldNum != iFdCount)	// 查询字段数量，不相等，查询结果异常退出
 	{
-		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+		//	MYWARN(_T("查询字段数量，不相等，查询结果异常退出"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -90,7 +155,7 @@ BOOL CMessageTask::InitMesInfo()
 	}
 	pWord++;
 
-	// ¼
+	// 记录集长度
 	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 	DWORD dwRecordLen = *((DWORD*)pByte);
@@ -103,7 +168,7 @@ BOOL CMessageTask::InitMesInfo()
 	}
 	pByte += sizeof(DWORD);
 
-	// ¼
+	// 记录数
 	DWORD dwRecordNum = *((int*)pByte);
 	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 	{
@@ -117,7 +182,7 @@ BOOL CMessageTask::InitMesInfo()
 	TCHAR *tValue = new TCHAR[1024+1];
 	if (tValue == NULL)
 	{
-		//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
+		//MYERROR(_T("分配内存错误，错误码：%d"),GetLastError());
 		MYERROR(_T("InitMesInfo tValue == NULL"));
 		delete[] pRead;
 		pRead = NULL;
@@ -125,7 +190,7 @@ BOOL CMessageTask::InitMesInfo()
 		return FALSE;
 	}
 
-	// ѯд뵽
+	// 将查询结果写入到缓存
 
 	//LZGRECORDSET rs;
 	for (int i=0;i<(int)dwRecordNum;i++)
@@ -141,7 +206,7 @@ BOOL CMessageTask::InitMesInfo()
 		iMessageInfo.Dataid = (int)*((DWORD *)tValue);
 		pByte += pHead->DataLen;
          
-	   // target*ϢĿ˵RTXNOֻ߽
+	   // target：*信息目标接收人的RTXNO或者接收人手机号
 		ZeroMemory(tValue,1024+1);
 		
 		CString CTxStr = _T("");
@@ -149,13 +214,13 @@ BOOL CMessageTask::InitMesInfo()
        //const TCHAR* ctxNum=_T("v_zhanglin");
 	   //memcpy(iMessageInfo.target_Ctx,ctxNum,sizeof(TCHAR)*10);
 		memcpy(tValue, pByte, (pHead+1)->DataLen);
-		CTxStr.Format(_T("%s"),tValue);           //CTX
+		CTxStr.Format(_T("%s"),tValue);           //存CTX号
 		pByte += (pHead+1)->DataLen;
 		
 		CString PhoneNumStr = _T("");
 		iMessageInfo.bCtxFlag=0;
 		memcpy(tValue, pByte, (pHead+2)->DataLen);
-		PhoneNumStr.Format(_T("%s"),tValue);      //ֻ
+		PhoneNumStr.Format(_T("%s"),tValue);      //存手机号
         pByte += (pHead+2)->DataLen;
 		
 		if (!CTxStr.IsEmpty())
@@ -170,11 +235,11 @@ BOOL CMessageTask::InitMesInfo()
 			memcpy(iMessageInfo.target_Phone,PhoneNumStr.GetBuffer(),PhoneNumStr.GetLength()*sizeof(TCHAR));
 		}
      
-       // msTitle :*Ϣı⣬Ϊ""
-        const TCHAR* msTitle=_T("ܵƽ̨");
+       // msTitle :*发送信息的标题，标题可为""
+        const TCHAR* msTitle=_T("智能电表管理平台");
 		memcpy(iMessageInfo.msTitle,msTitle,sizeof(TCHAR)*20);
 
-	   //TCHAR msContent[1024];   *ݣϢݲܳ500
+	   //TCHAR msContent[1024];   *发送内容，信息内容不能超过500个字
 		ZeroMemory(tValue,1024+1);
 		memcpy(tValue, pByte, (pHead+3)->DataLen);
 		memcpy(iMessageInfo.msContent,tValue,sizeof(TCHAR)*500);
@@ -184,17 +249,8 @@ BOOL CMessageTask::InitMesInfo()
 		memcpy(iMessageInfo.priority,priority,sizeof(TCHAR)*1);
 	
 
-        BOOL nResult = SendMessageProcess(iMessageInfo);
-		if (nResult)
-		{
-            MYERROR(_T("ŷͳɹ"));
-			iMessageInfo.bFlag = TRUE;		
-		}
-		else
-		{
-			MYERROR(_T("ŷʧ"));
-			iMessageInfo.bFlag = FALSE;		
-		}     
+		//发送结果由DispatchMessages填写
+		iMessageInfo.bFlag = FALSE;
 		m_vecMesInfo.push_back(iMessageInfo);
 	}
 	delete []tValue;
@@ -208,17 +264,35 @@ BOOL CMessageTask::InitMesInfo()
 
 BOOL CMessageTask::InitInstance()
 {
-	// TODO: ڴִ̳߳ʼ
+	// TODO: 在此执行任意逐线程初始化
 	int retimes=0;
+	//启动发送线程，每个线程持有一个长连接；退出时要等待线程结束，线程对象不自动删除
+	int nWorkers = 0;
+	for (int i=0;i<m_nWorkerNum;i++)
+	{
+		CWinThread* pThread = AfxBeginThread(SendWorkerProc, this, THREAD_PRIORITY_NORMAL, 0, CREATE_SUSPENDED);
+		if (pThread != NULL)
+		{
+			pThread->m_bAutoDelete = FALSE;
+			pThread->ResumeThread();
+			m_pSendThreads[nWorkers++] = pThread;
+		}
+	}
+	if (nWorkers == 0)
+	{
+		ReguTrace(ERRO,"信息发送线程启动失败");
+		return FALSE;
+	}
+	m_nWorkerNum = nWorkers;
 	while(1)
 	{
 		if (!InitMesInfo())
 		{
 
-			if (retimes>=3)    //  edit by  list  κԱ˳
+			if (retimes>=3)    //  edit by  list  重试三次后仍报错，退出
 			{
 				ReguTrace(ERRO,"InitMesInfo ERRO return");
-				exit(EXIT_FAILURE);  //˳Ź
+				exit(EXIT_FAILURE);  //无条件退出，看门狗会重启程序
 				//return FALSE;
 			}
 			retimes++;
@@ -226,12 +300,16 @@ BOOL CMessageTask::InitInstance()
 		}	
 		if(m_vecMesInfo.size()>0)  
 		{
+			DispatchMessages();
 			UpdateMsToDB();
 		}
-		Sleep(20000);  
-
+		if (WaitForSingleObject(m_hExitEvent,m_nSendInterval) == WAIT_OBJECT_0)
+		{
+			break;
+		}
 	}	
-	return TRUE;
+	StopWorkers();
+	return FALSE;
 
 
 	//while(1)
@@ -253,7 +331,7 @@ BOOL CMessageTask::InitInstance()
 
 int CMessageTask::ExitInstance()
 {
-	// TODO: ڴִ߳
+	// TODO: 在此执行任意逐线程清理
 	return CWinThread::ExitInstance();
 }
 
@@ -267,19 +345,125 @@ BOOL CMessageTask::TChar2Char(const TCHAR* pTchar, char* pChar)
 	WideCharToMultiByte(CP_ACP, 0, pTchar, -1, pChar, iASCIILen, NULL, NULL);
 	return TRUE;
 }
-// MessageTask Ϣ
-BOOL CMessageTask::SendMessageProcess(MesInfoData& iMessageInfo)
-{	
-	struct soap add_soap2;
+// MessageTask 消息处理程序
+
+//发送参数从emscfg.ini的[SMSSEND]段读取
+void CMessageTask::LoadSendConfig()
+{
+	m_nWorkerNum = MSGSEND_DEFAULT_WORKERS;
+	m_nRatePerSec = MSGSEND_DEFAULT_RATE;
+	m_nRetry = MSGSEND_DEFAULT_RETRY;
+	m_nRetryDelay = MSGSEND_DEFAULT_RETRYDELAY;
+	m_nSendInterval = MSGSEND_DEFAULT_INTERVAL;
+	TCHAR szDirectory[MAX_PATH];
+	memset(szDirectory,0,sizeof(TCHAR)*MAX_PATH);
+	if (GetModuleFileName(NULL,szDirectory,MAX_PATH))
+	{
+		CString strPath = szDirectory;
+		int iIndex = strPath.ReverseFind('\\');
+		if (iIndex > 0)
+		{
+			CString strCountPath = strPath.Left(iIndex) + _T("\\parameter\\emscfg.ini");
+			m_nWorkerNum = GetPrivateProfileInt(_T("SMSSEND"),_T("Workers"),MSGSEND_DEFAULT_WORKERS,strCountPath);
+			m_nRatePerSec = GetPrivateProfileInt(_T("SMSSEND"),_T("RatePerSec"),MSGSEND_DEFAULT_RATE,strCountPath);
+			m_nRetry = GetPrivateProfileInt(_T("SMSSEND"),_T("Retry"),MSGSEND_DEFAULT_RETRY,strCountPath);
+			m_nRetryDelay = GetPrivateProfileInt(_T("SMSSEND"),_T("RetryDelay"),MSGSEND_DEFAULT_RETRYDELAY,strCountPath);
+			m_nSendInterval = GetPrivateProfileInt(_T("SMSSEND"),_T("SendInterval"),MSGSEND_DEFAULT_INTERVAL,strCountPath);
+		}
+	}
+	if (m_nWorkerNum <= 0 || m_nWorkerNum > MSGSEND_MAX_WORKERS)
+	{
+		m_nWorkerNum = MSGSEND_DEFAULT_WORKERS;
+	}
+	//RatePerSec<=0表示不限速
+	if (m_nRetry < 0 || m_nRetry > 8)
+	{
+		m_nRetry = MSGSEND_DEFAULT_RETRY;
+	}
+	if (m_nRetryDelay <= 0)
+	{
+		m_nRetryDelay = MSGSEND_DEFAULT_RETRYDELAY;
+	}
+	if (m_nSendInterval <= 0)
+	{
+		m_nSendInterval = MSGSEND_DEFAULT_INTERVAL;
+	}
+	for (int i=0;i<MSGENDPOINT_NUM;i++)
+	{
+		m_SendPacer[i].SetRate(m_nRatePerSec);
+	}
+}
+
+//发送线程：持有一个长连接的gSOAP上下文，每轮被唤醒后从m_vecMesInfo中依次取信息发送，直到取完
+UINT CMessageTask::SendWorkerProc(LPVOID pParam)
+{
+	CMessageTask *pTask = (CMessageTask*)pParam;
+	struct soap iSoap;
+	soap_init2(&iSoap,SOAP_IO_KEEPALIVE,SOAP_IO_KEEPALIVE);
+	soap_set_mode(&iSoap,SOAP_C_MBSTRING);
+	iSoap.connect_timeout = MSGSEND_SOAP_TIMEOUT;
+	iSoap.send_timeout = MSGSEND_SOAP_TIMEOUT;
+	iSoap.recv_timeout = MSGSEND_SOAP_TIMEOUT;
+	while (WaitForSingleObject(pTask->m_hSendSemaphore,INFINITE) == WAIT_OBJECT_0)
+	{
+		if (pTask->m_bStopWorkers)
+		{
+			break;
+		}
+		LONG nIndex = 0;
+		while ((nIndex = InterlockedIncrement(&pTask->m_nNextMsg) - 1) < (LONG)pTask->m_vecMesInfo.size())
+		{
+			MesInfoData &iMessageInfo = pTask->m_vecMesInfo[nIndex];
+			iMessageInfo.bFlag = pTask->SendMessageProcess(&iSoap,iMessageInfo);
+		}
+		if (InterlockedDecrement(&pTask->m_nActiveWorkers) == 0)
+		{
+			SetEvent(pTask->m_hSendDoneEvent);
+		}
+	}
+	soap_done(&iSoap);
+	return 0;
+}
+
+//唤醒全部发送线程发送本轮m_vecMesInfo中的信息，全部发完后返回
+void CMessageTask::DispatchMessages()
+{
+	if (m_vecMesInfo.empty())
+	{
+		return;
+	}
+	DWORD dwBegin = GetTickCount();
+	m_nNextMsg = 0;
+	m_nActiveWorkers = m_nWorkerNum;
+	m_nRetryCount = 0;
+	ResetEvent(m_hSendDoneEvent);
+	ReleaseSemaphore(m_hSendSemaphore,m_nWorkerNum,NULL);
+	WaitForSingleObject(m_hSendDoneEvent,INFINITE);
+
+	int nSuccess = 0;
+	for (size_t i=0;i<m_vecMesInfo.size();i++)
+	{
+		if (m_vecMesInfo[i].bFlag)
+		{
+			nSuccess++;
+		}
+	}
+	DWORD dwSpan = GetTickCount() - dwBegin;
+	int nTotal = (int)m_vecMesInfo.size();
+	ReguTrace(Config,"信息发送:共%d条,成功%d条,失败%d条,重试%d次,发送线程%d个,耗时%dms,%.1f条/秒",
+		nTotal,nSuccess,nTotal-nSuccess,m_nRetryCount,m_nWorkerNum,dwSpan,dwSpan>0?nTotal*1000.0/dwSpan:(double)nTotal);
+}
+
+//调用一个接口，通讯错误时关闭连接并按m_nRetryDelay、2倍、4倍...退避重试(见CSendPacer::GetRetryDelay)；接口返回非OK不重试
+int CMessageTask::CallEndpoint(struct soap *pSoap, int nEndpoint, MesInfoData& iMessageInfo)
+{
 	char szContent[2048];
 	memset(szContent,0,2048);
 	char* pTmp = szContent;
 	TChar2Char(iMessageInfo.fromSys,pTmp);
 	std::string sFromSys(pTmp);
-	TChar2Char(iMessageInfo.target_Ctx,pTmp);
-	std::string sCtxTarget(pTmp);
-	TChar2Char(iMessageInfo.target_Phone,pTmp);
-	std::string sPhoneTarget(pTmp);
+	TChar2Char(nEndpoint==MSGENDPOINT_SMS?iMessageInfo.target_Phone:iMessageInfo.target_Ctx,pTmp);
+	std::string sTarget(pTmp);
 	TChar2Char(iMessageInfo.msTitle,pTmp);
 	std::string sTitle(pTmp);
 	TChar2Char(iMessageInfo.msContent,pTmp);
@@ -288,132 +472,132 @@ BOOL CMessageTask::SendMessageProcess(MesInfoData& iMessageInfo)
 	std::string stargetTime(pTmp);
 	TChar2Char(iMessageInfo.priority,pTmp);
 	std::string spriority(pTmp);
-     //
-	_ns1__SetSMSInfoC _ns1__SetSMSinfoC;
-	_ns1__SetSMSInfoCResponse _ns1__SetSMSinfoCResponse;	
-	_ns1__SetSMSinfoC.fromSys=&sFromSys;
-	_ns1__SetSMSinfoC.target=&sPhoneTarget;
-	_ns1__SetSMSinfoC.msTitle=&sTitle;
-	_ns1__SetSMSinfoC.msContent=&smsContent;
-	_ns1__SetSMSinfoC.targetTime=& stargetTime;
-	_ns1__SetSMSinfoC.priority=&spriority;
-
-   //CTX
-	_ns1__SetRTXInfoC _ns1__SetRTXinfoC;
-	_ns1__SetRTXInfoCResponse _ns1__SetRTXinfoCResponse;
-	_ns1__SetRTXinfoC.fromSys=&sFromSys;
-	_ns1__SetRTXinfoC.target=&sCtxTarget;
-	_ns1__SetRTXinfoC.msTitle=&sTitle;
-	_ns1__SetRTXinfoC.msContent=&smsContent;
-	_ns1__SetRTXinfoC.targetTime=& stargetTime;
-	_ns1__SetRTXinfoC.priority=&spriority;
-
-	soap_init(&add_soap2);
-	soap_set_mode(&add_soap2,SOAP_C_MBSTRING);
-	add_soap2.mode|=SOAP_C_MBSTRING;
-    
-	if(iMessageInfo.bCtxFlag==TRUE && iMessageInfo.bPhoneFlag==FALSE)
-	{
-		//CTX
-       soap_call___ns1__SetRTXInfoC(&add_soap2,NULL,NULL,&_ns1__SetRTXinfoC,&_ns1__SetRTXinfoCResponse);
-	   std::string sRetRTX;
-	   sRetRTX=_ns1__SetRTXinfoCResponse.SetRTXInfoCResult->c_str();
-	   soap_end(&add_soap2);
-	   soap_done(&add_soap2);
-	   //жϣʧҪط
-	   if(add_soap2.error)
-	   {
-		   soap_end(&add_soap2);
-		   soap_done(&add_soap2);
-		   ReguTrace(Config,"CTXŷͽӿʧ");
-		   return false;
-	   }
-	   //
-	   if (strcmp(sRetRTX.c_str(),"OK") == 0)
-	   {
-		   ReguTrace(Config,"CTXŷͳɹ");
-		   return TRUE;
-	   }
-	   else
-	   {
-		   ReguTrace(Config,"CTXŷʧ");
-		   return FALSE;
-	   }      
-	}
-	if(iMessageInfo.bPhoneFlag ==TRUE && iMessageInfo.bCtxFlag == FALSE)
-	{
-		//ͶϢ
-	  soap_call___ns1__SetSMSInfoC(&add_soap2,NULL,NULL,&_ns1__SetSMSinfoC,&_ns1__SetSMSinfoCResponse);
-	  std::string sRetSMS;
-	  sRetSMS=_ns1__SetSMSinfoCResponse.SetSMSInfoCResult->c_str();
-	  soap_end(&add_soap2);
-	  soap_done(&add_soap2);
-
-	  //жϣʧҪط
-	  if(add_soap2.error)
-	  {
-		  soap_end(&add_soap2);
-		  soap_done(&add_soap2);
-		  ReguTrace(Config,"öŷͽӿʧ");
-		  return false;
-	  }
-	  //
-	  if (strcmp(sRetSMS.c_str(),"OK") == 0)
-	  {
-		  ReguTrace(Config,"ŷͳɹ");
-		  return TRUE;
-	  }
-	  else
-	  {
-		  ReguTrace(Config,"ŷʧ");
-		  return FALSE;
-	  }
-	}
-	if (iMessageInfo.bPhoneFlag==TRUE && iMessageInfo.bCtxFlag==TRUE)
-	{		
-		//ͶϢ
-		soap_call___ns1__SetSMSInfoC(&add_soap2,NULL,NULL,&_ns1__SetSMSinfoC,&_ns1__SetSMSinfoCResponse);
-		//CTXϢ
-		soap_call___ns1__SetRTXInfoC(&add_soap2,NULL,NULL,&_ns1__SetRTXinfoC,&_ns1__SetRTXinfoCResponse);
-		//жϣʧҪط
-		if(add_soap2.error)
+
+	int nResult = MSGSEND_ERROR;
+	for (int nTry=0;nTry<=m_nRetry;nTry++)
+	{
+		if (nTry > 0)
 		{
-			soap_end(&add_soap2);
-			soap_done(&add_soap2);
-			ReguTrace(Config,"öŷͽӿʧ");
-			return false;
+			InterlockedIncrement(&m_nRetryCount);
+			Sleep(CSendPacer::GetRetryDelay(m_nRetryDelay,nTry));
 		}
-		std::string sRetSMS;
-		sRetSMS=_ns1__SetSMSinfoCResponse.SetSMSInfoCResult->c_str();
-
-		std::string sRetRTX;
-		sRetRTX=_ns1__SetRTXinfoCResponse.SetRTXInfoCResult->c_str();
-
-		soap_end(&add_soap2);
-		soap_done(&add_soap2);
-
-		//
-		if (strcmp(sRetSMS.c_str(),"OK") == 0||strcmp(sRetRTX.c_str(),"OK") == 0)
+		m_SendPacer[nEndpoint].Wait();
+		std::string sRet;
+		if (nEndpoint == MSGENDPOINT_SMS)
 		{
-			ReguTrace(Config,"ŷͳɹ");
-			return TRUE;
+			//短信
+			_ns1__SetSMSInfoC _ns1__SetSMSinfoC;
+			_ns1__SetSMSInfoCResponse _ns1__SetSMSinfoCResponse;
+			_ns1__SetSMSinfoC.fromSys=&sFromSys;
+			_ns1__SetSMSinfoC.target=&sTarget;
+			_ns1__SetSMSinfoC.msTitle=&sTitle;
+			_ns1__SetSMSinfoC.msContent=&smsContent;
+			_ns1__SetSMSinfoC.targetTime=&stargetTime;
+			_ns1__SetSMSinfoC.priority=&spriority;
+			if (soap_call___ns1__SetSMSInfoC(pSoap,NULL,NULL,&_ns1__SetSMSinfoC,&_ns1__SetSMSinfoCResponse) == SOAP_OK
+				&& _ns1__SetSMSinfoCResponse.SetSMSInfoCResult != NULL)
+			{
+				sRet = *_ns1__SetSMSinfoCResponse.SetSMSInfoCResult;
+			}
 		}
 		else
 		{
-			ReguTrace(Config,"ŷʧ");
-			return FALSE;
+			//CTX短信
+			_ns1__SetRTXInfoC _ns1__SetRTXinfoC;
+			_ns1__SetRTXInfoCResponse _ns1__SetRTXinfoCResponse;
+			_ns1__SetRTXinfoC.fromSys=&sFromSys;
+			_ns1__SetRTXinfoC.target=&sTarget;
+			_ns1__SetRTXinfoC.msTitle=&sTitle;
+			_ns1__SetRTXinfoC.msContent=&smsContent;
+			_ns1__SetRTXinfoC.targetTime=&stargetTime;
+			_ns1__SetRTXinfoC.priority=&spriority;
+			if (soap_call___ns1__SetRTXInfoC(pSoap,NULL,NULL,&_ns1__SetRTXinfoC,&_ns1__SetRTXinfoCResponse) == SOAP_OK
+				&& _ns1__SetRTXinfoCResponse.SetRTXInfoCResult != NULL)
+			{
+				sRet = *_ns1__SetRTXinfoCResponse.SetRTXInfoCResult;
+			}
 		}
+		int nError = pSoap->error;
+		//释放本次调用反序列化的数据，连接保留给下一次调用
+		soap_end(pSoap);
+		if (nError == SOAP_OK)
+		{
+			nResult = (strcmp(sRet.c_str(),"OK") == 0) ? MSGSEND_OK : MSGSEND_REJECT;
+			break;
+		}
+		soap_closesock(pSoap);
+		ReguTrace(Config,"调用%s接口失败,错误码%d,ID=%d,第%d次",nEndpoint==MSGENDPOINT_SMS?_T("短信"):_T("CTX"),
+			nError,iMessageInfo.Dataid,nTry+1);
 	}
+	return nResult;
+}
+
+BOOL CMessageTask::SendMessageProcess(struct soap *pSoap, MesInfoData& iMessageInfo)
+{
 	if (iMessageInfo.bPhoneFlag==FALSE&&iMessageInfo.bCtxFlag==FALSE)
 	{
-		//¼
-        ReguTrace(Config,"ݿм¼");
+		//记录不存在
+		ReguTrace(Config,"数据库中记录不存在");
 		return FALSE;
-	}	
-	return TRUE;
+	}
+	int nSMSResult = MSGSEND_REJECT;
+	int nRTXResult = MSGSEND_REJECT;
+	if (iMessageInfo.bPhoneFlag == TRUE)
+	{
+		nSMSResult = CallEndpoint(pSoap,MSGENDPOINT_SMS,iMessageInfo);
+	}
+	if (iMessageInfo.bCtxFlag == TRUE)
+	{
+		nRTXResult = CallEndpoint(pSoap,MSGENDPOINT_RTX,iMessageInfo);
+	}
+	//两个接口都调用时任一成功即算发送成功
+	if (nSMSResult == MSGSEND_OK || nRTXResult == MSGSEND_OK)
+	{
+		ReguTrace(Config,"短信发送成功 ID=%d",iMessageInfo.Dataid);
+		return TRUE;
+	}
+	ReguTrace(Config,"短信发送失败 ID=%d",iMessageInfo.Dataid);
+	return FALSE;
 }
+
+//本轮发送成功的ID按MSGUPDATE_MAX_IDS个一组生成UPDATE语句，一次提交
 void CMessageTask::UpdateMsToDB()
 {
+	CString strSqlFinal = _T("");
+	int nIdNum = 0;
+	int nUpdateNum = 0;
+	TCHAR Text[32];
+	vector<MesInfoData>::iterator iterMesInfoB = m_vecMesInfo.begin();
+	vector<MesInfoData>::iterator iterMesInfoE = m_vecMesInfo.end();
+	for (; iterMesInfoB != iterMesInfoE; iterMesInfoB++)
+	{
+		MesInfoData& iMsgInfo = *iterMesInfoB;
+		if (iMsgInfo.bFlag!=TRUE)
+		{
+			continue;
+		}
+		if (nIdNum == 0)
+		{
+			strSqlFinal.Append(_T("UPDATE TE_SMSRECORD SET RESULT=1 WHERE id in("));
+		}
+		int nLen = _stprintf(Text,nIdNum==0?_T("%d"):_T(",%d"),iMsgInfo.Dataid);
+		strSqlFinal.Append(Text,nLen);
+		nUpdateNum++;
+		if (++nIdNum >= MSGUPDATE_MAX_IDS)
+		{
+			strSqlFinal.Append(_T(");"));
+			nIdNum = 0;
+		}
+	}
+	if (nIdNum > 0)
+	{
+		strSqlFinal.Append(_T(");"));
+	}
+	if (strSqlFinal.IsEmpty())
+	{
+		return;
+	}
+
 	//HANDLE hPipe = OpenServerPipe();
 	HANDLE hPipe = OpenRealDataPipe();
 	int ReConnTime = 0;
@@ -429,36 +613,9 @@ void CMessageTask::UpdateMsToDB()
 		hPipe = OpenRealDataPipe();
 
 	}
-	//зͳɹIDIdListб
-	CString IdList = _T("");
-	vector<MesInfoData>::iterator iterMesInfoB = m_vecMesInfo.begin();
-	vector<MesInfoData>::iterator iterMesInfoE = m_vecMesInfo.end();
-	for (; iterMesInfoB != iterMesInfoE; iterMesInfoB++)
-	{
-		MesInfoData& iMsgInfo = *iterMesInfoB;
-		if (iMsgInfo.bFlag==TRUE)
-		{
-			CString strId = _T("");
-			strId.Format(_T("%d,"),iMsgInfo.Dataid);
-			IdList += strId;
-		}
-	}
-	IdList = IdList.Left(IdList.GetLength() - 1);
-	if (IdList.IsEmpty())	
-	{
-		if (hPipe != NULL)
-		{
-			CloseHandle(hPipe);
-			hPipe = NULL;
-		}
-		return;
-	}
 	BYTE* pRead = NULL;
-	//*****************************
-	CString strSqlFinal = _T("");
-	//ݿѾͳɹϢ
-	strSqlFinal.Format(_T("UPDATE TE_SMSRECORD SET RESULT=1 WHERE id in(%s);"),IdList);
-	ReguTrace(SQL,"ŷȷSQL:<%s>",strSqlFinal);
+	//更新数据库中已经发送成功的信息
+	ReguTrace(SQL,"短信发送确认入库%d条",nUpdateNum);
 	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
 	if (pRead)
 	{
@@ -470,4 +627,4 @@ void CMessageTask::UpdateMsToDB()
 		CloseHandle(hPipe);
 		hPipe = NULL;
 	}
-}
\ No newline at end of file
+}
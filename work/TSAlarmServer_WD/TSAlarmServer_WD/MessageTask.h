@@ -1,38 +1,89 @@
 #pragma once
+#include "SendPacer.h"
 
 
+#define MSGSEND_DEFAULT_WORKERS		4		//发送线程数，即同时在途的接口调用数上限
+#define MSGSEND_MAX_WORKERS			16
+#define MSGSEND_DEFAULT_RATE		10		//每个接口每秒最多调用次数
+#define MSGSEND_DEFAULT_RETRY		3		//接口调用失败(通讯错误)的重试次数
+#define MSGSEND_DEFAULT_RETRYDELAY	1000	//首次重试等待(ms)，之后每次加倍
+#define MSGSEND_DEFAULT_INTERVAL	20000	//两次扫描待发信息的间隔(ms)
+#define MSGSEND_SOAP_TIMEOUT		30		//接口连接、收发超时(s)
+#define MSGUPDATE_MAX_IDS			500		//回写发送结果时单条语句最多的ID数
+#define MSGSEND_EXIT_TIMEOUT		(MSGSEND_SOAP_TIMEOUT*2*1000)	//退出时等待发送线程结束的最长时间(ms)
+
+enum
+{
+	MSGENDPOINT_SMS = 0,		//SetSMSInfoC短信接口
+	MSGENDPOINT_RTX,			//SetRTXInfoC CTX接口
+	MSGENDPOINT_NUM,
+};
+
+enum
+{
+	MSGSEND_OK = 0,			//接口返回OK
+	MSGSEND_REJECT,			//接口返回非OK，不重试，下次扫描再发
+	MSGSEND_ERROR,			//通讯错误，退避后重试
+};
 
 // MessageTask
 struct MesInfoData
 {
 	int Dataid;
-	TCHAR fromSys[20];         //*ϢԴϵͳ루ôͳһϢƽ̨עϵͳϢʱɣ
-	TCHAR target_Phone[12];          //*ϢĿ˵RTXNOֻ߽
+	TCHAR fromSys[20];         //*信息来源系统代码（该代码由统一信息平台注册系统信息时生成）
+	TCHAR target_Phone[12];          //*信息目标接收人的RTXNO或者接受人手机号
 	TCHAR target_Ctx[12];
-	TCHAR msTitle[20];         //Ϣı⣬Ϊ""
-	TCHAR msContent[500];     //*ݣϢݲܳ500
-	TCHAR targetTime[20];      //Ŀ귢ʱ䣬Ϊ""Ϊ"",ĬΪ͸ʽ"yyyy-MM-dd HH:mm:ss"
-	TCHAR priority[1];         //ȼΪ"",Ϊ"",ĬΪ1
+	TCHAR msTitle[20];         //发送信息的标题，标题可为""
+	TCHAR msContent[500];     //*发送内容，信息内容不能超过500个字
+	TCHAR targetTime[20];      //目标发送时间，可以为""，如果为"",则默认为立即发送格式"yyyy-MM-dd HH:mm:ss"
+	TCHAR priority[1];         //发送优先级，可以为"",如果为"",则默认为1
 	BOOL  bFlag;
 	BOOL  bCtxFlag;
 	BOOL  bPhoneFlag;
 };
+struct soap;
+
+// CMessageTask
+// 定时扫描待发短信，由固定数量的发送线程并发调用短信/CTX接口。每个发送线程持有一个长连接(keep-alive)的
+// gSOAP上下文，各接口按配置的速率限流，通讯失败退避重试，本轮发送成功的记录批量回写RESULT
+
 class CMessageTask : public CWinThread
 {
 	DECLARE_DYNCREATE(CMessageTask)
 
 public:
-	CMessageTask();           // ̬ʹõܱĹ캯
+	CMessageTask();           // 动态创建所使用的受保护的构造函数
 	virtual ~CMessageTask();
     BOOL InitMesInfo();
 
 public:
 	virtual BOOL InitInstance();
 	virtual int ExitInstance();
-	BOOL SendMessageProcess(MesInfoData& iMessageInfo);
+	BOOL SendMessageProcess(struct soap *pSoap, MesInfoData& iMessageInfo);
+	int CallEndpoint(struct soap *pSoap, int nEndpoint, MesInfoData& iMessageInfo);
+	void DispatchMessages();
+	static UINT SendWorkerProc(LPVOID pParam);
+	void LoadSendConfig();
+	void Stop();
+	void StopWorkers();
 	void UpdateMsToDB();
 	BOOL TChar2Char(const TCHAR* pTchar, char* pChar);
 	vector<MesInfoData> m_vecMesInfo;
+	//发送线程池
+	int m_nWorkerNum;
+	int m_nRatePerSec;
+	int m_nRetry;
+	int m_nRetryDelay;
+	int m_nSendInterval;
+	HANDLE m_hSendSemaphore;		//每轮扫描释放m_nWorkerNum次，唤醒全部发送线程
+	HANDLE m_hSendDoneEvent;		//最后一个发送线程取完本轮信息后置位
+	HANDLE m_hExitEvent;			//Stop置位，扫描线程结束本轮后退出
+	CWinThread* m_pSendThreads[MSGSEND_MAX_WORKERS];
+	volatile BOOL m_bStopWorkers;	//置位后再释放信号量，发送线程被唤醒后退出
+	volatile LONG m_nNextMsg;		//下一个待发信息在m_vecMesInfo中的下标
+	volatile LONG m_nActiveWorkers;
+	volatile LONG m_nRetryCount;
+	CSendPacer m_SendPacer[MSGENDPOINT_NUM];	//各接口的限速
 	//CMap<int,int,MesInfoData,MesInfoData&> m_MesInfoMap;
 	//CMap<int,int,DevDayValue,DevDayValue&> m_DevDayValueMap;
 	int m_MinValue;
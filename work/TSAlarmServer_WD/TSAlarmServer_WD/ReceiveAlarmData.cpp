@@ -1,4 +1,4 @@
-// ReceiveAlarmData.cpp : ʵļ
+// ReceiveAlarmData.cpp : 实现文件
 //
 
 #include "stdafx.h"
@@ -14,6 +14,22 @@ IMPLEMENT_DYNCREATE(CReceiveAlarmData, CWinThread)
 CReceiveAlarmData::CReceiveAlarmData()
 {
 	m_bHasRegister = FALSE;
+	m_nWorkerNum = ALARMINTAKE_DEFAULT_WORKERS;
+	m_nTotalReceived = 0;
+	m_nTotalProcessed = 0;
+	RedisPort = 6379;
+	RedisIPAddress = _T("127.0.0.1");
+	InitializeCriticalSection(&m_csYxValue);
+	m_nRtdbFrameRecords = RTDB_FRAME_MAXRECORDS;
+	m_nRtdbWindow = RTDB_WINDOW_DEFAULT;
+	for (int i=0;i<ALARMINTAKE_MAX_WORKERS;i++)
+	{
+		m_IntakeWorkers[i].pOwner = this;
+		m_IntakeWorkers[i].nIndex = i;
+		m_IntakeWorkers[i].nPending = 0;
+		InitializeCriticalSection(&m_IntakeWorkers[i].csPending);
+		m_IntakeWorkers[i].hPendingEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	}
 	m_softbus = NULL;
 	m_softbus = new CRedisBus;
 	if (NULL == m_softbus)
@@ -78,6 +94,21 @@ BOOL CReceiveAlarmData::InitCfgInfo()
 		strIPAddress = _T("127.0.0.1");
 	}
 	RedisIPAddress = strIPAddress;
+	m_nWorkerNum = GetPrivateProfileInt(_T("ALARMINTAKE"),_T("Workers"),ALARMINTAKE_DEFAULT_WORKERS,strCountPath);
+	if (m_nWorkerNum <= 0 || m_nWorkerNum > ALARMINTAKE_MAX_WORKERS)
+	{
+		m_nWorkerNum = ALARMINTAKE_DEFAULT_WORKERS;
+	}
+	m_nRtdbFrameRecords = GetPrivateProfileInt(_T("RTDBFRAME"),_T("RecordsPerFrame"),RTDB_FRAME_MAXRECORDS,strCountPath);
+	if (m_nRtdbFrameRecords < 1)
+	{
+		m_nRtdbFrameRecords = RTDB_FRAME_MAXRECORDS;
+	}
+	m_nRtdbWindow = GetPrivateProfileInt(_T("RTDBFRAME"),_T("Window"),RTDB_WINDOW_DEFAULT,strCountPath);
+	if (m_nRtdbWindow < 0 || m_nRtdbWindow > RTDB_WINDOW_MAX)
+	{
+		m_nRtdbWindow = RTDB_WINDOW_DEFAULT;
+	}
 	return TRUE;
 }
 
@@ -122,7 +153,9 @@ BOOL CReceiveAlarmData::ConnectRedisServer()
 
 BOOL CReceiveAlarmData::InitInstance()
 {
-	// TODO: ڴִ̳߳ʼ
+	// TODO: 在此执行任意逐线程初始化
+	InitCfgInfo();
+	m_RtdbWindow.Start(m_nRtdbWindow);
 	if(!ConnectRedisServer())
 	{
 		ReguTrace(Config,"ConnectRedisServer err!");
@@ -135,26 +168,108 @@ BOOL CReceiveAlarmData::InitInstance()
 		return FALSE;
 	}
 	ReguTrace(Config,"initAlarmType end!");
+	for (int i=0;i<m_nWorkerNum;i++)
+	{
+		if (AfxBeginThread(AlarmWorkerProc, &m_IntakeWorkers[i]) == NULL)
+		{
+			ReguTrace(ERRO,"告警处理线程%d启动失败!",i);
+			return FALSE;
+		}
+	}
+	ReguTrace(Config,"告警处理线程%d个启动!",m_nWorkerNum);
+	int nIdleSleep = ALARMINTAKE_IDLE_SLEEP_MIN;
+	BOOL bFull = FALSE;
 	while(1)
 	{
-		BOOL bRet = FALSE;
-		bRet = GetDataFromRedis();
-		if (!bRet)
+		//有告警时连续取，每取满一批或队列取空就唤醒对应的处理线程；
+		//有处理线程积压到上限时不再取，告警留在Redis队列中，等处理线程追上
+		DWORD dwWorkerMask = 0;
+		int nNum = 0;
+		BOOL bFullNow = FALSE;
+		while (nNum<ALARMINTAKE_MAX_BATCH && !(bFullNow = IsIntakeFull()) && GetDataFromRedis(dwWorkerMask))
 		{
-			Sleep(1000);
+			nNum++;
+		}
+		for (int i=0;i<m_nWorkerNum;i++)
+		{
+			if (dwWorkerMask&((DWORD)1<<i))
+			{
+				SetEvent(m_IntakeWorkers[i].hPendingEvent);
+			}
+		}
+		if (bFullNow != bFull)
+		{
+			bFull = bFullNow;
+			if (bFull)
+			{
+				ReguTrace(ERRO,"告警处理积压,暂停取告警:累计收到%d条,已处理%d条",m_nTotalReceived,m_nTotalProcessed);
+			}
+			else
+			{
+				ReguTrace(ERRO,"告警处理积压解除,继续取告警:累计收到%d条,已处理%d条",m_nTotalReceived,m_nTotalProcessed);
+			}
+		}
+		if (bFullNow)
+		{
+			Sleep(ALARMINTAKE_IDLE_SLEEP_MIN);
+			continue;
+		}
+		if (nNum>0)
+		{
+			nIdleSleep = ALARMINTAKE_IDLE_SLEEP_MIN;
+			continue;
+		}
+		//无告警时从短间隔开始逐步加大轮询间隔
+		Sleep(nIdleSleep);
+		nIdleSleep *= 2;
+		if (nIdleSleep>ALARMINTAKE_IDLE_SLEEP_MAX)
+		{
+			nIdleSleep = ALARMINTAKE_IDLE_SLEEP_MAX;
 		}
-		Sleep(5);
 	}
 	return TRUE;
 }
 
-BOOL CReceiveAlarmData::GetDataFromRedis()
+//告警处理线程：每次取走本线程的全部待处理告警，按到达顺序逐条处理
+UINT CReceiveAlarmData::AlarmWorkerProc(LPVOID pParam)
+{
+	AlarmIntakeWorker *pWorker = (AlarmIntakeWorker*)pParam;
+	vector<AlarmIntakeItem> vecBatch;
+	while (WaitForSingleObject(pWorker->hPendingEvent,INFINITE) == WAIT_OBJECT_0)
+	{
+		EnterCriticalSection(&pWorker->csPending);
+		vecBatch.swap(pWorker->vecPending);
+		LeaveCriticalSection(&pWorker->csPending);
+		for (size_t i=0;i<vecBatch.size();i++)
+		{
+			pWorker->pOwner->ProcessAlarm(vecBatch[i]);
+		}
+		InterlockedExchangeAdd(&pWorker->nPending,-(LONG)vecBatch.size());
+		InterlockedExchangeAdd(&pWorker->pOwner->m_nTotalProcessed,(LONG)vecBatch.size());
+		vecBatch.clear();
+	}
+	return 0;
+}
+
+//任一处理线程积压达到ALARMINTAKE_MAX_PENDING。取到告警之前不知道它属于哪个线程，只能按最满的线程判断
+BOOL CReceiveAlarmData::IsIntakeFull()
+{
+	for (int i=0;i<m_nWorkerNum;i++)
+	{
+		if (m_IntakeWorkers[i].nPending>=ALARMINTAKE_MAX_PENDING)
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+//取一条告警放入对应处理线程的待处理列表，dwWorkerMask中置上该线程的位；没有取到消息时返回FALSE
+BOOL CReceiveAlarmData::GetDataFromRedis(DWORD &dwWorkerMask)
 {
 	unsigned char * buffer = NULL;
-	int length = 0;
 	int ret = REDIS_NODATA;
 	ret = m_softbus->RecvMessageFromMsmq_Ext("AlarmInfoData",&buffer); 
-	//ret = m_softbus->RecvMessageFromMsmq("SampleMessage",buffer,&length);
 	if(REDIS_ERR == ret)
 	{
 		ReguTrace(Config,"ReconnectRedisServer!");
@@ -167,147 +282,125 @@ BOOL CReceiveAlarmData::GetDataFromRedis()
 		}
 		return FALSE;
 	}
-	else if (REDIS_OK == ret)
+	else if (REDIS_NODATA == ret || NULL == buffer)
 	{
-		if (NULL == buffer)
-			return FALSE;
-		BYTE * pBuf = (BYTE*)buffer;
-		AlarmMsgHead* pHead = (AlarmMsgHead*)pBuf;
-		if (pHead->MsgBegin==0x7e&&pHead->MsgEnd==0x7e)  //0x7eΪ澯Ϣ
-		{
-			ReguTrace(Config,"յһ澯Ϣtype=%d!",pHead->dAlarmType);
-			BYTE* pMsg = pBuf + sizeof(AlarmMsgHead);
-			AlarmInfo *pAlarmInfo = (AlarmInfo*)pMsg;
-			if (pHead->dAlarmType!=pAlarmInfo->AlarmType)
-			{
-				ReguTrace(Config,"澯Ͳƥ!");
-				if (buffer!=NULL)
-				{
-					delete [] buffer;
-					buffer = NULL;
-				}
-				return FALSE;
-			}
-			
-			map<int,AlarmTypeDef>::iterator iterFinder = m_mapAlarmType.find(pHead->dAlarmType);
-			if(iterFinder != m_mapAlarmType.end())
-			{
-				AlarmTypeDef iAlarmType = iterFinder->second;
-				CString strAlarmTypeName = _T("");
-				AlarmItemDef ALARMDef;
-				memset(&ALARMDef, 0, sizeof(AlarmItemDef));
-				CreateUuid(ALARMDef.alarmID);
-				ALARMDef.alarmType = pAlarmInfo->AlarmType;
-				ALARMDef.alarmLevel = iAlarmType.m_iAlarmLevel;
-				ALARMDef.alarmObjID = pAlarmInfo->ObjectId;
-				if (ALARMDef.alarmType==ALARMTYPE_DEV_UNCOMMUN)  //ͨѶж
-				{
-					ALARMDef.stationID = pAlarmInfo->reserve;
-				}
-				if (ALARMDef.alarmType==ALARMTYPE_STATION_UNCOMMUN
-					&&pAlarmInfo->Status==ALARMSTATUS_NEWALARM)  //ͨѶж
-				{
-					m_YxValueInfoCArray.RemoveAll();
-					GetDIIndexByStationId(ALARMDef.alarmObjID);
-					Update2RTDB();
-					m_YxValueInfoCArray.RemoveAll();
-				}
-				memcpy(ALARMDef.alarmTypeName,iAlarmType.m_cstrName,sizeof(ALARMDef.alarmTypeName));
-				//memcpy(ALARMDef.alarmObjName,0,sizeof(ALARMDef.alarmObjName));
-
-				ALARMDef.alarmObjType = pAlarmInfo->ObjectType;
-				if (ALARMDef.alarmObjType==31)
-				{
-					ALARMDef.devID = ALARMDef.alarmObjID;
-				}
-				CTime curTime = CTime::GetCurrentTime();
-				ALARMDef.contentTime = curTime.GetTime();
-				curTime = CTime(curTime.GetYear(),curTime.GetMonth(),curTime.GetDay(),0,0,0);
-				ALARMDef.alarmTime = pAlarmInfo->AlarmTime.GetTime();
-
-				ALARMDef.status = pAlarmInfo->Status;
-
-				ALARMDef.projectID = 1;    //̺
-				ALARMDef.systemID = 1;    //ϵͳ
-				ALARMDef.rtAlarm = 0;    //¼ʵʱ澯
-				memset(ALARMDef.stationName, 0, sizeof(ALARMDef.stationName));
-				memset(ALARMDef.projectName, 0, sizeof(ALARMDef.projectName));
-				memcpy(ALARMDef.alarmSource,_T("Ӧ÷澯"),sizeof(ALARMDef.alarmSource));
-				ALARMDef.groupID1 = iAlarmType.m_iGroupId1;
-				ALARMDef.groupID2 = iAlarmType.m_iGroupId2;
-				memcpy(ALARMDef.alarmContent,pAlarmInfo->Contents,sizeof(ALARMDef.alarmContent));
-				memcpy(ALARMDef.reserve5,pAlarmInfo->Suggest,sizeof(ALARMDef.reserve5));
-
-				if (ALARMDef.status==ALARMSTATUS_NEWALARM)
-				{
-					AddAlarm2DB(ALARMDef);
-					//Send2SMSRecorde();
-				} 
-				else if(ALARMDef.status==ALARMSTATUS_REVERSE)
-				{
-					ChangeAlarmStatus(ALARMDef);
-				}
-				//뵽ű
-				if(ALARMDef.alarmType==8006)
-				{
-					return TRUE;
-				}
-				CTSAlarmServer_WDDlg* pDlg = (CTSAlarmServer_WDDlg*)AfxGetApp()->m_pMainWnd;
-				DeviceInfoData iDeviceInfo;
-				memset(&iDeviceInfo,0,sizeof(DeviceInfoData));
-				pDlg->m_pAlarmTask->m_DeviceInfoMap.Lookup(ALARMDef.devID,iDeviceInfo);
-				CString iKey = _T("");
-				iKey.Format(_T("%d_%d"),iDeviceInfo.iPlazaId,ALARMDef.alarmType);
-				SMSConfigDef iSMSCofig;
-				memset(&iSMSCofig,0,sizeof(SMSConfigDef));
-				if(pDlg->m_pAlarmTask->m_SMSConfigMap.Lookup(iKey,iSMSCofig))
-				{
-					if (iSMSCofig.IsShield==0)
-					{
-						CString TemplateContent = _T("");
-						pDlg->m_pAlarmTask->m_SMSTemplateMap.Lookup(iSMSCofig.TemplateNum,TemplateContent);
-						CString Owner = _T("");
-						CString AlarmObject = _T("");
-						CString strAlarmType = _T("");
-						Owner.Format(_T("%s"),iSMSCofig.PersonName);
-						AlarmObject.Format(_T("%s%sƷµ%s"),iDeviceInfo.PlazaName,iDeviceInfo.BrandName,iDeviceInfo.DevName);
-						strAlarmType.Format(_T("%s"),strAlarmTypeName);
-						TemplateContent.Replace(_T("[owner]"),Owner);
-						TemplateContent.Replace(_T("[object]"),AlarmObject);
-						TemplateContent.Replace(_T("[alarmtype]"),strAlarmType);
-						Insert2SMSRECORD(iSMSCofig,TemplateContent);
-					}
-				}
-			}
-			
-		}
-		else
+		if (buffer!=NULL)
 		{
-			ReguTrace(ERR,"REDIS_DATA ERR!");
-			if (buffer!=NULL)
-			{
-				delete [] buffer;
-				buffer = NULL;
-			}
-			return FALSE;
+			delete [] buffer;
+			buffer = NULL;
 		}
-		
-		
-	}
-	else if (REDIS_NODATA == ret)
-	{
-		OutputDebugString(_T("REDIS_NODATA \n"));
 		return FALSE;
 	}
 
-	if (buffer!=NULL)
+	BYTE * pBuf = (BYTE*)buffer;
+	AlarmMsgHead* pHead = (AlarmMsgHead*)pBuf;
+	AlarmInfo *pAlarmInfo = (AlarmInfo*)(pBuf + sizeof(AlarmMsgHead));
+	if (pHead->MsgBegin!=0x7e||pHead->MsgEnd!=0x7e)  //0x7e为告警消息标记
 	{
-		delete [] buffer;
-		buffer = NULL;
+		ReguTrace(ERR,"REDIS_DATA ERR!");
 	}
+	else if (pHead->dAlarmType!=pAlarmInfo->AlarmType)
+	{
+		ReguTrace(Config,"告警类型不匹配!");
+	}
+	else
+	{
+		ReguTrace(Config,"收到一条告警信息type=%d!",pHead->dAlarmType);
+		AlarmIntakeItem iItem;
+		iItem.dAlarmType = pHead->dAlarmType;
+		memcpy(&iItem.iAlarmInfo,pAlarmInfo,sizeof(AlarmInfo));
+		int nWorker = (int)((DWORD)(pAlarmInfo->ObjectType*31+pAlarmInfo->ObjectId)%(DWORD)m_nWorkerNum);
+		AlarmIntakeWorker &iWorker = m_IntakeWorkers[nWorker];
+		EnterCriticalSection(&iWorker.csPending);
+		iWorker.vecPending.push_back(iItem);
+		LeaveCriticalSection(&iWorker.csPending);
+		InterlockedIncrement(&iWorker.nPending);
+		dwWorkerMask |= (DWORD)1<<nWorker;
+		InterlockedIncrement(&m_nTotalReceived);
+	}
+	delete [] buffer;
+	buffer = NULL;
+	//格式错误的消息也已从队列取走，继续取下一条
 	return TRUE;
 }
 
+//处理一条告警：入库、集中器通讯中断时更新其下遥信、按配置插入短信表
+void CReceiveAlarmData::ProcessAlarm(const AlarmIntakeItem &iItem)
+{
+	const AlarmInfo *pAlarmInfo = &iItem.iAlarmInfo;
+	map<int,AlarmTypeDef>::iterator iterFinder = m_mapAlarmType.find(iItem.dAlarmType);
+	if(iterFinder != m_mapAlarmType.end())
+	{
+		AlarmTypeDef iAlarmType = iterFinder->second;
+		CString strAlarmTypeName = _T("");
+		AlarmItemDef ALARMDef;
+		memset(&ALARMDef, 0, sizeof(AlarmItemDef));
+		CreateUuid(ALARMDef.alarmID);
+		ALARMDef.alarmType = pAlarmInfo->AlarmType;
+		ALARMDef.alarmLevel = iAlarmType.m_iAlarmLevel;
+		ALARMDef.alarmObjID = pAlarmInfo->ObjectId;
+		if (ALARMDef.alarmType==ALARMTYPE_DEV_UNCOMMUN)  //电表通讯中断
+		{
+			ALARMDef.stationID = pAlarmInfo->reserve;
+		}
+		if (ALARMDef.alarmType==ALARMTYPE_STATION_UNCOMMUN
+			&&pAlarmInfo->Status==ALARMSTATUS_NEWALARM)  //集中器通讯中断
+		{
+			EnterCriticalSection(&m_csYxValue);
+			m_YxValueInfoCArray.RemoveAll();
+			GetDIIndexByStationId(ALARMDef.alarmObjID);
+			Update2RTDB();
+			m_YxValueInfoCArray.RemoveAll();
+			LeaveCriticalSection(&m_csYxValue);
+		}
+		memcpy(ALARMDef.alarmTypeName,iAlarmType.m_cstrName,sizeof(ALARMDef.alarmTypeName));
+		//memcpy(ALARMDef.alarmObjName,0,sizeof(ALARMDef.alarmObjName));
+
+		ALARMDef.alarmObjType = pAlarmInfo->ObjectType;
+		if (ALARMDef.alarmObjType==31)
+		{
+			ALARMDef.devID = ALARMDef.alarmObjID;
+		}
+		CTime curTime = CTime::GetCurrentTime();
+		ALARMDef.contentTime = curTime.GetTime();
+		curTime = CTime(curTime.GetYear(),curTime.GetMonth(),curTime.GetDay(),0,0,0);
+		ALARMDef.alarmTime = pAlarmInfo->AlarmTime.GetTime();
+
+		ALARMDef.status = pAlarmInfo->Status;
+
+		ALARMDef.projectID = 1;    //工程号
+		ALARMDef.systemID = 1;    //子系统号
+		ALARMDef.rtAlarm = 0;    //不记录实时告警
+		memset(ALARMDef.stationName, 0, sizeof(ALARMDef.stationName));
+		memset(ALARMDef.projectName, 0, sizeof(ALARMDef.projectName));
+		memcpy(ALARMDef.alarmSource,_T("应用服务告警"),sizeof(ALARMDef.alarmSource));
+		ALARMDef.groupID1 = iAlarmType.m_iGroupId1;
+		ALARMDef.groupID2 = iAlarmType.m_iGroupId2;
+		memcpy(ALARMDef.alarmContent,pAlarmInfo->Contents,sizeof(ALARMDef.alarmContent));
+		memcpy(ALARMDef.reserve5,pAlarmInfo->Suggest,sizeof(ALARMDef.reserve5));
+
+		if (ALARMDef.status==ALARMSTATUS_NEWALARM)
+		{
+			AddAlarm2DB(ALARMDef);
+			//Send2SMSRecorde();
+		} 
+		else if(ALARMDef.status==ALARMSTATUS_REVERSE)
+		{
+			ChangeAlarmStatus(ALARMDef);
+		}
+		//插入到短信表
+		if(ALARMDef.alarmType==8006)
+		{
+			return;
+		}
+		CTSAlarmServer_WDDlg* pDlg = (CTSAlarmServer_WDDlg*)AfxGetApp()->m_pMainWnd;
+		DeviceInfoData iDeviceInfo;
+		memset(&iDeviceInfo,0,sizeof(DeviceInfoData));
+		pDlg->m_pAlarmTask->GetDeviceInfo(ALARMDef.devID,iDeviceInfo);
+		pDlg->m_pAlarmTask->AddAlarmSMS(iDeviceInfo,ALARMDef.alarmType,strAlarmTypeName);
+	}
+}
+
 
 #include <Rpcdce.h>
 #pragma comment(lib,"Rpcrt4.lib")
@@ -417,11 +510,11 @@ BOOL CReceiveAlarmData::GetDIIndexByStationId(int StationId)
 BOOL CReceiveAlarmData::initAlarmType()
 {
 	m_mapAlarmType.clear();
-	int iFdCount = 5;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 5;	//	查询的字段数
+	int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -434,16 +527,16 @@ BOOL CReceiveAlarmData::initAlarmType()
 	CString strQuery = _T("select GROUPID1,GROUPID2,TYPE,NAME,ALARMLEVEL from TB_ALARMTYPE");
 	pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-	if (NULL == pRead)	// δѯ¼
+	if (NULL == pRead)	// 未查询到记录
 	{
 		CloseHandle(hPipe);
 		MYERROR(_T("InitDevInfo pRead null"));
 		return FALSE;
 	}
-	// صĽ
+	// 解析返回的结果
 	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-		//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+		//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -451,9 +544,9 @@ BOOL CReceiveAlarmData::initAlarmType()
 		return FALSE;
 	}	
 
-	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+	if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 	{
-		//MYWARN(_T("յջظģ޷ѯ"));
+		//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -461,12 +554,12 @@ BOOL CReceiveAlarmData::initAlarmType()
 		return FALSE;
 	}
 
-	// ȡѯֶ
+	// 获取查询的字段数
 	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 	int nFieldNum = (int)*pWord;
-	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	if (nFieldNum != iFdCount)	// 查询字段数量，不相等，曾查询结果异常退出
 	{
-		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+		//	MYWARN(_T("查询字段数量，不相等，曾查询结果异常退出"));
 		delete[] pRead;
 		pRead = NULL;
 		CloseHandle(hPipe);
@@ -475,7 +568,7 @@ BOOL CReceiveAlarmData::initAlarmType()
 	}
 	pWord++;
 
-	// ¼
+	// 记录集长度
 	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 	DWORD dwRecordLen = *((DWORD*)pByte);
@@ -488,7 +581,7 @@ BOOL CReceiveAlarmData::initAlarmType()
 	}
 	pByte += sizeof(DWORD);
 
-	// ¼
+	// 记录数
 	DWORD dwRecordNum = *((int*)pByte);
 	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 	{
@@ -499,7 +592,7 @@ BOOL CReceiveAlarmData::initAlarmType()
 	}
 	pByte += sizeof(DWORD);
 
-	// ѯд뵽
+	// 将查询结果写入到缓存
 	LZGRECORDSET rs;
 	for (int i=0;i<(int)dwRecordNum;i++)
 	{
@@ -511,7 +604,7 @@ BOOL CReceiveAlarmData::initAlarmType()
 		pByte += pHead->DataLen;
 		rs.clear();
 
-		//ϵͳID
+		//系统ID
 		memcpy(rs.buf, pByte, (pHead+1)->DataLen);
 		alarmType.m_iGroupId2 = rs.iRs;
 		pByte += (pHead+1)->DataLen;
@@ -523,7 +616,7 @@ BOOL CReceiveAlarmData::initAlarmType()
 		pByte += (pHead+2)->DataLen;
 		rs.clear();
 
-		//澯Name
+		//告警Name
 		memcpy(rs.buf, pByte, (pHead+3)->DataLen);
 		TCHAR chName[33];
 		memcpy(chName,rs.cBuf,sizeof(TCHAR)*33);
@@ -531,7 +624,7 @@ BOOL CReceiveAlarmData::initAlarmType()
 		pByte += (pHead+3)->DataLen;
 		rs.clear();
 
-		//澯ȼ
+		//告警等级
 		memcpy(rs.buf, pByte, (pHead+4)->DataLen);
 		alarmType.m_iAlarmLevel = rs.iRs;
 		pByte += (pHead+4)->DataLen;
@@ -547,354 +640,53 @@ BOOL CReceiveAlarmData::initAlarmType()
 	return TRUE;
 }	
 
+//实时告警交给批量入库线程，同一对象同一类型同一天的告警只入库一条
 void CReceiveAlarmData::AddAlarm2DB(AlarmItemDef ALARMDef)
 {
-	HANDLE hPipe = OpenRealDataPipe();
-	int ReConnTime = 0;
-	while (hPipe == NULL)
-	{
-		if (ReConnTime>=3)
-		{
-			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
-			return ;
-		}
-		ReConnTime++;
-		Sleep(1000);
-		hPipe = OpenRealDataPipe();
-
-	}
-	BYTE* pRead = NULL;
-
-	CString strSql;
-	CTime dt1 = CTime(ALARMDef.alarmTime);
-	CTime dt2 = CTime(ALARMDef.contentTime);
-
-	CString ctrAlarmTime = _T("");
-	ctrAlarmTime.Format(_T("%d-%d-%d %d:%d:%d"),dt1.GetYear(),
-		dt1.GetMonth(),
-		dt1.GetDay(),
-		dt1.GetHour(),
-		dt1.GetMinute(),
-		dt1.GetSecond());
-	CString strAlarmID(ALARMDef.alarmID);
-	strAlarmID.Replace(_T("'"), _T("''"));
-	CString strAlarmTypeName(ALARMDef.alarmTypeName);
-	strAlarmTypeName.Replace(_T("'"), _T("''"));
-	CString strAlarmSource(ALARMDef.alarmSource);
-	strAlarmSource.Replace(_T("'"), _T("''"));
-	CString strAlarmObjName(ALARMDef.alarmObjName);
-	strAlarmObjName.Replace(_T("'"), _T("''"));
-	CString strDevName(ALARMDef.devName);
-	strDevName.Replace(_T("'"), _T("''"));
-	CString strStationName(ALARMDef.stationName);
-	strStationName.Replace(_T("'"), _T("''"));
-	CString strAlarmContent(ALARMDef.alarmContent);
-	strAlarmContent.Replace(_T("'"), _T("''"));
-	CString strPrjName(ALARMDef.projectName);
-	strPrjName.Replace(_T("'"), _T("''"));
-	CString strReserve5(ALARMDef.reserve5);
-	strReserve5.Replace(_T("'"), _T("''"));
-	CString strReserve6(ALARMDef.reserve6);
-	strReserve6.Replace(_T("'"), _T("''"));
-
-	
-	strSql.Format(_T("insert into TE_ALARM_INDEX (ID,GROUP1,GROUP2,ALARMTYPE,ALARMTYPENAME,ALARMLEVEL,ALARMSOURCE,ALARMOBJTYPE,PROJECTID,\
-					 SYSTEMID,ALARMOBJID,DEVID,STATIONID,ALARMOBJNAME,DEVNAME,STATIONNAME,ALARMCONTENT,PROJECTNAME,RTALARM,STATUS,ALARMTIME,CONTENTTIME,\
-					 RESERVE1,RESERVE2,RESERVE3,RESERVE4,RESERVE5,RESERVE6) values ('%s',%d,%d,%d,'%s',%d,'%s',%d,%d,%d,%d,%d,%d,'%s','%s','%s','%s','%s',\
-					 %d,%d,'%d-%d-%d %d:%d:%d','%d-%d-%d %d:%d:%d',%d,%d,%f,%f,'%s','%s') "),
-					 strAlarmID,
-					 ALARMDef.groupID1,
-					 ALARMDef.groupID2,
-					 ALARMDef.alarmType,
-					 strAlarmTypeName,
-					 ALARMDef.alarmLevel,
-					 strAlarmSource,
-					 ALARMDef.alarmObjType,
-					 ALARMDef.projectID,
-					 ALARMDef.systemID,
-					 ALARMDef.alarmObjID,
-					 ALARMDef.devID,
-					 ALARMDef.stationID,
-					 strAlarmObjName,
-					 strDevName,
-					 strStationName,
-					 strAlarmContent,
-					 strPrjName,
-					 ALARMDef.rtAlarm,
-					 ALARMDef.status,
-					 dt1.GetYear(),
-					 dt1.GetMonth(),
-					 dt1.GetDay(),
-					 dt1.GetHour(),
-					 dt1.GetMinute(),
-					 dt1.GetSecond(),
-					 dt2.GetYear(),
-					 dt2.GetMonth(),
-					 dt2.GetDay(),
-					 dt2.GetHour(),
-					 dt2.GetMinute(),
-					 dt2.GetSecond(),
-					 ALARMDef.reserve1,
-					 ALARMDef.reserve2,
-					 ALARMDef.reserve3,
-					 ALARMDef.reserve4,
-					 strReserve5,
-					 strReserve6);
-	//*****************************
-	CString strSqlFinal = _T("");
-	/*strSqlFinal.Format(C_SQL_INSERT_ALARMINDEX,ALARMDef.alarmType,ALARMDef.alarmObjID,ALARMDef.alarmObjType,strSql,strAlarmContent,ctrAlarmTime,
-		ALARMDef.alarmType,ALARMDef.alarmObjID,ALARMDef.alarmObjType);*/
-	ReguTrace(SQL,"澯¼SQL:<%s>",strSql);
-	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSql);
-	if (pRead)
-	{
-		delete[] pRead;
-		pRead = NULL;
-	}
-	if (hPipe != NULL)
-	{
-		CloseHandle(hPipe);
-		hPipe = NULL;
-	}
-
+	CTSAlarmServer_WDDlg* pDlg = (CTSAlarmServer_WDDlg*)AfxGetApp()->m_pMainWnd;
+	pDlg->m_pAlarmBatchWriter->AddAlarm(ALARMWRITE_INSERT,ALARMDef);
 }
 
 
+//告警恢复也走批量入库线程，保证与之前缓存的告警插入顺序一致
 void CReceiveAlarmData::ChangeAlarmStatus(AlarmItemDef ALARMDef)
 {
-	HANDLE hPipe = OpenRealDataPipe();
-	int ReConnTime = 0;
-	while (hPipe == NULL)
-	{
-		if (ReConnTime>=3)
-		{
-			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
-			return ;
-		}
-		ReConnTime++;
-		Sleep(1000);
-		hPipe = OpenRealDataPipe();
-
-	}
-	CTime dt2 = CTime(ALARMDef.alarmTime);
-
-	CString ctrContentimeTime = _T("");
-	ctrContentimeTime.Format(_T("%d-%d-%d %d:%d:%d"),dt2.GetYear(),
-		dt2.GetMonth(),
-		dt2.GetDay(),
-		dt2.GetHour(),
-		dt2.GetMinute(),
-		dt2.GetSecond());
-	CString strAlarmContent(ALARMDef.alarmContent);
-	strAlarmContent.Replace(_T("'"), _T("''"));
-	BYTE* pRead = NULL;
-	CString strPreSql = _T("");
-	strPreSql.Format(_T("if exists (select id from TE_ALARM_INDEX where ALARMTYPE=%d and ALARMOBJID=%d and ALARMOBJTYPE=%d and STATUS=0) "),
-		ALARMDef.alarmType,
-		ALARMDef.alarmObjID,
-		ALARMDef.alarmObjType);
-	CString strUpdateSql = _T("");
-	strUpdateSql.Format(_T("update TE_ALARM_INDEX set STATUS=2,ALARMCONTENT='%s', CONTENTTIME='%s' where ALARMTYPE=%d and ALARMOBJID=%d and ALARMOBJTYPE=%d and STATUS=0"),
-		strAlarmContent,
-		ctrContentimeTime,
-		ALARMDef.alarmType,
-		ALARMDef.alarmObjID,
-		ALARMDef.alarmObjType);
-	ReguTrace(SQL,"澯״̬SQL:<%s>",strUpdateSql);
-	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strUpdateSql);
-	if (pRead)
-	{
-		delete[] pRead;
-		pRead = NULL;
-	}
-	if (hPipe != NULL)
-	{
-		CloseHandle(hPipe);
-		hPipe = NULL;
-	}
+	CTSAlarmServer_WDDlg* pDlg = (CTSAlarmServer_WDDlg*)AfxGetApp()->m_pMainWnd;
+	pDlg->m_pAlarmBatchWriter->AddAlarm(ALARMWRITE_RECOVER,ALARMDef);
 }
 
+//更新至实时库，多个遥信点打包成一帧，帧满即交给发送窗口，不等应答继续组下一帧
 BOOL CReceiveAlarmData::Update2RTDB()
 {
-	HANDLE hPipe=NULL;	 
-	hPipe = OpenRealDataPipe();
-	if (hPipe==NULL)
+	//遥信：TB_DI只更新原始值和遥信值两列
+	int nYxCols[] = {7,9};
+	CRtdbUpdateFrame YxFrame;
+	if (!YxFrame.Init(TABLE_NO_DI,sizeof(YxConfigDef),nYxCols,2,m_nRtdbFrameRecords))
+	{
+		ReguTrace(ERRO,"YxValue pWrite==null!");
 		return FALSE;
+	}
 	for (int i=0; i<m_YxValueInfoCArray.GetSize();i++)
 	{
-		YxConfigDef iYxConfig;
-		iYxConfig = m_YxValueInfoCArray[i];
-		BYTE *pData;
-		int nRecordLen = sizeof(YxConfigDef);
-
-		DWORD dwBufLen = nRecordLen + sizeof(UpdataRecordStruct) + sizeof(NetMessageHead);
-		BYTE* pWrite = new BYTE[dwBufLen];
-		if (NULL==pWrite)
-		{
-			ReguTrace(ERRO,"YxValue pWrite==null!");
-			if (hPipe != NULL)
-			{
-				CloseHandle(hPipe);
-				hPipe = NULL;
-			}
-			return FALSE;
-		}
-		NetMessageHead* pMessageHead = (NetMessageHead*)pWrite;										  
-		pMessageHead->MessageType =	NET_MESSAGE_UPDATARECORD;						 
-		pMessageHead->Length = nRecordLen + sizeof(UpdataRecordStruct) - 1;							 
-		UpdataRecordStruct* pUpdataStruct = (UpdataRecordStruct*)&pWrite[sizeof(NetMessageHead)];
-
-		pUpdataStruct->TableNo = TABLE_NO_DI;	
-		memset(&(pUpdataStruct->ColFlag[0]),0,256);
-
-		pUpdataStruct->ColFlag[7] = 1;
-		pUpdataStruct->ColFlag[9] = 1;
-
-		pUpdataStruct->UpdataType = UPDATARECORD_TYPE_UPDATA; 
-		pUpdataStruct->RecordLen = nRecordLen;
-
-		BYTE *pData1;
-		pData = new BYTE[nRecordLen];
-		if (NULL==pData)
+		YxFrame.PutYx(m_YxValueInfoCArray[i]);
+		if (YxFrame.IsFull())
 		{
-			ReguTrace(ERRO,"YxValue pData==null!");
-			if (hPipe != NULL)
-			{
-				CloseHandle(hPipe);
-				hPipe = NULL;
-			}
-			return FALSE;
+			m_RtdbWindow.Submit(YxFrame);
 		}
-		memset(pData,0,nRecordLen);
-		int nOffset = 0;
-		pData1 = pData;
-
-		memcpy(pData,&iYxConfig.nYxIndex,sizeof(iYxConfig.nYxIndex));
-		nOffset+=sizeof(iYxConfig.nYxIndex);
-
-		memcpy((pData+nOffset),&iYxConfig.nProjectNo,sizeof(iYxConfig.nProjectNo));
-		nOffset+=sizeof(iYxConfig.nProjectNo);
-
-		memcpy((pData+nOffset),&iYxConfig.nStationNo,sizeof(iYxConfig.nStationNo));
-		nOffset+=sizeof(iYxConfig.nStationNo);
-
-		memcpy((pData+nOffset),&iYxConfig.nDeviceNo,sizeof(iYxConfig.nDeviceNo));
-		nOffset+=sizeof(iYxConfig.nDeviceNo);
-
-		memcpy((pData+nOffset),&iYxConfig.nYxNum,sizeof(iYxConfig.nYxNum));
-		nOffset+=sizeof(iYxConfig.nYxNum);
-
-		memcpy((pData+nOffset),iYxConfig.cYxName,sizeof(iYxConfig.cYxName));
-		nOffset+=sizeof(iYxConfig.cYxName);
-
-		memcpy((pData+nOffset),iYxConfig.cDescription,sizeof(iYxConfig.cDescription));
-		nOffset+=sizeof(iYxConfig.cDescription);
-
-		memcpy((pData+nOffset),&iYxConfig.bYxRaw,sizeof(iYxConfig.bYxRaw));
-		nOffset+=sizeof(iYxConfig.bYxRaw);
-
-		memcpy((pData+nOffset),&iYxConfig.bYxType,sizeof(iYxConfig.bYxType));
-		nOffset+=sizeof(iYxConfig.bYxType);
-
-		memcpy((pData+nOffset),&iYxConfig.bYxValue,sizeof(iYxConfig.bYxValue));
-		nOffset+=sizeof(iYxConfig.bYxValue);
-
-		memcpy((pData+nOffset),&iYxConfig.bIdentifier,sizeof(iYxConfig.bIdentifier));
-		nOffset+=sizeof(iYxConfig.bIdentifier);
-
-		memcpy((pData+nOffset),&iYxConfig.nCountExchange,sizeof(iYxConfig.nCountExchange));
-		nOffset+=sizeof(iYxConfig.nCountExchange);
-
-		memcpy((pData+nOffset),&iYxConfig.nCountTrip,sizeof(iYxConfig.nCountTrip));
-		nOffset+=sizeof(iYxConfig.nCountTrip);
-
-		memcpy((pData+nOffset),&iYxConfig.nAlarmType,sizeof(iYxConfig.nAlarmType));
-		nOffset+=sizeof(iYxConfig.nAlarmType);
-
-		memcpy((pData+nOffset),&iYxConfig.nAlarmLevel,sizeof(iYxConfig.nAlarmLevel));
-		nOffset+=sizeof(iYxConfig.nAlarmLevel);
-
-		memcpy((pData+nOffset),&iYxConfig.nYxProp,sizeof(iYxConfig.nYxProp));
-		nOffset+=sizeof(iYxConfig.nYxProp);	
-
-		memmove(&pUpdataStruct->RecordData,pData1,nRecordLen);
-
-		BYTE* pRead;
-		if (hPipe)
-			pRead = (BYTE*)GetNetMessage(hPipe, pWrite,dwBufLen-1);	
-
-		if (pWrite!=NULL)
-		{
-			delete[] pWrite;
-		}
-
-		if (pRead==NULL) 
-		{
-			delete[] pData1;
-			continue;
-		}
-		pMessageHead = (NetMessageHead*)pRead;
-		MessageAck* pAck = (MessageAck*)&pRead[sizeof(NetMessageHead)];
-		if (pMessageHead->MessageType==NET_MESSAGE_ACK && pAck->wdAckType==NET_MESSAGE_ACK_OK) 
-		{
-			delete[] pRead;
-			delete[] pData1;
-			continue;
-		}
-		delete[] pRead;
-		delete[] pData1;
 	}
-	if (hPipe != NULL)
+	m_RtdbWindow.Submit(YxFrame);
+	int nFailed = m_RtdbWindow.Flush();
+	if (nFailed > 0)
 	{
-		CloseHandle(hPipe);
-		hPipe = NULL;
+		ReguTrace(SQLERRO,"实时库更新%d个点未确认成功!",nFailed);
 	}
 	return TRUE;
-
-}
-
-void CReceiveAlarmData::Insert2SMSRECORD(SMSConfigDef iSMSCofig,CString TemplateContent)
-{
-	HANDLE hPipe = OpenRealDataPipe();
-	int ReConnTime = 0;
-	while (hPipe == NULL)
-	{
-		if (ReConnTime>=3)
-		{
-			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
-			return ;
-		}
-		ReConnTime++;
-		Sleep(1000);
-		hPipe = OpenRealDataPipe();
-
-	}
-	BYTE* pRead = NULL;
-
-	CTime CurTime = CTime::GetCurrentTime();
-
-	CString strSqlFinal = _T("");
-	strSqlFinal.Format(_T("INSERT INTO TE_SMSRECORD VALUES(1,'%s','%s','%s','%d-%d-%d %d:%d:%d',1)"),
-		iSMSCofig.PersonName,iSMSCofig.PhoneNum,TemplateContent,CurTime.GetYear(),CurTime.GetMonth(),
-		CurTime.GetDay(),CurTime.GetHour(),CurTime.GetMinute(),CurTime.GetSecond());
-	ReguTrace(SQL,"ż¼SQL:<%s>",strSqlFinal);
-	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
-	if (pRead)
-	{
-		delete[] pRead;
-		pRead = NULL;
-	}
-	if (hPipe != NULL)
-	{
-		CloseHandle(hPipe);
-		hPipe = NULL;
-	}
-
 }
 
 int CReceiveAlarmData::ExitInstance()
 {
-	// TODO: ڴִ߳
+	// TODO: 在此执行任意逐线程清理
+	m_RtdbWindow.Stop();
 	return CWinThread::ExitInstance();
 }
 
@@ -902,4 +694,4 @@ BEGIN_MESSAGE_MAP(CReceiveAlarmData, CWinThread)
 END_MESSAGE_MAP()
 
 
-// CReceiveAlarmData Ϣ
+// CReceiveAlarmData 消息处理程序
@@ -3,20 +3,49 @@
 #include "SoftBus.h"
 #include "RedisBus.h"
 
+#define ALARMINTAKE_DEFAULT_WORKERS	4		//告警处理线程数
+#define ALARMINTAKE_MAX_WORKERS		16
+#define ALARMINTAKE_MAX_BATCH		256		//连续取到这么多条就先分发给处理线程
+#define ALARMINTAKE_IDLE_SLEEP_MIN	5		//无告警时的最短轮询间隔(ms)
+#define ALARMINTAKE_IDLE_SLEEP_MAX	100		//持续无告警时的最长轮询间隔(ms)
+#define ALARMINTAKE_MAX_PENDING		4096	//单个处理线程最多积压的告警数，达到后暂停从Redis取告警
+
+struct AlarmIntakeItem
+{
+	DWORD dAlarmType;
+	AlarmInfo iAlarmInfo;
+};
+
+class CReceiveAlarmData;
+
+//告警处理线程，同一告警对象总是落在同一线程，保证该对象的告警按到达顺序处理
+struct AlarmIntakeWorker
+{
+	CReceiveAlarmData *pOwner;
+	int nIndex;
+	vector<AlarmIntakeItem> vecPending;
+	volatile LONG nPending;		//已取到、尚未处理完的告警数，含处理线程已取走正在处理的
+	CRITICAL_SECTION csPending;
+	HANDLE hPendingEvent;
+};
 
 // CReceiveAlarmData
+// 从AlarmInfoData队列连续取告警，按告警对象分发给处理线程并行入库
 
 class CReceiveAlarmData : public CWinThread
 {
 	DECLARE_DYNCREATE(CReceiveAlarmData)
 
 public:
-	CReceiveAlarmData();           // ̬ʹõܱĹ캯
+	CReceiveAlarmData();           // 动态创建所使用的受保护的构造函数
 	virtual ~CReceiveAlarmData();
 	BOOL InitCfgInfo();
 	BOOL ConnectRedisServer();
 	BOOL TChar2Char(const TCHAR* pTchar, char* pChar);
-	BOOL GetDataFromRedis();
+	BOOL GetDataFromRedis(DWORD &dwWorkerMask);
+	BOOL IsIntakeFull();
+	void ProcessAlarm(const AlarmIntakeItem &iItem);
+	static UINT AlarmWorkerProc(LPVOID pParam);
 	void CreateUuid(TCHAR* csID);
 	BOOL initAlarmType();
 	void AddAlarm2DB(AlarmItemDef ALARMDef);
@@ -25,7 +54,6 @@ public:
 	//BOOL LoadSMSTemplate();
 	BOOL GetDIIndexByStationId(int StationId);
 	BOOL Update2RTDB();
-	void Insert2SMSRECORD(SMSConfigDef iSMSCofig,CString TemplateContent);
 public:
 	virtual BOOL InitInstance();
 	virtual int ExitInstance();
@@ -34,9 +62,17 @@ public:
 	BOOL m_bHasRegister;
 	CString RedisIPAddress;
 	int RedisPort;
-	map<int,AlarmTypeDef> m_mapAlarmType;  //澯
+	map<int,AlarmTypeDef> m_mapAlarmType;  //告警类型
 	CMap<CString,LPCTSTR,DevInfo,DevInfo&> m_DevInfoMap;
 	CArray<YxConfigDef,YxConfigDef&> m_YxValueInfoCArray ;
+	CRITICAL_SECTION m_csYxValue;		//集中器通讯中断时m_YxValueInfoCArray的取数和更新由各处理线程串行执行
+	int m_nRtdbFrameRecords;			//实时库更新报文每帧最多记录数
+	int m_nRtdbWindow;					//实时库更新报文同时等待应答的帧数，0为逐帧同步发送
+	CRtdbUpdateWindow m_RtdbWindow;		//Update2RTDB的发送窗口，在m_csYxValue内使用
+	AlarmIntakeWorker m_IntakeWorkers[ALARMINTAKE_MAX_WORKERS];
+	int m_nWorkerNum;
+	volatile LONG m_nTotalReceived;
+	volatile LONG m_nTotalProcessed;
 protected:
 	DECLARE_MESSAGE_MAP()
 };
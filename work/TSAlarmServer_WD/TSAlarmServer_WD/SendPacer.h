@@ -0,0 +1,99 @@
+#pragma once
+
+#define MSGSEND_MAX_RETRYDELAY		60000	//退避等待上限(ms)
+#define MSGSEND_MAX_AHEAD			600000	//时间片最多预订到多久以后(ms)，超过的视为GetTickCount环绕前的旧时刻
+
+// CSendPacer
+// 单个接口的限速：每次调用占用1000/nRatePerSec毫秒的时间片，不足1ms的部分按微秒累计，
+// 每秒超过1000次也能限住。各发送线程依次预订时间片，未到时间的等待；空闲期间不攒额度，
+// 时间片从当前时刻重新开始。当前时刻由调用者传入，可以不睡眠地测试。
+//
+// 用法：
+//	pacer.SetRate(m_nRatePerSec);
+//	pacer.Wait();			//发送线程每次调用接口前
+//	Sleep(CSendPacer::GetRetryDelay(m_nRetryDelay, nTry));
+
+class CSendPacer
+{
+public:
+	CSendPacer()
+	{
+		m_nStepUs = 0;
+		m_bStarted = FALSE;
+		m_dwNextSlot = 0;
+		m_nNextSlotUs = 0;
+		InitializeCriticalSection(&m_csSlot);
+	}
+
+	~CSendPacer()
+	{
+		DeleteCriticalSection(&m_csSlot);
+	}
+
+	//nRatePerSec<=0表示不限速
+	void SetRate(int nRatePerSec)
+	{
+		EnterCriticalSection(&m_csSlot);
+		m_nStepUs = nRatePerSec > 0 ? 1000000/nRatePerSec : 0;
+		if (nRatePerSec > 0 && m_nStepUs == 0)
+		{
+			m_nStepUs = 1;
+		}
+		LeaveCriticalSection(&m_csSlot);
+	}
+
+	//预订下一个时间片，返回从dwNow(ms)起还需等待的毫秒数
+	DWORD Reserve(DWORD dwNow)
+	{
+		EnterCriticalSection(&m_csSlot);
+		if (m_nStepUs <= 0)
+		{
+			LeaveCriticalSection(&m_csSlot);
+			return 0;
+		}
+		LONG nAhead = (LONG)(m_dwNextSlot - dwNow);
+		if (!m_bStarted || nAhead < 0 || nAhead > MSGSEND_MAX_AHEAD)
+		{
+			m_bStarted = TRUE;
+			m_dwNextSlot = dwNow;
+			m_nNextSlotUs = 0;
+		}
+		DWORD dwWait = (m_dwNextSlot - dwNow) + (m_nNextSlotUs > 0 ? 1 : 0);
+		m_nNextSlotUs += m_nStepUs;
+		m_dwNextSlot += m_nNextSlotUs/1000;
+		m_nNextSlotUs %= 1000;
+		LeaveCriticalSection(&m_csSlot);
+		return dwWait;
+	}
+
+	void Wait()
+	{
+		DWORD dwWait = Reserve(GetTickCount());
+		if (dwWait > 0)
+		{
+			Sleep(dwWait);
+		}
+	}
+
+	//第nTry次重试(从1开始)前的退避等待：nRetryDelay、2倍、4倍...，不超过MSGSEND_MAX_RETRYDELAY
+	static DWORD GetRetryDelay(int nRetryDelay, int nTry)
+	{
+		if (nTry <= 0 || nRetryDelay <= 0)
+		{
+			return 0;
+		}
+		DWORD dwDelay = (DWORD)nRetryDelay;
+		for (int i=1; i<nTry && dwDelay<MSGSEND_MAX_RETRYDELAY; i++)
+		{
+			dwDelay <<= 1;
+		}
+		return dwDelay < MSGSEND_MAX_RETRYDELAY ? dwDelay : MSGSEND_MAX_RETRYDELAY;
+	}
+
+protected:
+	int m_nStepUs;				//每个时间片的微秒数，0为不限速
+	BOOL m_bStarted;
+	DWORD m_dwNextSlot;			//下一个时间片的起点(GetTickCount)
+	int m_nNextSlotUs;			//起点不足1ms的微秒数
+	CRITICAL_SECTION m_csSlot;
+};
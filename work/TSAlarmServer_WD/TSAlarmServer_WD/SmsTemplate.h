@@ -0,0 +1,126 @@
+#pragma once
+
+//短信模板中的占位符
+enum
+{
+	SMSFIELD_TEXT = 0,		//固定文本
+	SMSFIELD_OWNER,			//[owner] 负责人
+	SMSFIELD_OBJECT,		//[object] 告警对象
+	SMSFIELD_ALARMTYPE,		//[alarmtype] 告警类型名称
+	SMSFIELD_NUM
+};
+
+#define MAKE_SMSCFG_KEY(iPlazaId,type)	(((__int64)(iPlazaId)<<32)|(DWORD)(type))	//场站ID+告警类型
+
+struct SmsTemplateSegment
+{
+	int nField;			//SMSFIELD_xxx
+	CString strText;	//nField为SMSFIELD_TEXT时的固定文本
+};
+
+// CSmsTemplate
+// 加载TB_PAYMENT_SMSTEMPLATE时把模板拆成固定文本和占位符片段，生成短信时按片段顺序拼接，
+// 不再每条短信对整段模板做三次Replace。
+//
+// 用法：
+//	CSmsTemplate tpl;
+//	tpl.Compile(_T("[owner]您好，[object]发生[alarmtype]"));
+//	CString strFields[SMSFIELD_NUM];
+//	strFields[SMSFIELD_OWNER] = ...;
+//	tpl.Render(strFields, strContent);
+
+class CSmsTemplate
+{
+public:
+	CSmsTemplate()
+	{
+		m_nTextLen = 0;
+	}
+
+	void Compile(const CString &strTemplate)
+	{
+		static const LPCTSTR szFieldName[SMSFIELD_NUM] = {NULL, _T("[owner]"), _T("[object]"), _T("[alarmtype]")};
+		m_vecSegment.clear();
+		m_nTextLen = 0;
+		int nLen = strTemplate.GetLength();
+		int nTextBegin = 0;
+		int nPos = 0;
+		while (nPos < nLen)
+		{
+			int nField = SMSFIELD_TEXT;
+			int nNameLen = 0;
+			if (strTemplate[nPos] == _T('['))
+			{
+				for (int i=SMSFIELD_OWNER; i<SMSFIELD_NUM; i++)
+				{
+					int nCmpLen = (int)_tcslen(szFieldName[i]);
+					if (_tcsncmp((LPCTSTR)strTemplate + nPos, szFieldName[i], nCmpLen) == 0)
+					{
+						nField = i;
+						nNameLen = nCmpLen;
+						break;
+					}
+				}
+			}
+			if (nField == SMSFIELD_TEXT)
+			{
+				nPos++;
+				continue;
+			}
+			AddText(strTemplate.Mid(nTextBegin, nPos - nTextBegin));
+			SmsTemplateSegment iSegment;
+			iSegment.nField = nField;
+			m_vecSegment.push_back(iSegment);
+			nPos += nNameLen;
+			nTextBegin = nPos;
+		}
+		AddText(strTemplate.Mid(nTextBegin));
+	}
+
+	//pFields按SMSFIELD_xxx下标给出各占位符的取值
+	void Render(const CString *pFields, CString &strOut) const
+	{
+		int nOutLen = m_nTextLen;
+		for (size_t i=0; i<m_vecSegment.size(); i++)
+		{
+			if (m_vecSegment[i].nField != SMSFIELD_TEXT)
+			{
+				nOutLen += pFields[m_vecSegment[i].nField].GetLength();
+			}
+		}
+		strOut.Truncate(0);
+		strOut.Preallocate(nOutLen);
+		for (size_t i=0; i<m_vecSegment.size(); i++)
+		{
+			const SmsTemplateSegment &iSegment = m_vecSegment[i];
+			if (iSegment.nField == SMSFIELD_TEXT)
+			{
+				strOut.Append(iSegment.strText);
+			}
+			else
+			{
+				strOut.Append(pFields[iSegment.nField]);
+			}
+		}
+	}
+
+protected:
+	void AddText(const CString &strText)
+	{
+		if (strText.IsEmpty())
+		{
+			return;
+		}
+		SmsTemplateSegment iSegment;
+		iSegment.nField = SMSFIELD_TEXT;
+		iSegment.strText = strText;
+		m_vecSegment.push_back(iSegment);
+		m_nTextLen += strText.GetLength();
+	}
+
+	vector<SmsTemplateSegment> m_vecSegment;
+	int m_nTextLen;			//固定文本总长度
+};
+
+typedef map<__int64, SMSConfigDef> SMSConfigMap;		//键为MAKE_SMSCFG_KEY(场站ID,告警类型)
+typedef map<int, CSmsTemplate> SMSTemplateMap;			//键为模板编号
@@ -1,18 +1,18 @@
 
-// TSAlarmServer_WD.h : PROJECT_NAME Ӧóͷļ
+// TSAlarmServer_WD.h : PROJECT_NAME 应用程序的主头文件
 //
 
 #pragma once
 
 #ifndef __AFXWIN_H__
-	#error "ڰļ֮ǰstdafx.h PCH ļ"
+	#error "在包含此文件之前包含“stdafx.h”以生成 PCH 文件"
 #endif
 
-#include "resource.h"		// 
+#include "resource.h"		// 主符号
 
 
 // CTSAlarmServer_WDApp:
-// йشʵ֣ TSAlarmServer_WD.cpp
+// 有关此类的实现，请参阅 TSAlarmServer_WD.cpp
 //
 
 class CTSAlarmServer_WDApp : public CWinAppEx
@@ -20,11 +20,11 @@ class CTSAlarmServer_WDApp : public CWinAppEx
 public:
 	CTSAlarmServer_WDApp();
 
-// д
+// 重写
 	public:
 	virtual BOOL InitInstance();
 
-// ʵ
+// 实现
 
 	DECLARE_MESSAGE_MAP()
 };
@@ -1,5 +1,5 @@
 
-// TSAlarmServer_WDDlg.cpp : ʵļ
+// TSAlarmServer_WDDlg.cpp : 实现文件
 //
 
 #include "stdafx.h"
@@ -11,20 +11,20 @@
 #endif
 
 
-// Ӧó򡰹ڡ˵ CAboutDlg Ի
+// 用于应用程序“关于”菜单项的 CAboutDlg 对话框
 
 class CAboutDlg : public CDialog
 {
 public:
 	CAboutDlg();
 
-// Ի
+// 对话框数据
 	enum { IDD = IDD_ABOUTBOX };
 
 	protected:
-	virtual void DoDataExchange(CDataExchange* pDX);    // DDX/DDV ֧
+	virtual void DoDataExchange(CDataExchange* pDX);    // DDX/DDV 支持
 
-// ʵ
+// 实现
 protected:
 	DECLARE_MESSAGE_MAP()
 };
@@ -48,7 +48,7 @@ BEGIN_MESSAGE_MAP(CAboutDlg, CDialog)
 END_MESSAGE_MAP()
 
 
-// CTSAlarmServer_WDDlg Ի
+// CTSAlarmServer_WDDlg 对话框
 
 
 
@@ -76,15 +76,15 @@ BEGIN_MESSAGE_MAP(CTSAlarmServer_WDDlg, CDialog)
 END_MESSAGE_MAP()
 
 
-// CTSAlarmServer_WDDlg Ϣ
+// CTSAlarmServer_WDDlg 消息处理程序
 
 BOOL CTSAlarmServer_WDDlg::OnInitDialog()
 {
 	CDialog::OnInitDialog();
 
-	// ...˵ӵϵͳ˵С
+	// 将“关于...”菜单项添加到系统菜单中。
 
-	// IDM_ABOUTBOX ϵͳΧڡ
+	// IDM_ABOUTBOX 必须在系统命令范围内。
 	ASSERT((IDM_ABOUTBOX & 0xFFF0) == IDM_ABOUTBOX);
 	ASSERT(IDM_ABOUTBOX < 0xF000);
 
@@ -102,19 +102,33 @@ BOOL CTSAlarmServer_WDDlg::OnInitDialog()
 		}
 	}
 
-	// ô˶ԻͼꡣӦóڲǶԻʱܽԶ
-	//  ִд˲
-	SetIcon(m_hIcon, TRUE);			// ôͼ
-	SetIcon(m_hIcon, FALSE);		// Сͼ
+	// 设置此对话框的图标。当应用程序主窗口不是对话框时，框架将自动
+	//  执行此操作
+	SetIcon(m_hIcon, TRUE);			// 设置大图标
+	SetIcon(m_hIcon, FALSE);		// 设置小图标
 
-	// TODO: ڴӶĳʼ
-	m_TrayIcon.Create(this,WM_ICON_NOTIFY,_T("澯"),m_hIcon,IDR_MENU1); 
+	// TODO: 在此添加额外的初始化代码
+	m_TrayIcon.Create(this,WM_ICON_NOTIFY,_T("告警服务程序"),m_hIcon,IDR_MENU1); 
 	PostMessage(WM_SYSCOMMAND,SC_MINIMIZE,0);   
 	ShowWindow(SW_HIDE);
 
 	m_pAlarmTask = NULL;
 	m_pReceiveAlarmData = NULL;
 	m_pMessageTask = NULL;
+	m_pAlarmBatchWriter = NULL;
+	m_pAlarmArchiver = NULL;
+	//告警入库线程先于产生告警的线程启动
+	m_pAlarmBatchWriter = new CAlarmBatchWriter;
+	if (m_pAlarmBatchWriter)
+	{
+		m_pAlarmBatchWriter->CreateThread();
+	}
+	//告警迁移线程启动后先续做上次未完成的迁移
+	m_pAlarmArchiver = new CAlarmArchiver;
+	if (m_pAlarmArchiver)
+	{
+		m_pAlarmArchiver->CreateThread();
+	}
 	//m_pMessageTask = new CMessageTask;
 	m_pReceiveAlarmData = new CReceiveAlarmData;
 	m_pAlarmTask = new CAlarmTask;
@@ -133,7 +147,7 @@ BOOL CTSAlarmServer_WDDlg::OnInitDialog()
 	{
 		m_pMessageTask->CreateThread();
 	}
-	return TRUE;  // ǽõؼ򷵻 TRUE
+	return TRUE;  // 除非将焦点设置到控件，否则返回 TRUE
 }
 
 void CTSAlarmServer_WDDlg::OnSysCommand(UINT nID, LPARAM lParam)
@@ -161,19 +175,19 @@ void CTSAlarmServer_WDDlg::OnSysCommand(UINT nID, LPARAM lParam)
 	}
 }
 
-// ԻСťҪĴ
-//  Ƹͼꡣʹĵ/ͼģ͵ MFC Ӧó
-//  ⽫ɿԶɡ
+// 如果向对话框添加最小化按钮，则需要下面的代码
+//  来绘制该图标。对于使用文档/视图模型的 MFC 应用程序，
+//  这将由框架自动完成。
 
 void CTSAlarmServer_WDDlg::OnPaint()
 {
 	if (IsIconic())
 	{
-		CPaintDC dc(this); // ڻƵ豸
+		CPaintDC dc(this); // 用于绘制的设备上下文
 
 		SendMessage(WM_ICONERASEBKGND, reinterpret_cast<WPARAM>(dc.GetSafeHdc()), 0);
 
-		// ʹͼڹо
+		// 使图标在工作区矩形中居中
 		int cxIcon = GetSystemMetrics(SM_CXICON);
 		int cyIcon = GetSystemMetrics(SM_CYICON);
 		CRect rect;
@@ -181,7 +195,7 @@ void CTSAlarmServer_WDDlg::OnPaint()
 		int x = (rect.Width() - cxIcon + 1) / 2;
 		int y = (rect.Height() - cyIcon + 1) / 2;
 
-		// ͼ
+		// 绘制图标
 		dc.DrawIcon(x, y, m_hIcon);
 	}
 	else
@@ -190,8 +204,8 @@ void CTSAlarmServer_WDDlg::OnPaint()
 	}
 }
 
-//û϶Сʱϵͳô˺ȡù
-//ʾ
+//当用户拖动最小化窗口时系统调用此函数取得光标
+//显示。
 HCURSOR CTSAlarmServer_WDDlg::OnQueryDragIcon()
 {
 	return static_cast<HCURSOR>(m_hIcon);
@@ -205,6 +219,20 @@ void CTSAlarmServer_WDDlg::OnAbout1()
 
 void CTSAlarmServer_WDDlg::OnExit()
 {
+	if (m_pAlarmBatchWriter)
+	{
+		//入库线程退出前会写完缓存；再Flush一次，写入等待期间其他线程新加入的告警
+		m_pAlarmBatchWriter->Stop();
+		m_pAlarmBatchWriter->Flush();
+	}
+	if (m_pAlarmArchiver)
+	{
+		m_pAlarmArchiver->Stop();
+	}
+	if (m_pMessageTask)
+	{
+		m_pMessageTask->Stop();
+	}
 	m_TrayIcon.RemoveIcon();
 	CDialog::OnDestroy();
 }
@@ -1,5 +1,5 @@
 
-// TSAlarmServer_WDDlg.h : ͷļ
+// TSAlarmServer_WDDlg.h : 头文件
 //
 
 #pragma once
@@ -7,30 +7,34 @@
 #include "AlarmTask.h"
 #include "ReceiveAlarmData.h"
 #include "MessageTask.h"
+#include "AlarmBatchWriter.h"
+#include "AlarmArchiver.h"
 
-// CTSAlarmServer_WDDlg Ի
+// CTSAlarmServer_WDDlg 对话框
 class CTSAlarmServer_WDDlg : public CDialog
 {
-// 
+// 构造
 public:
-	CTSAlarmServer_WDDlg(CWnd* pParent = NULL);	// ׼캯
+	CTSAlarmServer_WDDlg(CWnd* pParent = NULL);	// 标准构造函数
 
-// Ի
+// 对话框数据
 	enum { IDD = IDD_TSALARMSERVER_WD_DIALOG };
 
 	protected:
-	virtual void DoDataExchange(CDataExchange* pDX);	// DDX/DDV ֧
+	virtual void DoDataExchange(CDataExchange* pDX);	// DDX/DDV 支持
 
 public:
 	CAlarmTask *m_pAlarmTask;
 	CReceiveAlarmData *m_pReceiveAlarmData;
 	CMessageTask *m_pMessageTask;
-// ʵ
+	CAlarmBatchWriter *m_pAlarmBatchWriter;
+	CAlarmArchiver *m_pAlarmArchiver;
+// 实现
 protected:
 	LRESULT OnTrayNotification(WPARAM wParam,LPARAM lParam);
 	HICON m_hIcon;
 	CTrayIcon m_TrayIcon;
-	// ɵϢӳ亯
+	// 生成的消息映射函数
 	virtual BOOL OnInitDialog();
 	afx_msg void OnSysCommand(UINT nID, LPARAM lParam);
 	afx_msg void OnPaint();
@@ -1,7 +1,7 @@
 
-// stdafx.h : ׼ϵͳļİļ
-// Ǿʹõĵ
-// ضĿİļ
+// stdafx.h : 标准系统包含文件的包含文件，
+// 或是经常使用但不常更改的
+// 特定于项目的包含文件
 
 #pragma once
 
@@ -10,34 +10,34 @@
 #endif
 
 #ifndef VC_EXTRALEAN
-#define VC_EXTRALEAN            //  Windows ͷųʹõ
+#define VC_EXTRALEAN            // 从 Windows 头中排除极少使用的资料
 #endif
 
 #include "targetver.h"
 
 #define WM_ICON_NOTIFY WM_USER+102
 
-#define _ATL_CSTRING_EXPLICIT_CONSTRUCTORS      // ĳЩ CString 캯ʽ
+#define _ATL_CSTRING_EXPLICIT_CONSTRUCTORS      // 某些 CString 构造函数将是显式的
 
-// ر MFC ĳЩɷĺԵľϢ
+// 关闭 MFC 对某些常见但经常可放心忽略的警告消息的隐藏
 #define _AFX_ALL_WARNINGS
 
-#include <afxwin.h>         // MFC ͱ׼
-#include <afxext.h>         // MFC չ
+#include <afxwin.h>         // MFC 核心组件和标准组件
+#include <afxext.h>         // MFC 扩展
 
 
-#include <afxdisp.h>        // MFC Զ
+#include <afxdisp.h>        // MFC 自动化类
 
 
 
 #ifndef _AFX_NO_OLE_SUPPORT
-#include <afxdtctl.h>           // MFC  Internet Explorer 4 ؼ֧
+#include <afxdtctl.h>           // MFC 对 Internet Explorer 4 公共控件的支持
 #endif
 #ifndef _AFX_NO_AFXCMN_SUPPORT
-#include <afxcmn.h>             // MFC  Windows ؼ֧
+#include <afxcmn.h>             // MFC 对 Windows 公共控件的支持
 #endif // _AFX_NO_AFXCMN_SUPPORT
 
-#include <afxcontrolbars.h>     // Ϳؼ MFC ֧
+#include <afxcontrolbars.h>     // 功能区和控件条的 MFC 支持
 
 #include "soapH.h"
 #include "NETMESSAGE.H"
@@ -52,6 +52,9 @@
 #include "TypedefEx.h"
 #include "AClient.h"
 #include "LCD.h"
+#include "RecordSetReader.h"
+#include "RtdbUpdateFrame.h"
+#include "RtdbUpdateWindow.h"
 
 #pragma comment(lib,"LCD.lib")
 
@@ -96,14 +99,14 @@ typedef struct _AlarmMsgHead
 
 typedef struct _AlarmInfo
 {
-	int ObjectId;			//澯Id
-	int ObjectType;			//	31-豸 33-
-	int AlarmType;			//澯
-	int reserve;			//ֶ Ϊ31ʱ Ϊվ
-	CTime AlarmTime;		//澯ʱ
-	int Status;				//澯״̬
-	TCHAR Contents[256];	//澯
-	TCHAR Suggest[256];		//ʾ
+	int ObjectId;			//告警对象Id
+	int ObjectType;			//对象类型	31-设备 33-集中器
+	int AlarmType;			//告警类型
+	int reserve;			//保留字段 当对象类型为31时 作为场站号
+	CTime AlarmTime;		//告警时间
+	int Status;				//告警状态
+	TCHAR Contents[256];	//告警内容
+	TCHAR Suggest[256];		//处理策略提示
 }AlarmInfo;
 
 struct AlarmTypeDef
@@ -131,9 +134,9 @@ struct SMSConfigDef
 	TCHAR PhoneNum[65];
 };
 
-#define ALARMSTATUS_NEWALARM	0   //ڸ澯
-#define ALARMSTATUS_REVERSE		2	//ָ澯
-//ҵ澯
+#define ALARMSTATUS_NEWALARM	0   //正在告警
+#define ALARMSTATUS_REVERSE		2	//恢复告警
+//业务告警
 #define ALARMTYPE_RUSH				8001
 #define ALARMTYPE_CONTRACTNODEV		8002
 #define ALARMTYPE_CONTRACTEND		8003
@@ -141,9 +144,9 @@ struct SMSConfigDef
 #define ALARMTYPE_BUSSINESS_HIGH	8005
 #define ALARMTYPE_BILLOVERTIME		8007				
 
-//ϵͳ澯
+//系统告警
 
-//豸澯
+//设备告警
 #define ALARMTYPE_DEV_OVERDRAFT		9001
 #define ALARMTYPE_DEV_UNCOMMUN		9003
 #define ALARMTYPE_STATION_UNCOMMUN	9004
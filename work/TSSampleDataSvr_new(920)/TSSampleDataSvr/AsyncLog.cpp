@@ -0,0 +1,281 @@
+// AsyncLog.cpp : 实现文件
+//
+
+#include "stdafx.h"
+#include "AsyncLog.h"
+
+#include <shlwapi.h>
+
+// CAsyncLog
+
+CAsyncLog::CAsyncLog(LPCTSTR strFile)
+: m_LogQueue(LOG_QUEUE_SIZE)
+{
+	InitializeCriticalSection(&m_csDrain);
+	m_nLevel = LOGLEVEL_Config;
+	m_nDropped = 0;
+	m_nReportedDropped = 0;
+	m_nCurrentIndex = 0;
+	m_nLogFileTime = 0;
+	m_nFileSize = 0;
+	m_nWriteLen = 0;
+	m_pWriteBuf = new char[ASYNCLOG_WRITE_BUFSIZE];
+	m_hLogEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	m_hExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	CString sPath, sPath1(_T("\\log"));
+	GetModuleFileName(NULL, sPath.GetBuffer(MAX_PATH), MAX_PATH);
+	sPath.ReleaseBuffer();
+	sPath = sPath.Left(sPath.ReverseFind('\\'));
+	if (!PathFileExists(sPath + sPath1))
+	{
+		CreateDirectory(sPath + sPath1, NULL);
+	}
+	m_sPath.Format(_T("%s%s%s_"), (LPCTSTR)sPath, (LPCTSTR)sPath1, strFile);
+
+	//日志级别：0-Debug 1-Config 2-ERRO
+	CString strCfgPath = sPath + _T("\\parameter\\emscfg.ini");
+	m_nLevel = GetPrivateProfileInt(_T("LOG"),_T("Level"),LOGLEVEL_Config,strCfgPath);
+
+	m_pFlushThread = AfxBeginThread(FlushThreadProc, this, THREAD_PRIORITY_BELOW_NORMAL, 0, CREATE_SUSPENDED);
+	if (m_pFlushThread != NULL)
+	{
+		m_pFlushThread->m_bAutoDelete = FALSE;
+		m_pFlushThread->ResumeThread();
+	}
+}
+
+CAsyncLog::~CAsyncLog()
+{
+	SetEvent(m_hExitEvent);
+	if (m_pFlushThread != NULL)
+	{
+		//后台线程访问本对象的队列、文件和缓冲区，必须等它真正退出后才能析构；
+		//它收到退出事件后最多再完成一次落盘，不会无限阻塞
+		WaitForSingleObject(m_pFlushThread->m_hThread, INFINITE);
+		delete m_pFlushThread;
+		m_pFlushThread = NULL;
+	}
+	Flush();
+	if (m_fLog.m_hFile != CFile::hFileNull)
+	{
+		m_fLog.Close();
+	}
+	delete [] m_pWriteBuf;
+	m_pWriteBuf = NULL;
+	CloseHandle(m_hLogEvent);
+	CloseHandle(m_hExitEvent);
+	DeleteCriticalSection(&m_csDrain);
+}
+
+void CAsyncLog::Log(LPCTSTR strLog)
+{
+	if (NULL == strLog)
+	{
+		return;
+	}
+	LONG nPos = 0;
+	LogRecord *pRecord = m_LogQueue.BeginPush(nPos);
+	if (pRecord == NULL)
+	{
+		//不阻塞业务线程，队列满时直接丢弃并计数
+		InterlockedIncrement(&m_nDropped);
+		SetEvent(m_hLogEvent);
+		return;
+	}
+	//正文按实际长度拷入槽中，超过LOG_RECORD_LEN的部分截断
+	size_t nLen = _tcsnlen(strLog, LOG_RECORD_LEN - 1);
+	GetLocalTime(&pRecord->st);
+	memcpy(pRecord->szText, strLog, nLen * sizeof(TCHAR));
+	pRecord->szText[nLen] = 0;
+	m_LogQueue.CommitPush(nPos);
+	if (m_LogQueue.GetSize() > LOG_QUEUE_SIZE/2)
+	{
+		SetEvent(m_hLogEvent);
+	}
+}
+
+//把队列中已有的日志全部写入文件，程序退出或异常处理时调用
+void CAsyncLog::Flush()
+{
+	DrainQueue();
+}
+
+UINT CAsyncLog::FlushThreadProc(LPVOID pParam)
+{
+	CAsyncLog *pLog = (CAsyncLog*)pParam;
+	HANDLE hEvents[2];
+	hEvents[0] = pLog->m_hExitEvent;
+	hEvents[1] = pLog->m_hLogEvent;
+	while(1)
+	{
+		DWORD dwWait = WaitForMultipleObjects(2, hEvents, FALSE, ASYNCLOG_FLUSH_INTERVAL);
+		if (dwWait == WAIT_OBJECT_0)
+		{
+			break;
+		}
+		pLog->DrainQueue();
+	}
+	return 0;
+}
+
+void CAsyncLog::DrainQueue()
+{
+	EnterCriticalSection(&m_csDrain);
+	LogRecord *pRecord = NULL;
+	while ((pRecord = m_LogQueue.Front()) != NULL)
+	{
+		AppendRecord(pRecord->st, pRecord->szText);
+		m_LogQueue.PopFront();
+	}
+	LONG nDropped = m_nDropped;
+	if (nDropped != m_nReportedDropped)
+	{
+		SYSTEMTIME st;
+		TCHAR szText[LOG_DROP_TEXT_LEN];
+		GetLocalTime(&st);
+		_sntprintf_s(szText, LOG_DROP_TEXT_LEN, _TRUNCATE, _T("[ERRO][%20s:%-4d]日志队列已满,累计丢弃%d条"),
+			_T(__FUNCTION__), __LINE__, nDropped);
+		AppendRecord(st, szText);
+		m_nReportedDropped = nDropped;
+	}
+	WriteBuffer();
+	LeaveCriticalSection(&m_csDrain);
+}
+
+void CAsyncLog::AppendRecord(const SYSTEMTIME &st, LPCTSTR szText)
+{
+	unsigned int nLogFileTime = st.wYear * 10000 + st.wMonth * 100 + st.wDay;
+	if (m_fLog.m_hFile == CFile::hFileNull || nLogFileTime != m_nLogFileTime || m_nFileSize > ASYNCLOG_FILE_MAX_SIZE)
+	{
+		WriteBuffer();
+		if (!OpenLogFile(st))
+		{
+			return;
+		}
+	}
+
+	//一条日志最多占LOG_RECORD_LEN个字符的多字节编码加时间戳，缓冲区不足时先落盘
+	if (m_nWriteLen + LOG_RECORD_LEN*2 + 64 > ASYNCLOG_WRITE_BUFSIZE)
+	{
+		WriteBuffer();
+	}
+	char *pDst = m_pWriteBuf + m_nWriteLen;
+	int nLeft = ASYNCLOG_WRITE_BUFSIZE - m_nWriteLen;
+	int nLen = _snprintf_s(pDst, nLeft, _TRUNCATE, "%04d-%02d-%02d %02d:%02d:%02d:%03d\t",
+		st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+	if (nLen < 0)
+	{
+		return;
+	}
+	pDst += nLen;
+	nLeft -= nLen;
+#ifdef _UNICODE
+	int nText = WideCharToMultiByte(CP_ACP, 0, szText, -1, pDst, nLeft - 2, NULL, NULL);
+	nText = (nText > 0) ? nText - 1 : 0;
+#else
+	int nText = 0;
+	strncpy_s(pDst, nLeft - 2, szText, _TRUNCATE);
+	nText = (int)strlen(pDst);
+#endif
+	pDst += nText;
+	*pDst++ = '\r';
+	*pDst++ = '\n';
+	m_nWriteLen += nLen + nText + 2;
+}
+
+void CAsyncLog::WriteBuffer()
+{
+	if (m_nWriteLen <= 0 || m_fLog.m_hFile == CFile::hFileNull)
+	{
+		return;
+	}
+	TRY
+	{
+		m_fLog.Write(m_pWriteBuf, m_nWriteLen);
+		m_fLog.Flush();
+	}
+	CATCH(CFileException, e)
+	{
+	}
+	END_CATCH
+	m_nFileSize += m_nWriteLen;
+	m_nWriteLen = 0;
+}
+
+BOOL CAsyncLog::OpenLogFile(const SYSTEMTIME &st)
+{
+	CTime tmNow(st);
+	unsigned int nLogFileTime = st.wYear * 10000 + st.wMonth * 100 + st.wDay;
+	CString strLogFileFullPath;
+	if (m_fLog.m_hFile == CFile::hFileNull)
+	{
+		//首次打开，接着当天最后一个文件写
+		if (!GetCurentIndex(tmNow, strLogFileFullPath))
+		{
+			m_nCurrentIndex = 0;
+			strLogFileFullPath = GetLogFileFullPath(tmNow, m_nCurrentIndex);
+		}
+	}
+	else
+	{
+		m_fLog.Close();
+		if (nLogFileTime != m_nLogFileTime)
+		{
+			m_nCurrentIndex = 0;
+		}
+		else
+		{
+			m_nCurrentIndex++;
+		}
+		strLogFileFullPath = GetLogFileFullPath(tmNow, m_nCurrentIndex);
+	}
+
+	if (!m_fLog.Open(strLogFileFullPath, CFile::modeCreate|CFile::shareDenyNone | CFile::modeNoTruncate | CFile::modeReadWrite))
+	{
+		return FALSE;
+	}
+	m_nFileSize = m_fLog.SeekToEnd();
+	m_nLogFileTime = nLogFileTime;
+	return TRUE;
+}
+
+BOOL CAsyncLog::GetCurentIndex(const CTime &tm, CString &strFileFullPath)
+{
+	CFileFind finder;
+	m_nCurrentIndex = -1;
+	strFileFullPath = _T("");
+
+	CString strTime;
+	strTime.Format(_T("%04d%02d%02d_"), tm.GetYear(), tm.GetMonth(), tm.GetDay());
+	for (int i=999; i>=0; i--)
+	{
+		CString strTemp;
+		strTemp.Format(_T("%03d.log"), i);
+		CString strWildcard = m_sPath + strTime + strTemp;
+		if (finder.FindFile(strWildcard))
+		{
+			m_nCurrentIndex = i;
+			strFileFullPath = strWildcard;
+			break;
+		}
+	}
+	finder.Close();
+
+	if (m_nCurrentIndex == -1)
+	{
+		return FALSE;
+	}
+	return TRUE;
+}
+
+CString CAsyncLog::GetLogFileFullPath(const CTime &tm, int nIndex)
+{
+	CString strTime;
+	strTime.Format(_T("%04d%02d%02d_"), tm.GetYear(), tm.GetMonth(), tm.GetDay());
+
+	CString strTemp;
+	strTemp.Format(_T("%03d"), nIndex);
+
+	return m_sPath + strTime + strTemp + _T(".log");
+}
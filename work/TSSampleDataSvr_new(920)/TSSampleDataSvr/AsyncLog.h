@@ -0,0 +1,70 @@
+#pragma once
+
+#define LOG_RECORD_LEN			2048				//单条日志最大字符数，超出部分截断
+#define LOG_QUEUE_SIZE			1024				//日志队列容量(条)，每条连同正文定长存放，Unicode下每条约4KB
+#define LOG_DROP_TEXT_LEN		128					//丢弃统计日志的最大字符数
+#define ASYNCLOG_FILE_MAX_SIZE	(50*1024*1024)		//单个日志文件最大字节数，与CLog一致
+#define ASYNCLOG_WRITE_BUFSIZE	(64*1024)			//落盘缓冲区大小
+#define ASYNCLOG_FLUSH_INTERVAL	200					//后台线程最长落盘间隔(ms)
+
+//日志级别，ReguTrace的type参数通过LOGLEVEL_##type映射到级别，低于当前级别的日志不做格式化
+enum
+{
+	LOGLEVEL_Debug = 0,
+	LOGLEVEL_Config = 1,
+	LOGLEVEL_SQL = 1,
+	LOGLEVEL_YXDATA = 1,
+	LOGLEVEL_PrepayRecord = 1,
+	LOGLEVEL_ERRO = 2,
+	LOGLEVEL_SQLERRO = 2,
+};
+
+//日志正文直接存放在队列槽中，调用线程原地写入、后台线程原地读出，不为每条日志分配内存
+struct LogRecord
+{
+	SYSTEMTIME st;
+	TCHAR szText[LOG_RECORD_LEN];
+};
+
+// CAsyncLog
+// 异步日志：调用线程只把已格式化的日志正文放入无锁队列，
+// 时间戳格式化、编码转换和写文件都由后台线程批量完成。
+// 文件命名和按天/按大小切换的规则与CLog相同：log\<名称>_YYYYMMDD_NNN.log
+
+class CAsyncLog
+{
+public:
+	CAsyncLog(LPCTSTR strFile);
+	virtual ~CAsyncLog();
+
+	void Log(LPCTSTR strLog);
+	void Flush();
+	BOOL IsEnabled(int nLevel) const { return nLevel >= m_nLevel; }
+
+public:
+	int m_nLevel;		//最低输出级别，从emscfg.ini的[LOG]段Level读取
+
+protected:
+	static UINT FlushThreadProc(LPVOID pParam);
+	void DrainQueue();
+	void AppendRecord(const SYSTEMTIME &st, LPCTSTR szText);
+	void WriteBuffer();
+	BOOL OpenLogFile(const SYSTEMTIME &st);
+	BOOL GetCurentIndex(const CTime &tm, CString &strFileFullPath);
+	CString GetLogFileFullPath(const CTime &tm, int nIndex);
+
+	CMpscQueue<LogRecord> m_LogQueue;
+	CRITICAL_SECTION m_csDrain;		//后台线程与Flush()调用者互斥出队
+	HANDLE m_hLogEvent,m_hExitEvent;
+	CWinThread *m_pFlushThread;
+	volatile LONG m_nDropped;		//队列满时丢弃的条数
+	LONG m_nReportedDropped;
+
+	CFile m_fLog;
+	CString m_sPath;
+	int m_nCurrentIndex;
+	unsigned int m_nLogFileTime;
+	ULONGLONG m_nFileSize;
+	char *m_pWriteBuf;
+	int m_nWriteLen;
+};
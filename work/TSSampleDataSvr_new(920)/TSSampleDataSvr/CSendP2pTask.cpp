@@ -1,4 +1,4 @@
-// CSendP2pTask.cpp : ʵļ
+// CSendP2pTask.cpp : 实现文件
 //
 #pragma once
 #include "stdafx.h"
@@ -7,7 +7,7 @@
 #include "TSSampleDataSvr.h"
 #include "TSSampleDataSvrDlg.h"
 
-extern CLog *g_log ;
+extern CAsyncLog *g_log ;
 // CCSendP2pTask
 #pragma pack(1)
 typedef struct YmUnit_{
@@ -42,6 +42,8 @@ typedef struct MmiYmFrame_ {
 IMPLEMENT_DYNCREATE(CCSendP2pTask, CWinThread)
 
 CCSendP2pTask::CCSendP2pTask()
+: m_RecordQueue(RECORDLIST_QUEUE_SIZE)
+, m_AlarmInfoQueue(ALARMINFO_QUEUE_SIZE)
 {
 	m_SoftBus = new CRedisBus;
 	m_ProcessDataEvent = NULL;
@@ -49,11 +51,9 @@ CCSendP2pTask::CCSendP2pTask()
 	m_hExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 	m_ProcessDataEvent = CreateEvent(NULL,TRUE, FALSE, NULL);
 	m_AlarmEvent = CreateEvent(NULL,TRUE, FALSE, NULL);
-	InitializeCriticalSection(&m_csRecordList);
-	InitializeCriticalSection(&m_csAlarmInfoList);
 	if(g_log==NULL)
 	{
-		g_log = new CLog(_T("\\TSSampleDataSvr"));
+		g_log = new CAsyncLog(_T("\\TSSampleDataSvr"));
 	}
 }
 
@@ -64,7 +64,7 @@ CCSendP2pTask::~CCSendP2pTask()
 
 BOOL CCSendP2pTask::InitInstance()
 {
-	// TODO: ڴִ̳߳ʼ
+	// TODO: 在此执行任意逐线程初始化
 	redisContext *con = NULL;
 	int i = 0;
 
@@ -95,9 +95,9 @@ BOOL CCSendP2pTask::InitInstance()
 		 CTime ttCurTime = CTime::GetCurrentTime();
 		 ProtocolCallItem iItem;
 		 memset(&iItem,0,sizeof(ProtocolCallItem));
-		 ////******************ֵ¼for test************************
+		 ////******************组充值记录报文for test************************
 		 //iItem.m_nType = 0xE1;
-		 //iItem.m_nDeviceNo = 21;   //豸һ Id
+		 //iItem.m_nDeviceNo = 21;   //设备表第一列 Id
 		 //iItem.m_nStationNum = 3;
 
 		 //SocketMsgPrepayRecord iPrepayRecord ;
@@ -105,12 +105,12 @@ BOOL CCSendP2pTask::InitInstance()
 		 //iPrepayRecord.btRtuNo = 3;   //==m_nStationNum
 		 //iPrepayRecord.btEndNo = 0xff;
 		 //iPrepayRecord.btForeNo = 0x20;
-		 //iPrepayRecord.nDevNo = 2;  //豸ڶ deviceNo
+		 //iPrepayRecord.nDevNo = 2;  //设备表第二列 deviceNo
 		 //iPrepayRecord.wdYjNum = 2;
 		 //memcpy(iItem.m_nBuffer,&iPrepayRecord,sizeof(SocketMsgPrepayRecord));
-		 ////******************ֵ¼END************************
+		 ////******************组充值记录报文END************************
 
-		 ////******************бfor test************************
+		 ////******************组点招报文for test************************
 		 //iItem.m_nType = 0xB3;
 		 //iItem.m_nDeviceNo = nDevId;  //24 25
 		 //iItem.m_nStationNum = 2;
@@ -126,47 +126,37 @@ BOOL CCSendP2pTask::InitInstance()
 		 //iHuPrepayRecord.dwProcessId = 1001;
 		 //iHuPrepayRecord.dwUseId = 11;
 		 //memcpy(iItem.m_nBuffer,&iHuPrepayRecord,sizeof(SocketMsgHuRecord));
-		 ////******************бEND************************
+		 ////******************组点招报文END************************
 
-		 //**************************гֵ¼*********************************
+		 //**************************招充值记录*********************************
 		 HANDLE hEvents[3];
 		 hEvents[0] = m_hExitEvent; 
-		 ResetEvent(hEvents[0]);
 		 hEvents[1] = m_ProcessDataEvent;
-		 ResetEvent(hEvents[1]);
 		 hEvents[2] = m_AlarmEvent;
-		 ResetEvent(hEvents[2]);
 		 DWORD dwWait = WaitForMultipleObjects(3, hEvents, FALSE, INFINITE);
 		 switch (dwWait)
 		 {
 		 case WAIT_TIMEOUT:
 			 break;
 		 case WAIT_OBJECT_0:	  
+			 ResetEvent(hEvents[0]);
 			 break;
 		 case WAIT_OBJECT_0+1:   
 			 ResetEvent(hEvents[1]);
 				{
-					EnterCriticalSection(&m_csRecordList);
-					POSITION pos = NULL;
-					pos = m_RecordList.GetHeadPosition();
-					ReguTrace(Config,"ʼгֵ¼");
-					while (pos) 
+					ProtocolCallItem * pItem = NULL;
+					ReguTrace(Config,"开始发送招充值记录报文");
+					while (m_RecordQueue.Pop(pItem)) 
 					{
-						ProtocolCallItem * pItem = NULL;
-						POSITION pos1 = pos;
-						pItem = (ProtocolCallItem*)m_RecordList.GetNext(pos);
-						m_RecordList.RemoveAt(pos1);
 						if (pItem)
 						{
 							int Totallength=sizeof(ProtocolCallItem);
 							unsigned char * buffer = (unsigned char *)pItem;
-							ReguTrace(Config,"ʼгֵ¼:%s",bufToHexString(buffer,Totallength).c_str());
+							ReguTrace(Config,"开始发送招充值记录报文:%s",bufToHexString(buffer,Totallength).c_str());
 							if(m_SoftBus->SendMessageToMsmq("DownMessage",buffer,Totallength)== REDIS_ERR)
 							{
-								LeaveCriticalSection(&m_csRecordList);//MSW 150828 ADD,ֹredisʧܣ¶
 								m_SoftBus->UnRegisterSoftBus();
 								ConnectRedisServer();
-								EnterCriticalSection(&m_csRecordList);//MSW 150828 ADD,ֹredisʧܣ¶
 							}
 
 							delete pItem;
@@ -174,23 +164,19 @@ BOOL CCSendP2pTask::InitInstance()
 						}
 						
 					}
-
-					LeaveCriticalSection(&m_csRecordList);
-
+					if (m_RecordQueue.GetDropped()>0)
+					{
+						ReguTrace(Config,"招充值记录队列:最高%d,累计丢弃%d",m_RecordQueue.GetHighWater(),m_RecordQueue.GetDropped());
+					}
 				}
 				break;
 		 case WAIT_OBJECT_0+2:
 			 ResetEvent(hEvents[2]);
 			{
-				EnterCriticalSection(&m_csAlarmInfoList);
-				POSITION pos = NULL;
-				pos = m_AlarmInfoList.GetHeadPosition();
-				ReguTrace(Config,"ʼ͸澯Ϣ");
-				while (pos) 
+				AlarmInfo * pAlarmInfo = NULL;
+				ReguTrace(Config,"开始发送告警信息报文");
+				while (m_AlarmInfoQueue.Pop(pAlarmInfo)) 
 				{
-					AlarmInfo * pAlarmInfo = NULL;
-					POSITION pos1 = pos;
-					pAlarmInfo = (AlarmInfo*)m_AlarmInfoList.GetNext(pos);
 					if (pAlarmInfo)
 					{
 						int Totallength=sizeof(AlarmInfo) + sizeof(AlarmMsgHead);
@@ -202,13 +188,11 @@ BOOL CCSendP2pTask::InitInstance()
 						memcpy(buffer,&iAlarmHeadMsg,sizeof(AlarmMsgHead));
 						memcpy(buffer+sizeof(AlarmMsgHead),pAlarmInfo,sizeof(AlarmInfo));
 						
-						ReguTrace(Config,"ʼ͸澯Ϣ:澯:%d,վ:%d,״̬:%d",pAlarmInfo->ObjectId,pAlarmInfo->reserve,pAlarmInfo->Status);
+						ReguTrace(Config,"开始发送告警信息报文:告警对象:%d,所属厂站:%d,状态:%d",pAlarmInfo->ObjectId,pAlarmInfo->reserve,pAlarmInfo->Status);
 						if(m_SoftBus->SendMessageToMsmq("AlarmInfoData",buffer,Totallength)== REDIS_ERR)
 						{
-							LeaveCriticalSection(&m_csAlarmInfoList);//MSW 150828 ADD,ֹredisʧܣ¶
 							m_SoftBus->UnRegisterSoftBus();
 							ConnectRedisServer();
-							EnterCriticalSection(&m_csAlarmInfoList);//MSW 150828 ADD,ֹredisʧܣ¶
 						}
 
 						delete pAlarmInfo;
@@ -219,17 +203,17 @@ BOOL CCSendP2pTask::InitInstance()
 							buffer = NULL;
 						}
 					}
-					m_AlarmInfoList.RemoveAt(pos1);
 				}
-
-				LeaveCriticalSection(&m_csAlarmInfoList);
-
+				if (m_AlarmInfoQueue.GetDropped()>0)
+				{
+					ReguTrace(Config,"告警信息队列:最高%d,累计丢弃%d",m_AlarmInfoQueue.GetHighWater(),m_AlarmInfoQueue.GetDropped());
+				}
 			}
 			break;
 		 default:
 			 break;
 		 }
-		 //**************************гֵ¼END*********************************
+		 //**************************招充值记录END*********************************
 		/* int Totallength=sizeof(ProtocolCallItem);
 		 unsigned char * buffer = (unsigned char *)&iItem;
 
@@ -269,12 +253,12 @@ int CCSendP2pTask::GetTestBuffer(unsigned char ** buffer)
 
 	SocketMsgGroupYmDataEx_DATE* pSocketMsgYmData = new SocketMsgGroupYmDataEx_DATE;
 	CTime ttCurTime = CTime::GetCurrentTime();
-	pSocketMsgYmData->btForeNo=1;  //Դ
-	pSocketMsgYmData->btEndNo=0xff;   //Ŀػ
-	pSocketMsgYmData->btRtuNo=1;   //RTU
-	pSocketMsgYmData->wdYxNum=0; //YX  
-	pSocketMsgYmData->wdYcNum=0;   //YC 
-	pSocketMsgYmData->wdYmNum=1;   //YM 
+	pSocketMsgYmData->btForeNo=1;  //源机器号
+	pSocketMsgYmData->btEndNo=0xff;   //目地机器号
+	pSocketMsgYmData->btRtuNo=1;   //RTU号
+	pSocketMsgYmData->wdYxNum=0; //YX 包数 
+	pSocketMsgYmData->wdYcNum=0;   //YC 包数
+	pSocketMsgYmData->wdYmNum=1;   //YM 包数
 	pSocketMsgYmData->bYear=15;
 	pSocketMsgYmData->bMonth=ttCurTime.GetMonth();
 	pSocketMsgYmData->bDay=ttCurTime.GetDay();
@@ -289,7 +273,7 @@ int CCSendP2pTask::GetTestBuffer(unsigned char ** buffer)
 	SocketGroupYmUnitEx *pYmData = pSocketMsgYmData->YmUnitEx;
 	int ByteOffset = 0;
 	int i = 0;
-	/*Totallength ʱټһYmUnitΪMmiYmFrameвܶYmUnit YmUnit[0];*/
+	/*计算Totallength 时需少计算一个YmUnit，因为MmiYmFrame中不能定义YmUnit YmUnit[0];*/
 	int si = sizeof(MmiYmFrame);
 	int sa = sizeof(SocketGroupYmUnitEx);
 	int sb = sizeof(unsigned char);
@@ -371,7 +355,7 @@ BOOL CCSendP2pTask::ConnectRedisServer()
 
 int CCSendP2pTask::ExitInstance()
 {
-	// TODO: ڴִ߳
+	// TODO: 在此执行任意逐线程清理
 	return CWinThread::ExitInstance();
 }
 
@@ -379,4 +363,4 @@ BEGIN_MESSAGE_MAP(CCSendP2pTask, CWinThread)
 END_MESSAGE_MAP()
 
 
-// CCSendP2pTask Ϣ
+// CCSendP2pTask 消息处理程序
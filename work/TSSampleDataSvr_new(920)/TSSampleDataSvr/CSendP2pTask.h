@@ -10,7 +10,7 @@ class CCSendP2pTask : public CWinThread
 	DECLARE_DYNCREATE(CCSendP2pTask)
 
 public:
-	CCSendP2pTask();           // ̬ʹõܱĹ캯
+	CCSendP2pTask();           // 动态创建所使用的受保护的构造函数
 	virtual ~CCSendP2pTask();
 
 public:
@@ -18,11 +18,9 @@ public:
 	virtual int ExitInstance();
 	int GetTestBuffer(unsigned char ** buffer);
 	BOOL ConnectRedisServer();
-	CPtrList m_RecordList;
+	CMpscQueue<ProtocolCallItem*> m_RecordQueue;
 	HANDLE m_ProcessDataEvent,m_AlarmEvent,m_hExitEvent;  
-	CRITICAL_SECTION m_csRecordList;
-	CPtrList m_AlarmInfoList;
-	CRITICAL_SECTION m_csAlarmInfoList;
+	CMpscQueue<AlarmInfo*> m_AlarmInfoQueue;
 public:
 	CSoftBus *m_SoftBus;
 
@@ -0,0 +1,137 @@
+#pragma once
+
+// CFlatHashIndex
+// 开放寻址(线性探测)哈希表，键为__int64，值为int；建立后只读，查找不加锁不分配内存
+
+class CFlatHashIndex
+{
+public:
+	CFlatHashIndex()
+	{
+		m_pSlots = NULL;
+		m_nMask = 0;
+		m_nCount = 0;
+	}
+
+	~CFlatHashIndex()
+	{
+		if (m_pSlots != NULL)
+		{
+			delete [] m_pSlots;
+			m_pSlots = NULL;
+		}
+	}
+
+	void Init(int nExpected)
+	{
+		//装载因子不超过0.5，探测链保持很短
+		DWORD nSize = 16;
+		while (nSize < (DWORD)nExpected*2)
+		{
+			nSize <<= 1;
+		}
+		if (m_pSlots != NULL)
+		{
+			delete [] m_pSlots;
+		}
+		m_pSlots = new HashSlot[nSize];
+		memset(m_pSlots, 0, sizeof(HashSlot)*nSize);
+		m_nMask = nSize - 1;
+		m_nCount = 0;
+	}
+
+	//清空所有键，保留已分配的容量
+	void Clear()
+	{
+		if (m_pSlots != NULL)
+		{
+			memset(m_pSlots, 0, sizeof(HashSlot)*(m_nMask + 1));
+		}
+		m_nCount = 0;
+	}
+
+	//键已存在时更新值并返回FALSE
+	BOOL Insert(__int64 nKey, int nValue)
+	{
+		if (m_pSlots == NULL)
+		{
+			Init(16);
+		}
+		if ((DWORD)(m_nCount+1)*2 > m_nMask+1)
+		{
+			Grow();
+		}
+		DWORD nPos = HashOf(nKey);
+		while (m_pSlots[nPos].bUsed)
+		{
+			if (m_pSlots[nPos].nKey == nKey)
+			{
+				m_pSlots[nPos].nValue = nValue;
+				return FALSE;
+			}
+			nPos = (nPos + 1) & m_nMask;
+		}
+		m_pSlots[nPos].nKey = nKey;
+		m_pSlots[nPos].nValue = nValue;
+		m_pSlots[nPos].bUsed = 1;
+		m_nCount++;
+		return TRUE;
+	}
+
+	BOOL Find(__int64 nKey, int &nValue) const
+	{
+		if (m_pSlots == NULL)
+		{
+			return FALSE;
+		}
+		DWORD nPos = HashOf(nKey);
+		while (m_pSlots[nPos].bUsed)
+		{
+			if (m_pSlots[nPos].nKey == nKey)
+			{
+				nValue = m_pSlots[nPos].nValue;
+				return TRUE;
+			}
+			nPos = (nPos + 1) & m_nMask;
+		}
+		return FALSE;
+	}
+
+	int GetCount() const { return m_nCount; }
+	int GetCapacity() const { return m_pSlots != NULL ? (int)(m_nMask + 1) : 0; }
+
+private:
+	struct HashSlot
+	{
+		__int64 nKey;
+		int nValue;
+		int bUsed;
+	};
+	CFlatHashIndex(const CFlatHashIndex&);
+	CFlatHashIndex& operator=(const CFlatHashIndex&);
+
+	void Grow()
+	{
+		HashSlot *pOldSlots = m_pSlots;
+		DWORD nOldSize = m_nMask + 1;
+		m_pSlots = NULL;
+		Init((int)nOldSize);
+		for (DWORD i=0; i<nOldSize; i++)
+		{
+			if (pOldSlots[i].bUsed)
+			{
+				Insert(pOldSlots[i].nKey, pOldSlots[i].nValue);
+			}
+		}
+		delete [] pOldSlots;
+	}
+
+	DWORD HashOf(__int64 nKey) const
+	{
+		return (DWORD)(((unsigned __int64)nKey * 0x9E3779B97F4A7C15ULL) >> 32) & m_nMask;
+	}
+
+	HashSlot *m_pSlots;
+	DWORD m_nMask;
+	int m_nCount;
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+// CMpscQueue
+// 有界多生产者单消费者环形队列，用于处理线程向入库/发送线程投递数据指针，也可直接存放定长结构
+// 生产者之间通过Interlocked原子操作竞争写位置，不使用临界区；只允许一个线程出队
+
+template<class T>
+class CMpscQueue
+{
+public:
+	CMpscQueue(int nCapacity)
+	{
+		int nSize = 2;
+		while (nSize < nCapacity)
+		{
+			nSize <<= 1;
+		}
+		m_nMask = nSize - 1;
+		m_pCells = new QueueCell[nSize];
+		for (int i=0; i<nSize; i++)
+		{
+			m_pCells[i].nSeq = i;
+		}
+		m_nEnqueuePos = 0;
+		m_nDequeuePos = 0;
+		m_nHighWater = 0;
+		m_nDropped = 0;
+	}
+
+	~CMpscQueue()
+	{
+		delete [] m_pCells;
+		m_pCells = NULL;
+	}
+
+	//入队，队列满时立即返回FALSE
+	BOOL Push(const T &Data)
+	{
+		LONG nPos = 0;
+		T *pData = BeginPush(nPos);
+		if (pData == NULL)
+		{
+			return FALSE;
+		}
+		*pData = Data;
+		CommitPush(nPos);
+		return TRUE;
+	}
+
+	//原地入队：先占一个空槽直接写入，再CommitPush发布给消费者，用于较大的定长结构，省去整体拷贝。
+	//队列满时返回NULL；占到的槽必须尽快提交，提交前消费者会停在该槽
+	T *BeginPush(LONG &nPos)
+	{
+		QueueCell *pCell = NULL;
+		nPos = m_nEnqueuePos;
+		while (1)
+		{
+			pCell = &m_pCells[nPos & m_nMask];
+			LONG nDif = pCell->nSeq - nPos;
+			if (nDif == 0)
+			{
+				if (InterlockedCompareExchange(&m_nEnqueuePos, nPos + 1, nPos) == nPos)
+				{
+					break;
+				}
+				nPos = m_nEnqueuePos;
+			}
+			else if (nDif < 0)
+			{
+				return NULL;
+			}
+			else
+			{
+				nPos = m_nEnqueuePos;
+			}
+		}
+		return &pCell->Data;
+	}
+
+	void CommitPush(LONG nPos)
+	{
+		InterlockedExchange(&m_pCells[nPos & m_nMask].nSeq, nPos + 1);
+
+		LONG nSize = nPos + 1 - m_nDequeuePos;
+		LONG nHighWater = m_nHighWater;
+		while (nSize > nHighWater)
+		{
+			if (InterlockedCompareExchange(&m_nHighWater, nSize, nHighWater) == nHighWater)
+			{
+				break;
+			}
+			nHighWater = m_nHighWater;
+		}
+	}
+
+	//入队，队列满时最多等待dwTimeout毫秒让消费者腾出空间，超时则计入丢弃数
+	BOOL PushWait(const T &Data, DWORD dwTimeout)
+	{
+		DWORD dwBegin = GetTickCount();
+		while (!Push(Data))
+		{
+			if (GetTickCount() - dwBegin >= dwTimeout)
+			{
+				InterlockedIncrement(&m_nDropped);
+				return FALSE;
+			}
+			Sleep(1);
+		}
+		return TRUE;
+	}
+
+	//出队，只能由消费者线程调用
+	BOOL Pop(T &Data)
+	{
+		T *pData = Front();
+		if (pData == NULL)
+		{
+			return FALSE;
+		}
+		Data = *pData;
+		PopFront();
+		return TRUE;
+	}
+
+	//原地出队：Front返回队首数据的指针(队列空时为NULL)，用完后PopFront归还槽位。只能由消费者线程调用
+	T *Front()
+	{
+		QueueCell *pCell = &m_pCells[m_nDequeuePos & m_nMask];
+		if (pCell->nSeq - (m_nDequeuePos + 1) != 0)
+		{
+			return NULL;
+		}
+		return &pCell->Data;
+	}
+
+	//先推进读位置再归还槽位，生产者占到该槽时算出的队列长度不会超过容量
+	void PopFront()
+	{
+		LONG nPos = m_nDequeuePos;
+		InterlockedIncrement(&m_nDequeuePos);
+		InterlockedExchange(&m_pCells[nPos & m_nMask].nSeq, nPos + m_nMask + 1);
+	}
+
+	//批量出队，返回取出的个数
+	int PopBatch(T *pData, int nMax)
+	{
+		int nCount = 0;
+		while (nCount < nMax && Pop(pData[nCount]))
+		{
+			nCount++;
+		}
+		return nCount;
+	}
+
+	int GetSize()
+	{
+		LONG nSize = m_nEnqueuePos - m_nDequeuePos;
+		return nSize > 0 ? nSize : 0;
+	}
+
+	int GetCapacity()
+	{
+		return m_nMask + 1;
+	}
+
+	int GetHighWater()
+	{
+		return m_nHighWater;
+	}
+
+	int GetDropped()
+	{
+		return m_nDropped;
+	}
+
+private:
+	struct QueueCell
+	{
+		volatile LONG nSeq;
+		T Data;
+	};
+	CMpscQueue(const CMpscQueue&);
+	CMpscQueue& operator=(const CMpscQueue&);
+
+	QueueCell *m_pCells;
+	LONG m_nMask;
+	//写位置和读位置分别由生产者和消费者修改，放在不同缓存行避免伪共享
+	char m_cPad0[64];
+	volatile LONG m_nEnqueuePos;
+	char m_cPad1[64];
+	volatile LONG m_nDequeuePos;
+	char m_cPad2[64];
+	volatile LONG m_nHighWater;
+	volatile LONG m_nDropped;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <map>
+
+#define PAYRECON_CALL_MAX			10		//单台设备最多招的充值记录条数
+
+//一台设备的对账数据
+struct PayReconItem
+{
+	int iDevId;
+	int iStationId;
+	int iDevNo;			//前置设备号
+	int nDeviceNo;		//设备表第一列 Id
+	int MaxBuyNum;		//电表上的购电次数
+	int CallNum;		//需要招的充值记录条数，0表示不需要
+};
+
+// CPayReconRule
+// 充值记录对账的批量查询和判断：一批设备一条语句，取回各设备1..购电次数之间的充值记录数，以及最近
+// PAYRECON_CALL_MAX次购电(购电次数-i)是否有记录的位图(第i位)，在内存中算出要招的条数。
+// 拼语句和解析应答放在一起，保证两边字段一致。
+//
+// 用法：
+//	CPayReconRule::BuildQuery(strQuery, &m_vecRecon[nBegin], nEnd-nBegin);
+//	rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), 3);
+//	CPayReconRule::Evaluate(rs, &m_vecRecon[nBegin], nEnd-nBegin);
+
+class CPayReconRule
+{
+public:
+	static void BuildQuery(CString &strQuery, const PayReconItem *pItems, int nItems)
+	{
+		strQuery = _T("SELECT v.D,COUNT(p.[COUNT]),ISNULL(SUM(DISTINCT CASE WHEN p.[COUNT]>v.M-10 THEN POWER(2,v.M-p.[COUNT]) ELSE 0 END),0) FROM (VALUES ");
+		strQuery.Preallocate(nItems*24 + 512);
+		TCHAR Text[64];
+		for (int i=0;i<nItems;i++)
+		{
+			int nLen = _stprintf(Text,i==0?_T("(%d,%d)"):_T(",(%d,%d)"),pItems[i].iDevId,pItems[i].MaxBuyNum);
+			strQuery.Append(Text,nLen);
+		}
+		strQuery.Append(_T(") AS v(D,M) LEFT JOIN TE_PAYMENT_PAYRECORD p ON p.DEVICEID=v.D AND p.[COUNT]>0 AND p.[COUNT]<=v.M GROUP BY v.D;"));
+	}
+
+	//与原逐台对账的规则一致：记录齐全或缺得太多(超过10条)不招；一条都没有时招最近10条；
+	//否则招到最早缺失的那一次为止(只看最近10次)
+	static int CalcCallNum(int MaxBuyNum,int nRecordNum,DWORD dwRecentMask)
+	{
+		if (nRecordNum>=MaxBuyNum)
+		{
+			return 0;
+		}
+		if (nRecordNum==0)
+		{
+			return (MaxBuyNum<PAYRECON_CALL_MAX)?MaxBuyNum:PAYRECON_CALL_MAX;
+		}
+		if ((MaxBuyNum - nRecordNum)>PAYRECON_CALL_MAX)
+		{
+			return 0;
+		}
+		int CallNum = 0;
+		for (int i=0;i<MaxBuyNum&&i<PAYRECON_CALL_MAX;i++)
+		{
+			if ((dwRecentMask & (1<<i))==0)
+			{
+				CallNum = i + 1;
+			}
+		}
+		return CallNum;
+	}
+
+	//rs已Attach到BuildQuery语句的应答(3个字段)，按设备ID填写pItems的CallNum，返回应答中匹配的设备数。
+	//应答中没有的设备CallNum不变
+	static int Evaluate(CRecordSetReader &rs, PayReconItem *pItems, int nItems)
+	{
+		//同一批内按设备ID找回下标
+		std::map<int,int> DevIndex;
+		for (int i=0;i<nItems;i++)
+		{
+			DevIndex[pItems[i].iDevId] = i;
+		}
+		int nMatched = 0;
+		while (rs.NextRecord())
+		{
+			std::map<int,int>::iterator it = DevIndex.find(rs.GetInt(0));
+			if (it == DevIndex.end())
+			{
+				continue;
+			}
+			PayReconItem &iItem = pItems[it->second];
+			iItem.CallNum = CalcCallNum(iItem.MaxBuyNum,rs.GetInt(1),(DWORD)rs.GetInt(2));
+			nMatched++;
+		}
+		return nMatched;
+	}
+};
@@ -1,4 +1,4 @@
-// ProcessThread.cpp : ʵļ
+// ProcessThread.cpp : 实现文件
 //
 #pragma once
 #include "stdafx.h"
@@ -7,18 +7,29 @@
 #include "TSSampleDataSvrDlg.h"
 
 // CProcessThread
-extern CLog *g_log;
-extern CLog *DataTime_log;
+extern CAsyncLog *g_log;
+extern CAsyncLog *DataTime_log;
 IMPLEMENT_DYNCREATE(CProcessThread, CWinThread)
 
 CProcessThread::CProcessThread()
+: m_FrameQueue(PROCESS_QUEUE_SIZE)
 {
 	m_Index = 0;
+	m_nBatchPop = 0;
+	m_nBlockTime = 1;
+	m_nRtdbFrameRecords = RTDB_FRAME_MAXRECORDS;
+	m_nRtdbWindow = RTDB_WINDOW_DEFAULT;
+	m_bPartition = FALSE;
+	m_DevStateShard.InitHashTable(DEVSTATE_SHARD_HASH_SIZE);
 	m_ProcessDataEvent = NULL;
 	m_hExitEvent = NULL;
 	m_hExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 	m_ProcessDataEvent = CreateEvent(NULL,TRUE, FALSE, NULL);
 	InitializeCriticalSection(&m_csRedisDataList);
+	memset(m_Handlers,0,sizeof(m_Handlers));
+	RegisterHandler(SOCKET_MSG_GROUP_YXDATA,&CProcessThread::OnSocketMsgGroupYx);
+	RegisterHandler(SOCKET_MSG_GROUP_YMDATA_EX_DATE,&CProcessThread::StartProcessData);
+	RegisterHandler(SOCKET_MSG_PREPAYRECORD,&CProcessThread::OnCallPrePayRecord);
 	m_softbus = NULL;
 	m_softbus = new CRedisBus;
 	if (NULL == m_softbus)
@@ -27,11 +38,11 @@ CProcessThread::CProcessThread()
 	}
 	if(NULL==g_log)
 	{
-		g_log = new CLog(_T("\\TSSampleDataSvr"));
+		g_log = new CAsyncLog(_T("\\TSSampleDataSvr"));
 	}
 	if (NULL==DataTime_log)
 	{
-		DataTime_log = new CLog(_T("\\SampleDataCheck"));
+		DataTime_log = new CAsyncLog(_T("\\SampleDataCheck"));
 	}
 }
 
@@ -44,6 +55,51 @@ CProcessThread::~CProcessThread()
 	}
 }
 
+void CProcessThread::RegisterHandler(BYTE btType, SocketMsgHandler pHandler)
+{
+	m_Handlers[btType] = pHandler;
+}
+
+//分区模式下同一厂站的点只由一个线程处理，状态放在本线程的分片里，不加锁；
+//分片中没有的点从加载时建好的总表里取初值，此后总表不再被修改
+BOOL CProcessThread::LookupDevState(int nYxIndex, BYTE &State)
+{
+	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
+	if (!m_bPartition)
+	{
+		return pDlg->m_pCRedisRecvSample->m_DevStateMap.Lookup(nYxIndex,State);
+	}
+	if (m_DevStateShard.Lookup(nYxIndex,State))
+	{
+		return TRUE;
+	}
+	if (!pDlg->m_pCRedisRecvSample->m_DevStateMap.Lookup(nYxIndex,State))
+	{
+		return FALSE;
+	}
+	m_DevStateShard.SetAt(nYxIndex,State);
+	return TRUE;
+}
+
+void CProcessThread::SetDevState(int nYxIndex, BYTE State)
+{
+	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
+	if (m_bPartition)
+	{
+		m_DevStateShard.SetAt(nYxIndex,State);
+		return;
+	}
+	EnterCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDevStateMap);
+	pDlg->m_pCRedisRecvSample->m_DevStateMap.SetAt(nYxIndex,State);
+	LeaveCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDevStateMap);
+}
+
+//尚未处理完的报文数，退出时等待其为0
+int CProcessThread::GetPendingCount()
+{
+	return m_RedisDataList.GetSize() + m_FrameQueue.GetSize();
+}
+
 BOOL CProcessThread::ConnectRedisServer()
 {
 	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
@@ -56,6 +112,20 @@ BOOL CProcessThread::ConnectRedisServer()
 	}
 	while(1)
 	{
+		if (m_nBatchPop>0)
+		{
+			if (m_BatchConsumer.Connect(szIP, pDlg->m_pCRedisRecvSample->RedisPort))
+			{
+				break;
+			}
+			nCount++;
+			Sleep(3000);
+			if (nCount>=5)
+			{
+				return FALSE;
+			}
+			continue;
+		}
 		if (m_softbus->RegisterSoftBus(szIP, pDlg->m_pCRedisRecvSample->RedisPort) == REDIS_OK)
 		{
 			break;
@@ -76,8 +146,32 @@ BOOL CProcessThread::ConnectRedisServer()
 	return TRUE;
 }
 
+//批量模式：一次往返取多条，Redis为空时阻塞等待；报文在回复中原地处理，不再逐条分配和拷贝
+BOOL CProcessThread::GetBatchFromRedis()
+{
+	int nCount = m_BatchConsumer.PopBatch("SampleMessage",m_nBatchPop,m_nBlockTime);
+	if (nCount<0)
+	{
+		ReguTrace(Config,"线程%d:ReconnectRedisServer!",m_Index);
+		ConnectRedisServer();
+		return FALSE;
+	}
+	for (int i=0;i<nCount;i++)
+	{
+		int nLen = 0;
+		const BYTE *pMsg = m_BatchConsumer.GetMessage(i,nLen);
+		ProcessFrame((BYTE*)pMsg,nLen);
+	}
+	m_BatchConsumer.ReleaseBatch();
+	return nCount>0;
+}
+
 BOOL CProcessThread::GetDataFromRedis()
 {
+	if (m_nBatchPop>0)
+	{
+		return GetBatchFromRedis();
+	}
 	/*unsigned char buffer[1024];
 	memset(buffer,0,1024);*/
 	unsigned char * buffer = NULL;
@@ -86,7 +180,7 @@ BOOL CProcessThread::GetDataFromRedis()
 	//ret = m_softbus->RecvMessageFromMsmq("SampleMessage",buffer,&length);
 	if(REDIS_ERR == ret)
 	{
-		ReguTrace(Config,"߳%d:ReconnectRedisServer!",m_Index);
+		ReguTrace(Config,"线程%d:ReconnectRedisServer!",m_Index);
 		m_softbus->UnRegisterSoftBus();
 		ConnectRedisServer();
 		if (buffer!=NULL)
@@ -101,40 +195,13 @@ BOOL CProcessThread::GetDataFromRedis()
 		CString recvstr = _T("");
 		if (NULL == buffer)
 		{
-			ReguTrace(Config,"߳%d:buffer==NULL!",m_Index);
+			ReguTrace(Config,"线程%d:buffer==NULL!",m_Index);
 			return FALSE;
 		}
-		BYTE * pBuf = (BYTE*)buffer;
-
-		SocketMsgHead* pHead = (SocketMsgHead*)(pBuf+ sizeof(NetMessageHead));
-		int nn = pHead->btType;
-		int len = pHead->wdLen;
-		int mm = pHead->dwSyncCode;
-		int vv = sizeof(NetMessageHead)+sizeof(SocketMsgHead);
-		BYTE* pMsg = pBuf + sizeof(NetMessageHead)+sizeof(SocketMsgHead);
-		switch(pHead->btType)
-		{
-		case SOCKET_MSG_GROUP_YXDATA:
-			ReguTrace(Config,"߳%dյYX:%s",m_Index,bufToHexString(pMsg,len).c_str());
-			OnSocketMsgGroupYx((SocketMsgGroupYxEx*)pMsg);
-			break;
-		case SOCKET_MSG_GROUP_YMDATA_EX_DATE:
-			ReguTrace(Config,"߳%dյYM:%s",m_Index,bufToHexString(pMsg,len).c_str());
-			StartProcessData((SocketMsgGroupYmDataEx_DATE*)pMsg);
-			break;
-		case SOCKET_MSG_PREPAYRECORD:
-			ReguTrace(Config,"߳%dյPAYRECORD:%s",m_Index,bufToHexString(pMsg,len).c_str());
-			OnCallPrePayRecord((SocketMsgPrepayRecord*)pMsg);
-			break;
-		default:
-			break;
-		}
-		
-		
+		ProcessFrame((BYTE*)buffer,SOCKETFRAME_LEN_UNKNOWN);
 	}
 	else if (REDIS_NODATA == ret)
 	{
-		OutputDebugString(_T("REDIS_NODATA \n"));
 		if (buffer!=NULL)
 		{
 			delete [] buffer;
@@ -151,16 +218,72 @@ BOOL CProcessThread::GetDataFromRedis()
 	return TRUE;
 }
 
+//先校验长度再分派，处理函数直接按单元视图访问接收缓冲区；pBuf由调用者释放，nLen为收到的字节数
+void CProcessThread::ProcessFrame(BYTE *pBuf, int nLen)
+{
+	SocketFrameView Frame;
+	int nParse = CSocketFrameParser::Parse(pBuf,nLen,Frame);
+	if (nParse==SOCKETFRAME_OK)
+	{
+		ReguTrace(Debug,"线程%d收到%s报文:长度%d,单元%d个",m_Index,CSocketFrameParser::GetTypeName(Frame.btType),Frame.nMsgLen,Frame.Units.nCount);
+		SocketMsgHandler pHandler = m_Handlers[Frame.btType];
+		if (pHandler!=NULL)
+		{
+			(this->*pHandler)(Frame);
+		}
+	}
+	else if (nParse!=SOCKETFRAME_UNKNOWN)
+	{
+		//只有异常报文才输出十六进制内容，长度不超过收到或已校验的字节数
+		int nDumpLen = CSocketFrameParser::GetDumpLen(Frame,nLen);
+		ReguTrace(ERRO,"线程%d报文格式错误(%d):类型%d,正文长度%d:%s",m_Index,nParse,Frame.btType,Frame.nMsgLen,bufToHexString(pBuf,nDumpLen).c_str());
+	}
+}
+
+//分区模式：处理CSampleDispatcher投递到本线程的报文，返回处理的条数
+int CProcessThread::ProcessQueuedFrames()
+{
+	int nCount = 0;
+	BYTE *pBuf = NULL;
+	while (m_FrameQueue.Pop(pBuf))
+	{
+		//分派线程投递前已按收到的字节数校验过
+		ProcessFrame(pBuf,SOCKETFRAME_LEN_UNKNOWN);
+		delete [] pBuf;
+		pBuf = NULL;
+		nCount++;
+	}
+	return nCount;
+}
+
 BOOL CProcessThread::InitInstance()
 {
-	// TODO: ڴִ̳߳ʼ
+	// TODO: 在此执行任意逐线程初始化
 	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
+	m_RtdbWindow.Start(m_nRtdbWindow);
+	if (m_bPartition)
+	{
+		//报文由分派线程投递，退出时把已投递的处理完
+		while (!theApp.bExitFlag || m_FrameQueue.GetSize()>0)
+		{
+			if (ProcessQueuedFrames()>0)
+			{
+				continue;
+			}
+			if (WaitForSingleObject(m_ProcessDataEvent,REDIS_IDLE_SLEEP_MAX)==WAIT_OBJECT_0)
+			{
+				ResetEvent(m_ProcessDataEvent);
+			}
+		}
+		return FALSE;
+	}
 	if(!ConnectRedisServer())
 	{
-		ReguTrace(Config,"߳%d:ConnectRedisServer err!",m_Index);
+		ReguTrace(Config,"线程%d:ConnectRedisServer err!",m_Index);
 		//return FALSE;
 	}
-	ReguTrace(Config,"߳%d:ConnectRedisServer ɹ!",m_Index);
+	ReguTrace(Config,"线程%d:ConnectRedisServer 成功!",m_Index);
+	int nIdleSleep = REDIS_IDLE_SLEEP_MIN;
 	while(!theApp.bExitFlag)
 	{
 		if (!pDlg->m_pCRedisRecvSample->beInited)
@@ -170,9 +293,23 @@ BOOL CProcessThread::InitInstance()
 		}
 		BOOL bRet = FALSE;
 		bRet = GetDataFromRedis();
-		if (!bRet)
+		if (bRet)
 		{
-			Sleep(1000);
+			//有数据时连续取，不休眠
+			nIdleSleep = REDIS_IDLE_SLEEP_MIN;
+			continue;
+		}
+		if (m_nBatchPop>0&&m_BatchConsumer.IsConnected())
+		{
+			//批量模式下空队列已在BLPOP中等待过，不再休眠
+			continue;
+		}
+		//无数据时从短间隔开始逐步加大轮询间隔，数据恢复后最多延迟REDIS_IDLE_SLEEP_MIN即可取到
+		Sleep(nIdleSleep);
+		nIdleSleep *= 2;
+		if (nIdleSleep>REDIS_IDLE_SLEEP_MAX)
+		{
+			nIdleSleep = REDIS_IDLE_SLEEP_MAX;
 		}
 	}
 
@@ -206,8 +343,8 @@ BOOL CProcessThread::InitInstance()
 	//			BYTE* pBuf = (BYTE*)m_RedisDataList.GetNext(pos);	
 	//			m_listReceMsg.RemoveAt(pos1);
 	//			LeaveCriticalSection(&m_csRedisDataList); 
-	//			//ʱGetNextposΪգڴm_RedisDataListպݲ
-	//			//ѭֹµݽյ
+	//			//这时GetNext后若pos为空，在处理过程中m_RedisDataList刚好有数据插入后，
+	//			//循环终止，新的数据将不会接收到
 	//			...
 	//		}*/
 	//		while(1)
@@ -224,7 +361,7 @@ BOOL CProcessThread::InitInstance()
 	//			m_RedisDataList.RemoveAt(pos1);
 	//			int nNum = m_RedisDataList.GetSize();
 	//			LeaveCriticalSection(&m_csRedisDataList);
-	//			//ReguTrace(Config,"յ88:%s",bufToHexString(pBuf,100).c_str());
+	//			//ReguTrace(Config,"收到88报文:%s",bufToHexString(pBuf,100).c_str());
 	//			SocketMsgHead* pHead = (SocketMsgHead*)(pBuf+ sizeof(NetMessageHead));
 	//			int nn = pHead->btType;
 	//			int len = pHead->wdLen;
@@ -234,15 +371,15 @@ BOOL CProcessThread::InitInstance()
 	//			switch(pHead->btType)
 	//			{
 	//			case SOCKET_MSG_GROUP_YXDATA:
-	//				ReguTrace(Config,"߳%dյYX(ʣ%d):%s",m_Index,nNum,bufToHexString(pMsg,len).c_str());
+	//				ReguTrace(Config,"线程%d收到YX报文(剩余%d条待处理):%s",m_Index,nNum,bufToHexString(pMsg,len).c_str());
 	//				OnSocketMsgGroupYx((SocketMsgGroupYxEx*)pMsg);
 	//				break;
 	//			case SOCKET_MSG_GROUP_YMDATA_EX_DATE:
-	//				ReguTrace(Config,"߳%dյYM(ʣ%d):%s",m_Index,nNum,bufToHexString(pMsg,len).c_str());
+	//				ReguTrace(Config,"线程%d收到YM报文(剩余%d条待处理):%s",m_Index,nNum,bufToHexString(pMsg,len).c_str());
 	//				StartProcessData((SocketMsgGroupYmDataEx_DATE*)pMsg);
 	//				break;
 	//			case SOCKET_MSG_PREPAYRECORD:
-	//				ReguTrace(Config,"߳%dյPAYRECORD(ʣ%d):%s",m_Index,nNum,bufToHexString(pMsg,len).c_str());
+	//				ReguTrace(Config,"线程%d收到PAYRECORD报文(剩余%d条待处理):%s",m_Index,nNum,bufToHexString(pMsg,len).c_str());
 	//				OnCallPrePayRecord((SocketMsgPrepayRecord*)pMsg);
 	//				break;
 	//			default:
@@ -267,21 +404,22 @@ BOOL CProcessThread::InitInstance()
 
 int CProcessThread::ExitInstance()
 {
-	// TODO: ڴִ߳
+	// TODO: 在此执行任意逐线程清理
+	m_RtdbWindow.Stop();
 	return CWinThread::ExitInstance();
 }
 
 BOOL CProcessThread::QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee, CTime ChargeTime, CString &SerialId)
 {
-	int iFdCount = 1;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 1;	//	查询的字段数
+	int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 	CTime MinTime,MaxTime;
 	MinTime = ChargeTime - CTimeSpan(0,1,0,0);
 	MaxTime = ChargeTime + CTimeSpan(0,1,0,0);
 	CString csMinTime = _T(""),csMaxTime = _T("");
 	csMinTime.Format(_T("%d-%d-%d %d:%d:%d"),MinTime.GetYear(),MinTime.GetMonth(),MinTime.GetDay(),MinTime.GetHour(),MinTime.GetMinute(),MinTime.GetSecond());
 	csMaxTime.Format(_T("%d-%d-%d %d:%d:%d"),MaxTime.GetYear(),MaxTime.GetMonth(),MaxTime.GetDay(),MaxTime.GetHour(),MaxTime.GetMinute(),MaxTime.GetSecond());
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	/*HANDLE hPipe =OpenRealDataPipe();
@@ -298,16 +436,16 @@ BOOL CProcessThread::QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee, C
 					   and ChargeCnt=%d and abs([Param]-%02f)<0.1 and UPDATETIME>='%s' and UPDATETIME<='%s';"),iDevId,ChargeCnt,fFee,csMinTime,csMaxTime);
 	pRead = (BYTE*)GetMessage_RecordOfSql(strQuery);
 
-	if (NULL == pRead)	// δѯ¼
+	if (NULL == pRead)	// 未查询到记录
 	{
 		//CloseHandle(hPipe);
 		MYERROR(_T("QueryExamineRecorde pRead null"));
 		return FALSE;
 	}
-	// صĽ
+	// 解析返回的结果
 	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-		//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+		//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 		delete[] pRead;
 		pRead = NULL;
 		//CloseHandle(hPipe);
@@ -315,9 +453,9 @@ BOOL CProcessThread::QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee, C
 		return FALSE;
 	}	
 
-	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+	if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 	{
-		//MYWARN(_T("յջظģ޷ѯ"));
+		//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 		delete[] pRead;
 		pRead = NULL;
 		//CloseHandle(hPipe);
@@ -325,12 +463,12 @@ BOOL CProcessThread::QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee, C
 		return FALSE;
 	}
 
-	// ȡѯֶ
+	// 获取查询的字段数
 	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 	int nFieldNum = (int)*pWord;
-	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	if (nFieldNum != iFdCount)	// 查询字段数量，不相等，曾查询结果异常退出
 	{
-		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+		//	MYWARN(_T("查询字段数量，不相等，曾查询结果异常退出"));
 		delete[] pRead;
 		pRead = NULL;
 		//CloseHandle(hPipe);
@@ -339,7 +477,7 @@ BOOL CProcessThread::QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee, C
 	}
 	pWord++;
 
-	// ¼
+	// 记录集长度
 	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 	DWORD dwRecordLen = *((DWORD*)pByte);
@@ -352,7 +490,7 @@ BOOL CProcessThread::QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee, C
 	}
 	pByte += sizeof(DWORD);
 
-	// ¼
+	// 记录数
 	DWORD dwRecordNum = *((int*)pByte);
 	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 	{
@@ -366,7 +504,7 @@ BOOL CProcessThread::QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee, C
 	TCHAR *tValue = new TCHAR[1024+1];
 	if (tValue == NULL)
 	{
-		//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
+		//MYERROR(_T("分配内存错误，错误码：%d"),GetLastError());
 		MYERROR(_T("QueryExamineRecorde tValue == NULL"));
 		delete[] pRead;
 		pRead = NULL;
@@ -374,7 +512,7 @@ BOOL CProcessThread::QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee, C
 		return FALSE;
 	}
 
-	// ѯд뵽
+	// 将查询结果写入到缓存
 	if (dwRecordNum!=1)
 	{
 		delete[] pRead;
@@ -401,8 +539,9 @@ BOOL CProcessThread::QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee, C
 
 	return TRUE;
 }
-void CProcessThread::OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordData)
+void CProcessThread::OnCallPrePayRecord(const SocketFrameView &Frame)
 {
+	const SocketMsgPrepayRecord* pMsgPrepayRecordData = (const SocketMsgPrepayRecord*)Frame.pMsg;
 	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
 	HANDLE hPipe = NULL;
 	BYTE* pRead = NULL;
@@ -413,19 +552,18 @@ void CProcessThread::OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordD
 	{
 		nRtuNo = pMsgPrepayRecordData->btForeNo * 256 + pMsgPrepayRecordData->btRtuNo;
 	}*/
-	int nDevNo = pMsgPrepayRecordData->nDevNo;  //ǰ豸
+	int nDevNo = pMsgPrepayRecordData->nDevNo;  //前置设备号
 	int nDevId = 0;
 	pDlg->m_pCRedisRecvSample->GetDevId(nRtuNo,pMsgPrepayRecordData->nDevNo,nDevId);
 	if(nDevId==0)
 	{
 		return;
 	}
-	SocketPrepayRecordUnit *pRecordUnit = NULL;
-	pRecordUnit = pMsgPrepayRecordData->prUnit;
 	int icount = 0;
 	CString UpdateSql = _T(""); 
-	for (WORD i=0; i<pMsgPrepayRecordData->wdYjNum; i++,pRecordUnit++)
+	for (int i=0; i<Frame.Units.nCount; i++)
 	{
+		const SocketPrepayRecordUnit *pRecordUnit = Frame.Units.At<SocketPrepayRecordUnit>(i);
 		if (NULL==hPipe)
 		{
 			hPipe = OpenRealDataPipe();
@@ -446,13 +584,13 @@ void CProcessThread::OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordD
 		{
 			timestr.Format(_T("20%02d-%02d-%02d %02d:%02d:00"),iyear,imonth,iday,ihour,iminite);
 		}
-		int nTotalBuyCount = 0; //һγֵܹ
+		int nTotalBuyCount = 0; //上一次充值后的总购电次数
 		nTotalBuyCount = pRecordUnit->nTotalPercNum;
-		float nBuyFee = 0;  //γֵ
+		float nBuyFee = 0;  //本次充值金额
 		nBuyFee = pRecordUnit->nPercFee*0.01;
-		float nBefReminAmount = 0; //γֵǰʣ
-		float nAftReminAmount = 0; //γֵʣ
-		float nTotalFee = 0;   //ܹ
+		float nBefReminAmount = 0; //本次充值前剩余金额
+		float nAftReminAmount = 0; //本次充值后剩余金额
+		float nTotalFee = 0;   //总购电金额
 
 		int nBeforeFee = (int)pRecordUnit->nBefPercFee; //GUOJ ADD 151022 
 		int nAfterFee = (int)pRecordUnit->nAftPercFee;  //GUOJ ADD 151022 
@@ -463,7 +601,7 @@ void CProcessThread::OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordD
 		if (abs((nAftReminAmount - nBefReminAmount) - nBuyFee) > 1)
 		{
 			nBefReminAmount = nAftReminAmount - nBuyFee;
-			ReguTrace(PrepayRecord,"߳%d:ֵǰΪõ!ֵǰ=%f,ֵ=%f,ֵ=%f",m_Index,nBeforeFee*0.01,nAftReminAmount,nBuyFee);
+			ReguTrace(PrepayRecord,"线程%d:充值前金额为计算得到!充值前=%f,充值后=%f,充值金额=%f",m_Index,nBeforeFee*0.01,nAftReminAmount,nBuyFee);
 		}
 
 		CString BillSerial = _T("");
@@ -471,15 +609,15 @@ void CProcessThread::OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordD
 		int iPlazaId = 0;
 		DeviceInfo iDeviceInfo;
 		memset(&iDeviceInfo,0,sizeof(DeviceInfo));
-		if(!pDlg->m_pCRedisRecvSample->m_DeviceInfoMap.Lookup(nDevId,iDeviceInfo))
+		if(!pDlg->m_pCRedisRecvSample->GetDeviceInfo(nDevId,iDeviceInfo))
 		{
-			ReguTrace(PrepayRecord,"߳%d:δҵ豸Ĺ㳡ϢDevId=%d",m_Index,nDevId);
+			ReguTrace(PrepayRecord,"线程%d:未找到该设备的广场信息DevId=%d",m_Index,nDevId);
 		}
 		CTime TempTime = CTime::GetCurrentTime();
 		CString OperaterTime = _T("");
 		OperaterTime.Format(_T("%04d-%02d-%02d %02d:%02d:%02d"),TempTime.GetYear(),TempTime.GetMonth(),
 			TempTime.GetDay(),TempTime.GetHour(),TempTime.GetMinute(),TempTime.GetSecond());
-		//******************GUOJ ADD 151114 ƥ*********************
+		//******************GUOJ ADD 151114 匹配代办*********************
 		CTime ChargeTime = CTime(iyear+2000,imonth,iday,ihour,iminite,0);
 		if (QueryExamineRecorde(nDevId,nTotalBuyCount,nBuyFee,ChargeTime,BillSerial))
 		{
@@ -501,7 +639,7 @@ void CProcessThread::OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordD
 			UpdateSql += TempSql;
 			UpdateSql += Sql_Examine;
 			icount++;
-			continue;                 //ƥ˴
+			continue;                 //匹配了代办无需往下走
 		}
 		
 		//******************GUOJ ADD 151114 end**************************
@@ -525,12 +663,12 @@ void CProcessThread::OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordD
 			nDevId,nBuyFee,2,BillSerial,2,nBefReminAmount,nAftReminAmount,timestr,nTotalBuyCount,iDeviceInfo.iBrandId,iDeviceInfo.iPlazaId,iDeviceInfo.NickName);
 		UpdateSql += TempSql;
 		icount++;
-		if (icount%SQL_COUNT_ONCE!=0 && i!=pMsgPrepayRecordData->wdYjNum - 1)
+		if (icount%SQL_COUNT_ONCE!=0 && i!=Frame.Units.nCount - 1)
 		{
 			continue;
 		}
 		CString strSqlFinal = UpdateSql;
-		ReguTrace(PrepayRecord,"߳%d:ֵ¼:%s",m_Index,strSqlFinal);
+		ReguTrace(PrepayRecord,"线程%d:充值记录入库:%s",m_Index,strSqlFinal);
 		pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
 		if (pRead)
 		{
@@ -543,7 +681,7 @@ void CProcessThread::OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordD
 	}
 	if (!UpdateSql.IsEmpty())
 	{
-		ReguTrace(PrepayRecord,"߳%d:ֵ¼::%s",m_Index,UpdateSql);
+		ReguTrace(PrepayRecord,"线程%d:充值记录入库::%s",m_Index,UpdateSql);
 		pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, UpdateSql);
 		if (pRead)
 		{
@@ -559,8 +697,9 @@ void CProcessThread::OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordD
 	}
 }
 
-void CProcessThread::OnSocketMsgGroupYx(SocketMsgGroupYxEx* pMsgGroupYxData)
+void CProcessThread::OnSocketMsgGroupYx(const SocketFrameView &Frame)
 {
+	const SocketMsgGroupYxEx* pMsgGroupYxData = (const SocketMsgGroupYxEx*)Frame.pMsg;
 	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
 	HANDLE hPipe = NULL;
 	BYTE* pRead = NULL;
@@ -571,18 +710,27 @@ void CProcessThread::OnSocketMsgGroupYx(SocketMsgGroupYxEx* pMsgGroupYxData)
 	{
 		nRtuNo = pMsgGroupYxData->btForeNo * 256 + pMsgGroupYxData->btRtuNo;
 	}*/
-	SocketGroupYxUnit *YxUnit = NULL;
-	YxUnit = pMsgGroupYxData->YxUnit;
+	int nUnitNum = Frame.Units.nCount;
+	m_vecUnitDevNo.resize(nUnitNum);
+	m_vecUnitDevId.resize(nUnitNum);
+	for (int i=0; i<nUnitNum; i++)
+	{
+		m_vecUnitDevNo[i] = Frame.Units.At<SocketGroupYxUnit>(i)->DevId;
+	}
+	if (nUnitNum>0)
+	{
+		pDlg->m_pCRedisRecvSample->GetDevIds(nRtuNo,&m_vecUnitDevNo[0],nUnitNum,&m_vecUnitDevId[0]);
+	}
 	int icount = 0;
 	m_YxValueInfoCArray.RemoveAll();
 	m_YmValueInfoCArray.RemoveAll();
 	CString OutputStr = _T("");
-	OutputStr.Format(_T("ң:վ%d,"),nRtuNo);
+	OutputStr.Format(_T("解析遥信:厂站号%d,"),nRtuNo);
 	CTime CurTime = CTime::GetCurrentTime();
-    for (WORD i=0; i<pMsgGroupYxData->wdYxNum; i++,YxUnit++)
+    for (int i=0; i<nUnitNum; i++)
     {
-		int DevId = 0;
-		pDlg->m_pCRedisRecvSample->GetDevId(nRtuNo,YxUnit->DevId,DevId);
+		const SocketGroupYxUnit *YxUnit = Frame.Units.At<SocketGroupYxUnit>(i);
+		int DevId = m_vecUnitDevId[i];
 		if (DevId==0)
 		{
 			continue;
@@ -611,7 +759,7 @@ void CProcessThread::OnSocketMsgGroupYx(SocketMsgGroupYxEx* pMsgGroupYxData)
 
 		//GUOJ ADD 151030
 		BYTE lastState = 0;
-		if (pDlg->m_pCRedisRecvSample->m_DevStateMap.Lookup(iYxConfig.nYxIndex,lastState)) //GUOJ MOD 151218
+		if (LookupDevState(iYxConfig.nYxIndex,lastState)) //GUOJ MOD 151218
 		{
 			if (iYxConfig.bYxValue!=lastState)
 			{
@@ -621,46 +769,45 @@ void CProcessThread::OnSocketMsgGroupYx(SocketMsgGroupYxEx* pMsgGroupYxData)
 					if(NULL==pAlarmInfo)
 					{
 						m_YxValueInfoCArray.Add(iYxConfig);
-						EnterCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDevStateMap);
-						pDlg->m_pCRedisRecvSample->m_DevStateMap.SetAt(iYxConfig.nYxIndex,iYxConfig.bYxValue); //GUOJ MOD 151218
-						LeaveCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDevStateMap);
+						SetDevState(iYxConfig.nYxIndex,iYxConfig.bYxValue); //GUOJ MOD 151218
 						continue;
 					}
 					memset(pAlarmInfo,0,sizeof(AlarmInfo));
-					pAlarmInfo->AlarmType = 9003;	//9003ΪͨѶж
+					pAlarmInfo->AlarmType = 9003;	//9003为电表通讯中断
 					pAlarmInfo->ObjectId = DevId;
 					pAlarmInfo->ObjectType = 31;
 					pAlarmInfo->reserve = nRtuNo;
 					pAlarmInfo->AlarmTime = CurTime;
-					if (iYxConfig.bYxValue==0)	//ͨѶж 澯
+					if (iYxConfig.bYxValue==0)	//通讯中断 产生告警
 					{
 						pAlarmInfo->Status = 0;
-						CString strContents = _T("豸뼯ͨѶжϣ澯!");
+						CString strContents = _T("设备与集中器通讯中断，产生告警!");
 						memcpy(pAlarmInfo->Contents,strContents.GetBuffer(),sizeof(pAlarmInfo->Contents));
 					}
-					else if (iYxConfig.bYxValue==1)	//ͨѶָ ָ澯
+					else if (iYxConfig.bYxValue==1)	//通讯恢复 恢复告警
 					{
 						pAlarmInfo->Status = 2;
-						CString strContents = _T("豸뼯ͨѶָָ澯!");
+						CString strContents = _T("设备与集中器通讯恢复，恢复告警!");
 						memcpy(pAlarmInfo->Contents,strContents.GetBuffer(),sizeof(pAlarmInfo->Contents));
 					}
 
-					EnterCriticalSection(&pDlg->m_pCCSendP2pTask->m_csAlarmInfoList);
-					pDlg->m_pCCSendP2pTask->m_AlarmInfoList.AddTail(pAlarmInfo);
-					LeaveCriticalSection(&pDlg->m_pCCSendP2pTask->m_csAlarmInfoList);
+					if (!pDlg->m_pCCSendP2pTask->m_AlarmInfoQueue.PushWait(pAlarmInfo,QUEUE_PUSH_TIMEOUT))
+					{
+						ReguTrace(ERRO,"线程%d:告警信息队列已满,丢弃告警 DevId=%d",m_Index,DevId);
+						delete pAlarmInfo;
+						pAlarmInfo = NULL;
+					}
 				}
 				
 				m_YxValueInfoCArray.Add(iYxConfig);
-				EnterCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDevStateMap);
-				pDlg->m_pCRedisRecvSample->m_DevStateMap.SetAt(iYxConfig.nYxIndex,iYxConfig.bYxValue); //GUOJ MOD 151218
-				LeaveCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDevStateMap);
+				SetDevState(iYxConfig.nYxIndex,iYxConfig.bYxValue); //GUOJ MOD 151218
 
 				
 			} 
 		}
 		else
 		{
-			ReguTrace(Debug,"߳%d:δҵõλ:%d",m_Index,iYxConfig.nYxIndex);
+			ReguTrace(Debug,"线程%d:未找到该点位:%d",m_Index,iYxConfig.nYxIndex);
 		}
 		//GUOJ ADD 151030 end
 
@@ -669,7 +816,7 @@ void CProcessThread::OnSocketMsgGroupYx(SocketMsgGroupYxEx* pMsgGroupYxData)
 		//	hPipe = OpenServerPipe();
 		//}
 		//CString TempSql = _T("");
-		//TempSql.Format(_T("UPDATE TB_DI SET YXVALUE=%d WHERE DEVICENUM=%d AND NUM=%d; "),YxUnit->Value,DevId,YxUnit->Id);  //TB_DIеDEVICENUMΪ豸һ
+		//TempSql.Format(_T("UPDATE TB_DI SET YXVALUE=%d WHERE DEVICENUM=%d AND NUM=%d; "),YxUnit->Value,DevId,YxUnit->Id);  //TB_DI表中的DEVICENUM为设备表第一列
 		//UpdateSql += TempSql;
 		//icount++;
 		//if (icount%SQL_COUNT_ONCE!=0 && i!=pMsgGroupYxData->wdYxNum - 1)
@@ -686,18 +833,18 @@ void CProcessThread::OnSocketMsgGroupYx(SocketMsgGroupYxEx* pMsgGroupYxData)
 		//UpdateSql.Empty();
 
     }
-	ReguTrace(YXDATA,"߳%d:%s",m_Index,OutputStr);
-	if (pDlg->m_pCCSendP2pTask->m_AlarmInfoList.GetSize()>0)
+	ReguTrace(YXDATA,"线程%d:%s",m_Index,OutputStr);
+	if (pDlg->m_pCCSendP2pTask->m_AlarmInfoQueue.GetSize()>0)
 	{
-		ReguTrace(YXDATA,"߳%d:澯",m_Index);
+		ReguTrace(YXDATA,"线程%d:触发告警",m_Index);
 		SetEvent(pDlg->m_pCCSendP2pTask->m_AlarmEvent);
 	}
 	//SetEvent(pDlg->m_pCUpdateRTDBThread->m_ProcessDataEvent);
 	if (m_YxValueInfoCArray.GetSize()>0)
 	{
-		ReguTrace(Debug,"߳%d:Update2RTDB ʼ!µλ%d",m_Index,m_YxValueInfoCArray.GetSize());
+		ReguTrace(Debug,"线程%d:Update2RTDB 开始!更新点位个数%d。",m_Index,m_YxValueInfoCArray.GetSize());
 		Update2RTDB();
-		ReguTrace(Debug,"߳%d:Update2RTDB !",m_Index);
+		ReguTrace(Debug,"线程%d:Update2RTDB 结束!",m_Index);
 	}
 	if (hPipe != NULL)
 	{
@@ -707,8 +854,9 @@ void CProcessThread::OnSocketMsgGroupYx(SocketMsgGroupYxEx* pMsgGroupYxData)
 }
 
 
-void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmData)
+void CProcessThread::StartProcessData(const SocketFrameView &Frame)
 {
+	const SocketMsgGroupYmDataEx_DATE *pSocketMsgYmData = (const SocketMsgGroupYmDataEx_DATE*)Frame.pMsg;
 	short nRtuNo = pSocketMsgYmData->btRtuNo;
 	int SampleTableNo = TABLE_NO_SAMPLEHOUR;
 	int iyear = 0, imonth = 0, iday = 0, ihour = 0, iminite = 0, isecond = 0;
@@ -741,7 +889,7 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 	{
 		nRtuNo = pSocketMsgYmData->btForeNo * 256 + pSocketMsgYmData->btRtuNo;
 	}*/
-	int YmNum = pSocketMsgYmData->wdYmNum;
+	int YmNum = Frame.Units.nCount;
 	TIMESTAMP_STRUCT iTimeStamp;
 	memset(&iTimeStamp,0,sizeof(TIMESTAMP_STRUCT));
 	iTimeStamp.year = dataTime.GetYear();
@@ -749,27 +897,8 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 	iTimeStamp.day = dataTime.GetDay();
 	iTimeStamp.hour = dataTime.GetHour();
 	iTimeStamp.minute = dataTime.GetMinute();
-	unsigned char* pbYmData = NULL;
-	int nLengthYmStruct = 0;
-
-	SocketGroupYmUnitEx* pSocketYmDataEx = pSocketMsgYmData->YmUnitEx;
-	if (NULL == pSocketYmDataEx)	
-	{
-		return;
-	}
-	else	//־λ
-	{
-		pbYmData = (unsigned char*)pSocketYmDataEx;
-		nLengthYmStruct = sizeof(SocketGroupYmUnitEx);
-	}
 	int nLengthWord = sizeof(WORD);
 	int nLengthDWord = sizeof(DWORD);
-	int MinSampleNo = 0;
-	int MaxSampleNo = 0;
-	int MinSampleNoDay = 0;
-	int MaxSampleNoDay = 0;
-	int icount = 0;
-	int icountDay = 0;
 	m_SampleValueInfoMap.clear();
 	m_SampleValueInfoMapDay.clear();
 	m_YmValueInfoCArray.RemoveAll();
@@ -778,16 +907,28 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 	memset(DataFlag,0,sizeof(DataFlag));
 	CTime CurTime = CTime::GetCurrentTime();
 	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
-	for (int i=0; i<YmNum; i++,pbYmData += nLengthYmStruct) 
+	//整组单元的设备号一次解析成设备ID
+	m_vecUnitDevNo.resize(YmNum);
+	m_vecUnitDevId.resize(YmNum);
+	for (int i=0; i<YmNum; i++)
+	{
+		m_vecUnitDevNo[i] = *((const WORD*)Frame.Units.At<BYTE>(i));
+	}
+	if (YmNum>0)
+	{
+		pDlg->m_pCRedisRecvSample->GetDevIds(nRtuNo,&m_vecUnitDevNo[0],YmNum,&m_vecUnitDevId[0]);
+	}
+	for (int i=0; i<YmNum; i++) 
 	{
+		const unsigned char* pbYmData = Frame.Units.At<unsigned char>(i);	//带标志位的脉冲量
 		unsigned char cFlag = DATA_FLAG_INVALID;        
-		cFlag = *(pbYmData + sizeof(SocketGroupYmUnit));   //־λ
+		cFlag = *(pbYmData + sizeof(SocketGroupYmUnit));   //标志位
 
 		PowFileInfo powInfo;
 		memset(&powInfo, 0, sizeof(PowFileInfo));
-		powInfo.nDevID = *((WORD*)pbYmData);                  //ǰ豸
-		powInfo.nYmNum = *((WORD*)(pbYmData + nLengthWord));   //λ
-		powInfo.nYmVal = (DWORD) *((DWORD*)(pbYmData + nLengthWord*2));  //ԭʼֵ
+		powInfo.nDevID = *((const WORD*)pbYmData);                  //前置设备号
+		powInfo.nYmNum = *((const WORD*)(pbYmData + nLengthWord));   //点位号
+		powInfo.nYmVal = (DWORD) *((const DWORD*)(pbYmData + nLengthWord*2));  //原始值
 		powInfo.cFlag = cFlag;
 		if (powInfo.nYmNum>0&&powInfo.nYmNum<9)
 		{
@@ -796,40 +937,40 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 		
 		//YmConfigDef YmDef;
 		SimpleYmDef YmDef;
-		int iDevId = 0 ;
-		if(!pDlg->m_pCRedisRecvSample->GetYmDefByPowInfo(nRtuNo,&powInfo,YmDef,iDevId))
+		int iDevId = m_vecUnitDevId[i];
+		if(iDevId==0||!pDlg->m_pCRedisRecvSample->GetYmDef(iDevId,powInfo.nYmNum,YmDef))
 		{
-			ReguTrace(ERRO,"߳%d:GetYmDef FAILED! StationId=%d,DevNum=%d,Num=%d.",m_Index,nRtuNo,powInfo.nDevID,powInfo.nYmNum);
+			ReguTrace(ERRO,"线程%d:GetYmDef FAILED! StationId=%d,DevNum=%d,Num=%d.",m_Index,nRtuNo,powInfo.nDevID,powInfo.nYmNum);
 			continue;
 		}		
 		CTime iLastDataTime = CTime(YmDef.DataTime.year,YmDef.DataTime.month,YmDef.DataTime.day,YmDef.DataTime.hour,YmDef.DataTime.minute,YmDef.DataTime.second);
 		CTimeSpan TimeSpan = dataTime - iLastDataTime;
 		DeviceInfo iDevInfo;
 		memset(&iDevInfo,0,sizeof(DeviceInfo));
-		pDlg->m_pCRedisRecvSample->m_DeviceInfoMap.Lookup(iDevId,iDevInfo);
-		if (iDevInfo.iDevType==52)	//ı
+		pDlg->m_pCRedisRecvSample->GetDeviceInfo(iDevId,iDevInfo);
+		if (iDevInfo.iDevType==52)	//国网的表
 		{
 			if(TimeSpan.GetHours()>9)
 			{
 				CString ff = _T("");
 				ff.Format(_T("%04d-%02d-%02d %02d:%02d:00"),iLastDataTime.GetYear(),iLastDataTime.GetMonth(),
 					iLastDataTime.GetDay(),iLastDataTime.GetHour(),iLastDataTime.GetMinute());
-				ReguTrace_ext(DataTime_log,ERRO,"豸id:%d(%d),λ:%d,ϴθʱ%s,θʱ%s",
+				ReguTrace_ext(DataTime_log,ERRO,"设备id:%d(%d),点位号:%d,上次更新时间%s,本次更新时间%s",
 					iDevId,iDevInfo.iDevType,powInfo.nYmNum,ff,timestr);
 			}
 		}
-		else if (iDevInfo.iDevType==9||iDevInfo.iDevType==10)	//Ǳ
+		else if (iDevInfo.iDevType==9||iDevInfo.iDevType==10)	//天溯仪表
 		{
 			if(TimeSpan.GetHours()>4)
 			{
 				CString ff = _T("");
 				ff.Format(_T("%04d-%02d-%02d %02d:%02d:00"),iLastDataTime.GetYear(),iLastDataTime.GetMonth(),
 					iLastDataTime.GetDay(),iLastDataTime.GetHour(),iLastDataTime.GetMinute());
-				ReguTrace_ext(DataTime_log,ERRO,"豸id:%d(%d),λ:%d,ϴθʱ%s,θʱ%s",
+				ReguTrace_ext(DataTime_log,ERRO,"设备id:%d(%d),点位号:%d,上次更新时间%s,本次更新时间%s",
 					iDevId,iDevInfo.iDevType,powInfo.nYmNum,ff,timestr);
 			}
 		}
-		if (powInfo.nYmNum==2&&powInfo.cFlag==1)	//GUOJ ADD 151117 DIͨ״̬Ϊ1
+		if (powInfo.nYmNum==2&&powInfo.cFlag==1)	//GUOJ ADD 151117 更新DI的通信状态为1
 		{
 			/*YmYxData*pYmYxData = new YmYxData;
 			YxConfigDef*pYxDefData = new YxConfigDef;*/
@@ -845,9 +986,7 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 			LeaveCriticalSection(&pDlg->m_pCUpdateRTDBThread->m_csYxYmDataList);*/
 
 			m_YxValueInfoCArray.Add(iYxConfig); 
-			EnterCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDevStateMap);
-			pDlg->m_pCRedisRecvSample->m_DevStateMap.SetAt(iYxConfig.nYxIndex,iYxConfig.bYxValue); 
-			LeaveCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDevStateMap);
+			SetDevState(iYxConfig.nYxIndex,iYxConfig.bYxValue);
 			BYTE lastState = 0;
 			//if (pDlg->m_pCRedisRecvSample->m_DevStateMap.Lookup(iYxConfig.nYxIndex,lastState)) //GUOJ MOD 151218
 			//{
@@ -855,21 +994,21 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 				//{
 					//AlarmInfo *pAlarmInfo = new AlarmInfo;
 					//memset(pAlarmInfo,0,sizeof(AlarmInfo));
-					//pAlarmInfo->AlarmType = 9003;	//9003ΪͨѶж
+					//pAlarmInfo->AlarmType = 9003;	//9003为电表通讯中断
 					//pAlarmInfo->ObjectId = iDevId;
 					//pAlarmInfo->ObjectType = 31;
 					//pAlarmInfo->reserve = nRtuNo;
 					//pAlarmInfo->AlarmTime = CurTime;
-					//if (iYxConfig.bYxValue==0)	//ͨѶж 澯
+					//if (iYxConfig.bYxValue==0)	//通讯中断 产生告警
 					//{
 					//	pAlarmInfo->Status = 0;
-					//	CString strContents = _T("豸뼯ͨѶжϣ澯!");
+					//	CString strContents = _T("设备与集中器通讯中断，产生告警!");
 					//	memcpy(pAlarmInfo->Contents,strContents,sizeof(pAlarmInfo->Contents));
 					//}
-					//else if (iYxConfig.bYxValue==1)	//ͨѶָ ָ澯
+					//else if (iYxConfig.bYxValue==1)	//通讯恢复 恢复告警
 					//{
 					//	pAlarmInfo->Status = 2;
-					//	CString strContents = _T("豸뼯ͨѶָָ澯!");
+					//	CString strContents = _T("设备与集中器通讯恢复，恢复告警!");
 					//	memcpy(pAlarmInfo->Contents,strContents,sizeof(pAlarmInfo->Contents));
 					//}
 					//m_YxValueInfoCArray.Add(iYxConfig);  //GUOJ ADD 151218
@@ -885,33 +1024,12 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 			
 		}  //GUOJ ADD 151117
 
-		CString strKey = _T("");
-		strKey.Format(_T("%d+%d+%d"),SampleTableNo, TABLE_NO_PULSE, YmDef.nYmIndex);
-		SampleDayNo::iterator iSampleInfo;	
-		iSampleInfo = pDlg->m_pCRedisRecvSample->m_MapSampleNo.find(strKey);
-		if (iSampleInfo == pDlg->m_pCRedisRecvSample->m_MapSampleNo.end())
+		int SampleNo = 0;
+		if (!pDlg->m_pCRedisRecvSample->GetSampleNo(SampleTableNo, TABLE_NO_PULSE, YmDef.nYmIndex, SampleNo))
 		{
-			ReguTrace(ERRO,"߳%d:m_MapSampleNo ޴ strKey='%s'!",m_Index,strKey);
+			ReguTrace(ERRO,"线程%d:采样序号无此配置 key='%d+%d+%d'!",m_Index,SampleTableNo,TABLE_NO_PULSE,YmDef.nYmIndex);
 			continue;
 		}
-		icount++;
-		int SampleNo = iSampleInfo->second;
-		if (icount==1)
-		{
-			MinSampleNo = SampleNo;
-			MaxSampleNo = SampleNo;
-		}
-		else 
-		{
-			if (MinSampleNo>SampleNo)
-			{
-				MinSampleNo = SampleNo;
-			}
-			if (MaxSampleNo<SampleNo)
-			{
-				MaxSampleNo = SampleNo;
-			}	
-		}
 		double dbYm = 0.0;
 		dbYm = powInfo.nYmVal * YmDef.dYmQuotiety;
 
@@ -921,10 +1039,10 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 		iSampleValue.cFlag = cFlag;
 		m_SampleValueInfoMap[SampleNo] = iSampleValue;
 
-		//ѹб  ڼǷгֵ¼
+		//把购电次数加入列表  用于检查是否招充值记录
 		if (powInfo.nYmNum==7&&powInfo.cFlag==1)
 		{
-			if (YmDef.nYmRaw<powInfo.nYmVal)  //ʵʱеĹ
+			if (YmDef.nYmRaw<powInfo.nYmVal)  //购电次数大于实时库中的购电次数
 			{
 				ProtocolCallItem *pItem = new ProtocolCallItem;
 				if (NULL==pItem)
@@ -932,8 +1050,8 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 					continue;
 				}
 				memset(pItem,0,sizeof(ProtocolCallItem));
-				pItem->m_nType = 0xE1;//MSW 150828,עͣ0xE1-ٻֵ¼ı־
-				pItem->m_nDeviceNo = YmDef.nDeviceNo;    //豸һ Id
+				pItem->m_nType = 0xE1;//MSW 150828,加注释，0xE1-召唤充值记录的标志
+				pItem->m_nDeviceNo = YmDef.nDeviceNo;    //设备表第一列 Id
 				pItem->m_nStationNum = nRtuNo;
 
 				SocketMsgPrepayRecord iPrepayRecord ;
@@ -941,74 +1059,37 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 				iPrepayRecord.btRtuNo = pSocketMsgYmData->btRtuNo;     //==m_nStationNum
 				iPrepayRecord.btEndNo = 0xff;
 				iPrepayRecord.btForeNo = pSocketMsgYmData->btForeNo;
-				iPrepayRecord.nDevNo = powInfo.nDevID;    //豸ڶ deviceNo
+				iPrepayRecord.nDevNo = powInfo.nDevID;    //设备表第二列 deviceNo
 				iPrepayRecord.wdYjNum = powInfo.nYmVal - YmDef.nYmRaw;
 				memcpy(pItem->m_nBuffer,&iPrepayRecord,sizeof(SocketMsgPrepayRecord)-sizeof(SocketPrepayRecordUnit));
 
-				EnterCriticalSection(&pDlg->m_pCCSendP2pTask->m_csRecordList);
-				pDlg->m_pCCSendP2pTask->m_RecordList.AddTail(pItem);
-				LeaveCriticalSection(&pDlg->m_pCCSendP2pTask->m_csRecordList);
+				if (!pDlg->m_pCCSendP2pTask->m_RecordQueue.PushWait(pItem,QUEUE_PUSH_TIMEOUT))
+				{
+					ReguTrace(ERRO,"线程%d:招充值记录队列已满,丢弃 DeviceNo=%d",m_Index,YmDef.nDeviceNo);
+					delete pItem;
+					pItem = NULL;
+				}
 			}
 		}
 		
 
-		if (cFlag==1)  //m_YmConfigDefMap
+		if (cFlag==1)  //更新至遥脉索引快照里
 		{
 			YmDef.nYmRaw = powInfo.nYmVal;
 			YmDef.dYmValue = powInfo.nYmVal*YmDef.dYmQuotiety;
 			YmDef.DataTime = iTimeStamp;
-			YmYxData*pYmYxData = new YmYxData;
-			YmConfigDef*pYmDefData = new YmConfigDef;
-
-			//YmConfigDef iYmConfig;
-			memset(pYmDefData,0,sizeof(YmConfigDef));
-			pYmDefData->nYmIndex = YmDef.nYmIndex;
-			pYmDefData->nDeviceNo = YmDef.nDeviceNo;
-			pYmDefData->nYmNum = YmDef.nYmNum;
-			pYmDefData->dYmQuotiety = YmDef.dYmQuotiety;
-			pYmDefData->nYmRaw = YmDef.nYmRaw;
-			pYmDefData->dYmValue = YmDef.dYmValue;
-			//m_YmValueInfoCArray.Add(iYmConfig);
-			pYmYxData->iType = 1;
-			pYmYxData->data = pYmDefData;
-			EnterCriticalSection(&pDlg->m_pCUpdateRTDBThread->m_csYxYmDataList);
-			pDlg->m_pCUpdateRTDBThread->m_YxYmDataList.AddTail(pYmYxData);
-			LeaveCriticalSection(&pDlg->m_pCUpdateRTDBThread->m_csYxYmDataList);
-			CString tempKey = _T("");
-			tempKey.Format(_T("%d+%d"), YmDef.nDeviceNo, YmDef.nYmNum);	//keyΪ豸ID+ңš
-			EnterCriticalSection(&pDlg->m_pCRedisRecvSample->m_csYmConfigDefMap);
-			pDlg->m_pCRedisRecvSample->m_YmConfigDefMap[tempKey] = YmDef;
-			LeaveCriticalSection(&pDlg->m_pCRedisRecvSample->m_csYmConfigDefMap);
+			//实时值交给写回缓存，同一点在一个入库周期内只保留最新值
+			pDlg->m_pCUpdateRTDBThread->UpdateYm(YmDef.nYmIndex,YmDef.nYmRaw,YmDef.dYmValue);
+			pDlg->m_pCRedisRecvSample->UpdateYmDef(YmDef);
 		}
 		if (ihour==0&&iminite==0)
 		{
-			strKey = _T("");
-			strKey.Format(_T("%d+%d+%d"),TABLE_NO_SAMPLEDAY, TABLE_NO_PULSE, YmDef.nYmIndex);
-			SampleDayNo::iterator iSampleInfo;	
-			iSampleInfo = pDlg->m_pCRedisRecvSample->m_MapSampleNo.find(strKey);
-			if (iSampleInfo == pDlg->m_pCRedisRecvSample->m_MapSampleNo.end())
+			int SampleNoDay = 0;
+			if (!pDlg->m_pCRedisRecvSample->GetSampleNo(TABLE_NO_SAMPLEDAY, TABLE_NO_PULSE, YmDef.nYmIndex, SampleNoDay))
 			{
-				ReguTrace(ERRO,"߳%d:m_MapSampleNo ޴ strKey='%s'!",m_Index,strKey);
+				ReguTrace(ERRO,"线程%d:采样序号无此配置 key='%d+%d+%d'!",m_Index,TABLE_NO_SAMPLEDAY,TABLE_NO_PULSE,YmDef.nYmIndex);
 				continue;
 			}
-			icountDay++;
-			int SampleNoDay = iSampleInfo->second;
-			if (icountDay==1)
-			{
-				MinSampleNoDay = SampleNoDay;
-				MaxSampleNoDay = SampleNoDay;
-			}
-			else 
-			{
-				if (MinSampleNoDay>SampleNoDay)
-				{
-					MinSampleNoDay = SampleNoDay;
-				}
-				if (MaxSampleNoDay<SampleNoDay)
-				{
-					MaxSampleNoDay = SampleNoDay;
-				}	
-			}
 			SampleValueInfo iSampleValueDay;
 			iSampleValueDay.SampleNo = SampleNoDay;
 			iSampleValueDay.dbValue = dbYm;
@@ -1017,510 +1098,117 @@ void CProcessThread::StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmD
 		}
 	}
 
-	if (pDlg->m_pCCSendP2pTask->m_RecordList.GetSize()>0)
+	if (pDlg->m_pCCSendP2pTask->m_RecordQueue.GetSize()>0)
 	{
 		SetEvent(pDlg->m_pCCSendP2pTask->m_ProcessDataEvent);
 	}
-	SetEvent(pDlg->m_pCUpdateRTDBThread->m_ProcessDataEvent);
 	if (m_YxValueInfoCArray.GetSize()>0)
 	{
-		//ReguTrace(Debug,"߳%d:Update2RTDB ʼ!",m_Index);
+		//ReguTrace(Debug,"线程%d:Update2RTDB 开始!",m_Index);
 		Update2RTDB();
-		//ReguTrace(Debug,"߳%d:Update2RTDB !",m_Index);
+		//ReguTrace(Debug,"线程%d:Update2RTDB 结束!",m_Index);
 	}
 	if (m_SampleValueInfoMap.size()>0)
 	{
 		if (!(DataFlag[2]==TRUE&&DataFlag[3]==TRUE&&DataFlag[4]==TRUE&&DataFlag[5]==TRUE&&DataFlag[6]==TRUE))
 		{
-			SaveSampleData2DB(MinSampleNo,MaxSampleNo,timestr,0);
+			SaveSampleData2DB(timestr,0);
 		}
 		
 	}
 	if (m_SampleValueInfoMapDay.size()>0)
 	{
-		SaveSampleData2DB(MinSampleNoDay,MaxSampleNoDay,timestr,1);
+		SaveSampleData2DB(timestr,1);
 	}
 }
 
-void CProcessThread::SaveSampleData2DB(int MinSampleNo, int MaxSampleNo,CString StrTimeId,int itype)
+void CProcessThread::SaveSampleData2DB(CString StrTimeId,int itype)
 {
+	//采样值交给批量入库线程，按表和TIMEID与其他线程的数据合并后统一生成SQL
 	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
-	HANDLE hPipe = OpenRealDataPipe();
-	int ReConnTime = 0;
-	while (hPipe == NULL)
+	if (itype==0)  //小时采样
 	{
-		if (ReConnTime>=3)
-		{
-			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
-			return ;
-		}
-		ReConnTime++;
-		Sleep(1000);
-		hPipe = OpenRealDataPipe();
-		
+		pDlg->m_pSampleBatchWriter->AddSampleData(itype,StrTimeId,m_SampleValueInfoMap);
 	}
-	SYSTEMTIME tt;
-	CString sFileName = _T("");
-
-	GetLocalTime(&tt);
-	sFileName.Format(_T("%04d-%02d-%02d"), tt.wYear, tt.wMonth, tt.wDay);
-	CString sPath = pDlg->m_pCRedisRecvSample->m_strPath + _T("\\data_sql\\") + sFileName;
-
-	CFileFind fFind;
-	if (!fFind.FindFile(sPath))
+	else if (itype==1)  //天采样
 	{
-		ReguTrace(ERRO,"߳%d:δҵ·,path=%s!",m_Index,sPath);
-		if (!CreateDirectory(sPath, NULL))
-		{
-			ReguTrace(ERRO,"߳%d:ļг,path=%s!",m_Index,sPath);
-			return ;
-		}
+		pDlg->m_pSampleBatchWriter->AddSampleData(itype,StrTimeId,m_SampleValueInfoMapDay);
 	}
-	sFileName.Format(_T("%d_%04d-%02d-%02d %02d-%02d-%02d-%03d"), m_Index,tt.wYear, tt.wMonth, tt.wDay, tt.wHour, tt.wMinute, tt.wSecond, tt.wMilliseconds);
-	sPath += _T("\\SampleData_") + sFileName + _T(".txt");
-
-	
+}
 
-	int TableMinNo = MinSampleNo/SAMPLE_FIELDNUM ;
-	int TableMaxNo = MaxSampleNo/SAMPLE_FIELDNUM ;
-	if(MinSampleNo%SAMPLE_FIELDNUM==0&&TableMinNo!=0)		//GUOJ ADD 151228 ֹСΪ128ıʱ Ǵ										
-	{										//һűһֶεģV128Ҫ1
-		TableMinNo = TableMinNo - 1;
-	}
-	CString PreTableName = _T("TS_H1_%03d");
-	CString PreTableExtName = _T("TS_H1_EXT_%03d");
-	if(itype==1)
+//更新至实时库，同一张表的点共用一块报文缓冲区
+BOOL CProcessThread::Update2RTDB()
+{
+	//遥脉：TB_PULSE只更新原始值和遥脉值两列
+	int nYmCols[] = {7,9};
+	CRtdbUpdateFrame YmFrame;
+	if (!YmFrame.Init(TABLE_NO_PULSE,sizeof(YmConfigDef),nYmCols,2,m_nRtdbFrameRecords))
 	{
-		PreTableName = _T("TS_DAY_%03d");
-		PreTableExtName = _T("TS_DAY_EXT_%03d");
+		ReguTrace(ERRO,"YmValue pWrite==null!");
+		return FALSE;
 	}
-	CString strnSql = _T("");
-	int nCount = 0;
-	for (int i = TableMinNo; i<=TableMaxNo;i++)
+	//遥信：TB_DI只更新原始值和遥信值两列
+	int nYxCols[] = {7,9};
+	CRtdbUpdateFrame YxFrame;
+	if (!YxFrame.Init(TABLE_NO_DI,sizeof(YxConfigDef),nYxCols,2,m_nRtdbFrameRecords))
 	{
-		CString tableName = _T("");
-		tableName.Format(PreTableName,i);
-		CString tableNameExt = _T("");
-		tableNameExt.Format(PreTableExtName,i);
-		CString strSql = _T("");
-		CString strSql_Ext = _T("");
-		CString ColonmNames = _T("TIMEID");
-		CString ColonNames_Ext = _T("TIMEID");
-		CString strVals = _T("");
-		CString strValsflag = _T("");
-		CString UpdateVals = _T("");
-		CString UpdateVals_Ext = _T("");
-		for (int j = 1;j<=SAMPLE_FIELDNUM;j++)
-		{
-			int sampleNo = i*SAMPLE_FIELDNUM + j;
-			if (itype==0)  //Сʱ
-			{
-				SampleValueInfoMap::iterator its;	
-				its = m_SampleValueInfoMap.find(sampleNo);
-				if (its != m_SampleValueInfoMap.end())
-				{
-					SampleValueInfo iSampleValue = its->second;
-					TCHAR Text[5];
-					TCHAR TextExt[10];
-					TCHAR ValueText[40];
-					TCHAR ValueTextflag[40];
-					TCHAR UpdateText[40];
-					TCHAR UpdateTextExt[40];
-					_stprintf(Text,_T(",V%03d"), j);
-					ColonmNames += Text;
-					_stprintf(TextExt,_T(",V%03d_FLAG"), j);
-					ColonNames_Ext += TextExt;
-					_stprintf(ValueText,_T(",%2f"),iSampleValue.dbValue);
-					strVals += ValueText;
-					_stprintf(ValueTextflag,_T(",%d"),iSampleValue.cFlag);
-					strValsflag += ValueTextflag;
-					_stprintf(UpdateText,_T("V%03d=%2f,"),j,iSampleValue.dbValue);
-					UpdateVals += UpdateText;
-					_stprintf(UpdateTextExt,_T("V%03d_FLAG=%d,"),j,iSampleValue.cFlag);
-					UpdateVals_Ext += UpdateTextExt;
-				}
-
-			}
-			else if (itype==1)  //
-			{
-				SampleValueInfoMap::iterator its;	
-				its = m_SampleValueInfoMapDay.find(sampleNo);
-				if (its != m_SampleValueInfoMapDay.end())
-				{
-					/*SampleValueInfo iSampleValue = its->second;
-					TCHAR Text[5];
-					TCHAR ValueText[40];
-					TCHAR UpdateText[40];
-					_stprintf(Text,_T(",V%03d"), j);
-					ColonmNames += Text;
-					_stprintf(ValueText,_T(",%2f"),iSampleValue.dbValue);
-					strVals += ValueText;
-					_stprintf(UpdateText,_T("V%03d=%2f,"),j,iSampleValue.dbValue);
-					UpdateVals += UpdateText;*/
-					SampleValueInfo iSampleValue = its->second;
-					TCHAR Text[5];
-					TCHAR TextExt[10];
-					TCHAR ValueText[40];
-					TCHAR ValueTextflag[40];
-					TCHAR UpdateText[40];
-					TCHAR UpdateTextExt[40];
-					_stprintf(Text,_T(",V%03d"), j);
-					ColonmNames += Text;
-					_stprintf(TextExt,_T(",V%03d_FLAG"), j);
-					ColonNames_Ext += TextExt;
-					_stprintf(ValueText,_T(",%2f"),iSampleValue.dbValue);
-					strVals += ValueText;
-					_stprintf(ValueTextflag,_T(",%d"),iSampleValue.cFlag);
-					strValsflag += ValueTextflag;
-					_stprintf(UpdateText,_T("V%03d=%2f,"),j,iSampleValue.dbValue);
-					UpdateVals += UpdateText;
-					_stprintf(UpdateTextExt,_T("V%03d_FLAG=%d,"),j,iSampleValue.cFlag);
-					UpdateVals_Ext += UpdateTextExt;
-				}
-			}
-
-		}
-		if (UpdateVals.IsEmpty())
-		{
-			if (!strnSql.IsEmpty())
-			{
-				CString strSqlFinal1 = strnSql;
-				ReguTrace(SQL,"߳%d:SQL:<%s>",m_Index,strSqlFinal1);
-				CStdioFile fLog; 
-				if(fLog.Open(sPath, CFile::modeCreate|CFile::shareDenyNone | CFile::modeNoTruncate | CFile::modeReadWrite))
-				{
-					fLog.SeekToEnd();
-					fLog.WriteString(strSqlFinal1);
-					fLog.Close();
-				}
-				else
-				{
-					ReguTrace(SQL,"߳%d:SQL:дļʧ",m_Index);
-					BYTE* pRead = NULL;
-					pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal1);
-					if (pRead)
-					{
-						delete[] pRead;
-						pRead = NULL;
-					}
-				}
-				/*BYTE* pRead = NULL;
-				pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal1);
-				if (pRead)
-				{
-					delete[] pRead;
-					pRead = NULL;
-				}*/
-				strnSql.Empty();
-			}
-			continue;
-		}
-		UpdateVals = UpdateVals.Left(UpdateVals.GetLength()-1);
-		strSql.Format(C_SQL_Insert_SampleTable,tableName,StrTimeId,tableName,UpdateVals,StrTimeId,tableName,ColonmNames,StrTimeId,strVals);
-		strSql_Ext.Format(C_SQL_Insert_SampleTable,tableNameExt,StrTimeId,tableNameExt,UpdateVals_Ext,StrTimeId,tableNameExt,ColonNames_Ext,StrTimeId,strValsflag);
-		//strSql.Format(_T("if insert into %s (%s) values ('%s'%s);"),tableName,ColonmNames,StrTimeId,strVals);
-		//strnSql += (strSql + strSql_Ext);
-		strnSql += strSql;
-		nCount++;
-		if (nCount%SQL_COUNT_ONCE!=0 && i!=TableMaxNo)
-		{
-			continue;
-		}
-		CString strSqlFinal = strnSql;
-		ReguTrace(SQL,"߳%d:SQL:<%s>",m_Index,strSqlFinal);
-		CStdioFile fLog; 
-		if(fLog.Open(sPath, CFile::modeCreate|CFile::shareDenyNone | CFile::modeNoTruncate | CFile::modeReadWrite))
-		{
-			fLog.SeekToEnd();
-			fLog.WriteString(strSqlFinal);
-			fLog.Close();
-		}
-		else
-		{
-			ReguTrace(SQL,"߳%d:SQL:дļʧ",m_Index);
-			BYTE* pRead = NULL;
-			pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
-			if (pRead)
-			{
-				delete[] pRead;
-				pRead = NULL;
-			}
-		}
-		/*BYTE* pRead = NULL;
-		pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
-		if (pRead)
-		{
-			delete []pRead;
-			pRead = NULL;
-		}*/
-		strnSql.Empty();
+		ReguTrace(ERRO,"YxValue pWrite==null!");
+		return FALSE;
 	}
-	if (hPipe != NULL)
+	//多个点打包成一帧，帧满即交给发送窗口，不等应答继续组下一帧。
+	//窗口中不同帧到达实时库的先后不保证，同一点只提交最后一次出现的值
+	m_RtdbLastPos.Clear();
+	for (int i=0; i<m_YmValueInfoCArray.GetSize();i++)
 	{
-		CloseHandle(hPipe);
-		hPipe = NULL;
+		m_RtdbLastPos.Insert(m_YmValueInfoCArray[i].nYmIndex,i);
 	}
-}
-
-//ʵʱ
-BOOL CProcessThread::Update2RTDB()
-{
-	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
-	HANDLE hPipe=NULL;	 
-	hPipe = OpenRealDataPipe();
-	if (hPipe==NULL)
-		return FALSE;
+	int nLastPos = 0;
 	for (int i=0; i<m_YmValueInfoCArray.GetSize();i++)
 	{
-		YmConfigDef iYmDef;
-		iYmDef = m_YmValueInfoCArray[i];
-		if (iYmDef.nYmNum!=7)
+		if (m_YmValueInfoCArray[i].nYmNum!=7)
 		{
 			continue;
 		}
-		BYTE *pData;
-		int nRecordLen = sizeof(YmConfigDef);
-		DWORD dwBufLen = nRecordLen + sizeof(UpdataRecordStruct) + sizeof(NetMessageHead);
-		BYTE* pWrite = new BYTE[dwBufLen];
-		if (NULL==pWrite)
-		{
-			ReguTrace(ERRO,"YmValue pWrite==null!");
-			if (hPipe != NULL)
-			{
-				CloseHandle(hPipe);
-				hPipe = NULL;
-			}
-			return FALSE;
-		}
-		NetMessageHead* pMessageHead = (NetMessageHead*)pWrite;										  
-		pMessageHead->MessageType =	NET_MESSAGE_UPDATARECORD;						 
-		pMessageHead->Length = nRecordLen + sizeof(UpdataRecordStruct) - 1;							 
-		UpdataRecordStruct* pUpdataStruct = (UpdataRecordStruct*)&pWrite[sizeof(NetMessageHead)];
-
-		pUpdataStruct->TableNo = TABLE_NO_PULSE;	
-		memset(&(pUpdataStruct->ColFlag[0]),0,256);
-		//GUOJ DEL 151117	ֹpulseֶζΪֵ
-		pUpdataStruct->ColFlag[7] = 1;
-		pUpdataStruct->ColFlag[9] = 1;
-		/*for (int i=0; i<11; i++) {
-			pUpdataStruct->ColFlag[i] = 1;
-		}*/
-
-		pUpdataStruct->UpdataType = UPDATARECORD_TYPE_UPDATA; 
-		pUpdataStruct->RecordLen = nRecordLen;
-
-		BYTE *pData1;
-		pData = new BYTE[nRecordLen];
-		if (NULL==pData)
+		if (m_RtdbLastPos.Find(m_YmValueInfoCArray[i].nYmIndex,nLastPos) && nLastPos!=i)
 		{
-			ReguTrace(ERRO,"YmValue pData==null!");
-			if (hPipe != NULL)
-			{
-				CloseHandle(hPipe);
-				hPipe = NULL;
-			}
-			return FALSE;
-		}
-		memset(pData,0,nRecordLen);
-		int nOffset = 0;
-		pData1 = pData;
-
-		memcpy(pData,&iYmDef.nYmIndex,sizeof(iYmDef.nYmIndex));
-		nOffset+=sizeof(iYmDef.nYmIndex);
-
-		memcpy((pData+nOffset),&iYmDef.nProjectNo,sizeof(iYmDef.nProjectNo));
-		nOffset+=sizeof(iYmDef.nProjectNo);
-
-		memcpy((pData+nOffset),&iYmDef.nStationNo,sizeof(iYmDef.nStationNo));
-		nOffset+=sizeof(iYmDef.nStationNo);
-
-		memcpy((pData+nOffset),&iYmDef.nDeviceNo,sizeof(iYmDef.nDeviceNo));
-		nOffset+=sizeof(iYmDef.nDeviceNo);
-
-		memcpy((pData+nOffset),&iYmDef.nYmNum,sizeof(iYmDef.nYmNum));
-		nOffset+=sizeof(iYmDef.nYmNum);
-
-		memcpy((pData+nOffset),iYmDef.cYmName,sizeof(iYmDef.cYmName));
-		nOffset+=sizeof(iYmDef.cYmName);
-
-		memcpy((pData+nOffset),iYmDef.cDescription,sizeof(iYmDef.cDescription));
-		nOffset+=sizeof(iYmDef.cDescription);
-
-		memcpy((pData+nOffset),&iYmDef.nYmRaw,sizeof(iYmDef.nYmRaw));
-		nOffset+=sizeof(iYmDef.nYmRaw);
-
-		memcpy((pData+nOffset),&iYmDef.dYmQuotiety,sizeof(iYmDef.dYmQuotiety));
-		nOffset+=sizeof(iYmDef.dYmQuotiety);
-
-		memcpy((pData+nOffset),&iYmDef.dYmValue,sizeof(iYmDef.dYmValue));
-		nOffset+=sizeof(iYmDef.dYmValue);
-
-		memcpy((pData+nOffset),&iYmDef.bIdentifier,sizeof(iYmDef.bIdentifier));
-		nOffset+=sizeof(iYmDef.bIdentifier);
-
-		memmove(&pUpdataStruct->RecordData,pData1,nRecordLen);
-
-		BYTE* pRead;
-		if (hPipe)
-			//EnterCriticalSection(&pDlg->m_pCRedisRecvSample->m_csUpdateRTDB);
-			pRead = (BYTE*)GetNetMessage(hPipe, pWrite,dwBufLen-1);	
-			//LeaveCriticalSection(&pDlg->m_pCRedisRecvSample->m_csUpdateRTDB);
-
-		if (pWrite!=NULL)
-		{
-			delete[] pWrite;
-		}
-		if (pRead==NULL) 
-		{
-			delete[] pData1;
 			continue;
 		}
-		pMessageHead = (NetMessageHead*)pRead;
-		MessageAck* pAck = (MessageAck*)&pRead[sizeof(NetMessageHead)];
-		if (pMessageHead->MessageType!=NET_MESSAGE_ACK || pAck->wdAckType!=NET_MESSAGE_ACK_OK) 
+		YmFrame.PutYm(m_YmValueInfoCArray[i]);
+		if (YmFrame.IsFull())
 		{
-			delete[] pRead;	
-			delete[] pData1;
-			continue;
+			m_RtdbWindow.Submit(YmFrame);
 		}
-		delete[] pRead;
-		delete[] pData1;
-
 	}
+	m_RtdbWindow.Submit(YmFrame);
+	m_RtdbLastPos.Clear();
 	for (int i=0; i<m_YxValueInfoCArray.GetSize();i++)
 	{
-		YxConfigDef iYxConfig;
-		iYxConfig = m_YxValueInfoCArray[i];
-		BYTE *pData;
-		int nRecordLen = sizeof(YxConfigDef);
-
-		DWORD dwBufLen = nRecordLen + sizeof(UpdataRecordStruct) + sizeof(NetMessageHead);
-		BYTE* pWrite = new BYTE[dwBufLen];
-		if (NULL==pWrite)
-		{
-			ReguTrace(ERRO,"YxValue pWrite==null!");
-			if (hPipe != NULL)
-			{
-				CloseHandle(hPipe);
-				hPipe = NULL;
-			}
-			return FALSE;
-		}
-		NetMessageHead* pMessageHead = (NetMessageHead*)pWrite;										  
-		pMessageHead->MessageType =	NET_MESSAGE_UPDATARECORD;						 
-		pMessageHead->Length = nRecordLen + sizeof(UpdataRecordStruct) - 1;							 
-		UpdataRecordStruct* pUpdataStruct = (UpdataRecordStruct*)&pWrite[sizeof(NetMessageHead)];
-
-		pUpdataStruct->TableNo = TABLE_NO_DI;	
-		memset(&(pUpdataStruct->ColFlag[0]),0,256);
-
-		pUpdataStruct->ColFlag[7] = 1;
-		pUpdataStruct->ColFlag[9] = 1;
-
-		pUpdataStruct->UpdataType = UPDATARECORD_TYPE_UPDATA; 
-		pUpdataStruct->RecordLen = nRecordLen;
-
-		BYTE *pData1;
-		pData = new BYTE[nRecordLen];
-		if (NULL==pData)
-		{
-			ReguTrace(ERRO,"YxValue pData==null!");
-			if (hPipe != NULL)
-			{
-				CloseHandle(hPipe);
-				hPipe = NULL;
-			}
-			return FALSE;
-		}
-		memset(pData,0,nRecordLen);
-		int nOffset = 0;
-		pData1 = pData;
-
-		memcpy(pData,&iYxConfig.nYxIndex,sizeof(iYxConfig.nYxIndex));
-		nOffset+=sizeof(iYxConfig.nYxIndex);
-
-		memcpy((pData+nOffset),&iYxConfig.nProjectNo,sizeof(iYxConfig.nProjectNo));
-		nOffset+=sizeof(iYxConfig.nProjectNo);
-
-		memcpy((pData+nOffset),&iYxConfig.nStationNo,sizeof(iYxConfig.nStationNo));
-		nOffset+=sizeof(iYxConfig.nStationNo);
-
-		memcpy((pData+nOffset),&iYxConfig.nDeviceNo,sizeof(iYxConfig.nDeviceNo));
-		nOffset+=sizeof(iYxConfig.nDeviceNo);
-
-		memcpy((pData+nOffset),&iYxConfig.nYxNum,sizeof(iYxConfig.nYxNum));
-		nOffset+=sizeof(iYxConfig.nYxNum);
-
-		memcpy((pData+nOffset),iYxConfig.cYxName,sizeof(iYxConfig.cYxName));
-		nOffset+=sizeof(iYxConfig.cYxName);
-
-		memcpy((pData+nOffset),iYxConfig.cDescription,sizeof(iYxConfig.cDescription));
-		nOffset+=sizeof(iYxConfig.cDescription);
-
-		memcpy((pData+nOffset),&iYxConfig.bYxRaw,sizeof(iYxConfig.bYxRaw));
-		nOffset+=sizeof(iYxConfig.bYxRaw);
-
-		memcpy((pData+nOffset),&iYxConfig.bYxType,sizeof(iYxConfig.bYxType));
-		nOffset+=sizeof(iYxConfig.bYxType);
-
-		memcpy((pData+nOffset),&iYxConfig.bYxValue,sizeof(iYxConfig.bYxValue));
-		nOffset+=sizeof(iYxConfig.bYxValue);
-
-		memcpy((pData+nOffset),&iYxConfig.bIdentifier,sizeof(iYxConfig.bIdentifier));
-		nOffset+=sizeof(iYxConfig.bIdentifier);
-
-		memcpy((pData+nOffset),&iYxConfig.nCountExchange,sizeof(iYxConfig.nCountExchange));
-		nOffset+=sizeof(iYxConfig.nCountExchange);
-
-		memcpy((pData+nOffset),&iYxConfig.nCountTrip,sizeof(iYxConfig.nCountTrip));
-		nOffset+=sizeof(iYxConfig.nCountTrip);
-
-		memcpy((pData+nOffset),&iYxConfig.nAlarmType,sizeof(iYxConfig.nAlarmType));
-		nOffset+=sizeof(iYxConfig.nAlarmType);
-
-		memcpy((pData+nOffset),&iYxConfig.nAlarmLevel,sizeof(iYxConfig.nAlarmLevel));
-		nOffset+=sizeof(iYxConfig.nAlarmLevel);
-
-		memcpy((pData+nOffset),&iYxConfig.nYxProp,sizeof(iYxConfig.nYxProp));
-		nOffset+=sizeof(iYxConfig.nYxProp);	
-
-		memmove(&pUpdataStruct->RecordData,pData1,nRecordLen);
-
-		BYTE* pRead;
-		if (hPipe)
-			pRead = (BYTE*)GetNetMessage(hPipe, pWrite,dwBufLen-1);	
-
-		if (pWrite!=NULL)
-		{
-			delete[] pWrite;
-		}
-
-		if (pRead==NULL) 
+		m_RtdbLastPos.Insert(m_YxValueInfoCArray[i].nYxIndex,i);
+	}
+	for (int i=0; i<m_YxValueInfoCArray.GetSize();i++)
+	{
+		if (m_RtdbLastPos.Find(m_YxValueInfoCArray[i].nYxIndex,nLastPos) && nLastPos!=i)
 		{
-			delete[] pData1;
 			continue;
 		}
-		pMessageHead = (NetMessageHead*)pRead;
-		MessageAck* pAck = (MessageAck*)&pRead[sizeof(NetMessageHead)];
-		if (pMessageHead->MessageType==NET_MESSAGE_ACK && pAck->wdAckType==NET_MESSAGE_ACK_OK) 
+		YxFrame.PutYx(m_YxValueInfoCArray[i]);
+		if (YxFrame.IsFull())
 		{
-			delete[] pRead;
-			delete[] pData1;
-			continue;
+			m_RtdbWindow.Submit(YxFrame);
 		}
-		delete[] pRead;
-		delete[] pData1;
 	}
-	if (hPipe != NULL)
+	m_RtdbWindow.Submit(YxFrame);
+	int nFailed = m_RtdbWindow.Flush();
+	if (nFailed > 0)
 	{
-		CloseHandle(hPipe);
-		hPipe = NULL;
+		ReguTrace(SQLERRO,"线程%d:实时库更新%d个点未确认成功!",m_Index,nFailed);
 	}
 	return TRUE;
 }
 
+
 BEGIN_MESSAGE_MAP(CProcessThread, CWinThread)
 END_MESSAGE_MAP()
 
 
-// CProcessThread Ϣ
+// CProcessThread 消息处理程序
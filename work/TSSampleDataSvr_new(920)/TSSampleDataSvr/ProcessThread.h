@@ -2,29 +2,41 @@
 #include "HiredisIntf.h"
 #include "SoftBus.h"
 #include "RedisBus.h"
+#include "RedisBatchConsumer.h"
+#include "FlatHashIndex.h"
 
 
 // CProcessThread
 
+class CProcessThread;
+typedef void (CProcessThread::*SocketMsgHandler)(const SocketFrameView &Frame);
+
 class CProcessThread : public CWinThread
 {
 	DECLARE_DYNCREATE(CProcessThread)
 
 public:
-	CProcessThread();           // ̬ʹõܱĹ캯
+	CProcessThread();           // 动态创建所使用的受保护的构造函数
 	virtual ~CProcessThread();
 
 public:
 	virtual BOOL InitInstance();
 	virtual int ExitInstance();
-	void StartProcessData(SocketMsgGroupYmDataEx_DATE *pSocketMsgYmData);
-	void OnSocketMsgGroupYx(SocketMsgGroupYxEx* pMsgGroupYxData);
-	void OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordData);
+	void StartProcessData(const SocketFrameView &Frame);
+	void OnSocketMsgGroupYx(const SocketFrameView &Frame);
+	void OnCallPrePayRecord(const SocketFrameView &Frame);
+	void RegisterHandler(BYTE btType, SocketMsgHandler pHandler);
 	BOOL Update2RTDB();
-	void SaveSampleData2DB(int MinSampleNo, int MaxSampleNo,CString StrTimeId,int itype);
+	void SaveSampleData2DB(CString StrTimeId,int itype);
 	BOOL QueryExamineRecorde(int iDevId, int ChargeCnt,float fFee,CTime ChargeTime, CString &SerialId);
 	BOOL GetDataFromRedis();
+	BOOL GetBatchFromRedis();
+	void ProcessFrame(BYTE *pBuf, int nLen);
+	int ProcessQueuedFrames();
 	BOOL ConnectRedisServer();
+	BOOL LookupDevState(int nYxIndex, BYTE &State);
+	void SetDevState(int nYxIndex, BYTE State);
+	int GetPendingCount();
 public:
 	SampleValueInfoMap m_SampleValueInfoMap;
 	SampleValueInfoMap m_SampleValueInfoMapDay;
@@ -35,6 +47,19 @@ public:
 	CRITICAL_SECTION m_csRedisDataList;
 	CSoftBus *m_softbus; 
 	int m_Index;
+	int m_nBatchPop;					//每次往返取的报文数，0表示经软总线逐条取
+	int m_nBlockTime;					//批量模式下Redis为空时阻塞等待的秒数
+	CRedisBatchConsumer m_BatchConsumer;
+	int m_nRtdbFrameRecords;			//实时库更新报文每帧最多记录数
+	int m_nRtdbWindow;					//实时库更新报文同时等待应答的帧数
+	CRtdbUpdateWindow m_RtdbWindow;		//Update2RTDB的发送窗口，线程启动时按m_nRtdbWindow启动
+	CFlatHashIndex m_RtdbLastPos;		//Update2RTDB去重：点号 -> 本次最后一次出现的下标
+	BOOL m_bPartition;					//分区模式：报文由CSampleDispatcher按厂站号投递到m_FrameQueue，不直接读Redis
+	CMpscQueue<BYTE*> m_FrameQueue;		//分区模式下待处理的报文
+	CMap<int,int,BYTE,BYTE&> m_DevStateShard;	//分区模式下本线程负责厂站的遥信状态，只由本线程访问
+	SocketMsgHandler m_Handlers[256];	//按btType分派报文，未注册的类型为NULL
+	std::vector<int> m_vecUnitDevNo;		//一组单元的前置设备号
+	std::vector<int> m_vecUnitDevId;		//对应的设备ID，0表示未找到
 	//CLog *m_log;
 protected:
 	DECLARE_MESSAGE_MAP()
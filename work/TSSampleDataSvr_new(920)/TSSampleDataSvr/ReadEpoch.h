@@ -0,0 +1,71 @@
+#pragma once
+
+// CReadEpoch
+// 整体替换的只读快照(索引、设备信息表等)的释放时机：读者在访问快照前后调用ReadLock/ReadUnlock，
+// 按当前纪元的奇偶计数；发布者换上新快照后调用Synchronize翻转纪元，并等旧纪元的读者全部退出，
+// 此后不会再有人拿到旧快照，即可立即释放。读区间内只做查找和拷贝，不能阻塞。
+//
+// 用法：
+//	LONG nIdx = m_ReadEpoch.ReadLock();
+//	CYmLookupIndex *pIndex = m_pLookupIndex;
+//	...
+//	m_ReadEpoch.ReadUnlock(nIdx);
+
+class CReadEpoch
+{
+public:
+	CReadEpoch()
+	{
+		m_nEpoch = 0;
+		m_nReaders[0] = 0;
+		m_nReaders[1] = 0;
+		InitializeCriticalSection(&m_csSync);
+	}
+
+	~CReadEpoch()
+	{
+		DeleteCriticalSection(&m_csSync);
+	}
+
+	//返回登记的计数下标，交给ReadUnlock
+	LONG ReadLock()
+	{
+		while (1)
+		{
+			LONG nEpoch = m_nEpoch;
+			InterlockedIncrement(&m_nReaders[nEpoch & 1]);
+			if (nEpoch == m_nEpoch)
+			{
+				return nEpoch & 1;
+			}
+			//纪元已翻转，可能错过了发布者的等待，按新纪元重新登记
+			InterlockedDecrement(&m_nReaders[nEpoch & 1]);
+		}
+	}
+
+	void ReadUnlock(LONG nIdx)
+	{
+		InterlockedDecrement(&m_nReaders[nIdx]);
+	}
+
+	//在替换快照指针之后调用；返回时已没有读者持有替换前的快照
+	void Synchronize()
+	{
+		EnterCriticalSection(&m_csSync);
+		LONG nOld = m_nEpoch;
+		InterlockedIncrement(&m_nEpoch);
+		while (m_nReaders[nOld & 1] != 0)
+		{
+			Sleep(0);
+		}
+		LeaveCriticalSection(&m_csSync);
+	}
+
+private:
+	CReadEpoch(const CReadEpoch&);
+	CReadEpoch& operator=(const CReadEpoch&);
+
+	volatile LONG m_nEpoch;
+	volatile LONG m_nReaders[2];
+	CRITICAL_SECTION m_csSync;		//发布者之间互斥，同一时刻只有一次翻转
+};
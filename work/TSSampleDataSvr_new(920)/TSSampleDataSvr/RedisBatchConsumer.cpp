@@ -0,0 +1,190 @@
+// RedisBatchConsumer.cpp : 实现文件
+//
+
+#include "stdafx.h"
+#include "RedisBatchConsumer.h"
+
+// CRedisBatchConsumer
+
+CRedisBatchConsumer::CRedisBatchConsumer()
+{
+	m_pContext = NULL;
+	m_bPopRight = FALSE;
+}
+
+CRedisBatchConsumer::~CRedisBatchConsumer()
+{
+	Disconnect();
+}
+
+BOOL CRedisBatchConsumer::Connect(const char *szIP, int nPort)
+{
+	Disconnect();
+	struct timeval tv;
+	tv.tv_sec = REDIS_REPLY_TIMEOUT;
+	tv.tv_usec = 0;
+	redisContext *pContext = redisConnectWithTimeout(szIP, nPort, tv);
+	if (pContext == NULL)
+	{
+		return FALSE;
+	}
+	if (pContext->err)
+	{
+		redisFree(pContext);
+		return FALSE;
+	}
+	//阻塞取数时连接上长时间没有回复，读超时须比最长阻塞时间长，否则会被当成连接出错
+	if (redisSetTimeout(pContext, tv) != REDIS_OK)
+	{
+		redisFree(pContext);
+		return FALSE;
+	}
+	m_pContext = pContext;
+	return TRUE;
+}
+
+void CRedisBatchConsumer::Disconnect()
+{
+	ReleaseBatch();
+	if (m_pContext != NULL)
+	{
+		redisFree(m_pContext);
+		m_pContext = NULL;
+	}
+}
+
+//pReply为字符串时记为一条消息，nil(队列已空)忽略；其他类型说明命令出错
+BOOL CRedisBatchConsumer::AddMessage(redisReply *pReply)
+{
+	if (pReply->type == REDIS_REPLY_STRING)
+	{
+		m_vecMessages.push_back(pReply);
+		return TRUE;
+	}
+	return pReply->type == REDIS_REPLY_NIL;
+}
+
+int CRedisBatchConsumer::PopBatch(const char *szQueue, int nMaxCount, int nBlockSec)
+{
+	ReleaseBatch();
+	if (m_pContext == NULL)
+	{
+		return -1;
+	}
+	if (nMaxCount < 1)
+	{
+		nMaxCount = 1;
+	}
+	//LPOP逐条发出后一次读回，Redis 2.6的LPOP不支持一次取多条
+	const char *szPop = m_bPopRight ? "RPOP %s" : "LPOP %s";
+	for (int i=0; i<nMaxCount; i++)
+	{
+		redisAppendCommand(m_pContext, szPop, szQueue);
+	}
+	BOOL bOk = TRUE;
+	for (int i=0; i<nMaxCount; i++)
+	{
+		redisReply *pReply = NULL;
+		if (redisGetReply(m_pContext, (void**)&pReply) != REDIS_OK || pReply == NULL)
+		{
+			Disconnect();
+			return -1;
+		}
+		m_vecReplies.push_back(pReply);
+		if (!AddMessage(pReply))
+		{
+			bOk = FALSE;
+		}
+	}
+	if (!bOk)
+	{
+		Disconnect();
+		return -1;
+	}
+	if (!m_vecMessages.empty() || nBlockSec <= 0)
+	{
+		return (int)m_vecMessages.size();
+	}
+	if (nBlockSec > REDIS_BLOCK_MAX_SEC)
+	{
+		nBlockSec = REDIS_BLOCK_MAX_SEC;
+	}
+
+	//队列为空：阻塞等待下一条，超时返回nil；回复为[队列名,消息]
+	redisReply *pReply = (redisReply*)redisCommand(m_pContext, m_bPopRight ? "BRPOP %s %d" : "BLPOP %s %d", szQueue, nBlockSec);
+	if (pReply == NULL)
+	{
+		Disconnect();
+		return -1;
+	}
+	m_vecReplies.push_back(pReply);
+	if (pReply->type == REDIS_REPLY_ARRAY && pReply->elements == 2 && pReply->element[1]->type == REDIS_REPLY_STRING)
+	{
+		m_vecMessages.push_back(pReply->element[1]);
+	}
+	else if (pReply->type != REDIS_REPLY_NIL)
+	{
+		Disconnect();
+		return -1;
+	}
+	return (int)m_vecMessages.size();
+}
+
+const BYTE *CRedisBatchConsumer::GetMessage(int nIndex, int &nLen) const
+{
+	if (nIndex < 0 || nIndex >= (int)m_vecMessages.size())
+	{
+		nLen = 0;
+		return NULL;
+	}
+	nLen = m_vecMessages[nIndex]->len;
+	return (const BYTE*)m_vecMessages[nIndex]->str;
+}
+
+//从哪端取就放回哪端。LPUSH/RPUSH按参数顺序逐个放入，最后一个参数落在最外侧，所以倒序给出，一条命令放回整段
+BOOL CRedisBatchConsumer::PushBack(const char *szQueue, int nFrom)
+{
+	int nCount = (int)m_vecMessages.size();
+	if (nFrom < 0)
+	{
+		nFrom = 0;
+	}
+	if (nFrom >= nCount)
+	{
+		return TRUE;
+	}
+	if (m_pContext == NULL)
+	{
+		return FALSE;
+	}
+	std::vector<const char*> vecArgv;
+	std::vector<size_t> vecArgvLen;
+	vecArgv.push_back(m_bPopRight ? "RPUSH" : "LPUSH");
+	vecArgvLen.push_back(5);
+	vecArgv.push_back(szQueue);
+	vecArgvLen.push_back(strlen(szQueue));
+	for (int i=nCount-1; i>=nFrom; i--)
+	{
+		vecArgv.push_back(m_vecMessages[i]->str);
+		vecArgvLen.push_back(m_vecMessages[i]->len);
+	}
+	redisReply *pReply = (redisReply*)redisCommandArgv(m_pContext, (int)vecArgv.size(), &vecArgv[0], &vecArgvLen[0]);
+	if (pReply == NULL)
+	{
+		Disconnect();
+		return FALSE;
+	}
+	BOOL bOk = pReply->type == REDIS_REPLY_INTEGER;
+	freeReplyObject(pReply);
+	return bOk;
+}
+
+void CRedisBatchConsumer::ReleaseBatch()
+{
+	for (size_t i=0; i<m_vecReplies.size(); i++)
+	{
+		freeReplyObject(m_vecReplies[i]);
+	}
+	m_vecReplies.clear();
+	m_vecMessages.clear();
+}
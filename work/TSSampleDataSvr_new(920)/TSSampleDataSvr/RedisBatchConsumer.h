@@ -0,0 +1,49 @@
+#pragma once
+#include "hiredis.h"
+
+#define REDIS_BLOCK_MAX_SEC		5		//BLPOP最长阻塞时间(秒)
+#define REDIS_REPLY_TIMEOUT		10		//连接和读回复超时(秒)，须大于REDIS_BLOCK_MAX_SEC
+
+// CRedisBatchConsumer
+// 直接用hiredis从Redis列表批量取消息，供处理线程和分派线程替代逐条RecvMessageFromMsmq_Ext：
+// 队列有数据时一次往返流水线发出最多nMaxCount条LPOP；一条都没取到时改用BLPOP阻塞等待，
+// 有数据立即返回，不再按固定间隔轮询休眠。
+// 消息直接在hiredis回复中原地交给调用者处理，ReleaseBatch时统一释放，不再为每条消息另分配缓冲区并拷贝。
+// 回复数组在对象内复用，每个线程一个对象，不可跨线程使用。
+//
+// 用法：
+//	int nCount = Consumer.PopBatch("SampleMessage", 64, 1);
+//	for (int i=0; i<nCount; i++)
+//	{
+//		int nLen = 0;
+//		const BYTE *pMsg = Consumer.GetMessage(i, nLen);
+//	}
+//	Consumer.ReleaseBatch();
+
+class CRedisBatchConsumer
+{
+public:
+	CRedisBatchConsumer();
+	~CRedisBatchConsumer();
+
+	BOOL Connect(const char *szIP, int nPort);
+	void Disconnect();
+	BOOL IsConnected() const { return m_pContext != NULL; }
+	//取一批消息，返回条数；连接出错时断开并返回-1，由调用者重连
+	int PopBatch(const char *szQueue, int nMaxCount, int nBlockSec);
+	const BYTE *GetMessage(int nIndex, int &nLen) const;
+	//把本批第nFrom条及以后未处理的消息按原顺序放回队首，下次仍先取到；须在ReleaseBatch之前调用
+	BOOL PushBack(const char *szQueue, int nFrom);
+	void ReleaseBatch();
+public:
+	BOOL m_bPopRight;				//从列表右端取(RPOP/BRPOP)，与生产者LPUSH配合
+
+private:
+	CRedisBatchConsumer(const CRedisBatchConsumer&);
+	CRedisBatchConsumer& operator=(const CRedisBatchConsumer&);
+	BOOL AddMessage(redisReply *pReply);
+
+	redisContext *m_pContext;
+	std::vector<redisReply*> m_vecReplies;		//本批待释放的回复
+	std::vector<redisReply*> m_vecMessages;		//本批各条消息所在的字符串回复
+};
@@ -1,4 +1,4 @@
-// RedisRecvSample.cpp : ʵļ
+// RedisRecvSample.cpp : 实现文件
 //
 #pragma once
 #include "stdafx.h"
@@ -6,15 +6,26 @@
 #include "TSSampleDataSvr.h"
 #include "TSSampleDataSvrDlg.h"
 
+//设备信息查询的字段和关联表，全量加载和变化检测共用
+static const TCHAR C_SQL_DevInfo_Fields[] = _T("TB_DEVICE.ID,TB_DEVICE.DEVTYPE,pl.ID as plazaid,pl.CNAME as plazaname,TB_PAYMENT_ACCOUNT.ID as brandid,TB_PAYMENT_ACCOUNT.CNAME as brandname,rm.cname as roomname,TB_PAYMENT_ACCOUNT.NICKNAME");
+static const TCHAR C_SQL_DevInfo_From[] = _T("TB_DEVICE left join TB_PAYMENT_DEVICE_EX on TB_PAYMENT_DEVICE_EX.DEVICEID=TB_DEVICE.ID left JOIN TL_PAYMENT_ROOM ON TB_PAYMENT_DEVICE_EX.DEVICEID =TL_PAYMENT_ROOM.DEVICEID  left JOIN \
+TB_PAYMENT_ROOM rm on rm.ID=TL_PAYMENT_ROOM.ROOMID left JOIN TB_PAYMENT_ROOM pl on TB_PAYMENT_DEVICE_EX.PLAZAID=pl.ID  left JOIN TB_PAYMENT_ACCOUNT ON  rm.ACCOUNTID = TB_PAYMENT_ACCOUNT.ID");
+static const TCHAR C_SQL_DevInfo_Checksum[] = _T("TB_DEVICE.ID,TB_DEVICE.DEVTYPE,pl.ID,pl.CNAME,TB_PAYMENT_ACCOUNT.ID,TB_PAYMENT_ACCOUNT.CNAME,rm.cname,TB_PAYMENT_ACCOUNT.NICKNAME");
+
 // CRedisRecvSample
-CLog *g_log=NULL;
-CLog *DataTime_log=NULL;
+CAsyncLog *g_log=NULL;
+CAsyncLog *DataTime_log=NULL;
 IMPLEMENT_DYNCREATE(CRedisRecvSample, CWinThread)
 
 CRedisRecvSample::CRedisRecvSample()
 {
 	beInited = FALSE;
 	m_bAutoDelete = TRUE;
+	m_pDeviceInfoMap = NULL;
+	m_nDevInfoCount = 0;
+	m_nDevInfoChecksum = 0;
+	m_pLookupIndex = NULL;
+	m_pDevIndex = NULL;
 	MaxStationNum = 0;
 	m_bHasRegister = FALSE;
 	m_softbus = NULL;
@@ -29,13 +40,13 @@ CRedisRecvSample::CRedisRecvSample()
 	}
 	if(NULL==g_log)
 	{
-		g_log = new CLog(_T("\\TSSampleDataSvr"));
+		g_log = new CAsyncLog(_T("\\TSSampleDataSvr"));
 	}
 	InitCfgInfo();
-	InitializeCriticalSection(&m_csYmConfigDefMap);
 	InitializeCriticalSection(&m_csBillNum);
 	InitializeCriticalSection(&m_csDayTime);
 	InitializeCriticalSection(&m_csDevStateMap);
+	InitializeCriticalSection(&m_csDeviceRecord);
 	//InitializeCriticalSection(&m_csUpdateRTDB);
 
 }
@@ -93,6 +104,21 @@ CRedisRecvSample::~CRedisRecvSample()
 		delete m_softbus;
 		m_softbus = NULL;
 	}
+	if (m_pLookupIndex!=NULL)
+	{
+		delete m_pLookupIndex;
+		m_pLookupIndex = NULL;
+	}
+	if (m_pDevIndex!=NULL)
+	{
+		delete m_pDevIndex;
+		m_pDevIndex = NULL;
+	}
+	if (m_pDeviceInfoMap!=NULL)
+	{
+		delete m_pDeviceInfoMap;
+		m_pDeviceInfoMap = NULL;
+	}
 }
 
 BOOL CRedisRecvSample::ConnectRedisServer()
@@ -135,13 +161,13 @@ BOOL CRedisRecvSample::InitInstance()
 		//return FALSE;
 	}
 	ReguTrace(Config,"LoadAllForeignTable end!");
-	if (!GetDevInfo())
+	if (!RefreshDevInfo())
 	{
 		ReguTrace(Config,"GetDevInfo ERR!");
 		exit(0);
 		//return FALSE;
 	}
-	ReguTrace(Config,"GetDevInfo end!num=%d",m_DeviceInfoMap.GetSize());
+	ReguTrace(Config,"GetDevInfo end!num=%d",GetDeviceInfoCount());
 	//if(!ConnectRedisServer())
 	//{
 	//	ReguTrace(Config,"ConnectRedisServer err!");
@@ -149,7 +175,7 @@ BOOL CRedisRecvSample::InitInstance()
 	//	//return FALSE;
 	//}
 	//ReguTrace(Config,"ConnectRedisServer end!");
-	//NTS-9000\data_sql\2015-11-23ļвڣ򴴽
+	//如果NTS-9000\data_sql\2015-11-23文件夹不存在，则创建
 	if(m_strPath.IsEmpty()) 
 	{
 		TCHAR szDirectory[MAX_PATH];
@@ -177,30 +203,19 @@ BOOL CRedisRecvSample::InitInstance()
 	{
 		if (!CreateDirectory(m_strPath + sPath, NULL))
 		{
-			ReguTrace(ERRO,"ļг,path=%s!",m_strPath+sPath);
+			ReguTrace(ERRO,"创建文件夹出错,path=%s!",m_strPath+sPath);
 		}
 	}
 
 	beInited = TRUE;
-	BOOL bFlag = TRUE;
+	DWORD dwLastCheck = GetTickCount();
 	while(!theApp.bExitFlag)
 	{
-		SYSTEMTIME sys_time;
-		GetLocalTime(&sys_time);
-		if ((sys_time.wHour==22&&sys_time.wMinute==0&&bFlag)
-			||(sys_time.wHour==7&&sys_time.wMinute==0&&bFlag))
+		//定时比对设备信息校验和，有变化才重新加载
+		if (GetTickCount() - dwLastCheck >= DEVINFO_CHECK_INTERVAL)
 		{
-			if (!GetDevInfo())
-			{
-				ReguTrace(Config,"GetDevInfo ERR!");
-				continue;
-			}
-			ReguTrace(Config,"DevInfoɹ!num=%d",m_DeviceInfoMap.GetSize());
-			bFlag = FALSE;
-		}
-		if (sys_time.wHour==0&&sys_time.wMinute==0)
-		{
-			bFlag = TRUE;
+			RefreshDevInfo();
+			dwLastCheck = GetTickCount();
 		}
 		Sleep(10000);
 	}
@@ -222,7 +237,7 @@ BOOL CRedisRecvSample::InitInstance()
 				ReguTrace(Config,"GetDevInfo ERR!");
 				continue;
 			}
-			ReguTrace(Config,"DevInfoɹ!");
+			ReguTrace(Config,"更新DevInfo成功!");
 			bFlag = FALSE;
 		}
 		if (sys_time.wHour==0&&sys_time.wMinute==0)
@@ -231,18 +246,19 @@ BOOL CRedisRecvSample::InitInstance()
 		}
 		Sleep(1);
 	}*/
-	ReguTrace(ERRO,"whileѭ!");
+	ReguTrace(ERRO,"跳出while循环!");
 	return TRUE;
 }
 
 BOOL  CRedisRecvSample::GetDevInfo()
 {
-	m_DeviceInfoMap.RemoveAll();
-	int iFdCount = 8;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	//在新表中加载，成功后整体替换，加载过程中处理线程仍查旧表
+	DeviceInfoMap *pNewMap = new DeviceInfoMap;
+	pNewMap->InitHashTable(DEVINFO_HASH_SIZE);
+	int iFdCount = 8;	//	查询的字段数
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -250,6 +266,7 @@ BOOL  CRedisRecvSample::GetDevInfo()
 	if (hPipe == NULL) 
 	{
 		MYERROR(_T("GetPlazaId hPipe null"));
+		delete pNewMap;
 		return FALSE;
 	}
 
@@ -258,158 +275,154 @@ BOOL  CRedisRecvSample::GetDevInfo()
 	{
 		CString strQuery;
 		//strQuery.Format(_T("select top(10000) DEVICEID,b.ID,b.CNAME from TB_PAYMENT_DEVICE_EX a left join TB_PAYMENT_ROOM b on(a.PLAZAID=b.ID) where deviceid > %d order by deviceid; "),tempId);
-		strQuery.Format(_T("select top 5000 TB_DEVICE.ID,TB_DEVICE.DEVTYPE,pl.ID as plazaid,pl.CNAME as plazaname,TB_PAYMENT_ACCOUNT.ID as brandid,TB_PAYMENT_ACCOUNT.CNAME as brandname,rm.cname as roomname,TB_PAYMENT_ACCOUNT.NICKNAME \
-						   from TB_DEVICE left join TB_PAYMENT_DEVICE_EX on TB_PAYMENT_DEVICE_EX.DEVICEID=TB_DEVICE.ID left JOIN TL_PAYMENT_ROOM ON TB_PAYMENT_DEVICE_EX.DEVICEID =TL_PAYMENT_ROOM.DEVICEID  left JOIN \
-						   TB_PAYMENT_ROOM rm on rm.ID=TL_PAYMENT_ROOM.ROOMID left JOIN TB_PAYMENT_ROOM pl on TB_PAYMENT_DEVICE_EX.PLAZAID=pl.ID  left JOIN TB_PAYMENT_ACCOUNT ON  rm.ACCOUNTID = TB_PAYMENT_ACCOUNT.ID \
-						   where TB_DEVICE.ID > %d order by TB_DEVICE.ID;"),tempId);
+		strQuery.Format(_T("select top 5000 %s from %s where TB_DEVICE.ID > %d order by TB_DEVICE.ID;"),C_SQL_DevInfo_Fields,C_SQL_DevInfo_From,tempId);
 		pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-		if (NULL == pRead)	// δѯ¼
+		if (NULL == pRead)	// 未查询到记录
 		{
 			CloseHandle(hPipe);
+			delete pNewMap;
 			MYERROR(_T("GetPlazaId pRead null"));
 			return FALSE;
 		}
-		// صĽ
-		NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
-		if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-			//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			MYERROR(_T("GetPlazaId pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB null"));
-			return FALSE;
-		}	
-
-		if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
-		{
-			//MYWARN(_T("յջظģ޷ѯ"));
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			MYERROR(_T("GetPlazaId pNetMessageHead->Length < 1 null"));
-			return FALSE;
-		}
-
-		// ȡѯֶ
-		WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
-		int nFieldNum = (int)*pWord;
-		if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+		// 解析返回的结果，直接在接收缓冲区上按字段偏移读取
+		CRecordSetReader rs;
+		if (!rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), iFdCount))
 		{
-			//	MYWARN(_T("ѯֶȣѯ쳣˳"));
 			delete[] pRead;
 			pRead = NULL;
 			CloseHandle(hPipe);
-			MYERROR(_T("GetPlazaId nFieldNum != iFdCount null"));
+			delete pNewMap;
+			MYERROR(_T("GetPlazaId 返回记录集异常"));
 			return FALSE;
 		}
-		pWord++;
+		DWORD dwRecordNum = (DWORD)rs.GetRecordNum();
 
-		// ¼
-		MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
-		BYTE *pByte = (BYTE*)&pHead[nFieldNum];
-		DWORD dwRecordLen = *((DWORD*)pByte);
-		if (dwRecordLen < 1)
-		{
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return FALSE;
-		}
-		pByte += sizeof(DWORD);
-
-		// ¼
-		DWORD dwRecordNum = *((int*)pByte);
-		if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
-		{
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return FALSE;
-		}
-		pByte += sizeof(DWORD);
-
-		TCHAR *tValue = new TCHAR[1024+1];
-		if (tValue == NULL)
-		{
-			//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
-			MYERROR(_T("GetPlazaId tValue == NULL"));
-			delete[] pRead;
-			pRead = NULL;
-			CloseHandle(hPipe);
-			return FALSE;
-		}
-
-		// ѯд뵽
-		for (int i=0;i<(int)dwRecordNum;i++)
+		// 将查询结果写入到缓存
+		while (rs.NextRecord())
 		{
 			DeviceInfo iDeviceInfo;
 			memset(&iDeviceInfo,0,sizeof(DeviceInfo));
 
-			// iDevId
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, pHead->DataLen);
-			iDeviceInfo.iDevId = (int)*((DWORD *)tValue);
-			pByte += pHead->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+1)->DataLen);
-			iDeviceInfo.iDevType = (int)*((DWORD *)tValue);
-			pByte += (pHead+1)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+2)->DataLen);
-			iDeviceInfo.iPlazaId = (int)*(DWORD*)tValue;
-			pByte += (pHead+2)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+3)->DataLen);
-			memcpy(iDeviceInfo.PlazaName, tValue, sizeof(TCHAR)*128);
-			pByte += (pHead+3)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+4)->DataLen);
-			iDeviceInfo.iBrandId = (int)*(DWORD*)tValue;
-			pByte += (pHead+4)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+5)->DataLen);
-			CString csBrand = _T("");
-			csBrand.Format(_T("%s"),tValue);
-			csBrand.Replace(_T("'"),_T("\""));
-			memcpy(iDeviceInfo.BrandName, csBrand.GetBuffer(), sizeof(TCHAR)*csBrand.GetLength());
-			pByte += (pHead+5)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+6)->DataLen);
-			memcpy(iDeviceInfo.RoomName, tValue, sizeof(TCHAR)*128);
-			pByte += (pHead+6)->DataLen;
-
-			ZeroMemory(tValue,1024+1);
-			memcpy(tValue, pByte, (pHead+7)->DataLen);
-			memcpy(iDeviceInfo.NickName, tValue, sizeof(TCHAR)*600);
-			pByte += (pHead+7)->DataLen;
+			iDeviceInfo.iDevId = rs.GetInt(0);
+			iDeviceInfo.iDevType = rs.GetInt(1);
+			iDeviceInfo.iPlazaId = rs.GetInt(2);
+			rs.GetString(3, iDeviceInfo.PlazaName, 128);
+			iDeviceInfo.iBrandId = rs.GetInt(4);
+			rs.GetString(5, iDeviceInfo.BrandName, 128);
+			for (TCHAR *p = iDeviceInfo.BrandName; *p; p++)
+			{
+				if (*p == _T('\''))
+				{
+					*p = _T('"');
+				}
+			}
+			rs.GetString(6, iDeviceInfo.RoomName, 128);
+			rs.GetString(7, iDeviceInfo.NickName, 600);
 
 			if (iDeviceInfo.iDevId>tempId)
 			{
 				tempId = iDeviceInfo.iDevId;
 			}
-			m_DeviceInfoMap.SetAt(iDeviceInfo.iDevId,iDeviceInfo);
+			pNewMap->SetAt(iDeviceInfo.iDevId,iDeviceInfo);
 		}
-		delete []tValue;
-		tValue = NULL;
+		delete[] pRead;
+		pRead = NULL;
 		if (dwRecordNum<5000)
 		{
 			break;
 		}
 	}
 
-	int num = m_DeviceInfoMap.GetSize();
+	CloseHandle(hPipe);
+
+	DeviceInfoMap *pOldMap = (DeviceInfoMap*)InterlockedExchangePointer((PVOID volatile*)&m_pDeviceInfoMap, pNewMap);
+	//等正在查旧表的处理线程读完再释放
+	m_ReadEpoch.Synchronize();
+	if (pOldMap != NULL)
+	{
+		delete pOldMap;
+	}
+
+	return TRUE;
+}
 
-	delete[] pRead;
-	pRead = NULL;
+BOOL CRedisRecvSample::GetDeviceInfo(int nDevId, DeviceInfo &iDeviceInfo)
+{
+	LONG nIdx = m_ReadEpoch.ReadLock();
+	DeviceInfoMap *pMap = m_pDeviceInfoMap;
+	BOOL bFound = pMap != NULL && pMap->Lookup(nDevId, iDeviceInfo);
+	m_ReadEpoch.ReadUnlock(nIdx);
+	return bFound;
+}
+
+int CRedisRecvSample::GetDeviceInfoCount()
+{
+	LONG nIdx = m_ReadEpoch.ReadLock();
+	DeviceInfoMap *pMap = m_pDeviceInfoMap;
+	int nCount = pMap != NULL ? (int)pMap->GetCount() : 0;
+	m_ReadEpoch.ReadUnlock(nIdx);
+	return nCount;
+}
+
+//查询设备信息的记录数和校验和，用于判断设备、广场、商户信息是否有变化
+BOOL CRedisRecvSample::GetDevInfoVersion(int &nCount, int &nChecksum)
+{
+	nCount = 0;
+	nChecksum = 0;
+	HANDLE hPipe = OpenRealDataPipe();
+	if (hPipe == NULL)
+	{
+		return FALSE;
+	}
+	CString strQuery;
+	strQuery.Format(_T("select count(*),isnull(CHECKSUM_AGG(BINARY_CHECKSUM(%s)),0) from %s;"),C_SQL_DevInfo_Checksum,C_SQL_DevInfo_From);
+	BYTE* pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 	CloseHandle(hPipe);
+	if (NULL == pRead)
+	{
+		return FALSE;
+	}
+	//报文类型、字段数和长度都由CRecordSetReader校验，结果只有一行两个整型字段
+	CRecordSetReader rs;
+	BOOL bOk = rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), 2) && rs.GetRecordNum() == 1 && rs.NextRecord();
+	if (bOk)
+	{
+		nCount = rs.GetInt(0);
+		nChecksum = rs.GetInt(1);
+	}
+	delete[] pRead;
+	return bOk;
+}
 
+//设备信息有变化时才重新加载
+BOOL CRedisRecvSample::RefreshDevInfo()
+{
+	int nCount = 0, nChecksum = 0;
+	if (!GetDevInfoVersion(nCount, nChecksum))
+	{
+		ReguTrace(ERRO,"GetDevInfoVersion ERR!");
+		return FALSE;
+	}
+	if (m_pDeviceInfoMap != NULL && nCount == m_nDevInfoCount && nChecksum == m_nDevInfoChecksum)
+	{
+		return TRUE;
+	}
+	DWORD dwBegin = GetTickCount();
+	//启动时设备表已由LoadAllForeignTable加载，之后设备有增删改时同设备信息一起重新加载
+	if (m_pDeviceInfoMap != NULL && !ReloadDeviceTable())
+	{
+		ReguTrace(ERRO,"ReloadDeviceTable ERR!");
+		return FALSE;
+	}
+	if (!GetDevInfo())
+	{
+		ReguTrace(ERRO,"GetDevInfo ERR!");
+		return FALSE;
+	}
+	m_nDevInfoCount = nCount;
+	m_nDevInfoChecksum = nChecksum;
+	ReguTrace(Config,"更新DevInfo成功!num=%d,耗时%dms",GetDeviceInfoCount(),GetTickCount()-dwBegin);
 	return TRUE;
 }
 
@@ -437,7 +450,7 @@ BOOL CRedisRecvSample::GetDataFromRedis()
 	}
 	else if (REDIS_OK == ret)
 	{
-		//ReguTrace(Config,"յʼ:%s",bufToHexString(buffer,100).c_str());
+		//ReguTrace(Config,"收到初始报文:%s",bufToHexString(buffer,100).c_str());
 		CString recvstr = _T("");
 		if (NULL == buffer)
 		{
@@ -446,12 +459,12 @@ BOOL CRedisRecvSample::GetDataFromRedis()
 		}
 		BYTE * pBuf = (BYTE*)buffer;
 		int index = 0;
-		//srand(time(0));  //ʱӣʹÿ漴ֲһ
+		//srand(time(0));  //用时间作种子，使每次随即的数字不一样
 		index = rand()%10;
 		EnterCriticalSection(&pDlg->m_pCProcessThread[index]->m_csRedisDataList);
 		pDlg->m_pCProcessThread[index]->m_RedisDataList.AddTail(pBuf);
 		LeaveCriticalSection(&pDlg->m_pCProcessThread[index]->m_csRedisDataList);
-		ReguTrace(Config,"͸߳%d:%s",index,bufToHexString(buffer,100).c_str());
+		ReguTrace(Config,"发送给线程%d:%s",index,bufToHexString(buffer,100).c_str());
 		SetEvent(pDlg->m_pCProcessThread[index]->m_ProcessDataEvent);
 /*
 		SocketMsgHead* pHead = (SocketMsgHead*)(pBuf+ sizeof(NetMessageHead));
@@ -463,15 +476,15 @@ BOOL CRedisRecvSample::GetDataFromRedis()
 		switch(pHead->btType)
 		{
 		case SOCKET_MSG_GROUP_YXDATA:
-			ReguTrace(Config,"յYX:%s",bufToHexString(pMsg,len).c_str());
+			ReguTrace(Config,"收到YX报文:%s",bufToHexString(pMsg,len).c_str());
 			//OnSocketMsgGroupYx((SocketMsgGroupYxEx*)pMsg);
 			break;
 		case SOCKET_MSG_GROUP_YMDATA_EX_DATE:
-			ReguTrace(Config,"յYM:%s",bufToHexString(pMsg,len).c_str());
+			ReguTrace(Config,"收到YM报文:%s",bufToHexString(pMsg,len).c_str());
 			//StartProcessData((SocketMsgGroupYmDataEx_DATE*)pMsg);
 			break;
 		case SOCKET_MSG_PREPAYRECORD:
-			ReguTrace(Config,"յPAYRECORD:%s",bufToHexString(pMsg,len).c_str());
+			ReguTrace(Config,"收到PAYRECORD报文:%s",bufToHexString(pMsg,len).c_str());
 			//OnCallPrePayRecord((SocketMsgPrepayRecord*)pMsg);
 			break;
 		default:
@@ -511,7 +524,7 @@ BOOL CRedisRecvSample::GetDataFromRedis()
 //	{
 //		nRtuNo = pMsgPrepayRecordData->btForeNo * 256 + pMsgPrepayRecordData->btRtuNo;
 //	}*/
-//	int nDevNo = pMsgPrepayRecordData->nDevNo;  //ǰ豸
+//	int nDevNo = pMsgPrepayRecordData->nDevNo;  //前置设备号
 //	int nDevId = 0;
 //	GetDevId(nRtuNo,pMsgPrepayRecordData->nDevNo,nDevId);
 //	if(nDevId==0)
@@ -543,13 +556,13 @@ BOOL CRedisRecvSample::GetDataFromRedis()
 //		{
 //			timestr.Format(_T("20%02d-%02d-%02d %02d:%02d:00"),iyear,imonth,iday,ihour,iminite);
 //		}
-//		int nTotalBuyCount = 0; //һγֵܹ
+//		int nTotalBuyCount = 0; //上一次充值后的总购电次数
 //		nTotalBuyCount = pRecordUnit->nTotalPercNum;
-//		float nBuyFee = 0;  //γֵ
+//		float nBuyFee = 0;  //本次充值金额
 //		nBuyFee = pRecordUnit->nPercFee*0.01;
-//		float nBefReminAmount = 0; //γֵǰʣ
-//		float nAftReminAmount = 0; //γֵʣ
-//		float nTotalFee = 0;   //ܹ
+//		float nBefReminAmount = 0; //本次充值前剩余金额
+//		float nAftReminAmount = 0; //本次充值后剩余金额
+//		float nTotalFee = 0;   //总购电金额
 //		nBefReminAmount = pRecordUnit->nBefPercFee*0.01;
 //		nAftReminAmount = pRecordUnit->nAftPercFee*0.01;
 //		nTotalFee = pRecordUnit->nTotalPercFee*0.01;
@@ -623,7 +636,7 @@ BOOL CRedisRecvSample::GetDataFromRedis()
 //		//	hPipe = OpenServerPipe();
 //		//}
 //		//CString TempSql = _T("");
-//		//TempSql.Format(_T("UPDATE TB_DI SET YXVALUE=%d WHERE DEVICENUM=%d AND NUM=%d; "),YxUnit->Value,DevId,YxUnit->Id);  //TB_DIеDEVICENUMΪ豸һ
+//		//TempSql.Format(_T("UPDATE TB_DI SET YXVALUE=%d WHERE DEVICENUM=%d AND NUM=%d; "),YxUnit->Value,DevId,YxUnit->Id);  //TB_DI表中的DEVICENUM为设备表第一列
 //		//UpdateSql += TempSql;
 //		//icount++;
 //		//if (icount%SQL_COUNT_ONCE!=0 && i!=pMsgGroupYxData->wdYxNum - 1)
@@ -650,7 +663,7 @@ BOOL CRedisRecvSample::GetDataFromRedis()
 
 BOOL CRedisRecvSample::GetDevId(short nRtu, int DeviceNo, int &DevId)
 {
-	//ͨRtuҵվID
+	//通过Rtu号找到厂站ID
 	/*StationDefMap::iterator its;
 	its = m_StationDefMap.find(nRtu);
 	if (its == m_StationDefMap.end())
@@ -658,18 +671,16 @@ BOOL CRedisRecvSample::GetDevId(short nRtu, int DeviceNo, int &DevId)
 		return FALSE;
 	}*/  //GUOJ DEL 151022
 
-	//ͨվIDǰ豸ҵ豸ID
-	CString key = _T("");
-	key.Format(_T("%d+%d"), nRtu, DeviceNo);
-	DeviceRecordDefMap::iterator itd;
-	itd = m_DeviceRecordDefMap.find(key);
-	if (itd == m_DeviceRecordDefMap.end())
+	//通过厂站ID和前置设备号找到设备ID
+	LONG nIdx = m_ReadEpoch.ReadLock();
+	CDevLookupIndex *pIndex = m_pDevIndex;
+	BOOL bFound = pIndex != NULL && pIndex->GetDevId(nRtu, DeviceNo, DevId);
+	m_ReadEpoch.ReadUnlock(nIdx);
+	if (!bFound)
 	{
 		return FALSE;
 	}
-
-	DevId = itd->second;
-	//Ǽģʽ豸ӳ  //ZHOUN 140909 ADD
+	//如是集中器模式，则需进行设备映射  //ZHOUN 140909 ADD
 	//int nDevID = 0, nDev3YNum = 0;
 	/*int nDev3YNum = 0;
 	if (GetDeviceInfoByCollectorInfo(itd->second.nID, YxUnit->Id, DevId, nDev3YNum))
@@ -686,15 +697,40 @@ BOOL CRedisRecvSample::GetDevId(short nRtu, int DeviceNo, int &DevId)
 		DevId = itd->second.nID;
 		nDev3YNum = YxUnit->Id;
 	}*/
+	return TRUE;
+}
 
+//同一报文的所有单元在同一份索引快照上解析设备ID
+int CRedisRecvSample::GetDevIds(short nRtu, const int *pDevNo, int nCount, int *pDevId)
+{
+	LONG nIdx = m_ReadEpoch.ReadLock();
+	CDevLookupIndex *pIndex = m_pDevIndex;
+	int nFound = 0;
+	if (pIndex == NULL)
+	{
+		memset(pDevId, 0, sizeof(int)*nCount);
+	}
+	else
+	{
+		nFound = pIndex->GetDevIds(nRtu, pDevNo, nCount, pDevId);
+	}
+	m_ReadEpoch.ReadUnlock(nIdx);
+	return nFound;
 }
 
 BOOL CRedisRecvSample::GetYmDefByPowInfo(short nRtu, const PowFileInfo *pPowInfo, SimpleYmDef &ymDef, int &iDevId)
 {
 	memset(&ymDef, 0, sizeof(SimpleYmDef));
-	CString key = _T("");
+	LONG nIdx = m_ReadEpoch.ReadLock();
+	CYmLookupIndex *pIndex = m_pLookupIndex;
+	CDevLookupIndex *pDevIndex = m_pDevIndex;
+	if (pIndex == NULL || pDevIndex == NULL)
+	{
+		m_ReadEpoch.ReadUnlock(nIdx);
+		return FALSE;
+	}
 
-	//ͨRtuҵվID
+	//通过Rtu号找到厂站ID
 	/*StationDefMap::iterator its;
 	its = m_StationDefMap.find(nRtu);
 	if (its == m_StationDefMap.end())
@@ -702,18 +738,17 @@ BOOL CRedisRecvSample::GetYmDefByPowInfo(short nRtu, const PowFileInfo *pPowInfo
 		return FALSE;
 	}*/
 
-	//ͨվIDǰ豸ҵ豸ID
+	//通过厂站ID和前置设备号找到设备ID
 	//key.Format(_T("%d+%d"), its->second.nStationNum, pPowInfo->nDevID);
-	key.Format(_T("%d+%d"), nRtu, pPowInfo->nDevID);  //GUOJ MOD 151022
-	DeviceRecordDefMap::iterator itd;
-	itd = m_DeviceRecordDefMap.find(key);
-	if (itd == m_DeviceRecordDefMap.end())
+	//key.Format(_T("%d+%d"), nRtu, pPowInfo->nDevID);  //GUOJ MOD 151022
+	int nDevID = 0, nDev3YNum = 0;
+	if (!pDevIndex->GetDevId(nRtu, pPowInfo->nDevID, nDevID))
 	{
+		m_ReadEpoch.ReadUnlock(nIdx);
 		return FALSE;
 	}
 
-	////Ǽģʽ豸ӳ  //ZHOUN 140909 ADD
-	int nDevID = 0, nDev3YNum = 0;
+	////如是集中器模式，则需进行设备映射  //ZHOUN 140909 ADD
 	//if (GetDeviceInfoByCollectorInfo(itd->second.nID, pPowInfo->nYmNum, nDevID, nDev3YNum))
 	//{
 	//	DeviceRecordDefMap2::iterator itd2;
@@ -729,20 +764,78 @@ BOOL CRedisRecvSample::GetYmDefByPowInfo(short nRtu, const PowFileInfo *pPowInfo
 	//	nDev3YNum = pPowInfo->nYmNum;
 	//}//
 
-	nDevID = itd->second;
 	nDev3YNum = pPowInfo->nYmNum;
 	iDevId = nDevID;
-	//ͨ豸IDңҵӦң¼
-	key.Format(_T("%d+%d"), nDevID, nDev3YNum);
-	YmConfigDefMap::iterator itym;	
-	itym = m_YmConfigDefMap.find(key);
-	if (itym == m_YmConfigDefMap.end())
+	//通过设备ID和遥脉序号找到对应的遥脉记录
+	BOOL bFound = pIndex->GetYmDef(nDevID, nDev3YNum, ymDef);
+	m_ReadEpoch.ReadUnlock(nIdx);
+	return bFound;
+}
+
+BOOL CRedisRecvSample::GetYmDef(int nDevId, int nYmNum, SimpleYmDef &ymDef)
+{
+	LONG nIdx = m_ReadEpoch.ReadLock();
+	CYmLookupIndex *pIndex = m_pLookupIndex;
+	BOOL bFound = pIndex != NULL && pIndex->GetYmDef(nDevId, nYmNum, ymDef);
+	m_ReadEpoch.ReadUnlock(nIdx);
+	return bFound;
+}
+
+BOOL CRedisRecvSample::UpdateYmDef(const SimpleYmDef &ymDef)
+{
+	LONG nIdx = m_ReadEpoch.ReadLock();
+	CYmLookupIndex *pIndex = m_pLookupIndex;
+	BOOL bFound = pIndex != NULL && pIndex->UpdateYmDef(ymDef);
+	m_ReadEpoch.ReadUnlock(nIdx);
+	return bFound;
+}
+
+BOOL CRedisRecvSample::GetSampleNo(int SampleTableNo, int nTableNo, int nIndex, int &SampleNo)
+{
+	LONG nIdx = m_ReadEpoch.ReadLock();
+	CYmLookupIndex *pIndex = m_pLookupIndex;
+	BOOL bFound = pIndex != NULL && pIndex->GetSampleNo(SampleTableNo, nTableNo, nIndex, SampleNo);
+	m_ReadEpoch.ReadUnlock(nIdx);
+	return bFound;
+}
+
+//由m_YmConfigDefMap/m_MapSampleNo建立新的整型键索引并整体替换当前快照。
+//处理线程只在单次查找期间登记为读者，替换后等它们退出即释放旧快照
+void CRedisRecvSample::PublishLookupIndex()
+{
+	CYmLookupIndex *pNewIndex = new CYmLookupIndex;
+	pNewIndex->Build(m_YmConfigDefMap, m_MapSampleNo, m_pLookupIndex);
+	CYmLookupIndex *pOldIndex = (CYmLookupIndex*)InterlockedExchangePointer((PVOID volatile*)&m_pLookupIndex, pNewIndex);
+	m_ReadEpoch.Synchronize();
+	if (pOldIndex != NULL)
 	{
-		return FALSE;
+		delete pOldIndex;
 	}
+	ReguTrace(Config,"PublishLookupIndex end! ym=%d",pNewIndex->GetYmCount());
+}
 
-	ymDef = itym->second;
-	return TRUE;
+//由m_DeviceRecordDefMap建立设备索引并整体替换，释放规则与PublishLookupIndex相同
+void CRedisRecvSample::PublishDevIndex()
+{
+	CDevLookupIndex *pNewIndex = new CDevLookupIndex;
+	EnterCriticalSection(&m_csDeviceRecord);
+	pNewIndex->Build(m_DeviceRecordDefMap);
+	LeaveCriticalSection(&m_csDeviceRecord);
+	CDevLookupIndex *pOldIndex = (CDevLookupIndex*)InterlockedExchangePointer((PVOID volatile*)&m_pDevIndex, pNewIndex);
+	m_ReadEpoch.Synchronize();
+	if (pOldIndex != NULL)
+	{
+		delete pOldIndex;
+	}
+	ReguTrace(Config,"PublishDevIndex end! dev=%d",pNewIndex->GetCount());
+}
+
+//设备信息变化后重新加载设备表；厂站表只在加载设备表期间使用，用完清空
+BOOL CRedisRecvSample::ReloadDeviceTable()
+{
+	BOOL bOk = LoadStationTable() && LoadDeviceTable();
+	m_StationDefMap.clear();
+	return bOk;
 }
 
 BOOL CRedisRecvSample::GetDeviceInfoByCollectorInfo(int nCollectorID, int nCollector3YNum, int &nDevID, int &nDev3YNum)
@@ -758,7 +851,7 @@ BOOL CRedisRecvSample::GetDeviceInfoByCollectorInfo(int nCollectorID, int nColle
 	}
 
 	val = itcm->second;
-	nDevID = ((unsigned __int64)val >> 32) & 0xFFFF;        //ת޷int64ƴλ
+	nDevID = ((unsigned __int64)val >> 32) & 0xFFFF;        //转换成无符号int64以免引发右移带出符号位的隐患
 	nDev3YNum = val & 0xFFFF;
 
 	return TRUE;
@@ -805,20 +898,24 @@ BOOL CRedisRecvSample::LoadAllForeignTable()
 		return FALSE;
 	}*/
 	ReguTrace(Config,"LoadSampleExtTable end! num=%d",m_MapSampleNo.size());
+	PublishLookupIndex();
+	//遥脉和采样序号只通过索引快照查找，建好后清空map，减少内存
+	m_YmConfigDefMap.clear();
+	m_MapSampleNo.clear();
 	if (!LoadYxTable())
 	{
 		ReguTrace(Config,"LoadYxTable err!");
 		return FALSE;
 	}
 	ReguTrace(Config,"LoadYxTable end! num=%d",m_DevStateMap.GetSize());
-	m_StationDefMap.clear();     //ѳվգڴ档
+	m_StationDefMap.clear();     //把厂站配置清空，减少内存。
 	return TRUE;
 }
 
 BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 {
 	CString strKey = _T("");
-	int iFdCount = 3;	//	ѯֶ
+	int iFdCount = 3;	//	查询的字段数
 	CString TableName = _T("TB_SAMPLEHOUR_EXT");
 	if(SampleTableNo==TABLE_NO_SAMPLEDAY_EXT)
 	{
@@ -843,9 +940,9 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 		sql.Format(_T("SELECT TOP 5000 SAMPLENO,TABLENO,RECORDNO FROM %s where SAMPLENO>'%d' order by SAMPLENO"),TableName,tempSampleId);
 		//sql.Format(_T("SELECT TOP 1 SAMPLENO,TABLENO,RECORDNO FROM %s where SAMPLENO>'%d' order by SAMPLENO"),TableName,tempSampleId);
 		BYTE* pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,sql);
-		if (NULL == pRead)	// δѯ¼
+		if (NULL == pRead)	// 未查询到记录
 		{
-			MYERROR(_T("ѯ쳣ϵͳ̨ûӦ룺%d"),GetLastError());
+			MYERROR(_T("查询异常，系统后台没有响应，错误码：%d"),GetLastError());
 			if (hPipe)
 			{
 				CloseHandle(hPipe);
@@ -853,10 +950,10 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 			}
 			return FALSE;
 		}
-		// صĽ
+		// 解析返回的结果
 		NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 		if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-			//MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+			//MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 			delete[] pRead;
 			pRead = NULL;
 
@@ -868,9 +965,9 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 			return FALSE;
 		}
 
-		if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+		if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 		{
-			//MYWARN(_T("ձģ޲ѯ"));
+			//MYWARN(_T("空报文，无查询结果"));
 			delete[] pRead;
 			pRead = NULL;
 			if (hPipe)
@@ -882,12 +979,12 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 			return FALSE;
 		}
 
-		// ȡѯֶ
+		// 获取查询的字段数
 		WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 		int nFieldNum = (int)*pWord;
-		if (nFieldNum != iFdCount)   //Ҫݲѯֶ޸
+		if (nFieldNum != iFdCount)   //需要根据查询出的字段数修改
 		{
-			//MYWARN(_T("ѯзصֶȷ[nFieldNum=%d]"),nFieldNum);
+			//MYWARN(_T("查询结果报文中返回的字段数不正确[nFieldNum=%d]"),nFieldNum);
 			delete[] pRead;
 			pRead = NULL;
 			if (hPipe)
@@ -899,13 +996,13 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 		}
 		pWord++;
 
-		// ¼
+		// 记录集长度
 		MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 		BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 		DWORD dwRecordLen = *((DWORD*)pByte);
 		if (dwRecordLen < 0)
 		{
-			//MYWARN(_T("ѯзصļ¼Ȳȷ[dwRecordLen=%d]"),dwRecordLen);
+			//MYWARN(_T("查询结果报文中返回的记录集长度不正确[dwRecordLen=%d]"),dwRecordLen);
 			delete[] pRead;
 			pRead = NULL;
 			if (hPipe)
@@ -917,7 +1014,7 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 		}
 		pByte += sizeof(DWORD);
 
-		// ¼
+		// 记录数
 		DWORD dwRecordNum = *((int*)pByte);
 		if (dwRecordNum < 0)
 		{
@@ -936,7 +1033,7 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 		TCHAR *tValue = new TCHAR[1024+1];
 		if (tValue == NULL)
 		{
-			//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
+			//MYERROR(_T("分配内存错误，错误码：%d"),GetLastError());
 			//MYERROR(_T("GetPlazaId tValue == NULL"));
 			delete[] pRead;
 			pRead = NULL;
@@ -948,7 +1045,7 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 			return FALSE;
 		}
 
-		// ѯд뵽
+		// 将查询结果写入到缓存
 		for (int i=0;i<(int)dwRecordNum;i++)
 		{
 			ZeroMemory(tValue,1024+1);
@@ -966,7 +1063,7 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 			int n3YIndex = (int)*(DWORD*)tValue;
 			pByte += (pHead+2)->DataLen;
 
-			strKey.Format(_T("%d+%d+%d"), SampleTableNo, nTableNo, n3YIndex);	//keyΪ+ң+ңš
+			strKey.Format(_T("%d+%d+%d"), SampleTableNo, nTableNo, n3YIndex);	//key为“采样表号+三遥表号+三遥序号”
 			m_MapSampleNo[strKey] = SampleNo;
 			if (SampleNo>tempSampleId)
 			{
@@ -995,7 +1092,7 @@ BOOL CRedisRecvSample::LoadSampleExtTable(WORD SampleTableNo)
 BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 {
 	CString strKey = _T("");
-	int iFdCount = 2;	//	ѯֶ
+	int iFdCount = 2;	//	查询的字段数
 	CString TableName = _T("TB_SAMPLEHOUR");
 	if(SampleTableNo==TABLE_NO_SAMPLEDAY)
 	{
@@ -1020,9 +1117,9 @@ BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 		sql.Format(_T("SELECT TOP 5000 ID,DATASOURCE FROM %s where ID>'%d' order by ID"),TableName,tempSampleId);
 		//sql.Format(_T("SELECT TOP 1 SAMPLENO,TABLENO,RECORDNO FROM %s where SAMPLENO>'%d' order by SAMPLENO"),TableName,tempSampleId);
 		BYTE* pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,sql);
-		if (NULL == pRead)	// δѯ¼
+		if (NULL == pRead)	// 未查询到记录
 		{
-			MYERROR(_T("ѯ쳣ϵͳ̨ûӦ룺%d"),GetLastError());
+			MYERROR(_T("查询异常，系统后台没有响应，错误码：%d"),GetLastError());
 			if (hPipe)
 			{
 				CloseHandle(hPipe);
@@ -1030,10 +1127,10 @@ BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 			}
 			return FALSE;
 		}
-		// صĽ
+		// 解析返回的结果
 		NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 		if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-			//MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+			//MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 			delete[] pRead;
 			pRead = NULL;
 
@@ -1045,9 +1142,9 @@ BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 			return FALSE;
 		}
 
-		if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+		if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 		{
-			//MYWARN(_T("ձģ޲ѯ"));
+			//MYWARN(_T("空报文，无查询结果"));
 			delete[] pRead;
 			pRead = NULL;
 			if (hPipe)
@@ -1059,12 +1156,12 @@ BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 			return FALSE;
 		}
 
-		// ȡѯֶ
+		// 获取查询的字段数
 		WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 		int nFieldNum = (int)*pWord;
-		if (nFieldNum != iFdCount)   //Ҫݲѯֶ޸
+		if (nFieldNum != iFdCount)   //需要根据查询出的字段数修改
 		{
-			//MYWARN(_T("ѯзصֶȷ[nFieldNum=%d]"),nFieldNum);
+			//MYWARN(_T("查询结果报文中返回的字段数不正确[nFieldNum=%d]"),nFieldNum);
 			delete[] pRead;
 			pRead = NULL;
 			if (hPipe)
@@ -1076,13 +1173,13 @@ BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 		}
 		pWord++;
 
-		// ¼
+		// 记录集长度
 		MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 		BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 		DWORD dwRecordLen = *((DWORD*)pByte);
 		if (dwRecordLen < 0)
 		{
-			//MYWARN(_T("ѯзصļ¼Ȳȷ[dwRecordLen=%d]"),dwRecordLen);
+			//MYWARN(_T("查询结果报文中返回的记录集长度不正确[dwRecordLen=%d]"),dwRecordLen);
 			delete[] pRead;
 			pRead = NULL;
 			if (hPipe)
@@ -1094,7 +1191,7 @@ BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 		}
 		pByte += sizeof(DWORD);
 
-		// ¼
+		// 记录数
 		DWORD dwRecordNum = *((int*)pByte);
 		if (dwRecordNum < 0)
 		{
@@ -1113,7 +1210,7 @@ BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 		TCHAR *tValue = new TCHAR[1024+1];
 		if (tValue == NULL)
 		{
-			//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
+			//MYERROR(_T("分配内存错误，错误码：%d"),GetLastError());
 			//MYERROR(_T("GetPlazaId tValue == NULL"));
 			delete[] pRead;
 			pRead = NULL;
@@ -1125,7 +1222,7 @@ BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 			return FALSE;
 		}
 
-		// ѯд뵽
+		// 将查询结果写入到缓存
 		for (int i=0;i<(int)dwRecordNum;i++)
 		{
 			ZeroMemory(tValue,1024+1);
@@ -1139,7 +1236,7 @@ BOOL CRedisRecvSample::LoadSampleTable(WORD SampleTableNo)
 			pByte += (pHead+1)->DataLen;
 
 
-			strKey.Format(_T("%d+%d+%d"), SampleTableNo, TABLE_NO_PULSE, pIndex->RecordNo);	//keyΪ+ң+ңš
+			strKey.Format(_T("%d+%d+%d"), SampleTableNo, TABLE_NO_PULSE, pIndex->RecordNo);	//key为“采样表号+三遥表号+三遥序号”
 			m_MapSampleNo[strKey] = SampleNo;
 			if (SampleNo>tempSampleId)
 			{
@@ -1173,7 +1270,7 @@ BOOL CRedisRecvSample::LoadStationTable()
 	NetMessageHead* pNetMessageHead = NULL;
 	MessageQueryRecord mqr;
 
-	//ȡվϢ
+	//读取厂站信息表
 	mqr.BaseNo = BASE_NO_RTDB;
 	mqr.TableNo = TABLE_NO_STATION;
 	mqr.FilterFieldNo = 0;
@@ -1267,16 +1364,17 @@ BOOL CRedisRecvSample::LoadStationTable()
 		nNum--;
 	}
 
-	//
+	//清理
 	if(hPipe != NULL)			{CloseHandle(hPipe); hPipe = NULL;}
 	if(pNetMessageHead != NULL){delete [](BYTE *)pNetMessageHead; pNetMessageHead=NULL;}
 
 	return TRUE;
 }
 
+//设备表先加载到临时map，全部成功后整体替换m_DeviceRecordDefMap并发布设备索引，加载失败时保留旧表
 BOOL CRedisRecvSample::LoadDeviceTable()
 {
-	m_DeviceRecordDefMap.clear();
+	DeviceRecordDefMap NewDeviceMap;
 	//m_DeviceRecordDefMap2.clear();
 
 	CString strKey = _T("");
@@ -1303,7 +1401,7 @@ BOOL CRedisRecvSample::LoadDeviceTable()
 			iStationNum++;
 			continue;
 		}
-		//ȡ豸
+		//读取设备表
 		mqr.BaseNo = BASE_NO_RTDB;
 		mqr.TableNo = TABLE_NO_DEVICE;
 		mqr.FilterFieldNo = 6;
@@ -1368,22 +1466,29 @@ BOOL CRedisRecvSample::LoadDeviceTable()
 			}
 			memcpy(&DeviceRecord.nSysID,pBuf+nOffset,(pRetRecordHead+8+i)->DataLen);
 
-			strKey.Format(_T("%d+%d"), DeviceRecord.nStationNo, DeviceRecord.nDeviceNo);	//keyΪվID+ǰ豸š
-			m_DeviceRecordDefMap[strKey] = DeviceRecord.nID;
+			strKey.Format(_T("%d+%d"), DeviceRecord.nStationNo, DeviceRecord.nDeviceNo);	//key为“厂站ID+前置设备号”
+			NewDeviceMap[strKey] = DeviceRecord.nID;
 
-			//m_DeviceRecordDefMap2[DeviceRecord.nID] = DeviceRecord;	//keyΪ豸id
+			//m_DeviceRecordDefMap2[DeviceRecord.nID] = DeviceRecord;	//key为设备id
 
 			pBuf+=dwRecordLen;
 			nNum--;
 		}
 
+		//每个厂站一条返回报文，运行中会重复加载，逐条释放
+		delete [](BYTE *)pNetMessageHead;
+		pNetMessageHead = NULL;
 		iStationNum++;
 	}
 	
-	//
+	//清理
 	if(hPipe != NULL)			{CloseHandle(hPipe); hPipe = NULL;}
 	if(pNetMessageHead != NULL){delete [](BYTE *)pNetMessageHead; pNetMessageHead=NULL;}
 
+	EnterCriticalSection(&m_csDeviceRecord);
+	m_DeviceRecordDefMap.swap(NewDeviceMap);
+	LeaveCriticalSection(&m_csDeviceRecord);
+	PublishDevIndex();
 	return TRUE;
 }
 
@@ -1397,7 +1502,7 @@ BOOL CRedisRecvSample::LoadYxTable()
 	if (hPipe == NULL) {
 		return FALSE;
 	}
-	//ȡңϢ
+	//读取遥脉信息表
 	int iStationNum = 1;
 	while(1)
 	{
@@ -1480,17 +1585,17 @@ BOOL CRedisRecvSample::LoadYxTable()
 
 		iStationNum++;
 	}
-	//
+	//清理
 	if(hPipe != NULL)			{CloseHandle(hPipe); hPipe = NULL;}
 	if(pNetMessageHead != NULL){delete [](BYTE *)pNetMessageHead; pNetMessageHead=NULL;}
 
 	return TRUE;
 
-	//int iFdCount = 2;	//	ѯֶ
-	//int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	//int iFdCount = 2;	//	查询的字段数
+	//int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 
 
-	//// ݹܵSQL
+	//// 向数据管道发送SQL语句
 	//BYTE* pRead = NULL;
 
 	//HANDLE hPipe =OpenRealDataPipe();
@@ -1508,16 +1613,16 @@ BOOL CRedisRecvSample::LoadYxTable()
 	//	strQuery.Format(_T("SELECT top 5000 DEVICENUM,YXVALUE FROM TB_DI WHERE NUM=0 AND DEVICENUM > %d order by DEVICENUM;"),tempId);
 	//	pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-	//	if (NULL == pRead)	// δѯ¼
+	//	if (NULL == pRead)	// 未查询到记录
 	//	{
 	//		CloseHandle(hPipe);
 	//		MYERROR(_T("GetPlazaId pRead null"));
 	//		return FALSE;
 	//	}
-	//	// صĽ
+	//	// 解析返回的结果
 	//	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 	//	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-	//		//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+	//		//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 	//		delete[] pRead;
 	//		pRead = NULL;
 	//		CloseHandle(hPipe);
@@ -1525,9 +1630,9 @@ BOOL CRedisRecvSample::LoadYxTable()
 	//		return FALSE;
 	//	}	
 
-	//	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+	//	if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 	//	{
-	//		//MYWARN(_T("յջظģ޷ѯ"));
+	//		//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 	//		delete[] pRead;
 	//		pRead = NULL;
 	//		CloseHandle(hPipe);
@@ -1535,12 +1640,12 @@ BOOL CRedisRecvSample::LoadYxTable()
 	//		return FALSE;
 	//	}
 
-	//	// ȡѯֶ
+	//	// 获取查询的字段数
 	//	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 	//	int nFieldNum = (int)*pWord;
-	//	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	//	if (nFieldNum != iFdCount)	// 查询字段数量，不相等，曾查询结果异常退出
 	//	{
-	//		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+	//		//	MYWARN(_T("查询字段数量，不相等，曾查询结果异常退出"));
 	//		delete[] pRead;
 	//		pRead = NULL;
 	//		CloseHandle(hPipe);
@@ -1549,7 +1654,7 @@ BOOL CRedisRecvSample::LoadYxTable()
 	//	}
 	//	pWord++;
 
-	//	// ¼
+	//	// 记录集长度
 	//	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 	//	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 	//	DWORD dwRecordLen = *((DWORD*)pByte);
@@ -1562,7 +1667,7 @@ BOOL CRedisRecvSample::LoadYxTable()
 	//	}
 	//	pByte += sizeof(DWORD);
 
-	//	// ¼
+	//	// 记录数
 	//	DWORD dwRecordNum = *((int*)pByte);
 	//	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 	//	{
@@ -1576,7 +1681,7 @@ BOOL CRedisRecvSample::LoadYxTable()
 	//	TCHAR *tValue = new TCHAR[1024+1];
 	//	if (tValue == NULL)
 	//	{
-	//		//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
+	//		//MYERROR(_T("分配内存错误，错误码：%d"),GetLastError());
 	//		MYERROR(_T("GetPlazaId tValue == NULL"));
 	//		delete[] pRead;
 	//		pRead = NULL;
@@ -1584,7 +1689,7 @@ BOOL CRedisRecvSample::LoadYxTable()
 	//		return FALSE;
 	//	}
 
-	//	// ѯд뵽
+	//	// 将查询结果写入到缓存
 	//	for (int i=0;i<(int)dwRecordNum;i++)
 	//	{
 	//		// iDevId
@@ -1631,7 +1736,7 @@ BOOL CRedisRecvSample::LoadSampleTableFromRTDB(WORD SampleTableNo)
 	if (hPipe == NULL) {
 		return FALSE;
 	}
-	//ȡңϢ
+	//读取遥脉信息表
 	int tempSampleId = 0;
 	while(1)
 	{
@@ -1689,7 +1794,7 @@ BOOL CRedisRecvSample::LoadSampleTableFromRTDB(WORD SampleTableNo)
 			nOffset+=(pRetRecordHead+5)->DataLen;
 			
 
-			strKey.Format(_T("%d+%d+%d"), SampleTableNo, TABLE_NO_PULSE, iIndexDef.RecordNo);	//keyΪ+ң+ңš
+			strKey.Format(_T("%d+%d+%d"), SampleTableNo, TABLE_NO_PULSE, iIndexDef.RecordNo);	//key为“采样表号+三遥表号+三遥序号”
 			m_MapSampleNo[strKey] = SampleNo;
 			/*if (SampleNo>tempSampleId)
 			{
@@ -1702,7 +1807,7 @@ BOOL CRedisRecvSample::LoadSampleTableFromRTDB(WORD SampleTableNo)
 		tempSampleId++;
 
 	}
-	//
+	//清理
 	if(hPipe != NULL)			{CloseHandle(hPipe); hPipe = NULL;}
 	if(pNetMessageHead != NULL){delete [](BYTE *)pNetMessageHead; pNetMessageHead=NULL;}
 
@@ -1722,7 +1827,7 @@ BOOL CRedisRecvSample::LoadYmTable()
 	if (hPipe == NULL) {
 		return FALSE;
 	}
-	//ȡңϢ
+	//读取遥脉信息表
 	int iStationNum = 1;
 	SYSTEMTIME sys_time;
 	GetLocalTime(&sys_time);
@@ -1805,7 +1910,7 @@ BOOL CRedisRecvSample::LoadYmTable()
 			//memcpy(&YmConfig.bIdentifier,pBuf+nOffset,(pRetRecordHead+10)->DataLen);
 			
 			SimpleYmConfig.DataTime = iTimeStamp;
-			strKey.Format(_T("%d+%d"), SimpleYmConfig.nDeviceNo, SimpleYmConfig.nYmNum);	//keyΪ豸ID+ңš
+			strKey.Format(_T("%d+%d"), SimpleYmConfig.nDeviceNo, SimpleYmConfig.nYmNum);	//key为“设备ID+遥脉序号”
 			m_YmConfigDefMap[strKey] = SimpleYmConfig;
 			pBuf+=dwRecordLen;
 			nNum--;
@@ -1813,7 +1918,7 @@ BOOL CRedisRecvSample::LoadYmTable()
 
 		iStationNum++;
 	}
-	//
+	//清理
 	if(hPipe != NULL)			{CloseHandle(hPipe); hPipe = NULL;}
 	if(pNetMessageHead != NULL){delete [](BYTE *)pNetMessageHead; pNetMessageHead=NULL;}
 
@@ -1868,7 +1973,7 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //	{
 //		return;
 //	}
-//	else	//־λ
+//	else	//带标志位的脉冲量
 //	{
 //		pbYmData = (unsigned char*)pSocketYmDataEx;
 //		nLengthYmStruct = sizeof(SocketGroupYmUnitEx);
@@ -1888,13 +1993,13 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //	for (int i=0; i<YmNum; i++,pbYmData += nLengthYmStruct) 
 //	{
 //		unsigned char cFlag = DATA_FLAG_INVALID;        
-//		cFlag = *(pbYmData + sizeof(SocketGroupYmUnit));   //־λ
+//		cFlag = *(pbYmData + sizeof(SocketGroupYmUnit));   //标志位
 //
 //		PowFileInfo powInfo;
 //		memset(&powInfo, 0, sizeof(PowFileInfo));
-//		powInfo.nDevID = *((WORD*)pbYmData);                  //ǰ豸
-//		powInfo.nYmNum = *((WORD*)(pbYmData + nLengthWord));   //λ
-//		powInfo.nYmVal = (DWORD) *((DWORD*)(pbYmData + nLengthWord*2));  //ԭʼֵ
+//		powInfo.nDevID = *((WORD*)pbYmData);                  //前置设备号
+//		powInfo.nYmNum = *((WORD*)(pbYmData + nLengthWord));   //点位号
+//		powInfo.nYmVal = (DWORD) *((DWORD*)(pbYmData + nLengthWord*2));  //原始值
 //		powInfo.cFlag = cFlag;
 //		YmConfigDef YmDef;
 //		int iDevId = 0 ;
@@ -1935,10 +2040,10 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //		iSampleValue.cFlag = cFlag;
 //		m_SampleValueInfoMap[SampleNo] = iSampleValue;
 //
-//		//ѹб  ڼǷгֵ¼
+//		//把购电次数加入列表  用于检查是否招充值记录
 //		if (powInfo.nYmNum==7&&powInfo.cFlag==1)
 //		{
-//			if (YmDef.nYmRaw<powInfo.nYmVal)  //ʵʱеĹ
+//			if (YmDef.nYmRaw<powInfo.nYmVal)  //购电次数大于实时库中的购电次数
 //			{
 //				ProtocolCallItem *pItem = new ProtocolCallItem;
 //				if (NULL==pItem)
@@ -1946,8 +2051,8 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //					continue;
 //				}
 //				memset(pItem,0,sizeof(ProtocolCallItem));
-//				pItem->m_nType = 0xE1;//MSW 150828,עͣ0xE1-ٻֵ¼ı־
-//				pItem->m_nDeviceNo = YmDef.nDeviceNo;    //豸һ Id
+//				pItem->m_nType = 0xE1;//MSW 150828,加注释，0xE1-召唤充值记录的标志
+//				pItem->m_nDeviceNo = YmDef.nDeviceNo;    //设备表第一列 Id
 //				pItem->m_nStationNum = nRtuNo;
 //
 //				SocketMsgPrepayRecord iPrepayRecord ;
@@ -1955,7 +2060,7 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //				iPrepayRecord.btRtuNo = pSocketMsgYmData->btRtuNo;     //==m_nStationNum
 //				iPrepayRecord.btEndNo = 0xff;
 //				iPrepayRecord.btForeNo = pSocketMsgYmData->btForeNo;
-//				iPrepayRecord.nDevNo = powInfo.nDevID;    //豸ڶ deviceNo
+//				iPrepayRecord.nDevNo = powInfo.nDevID;    //设备表第二列 deviceNo
 //				iPrepayRecord.wdYjNum = powInfo.nYmVal - YmDef.nYmRaw;
 //				memcpy(pItem->m_nBuffer,&iPrepayRecord,sizeof(SocketMsgPrepayRecord)-sizeof(SocketPrepayRecordUnit));
 //
@@ -1964,13 +2069,13 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //				LeaveCriticalSection(&pDlg->m_pCCSendP2pTask->m_csRecordList);
 //			}
 //		}
-//		if (cFlag==1)  //m_YmConfigDefMap
+//		if (cFlag==1)  //更新至m_YmConfigDefMap里
 //		{
 //			YmDef.nYmRaw = powInfo.nYmVal;
 //			YmDef.dYmValue = powInfo.nYmVal*YmDef.dYmQuotiety;
 //			m_YmValueInfoCArray.Add(YmDef);
 //			CString tempKey = _T("");
-//			tempKey.Format(_T("%d+%d"), YmDef.nDeviceNo, YmDef.nYmNum);	//keyΪ豸ID+ңš
+//			tempKey.Format(_T("%d+%d"), YmDef.nDeviceNo, YmDef.nYmNum);	//key为“设备ID+遥脉序号”
 //			m_YmConfigDefMap[tempKey] = YmDef;
 //		}
 //		if (ihour==0&&iminite==0)
@@ -2063,7 +2168,7 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //		for (int j = 1;j<=SAMPLE_FIELDNUM;j++)
 //		{
 //			int sampleNo = i*SAMPLE_FIELDNUM + j;
-//			if (itype==0)  //Сʱ
+//			if (itype==0)  //小时采样
 //			{
 //				SampleValueInfoMap::iterator its;	
 //				its = m_SampleValueInfoMap.find(sampleNo);
@@ -2091,7 +2196,7 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //				}
 //
 //			}
-//			else if (itype==1)  //
+//			else if (itype==1)  //天采样
 //			{
 //				SampleValueInfoMap::iterator its;	
 //				its = m_SampleValueInfoMapDay.find(sampleNo);
@@ -2162,7 +2267,7 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //	}
 //}
 //
-////ʵʱ
+////更新至实时库
 //BOOL CRedisRecvSample::Update2RTDB()
 //{
 //	HANDLE hPipe=NULL;	 
@@ -2236,7 +2341,7 @@ BOOL CRedisRecvSample::SetTimeId(CString strTime)
 //		if (hPipe)
 //			pRead = (BYTE*)GetNetMessage(hPipe, pWrite,dwBufLen-1);	
 //
-//		delete[] pWrite;  //pData ûͷ
+//		delete[] pWrite;  //pData 没有释放
 //		if (pRead==NULL) 
 //		{
 //			continue;
@@ -2374,7 +2479,7 @@ BOOL CRedisRecvSample::CharToTchar (const char * _char, TCHAR * tchar)
 
 int CRedisRecvSample::ExitInstance()
 {
-	// TODO: ڴִ߳
+	// TODO: 在此执行任意逐线程清理
 	return CWinThread::ExitInstance();
 }
 
@@ -2382,4 +2487,4 @@ BEGIN_MESSAGE_MAP(CRedisRecvSample, CWinThread)
 END_MESSAGE_MAP()
 
 
-// CRedisRecvSample Ϣ
+// CRedisRecvSample 消息处理程序
@@ -3,6 +3,8 @@
 #include "HiredisIntf.h"
 #include "SoftBus.h"
 #include "RedisBus.h"
+#include "YmLookupIndex.h"
+#include "ReadEpoch.h"
 // CRedisRecvSample
 
 struct DeviceInfo
@@ -16,12 +18,14 @@ struct DeviceInfo
 	TCHAR RoomName[128];
 	TCHAR NickName[600];
 };
+typedef CMap<int,int,DeviceInfo,DeviceInfo&> DeviceInfoMap;
+
 class CRedisRecvSample : public CWinThread
 {
 	DECLARE_DYNCREATE(CRedisRecvSample)
 
 public:
-	CRedisRecvSample();           // ̬ʹõܱĹ캯
+	CRedisRecvSample();           // 动态创建所使用的受保护的构造函数
 	virtual ~CRedisRecvSample();
 
 public:
@@ -38,15 +42,26 @@ public:
 	BOOL LoadYmTable();
 	BOOL LoadSampleExtTable(WORD SampleTableNo);
 	BOOL GetYmDefByPowInfo(short nRtu, const PowFileInfo *pPowInfo, SimpleYmDef &ymDef, int &iDevId);
+	BOOL GetYmDef(int nDevId, int nYmNum, SimpleYmDef &ymDef);
+	BOOL UpdateYmDef(const SimpleYmDef &ymDef);
+	BOOL GetSampleNo(int SampleTableNo, int nTableNo, int nIndex, int &SampleNo);
+	void PublishLookupIndex();
+	void PublishDevIndex();
+	BOOL ReloadDeviceTable();
 	BOOL GetDeviceInfoByCollectorInfo(int nCollectorID, int nCollector3YNum, int &nDevID, int &nDev3YNum);
 	//void SaveSampleData2DB(int MinSampleNo, int MaxSampleNo,CString StrTimeId,int itype); GUOJ DEL 150909
 	BOOL GetDataFromRedis();
 	BOOL ConnectRedisServer();
 	//void OnSocketMsgGroupYx(SocketMsgGroupYxEx* pMsgGroupYxData); GUOJ DEL 150909
 	BOOL GetDevId(short nRtu, int DeviceNo, int &DevId);
+	int GetDevIds(short nRtu, const int *pDevNo, int nCount, int *pDevId);
 	//void OnCallPrePayRecord(SocketMsgPrepayRecord* pMsgPrepayRecordData); GUOJ DEL 150909
 	//BOOL Update2RTDB(); GUOJ DEL 150909
 	BOOL  GetDevInfo();
+	BOOL  GetDevInfoVersion(int &nCount, int &nChecksum);
+	BOOL  RefreshDevInfo();
+	BOOL  GetDeviceInfo(int nDevId, DeviceInfo &iDeviceInfo);
+	int   GetDeviceInfoCount();
 	BOOL  LoadYxTable();
 	BOOL LoadSampleTable(WORD SampleTableNo);
 	BOOL LoadSampleTableFromRTDB(WORD SampleTableNo);
@@ -55,27 +70,32 @@ public:
 	BOOL m_bHasRegister;
 	CString RedisIPAddress;
 	int RedisPort;
-	StationDefMap m_StationDefMap;			//վ
-	DeviceRecordDefMap m_DeviceRecordDefMap;	//豸
-	DeviceRecordDefMap2 m_DeviceRecordDefMap2;	//豸2
-	YmConfigDefMap m_YmConfigDefMap;		//ң
-	CollectorMappingMap m_CollectorMappingMap;  //豸ӳmap   
+	StationDefMap m_StationDefMap;			//厂站表
+	DeviceRecordDefMap m_DeviceRecordDefMap;	//设备表，重新加载时在m_csDeviceRecord内整体替换
+	DeviceRecordDefMap2 m_DeviceRecordDefMap2;	//设备表2
+	YmConfigDefMap m_YmConfigDefMap;		//遥脉表
+	CollectorMappingMap m_CollectorMappingMap;  //集中器向虚设备的映射map   
 	SampleDayNo m_MapSampleNo;
+	CYmLookupIndex * volatile m_pLookupIndex;	//当前发布的索引快照，处理线程只读
+	CDevLookupIndex * volatile m_pDevIndex;	//当前发布的设备索引快照，处理线程只读
+	CReadEpoch m_ReadEpoch;					//以上快照及m_pDeviceInfoMap的读者登记，替换后等读者退出再释放旧快照
 	//GUOJ DEL 150909
 	//SampleValueInfoMap m_SampleValueInfoMap;
 	//SampleValueInfoMap m_SampleValueInfoMapDay;
 	//CArray<YmConfigDef,YmConfigDef&> m_YmValueInfoCArray ;
 	//CArray<YxConfigDef,YxConfigDef&> m_YxValueInfoCArray ;
 	//GUOJ DEL 150909 END
-	CRITICAL_SECTION m_csYmConfigDefMap;
 	CRITICAL_SECTION m_csBillNum;
 	CRITICAL_SECTION m_csDayTime;
 	CRITICAL_SECTION m_csDevStateMap;
+	CRITICAL_SECTION m_csDeviceRecord;		//保护m_DeviceRecordDefMap的替换与遍历
 	//CRITICAL_SECTION m_csUpdateRTDB;
 	int MaxStationNum;
 	int BillNum;
 	CTime m_DayTime;
-	CMap<int,int,DeviceInfo,DeviceInfo&> m_DeviceInfoMap;
+	DeviceInfoMap * volatile m_pDeviceInfoMap;	//设备信息表，整体替换，处理线程只读
+	int m_nDevInfoCount;						//当前设备信息表对应的记录数和校验和
+	int m_nDevInfoChecksum;
 	CMap<int,int,BYTE,BYTE&> m_DevStateMap;
 	BOOL beInited;
 	CString m_strPath;
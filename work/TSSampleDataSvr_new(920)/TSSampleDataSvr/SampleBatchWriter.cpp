@@ -0,0 +1,286 @@
+// SampleBatchWriter.cpp : 实现文件
+//
+
+#include "stdafx.h"
+#include "TSSampleDataSvr.h"
+#include "SampleBatchWriter.h"
+#include "TSSampleDataSvrDlg.h"
+
+extern CAsyncLog *g_log;
+// CSampleBatchWriter
+
+IMPLEMENT_DYNCREATE(CSampleBatchWriter, CWinThread)
+
+CSampleBatchWriter::CSampleBatchWriter()
+{
+	m_nPendingBytes = 0;
+	m_nTotalRows = 0;
+	m_nTotalStatements = 0;
+	m_nTotalFlush = 0;
+	m_hExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_FlushEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	InitializeCriticalSection(&m_csSampleRowMap);
+	InitializeCriticalSection(&m_csFlush);
+	if(NULL==g_log)
+	{
+		g_log = new CAsyncLog(_T("\\TSSampleDataSvr"));
+	}
+
+	//批量参数从emscfg.ini的[SAMPLEBATCH]段读取
+	m_nMaxBatchBytes = SAMPLE_BATCH_MAXBYTES;
+	m_nMaxDelay = SAMPLE_BATCH_MAXDELAY;
+	m_nMaxRows = SAMPLE_BATCH_MAXROWS;
+	TCHAR szDirectory[MAX_PATH];
+	memset(szDirectory,0,sizeof(TCHAR)*MAX_PATH);
+	if (GetModuleFileName(NULL,szDirectory,MAX_PATH))
+	{
+		CString strPath = szDirectory;
+		int iIndex = strPath.ReverseFind('\\');
+		if (iIndex > 0)
+		{
+			CString strCountPath = strPath.Left(iIndex) + _T("\\parameter\\emscfg.ini");
+			m_nMaxBatchBytes = GetPrivateProfileInt(_T("SAMPLEBATCH"),_T("MaxBatchBytes"),SAMPLE_BATCH_MAXBYTES,strCountPath);
+			m_nMaxDelay = GetPrivateProfileInt(_T("SAMPLEBATCH"),_T("MaxDelay"),SAMPLE_BATCH_MAXDELAY,strCountPath);
+			m_nMaxRows = GetPrivateProfileInt(_T("SAMPLEBATCH"),_T("MaxRows"),SAMPLE_BATCH_MAXROWS,strCountPath);
+		}
+	}
+	if (m_nMaxBatchBytes < 4096)
+	{
+		m_nMaxBatchBytes = 4096;
+	}
+	if (m_nMaxDelay <= 0)
+	{
+		m_nMaxDelay = SAMPLE_BATCH_MAXDELAY;
+	}
+	//SQL Server单条VALUES最多1000行
+	if (m_nMaxRows <= 0 || m_nMaxRows > SQL_VALUES_MAXROWS)
+	{
+		m_nMaxRows = SAMPLE_BATCH_MAXROWS;
+	}
+}
+
+CSampleBatchWriter::~CSampleBatchWriter()
+{
+}
+
+BOOL CSampleBatchWriter::InitInstance()
+{
+	// TODO: 在此执行任意逐线程初始化
+	while(1)
+	{
+		HANDLE hEvents[2];
+		hEvents[0] = m_hExitEvent;
+		hEvents[1] = m_FlushEvent;
+		DWORD dwWait = WaitForMultipleObjects(2, hEvents, FALSE, m_nMaxDelay);
+		switch (dwWait)
+		{
+		case WAIT_OBJECT_0:
+			Flush();
+			return FALSE;
+		case WAIT_OBJECT_0+1:
+			ResetEvent(m_FlushEvent);
+			Flush();
+			break;
+		case WAIT_TIMEOUT:
+			Flush();
+			break;
+		default:
+			Sleep(1000);
+			break;
+		}
+	}
+	return TRUE;
+}
+
+int CSampleBatchWriter::ExitInstance()
+{
+	// TODO: 在此执行任意逐线程清理
+	return CWinThread::ExitInstance();
+}
+
+//把一个处理线程解析出的采样值合并到缓存中，同一张表同一TIMEID只保留一行
+void CSampleBatchWriter::AddSampleData(int itype, const CString& StrTimeId, const SampleValueInfoMap& SampleValueMap)
+{
+	SampleRowKey iKey;
+	memset(&iKey,0,sizeof(SampleRowKey));
+	iKey.iType = itype;
+	_tcsncpy(iKey.TimeId,StrTimeId,sizeof(iKey.TimeId)/sizeof(TCHAR)-1);
+
+	int nAddBytes = 0;
+	EnterCriticalSection(&m_csSampleRowMap);
+	SampleRowMap::iterator itRow = m_SampleRowMap.end();
+	SampleValueInfoMap::const_iterator its = SampleValueMap.begin();
+	for (;its!=SampleValueMap.end();++its)
+	{
+		int SampleNo = its->first;
+		if (SampleNo<=0)
+		{
+			continue;
+		}
+		//采样号n存放在第(n-1)/128张表的V((n-1)%128+1)列
+		int nTableNo = (SampleNo-1)/SAMPLE_FIELDNUM;
+		int nCol = (SampleNo-1)%SAMPLE_FIELDNUM;
+		if (itRow==m_SampleRowMap.end()||itRow->first.nTableNo!=nTableNo)
+		{
+			iKey.nTableNo = nTableNo;
+			itRow = m_SampleRowMap.find(iKey);
+			if (itRow==m_SampleRowMap.end())
+			{
+				SampleRow iRow;
+				memset(&iRow,0,sizeof(SampleRow));
+				itRow = m_SampleRowMap.insert(std::make_pair(iKey,iRow)).first;
+				nAddBytes += 48;
+			}
+		}
+		SampleRow &iRow = itRow->second;
+		DWORD dwBit = (DWORD)1<<(nCol%32);
+		if (!(iRow.ColMask[nCol/32]&dwBit))
+		{
+			iRow.ColMask[nCol/32] |= dwBit;
+			nAddBytes += 40;
+		}
+		iRow.dbValue[nCol] = its->second.dbValue;
+		iRow.cFlag[nCol] = its->second.cFlag;
+	}
+	m_nPendingBytes += nAddBytes;
+	BOOL bFlush = (m_nPendingBytes*(int)sizeof(TCHAR)>=m_nMaxBatchBytes);
+	LeaveCriticalSection(&m_csSampleRowMap);
+
+	if (bFlush)
+	{
+		SetEvent(m_FlushEvent);
+	}
+}
+
+//与原SaveSampleData2DB一致：优先写入data_sql文件，写文件失败再直接发往实时库
+void CSampleBatchWriter::WriteSql(HANDLE& hPipe, const CString& sPath, const CString& strSql)
+{
+	if (!sPath.IsEmpty())
+	{
+		CStdioFile fLog;
+		if(fLog.Open(sPath, CFile::modeCreate|CFile::shareDenyNone | CFile::modeNoTruncate | CFile::modeReadWrite))
+		{
+			fLog.SeekToEnd();
+			fLog.WriteString(strSql);
+			fLog.Close();
+			return;
+		}
+	}
+	ReguTrace(SQL,"采样入库:SQL写文件失败,直接入库");
+	int ReConnTime = 0;
+	while (hPipe == NULL)
+	{
+		hPipe = OpenRealDataPipe();
+		if (hPipe!=NULL)
+		{
+			break;
+		}
+		if (ReConnTime>=3)
+		{
+			ReguTrace(SQLERRO,"OpenRealDataPipe ERRO hPipe==null!");
+			return ;
+		}
+		ReConnTime++;
+		Sleep(1000);
+	}
+	CString strSqlFinal = strSql;
+	BYTE* pRead = NULL;
+	pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSqlFinal);
+	if (pRead)
+	{
+		delete[] pRead;
+		pRead = NULL;
+	}
+}
+
+//OnExit与写线程可能同时调用；先取m_csFlush再取走缓存，保证先取走的批次先入库，
+//否则后取走的新值可能先写入、随后被旧值覆盖
+void CSampleBatchWriter::Flush()
+{
+	SampleRowMap RowMap;
+	EnterCriticalSection(&m_csFlush);
+	EnterCriticalSection(&m_csSampleRowMap);
+	RowMap.swap(m_SampleRowMap);
+	m_nPendingBytes = 0;
+	LeaveCriticalSection(&m_csSampleRowMap);
+	if (RowMap.empty())
+	{
+		LeaveCriticalSection(&m_csFlush);
+		return;
+	}
+
+	DWORD dwBegin = GetTickCount();
+	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
+	SYSTEMTIME tt;
+	CString sFileName = _T("");
+	GetLocalTime(&tt);
+	sFileName.Format(_T("%04d-%02d-%02d"), tt.wYear, tt.wMonth, tt.wDay);
+	CString sPath = pDlg->m_pCRedisRecvSample->m_strPath + _T("\\data_sql\\") + sFileName;
+	CFileFind fFind;
+	if (!fFind.FindFile(sPath))
+	{
+		ReguTrace(ERRO,"采样入库:未找到该路径,path=%s!",sPath);
+		if (!CreateDirectory(sPath, NULL))
+		{
+			ReguTrace(ERRO,"采样入库:创建文件夹出错,path=%s!",sPath);
+			sPath.Empty();
+		}
+	}
+	if (!sPath.IsEmpty())
+	{
+		sFileName.Format(_T("%d_%04d-%02d-%02d %02d-%02d-%02d-%03d"), THREAD_NUM,tt.wYear, tt.wMonth, tt.wDay, tt.wHour, tt.wMinute, tt.wSecond, tt.wMilliseconds);
+		sPath += _T("\\SampleData_") + sFileName + _T(".txt");
+	}
+
+	HANDLE hPipe = NULL;
+	CString strBatch = _T("");
+	strBatch.Preallocate(m_nMaxBatchBytes/sizeof(TCHAR) + 4096);
+	int nRows = 0;
+	int nStatements = 0;
+	int nBatch = 0;
+	SampleRowMap::const_iterator it = RowMap.begin();
+	while (it!=RowMap.end())
+	{
+		//RowMap按(类型,表号,TIMEID)排序，同一张表的行是连续的
+		SampleRowMap::const_iterator itEnd = it;
+		int n = 0;
+		while (itEnd!=RowMap.end()&&itEnd->first.iType==it->first.iType&&itEnd->first.nTableNo==it->first.nTableNo&&n<m_nMaxRows)
+		{
+			++itEnd;
+			n++;
+		}
+		int nStmtRows = BuildSampleMergeSql(it,itEnd,strBatch);
+		if (nStmtRows>0)
+		{
+			nRows += nStmtRows;
+			nStatements++;
+		}
+		it = itEnd;
+		if (strBatch.GetLength()*(int)sizeof(TCHAR)>=m_nMaxBatchBytes||(it==RowMap.end()&&!strBatch.IsEmpty()))
+		{
+			WriteSql(hPipe,sPath,strBatch);
+			strBatch.Truncate(0);
+			nBatch++;
+		}
+	}
+	if (hPipe != NULL)
+	{
+		CloseHandle(hPipe);
+		hPipe = NULL;
+	}
+	DWORD dwSpan = GetTickCount() - dwBegin;
+	m_nTotalRows += nRows;
+	m_nTotalStatements += nStatements;
+	m_nTotalFlush++;
+	LeaveCriticalSection(&m_csFlush);
+
+	ReguTrace(SQL,"采样入库:行数%d,语句数%d,批次%d,耗时%dms,%.0f行/秒;累计行数%I64d,语句数%I64d,平均每次%.1f条语句",
+		nRows,nStatements,nBatch,dwSpan,dwSpan>0?nRows*1000.0/dwSpan:(double)nRows,m_nTotalRows,m_nTotalStatements,
+		(double)m_nTotalStatements/m_nTotalFlush);
+}
+
+BEGIN_MESSAGE_MAP(CSampleBatchWriter, CWinThread)
+END_MESSAGE_MAP()
+
+
+// CSampleBatchWriter 消息处理程序
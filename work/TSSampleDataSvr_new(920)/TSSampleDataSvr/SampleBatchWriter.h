@@ -0,0 +1,42 @@
+#pragma once
+#include "SampleMergeSql.h"
+
+#define SAMPLE_BATCH_MAXBYTES	(256*1024)	//单批SQL最大字节数
+#define SAMPLE_BATCH_MAXDELAY	5000		//采样行最大缓存时间(ms)
+#define SAMPLE_BATCH_MAXROWS	500			//单条MERGE语句最大行数，不超过SQL_VALUES_MAXROWS
+
+// CSampleBatchWriter
+// 各处理线程提交的采样值按"采样表+TIMEID"合并缓存，按字节数或时延批量生成MERGE语句入库
+
+class CSampleBatchWriter : public CWinThread
+{
+	DECLARE_DYNCREATE(CSampleBatchWriter)
+
+public:
+	CSampleBatchWriter();           // 动态创建所使用的受保护的构造函数
+	virtual ~CSampleBatchWriter();
+
+public:
+	virtual BOOL InitInstance();
+	virtual int ExitInstance();
+	void AddSampleData(int itype, const CString& StrTimeId, const SampleValueInfoMap& SampleValueMap);
+	void Flush();
+protected:
+	void WriteSql(HANDLE& hPipe, const CString& sPath, const CString& strSql);
+public:
+	SampleRowMap m_SampleRowMap;
+	CRITICAL_SECTION m_csSampleRowMap;
+	CRITICAL_SECTION m_csFlush;
+	HANDLE m_FlushEvent,m_hExitEvent;
+	int m_nPendingBytes;		//缓存中待入库数据的估算字节数
+	int m_nMaxBatchBytes;
+	int m_nMaxDelay;
+	int m_nMaxRows;
+	//统计
+	__int64 m_nTotalRows;
+	__int64 m_nTotalStatements;
+	__int64 m_nTotalFlush;
+
+protected:
+	DECLARE_MESSAGE_MAP()
+};
@@ -0,0 +1,271 @@
+// SampleDispatcher.cpp : 实现文件
+//
+
+#include "stdafx.h"
+#include "TSSampleDataSvr.h"
+#include "SampleDispatcher.h"
+#include "TSSampleDataSvrDlg.h"
+
+extern CAsyncLog *g_log;
+// CSampleDispatcher
+
+IMPLEMENT_DYNCREATE(CSampleDispatcher, CWinThread)
+
+CSampleDispatcher::CSampleDispatcher()
+{
+	m_nWorkerNum = THREAD_NUM;
+	m_nBatchPop = 0;
+	m_nBlockTime = 1;
+	m_nTotalFrames = 0;
+	m_nTotalWaits = 0;
+	m_nTotalDropped = 0;
+	m_nTotalUnknown = 0;
+	m_dwLastWaitLog = 0;
+	m_dwLastDropLog = 0;
+	m_nWaitsSinceLog = 0;
+	m_nDroppedSinceLog = 0;
+	memset(m_nWorkerFrames,0,sizeof(m_nWorkerFrames));
+	m_softbus = NULL;
+	m_softbus = new CRedisBus;
+	if (NULL==g_log)
+	{
+		g_log = new CAsyncLog(_T("\\TSSampleDataSvr"));
+	}
+}
+
+CSampleDispatcher::~CSampleDispatcher()
+{
+	if (m_softbus!=NULL)
+	{
+		delete m_softbus;
+		m_softbus = NULL;
+	}
+}
+
+BOOL CSampleDispatcher::ConnectRedisServer()
+{
+	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
+	int nCount = 0;
+	char szIP[WORDDOC_NAMESTRING_LEN];
+	memset(szIP, 0, WORDDOC_NAMESTRING_LEN);
+	if (!pDlg->m_pCRedisRecvSample->TChar2Char(pDlg->m_pCRedisRecvSample->RedisIPAddress,szIP))
+	{
+		return FALSE;
+	}
+	while(1)
+	{
+		if (m_nBatchPop>0)
+		{
+			if (m_BatchConsumer.Connect(szIP, pDlg->m_pCRedisRecvSample->RedisPort))
+			{
+				break;
+			}
+		}
+		else if (m_softbus->RegisterSoftBus(szIP, pDlg->m_pCRedisRecvSample->RedisPort) == REDIS_OK)
+		{
+			break;
+		}
+		m_softbus->UnRegisterSoftBus();
+		nCount++;
+		Sleep(3000);
+		if (nCount>=5)
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+//按厂站号选处理线程，取不到厂站号时返回-1
+int CSampleDispatcher::SelectWorker(const SocketFrameView &Frame)
+{
+	int nRtuNo = CSocketFrameParser::GetRtuNo(Frame);
+	if (nRtuNo<0)
+	{
+		return -1;
+	}
+	return nRtuNo % m_nWorkerNum;
+}
+
+BOOL CSampleDispatcher::DispatchFromRedis()
+{
+	if (m_nBatchPop>0)
+	{
+		return DispatchBatchFromRedis();
+	}
+	unsigned char * buffer = NULL;
+	int ret = m_softbus->RecvMessageFromMsmq_Ext("SampleMessage",&buffer);
+	if (REDIS_OK != ret || NULL == buffer)
+	{
+		if (buffer!=NULL)
+		{
+			delete [] buffer;
+			buffer = NULL;
+		}
+		if (REDIS_ERR == ret)
+		{
+			ReguTrace(Config,"分派线程:ReconnectRedisServer!");
+			m_softbus->UnRegisterSoftBus();
+			ConnectRedisServer();
+		}
+		return FALSE;
+	}
+	return DispatchFrame((BYTE*)buffer,SOCKETFRAME_LEN_UNKNOWN);
+}
+
+//批量模式：一次往返取多条，Redis为空时阻塞等待。报文要交给其他线程释放，仍各拷贝一份。
+//退出时本批未投递的报文(含投递失败的那条)放回Redis，下次启动接着处理
+BOOL CSampleDispatcher::DispatchBatchFromRedis()
+{
+	int nCount = m_BatchConsumer.PopBatch("SampleMessage",m_nBatchPop,m_nBlockTime);
+	if (nCount<0)
+	{
+		ReguTrace(Config,"分派线程:ReconnectRedisServer!");
+		ConnectRedisServer();
+		return FALSE;
+	}
+	for (int i=0;i<nCount;i++)
+	{
+		int nLen = 0;
+		const BYTE *pMsg = m_BatchConsumer.GetMessage(i,nLen);
+		BYTE *pBuf = new BYTE[nLen];
+		memcpy(pBuf,pMsg,nLen);
+		if (!DispatchFrame(pBuf,nLen))
+		{
+			if (m_BatchConsumer.PushBack("SampleMessage",i))
+			{
+				ReguTrace(Config,"分派线程:退出,本批未投递的%d条报文已放回Redis",nCount-i);
+			}
+			else
+			{
+				ReguTrace(ERRO,"分派线程:退出,本批未投递的%d条报文放回Redis失败",nCount-i);
+			}
+			break;
+		}
+	}
+	m_BatchConsumer.ReleaseBatch();
+	return nCount>0;
+}
+
+//校验后把一条报文交给所属处理线程，由处理线程释放；nLen为收到的字节数。
+//校验不通过的报文在此释放，不投递；程序退出时未能投递的报文在此释放并返回FALSE
+BOOL CSampleDispatcher::DispatchFrame(BYTE *buffer, int nLen)
+{
+	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
+	SocketFrameView Frame;
+	int nParse = CSocketFrameParser::Parse(buffer,nLen,Frame);
+	int nWorker = (nParse==SOCKETFRAME_OK) ? SelectWorker(Frame) : -1;
+	if (nWorker<0)
+	{
+		//不认识的报文类型处理线程也不处理，只计数；格式错误的报文按DISPATCH_LOG_INTERVAL限频记录
+		if (nParse==SOCKETFRAME_OK||nParse==SOCKETFRAME_UNKNOWN)
+		{
+			m_nTotalUnknown++;
+		}
+		else
+		{
+			m_nTotalDropped++;
+			m_nDroppedSinceLog++;
+			if (GetTickCount() - m_dwLastDropLog >= DISPATCH_LOG_INTERVAL)
+			{
+				ReguTrace(ERRO,"分派线程:丢弃格式错误的报文%d条(累计%I64d条),最近一条(%d):类型%d,正文长度%d:%s",
+					m_nDroppedSinceLog,m_nTotalDropped,nParse,Frame.btType,Frame.nMsgLen,
+					bufToHexString(buffer,CSocketFrameParser::GetDumpLen(Frame,nLen)).c_str());
+				m_nDroppedSinceLog = 0;
+				m_dwLastDropLog = GetTickCount();
+			}
+		}
+		delete [] buffer;
+		buffer = NULL;
+		return TRUE;
+	}
+	CProcessThread *pWorker = pDlg->m_pCProcessThread[nWorker];
+	while (!pWorker->m_FrameQueue.PushWait(buffer,QUEUE_PUSH_TIMEOUT))
+	{
+		//处理线程跟不上时停止从Redis取数，保持同一厂站报文的顺序
+		//每次超时只计数，持续积压时按DISPATCH_LOG_INTERVAL输出一次
+		m_nTotalWaits++;
+		m_nWaitsSinceLog++;
+		SetEvent(pWorker->m_ProcessDataEvent);
+		if (GetTickCount() - m_dwLastWaitLog >= DISPATCH_LOG_INTERVAL)
+		{
+			ReguTrace(ERRO,"分派线程:线程%d队列已满(%d条),等待处理;%dms内等待超时%d次",
+				nWorker,pWorker->m_FrameQueue.GetSize(),DISPATCH_LOG_INTERVAL,m_nWaitsSinceLog);
+			m_nWaitsSinceLog = 0;
+			m_dwLastWaitLog = GetTickCount();
+		}
+		if (theApp.bExitFlag)
+		{
+			delete [] buffer;
+			buffer = NULL;
+			return FALSE;
+		}
+	}
+	SetEvent(pWorker->m_ProcessDataEvent);
+	m_nTotalFrames++;
+	m_nWorkerFrames[nWorker]++;
+	return TRUE;
+}
+
+BOOL CSampleDispatcher::InitInstance()
+{
+	// TODO: 在此执行任意逐线程初始化
+	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
+	if(!ConnectRedisServer())
+	{
+		ReguTrace(Config,"分派线程:ConnectRedisServer err!");
+	}
+	ReguTrace(Config,"分派线程:按厂站号分派到%d个处理线程",m_nWorkerNum);
+	int nIdleSleep = REDIS_IDLE_SLEEP_MIN;
+	DWORD dwLastStat = GetTickCount();
+	while(!theApp.bExitFlag)
+	{
+		if (!pDlg->m_pCRedisRecvSample->beInited)
+		{
+			Sleep(200);
+			continue;
+		}
+		if (GetTickCount() - dwLastStat >= DISPATCH_STAT_INTERVAL)
+		{
+			CString strStat = _T("");
+			for (int i=0;i<m_nWorkerNum;i++)
+			{
+				CString strTemp = _T("");
+				strTemp.Format(_T(" %d:%I64d/%d"),i,m_nWorkerFrames[i],pDlg->m_pCProcessThread[i]->m_FrameQueue.GetHighWater());
+				strStat += strTemp;
+			}
+			ReguTrace(Config,"分派线程:共分派%I64d条,队列满等待%I64d次,丢弃格式错误%I64d条,不认识的类型%I64d条,各线程报文数/队列最高水位:%s",
+				m_nTotalFrames,m_nTotalWaits,m_nTotalDropped,m_nTotalUnknown,strStat);
+			dwLastStat = GetTickCount();
+		}
+		if (DispatchFromRedis())
+		{
+			nIdleSleep = REDIS_IDLE_SLEEP_MIN;
+			continue;
+		}
+		if (m_nBatchPop>0&&m_BatchConsumer.IsConnected())
+		{
+			//批量模式下空队列已在BLPOP中等待过，不再休眠
+			continue;
+		}
+		Sleep(nIdleSleep);
+		nIdleSleep *= 2;
+		if (nIdleSleep>REDIS_IDLE_SLEEP_MAX)
+		{
+			nIdleSleep = REDIS_IDLE_SLEEP_MAX;
+		}
+	}
+	return FALSE;
+}
+
+int CSampleDispatcher::ExitInstance()
+{
+	// TODO: 在此执行任意逐线程清理
+	return CWinThread::ExitInstance();
+}
+
+BEGIN_MESSAGE_MAP(CSampleDispatcher, CWinThread)
+END_MESSAGE_MAP()
+
+
+// CSampleDispatcher 消息处理程序
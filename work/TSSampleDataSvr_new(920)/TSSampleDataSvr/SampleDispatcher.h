@@ -0,0 +1,50 @@
+#pragma once
+#include "SoftBus.h"
+#include "RedisBus.h"
+#include "RedisBatchConsumer.h"
+
+#define DISPATCH_STAT_INTERVAL	60000	//分派统计输出周期(ms)
+#define DISPATCH_LOG_INTERVAL	10000	//队列满、丢弃报文的错误日志最短间隔(ms)
+
+// CSampleDispatcher
+// 分区模式下唯一读取Redis SampleMessage的线程。按报文的厂站号(前置号*256+RTU号)取模选定处理线程，
+// 同一厂站的报文总是按到达顺序交给同一个线程，处理线程各自持有所负责厂站的遥信状态，不再争用m_csDevStateMap。
+// 报文投递前按收到的字节数校验，格式错误或取不到厂站号的报文直接丢弃，处理线程只收到校验过的报文。
+// 处理线程队列满时等待，不丢报文，未取走的报文留在Redis中。
+
+class CSampleDispatcher : public CWinThread
+{
+	DECLARE_DYNCREATE(CSampleDispatcher)
+
+public:
+	CSampleDispatcher();           // 动态创建所使用的受保护的构造函数
+	virtual ~CSampleDispatcher();
+
+public:
+	virtual BOOL InitInstance();
+	virtual int ExitInstance();
+	BOOL ConnectRedisServer();
+	BOOL DispatchFromRedis();
+	BOOL DispatchBatchFromRedis();
+	BOOL DispatchFrame(BYTE *pBuf, int nLen);
+	int SelectWorker(const SocketFrameView &Frame);
+public:
+	CSoftBus *m_softbus;
+	int m_nWorkerNum;
+	int m_nBatchPop;				//每次往返取的报文数，0表示经软总线逐条取
+	int m_nBlockTime;				//批量模式下Redis为空时阻塞等待的秒数
+	CRedisBatchConsumer m_BatchConsumer;
+	//统计
+	__int64 m_nTotalFrames;
+	__int64 m_nTotalWaits;			//处理线程队列满而等待的次数
+	__int64 m_nTotalDropped;		//格式错误而丢弃的报文数
+	__int64 m_nTotalUnknown;		//类型不认识或取不到厂站号而丢弃的报文数
+	DWORD m_dwLastWaitLog;
+	DWORD m_dwLastDropLog;
+	int m_nWaitsSinceLog;			//上次输出后的等待超时次数
+	int m_nDroppedSinceLog;			//上次输出后丢弃的格式错误报文数
+	__int64 m_nWorkerFrames[THREAD_NUM_MAX];
+
+protected:
+	DECLARE_MESSAGE_MAP()
+};
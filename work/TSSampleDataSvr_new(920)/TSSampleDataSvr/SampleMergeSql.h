@@ -0,0 +1,106 @@
+#pragma once
+
+#include <map>
+#include "SqlText.h"
+
+#define SAMPLE_COLMASK_NUM		((SAMPLE_FIELDNUM+31)/32)
+
+struct SampleRowKey
+{
+	int iType;				//0-小时采样 1-天采样
+	int nTableNo;			//采样表序号，即TS_H1_%03d/TS_DAY_%03d中的序号
+	TCHAR TimeId[20];		//TIMEID
+
+	bool operator<(const SampleRowKey& other) const
+	{
+		if (iType!=other.iType)
+		{
+			return iType<other.iType;
+		}
+		if (nTableNo!=other.nTableNo)
+		{
+			return nTableNo<other.nTableNo;
+		}
+		return _tcscmp(TimeId,other.TimeId)<0;
+	}
+};
+
+struct SampleRow
+{
+	DWORD ColMask[SAMPLE_COLMASK_NUM];		//已赋值的列,第j位对应V(j+1)
+	double dbValue[SAMPLE_FIELDNUM];
+	unsigned char cFlag[SAMPLE_FIELDNUM];
+};
+
+typedef std::map<SampleRowKey,SampleRow> SampleRowMap;
+
+//同一张表的[itBegin,itEnd)行生成一条MERGE语句追加到strSql，返回行数。
+//调用者保证行数不超过SQL_VALUES_MAXROWS；同一批中某行未赋值的列写NULL，更新时保留库中原值
+inline int BuildSampleMergeSql(SampleRowMap::const_iterator itBegin, SampleRowMap::const_iterator itEnd, CString& strSql)
+{
+	DWORD ColMask[SAMPLE_COLMASK_NUM];
+	memset(ColMask,0,sizeof(ColMask));
+	SampleRowMap::const_iterator it;
+	for (it=itBegin;it!=itEnd;++it)
+	{
+		for (int k=0;k<SAMPLE_COLMASK_NUM;k++)
+		{
+			ColMask[k] |= it->second.ColMask[k];
+		}
+	}
+	int nCols[SAMPLE_FIELDNUM];
+	int nColNum = 0;
+	for (int j=0;j<SAMPLE_FIELDNUM;j++)
+	{
+		if (ColMask[j/32]&((DWORD)1<<(j%32)))
+		{
+			nCols[nColNum++] = j;
+		}
+	}
+	if (nColNum==0)
+	{
+		return 0;
+	}
+
+	AppendSqlText(strSql,itBegin->first.iType==1?_T("MERGE TS_DAY_%03d AS t USING (VALUES "):_T("MERGE TS_H1_%03d AS t USING (VALUES "),itBegin->first.nTableNo);
+	int nRows = 0;
+	for (it=itBegin;it!=itEnd;++it,nRows++)
+	{
+		AppendSqlText(strSql,nRows==0?_T("('%s'"):_T(",('%s'"),it->first.TimeId);
+		for (int k=0;k<nColNum;k++)
+		{
+			int j = nCols[k];
+			if (it->second.ColMask[j/32]&((DWORD)1<<(j%32)))
+			{
+				AppendSqlText(strSql,_T(",%2f"),it->second.dbValue[j]);
+			}
+			else
+			{
+				strSql.Append(_T(",NULL"),5);
+			}
+		}
+		strSql.AppendChar(_T(')'));
+	}
+	strSql.Append(_T(") AS s(TIMEID"),13);
+	for (int k=0;k<nColNum;k++)
+	{
+		AppendSqlText(strSql,_T(",V%03d"),nCols[k]+1);
+	}
+	strSql.Append(_T(") ON t.TIMEID=s.TIMEID WHEN MATCHED THEN UPDATE SET "));
+	for (int k=0;k<nColNum;k++)
+	{
+		AppendSqlText(strSql,k==0?_T("V%03d=ISNULL(s.V%03d,t.V%03d)"):_T(",V%03d=ISNULL(s.V%03d,t.V%03d)"),nCols[k]+1,nCols[k]+1,nCols[k]+1);
+	}
+	strSql.Append(_T(" WHEN NOT MATCHED THEN INSERT (TIMEID"));
+	for (int k=0;k<nColNum;k++)
+	{
+		AppendSqlText(strSql,_T(",V%03d"),nCols[k]+1);
+	}
+	strSql.Append(_T(") VALUES (s.TIMEID"));
+	for (int k=0;k<nColNum;k++)
+	{
+		AppendSqlText(strSql,_T(",s.V%03d"),nCols[k]+1);
+	}
+	strSql.Append(_T("); "));
+	return nRows;
+}
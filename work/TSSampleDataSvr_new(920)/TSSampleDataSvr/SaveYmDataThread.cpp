@@ -1,4 +1,4 @@
-// SaveYmDataThread.cpp : ʵļ
+// SaveYmDataThread.cpp : 实现文件
 //
 
 #include "stdafx.h"
@@ -7,14 +7,53 @@
 #include "TSSampleDataSvrDlg.h"
 
 // CSaveYmDataThread
-extern CLog *g_log;
+extern CAsyncLog *g_log;
 IMPLEMENT_DYNCREATE(CSaveYmDataThread, CWinThread)
 
 CSaveYmDataThread::CSaveYmDataThread()
 {
 	if(NULL==g_log)
 	{
-		g_log = new CLog(_T("\\TSSampleDataSvr"));
+		g_log = new CAsyncLog(_T("\\TSSampleDataSvr"));
+	}
+	m_nNextBatch = 0;
+	m_nFailedBatch = 0;
+
+	//对账参数从emscfg.ini的[PAYRECON]段读取
+	m_nWorkerNum = PAYRECON_DEFAULT_WORKERS;
+	m_nBatchDevices = PAYRECON_BATCH_DEVICES;
+	m_nRecallBatch = PAYRECON_RECALL_BATCH;
+	m_nRecallInterval = PAYRECON_RECALL_INTERVAL;
+	TCHAR szDirectory[MAX_PATH];
+	memset(szDirectory,0,sizeof(TCHAR)*MAX_PATH);
+	if (GetModuleFileName(NULL,szDirectory,MAX_PATH))
+	{
+		CString strPath = szDirectory;
+		int iIndex = strPath.ReverseFind('\\');
+		if (iIndex > 0)
+		{
+			CString strCountPath = strPath.Left(iIndex) + _T("\\parameter\\emscfg.ini");
+			m_nWorkerNum = GetPrivateProfileInt(_T("PAYRECON"),_T("Workers"),PAYRECON_DEFAULT_WORKERS,strCountPath);
+			m_nBatchDevices = GetPrivateProfileInt(_T("PAYRECON"),_T("BatchDevices"),PAYRECON_BATCH_DEVICES,strCountPath);
+			m_nRecallBatch = GetPrivateProfileInt(_T("PAYRECON"),_T("RecallBatch"),PAYRECON_RECALL_BATCH,strCountPath);
+			m_nRecallInterval = GetPrivateProfileInt(_T("PAYRECON"),_T("RecallInterval"),PAYRECON_RECALL_INTERVAL,strCountPath);
+		}
+	}
+	if (m_nWorkerNum < 1 || m_nWorkerNum > PAYRECON_MAX_WORKERS)
+	{
+		m_nWorkerNum = PAYRECON_DEFAULT_WORKERS;
+	}
+	if (m_nBatchDevices < 1 || m_nBatchDevices > 1000)
+	{
+		m_nBatchDevices = PAYRECON_BATCH_DEVICES;
+	}
+	if (m_nRecallBatch < 1)
+	{
+		m_nRecallBatch = PAYRECON_RECALL_BATCH;
+	}
+	if (m_nRecallInterval < 0)
+	{
+		m_nRecallInterval = PAYRECON_RECALL_INTERVAL;
 	}
 }
 
@@ -24,7 +63,7 @@ CSaveYmDataThread::~CSaveYmDataThread()
 
 BOOL CSaveYmDataThread::InitInstance()
 {
-	// TODO: ڴִ̳߳ʼ
+	// TODO: 在此执行任意逐线程初始化
 	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
 	BOOL beDone = FALSE;
 	while(1)
@@ -33,156 +72,9 @@ BOOL CSaveYmDataThread::InitInstance()
 		GetLocalTime(&sys_time);
 		if (sys_time.wHour==10&&beDone==FALSE&&pDlg->m_pCRedisRecvSample->beInited)
 		{
-			//GetDeviceId();
-			ReguTrace(Config,"Check YmData begin!");
-			DeviceRecordDefMap::iterator iterDevMap=pDlg->m_pCRedisRecvSample->m_DeviceRecordDefMap.begin();   
-			for(;iterDevMap!=pDlg->m_pCRedisRecvSample->m_DeviceRecordDefMap.end();++iterDevMap)  
-			{
-				int iDevId = 0;
-				int iStationId = 0;
-				int iDevNo = 0;  //ǰ豸
-				iDevId = iterDevMap->second;
-				CString ikey = _T("");
-				ikey = iterDevMap->first;
-				USES_CONVERSION;
-				char* chArr = W2A(ikey);
-				sscanf_s((const char *)chArr, "%d+%d",&iStationId, &iDevNo);
-				SimpleYmDef YmDef;
-				BYTE LowRtu = iStationId%256;
-				BYTE HighRtu = iStationId/256;
-				CString key = _T("");
-				key.Format(_T("%d+%d"), iDevId, 7);
-				YmConfigDefMap::iterator itym;	
-				itym = pDlg->m_pCRedisRecvSample->m_YmConfigDefMap.find(key);
-				if (itym == pDlg->m_pCRedisRecvSample->m_YmConfigDefMap.end())
-				{
-					continue;
-				}
-				YmDef = itym->second;
-				int CallNum = 0;
-				if (YmDef.nYmRaw==0)
-				{
-					continue;
-				}
-				CheckPaymentRecord(iDevId,YmDef.nYmRaw,CallNum);
-				if (CallNum>0)
-				{
-					ProtocolCallItem *pItem = new ProtocolCallItem;
-					if (NULL==pItem)
-					{
-						continue;
-					}
-					memset(pItem,0,sizeof(ProtocolCallItem));
-					pItem->m_nType = 0xE1;//MSW 150828,עͣ0xE1-ٻֵ¼ı־
-					pItem->m_nDeviceNo = YmDef.nDeviceNo;    //豸һ Id
-					pItem->m_nStationNum = iStationId;
-
-					SocketMsgPrepayRecord iPrepayRecord ;
-					memset(&iPrepayRecord,0,sizeof(SocketMsgPrepayRecord));
-					iPrepayRecord.btRtuNo = LowRtu;     //==m_nStationNum
-					iPrepayRecord.btEndNo = 0xff;
-					iPrepayRecord.btForeNo = HighRtu;
-					iPrepayRecord.nDevNo = iDevNo;    //豸ڶ deviceNo
-					iPrepayRecord.wdYjNum = CallNum;
-					memcpy(pItem->m_nBuffer,&iPrepayRecord,sizeof(SocketMsgPrepayRecord)-sizeof(SocketPrepayRecordUnit));
-
-					ReguTrace(Config,"гֵ¼DevId:%d!",iDevId);
-					EnterCriticalSection(&pDlg->m_pCCSendP2pTask->m_csRecordList);
-					pDlg->m_pCCSendP2pTask->m_RecordList.AddTail(pItem);
-					LeaveCriticalSection(&pDlg->m_pCCSendP2pTask->m_csRecordList);
-					SetEvent(pDlg->m_pCCSendP2pTask->m_ProcessDataEvent);
-					Sleep(1000);
-				}
-			}
-			ReguTrace(Config,"Check YmData end!");
-			//for (int i=0;i<m_DevIdCArray.GetSize();i++)
-			//{
-			//	SimpleYmDef YmDef;
-			//	int iDevId = m_DevIdCArray[i].iDevId;
-			//	BYTE LowRtu = m_DevIdCArray[i].iStationId%256;
-			//	BYTE HighRtu = m_DevIdCArray[i].iStationId/256;
-			//	CString key = _T("");
-			//	key.Format(_T("%d+%d"), iDevId, 7);
-			//	YmConfigDefMap::iterator itym;	
-			//	itym = pDlg->m_pCRedisRecvSample->m_YmConfigDefMap.find(key);
-			//	if (itym == pDlg->m_pCRedisRecvSample->m_YmConfigDefMap.end())
-			//	{
-			//		continue;
-			//	}
-			//	YmDef = itym->second;
-			//	int CallNum = 0;
-			//	CheckPaymentRecord(iDevId,YmDef.nYmRaw,CallNum);
-			//	if (CallNum>0)
-			//	{
-			//		ProtocolCallItem *pItem = new ProtocolCallItem;
-			//		if (NULL==pItem)
-			//		{
-			//			continue;
-			//		}
-			//		memset(pItem,0,sizeof(ProtocolCallItem));
-			//		pItem->m_nType = 0xE1;//MSW 150828,עͣ0xE1-ٻֵ¼ı־
-			//		pItem->m_nDeviceNo = YmDef.nDeviceNo;    //豸һ Id
-			//		pItem->m_nStationNum = m_DevIdCArray[i].iStationId;
-
-			//		SocketMsgPrepayRecord iPrepayRecord ;
-			//		memset(&iPrepayRecord,0,sizeof(SocketMsgPrepayRecord));
-			//		iPrepayRecord.btRtuNo = LowRtu;     //==m_nStationNum
-			//		iPrepayRecord.btEndNo = 0xff;
-			//		iPrepayRecord.btForeNo = HighRtu;
-			//		iPrepayRecord.nDevNo = m_DevIdCArray[i].iDevNum;    //豸ڶ deviceNo
-			//		iPrepayRecord.wdYjNum = CallNum;
-			//		memcpy(pItem->m_nBuffer,&iPrepayRecord,sizeof(SocketMsgPrepayRecord)-sizeof(SocketPrepayRecordUnit));
-
-			//		EnterCriticalSection(&pDlg->m_pCCSendP2pTask->m_csRecordList);
-			//		pDlg->m_pCCSendP2pTask->m_RecordList.AddTail(pItem);
-			//		LeaveCriticalSection(&pDlg->m_pCCSendP2pTask->m_csRecordList);
-			//	}
-			//}
-			/*if (pDlg->m_pCCSendP2pTask->m_RecordList.GetSize()>0)
-			{
-				SetEvent(pDlg->m_pCCSendP2pTask->m_ProcessDataEvent);
-			}*/
+			RunReconciliation();
 			beDone = TRUE;
 		}
-		if (0)//((sys_time.wHour==1||sys_time.wHour==10||sys_time.wHour==18)&&beDone==FALSE&&pDlg->m_pCRedisRecvSample->beInited)
-		{
-			ReguTrace(Config,"save YmData begin!");
-			HANDLE hPipe = OpenRealDataPipe();
-			
-			CString UpdateSql = _T("");
-			int icount = 0;
-			YmConfigDefMap::iterator itym=pDlg->m_pCRedisRecvSample->m_YmConfigDefMap.begin();   
-			for(;itym!=pDlg->m_pCRedisRecvSample->m_YmConfigDefMap.end();++itym)  
-			{
-				SimpleYmDef YmDef;
-				YmDef = itym->second;
-				CString TempSql = _T("");
-				TempSql.Format(_T("UPDATE TB_PULSE SET RAWVALUE=%lld,YMVALUE=%f WHERE ID=%d ;"),YmDef.nYmRaw,YmDef.dYmValue,YmDef.nYmIndex);
-				UpdateSql += TempSql;
-				icount++;
-				if (icount%100!=0 &&itym!=pDlg->m_pCRedisRecvSample->m_YmConfigDefMap.end())
-				{
-					continue;
-				}
-
-				BYTE* pRead = NULL;
-				CString strSql = UpdateSql;
-				pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSql);
-				if (pRead)
-				{
-					delete[] pRead;
-					pRead = NULL;
-				}
-				UpdateSql.Empty();
-			}
-			if (hPipe != NULL)
-			{
-				CloseHandle(hPipe);
-				hPipe = NULL;
-			}
-			beDone = TRUE;
-			ReguTrace(Config,"save YmData end!");
-		}
 		if(sys_time.wHour==2||sys_time.wHour==11||sys_time.wHour==16||sys_time.wHour==19) 
 		{
 			beDone = FALSE;
@@ -195,11 +87,11 @@ BOOL CSaveYmDataThread::InitInstance()
 BOOL CSaveYmDataThread::GetDeviceId()
 {
 	m_DevIdCArray.RemoveAll();
-	int iFdCount = 3;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
+	int iFdCount = 3;	//	查询的字段数
+	int iMaxRsCount = -1;	// 限制查询得到的最大记录个数，-1指不限制
 
 
-	// ݹܵSQL
+	// 向数据管道发送SQL语句
 	BYTE* pRead = NULL;
 
 	HANDLE hPipe =OpenRealDataPipe();
@@ -217,16 +109,16 @@ BOOL CSaveYmDataThread::GetDeviceId()
 		strQuery.Format(_T("select top 5000 ID, DEVICENUM, STATIONID from TB_DEVICE where ID > %d order by ID;"),tempId);
 		pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
 
-		if (NULL == pRead)	// δѯ¼
+		if (NULL == pRead)	// 未查询到记录
 		{
 			CloseHandle(hPipe);
 			MYERROR(_T("GetDeviceId pRead null"));
 			return FALSE;
 		}
-		// صĽ
+		// 解析返回的结果
 		NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
 		if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-			//	MYWARN(_T("ر쳣%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
+			//	MYWARN(_T("返回报文异常，%s"),bufToHexString(pRead,pNetMessageHead->Length).c_str());
 			delete[] pRead;
 			pRead = NULL;
 			CloseHandle(hPipe);
@@ -234,9 +126,9 @@ BOOL CSaveYmDataThread::GetDeviceId()
 			return FALSE;
 		}	
 
-		if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+		if (pNetMessageHead->Length < 1)	// 空报文，无查询结果
 		{
-			//MYWARN(_T("յջظģ޷ѯ"));
+			//MYWARN(_T("接收到空回复报文，无法解析查询结果"));
 			delete[] pRead;
 			pRead = NULL;
 			CloseHandle(hPipe);
@@ -244,12 +136,12 @@ BOOL CSaveYmDataThread::GetDeviceId()
 			return FALSE;
 		}
 
-		// ȡѯֶ
+		// 获取查询的字段数
 		WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
 		int nFieldNum = (int)*pWord;
-		if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+		if (nFieldNum != iFdCount)	// 查询字段数量，不相等，曾查询结果异常退出
 		{
-			//	MYWARN(_T("ѯֶȣѯ쳣˳"));
+			//	MYWARN(_T("查询字段数量，不相等，曾查询结果异常退出"));
 			delete[] pRead;
 			pRead = NULL;
 			CloseHandle(hPipe);
@@ -258,7 +150,7 @@ BOOL CSaveYmDataThread::GetDeviceId()
 		}
 		pWord++;
 
-		// ¼
+		// 记录集长度
 		MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
 		BYTE *pByte = (BYTE*)&pHead[nFieldNum];
 		DWORD dwRecordLen = *((DWORD*)pByte);
@@ -271,7 +163,7 @@ BOOL CSaveYmDataThread::GetDeviceId()
 		}
 		pByte += sizeof(DWORD);
 
-		// ¼
+		// 记录数
 		DWORD dwRecordNum = *((int*)pByte);
 		if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
 		{
@@ -285,7 +177,7 @@ BOOL CSaveYmDataThread::GetDeviceId()
 		TCHAR *tValue = new TCHAR[1024+1];
 		if (tValue == NULL)
 		{
-			//MYERROR(_T("ڴ󣬴룺%d"),GetLastError());
+			//MYERROR(_T("分配内存错误，错误码：%d"),GetLastError());
 			MYERROR(_T("GetDeviceId tValue == NULL"));
 			delete[] pRead;
 			pRead = NULL;
@@ -293,7 +185,7 @@ BOOL CSaveYmDataThread::GetDeviceId()
 			return FALSE;
 		}
 
-		// ѯд뵽
+		// 将查询结果写入到缓存
 		for (int i=0;i<(int)dwRecordNum;i++)
 		{
 			DevStaionInfo iDevInfo;
@@ -337,148 +229,208 @@ BOOL CSaveYmDataThread::GetDeviceId()
 
 	return TRUE;
 }
-BOOL CSaveYmDataThread::CheckPaymentRecord(int iDevId,int MaxBuyNum,int& CallNum)
+//对账：取设备快照 -> 多线程分批查询并算出要招的条数 -> 分批投递招充值记录命令
+void CSaveYmDataThread::RunReconciliation()
 {
-	BYTE* pRead = NULL;
-	int iFdCount = 1;	//	ѯֶ
-	int iMaxRsCount = -1;	// Ʋѯõ¼-1ָ
-
-	/*HANDLE hPipe =OpenRealDataPipe();
-	if (hPipe == NULL) 
+	ReguTrace(Config,"Check YmData begin!");
+	DWORD dwBegin = GetTickCount();
+	int nDevNum = BuildReconItems();
+	if (nDevNum == 0)
 	{
-		MYERROR(_T("CheckPaymentRecord hPipe null"));
-		return FALSE;
-	}*/
-
-
-	CString strQuery;
-	strQuery.Format(_T("select [COUNT] from TE_PAYMENT_PAYRECORD where DEVICEID=%d and [COUNT]>0 and [COUNT]<= %d order by [COUNT] desc;"),iDevId,MaxBuyNum);
-	pRead = (BYTE*)GetMessage_RecordOfSql(strQuery);
+		ReguTrace(Config,"Check YmData end!无需对账的设备");
+		return;
+	}
+	int nBatchNum = (nDevNum + m_nBatchDevices - 1)/m_nBatchDevices;
+	InterlockedExchange(&m_nNextBatch,0);
+	InterlockedExchange(&m_nFailedBatch,0);
 
-	if (NULL == pRead)	// δѯ¼
+	CWinThread* pWorkers[PAYRECON_MAX_WORKERS];
+	int nWorkers = 0;
+	for (int i=0;i<m_nWorkerNum&&i<nBatchNum;i++)
 	{
-		//CloseHandle(hPipe);
-		MYERROR(_T("CheckPaymentRecord pRead null"));
-		return FALSE;
+		CWinThread* pThread = AfxBeginThread(ReconWorkerProc, this, THREAD_PRIORITY_NORMAL, 0, CREATE_SUSPENDED);
+		if (pThread == NULL)
+		{
+			continue;
+		}
+		pThread->m_bAutoDelete = FALSE;
+		pThread->ResumeThread();
+		pWorkers[nWorkers++] = pThread;
 	}
-	// صĽ
-	NetMessageHead *pNetMessageHead = (NetMessageHead*)pRead;
-	if (pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB) {
-		delete[] pRead;
-		pRead = NULL;
-		//CloseHandle(hPipe);
-		CallNum = (MaxBuyNum<10)?MaxBuyNum:10;
-		//MYERROR(_T("CheckPaymentRecord pNetMessageHead->MessageType != NET_MESSAGE_RETRECORDOFTB null"));
-		return FALSE;
-	}	
-
-	if (pNetMessageHead->Length < 1)	// ձģ޲ѯ
+	if (nWorkers == 0)
 	{
-		//MYWARN(_T("յջظģ޷ѯ"));
-		delete[] pRead;
-		pRead = NULL;
-		//CloseHandle(hPipe);
-		MYERROR(_T("CheckPaymentRecord pNetMessageHead->Length < 1 null"));
-		CallNum = (MaxBuyNum<10)?MaxBuyNum:10;
-		return FALSE;
+		//线程创建失败时在本线程顺序执行
+		ReconWorkerProc(this);
 	}
-
-	// ȡѯֶ
-	WORD* pWord = (WORD*)&pRead[sizeof(NetMessageHead)];
-	int nFieldNum = (int)*pWord;
-	if (nFieldNum != iFdCount)	// ѯֶȣѯ쳣˳
+	for (int i=0;i<nWorkers;i++)
 	{
-		//	MYWARN(_T("ѯֶȣѯ쳣˳"));
-		delete[] pRead;
-		pRead = NULL;
-		//CloseHandle(hPipe);
-		MYERROR(_T("CheckPaymentRecord nFieldNum != iFdCount null"));
-		return FALSE;
+		WaitForSingleObject(pWorkers[i]->m_hThread, INFINITE);
+		delete pWorkers[i];
 	}
-	pWord++;
+	DWORD dwQuery = GetTickCount() - dwBegin;
+	ReguTrace(Config,"对账查询完成:设备%d台,%d批,失败%d批,查询线程%d个,耗时%dms",
+		nDevNum,nBatchNum,(int)m_nFailedBatch,max(nWorkers,1),dwQuery);
 
-	// ¼
-	MessageRetRecordHead* pHead = (MessageRetRecordHead*)pWord;
-	BYTE *pByte = (BYTE*)&pHead[nFieldNum];
-	DWORD dwRecordLen = *((DWORD*)pByte);
-	if (dwRecordLen < 1)
+	QueueRecallCommands();
+	m_vecRecon.clear();
+	ReguTrace(Config,"Check YmData end!总耗时%dms",GetTickCount()-dwBegin);
+}
+
+//从设备表和遥脉索引取出购电次数非0的设备，遍历只在本线程进行
+int CSaveYmDataThread::BuildReconItems()
+{
+	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
+	m_vecRecon.clear();
+	//设备表可能被设备信息刷新整体替换，遍历期间持锁
+	EnterCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDeviceRecord);
+	m_vecRecon.reserve(pDlg->m_pCRedisRecvSample->m_DeviceRecordDefMap.size());
+	DeviceRecordDefMap::iterator iterDevMap=pDlg->m_pCRedisRecvSample->m_DeviceRecordDefMap.begin();
+	for(;iterDevMap!=pDlg->m_pCRedisRecvSample->m_DeviceRecordDefMap.end();++iterDevMap)
 	{
-		delete[] pRead;
-		pRead = NULL;
-		//CloseHandle(hPipe);
-		CallNum = (MaxBuyNum<10)?MaxBuyNum:10;
-		return FALSE;
+		PayReconItem iItem;
+		memset(&iItem,0,sizeof(PayReconItem));
+		iItem.iDevId = iterDevMap->second;
+		USES_CONVERSION;
+		char* chArr = W2A(iterDevMap->first);
+		sscanf_s((const char *)chArr, "%d+%d",&iItem.iStationId, &iItem.iDevNo);
+		SimpleYmDef YmDef;
+		if (!pDlg->m_pCRedisRecvSample->GetYmDef(iItem.iDevId, 7, YmDef))
+		{
+			continue;
+		}
+		if (YmDef.nYmRaw<=0)
+		{
+			continue;
+		}
+		iItem.nDeviceNo = YmDef.nDeviceNo;
+		iItem.MaxBuyNum = (int)YmDef.nYmRaw;
+		m_vecRecon.push_back(iItem);
 	}
-	pByte += sizeof(DWORD);
+	LeaveCriticalSection(&pDlg->m_pCRedisRecvSample->m_csDeviceRecord);
+	return (int)m_vecRecon.size();
+}
 
-	// ¼
-	DWORD dwRecordNum = *((int*)pByte);
-	if ((iMaxRsCount > 0) && (dwRecordNum != iMaxRsCount))
+UINT CSaveYmDataThread::ReconWorkerProc(LPVOID pParam)
+{
+	CSaveYmDataThread* pThis = (CSaveYmDataThread*)pParam;
+	int nDevNum = (int)pThis->m_vecRecon.size();
+	HANDLE hPipe = NULL;
+	while (1)
 	{
-		delete[] pRead;
-		pRead = NULL;
-		//CloseHandle(hPipe);
-		return FALSE;
+		int nBatch = InterlockedIncrement(&pThis->m_nNextBatch) - 1;
+		int nBegin = nBatch*pThis->m_nBatchDevices;
+		if (nBegin>=nDevNum)
+		{
+			break;
+		}
+		int nEnd = min(nBegin+pThis->m_nBatchDevices,nDevNum);
+		if (hPipe == NULL)
+		{
+			hPipe = OpenRealDataPipe();
+		}
+		if (hPipe == NULL || !pThis->QueryPaymentBatch(hPipe,nBegin,nEnd))
+		{
+			//失败的批次本轮不招，管道重开后继续下一批
+			InterlockedIncrement(&pThis->m_nFailedBatch);
+			ReguTrace(SQLERRO,"对账查询失败:设备[%d,%d)",nBegin,nEnd);
+			if (hPipe != NULL)
+			{
+				CloseHandle(hPipe);
+				hPipe = NULL;
+			}
+		}
 	}
-	pByte += sizeof(DWORD);
-
-
-	// ѯд뵽
-	if (dwRecordNum==MaxBuyNum)
+	if (hPipe != NULL)
 	{
-		delete[] pRead;
-		pRead = NULL;
-		//CloseHandle(hPipe);
-		return TRUE;
+		CloseHandle(hPipe);
+		hPipe = NULL;
 	}
-	if ((MaxBuyNum - dwRecordNum)>10)
+	return 0;
+}
+
+//一条语句取回[nBegin,nEnd)各设备的充值记录数和最近10次购电的记录位图，由CPayReconRule算出要招的条数。
+//每个批次只由一个查询线程写，不需要加锁
+BOOL CSaveYmDataThread::QueryPaymentBatch(HANDLE hPipe,int nBegin,int nEnd)
+{
+	CString strQuery = _T("");
+	CPayReconRule::BuildQuery(strQuery,&m_vecRecon[nBegin],nEnd-nBegin);
+	BYTE* pRead = (BYTE*)GetMessage_RecordOfSql(hPipe,strQuery);
+	if (NULL == pRead)
 	{
-		delete[] pRead;
-		pRead = NULL;
-		//CloseHandle(hPipe);
-		return TRUE;
+		return FALSE;
 	}
-	TCHAR *tValue = new TCHAR[1024+1];
-	if (tValue == NULL)
+	CRecordSetReader rs;
+	if (!rs.Attach(pRead,CRecordSetReader::GetReplyLen(pRead),3))
 	{
 		delete[] pRead;
 		pRead = NULL;
-		//CloseHandle(hPipe);
 		return FALSE;
 	}
+	CPayReconRule::Evaluate(rs,&m_vecRecon[nBegin],nEnd-nBegin);
+	delete[] pRead;
+	pRead = NULL;
+	return TRUE;
+}
 
-	int ChargeCnt[10] = {0};
-	for (int i=0;i<(int)dwRecordNum&&i<10;i++)
+//每投递m_nRecallBatch条命令唤醒一次发送线程并间隔m_nRecallInterval，避免同时向前置下发太多招测
+void CSaveYmDataThread::QueueRecallCommands()
+{
+	CTSSampleDataSvrDlg* pDlg = (CTSSampleDataSvrDlg*)AfxGetApp()->m_pMainWnd;
+	int nQueued = 0;
+	int nInBatch = 0;
+	for (size_t n=0;n<m_vecRecon.size();n++)
 	{
-		ZeroMemory(tValue,1024+1);
-		memcpy(tValue, pByte, pHead->DataLen);
-		int iCount = (int)*((DWORD *)tValue);
-		pByte += pHead->DataLen;
-		if ((MaxBuyNum-iCount)<0)
+		const PayReconItem &iItem = m_vecRecon[n];
+		if (iItem.CallNum<=0)
 		{
 			continue;
 		}
-		ChargeCnt[MaxBuyNum-iCount] = iCount;
-	}
-	CallNum = 0;
-	for (int i=0;i<MaxBuyNum&&i<10;i++)
-	{
-		if (ChargeCnt[i]==0)
+		ProtocolCallItem *pItem = new ProtocolCallItem;
+		if (NULL==pItem)
+		{
+			continue;
+		}
+		BYTE LowRtu = iItem.iStationId%256;
+		BYTE HighRtu = iItem.iStationId/256;
+		memset(pItem,0,sizeof(ProtocolCallItem));
+		pItem->m_nType = 0xE1;//MSW 150828,加注释，0xE1-召唤充值记录的标志
+		pItem->m_nDeviceNo = iItem.nDeviceNo;    //设备表第一列 Id
+		pItem->m_nStationNum = iItem.iStationId;
+
+		SocketMsgPrepayRecord iPrepayRecord ;
+		memset(&iPrepayRecord,0,sizeof(SocketMsgPrepayRecord));
+		iPrepayRecord.btRtuNo = LowRtu;     //==m_nStationNum
+		iPrepayRecord.btEndNo = 0xff;
+		iPrepayRecord.btForeNo = HighRtu;
+		iPrepayRecord.nDevNo = iItem.iDevNo;    //设备表第二列 deviceNo
+		iPrepayRecord.wdYjNum = iItem.CallNum;
+		memcpy(pItem->m_nBuffer,&iPrepayRecord,sizeof(SocketMsgPrepayRecord)-sizeof(SocketPrepayRecordUnit));
+
+		ReguTrace(Config,"招充值记录DevId:%d,条数%d!",iItem.iDevId,iItem.CallNum);
+		if (!pDlg->m_pCCSendP2pTask->m_RecordQueue.PushWait(pItem,QUEUE_PUSH_TIMEOUT))
+		{
+			ReguTrace(ERRO,"招充值记录队列已满,丢弃 DevId:%d!",iItem.iDevId);
+			delete pItem;
+			pItem = NULL;
+			continue;
+		}
+		nQueued++;
+		if (++nInBatch>=m_nRecallBatch)
 		{
-			CallNum = i + 1;
+			SetEvent(pDlg->m_pCCSendP2pTask->m_ProcessDataEvent);
+			nInBatch = 0;
+			Sleep(m_nRecallInterval);
 		}
 	}
-	delete []tValue;
-	tValue = NULL;
-	delete[] pRead;
-	pRead = NULL;
-	//CloseHandle(hPipe);
-
-	return TRUE;
+	if (nInBatch>0)
+	{
+		SetEvent(pDlg->m_pCCSendP2pTask->m_ProcessDataEvent);
+	}
+	ReguTrace(Config,"招充值记录命令投递%d条",nQueued);
 }
 int CSaveYmDataThread::ExitInstance()
 {
-	// TODO: ڴִ߳
+	// TODO: 在此执行任意逐线程清理
 	return CWinThread::ExitInstance();
 }
 
@@ -486,4 +438,4 @@ BEGIN_MESSAGE_MAP(CSaveYmDataThread, CWinThread)
 END_MESSAGE_MAP()
 
 
-// CSaveYmDataThread Ϣ
+// CSaveYmDataThread 消息处理程序
@@ -1,4 +1,5 @@
 #pragma once
+#include "PayReconRule.h"
 
 struct	DevStaionInfo
 {
@@ -7,23 +8,43 @@ struct	DevStaionInfo
 	int	iStationId;
 };
 
+#define PAYRECON_DEFAULT_WORKERS	4		//对账查询线程数，同时也是同时打开的管道数
+#define PAYRECON_MAX_WORKERS		8
+#define PAYRECON_BATCH_DEVICES		500		//单条对账查询的设备数(VALUES最多1000行)
+#define PAYRECON_RECALL_BATCH		20		//每批投递给发送线程的招充值记录命令数
+#define PAYRECON_RECALL_INTERVAL	1000	//两批招充值记录命令之间的间隔(ms)
+
 // CSaveYmDataThread
+// 每天10点把电表购电次数与TE_PAYMENT_PAYRECORD中的充值记录对账，缺记录的设备下发招充值记录命令。
+// 设备按PAYRECON_BATCH_DEVICES分批，多个查询线程各用一个管道并行查询，每批一条语句取回各设备的记录数
+// 和最近10次充值的存在位图，在内存中算出要招的条数，最后按批投递给发送线程
 
 class CSaveYmDataThread : public CWinThread
 {
 	DECLARE_DYNCREATE(CSaveYmDataThread)
 
 public:
-	CSaveYmDataThread();           // ̬ʹõܱĹ캯
+	CSaveYmDataThread();           // 动态创建所使用的受保护的构造函数
 	virtual ~CSaveYmDataThread();
 
 public:
-	BOOL CheckPaymentRecord(int iDevId,int MaxBuyNum,int& CallNum);
 	BOOL GetDeviceId();
+	void RunReconciliation();
+	int BuildReconItems();
+	BOOL QueryPaymentBatch(HANDLE hPipe,int nBegin,int nEnd);
+	void QueueRecallCommands();
+	static UINT ReconWorkerProc(LPVOID pParam);
 	virtual BOOL InitInstance();
 	virtual int ExitInstance();
 public:
 	CArray<DevStaionInfo,DevStaionInfo&> m_DevIdCArray ;
+	std::vector<PayReconItem> m_vecRecon;
+	volatile LONG m_nNextBatch;			//下一个待查询批次，查询线程取批次时原子递增
+	volatile LONG m_nFailedBatch;
+	int m_nWorkerNum;
+	int m_nBatchDevices;
+	int m_nRecallBatch;
+	int m_nRecallInterval;
 protected:
 	DECLARE_MESSAGE_MAP()
 };
@@ -0,0 +1,177 @@
+#pragma once
+
+#define SOCKETFRAME_LEN_UNKNOWN		-1		//收到的字节数未知，只能按报文头给出的长度解析
+#define SOCKETFRAME_MAXLEN			(sizeof(SocketMsgHead)+0xFFFF)	//NetMessageHead.Length的上限，正文长度wdLen是WORD
+#define SOCKETFRAME_DUMP_MAX		256		//异常报文最多输出的字节数
+
+//报文解析结果
+enum
+{
+	SOCKETFRAME_OK = 0,
+	SOCKETFRAME_SHORT,			//报文头不完整或正文超出报文长度
+	SOCKETFRAME_BADCOUNT,		//单元个数与正文长度不符
+	SOCKETFRAME_UNKNOWN,		//不认识的报文类型，正文有效但不解析单元
+	SOCKETFRAME_OVERSIZE,		//NetMessageHead.Length超过SOCKETFRAME_MAXLEN
+};
+
+// 正文中定长单元数组(遥信/遥脉/充值记录)的只读视图，直接指向接收缓冲区，不复制
+struct SocketUnitSpan
+{
+	const BYTE *pData;
+	int nCount;
+	int nStride;
+
+	template <class T>
+	const T* At(int i) const
+	{
+		return (const T*)(pData + i*nStride);
+	}
+};
+
+struct SocketFrameView
+{
+	BYTE btType;
+	const SocketMsgHead *pHead;
+	const BYTE *pMsg;			//SocketMsgHead之后的正文
+	int nMsgLen;
+	int nFrameLen;				//已校验可以访问的报文长度(NetMessageHead+Length)，校验前为0
+	SocketUnitSpan Units;
+};
+
+// 各报文类型的正文布局：RTU号和前置号字段的偏移、单元个数字段(WORD)的偏移、单元数组的偏移和单元长度
+struct SocketFrameLayout
+{
+	BYTE btType;
+	LPCTSTR szName;
+	int nRtuOffset;
+	int nForeOffset;
+	int nCountOffset;
+	int nUnitOffset;
+	int nUnitSize;
+};
+
+// CSocketFrameParser
+// 校验并解析从Redis取到的NetMessageHead + SocketMsgHead + 正文报文。
+// NetMessageHead.Length不得超出收到的字节数和SOCKETFRAME_MAXLEN，正文不得超出Length给出的报文范围，
+// 单元数组不得超出SocketMsgHead.wdLen给出的正文长度，校验通过后处理函数直接按视图访问单元，不再自行计算偏移。
+// 收到的字节数未知时(经软总线逐条取到的报文)传SOCKETFRAME_LEN_UNKNOWN，只能相信报文头中的长度。
+//
+// 用法：
+//	SocketFrameView Frame;
+//	if (CSocketFrameParser::Parse(pBuf, nLen, Frame) == SOCKETFRAME_OK)
+//	{
+//		for (int i=0; i<Frame.Units.nCount; i++)
+//		{
+//			const SocketGroupYxUnit *YxUnit = Frame.Units.At<SocketGroupYxUnit>(i);
+//		}
+//	}
+
+class CSocketFrameParser
+{
+public:
+	static const SocketFrameLayout* GetLayout(BYTE btType)
+	{
+		static const SocketFrameLayout Layouts[] =
+		{
+			{SOCKET_MSG_GROUP_YXDATA, _T("YX"), offsetof(SocketMsgGroupYxEx,btRtuNo), offsetof(SocketMsgGroupYxEx,btForeNo), offsetof(SocketMsgGroupYxEx,wdYxNum), offsetof(SocketMsgGroupYxEx,YxUnit), sizeof(SocketGroupYxUnit)},
+			{SOCKET_MSG_GROUP_YMDATA_EX_DATE, _T("YM"), offsetof(SocketMsgGroupYmDataEx_DATE,btRtuNo), offsetof(SocketMsgGroupYmDataEx_DATE,btForeNo), offsetof(SocketMsgGroupYmDataEx_DATE,wdYmNum), offsetof(SocketMsgGroupYmDataEx_DATE,YmUnitEx), sizeof(SocketGroupYmUnitEx)},
+			{SOCKET_MSG_PREPAYRECORD, _T("PAYRECORD"), offsetof(SocketMsgPrepayRecord,btRtuNo), offsetof(SocketMsgPrepayRecord,btForeNo), offsetof(SocketMsgPrepayRecord,wdYjNum), offsetof(SocketMsgPrepayRecord,prUnit), sizeof(SocketPrepayRecordUnit)},
+		};
+		for (int i=0; i<(int)(sizeof(Layouts)/sizeof(Layouts[0])); i++)
+		{
+			if (Layouts[i].btType == btType)
+			{
+				return &Layouts[i];
+			}
+		}
+		return NULL;
+	}
+
+	static LPCTSTR GetTypeName(BYTE btType)
+	{
+		const SocketFrameLayout *pLayout = GetLayout(btType);
+		return pLayout ? pLayout->szName : _T("UNKNOWN");
+	}
+
+	//报文所属的厂站号(前置号*256+RTU号)，与各处理函数的计算方式一致；不认识的类型返回-1
+	static int GetRtuNo(const SocketFrameView &Frame)
+	{
+		const SocketFrameLayout *pLayout = GetLayout(Frame.btType);
+		if (pLayout == NULL || Frame.pMsg == NULL)
+		{
+			return -1;
+		}
+		if (pLayout->nRtuOffset >= Frame.nMsgLen || pLayout->nForeOffset >= Frame.nMsgLen)
+		{
+			return -1;
+		}
+		return Frame.pMsg[pLayout->nForeOffset]*256 + Frame.pMsg[pLayout->nRtuOffset];
+	}
+
+	//异常报文可以安全输出的字节数：优先用已校验的报文长度，其次用收到的字节数，都不知道时只输出NetMessageHead
+	static int GetDumpLen(const SocketFrameView &Frame, int nLen)
+	{
+		int nDumpLen = Frame.nFrameLen;
+		if (nDumpLen <= 0)
+		{
+			nDumpLen = (nLen >= 0) ? nLen : (int)sizeof(NetMessageHead);
+		}
+		return nDumpLen < SOCKETFRAME_DUMP_MAX ? nDumpLen : SOCKETFRAME_DUMP_MAX;
+	}
+
+	//nLen为pBuf中收到的字节数，未知时传SOCKETFRAME_LEN_UNKNOWN
+	static int Parse(const BYTE *pBuf, int nLen, SocketFrameView &Frame)
+	{
+		memset(&Frame, 0, sizeof(SocketFrameView));
+		if (pBuf == NULL || (nLen >= 0 && nLen < (int)sizeof(NetMessageHead)))
+		{
+			return SOCKETFRAME_SHORT;
+		}
+		//Length为NetMessageHead之后的长度，其中包含SocketMsgHead和正文；先按整数比较，避免超长的Length使指针越界
+		DWORD dwLength = ((const NetMessageHead*)pBuf)->Length;
+		if (dwLength > SOCKETFRAME_MAXLEN)
+		{
+			return SOCKETFRAME_OVERSIZE;
+		}
+		int nFrameLen = (int)(sizeof(NetMessageHead) + dwLength);
+		if (nLen >= 0 && nFrameLen > nLen)
+		{
+			return SOCKETFRAME_SHORT;
+		}
+		Frame.nFrameLen = nFrameLen;
+		if (dwLength < sizeof(SocketMsgHead))
+		{
+			return SOCKETFRAME_SHORT;
+		}
+		Frame.pHead = (const SocketMsgHead*)(pBuf + sizeof(NetMessageHead));
+		Frame.btType = Frame.pHead->btType;
+		Frame.pMsg = pBuf + sizeof(NetMessageHead) + sizeof(SocketMsgHead);
+		Frame.nMsgLen = Frame.pHead->wdLen;
+		if (sizeof(SocketMsgHead) + Frame.nMsgLen > dwLength)
+		{
+			return SOCKETFRAME_SHORT;
+		}
+		const BYTE *pMsg = Frame.pMsg;
+		const SocketFrameLayout *pLayout = GetLayout(Frame.btType);
+		if (pLayout == NULL)
+		{
+			return SOCKETFRAME_UNKNOWN;
+		}
+		if (pLayout->nUnitOffset > Frame.nMsgLen || pLayout->nCountOffset + (int)sizeof(WORD) > Frame.nMsgLen)
+		{
+			return SOCKETFRAME_SHORT;
+		}
+		//报文按1字节对齐，单元个数字段不一定在偶地址上
+		WORD wdCount = 0;
+		memcpy(&wdCount, pMsg + pLayout->nCountOffset, sizeof(WORD));
+		int nCount = wdCount;
+		if (pLayout->nUnitOffset + nCount*pLayout->nUnitSize > Frame.nMsgLen)
+		{
+			return SOCKETFRAME_BADCOUNT;
+		}
+		Frame.Units.pData = pMsg + pLayout->nUnitOffset;
+		Frame.Units.nCount = nCount;
+		Frame.Units.nStride = pLayout->nUnitSize;
+		return SOCKETFRAME_OK;
+	}
+};
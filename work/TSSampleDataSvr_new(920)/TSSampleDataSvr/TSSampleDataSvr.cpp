@@ -1,5 +1,5 @@
 
-// TSSampleDataSvr.cpp : ӦóΪ
+// TSSampleDataSvr.cpp : 定义应用程序的类行为。
 //
 
 #include "stdafx.h"
@@ -20,31 +20,32 @@ BEGIN_MESSAGE_MAP(CTSSampleDataSvrApp, CWinAppEx)
 END_MESSAGE_MAP()
 
 
-// CTSSampleDataSvrApp 
+// CTSSampleDataSvrApp 构造
 
 CTSSampleDataSvrApp::CTSSampleDataSvrApp()
 {
-	// TODO: ڴ˴ӹ룬
-	// Ҫĳʼ InitInstance 
+	// TODO: 在此处添加构造代码，
+	// 将所有重要的初始化放置在 InitInstance 中
 	bExitFlag = FALSE;
 }
 
 
-// Ψһһ CTSSampleDataSvrApp 
+// 唯一的一个 CTSSampleDataSvrApp 对象
 
 CTSSampleDataSvrApp theApp;
 
 //Gongc ADD 20151021
-extern CLog *g_log ;
+extern CAsyncLog *g_log ;
 long __stdcall exception_cb(_EXCEPTION_POINTERS* excp)   
 {	
-	//AfxMessageBox(_T("ӭ쳣.."));
+	//AfxMessageBox(_T("欢迎来到天溯异常捕获中心.."));
 // 	CTSSampleDataSvrApp* pApp = (CTSSampleDataSvrApp*)AfxGetApp();
 	if(g_log==NULL)
 	{
-		g_log = new CLog(_T("\\TSSampleDataSvr"));
+		g_log = new CAsyncLog(_T("\\TSSampleDataSvr"));
 	}
-	ReguTrace(ERRO,"쳣쳣");
+	ReguTrace(ERRO,"程序异常！进入异常处理函数。");
+	g_log->Flush();
 	TCHAR szDirectory[MAX_PATH];
 	GetModuleFileName(GetModuleHandle(NULL),szDirectory,MAX_PATH);
 	CString strPath = szDirectory;	
@@ -79,24 +80,24 @@ long __stdcall exception_cb(_EXCEPTION_POINTERS* excp)
 		::CloseHandle(hFile);
 	}
 	/*
-	EXCEPTION_EXECUTE_HANDLER equ 1 ʾѾ쳣,ŵؽ 
-	EXCEPTION_CONTINUE_SEARCH equ 0 ʾҲ,,windowsĬϵĴʾһ, 
-	EXCEPTION_CONTINUE_EXECUTION equ -1 ʾѾ޸,쳣ִ  
+	EXCEPTION_EXECUTE_HANDLER equ 1 表示我已经处理了异常,可以优雅地结束了 
+	EXCEPTION_CONTINUE_SEARCH equ 0 表示我不处理,其他人来吧,于是windows调用默认的处理程序显示一个错误框,并结束 
+	EXCEPTION_CONTINUE_EXECUTION equ -1 表示错误已经被修复,请从异常发生处继续执行  
 	*/
-	ReguTrace(ERRO,"쳣");
+	ReguTrace(ERRO,"异常处理函数结束");
 	return	 EXCEPTION_EXECUTE_HANDLER;   
 }
-// CTSSampleDataSvrApp ʼ
+// CTSSampleDataSvrApp 初始化
 
 BOOL CTSSampleDataSvrApp::InitInstance()
 {
-	// һ Windows XP ϵӦó嵥ָҪ
-	// ʹ ComCtl32.dll 汾 6 ߰汾ÿӻʽ
-	//Ҫ InitCommonControlsEx()򣬽޷ڡ
+	// 如果一个运行在 Windows XP 上的应用程序清单指定要
+	// 使用 ComCtl32.dll 版本 6 或更高版本来启用可视化方式，
+	//则需要 InitCommonControlsEx()。否则，将无法创建窗口。
 	INITCOMMONCONTROLSEX InitCtrls;
 	InitCtrls.dwSize = sizeof(InitCtrls);
-	// ΪҪӦóʹõ
-	// ؼࡣ
+	// 将它设置为包括所有要在应用程序中使用的
+	// 公共控件类。
 	InitCtrls.dwICC = ICC_WIN95_CLASSES;
 	InitCommonControlsEx(&InitCtrls);
 
@@ -104,13 +105,13 @@ BOOL CTSSampleDataSvrApp::InitInstance()
 
 	AfxEnableControlContainer();
 
-	// ׼ʼ
-	// δʹЩܲϣС
-	// տִļĴСӦƳ
-	// Ҫضʼ
-	// ڴ洢õע
-	// TODO: Ӧʵ޸ĸַ
-	// ޸Ϊ˾֯
+	// 标准初始化
+	// 如果未使用这些功能并希望减小
+	// 最终可执行文件的大小，则应移除下列
+	// 不需要的特定初始化例程
+	// 更改用于存储设置的注册表项
+	// TODO: 应适当修改该字符串，
+	// 例如修改为公司或组织名
 	SetRegistryKey(_T("TSSampleDataSvr.exe"));
 	SetErrorMode(1|2);
 	SetUnhandledExceptionFilter(exception_cb);   //Gongc ADD 20151021
@@ -119,16 +120,16 @@ BOOL CTSSampleDataSvrApp::InitInstance()
 	INT_PTR nResponse = dlg.DoModal();
 	if (nResponse == IDOK)
 	{
-		// TODO: ڴ˷ôʱ
-		//  ȷرնԻĴ
+		// TODO: 在此放置处理何时用
+		//  “确定”来关闭对话框的代码
 	}
 	else if (nResponse == IDCANCEL)
 	{
-		// TODO: ڴ˷ôʱ
-		//  ȡرնԻĴ
+		// TODO: 在此放置处理何时用
+		//  “取消”来关闭对话框的代码
 	}
 
-	// ڶԻѹرգԽ FALSE Ա˳Ӧó
-	//  ӦóϢá
+	// 由于对话框已关闭，所以将返回 FALSE 以便退出应用程序，
+	//  而不是启动应用程序的消息泵。
 	return FALSE;
 }
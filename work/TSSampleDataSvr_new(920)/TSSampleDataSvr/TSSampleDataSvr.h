@@ -1,17 +1,17 @@
 
-// TSSampleDataSvr.h : PROJECT_NAME Ӧóͷļ
+// TSSampleDataSvr.h : PROJECT_NAME 应用程序的主头文件
 //
 
 #pragma once
 
 #ifndef __AFXWIN_H__
-	#error "ڰļ֮ǰstdafx.h PCH ļ"
+	#error "在包含此文件之前包含“stdafx.h”以生成 PCH 文件"
 #endif
 
-#include "resource.h"		// 
+#include "resource.h"		// 主符号
 
 // CTSSampleDataSvrApp:
-// йشʵ֣ TSSampleDataSvr.cpp
+// 有关此类的实现，请参阅 TSSampleDataSvr.cpp
 //
 
 class CTSSampleDataSvrApp : public CWinAppEx
@@ -19,11 +19,11 @@ class CTSSampleDataSvrApp : public CWinAppEx
 public:
 	CTSSampleDataSvrApp();
 
-// д
+// 重写
 public:
 	virtual BOOL InitInstance();
 	BOOL bExitFlag;
-// ʵ
+// 实现
 public:
 	DECLARE_MESSAGE_MAP()
 };
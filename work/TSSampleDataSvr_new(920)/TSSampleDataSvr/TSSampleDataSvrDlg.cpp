@@ -1,5 +1,5 @@
 
-// TSSampleDataSvrDlg.cpp : ʵļ
+// TSSampleDataSvrDlg.cpp : 实现文件
 //
 
 #include "stdafx.h"
@@ -10,21 +10,23 @@
 #define new DEBUG_NEW
 #endif
 
+extern CAsyncLog *g_log;
 
-// Ӧó򡰹ڡ˵ CAboutDlg Ի
+
+// 用于应用程序“关于”菜单项的 CAboutDlg 对话框
 
 class CAboutDlg : public CDialog
 {
 public:
 	CAboutDlg();
 
-	// Ի
+	// 对话框数据
 	enum { IDD = IDD_ABOUTBOX };
 
 protected:
-	virtual void DoDataExchange(CDataExchange* pDX);    // DDX/DDV ֧
+	virtual void DoDataExchange(CDataExchange* pDX);    // DDX/DDV 支持
 
-	// ʵ
+	// 实现
 protected:
 	DECLARE_MESSAGE_MAP()
 };
@@ -48,7 +50,7 @@ BEGIN_MESSAGE_MAP(CAboutDlg, CDialog)
 END_MESSAGE_MAP()
 
 
-// CTSSampleDataSvrDlg Ի
+// CTSSampleDataSvrDlg 对话框
 
 
 
@@ -57,6 +59,99 @@ CTSSampleDataSvrDlg::CTSSampleDataSvrDlg(CWnd* pParent /*=NULL*/)
 : CDialog(CTSSampleDataSvrDlg::IDD, pParent)
 {
 	m_hIcon = AfxGetApp()->LoadIcon(IDR_MAINFRAME);
+	m_nProcessThreadNum = THREAD_NUM;
+	m_bPartition = FALSE;
+	m_nRedisBatchPop = 0;
+	m_nRedisBlockTime = 1;
+	m_bRedisPopRight = FALSE;
+	m_nRtdbFrameRecords = RTDB_FRAME_MAXRECORDS;
+	m_nRtdbWindow = RTDB_WINDOW_DEFAULT;
+	m_pSampleDispatcher = NULL;
+	memset(m_pCProcessThread,0,sizeof(m_pCProcessThread));
+}
+
+//处理线程数和分区模式从emscfg.ini的[PROCESS]段读取，ThreadNum为0时按CPU核数；
+//Redis批量取数参数从[REDISCONFIG]段读取，实时库更新报文参数从[RTDBFRAME]段读取
+void CTSSampleDataSvrDlg::LoadProcessConfig()
+{
+	m_nProcessThreadNum = THREAD_NUM;
+	m_bPartition = FALSE;
+	m_nRedisBatchPop = 0;
+	m_nRedisBlockTime = 1;
+	m_bRedisPopRight = FALSE;
+	m_nRtdbFrameRecords = RTDB_FRAME_MAXRECORDS;
+	m_nRtdbWindow = RTDB_WINDOW_DEFAULT;
+	TCHAR szDirectory[MAX_PATH];
+	memset(szDirectory,0,sizeof(TCHAR)*MAX_PATH);
+	if (GetModuleFileName(NULL,szDirectory,MAX_PATH))
+	{
+		CString strPath = szDirectory;
+		int iIndex = strPath.ReverseFind('\\');
+		if (iIndex > 0)
+		{
+			CString strCountPath = strPath.Left(iIndex) + _T("\\parameter\\emscfg.ini");
+			m_nProcessThreadNum = GetPrivateProfileInt(_T("PROCESS"),_T("ThreadNum"),THREAD_NUM,strCountPath);
+			m_bPartition = GetPrivateProfileInt(_T("PROCESS"),_T("Partition"),0,strCountPath)!=0;
+			m_nRedisBatchPop = GetPrivateProfileInt(_T("REDISCONFIG"),_T("BatchPop"),0,strCountPath);
+			m_nRedisBlockTime = GetPrivateProfileInt(_T("REDISCONFIG"),_T("BlockTime"),1,strCountPath);
+			m_bRedisPopRight = GetPrivateProfileInt(_T("REDISCONFIG"),_T("PopRight"),0,strCountPath)!=0;
+			m_nRtdbFrameRecords = GetPrivateProfileInt(_T("RTDBFRAME"),_T("RecordsPerFrame"),RTDB_FRAME_MAXRECORDS,strCountPath);
+			m_nRtdbWindow = GetPrivateProfileInt(_T("RTDBFRAME"),_T("Window"),RTDB_WINDOW_DEFAULT,strCountPath);
+		}
+	}
+	if (m_nProcessThreadNum == 0)
+	{
+		SYSTEM_INFO SysInfo;
+		GetSystemInfo(&SysInfo);
+		m_nProcessThreadNum = (int)SysInfo.dwNumberOfProcessors;
+	}
+	if (m_nProcessThreadNum < 1 || m_nProcessThreadNum > THREAD_NUM_MAX)
+	{
+		m_nProcessThreadNum = THREAD_NUM;
+	}
+	if (m_nRedisBatchPop < 0 || m_nRedisBatchPop > REDIS_BATCH_POP_MAX)
+	{
+		m_nRedisBatchPop = REDIS_BATCH_POP_MAX;
+	}
+	if (m_nRedisBlockTime < 1 || m_nRedisBlockTime > REDIS_BLOCK_MAX_SEC)
+	{
+		m_nRedisBlockTime = 1;
+	}
+	if (m_nRtdbFrameRecords < 1)
+	{
+		m_nRtdbFrameRecords = RTDB_FRAME_MAXRECORDS;
+	}
+	if (m_nRtdbWindow < 0 || m_nRtdbWindow > RTDB_WINDOW_MAX)
+	{
+		m_nRtdbWindow = RTDB_WINDOW_DEFAULT;
+	}
+	ReguTrace(Config,"处理线程%d个,%s",m_nProcessThreadNum,m_bPartition?_T("按厂站号分区"):_T("各线程直接读取Redis"));
+	if (m_nRedisBatchPop > 0)
+	{
+		ReguTrace(Config,"Redis批量取数:每次%d条,空队列阻塞%d秒,%s",m_nRedisBatchPop,m_nRedisBlockTime,m_bRedisPopRight?_T("从右端取"):_T("从左端取"));
+	}
+}
+
+//退出前等待各处理线程把已取到的报文处理完
+BOOL CTSSampleDataSvrDlg::WaitProcessIdle()
+{
+	while(1)
+	{
+		int Index = 0;
+		for (int i=0;i<m_nProcessThreadNum;i++)
+		{
+			if (m_pCProcessThread[i]==NULL||m_pCProcessThread[i]->GetPendingCount()<=0)
+			{
+				Index++;
+			}
+		}
+		if (Index==m_nProcessThreadNum)
+		{
+			break;
+		}
+		Sleep(100);
+	}
+	return TRUE;
 }
 
 void CTSSampleDataSvrDlg::DoDataExchange(CDataExchange* pDX)
@@ -77,14 +172,14 @@ BEGIN_MESSAGE_MAP(CTSSampleDataSvrDlg, CDialog)
 END_MESSAGE_MAP()
 
 
-// CTSSampleDataSvrDlg Ϣ
+// CTSSampleDataSvrDlg 消息处理程序
 
 BOOL CTSSampleDataSvrDlg::OnInitDialog()
 {
 	CDialog::OnInitDialog();
-	// ...˵ӵϵͳ˵С
+	// 将“关于...”菜单项添加到系统菜单中。
 
-	// IDM_ABOUTBOX ϵͳΧڡ
+	// IDM_ABOUTBOX 必须在系统命令范围内。
 	ASSERT((IDM_ABOUTBOX & 0xFFF0) == IDM_ABOUTBOX);
 	ASSERT(IDM_ABOUTBOX < 0xF000);
 
@@ -102,13 +197,13 @@ BOOL CTSSampleDataSvrDlg::OnInitDialog()
 		}
 	}
 
-	// ô˶ԻͼꡣӦóڲǶԻʱܽԶ
-	//  ִд˲
-	SetIcon(m_hIcon, TRUE);			// ôͼ
-	SetIcon(m_hIcon, FALSE);		// Сͼ
+	// 设置此对话框的图标。当应用程序主窗口不是对话框时，框架将自动
+	//  执行此操作
+	SetIcon(m_hIcon, TRUE);			// 设置大图标
+	SetIcon(m_hIcon, FALSE);		// 设置小图标
 
-	// TODO: ڴӶĳʼ
-	m_TrayIcon.Create(this,WM_ICON_NOTIFY,_T(""),m_hIcon,IDR_MENU1); 
+	// TODO: 在此添加额外的初始化代码
+	m_TrayIcon.Create(this,WM_ICON_NOTIFY,_T("冻结数据入库服务程序"),m_hIcon,IDR_MENU1); 
 	PostMessage(WM_SYSCOMMAND,SC_MINIMIZE,0);   
 	ShowWindow(SW_HIDE);
 
@@ -120,6 +215,8 @@ BOOL CTSSampleDataSvrDlg::OnInitDialog()
 	m_pCSaveYmDataThread = new CSaveYmDataThread;
 	m_pCUpdateRTDBThread = NULL;
 	m_pCUpdateRTDBThread = new CUpDateRTDB;
+	m_pSampleBatchWriter = NULL;
+	m_pSampleBatchWriter = new CSampleBatchWriter;
 	if (m_pCCSendP2pTask)
 	{
 		m_pCCSendP2pTask->CreateThread();
@@ -135,22 +232,43 @@ BOOL CTSSampleDataSvrDlg::OnInitDialog()
 		m_pCUpdateRTDBThread->CreateThread();
 	}
 
-	for (int i=0;i<THREAD_NUM;i++)
+	if (m_pSampleBatchWriter)
+	{
+		m_pSampleBatchWriter->CreateThread();
+	}
+
+	LoadProcessConfig();
+	for (int i=0;i<m_nProcessThreadNum;i++)
 	{
 		m_pCProcessThread[i] = NULL;
 		m_pCProcessThread[i] = new CProcessThread();
 		m_pCProcessThread[i]->m_Index = i;
+		m_pCProcessThread[i]->m_bPartition = m_bPartition;
+		m_pCProcessThread[i]->m_nBatchPop = m_nRedisBatchPop;
+		m_pCProcessThread[i]->m_nBlockTime = m_nRedisBlockTime;
+		m_pCProcessThread[i]->m_BatchConsumer.m_bPopRight = m_bRedisPopRight;
+		m_pCProcessThread[i]->m_nRtdbFrameRecords = m_nRtdbFrameRecords;
+		m_pCProcessThread[i]->m_nRtdbWindow = m_nRtdbWindow;
 		if (m_pCProcessThread[i]!=NULL)
 		{
 			m_pCProcessThread[i]->CreateThread();
 		}
 	}
+	if (m_bPartition)
+	{
+		m_pSampleDispatcher = new CSampleDispatcher;
+		m_pSampleDispatcher->m_nWorkerNum = m_nProcessThreadNum;
+		m_pSampleDispatcher->m_nBatchPop = m_nRedisBatchPop;
+		m_pSampleDispatcher->m_nBlockTime = m_nRedisBlockTime;
+		m_pSampleDispatcher->m_BatchConsumer.m_bPopRight = m_bRedisPopRight;
+		m_pSampleDispatcher->CreateThread();
+	}
 
 	if (m_pCSaveYmDataThread)
 	{
 		m_pCSaveYmDataThread->CreateThread();
 	}
-	return TRUE;  // ǽõؼ򷵻 TRUE
+	return TRUE;  // 除非将焦点设置到控件，否则返回 TRUE
 }
 
 void CTSSampleDataSvrDlg::OnSysCommand(UINT nID, LPARAM lParam)
@@ -179,19 +297,19 @@ void CTSSampleDataSvrDlg::OnSysCommand(UINT nID, LPARAM lParam)
 	}
 }
 
-// ԻСťҪĴ
-//  Ƹͼꡣʹĵ/ͼģ͵ MFC Ӧó
-//  ⽫ɿԶɡ
+// 如果向对话框添加最小化按钮，则需要下面的代码
+//  来绘制该图标。对于使用文档/视图模型的 MFC 应用程序，
+//  这将由框架自动完成。
 
 void CTSSampleDataSvrDlg::OnPaint()
 {
 	if (IsIconic())
 	{
-		CPaintDC dc(this); // ڻƵ豸
+		CPaintDC dc(this); // 用于绘制的设备上下文
 
 		SendMessage(WM_ICONERASEBKGND, reinterpret_cast<WPARAM>(dc.GetSafeHdc()), 0);
 
-		// ʹͼڹо
+		// 使图标在工作区矩形中居中
 		int cxIcon = GetSystemMetrics(SM_CXICON);
 		int cyIcon = GetSystemMetrics(SM_CYICON);
 		CRect rect;
@@ -199,7 +317,7 @@ void CTSSampleDataSvrDlg::OnPaint()
 		int x = (rect.Width() - cxIcon + 1) / 2;
 		int y = (rect.Height() - cyIcon + 1) / 2;
 
-		// ͼ
+		// 绘制图标
 		dc.DrawIcon(x, y, m_hIcon);
 	}
 	else
@@ -208,8 +326,8 @@ void CTSSampleDataSvrDlg::OnPaint()
 	}
 }
 
-//û϶Сʱϵͳô˺ȡù
-//ʾ
+//当用户拖动最小化窗口时系统调用此函数取得光标
+//显示。
 HCURSOR CTSSampleDataSvrDlg::OnQueryDragIcon()
 {
 	return static_cast<HCURSOR>(m_hIcon);
@@ -225,22 +343,10 @@ void CTSSampleDataSvrDlg::OnAbout1()
 void CTSSampleDataSvrDlg::OnExit()
 {
 	theApp.bExitFlag = TRUE;
-	while(1)
-	{
-		int Index = 0;
-		for (int i=0;i<THREAD_NUM;i++)
-		{
-			if (m_pCProcessThread[i]->m_RedisDataList.GetSize()<=0)
-			{
-				Index++;
-			}
-		}
-		if (Index==THREAD_NUM)
-		{
-			break;
-		}
-		Sleep(100);
-	}
+	WaitProcessIdle();
+	m_pSampleBatchWriter->Flush();
+	m_pCUpdateRTDBThread->Flush();
+	g_log->Flush();
 	Sleep(3000);
 	m_TrayIcon.RemoveIcon();
 	CDialog::OnDestroy();
@@ -264,25 +370,13 @@ void CTSSampleDataSvrDlg::OnShow()
 
 void CTSSampleDataSvrDlg::OnClose()
 {
-	// TODO: ڴϢ/Ĭֵ
+	// TODO: 在此添加消息处理程序代码和/或调用默认值
 	//ShowWindow(SW_MINIMIZE);
 	theApp.bExitFlag = TRUE;
-	while(1)
-	{
-		int Index = 0;
-		for (int i=0;i<THREAD_NUM;i++)
-		{
-			if (m_pCProcessThread[i]->m_RedisDataList.GetSize()<=0)
-			{
-				Index++;
-			}
-		}
-		if (Index==THREAD_NUM)
-		{
-			break;
-		}
-		Sleep(100);
-	}
+	WaitProcessIdle();
+	m_pSampleBatchWriter->Flush();
+	m_pCUpdateRTDBThread->Flush();
+	g_log->Flush();
 	Sleep(3000);
  	CDialog::OnClose();
 }
@@ -1,5 +1,5 @@
 
-// TSSampleDataSvrDlg.h : ͷļ
+// TSSampleDataSvrDlg.h : 头文件
 //
 
 #pragma once
@@ -8,37 +8,50 @@
 #include "ProcessThread.h"
 #include "SaveYmDataThread.h"
 #include "UpDateRTDB.h"
+#include "SampleBatchWriter.h"
+#include "SampleDispatcher.h"
 #include "TrayIcon.h"
 
-// CTSSampleDataSvrDlg Ի
+// CTSSampleDataSvrDlg 对话框
 class CTSSampleDataSvrDlg : public CDialog
 {
-// 
+// 构造
 public:
-	CTSSampleDataSvrDlg(CWnd* pParent = NULL);	// ׼캯
+	CTSSampleDataSvrDlg(CWnd* pParent = NULL);	// 标准构造函数
 
-// Ի
+// 对话框数据
 	enum { IDD = IDD_TSSAMPLEDATASVR_DIALOG };
 
 	protected:
-	virtual void DoDataExchange(CDataExchange* pDX);	// DDX/DDV ֧
+	virtual void DoDataExchange(CDataExchange* pDX);	// DDX/DDV 支持
 
 public:
 	CRedisRecvSample *m_pCRedisRecvSample;
 	CCSendP2pTask *m_pCCSendP2pTask;
-	CProcessThread *m_pCProcessThread[10];
+	CProcessThread *m_pCProcessThread[THREAD_NUM_MAX];
+	int m_nProcessThreadNum;
+	BOOL m_bPartition;					//分区模式：由m_pSampleDispatcher按厂站号把报文分给处理线程
+	int m_nRedisBatchPop;				//每次往返从Redis取的报文数，0表示经软总线逐条取
+	int m_nRedisBlockTime;				//批量模式下Redis为空时阻塞等待的秒数
+	BOOL m_bRedisPopRight;				//批量模式从列表右端取
+	int m_nRtdbFrameRecords;			//实时库更新报文每帧最多记录数
+	int m_nRtdbWindow;					//实时库更新报文同时等待应答的帧数，0为逐帧同步发送
+	CSampleDispatcher *m_pSampleDispatcher;
 	CSaveYmDataThread *m_pCSaveYmDataThread;
 	CUpDateRTDB *m_pCUpdateRTDBThread;
-// ʵ
+	CSampleBatchWriter *m_pSampleBatchWriter;
+// 实现
 protected:
 	LRESULT OnTrayNotification(WPARAM wParam,LPARAM lParam);
 	HICON m_hIcon;
 	CTrayIcon m_TrayIcon;
-	// ɵϢӳ亯
+	// 生成的消息映射函数
 	virtual BOOL OnInitDialog();
 	afx_msg void OnSysCommand(UINT nID, LPARAM lParam);
 	afx_msg void OnPaint();
 	afx_msg HCURSOR OnQueryDragIcon();
+	void LoadProcessConfig();
+	BOOL WaitProcessIdle();
 	//virtual void OnClose();
 	DECLARE_MESSAGE_MAP()
 public:
@@ -1,160 +1,110 @@
-// UpDateRTDB.cpp : ʵļ
+// UpDateRTDB.cpp : 实现文件
 //
 
 #include "stdafx.h"
 #include "TSSampleDataSvr.h"
 #include "UpDateRTDB.h"
 
-extern CLog *g_log;
+extern CAsyncLog *g_log;
 // CUpDateRTDB
 
 IMPLEMENT_DYNCREATE(CUpDateRTDB, CWinThread)
 
 CUpDateRTDB::CUpDateRTDB()
+	: m_UpdateQueue(RTDB_CACHE_QUEUESIZE)
 {
+	m_nQueued = 0;
+	m_nTotalUpdates = 0;
+	m_nTotalCoalesced = 0;
+	m_nTotalRows = 0;
+	m_nTotalStatements = 0;
+	m_nTotalFailed = 0;
+	m_nTotalFlush = 0;
 	m_hExitEvent = NULL;
 	m_hExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-	m_ProcessDataEvent = CreateEvent(NULL,TRUE, FALSE, NULL);
-	InitializeCriticalSection(&m_csYxYmDataList);
+	m_FlushEvent = CreateEvent(NULL,TRUE, FALSE, NULL);
+	InitializeCriticalSection(&m_csFlush);
 	if(NULL==g_log)
 	{
-		g_log = new CLog(_T("\\TSSampleDataSvr"));
+		g_log = new CAsyncLog(_T("\\TSSampleDataSvr"));
 	}
+
+	//缓存参数从emscfg.ini的[RTDBCACHE]段读取
+	m_nFlushInterval = RTDB_CACHE_FLUSHINTERVAL;
+	m_nMaxBatch = RTDB_CACHE_MAXBATCH;
+	TCHAR szDirectory[MAX_PATH];
+	memset(szDirectory,0,sizeof(TCHAR)*MAX_PATH);
+	if (GetModuleFileName(NULL,szDirectory,MAX_PATH))
+	{
+		CString strPath = szDirectory;
+		int iIndex = strPath.ReverseFind('\\');
+		if (iIndex > 0)
+		{
+			CString strCountPath = strPath.Left(iIndex) + _T("\\parameter\\emscfg.ini");
+			m_nFlushInterval = GetPrivateProfileInt(_T("RTDBCACHE"),_T("FlushInterval"),RTDB_CACHE_FLUSHINTERVAL,strCountPath);
+			m_nMaxBatch = GetPrivateProfileInt(_T("RTDBCACHE"),_T("MaxBatch"),RTDB_CACHE_MAXBATCH,strCountPath);
+		}
+	}
+	if (m_nFlushInterval <= 0)
+	{
+		m_nFlushInterval = RTDB_CACHE_FLUSHINTERVAL;
+	}
+	//SQL Server单条VALUES最多1000行
+	if (m_nMaxBatch <= 0 || m_nMaxBatch > SQL_VALUES_MAXROWS)
+	{
+		m_nMaxBatch = RTDB_CACHE_MAXBATCH;
+	}
+	m_PointIndex.Init(4096);
+	m_vecEntry.reserve(4096);
+	m_vecDirtySlot.reserve(m_nMaxBatch*2);
 }
 
 CUpDateRTDB::~CUpDateRTDB()
 {
+	CloseHandle(m_hExitEvent);
+	CloseHandle(m_FlushEvent);
+	DeleteCriticalSection(&m_csFlush);
 }
 
 BOOL CUpDateRTDB::InitInstance()
 {
-	// TODO: ڴִ̳߳ʼ
+	// TODO: 在此执行任意逐线程初始化
+	DWORD dwLastFlush = GetTickCount();
 	while(1)
 	{
 		HANDLE hEvents[2];
-		hEvents[0] = m_hExitEvent; 
-		ResetEvent(hEvents[0]);
-		hEvents[1] = m_ProcessDataEvent;
-		ResetEvent(hEvents[1]);
-		DWORD dwWait = WaitForMultipleObjects(2, hEvents, FALSE, INFINITE);
+		hEvents[0] = m_hExitEvent;
+		hEvents[1] = m_FlushEvent;
+		DWORD dwSpan = GetTickCount() - dwLastFlush;
+		DWORD dwTimeout = dwSpan<(DWORD)m_nFlushInterval ? m_nFlushInterval-dwSpan : 0;
+		DWORD dwWait = WaitForMultipleObjects(2, hEvents, FALSE, dwTimeout);
 		switch (dwWait)
 		{
-		case WAIT_TIMEOUT:
-			break;
-		case WAIT_OBJECT_0:	  
-			break;
-		case WAIT_OBJECT_0+1:   
-			ResetEvent(hEvents[1]);
-			POSITION pos = NULL;
-			HANDLE hPipe=NULL;	 
-			hPipe = OpenRealDataPipe();
-			if (hPipe==NULL)
-				continue;
-			CString UpdateSql = _T("");
-			int icount = 0;
-			while(1)
+		case WAIT_OBJECT_0:
+			Flush();
+			return FALSE;
+		case WAIT_OBJECT_0+1:
 			{
-				EnterCriticalSection(&m_csYxYmDataList);
-				pos = m_YxYmDataList.GetHeadPosition();
-				if (!pos)
-				{
-					LeaveCriticalSection(&m_csYxYmDataList);
-					if (!UpdateSql.IsEmpty())
-					{
-						BYTE* pRead = NULL;
-						CString strSql = UpdateSql;
-						pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSql);
-						if (pRead)
-						{
-							delete[] pRead;
-							pRead = NULL;
-						}
-						UpdateSql.Empty();
-					}
-					break;
-				}
-				POSITION pos1 = pos;
-				BYTE *pBuf = (BYTE*)m_YxYmDataList.GetNext(pos);
-				m_YxYmDataList.RemoveAt(pos1);
-				LeaveCriticalSection(&m_csYxYmDataList);
-				YmYxData *pYmYxData = (YmYxData*)pBuf;
-				if (pYmYxData==NULL)
-				{
-					if (pYmYxData!=NULL)
-					{
-						delete pYmYxData;
-						pYmYxData = NULL;
-					}
-					continue;
-				}
-				if (pYmYxData->iType==1)	//Ym
-				{
-					YmConfigDef *pYmDefData = (YmConfigDef*)pYmYxData->data;
-					if (pYmDefData==NULL)
-					{
-						if (pYmYxData!=NULL)
-						{
-							delete pYmYxData;
-							pYmYxData = NULL;
-						}
-						continue;
-					}
-					CString TempSql = _T("");
-					TempSql.Format(_T("UPDATE TB_PULSE SET RAWVALUE=%lld,YMVALUE=%f WHERE ID=%d ;"),pYmDefData->nYmRaw,pYmDefData->dYmValue,pYmDefData->nYmIndex);
-					UpdateSql += TempSql;
-					icount++;
-				}
-				else if (pYmYxData->iType==2)   //Yx
-				{
-					YxConfigDef *pYxDefData = (YxConfigDef*)pYmYxData->data;
-					if (pYxDefData==NULL)
-					{
-						if (pYmYxData!=NULL)
-						{
-							delete pYmYxData;
-							pYmYxData = NULL;
-						}
-						continue;
-					}
-					CString TempSql = _T("");
-					TempSql.Format(_T("UPDATE TB_DI SET RAWVALUE=%d,YXVALUE=%d WHERE ID=%d ;"),pYxDefData->bYxRaw,pYxDefData->bYxValue,pYxDefData->nYxIndex);
-					UpdateSql += TempSql;
-					icount++;
-				}
-
-				if (pYmYxData->data!=NULL)
-				{
-					delete pYmYxData->data;
-					pYmYxData->data = NULL;
-				}
-				if (pYmYxData!=NULL)
+				//队列中已积累一批新值：先复位再取队列，之后投递的新值会重新置位事件，不会丢失。
+				//同一点的新值在此合并，脏点满一批或到了入库周期才入库
+				ResetEvent(m_FlushEvent);
+				EnterCriticalSection(&m_csFlush);
+				int nDirty = DrainQueue();
+				LeaveCriticalSection(&m_csFlush);
+				if (nDirty>=m_nMaxBatch||GetTickCount()-dwLastFlush>=(DWORD)m_nFlushInterval)
 				{
-					delete pYmYxData;
-					pYmYxData = NULL;
+					Flush();
+					dwLastFlush = GetTickCount();
 				}
-
-				if (icount%100!=0)
-				{
-					continue;
-				}
-
-				BYTE* pRead = NULL;
-				CString strSql = UpdateSql;
-				pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSql);
-				if (pRead)
-				{
-					delete[] pRead;
-					pRead = NULL;
-				}
-				UpdateSql.Empty();
-				
-			}
-
-			if (hPipe != NULL)
-			{
-				CloseHandle(hPipe);
-				hPipe = NULL;
 			}
+			break;
+		case WAIT_TIMEOUT:
+			Flush();
+			dwLastFlush = GetTickCount();
+			break;
+		default:
+			Sleep(1000);
+			break;
 		}
 	}
 	return TRUE;
@@ -162,12 +112,193 @@ BOOL CUpDateRTDB::InitInstance()
 
 int CUpDateRTDB::ExitInstance()
 {
-	// TODO: ڴִ߳
+	// TODO: 在此执行任意逐线程清理
 	return CWinThread::ExitInstance();
 }
 
+//处理线程只把新值投递到队列，不加锁也不分配内存；每投递一批通知入库线程取走合并。
+//队列满时与其他队列一样最多等待QUEUE_PUSH_TIMEOUT，超时丢弃的个数计入队列统计
+void CUpDateRTDB::UpdateYm(int nYmIndex, __int64 nYmRaw, double dYmValue)
+{
+	RtdbPointUpdate iUpdate;
+	iUpdate.nId = nYmIndex;
+	iUpdate.nRaw = nYmRaw;
+	iUpdate.dValue = dYmValue;
+	if (!m_UpdateQueue.PushWait(iUpdate,QUEUE_PUSH_TIMEOUT))
+	{
+		return;
+	}
+	if (InterlockedIncrement(&m_nQueued)==m_nMaxBatch)
+	{
+		SetEvent(m_FlushEvent);
+	}
+}
+
+//取出队列中的新值合并到缓存：同一点只保留最新值，已是脏点时直接覆盖，计为一次合并。
+//须持有m_csFlush，返回当前脏点数
+int CUpDateRTDB::DrainQueue()
+{
+	InterlockedExchange(&m_nQueued,0);
+	RtdbPointUpdate* pUpdate = NULL;
+	while ((pUpdate = m_UpdateQueue.Front()) != NULL)
+	{
+		int nSlot = 0;
+		if (!m_PointIndex.Find(pUpdate->nId,nSlot))
+		{
+			RtdbPointEntry iEntry;
+			memset(&iEntry,0,sizeof(RtdbPointEntry));
+			iEntry.nId = pUpdate->nId;
+			nSlot = (int)m_vecEntry.size();
+			m_vecEntry.push_back(iEntry);
+			m_PointIndex.Insert(pUpdate->nId,nSlot);
+		}
+		RtdbPointEntry &iEntry = m_vecEntry[nSlot];
+		iEntry.nRaw = pUpdate->nRaw;
+		iEntry.dValue = pUpdate->dValue;
+		m_UpdateQueue.PopFront();
+		if (iEntry.bDirty)
+		{
+			m_nTotalCoalesced++;
+		}
+		else
+		{
+			iEntry.bDirty = TRUE;
+			m_vecDirtySlot.push_back(nSlot);
+		}
+		m_nTotalUpdates++;
+	}
+	return (int)m_vecDirtySlot.size();
+}
+
+//[nBegin,nEnd)中入库失败的点重新置脏；期间已有新值的点本身就是脏点，不再重复加入。须持有m_csFlush
+void CUpDateRTDB::MarkDirtyAgain(const std::vector<RtdbPointValue>& vecValue, int nBegin, int nEnd)
+{
+	for (int i=nBegin;i<nEnd;i++)
+	{
+		RtdbPointEntry &iEntry = m_vecEntry[vecValue[i].nSlot];
+		if (!iEntry.bDirty)
+		{
+			iEntry.bDirty = TRUE;
+			m_vecDirtySlot.push_back(vecValue[i].nSlot);
+		}
+	}
+}
+
+//[nBegin,nEnd)的点生成一条按ID关联的UPDATE语句追加到strSql，返回点数
+int CUpDateRTDB::BuildUpdateSql(const std::vector<RtdbPointValue>& vecValue, int nBegin, int nEnd, CString& strSql)
+{
+	if (nBegin>=nEnd)
+	{
+		return 0;
+	}
+	strSql.Append(_T("UPDATE t SET RAWVALUE=s.R,YMVALUE=s.V FROM TB_PULSE t INNER JOIN (VALUES "));
+	for (int i=nBegin;i<nEnd;i++)
+	{
+		const RtdbPointValue &iValue = vecValue[i];
+		AppendSqlText(strSql,i==nBegin?_T("(%d,%lld,%f)"):_T(",(%d,%lld,%f)"),iValue.nId,iValue.nRaw,iValue.dValue);
+	}
+	strSql.Append(_T(") AS s(ID,R,V) ON t.ID=s.ID; "));
+	return nEnd-nBegin;
+}
+
+void CUpDateRTDB::Flush()
+{
+	EnterCriticalSection(&m_csFlush);
+	//先合并队列中的新值，再取走脏点列表并拷出当前值，之后的新值重新置脏，留到下一次入库
+	DrainQueue();
+	std::vector<int> vecDirtySlot;
+	std::vector<RtdbPointValue> vecYm;
+	vecDirtySlot.swap(m_vecDirtySlot);
+	m_vecDirtySlot.reserve(m_nMaxBatch*2);
+	vecYm.reserve(vecDirtySlot.size());
+	for (size_t i=0;i<vecDirtySlot.size();i++)
+	{
+		RtdbPointEntry &iEntry = m_vecEntry[vecDirtySlot[i]];
+		RtdbPointValue iValue;
+		iValue.nSlot = vecDirtySlot[i];
+		iValue.nId = iEntry.nId;
+		iValue.nRaw = iEntry.nRaw;
+		iValue.dValue = iEntry.dValue;
+		iEntry.bDirty = FALSE;
+		vecYm.push_back(iValue);
+	}
+	int nCount = (int)vecYm.size();
+	if (nCount==0)
+	{
+		LeaveCriticalSection(&m_csFlush);
+		return;
+	}
+
+	DWORD dwBegin = GetTickCount();
+	HANDLE hPipe = OpenRealDataPipe();
+	if (hPipe==NULL)
+	{
+		ReguTrace(SQLERRO,"实时值入库:OpenRealDataPipe ERRO hPipe==null,%d个点留待下次入库!",nCount);
+		MarkDirtyAgain(vecYm,0,nCount);
+		LeaveCriticalSection(&m_csFlush);
+		return;
+	}
+
+	//逐条检查应答：只有确认成功的应答才算入库，执行失败或其他报文的语句中的点重新置脏，
+	//无应答时管道已不可用，剩余的点全部留待下次。每条语句之间取一次队列，入库较慢时队列也不会堆满
+	int nRows = 0;
+	int nStatements = 0;
+	int nFailed = 0;
+	CString strSql = _T("");
+	strSql.Preallocate(m_nMaxBatch*48 + 256);
+	int nBegin = 0;
+	for (;nBegin<nCount;nBegin+=m_nMaxBatch)
+	{
+		int nEnd = min(nBegin+m_nMaxBatch,nCount);
+		strSql.Truncate(0);
+		BuildUpdateSql(vecYm,nBegin,nEnd,strSql);
+		nStatements++;
+		BYTE* pRead = NULL;
+		pRead = (BYTE*)GetMessage_RecordOfSql_Ext(hPipe, strSql);
+		if (pRead==NULL)
+		{
+			ReguTrace(SQLERRO,"实时值入库无应答,%d个点留待下次入库:<%s>",nCount-nBegin,(LPCTSTR)strSql.Left(512));
+			nFailed++;
+			break;
+		}
+		if (!CRtdbUpdateFrame::IsAckOk(pRead))
+		{
+			NetMessageHead* pMessageHead = (NetMessageHead*)pRead;
+			MessageAck* pAck = (MessageAck*)&pRead[sizeof(NetMessageHead)];
+			ReguTrace(SQLERRO,"实时值入库执行失败(报文类型%d,应答%d),%d个点留待下次入库:<%s>",pMessageHead->MessageType,
+				pMessageHead->MessageType==NET_MESSAGE_ACK?pAck->wdAckType:-1,nEnd-nBegin,(LPCTSTR)strSql.Left(512));
+			MarkDirtyAgain(vecYm,nBegin,nEnd);
+			nFailed++;
+		}
+		else
+		{
+			nRows += nEnd-nBegin;
+		}
+		delete[] pRead;
+		pRead = NULL;
+		DrainQueue();
+	}
+	if (nBegin<nCount)
+	{
+		MarkDirtyAgain(vecYm,nBegin,nCount);
+	}
+	CloseHandle(hPipe);
+	hPipe = NULL;
+	DWORD dwSpan = GetTickCount() - dwBegin;
+	m_nTotalRows += nRows;
+	m_nTotalStatements += nStatements;
+	m_nTotalFailed += nFailed;
+	m_nTotalFlush++;
+	__int64 nUpdates = m_nTotalUpdates;
+	__int64 nCoalesced = m_nTotalCoalesced;
+	LeaveCriticalSection(&m_csFlush);
+
+	ReguTrace(SQL,"实时值入库:遥脉%d点,成功%d点,语句数%d,失败%d,耗时%dms;累计收到%I64d次更新,入库%I64d点,合并省掉%I64d次更新,失败语句%I64d条,队列满丢弃%d次",
+		nCount,nRows,nStatements,nFailed,dwSpan,nUpdates,m_nTotalRows,nCoalesced,m_nTotalFailed,m_UpdateQueue.GetDropped());
+}
+
 BEGIN_MESSAGE_MAP(CUpDateRTDB, CWinThread)
 END_MESSAGE_MAP()
 
 
-// CUpDateRTDB Ϣ
+// CUpDateRTDB 消息处理程序
@@ -1,28 +1,74 @@
 #pragma once
+#include "YmLookupIndex.h"
 
+#define RTDB_CACHE_FLUSHINTERVAL	1000	//脏点最长缓存时间(ms)
+#define RTDB_CACHE_MAXBATCH			500		//单条UPDATE语句最大点数
+#define RTDB_CACHE_QUEUESIZE		65536	//遥脉新值队列容量
 
+struct RtdbPointEntry
+{
+	int nId;			//点ID,即TB_PULSE的ID
+	__int64 nRaw;		//最新原始值
+	double dValue;		//最新工程值
+	BOOL bDirty;		//是否有未入库的新值
+};
+
+//处理线程投递的一次遥脉新值
+struct RtdbPointUpdate
+{
+	int nId;
+	__int64 nRaw;
+	double dValue;
+};
+
+struct RtdbPointValue
+{
+	int nSlot;			//在m_vecEntry中的下标，入库失败时据此重新置脏
+	int nId;
+	__int64 nRaw;
+	double dValue;
+};
 
 // CUpDateRTDB
+// 遥脉实时值的写回缓存：按点ID只保留最新值并记脏，按周期或脏点数批量更新TB_PULSE。
+// 各处理线程经无锁队列投递新值，由入库线程(持m_csFlush)取出合并到缓存，缓存只在m_csFlush下访问。
+// 遥信(TB_DI)只在变位时由CProcessThread::Update2RTDB按实时库帧写入，不经过本缓存
 
 class CUpDateRTDB : public CWinThread
 {
 	DECLARE_DYNCREATE(CUpDateRTDB)
 
 public:
-	CUpDateRTDB();           // ̬ʹõܱĹ캯
+	CUpDateRTDB();           // 动态创建所使用的受保护的构造函数
 	virtual ~CUpDateRTDB();
 
 public:
 	virtual BOOL InitInstance();
 	virtual int ExitInstance();
-	void Update2DB(YmYxData *pYmYxData);
+	void UpdateYm(int nYmIndex, __int64 nYmRaw, double dYmValue);
+	void Flush();
+protected:
+	int DrainQueue();
+	int BuildUpdateSql(const std::vector<RtdbPointValue>& vecValue, int nBegin, int nEnd, CString& strSql);
+	void MarkDirtyAgain(const std::vector<RtdbPointValue>& vecValue, int nBegin, int nEnd);
 public:
-	CPtrList m_YxYmDataList;
-	HANDLE m_ProcessDataEvent,m_hExitEvent;  
-	CRITICAL_SECTION m_csYxYmDataList;
+	CFlatHashIndex m_PointIndex;		//点ID -> m_vecEntry下标
+	std::vector<RtdbPointEntry> m_vecEntry;
+	std::vector<int> m_vecDirtySlot;			//当前脏点的下标，每个脏点只出现一次
+	CMpscQueue<RtdbPointUpdate> m_UpdateQueue;	//处理线程投递的新值，只在m_csFlush下出队
+	volatile LONG m_nQueued;					//上次取队列后投递的个数，满一批时通知入库线程
+	CRITICAL_SECTION m_csFlush;
+	HANDLE m_FlushEvent,m_hExitEvent;
+	int m_nFlushInterval;
+	int m_nMaxBatch;
+	//统计
+	__int64 m_nTotalUpdates;		//收到的更新次数
+	__int64 m_nTotalCoalesced;		//被同一点后续新值覆盖、省掉的更新次数
+	__int64 m_nTotalRows;			//实际入库的点数
+	__int64 m_nTotalStatements;
+	__int64 m_nTotalFailed;			//执行失败或应答异常、重新置脏的语句数
+	__int64 m_nTotalFlush;
 
 protected:
 	DECLARE_MESSAGE_MAP()
 };
-
-
@@ -0,0 +1,179 @@
+// YmLookupIndex.cpp : 实现文件
+//
+
+#include "stdafx.h"
+#include "YmLookupIndex.h"
+
+// CDevLookupIndex
+
+void CDevLookupIndex::Build(const DeviceRecordDefMap &DevMap)
+{
+	m_DevIndex.Init((int)DevMap.size());
+	DeviceRecordDefMap::const_iterator itd = DevMap.begin();
+	for (; itd!=DevMap.end(); ++itd)
+	{
+		int nRtu = 0, nDevNo = 0;
+		if (_stscanf_s(itd->first, _T("%d+%d"), &nRtu, &nDevNo) != 2)
+		{
+			continue;
+		}
+		m_DevIndex.Insert(MAKE_DEV_KEY(nRtu,nDevNo), itd->second);
+	}
+}
+
+BOOL CDevLookupIndex::GetDevId(short nRtu, int nDevNo, int &nDevId) const
+{
+	return m_DevIndex.Find(MAKE_DEV_KEY(nRtu,nDevNo), nDevId);
+}
+
+//一组单元的前置设备号一次解析成设备ID，找不到的置0，返回找到的个数。
+//同一设备的点在报文里通常相邻，与上一个单元设备号相同时直接沿用上一次的结果
+int CDevLookupIndex::GetDevIds(short nRtu, const int *pDevNo, int nCount, int *pDevId) const
+{
+	int nFound = 0;
+	int nLastDevNo = 0;
+	int nLastDevId = 0;
+	BOOL bHasLast = FALSE;
+	for (int i=0; i<nCount; i++)
+	{
+		if (!bHasLast || pDevNo[i] != nLastDevNo)
+		{
+			nLastDevNo = pDevNo[i];
+			nLastDevId = 0;
+			if (!m_DevIndex.Find(MAKE_DEV_KEY(nRtu,nLastDevNo), nLastDevId))
+			{
+				nLastDevId = 0;
+			}
+			bHasLast = TRUE;
+		}
+		pDevId[i] = nLastDevId;
+		if (nLastDevId != 0)
+		{
+			nFound++;
+		}
+	}
+	return nFound;
+}
+
+// CYmLookupIndex
+
+CYmLookupIndex::CYmLookupIndex()
+{
+	m_pYmEntries = NULL;
+	m_nYmCount = 0;
+}
+
+CYmLookupIndex::~CYmLookupIndex()
+{
+	if (m_pYmEntries != NULL)
+	{
+		delete [] m_pYmEntries;
+		m_pYmEntries = NULL;
+	}
+}
+
+//由加载配置时生成的map建立索引；pOldIndex不为空时沿用旧快照中遥脉的运行值(原始值、数据时间)
+void CYmLookupIndex::Build(const YmConfigDefMap &YmMap, const SampleDayNo &SampleMap, CYmLookupIndex *pOldIndex)
+{
+	m_nYmCount = 0;
+	m_pYmEntries = new YmIndexEntry[YmMap.size()>0 ? YmMap.size() : 1];
+	m_YmIndex.Init((int)YmMap.size());
+	YmConfigDefMap::const_iterator itym = YmMap.begin();
+	for (; itym!=YmMap.end(); ++itym)
+	{
+		int nPos = 0;
+		__int64 nKey = MAKE_YM_KEY(itym->second.nDeviceNo,itym->second.nYmNum);
+		if (m_YmIndex.Find(nKey, nPos))
+		{
+			continue;
+		}
+		YmIndexEntry &Entry = m_pYmEntries[m_nYmCount];
+		Entry.nSeq = 0;
+		Entry.YmDef = itym->second;
+		//只沿用运行值，系数、遥脉序号等配置以新加载的为准
+		SimpleYmDef OldDef;
+		if (pOldIndex != NULL && pOldIndex->GetYmDef(Entry.YmDef.nDeviceNo, Entry.YmDef.nYmNum, OldDef))
+		{
+			Entry.YmDef.nYmRaw = OldDef.nYmRaw;
+			Entry.YmDef.dYmValue = OldDef.dYmValue;
+			Entry.YmDef.DataTime = OldDef.DataTime;
+		}
+		m_YmIndex.Insert(nKey, m_nYmCount);
+		m_nYmCount++;
+	}
+
+	m_SampleIndex.Init((int)SampleMap.size());
+	SampleDayNo::const_iterator its = SampleMap.begin();
+	for (; its!=SampleMap.end(); ++its)
+	{
+		int nSampleTb = 0, nTb = 0, nIndex = 0;
+		if (_stscanf_s(its->first, _T("%d+%d+%d"), &nSampleTb, &nTb, &nIndex) != 3)
+		{
+			continue;
+		}
+		m_SampleIndex.Insert(MAKE_SAMPLE_KEY(nSampleTb,nTb,nIndex), its->second);
+	}
+}
+
+void CYmLookupIndex::ReadEntry(const YmIndexEntry &Entry, SimpleYmDef &ymDef) const
+{
+	while (1)
+	{
+		LONG nSeq = Entry.nSeq;
+		if (nSeq & 1)
+		{
+			YieldProcessor();
+			continue;
+		}
+		MemoryBarrier();
+		ymDef = Entry.YmDef;
+		MemoryBarrier();
+		if (Entry.nSeq == nSeq)
+		{
+			return;
+		}
+	}
+}
+
+BOOL CYmLookupIndex::GetYmDef(int nDevId, int nYmNum, SimpleYmDef &ymDef) const
+{
+	int nPos = 0;
+	if (!m_YmIndex.Find(MAKE_YM_KEY(nDevId,nYmNum), nPos))
+	{
+		return FALSE;
+	}
+	ReadEntry(m_pYmEntries[nPos], ymDef);
+	return TRUE;
+}
+
+void CYmLookupIndex::GetYmDefAt(int nPos, SimpleYmDef &ymDef) const
+{
+	ReadEntry(m_pYmEntries[nPos], ymDef);
+}
+
+BOOL CYmLookupIndex::UpdateYmDef(const SimpleYmDef &ymDef)
+{
+	int nPos = 0;
+	if (!m_YmIndex.Find(MAKE_YM_KEY(ymDef.nDeviceNo,ymDef.nYmNum), nPos))
+	{
+		return FALSE;
+	}
+	YmIndexEntry &Entry = m_pYmEntries[nPos];
+	while (1)
+	{
+		LONG nSeq = Entry.nSeq;
+		if ((nSeq & 1) == 0 && InterlockedCompareExchange(&Entry.nSeq, nSeq + 1, nSeq) == nSeq)
+		{
+			break;
+		}
+		YieldProcessor();
+	}
+	Entry.YmDef = ymDef;
+	InterlockedIncrement(&Entry.nSeq);
+	return TRUE;
+}
+
+BOOL CYmLookupIndex::GetSampleNo(int nSampleTableNo, int nTableNo, int nIndex, int &nSampleNo) const
+{
+	return m_SampleIndex.Find(MAKE_SAMPLE_KEY(nSampleTableNo,nTableNo,nIndex), nSampleNo);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "FlatHashIndex.h"
+
+// 整型打包键，替代原"%d+%d"/"%d+%d+%d"格式的CString键
+#define MAKE_DEV_KEY(nRtu,nDevNo)		(((__int64)(nRtu)<<32)|(DWORD)(nDevNo))							//厂站号+前置设备号
+#define MAKE_YM_KEY(nDevId,nYmNum)		(((__int64)(nDevId)<<32)|(DWORD)(nYmNum))						//设备ID+遥脉序号
+#define MAKE_SAMPLE_KEY(nSampleTb,nTb,nIndex)	(((__int64)(nSampleTb)<<48)|((__int64)((nTb)&0xFFFF)<<32)|(DWORD)(nIndex))	//采样表号+三遥表号+三遥序号
+
+// 遥脉运行值，用顺序号做无锁读：写者把nSeq置为奇数后修改，读者读到偶数且前后一致才算成功
+struct YmIndexEntry
+{
+	volatile LONG nSeq;
+	SimpleYmDef YmDef;
+};
+
+// CDevLookupIndex
+// 厂站号+前置设备号到设备ID的索引快照。设备表随设备信息变化重新加载，
+// 与遥脉索引分开发布，重建时不影响遥脉运行值
+
+class CDevLookupIndex
+{
+public:
+	void Build(const DeviceRecordDefMap &DevMap);
+	BOOL GetDevId(short nRtu, int nDevNo, int &nDevId) const;
+	int GetDevIds(short nRtu, const int *pDevNo, int nCount, int *pDevId) const;
+	int GetCount() const { return m_DevIndex.GetCount(); }
+
+private:
+	CFlatHashIndex m_DevIndex;		//厂站号+前置设备号 -> 设备ID
+};
+
+// CYmLookupIndex
+// LoadAllForeignTable时一次性建立的遥脉/采样序号索引快照。
+// 快照发布后结构不再改变，处理线程只读查找；遥脉的原始值、时间等运行值在YmIndexEntry中原地更新
+
+class CYmLookupIndex
+{
+public:
+	CYmLookupIndex();
+	~CYmLookupIndex();
+
+	void Build(const YmConfigDefMap &YmMap, const SampleDayNo &SampleMap, CYmLookupIndex *pOldIndex);
+	BOOL GetYmDef(int nDevId, int nYmNum, SimpleYmDef &ymDef) const;
+	BOOL UpdateYmDef(const SimpleYmDef &ymDef);
+	BOOL GetSampleNo(int nSampleTableNo, int nTableNo, int nIndex, int &nSampleNo) const;
+	int GetYmCount() const { return m_nYmCount; }
+	void GetYmDefAt(int nPos, SimpleYmDef &ymDef) const;
+
+private:
+	CYmLookupIndex(const CYmLookupIndex&);
+	CYmLookupIndex& operator=(const CYmLookupIndex&);
+	void ReadEntry(const YmIndexEntry &Entry, SimpleYmDef &ymDef) const;
+
+	CFlatHashIndex m_YmIndex;		//设备ID+遥脉序号 -> m_pYmEntries下标
+	CFlatHashIndex m_SampleIndex;	//采样表号+三遥表号+三遥序号 -> 采样序号
+	YmIndexEntry *m_pYmEntries;
+	int m_nYmCount;
+};
@@ -1,7 +1,7 @@
 
-// stdafx.cpp : ֻ׼ļԴļ
-// TSSampleDataSvr.pch ΪԤͷ
-// stdafx.obj ԤϢ
+// stdafx.cpp : 只包括标准包含文件的源文件
+// TSSampleDataSvr.pch 将作为预编译头
+// stdafx.obj 将包含预编译类型信息
 
 #include "stdafx.h"
 
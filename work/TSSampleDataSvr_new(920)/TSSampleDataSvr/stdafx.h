@@ -1,7 +1,7 @@
 
-// stdafx.h : ׼ϵͳļİļ
-// Ǿʹõĵ
-// ضĿİļ
+// stdafx.h : 标准系统包含文件的包含文件，
+// 或是经常使用但不常更改的
+// 特定于项目的包含文件
 
 #pragma once
 
@@ -10,32 +10,32 @@
 #endif
 
 #ifndef VC_EXTRALEAN
-#define VC_EXTRALEAN            //  Windows ͷųʹõ
+#define VC_EXTRALEAN            // 从 Windows 头中排除极少使用的资料
 #endif
 
 #include "targetver.h"
 
-#define _ATL_CSTRING_EXPLICIT_CONSTRUCTORS      // ĳЩ CString 캯ʽ
+#define _ATL_CSTRING_EXPLICIT_CONSTRUCTORS      // 某些 CString 构造函数将是显式的
 
-// ر MFC ĳЩɷĺԵľϢ
+// 关闭 MFC 对某些常见但经常可放心忽略的警告消息的隐藏
 #define _AFX_ALL_WARNINGS
 
-#include <afxwin.h>         // MFC ͱ׼
-#include <afxext.h>         // MFC չ
+#include <afxwin.h>         // MFC 核心组件和标准组件
+#include <afxext.h>         // MFC 扩展
 
 
-#include <afxdisp.h>        // MFC Զ
+#include <afxdisp.h>        // MFC 自动化类
 
 
 
 #ifndef _AFX_NO_OLE_SUPPORT
-#include <afxdtctl.h>           // MFC  Internet Explorer 4 ؼ֧
+#include <afxdtctl.h>           // MFC 对 Internet Explorer 4 公共控件的支持
 #endif
 #ifndef _AFX_NO_AFXCMN_SUPPORT
-#include <afxcmn.h>             // MFC  Windows ؼ֧
+#include <afxcmn.h>             // MFC 对 Windows 公共控件的支持
 #endif // _AFX_NO_AFXCMN_SUPPORT
 
-#include <afxcontrolbars.h>     // Ϳؼ MFC ֧
+#include <afxcontrolbars.h>     // 功能区和控件条的 MFC 支持
 
 #include "NetMessage.h"
 #include "wrkdllsock.h"
@@ -45,6 +45,14 @@
 #include "Log.h"
 #include "MyLogInc.h"
 #include <map>
+#include <vector>
+#include "MpscQueue.h"
+#include "AsyncLog.h"
+#include "RecordSetReader.h"
+#include "SqlText.h"
+#include "RtdbUpdateFrame.h"
+#include "RtdbUpdateWindow.h"
+#include "SocketFrame.h"
 
 typedef enum{
 	REGU_HIREDIS,
@@ -53,29 +61,40 @@ typedef enum{
 	REGU_YK,
 }dbg_type_t;
 
+//先按级别过滤再格式化，格式化后的正文交给异步日志线程落盘
 #define  ReguTrace(type,fmt,...)     do{\
-	CString s1,s2;\
-	TCHAR* t=_T("Unknow");\
-	s1.Format(_T(fmt),__VA_ARGS__) ;\
-	s2.Format(_T("[%s][%20s:%-4d]"),_T(#type),_T(__FUNCTION__),__LINE__);\
-	g_log->Log(s2+s1);\
+	if (g_log->IsEnabled(LOGLEVEL_##type))\
+	{\
+		TCHAR szLog[LOG_RECORD_LEN];\
+		int nPos = _sntprintf_s(szLog,LOG_RECORD_LEN,_TRUNCATE,_T("[%s][%20s:%-4d]"),_T(#type),_T(__FUNCTION__),__LINE__);\
+		if (nPos>0)\
+		{\
+			_sntprintf_s(szLog+nPos,LOG_RECORD_LEN-nPos,_TRUNCATE,_T(fmt),__VA_ARGS__);\
+		}\
+		g_log->Log(szLog);\
+	}\
 	}while(0)
 
 #define  ReguTrace_ext(logger,type,fmt,...)     do{\
-	CString s1,s2;\
-	TCHAR* t=_T("Unknow");\
-	s1.Format(_T(fmt),__VA_ARGS__) ;\
-	s2.Format(_T("[%s][%20s:%-4d]"),_T(#type),_T(__FUNCTION__),__LINE__);\
-	(logger)->Log(s2+s1);\
+	if ((logger)->IsEnabled(LOGLEVEL_##type))\
+	{\
+		TCHAR szLog[LOG_RECORD_LEN];\
+		int nPos = _sntprintf_s(szLog,LOG_RECORD_LEN,_TRUNCATE,_T("[%s][%20s:%-4d]"),_T(#type),_T(__FUNCTION__),__LINE__);\
+		if (nPos>0)\
+		{\
+			_sntprintf_s(szLog+nPos,LOG_RECORD_LEN-nPos,_TRUNCATE,_T(fmt),__VA_ARGS__);\
+		}\
+		(logger)->Log(szLog);\
+	}\
 	}while(0)
 
 #pragma pack(1)
-typedef struct _PowFileInfo		//ļеĵϢ
+typedef struct _PowFileInfo		//文件中单个点的电度量信息
 {
-	WORD nDevID;		//豸ID
-	WORD nYmNum;		//ң
-	DWORD nYmVal;		//ңֵ
-	unsigned char cFlag;	//־λ
+	WORD nDevID;		//设备ID
+	WORD nYmNum;		//遥脉序号
+	DWORD nYmVal;		//遥脉值
+	unsigned char cFlag;	//标志位
 }PowFileInfo;
 
 typedef struct _SampleValueInfo
@@ -98,7 +117,7 @@ struct   ProtocolCallItem
 	//	byte m_nStationNum;
 	unsigned short m_nStationNum;//MSW 150615 MOD
 	//	WORD m_nDeviceNo;
-	int m_nDeviceNo;//豸ID豸
+	int m_nDeviceNo;//设备ID，设备表的主键
 	byte m_nBuffer[2060] ;
 };
 
@@ -112,14 +131,14 @@ typedef struct _AlarmMsgHead
 
 typedef struct _AlarmInfo
 {
-	int ObjectId;			//澯Id
-	int ObjectType;			//	31-豸 33-
-	int AlarmType;			//澯
-	int reserve;			//ֶ Ϊ31ʱ Ϊվ
-	CTime AlarmTime;		//澯ʱ
-	int Status;				//澯״̬
-	TCHAR Contents[256];	//澯
-	TCHAR Suggest[256];		//ʾ
+	int ObjectId;			//告警对象Id
+	int ObjectType;			//对象类型	31-设备 33-集中器
+	int AlarmType;			//告警类型
+	int reserve;			//保留字段 当对象类型为31时 作为场站号
+	CTime AlarmTime;		//告警时间
+	int Status;				//告警状态
+	TCHAR Contents[256];	//告警内容
+	TCHAR Suggest[256];		//处理策略提示
 }AlarmInfo;
 //GUOJ ADD 151116
 struct	SimpleYmDef
@@ -133,27 +152,33 @@ struct	SimpleYmDef
 	TIMESTAMP_STRUCT DataTime;
 };
 
-struct YmYxData 
-{
-	BYTE iType;	//1--Ym,2-->Yx
-	void* data;
-};
 #pragma pack()
 
-typedef std::map<CString, SimpleYmDef>	YmConfigDefMap;		//мCString"豸ID+ң"
-typedef std::map<int, int>	StationDefMap;		//мΪ"Rtu"StationDefеnPortNo
-typedef std::map<CString, int>	DeviceRecordDefMap;		//мCString"վID+ǰ豸"
-typedef std::map<int, DeviceRecordDef>	DeviceRecordDefMap2;		//мΪ豸ID
+typedef std::map<CString, SimpleYmDef>	YmConfigDefMap;		//其中键类型CString由"设备ID+遥脉序号"组合生成
+typedef std::map<int, int>	StationDefMap;		//其中键为"Rtu号"，即StationDef中的nPortNo
+typedef std::map<CString, int>	DeviceRecordDefMap;		//其中键类型CString由"厂站ID+前置设备号"组合生成
+typedef std::map<int, DeviceRecordDef>	DeviceRecordDefMap2;		//其中键为设备ID
 typedef std::map<CString, int> SampleDayNo;
 typedef std::map<int,SampleValueInfo> SampleValueInfoMap;
-typedef std::map<__int64, __int64>	CollectorMappingMap;	//豸ӳmapмĸ4λΪID4λΪµţ
-//ֵĸ4λΪ豸ID4λΪ豸µ    //ZHOUN 140909 ADD
+typedef std::map<__int64, __int64>	CollectorMappingMap;	//集中器向虚设备的映射map，其中键的高4位为集中器ID，低4位为集中器下点的序号；
+//值的高4位为虚设备ID，低4位为虚设备下点的序号    //ZHOUN 140909 ADD
 const CString C_SQL_Insert_SampleTable = _T("if exists (select RECNUM FROM %s WHERE TIMEID='%s') BEGIN UPDATE %s SET %s WHERE TIMEID='%s' END ELSE BEGIN INSERT INTO %s (%s) VALUES ('%s'%s) END ; ");
 const CString C_SQL_Insert_PaymentRecord = _T("IF NOT EXISTS (SELECT ID FROM TE_PAYMENT_PAYRECORD WHERE DEVICEID=%d AND COUNT=%d ) BEGIN INSERT INTO TE_PAYMENT_PAYRECORD \
 											  (OPERATIONTIME,ACCOUNTCODE,ROOMNAME,DEVICEID,PAYCOUNT,PAPTAKER,BILLSERIAL,RECHARGETYPE,BEFORERECHARGE,AFTERERECHARGE,RECHARGETIME,COUNT,UPMARK,BRANDID,PLAZAID,BUNKCODE) VALUES ('%s','%s','%s',%d,%02f,%d,'%s',%d,%02f,%02f,'%s',%d,0,%d,%d,'%s') END; ");
 #define SQL_COUNT_ONCE	10
 
-#define THREAD_NUM	10
+#define THREAD_NUM	10				//默认处理线程数
+#define THREAD_NUM_MAX	32			//处理线程数上限
+#define PROCESS_QUEUE_SIZE	1024	//分区模式下每个处理线程的报文队列容量
+#define DEVSTATE_SHARD_HASH_SIZE	4001	//分区模式下每个处理线程遥信状态表的哈希桶数(取质数)
+#define RECORDLIST_QUEUE_SIZE	4096	//招充值记录队列容量
+#define ALARMINFO_QUEUE_SIZE	4096	//告警信息队列容量
+#define REDIS_IDLE_SLEEP_MIN	5		//Redis无数据时的最短轮询间隔(ms)
+#define REDIS_IDLE_SLEEP_MAX	100		//Redis持续无数据时的最长轮询间隔(ms)
+#define REDIS_BATCH_POP_MAX		256		//批量模式每次往返最多取的报文数
+#define DEVINFO_CHECK_INTERVAL	60000	//设备信息变化检测周期(ms)
+#define DEVINFO_HASH_SIZE		20011	//设备信息表哈希桶数(取质数)
+#define QUEUE_PUSH_TIMEOUT		1000	//队列满时生产者最长等待时间(ms)
 #define WM_ICON_NOTIFY WM_USER+102
 
 #define SIZEOFSTATION   1024
@@ -1,24 +1,39 @@
 /*********************************************************************
- * Ȩ (C)2013
+ * 版权所有 (C)2013
  *
- * ļƣ 
- * ļʶ 
- * ˵ ͨ
- * ǰ汾 V1.0
- *     ߣ 
- * ڣ 
+ * 文件名称： 
+ * 文件标识： 
+ * 其它说明： 通信组件
+ * 当前版本： V1.0
+ * 作    者： 
+ * 完成日期： 
  *
- * ޸ļ¼1
- *    ޸ڣ20131113
- *      ţV1.0
- *      ˣNew
- *    ޸ݣ
+ * 修改记录1：
+ *    修改日期：2013年11月13日
+ *    版 本 号：V1.0
+ *    修 改 人：New
+ *    修改内容：创建
  **********************************************************************/
 #include "comm.hpp"
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <sched.h>
+#include <stddef.h>
 
-const WORD32  g_max_cli=((WORD32)100);
-const WORD32  g_max_rcv=((WORD32)16*4096);
-const WORD32  g_max_snd=((WORD32)8*4096);
+const WORD32  g_max_cli=((WORD32)65536);   /* 最大连接数，需同时调大进程的打开文件数限制(ulimit -n) */
+const WORD32  g_max_rcv=((WORD32)16*4096);   /* 默认最大消息长度 */
+const WORD32  g_init_rcv=((WORD32)4096);     /* 接收缓存初始大小，收到长消息时再增长 */
+const WORD32  g_max_snd=((WORD32)8*4096);   /* 发送队列每块大小，小消息拷进同一块合并发送 */
+const WORD32  g_snd_high=((WORD32)1024*1024); /* 发送队列高水位，超过时发送者等待 */
+const WORD32  g_snd_low=((WORD32)256*1024);   /* 发送队列低水位，降到此值以下时唤醒发送者 */
+const WORD32  g_max_iov=((WORD32)64);       /* 每次sendmsg最多聚合的块数 */
+const WORD32  g_max_events=((WORD32)256);  /* 每次epoll_wait取回的最大事件数 */
+const WORD32  g_snd_wait=((WORD32)1000);   /* 发送队列超过高水位时发送者最多等待的时间(ms) */
+const WORD32  g_max_jobs=((WORD32)4096);   /* 每个工作任务排队消息数上限，超过时丢弃新消息，接收任务不等待 */
+const WORD32  g_drop_log=((WORD32)1024);   /* 丢弃消息时第一次和之后每隔这么多次打印一次累计数 */
 
 
 #define ETH_HW_ADDR_LEN  ((WORD32)6)
@@ -120,21 +135,31 @@ CCommLink::CCommLink(WORD32 type,WORD32 fd,WORD32 addr)
     dwacfd    = fd;
     dwtype    = type;
     dwAddr    = addr; 
-    rcvlen    = g_max_rcv;
-    sndlen    = g_max_snd;
+    rcvlen    = g_init_rcv;
+    dwRcvOff  = 0;
+    dwRcvHead = 0;
+    dwMaxRcv  = g_max_rcv;
     
     pucRcvBuf = (BYTE *)Vos_Malloc(MEM_COMM_TYPE, rcvlen);
     if(NULL == pucRcvBuf)
     {
         rcvlen = 0;
     }
-    pucSndBuf = (BYTE *)Vos_Malloc(MEM_COMM_TYPE, sndlen);
-    if(NULL == pucSndBuf)
-    {
-        sndlen = 0;
-    }
+    pucAlignBuf = NULL;
+    dwAlignLen  = 0;
+    ptSndHead  = NULL;
+    ptSndTail  = NULL;
+    dwSndBytes = 0;
+    dwSndErr   = 0;
+    dwSndWatch = 0;
+    dwRef      = 0;
+    Vos_Init_Mutex(&sndmutex);
+    pthread_cond_init(&tSndCond, NULL);
     pUsercall = NULL; 
-    ptNext = NULL;
+    dwReactor = 0;
+    ptOwner   = NULL;
+    ptNext    = NULL;
+    dwHandle  = 0;
 }
 CCommLink::~CCommLink()
 {
@@ -143,62 +168,534 @@ CCommLink::~CCommLink()
     {
         Vos_Free(pucRcvBuf);
     }
-    if(pucSndBuf)
+    if(pucAlignBuf)
+    {
+        Vos_Free(pucAlignBuf);
+    }
+    while(NULL != ptSndHead)
     {
-        Vos_Free(pucSndBuf);
+        ptSndTail = ptSndHead->ptNext;
+        Vos_Free(ptSndHead);
+        ptSndHead = ptSndTail;
     }
+    pthread_cond_destroy(&tSndCond);
+    pthread_mutex_destroy(&sndmutex);
 }
 
 WORD32 CCommLink::SetUsercall(TaskEntryProto pcall)
 {
     pUsercall = pcall;
+    return 0;
 }
 
 CCommCtl::CCommCtl()
 {
     dwNum      = 0;
-    ptLinkItem = NULL;
+    dwEpoch    = 0;
+    adwReaders[0] = 0;
+    adwReaders[1] = 0;
+    memset((void *)aptAddrHash, 0, sizeof(aptAddrHash));
+    ptLinkSlot = (T_CommLinkSlot *)Vos_Malloc(MEM_COMM_TYPE, g_max_cli * sizeof(T_CommLinkSlot));
+    if(NULL == ptLinkSlot)
+    {
+        R_Printf("CCommCtl link table malloc error!\n");
+    }
+    else
+    {
+        memset((void *)ptLinkSlot, 0, g_max_cli * sizeof(T_CommLinkSlot));
+    }
+    dwservfd   = 0;
+    dwclientfd = 0;
+    dwReactorNum  = 1;
+    dwNextReactor = 0;
+    dwWorkerNum   = 0;
+    dwWorkerInit  = 0;
+    dwMaxFrame    = g_max_rcv;
+    dwStop        = 0;
+    dwTasks       = 0;
+    dwDropFull    = 0;
+    dwDropNoMem   = 0;
+    memset(atReactor, 0, sizeof(atReactor));
+    memset(atWorker, 0, sizeof(atWorker));
+    /* 0号接收任务的epoll fd先建好，客户端连接可在ServInit之前加入；size参数只作提示，连接数不受其限制 */
+    atReactor[0].ptCtl  = this;
+    atReactor[0].dwepfd = epoll_create(1024);
+    if (-1 == atReactor[0].dwepfd)
+    {
+        R_Printf("CCommCtl epoll_create error!error %d\n",errno);
+    }
     Vos_Init_Mutex(&mutex);
-    /* ptLinkItem = new class CCommLink[dwlink]; */
 }
 
+/* 先停接收和工作任务，再关闭全部连接、监听fd和各接收任务的epoll fd。
+   调用者须保证此时没有任务还在用LinkSend/HandleSend发送 */
 CCommCtl::~CCommCtl()
 {
-    /* delete []ptLinkItem; */
+    WORD32      dwi;
+    
+    StopTasks();
+    if(ptLinkSlot)
+    {
+        for (dwi = 0; dwi < g_max_cli; dwi ++)
+        {
+            if(NULL != ptLinkSlot[dwi].ptLink)
+            {
+                close(dwi);
+                delete ptLinkSlot[dwi].ptLink;
+            }
+        }
+        Vos_Free(ptLinkSlot);
+        ptLinkSlot = NULL;
+    }
+    if(dwservfd > 0)
+    {
+        close(dwservfd);
+        dwservfd = 0;
+    }
+    for (dwi = 0; dwi < COMM_MAX_REACTOR; dwi ++)
+    {
+        if(atReactor[dwi].dwepfd > 0)
+        {
+            close(atReactor[dwi].dwepfd);
+            atReactor[dwi].dwepfd = 0;
+        }
+    }
+    pthread_mutex_destroy(&mutex);
+}
+
+/* 通知接收和工作任务退出并等它们全部退出，再释放工作任务中未处理的消息和同步对象。
+   接收任务每次epoll_wait最多等1s，因此最多等1s左右 */
+WORD32 CCommCtl::StopTasks()
+{
+    T_CommJob           *ptJob;
+    WORD32              dwi;
+    
+    dwStop = 1;
+    for (dwi = 0; dwi < dwWorkerInit; dwi ++)
+    {
+        Vos_Pthread_Mutex_Lock(&atWorker[dwi].mutex);
+        pthread_cond_broadcast(&atWorker[dwi].tNotEmpty);
+        Vos_Pthread_Mutex_Unlock(&atWorker[dwi].mutex);
+    }
+    /* 用原子读取等待计数归零，任务退出前的写入对本线程可见 */
+    while(0 != __sync_fetch_and_add(&dwTasks, 0))
+    {
+        usleep(10000);
+    }
+    for (dwi = 0; dwi < dwWorkerInit; dwi ++)
+    {
+        while(NULL != atWorker[dwi].ptHead)
+        {
+            ptJob = atWorker[dwi].ptHead;
+            atWorker[dwi].ptHead = ptJob->ptNext;
+            Vos_Free((BYTE *)ptJob);
+        }
+        atWorker[dwi].ptTail  = NULL;
+        atWorker[dwi].dwCount = 0;
+        pthread_cond_destroy(&atWorker[dwi].tNotEmpty);
+        pthread_mutex_destroy(&atWorker[dwi].mutex);
+    }
+    dwWorkerInit = 0;
+    dwStop       = 0;
+    return 0;
+}
+
+static inline WORD32 comm_addr_hash(WORD32 addr)
+{
+    return ((addr * 2654435761U) >> (32 - COMM_ADDR_HASH_BITS));
+}
+
+/* 发送路径查找连接不加锁：查找者按当前纪元的奇偶计数，摘除连接的一方翻转纪元后
+   等旧纪元的查找者全部退出，此后不会再有人拿到被摘除的连接，即可释放。
+   读区间内只做查找和引用计数，不能阻塞 */
+WORD32 CCommCtl::ReadLock()
+{
+    WORD32      dwEpochNow;
+    
+    while(1)
+    {
+        dwEpochNow = dwEpoch;
+        __sync_fetch_and_add(&adwReaders[dwEpochNow & 1], 1);
+        if(dwEpochNow == dwEpoch)
+        {
+            return (dwEpochNow & 1);
+        }
+        /* 纪元已翻转，可能错过了等待，按新纪元重新登记 */
+        __sync_fetch_and_sub(&adwReaders[dwEpochNow & 1], 1);
+    }
+}
+
+WORD32 CCommCtl::ReadUnlock(WORD32 dwIdx)
+{
+    __sync_fetch_and_sub(&adwReaders[dwIdx], 1);
+    return 0;
+}
+
+/* 在mutex下调用，保证同一时刻只有一个翻转 */
+WORD32 CCommCtl::Synchronize()
+{
+    WORD32      dwOld = dwEpoch;
+    
+    __sync_fetch_and_add(&dwEpoch, 1);
+    while(0 != adwReaders[dwOld & 1])
+    {
+        sched_yield();
+    }
+    return 0;
 }
 
+/* 在ReadLock区间内调用；同一地址有多条连接时返回最后建立的一条 */
+class CCommLink *CCommCtl::FindLink(WORD32 addr)
+{
+    class CCommLink     *ptlink;
+    
+    for (ptlink = aptAddrHash[comm_addr_hash(addr)]; ptlink != NULL; ptlink = ptlink->ptNext)
+    {
+        if(ptlink->dwAddr == addr)
+        {
+            return ptlink;
+        }
+    }
+    return NULL;
+}
+
+/* 把消息放入发送队列：先填满队尾块的剩余空间，不够再申请新块，
+   小消息因此合并在同一块里，由SndFlush一次sendmsg发出。调用者持有sndmutex */
+WORD32  CCommLink::SndAppend(BYTE *ptbuf, WORD32 dwlen)
+{
+    T_CommSndBuf        *ptBuf = ptSndTail;
+    WORD32              dwCopy;
+    WORD32              dwSize;
+    
+    while(dwlen > 0)
+    {
+        if((NULL == ptBuf) || (ptBuf->dwTail == ptBuf->dwSize))
+        {
+            dwSize = (dwlen > g_max_snd) ? dwlen : g_max_snd;
+            ptBuf  = (T_CommSndBuf *)Vos_Malloc(MEM_COMM_TYPE, sizeof(T_CommSndBuf) + dwSize);
+            if(NULL == ptBuf)
+            {
+                return LEOF;
+            }
+            ptBuf->ptNext = NULL;
+            ptBuf->dwSize = dwSize;
+            ptBuf->dwHead = 0;
+            ptBuf->dwTail = 0;
+            if(NULL == ptSndTail)
+            {
+                ptSndHead = ptBuf;
+            }
+            else
+            {
+                ptSndTail->ptNext = ptBuf;
+            }
+            ptSndTail = ptBuf;
+        }
+        dwCopy = ptBuf->dwSize - ptBuf->dwTail;
+        if(dwCopy > dwlen)
+        {
+            dwCopy = dwlen;
+        }
+        memcpy((BYTE *)(ptBuf + 1) + ptBuf->dwTail, ptbuf, dwCopy);
+        ptBuf->dwTail += dwCopy;
+        dwSndBytes    += dwCopy;
+        ptbuf         += dwCopy;
+        dwlen         -= dwCopy;
+    }
+    return 0;
+}
+
+/* 队列非空时关注EPOLLOUT，由所属接收任务在可写时调用SndFlush；队列发完后取消关注。调用者持有sndmutex */
+WORD32  CCommLink::SndWatch(WORD32 dwOn)
+{
+    struct epoll_event   tEvent;
+    
+    if((dwSndWatch == dwOn) || (NULL == ptOwner))
+    {
+        return 0;
+    }
+    tEvent.events   = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if(dwOn)
+    {
+        tEvent.events |= EPOLLOUT;
+    }
+    tEvent.data.ptr = (void *)this;
+    if (-1 == epoll_ctl(ptOwner->atReactor[dwReactor].dwepfd, EPOLL_CTL_MOD, dwacfd, &tEvent))
+    {
+        R_Printf("SndWatch epoll_ctl error!fd %d,error %d\n",dwacfd,errno);
+        return LEOF;
+    }
+    dwSndWatch = dwOn;
+    return 0;
+}
+
+/* 发送不再阻塞在send上：队列为空时先直接发，发不完的部分拷入发送队列，由接收任务在可写时发出。
+   整条消息在sndmutex下入队，多个任务向同一连接发送时消息不会交错。
+   队列超过高水位时等待降到低水位，最多等g_snd_wait，超时返回失败，由调用者决定丢弃或重发。
+   注意：不挂工作任务时回调在接收任务中执行，若在回调中发送且对端不收，只能等超时返回 */
 WORD32  CCommLink::send2(BYTE *ptbuf, WORD32 dwlen)
 {
-    SWORD32      sdwSendCount;
-    WORD32       dwSnd = dwlen;
+    SWORD32             sdwSendCount = 0;
+    struct timeval      tNow;
+    struct timespec     tDeadline;
     
     if(dwlen == 0)
     {
         R_Printf("packet socket send error!%d\n",errno);
         return -1;
     }
-    /* Ȳ */
-    do
+    Vos_Pthread_Mutex_Lock(&sndmutex);
+    if((0 == dwSndErr) && (dwSndBytes >= g_snd_high))
+    {
+        gettimeofday(&tNow, NULL);
+        tDeadline.tv_sec  = tNow.tv_sec + g_snd_wait / 1000;
+        tDeadline.tv_nsec = tNow.tv_usec * 1000 + (g_snd_wait % 1000) * 1000000;
+        if(tDeadline.tv_nsec >= 1000000000)
+        {
+            tDeadline.tv_sec  ++;
+            tDeadline.tv_nsec -= 1000000000;
+        }
+        while((0 == dwSndErr) && (dwSndBytes > g_snd_low))
+        {
+            if(ETIMEDOUT == pthread_cond_timedwait(&tSndCond, &sndmutex, &tDeadline))
+            {
+                Vos_Pthread_Mutex_Unlock(&sndmutex);
+                R_Printf("packet socket send queue full!fd %d,queued %d\n",dwacfd,dwSndBytes);
+                return -1;
+            }
+        }
+    }
+    if(dwSndErr)
+    {
+        Vos_Pthread_Mutex_Unlock(&sndmutex);
+        return -1;
+    }
+    if(NULL == ptSndHead)
     {
-        sdwSendCount = send(dwacfd,ptbuf+dwlen-dwSnd,dwSnd,0);
+        do
+        {
+            sdwSendCount = send(dwacfd,ptbuf,dwlen,MSG_NOSIGNAL | MSG_DONTWAIT);
+        }while((-1 == sdwSendCount) && (EINTR == errno));
         if(-1 == sdwSendCount)
         {
-            R_Printf("packet socket send error!%d\n",errno);
-            close(dwacfd);
+            if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+            {
+                R_Printf("packet socket send error!%d\n",errno);
+                /* 不在发送线程里close，由接收线程收到挂断事件后统一关闭释放，避免fd被复用 */
+                dwSndErr = 1;
+                shutdown(dwacfd, SHUT_RDWR);
+                Vos_Pthread_Mutex_Unlock(&sndmutex);
+                return -1;
+            }
+            sdwSendCount = 0;
+        }
+    }
+    if((WORD32)sdwSendCount < dwlen)
+    {
+        if(0 != SndAppend(ptbuf + sdwSendCount, dwlen - sdwSendCount))
+        {
+            /* 消息可能已发出一部分，对端无法再对齐，只能断开 */
+            R_Printf("packet socket send queue malloc error!fd %d\n",dwacfd);
+            dwSndErr = 1;
+            shutdown(dwacfd, SHUT_RDWR);
+            Vos_Pthread_Mutex_Unlock(&sndmutex);
             return -1;
         }
-        dwSnd -= sdwSendCount;
-    }while(dwSnd >0);
-    
+        SndWatch(1);
+    }
     dwxid ++;
+    Vos_Pthread_Mutex_Unlock(&sndmutex);
     return 0;
 }
 
+/* 接收任务收到EPOLLOUT时调用：按块聚合成iovec，一直发到队列为空或EAGAIN。返回LEOF表示链路需要关闭 */
+WORD32  CCommLink::SndFlush()
+{
+    struct iovec        atIov[g_max_iov];
+    struct msghdr       tMsg;
+    T_CommSndBuf        *ptBuf;
+    SWORD32             sdwSendCount;
+    WORD32              dwIov;
+    WORD32              dwDone;
+    
+    Vos_Pthread_Mutex_Lock(&sndmutex);
+    while(NULL != ptSndHead)
+    {
+        dwIov = 0;
+        for(ptBuf = ptSndHead; (NULL != ptBuf) && (dwIov < g_max_iov); ptBuf = ptBuf->ptNext)
+        {
+            atIov[dwIov].iov_base = (BYTE *)(ptBuf + 1) + ptBuf->dwHead;
+            atIov[dwIov].iov_len  = ptBuf->dwTail - ptBuf->dwHead;
+            dwIov ++;
+        }
+        /* 用sendmsg而不用writev，才能带MSG_NOSIGNAL */
+        memset(&tMsg, 0, sizeof(tMsg));
+        tMsg.msg_iov    = atIov;
+        tMsg.msg_iovlen = dwIov;
+        sdwSendCount = sendmsg(dwacfd, &tMsg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(-1 == sdwSendCount)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+            {
+                break;
+            }
+            R_Printf("packet socket sendmsg error!%d\n",errno);
+            dwSndErr = 1;
+            pthread_cond_broadcast(&tSndCond);
+            Vos_Pthread_Mutex_Unlock(&sndmutex);
+            return LEOF;
+        }
+        dwSndBytes -= sdwSendCount;
+        while(sdwSendCount > 0)
+        {
+            ptBuf  = ptSndHead;
+            dwDone = ptBuf->dwTail - ptBuf->dwHead;
+            if((WORD32)sdwSendCount < dwDone)
+            {
+                ptBuf->dwHead += sdwSendCount;
+                break;
+            }
+            sdwSendCount -= dwDone;
+            ptSndHead = ptBuf->ptNext;
+            if(NULL == ptSndHead)
+            {
+                ptSndTail = NULL;
+            }
+            Vos_Free(ptBuf);
+        }
+    }
+    if(NULL == ptSndHead)
+    {
+        SndWatch(0);
+    }
+    if(dwSndBytes <= g_snd_low)
+    {
+        pthread_cond_broadcast(&tSndCond);
+    }
+    Vos_Pthread_Mutex_Unlock(&sndmutex);
+    return 0;
+}
+
+/* 连接关闭前调用：此后send2都返回失败，唤醒等待队列的发送者 */
+WORD32  CCommLink::SndClose()
+{
+    Vos_Pthread_Mutex_Lock(&sndmutex);
+    dwSndErr = 1;
+    pthread_cond_broadcast(&tSndCond);
+    Vos_Pthread_Mutex_Unlock(&sndmutex);
+    return 0;
+}
+
+/* 设置最大消息长度，接收缓存按需增长到该值为止 */
 WORD32  CCommLink::SetRcvSize(WORD32 size)
 {
+    if(size < sizeof(class msg_header))
+    {
+        return LEOF;
+    }
+    dwMaxRcv = size;
     return 0;
 }
 
+/* 保证从dwRcvHead起能连续放下dwNeed字节：尾部不够时把未派发的半条消息移到缓存头，
+   缓存本身不够时按倍数增长。每次只移动不足一条的剩余数据，且只在尾部用完时移动 */
+WORD32  CCommLink::RcvReserve(WORD32 dwNeed)
+{
+    WORD32      dwPending = dwRcvOff - dwRcvHead;
+    WORD32      dwNewLen;
+    BYTE        *pucNewBuf;
+    
+    if((dwRcvHead + dwNeed <= rcvlen) && (dwRcvOff < rcvlen))
+    {
+        return 0;
+    }
+    if(dwNeed <= rcvlen)
+    {
+        if(dwPending)
+        {
+            memmove(pucRcvBuf, pucRcvBuf + dwRcvHead, dwPending);
+        }
+        dwRcvHead = 0;
+        dwRcvOff  = dwPending;
+        return 0;
+    }
+    if(dwNeed > dwMaxRcv)
+    {
+        R_Printf("stream socket receive frame too long %d,max %d!\n",dwNeed,dwMaxRcv);
+        return LEOF;
+    }
+    dwNewLen = rcvlen * 2;
+    if(dwNewLen < dwNeed)
+    {
+        dwNewLen = dwNeed;
+    }
+    if(dwNewLen > dwMaxRcv)
+    {
+        dwNewLen = dwMaxRcv;
+    }
+    pucNewBuf = (BYTE *)Vos_Malloc(MEM_COMM_TYPE, dwNewLen);
+    if(NULL == pucNewBuf)
+    {
+        R_Printf("stream socket receive malloc error %d!\n",dwNewLen);
+        return LEOF;
+    }
+    if(dwPending)
+    {
+        memcpy(pucNewBuf, pucRcvBuf + dwRcvHead, dwPending);
+    }
+    if(pucRcvBuf)
+    {
+        Vos_Free(pucRcvBuf);
+    }
+    pucRcvBuf = pucNewBuf;
+    rcvlen    = dwNewLen;
+    dwRcvHead = 0;
+    dwRcvOff  = dwPending;
+    return 0;
+}
+
+/* 消息紧接在上一条之后，起始位置不一定按msg_header对齐，长度字段逐字节取 */
+static inline WORD32 comm_frame_len(const BYTE *pucFrame)
+{
+    WORD16      wLen;
+    
+    memcpy(&wLen, pucFrame + offsetof(msg_header, length), sizeof(wLen));
+    return ntohs(wLen);
+}
+
+/* 回调按msg_header访问消息，未对齐时拷到对齐的缓存再交出，拷贝只涉及这一条消息。
+   缓存按需增长，最大为dwMaxRcv，内存不足返回NULL */
+class msg_header *CCommLink::RcvAligned(BYTE *pucFrame, WORD32 dwlen)
+{
+    BYTE        *pucNewBuf;
+    
+    if(0 == ((unsigned long)pucFrame & (__alignof__(class msg_header) - 1)))
+    {
+        return (class msg_header *)pucFrame;
+    }
+    if(dwlen > dwAlignLen)
+    {
+        pucNewBuf = (BYTE *)Vos_Malloc(MEM_COMM_TYPE, (dwlen > g_init_rcv) ? dwlen : g_init_rcv);
+        if(NULL == pucNewBuf)
+        {
+            R_Printf("stream socket receive malloc error %d!\n",dwlen);
+            return NULL;
+        }
+        if(pucAlignBuf)
+        {
+            Vos_Free(pucAlignBuf);
+        }
+        pucAlignBuf = pucNewBuf;
+        dwAlignLen  = (dwlen > g_init_rcv) ? dwlen : g_init_rcv;
+    }
+    memcpy(pucAlignBuf, pucFrame, dwlen);
+    return (class msg_header *)pucAlignBuf;
+}
+
 WORD32  msg_free(class msg_header  *pkt)
 {
     Vos_Free((BYTE *)pkt);
@@ -212,259 +709,560 @@ struct msg_header  *GetHeader(BYTE  *ptUser)
 
 
 
-WORD32 CCommCtl::AppendLink(WORD32 fd, WORD32 addr)
+/* 设置接收任务数，须在ServInit之前调用；各任务的epoll fd在这里建好，之后加入的连接即可分配 */
+WORD32 CCommCtl::SetReactorNum(WORD32 num)
 {
-    CCommLink     *ptlink = new class  CCommLink(0, fd, addr);
-    Vos_Pthread_Mutex_Lock(&mutex);
-    if(NULL == ptLinkItem)
+    WORD32      dwi;
+    WORD32      dwj;
+    
+    if((num == 0) || (num > COMM_MAX_REACTOR) || (dwservfd != 0))
+    {
+        return LEOF;
+    }
+    for (dwi = 1; dwi < num; dwi ++)
+    {
+        if(atReactor[dwi].dwepfd > 0)
+        {
+            continue;
+        }
+        atReactor[dwi].ptCtl  = this;
+        atReactor[dwi].dwepfd = epoll_create(1024);
+        if (-1 == atReactor[dwi].dwepfd)
+        {
+            R_Printf("SetReactorNum epoll_create error!error %d\n",errno);
+            atReactor[dwi].dwepfd = 0;
+            /* 关闭本次多建的epoll fd，接收任务数保持不变；还没有连接分配到这些任务 */
+            for (dwj = dwReactorNum; dwj < dwi; dwj ++)
+            {
+                close(atReactor[dwj].dwepfd);
+                atReactor[dwj].dwepfd = 0;
+            }
+            return LEOF;
+        }
+    }
+    dwReactorNum = num;
+    return 0;
+}
+
+/* 设置回调工作任务数，0表示在接收任务中直接回调；须在ServInit之前调用 */
+WORD32 CCommCtl::SetWorkerNum(WORD32 num)
+{
+    if((num > MAX_TASK_NUM) || (dwservfd != 0))
+    {
+        return LEOF;
+    }
+    dwWorkerNum = num;
+    return 0;
+}
+
+/* 设置新连接的最大消息长度 */
+WORD32 CCommCtl::SetMaxFrame(WORD32 size)
+{
+    if(size < sizeof(class msg_header))
+    {
+        return LEOF;
+    }
+    dwMaxFrame = size;
+    return 0;
+}
+
+/* 丢弃消息计数，第一次和之后每g_drop_log次打印累计数 */
+static inline void comm_count_drop(volatile WORD32 *pdwDrop, const CHAR *pcReason, WORD32 fd, WORD32 dwlen)
+{
+    WORD32              dwDrop = __sync_add_and_fetch(pdwDrop, 1);
+    
+    if((1 == dwDrop) || (0 == dwDrop % g_drop_log))
+    {
+        R_Printf("PostJob drop %s!fd %d len %d total %d\n",pcReason,fd,dwlen,dwDrop);
+    }
+}
+
+/* 拷贝消息交给工作任务，同一连接总是交给同一个工作任务，保证消息顺序。
+   接收任务不能阻塞：队列满或内存不足时丢弃该消息，计入dwDropFull/dwDropNoMem并返回LEOF */
+WORD32 CCommCtl::PostJob(class CCommLink *ptlink, BYTE *ptMsg, WORD32 dwlen)
+{
+    TaskEntryProto      pcall = ptlink->pUsercall ? ptlink->pUsercall : g_ptcallback;
+    T_CommWorker        *ptWorker;
+    T_CommJob           *ptJob;
+    
+    if(NULL == pcall)
     {
-        ptLinkItem     = ptlink;
+        return 0;
+    }
+    ptWorker = &atWorker[(WORD32)ptlink->dwacfd % dwWorkerNum];
+    ptJob = (T_CommJob *)Vos_Malloc(MEM_COMM_TYPE, sizeof(T_CommJob) + dwlen);
+    if(NULL == ptJob)
+    {
+        comm_count_drop(&dwDropNoMem, "malloc error", ptlink->dwacfd, dwlen);
+        return LEOF;
+    }
+    ptJob->ptNext = NULL;
+    ptJob->pcall  = pcall;
+    ptJob->dwLen  = dwlen;
+    memcpy((BYTE *)(ptJob + 1), ptMsg, dwlen);
+    
+    Vos_Pthread_Mutex_Lock(&ptWorker->mutex);
+    if(ptWorker->dwCount >= g_max_jobs)
+    {
+        Vos_Pthread_Mutex_Unlock(&ptWorker->mutex);
+        Vos_Free((BYTE *)ptJob);
+        comm_count_drop(&dwDropFull, "queue full", ptlink->dwacfd, dwlen);
+        return LEOF;
+    }
+    if(NULL == ptWorker->ptTail)
+    {
+        ptWorker->ptHead = ptJob;
     }
     else
     {
-        ptlink->ptNext = ptLinkItem;
-        ptLinkItem     = ptlink;
+        ptWorker->ptTail->ptNext = ptJob;
     }
-    dwNum ++;
-    Vos_Pthread_Mutex_Unlock(&mutex);
+    ptWorker->ptTail = ptJob;
+    ptWorker->dwCount ++;
+    pthread_cond_signal(&ptWorker->tNotEmpty);
+    Vos_Pthread_Mutex_Unlock(&ptWorker->mutex);
+    return 0;
+}
+
+/* 挂到fd表和地址哈希，失败时关闭fd并返回LEOF。
+   在mutex下先加入epoll，成功后才发布到fd表和地址哈希；发布前接收任务就收到事件时，
+   它调用的CloseLink要拿mutex，会等到发布完成后再摘除 */
+WORD32 CCommCtl::AppendLink(WORD32 fd, WORD32 addr)
+{
+    CCommLink           *ptlink;
+    T_CommLinkSlot      *ptSlot;
+    T_CommReactor       *ptReactor;
+    struct epoll_event  tEvent;
+    WORD32              dwOption = 1;
+    WORD32              dwHash = comm_addr_hash(addr);
+    WORD32              dwGen;
+    WORD32              dwret;
+    
+    if((NULL == ptLinkSlot) || (fd >= g_max_cli))
+    {
+        R_Printf("AppendLink fd %d out of link table!\n",fd);
+        close(fd);
+        return LEOF;
+    }
+    ptlink = new class  CCommLink(0, fd, addr);
+    /* 边沿触发要求fd非阻塞，每次事件都要读到EAGAIN */
+    ioctl(fd,FIONBIO,&dwOption);
+    ptlink->ptOwner = this;
+    ptlink->SetRcvSize(dwMaxFrame);
     ptlink->dwUser = 1;
+    Vos_Pthread_Mutex_Lock(&mutex);
+    ptlink->dwReactor = dwNextReactor;
+    ptReactor         = &atReactor[ptlink->dwReactor];
+    /* 代数在1..0x7FFF间循环，句柄不会是0或LEOF */
+    ptSlot            = &ptLinkSlot[fd];
+    dwGen             = (ptSlot->dwGen % 0x7FFF) + 1;
+    ptlink->dwHandle  = (dwGen << 16) | fd;
     
+    tEvent.events   = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    tEvent.data.ptr = (void *)ptlink;
+    if (-1 == epoll_ctl(ptReactor->dwepfd, EPOLL_CTL_ADD, fd, &tEvent))
+    {
+        Vos_Pthread_Mutex_Unlock(&mutex);
+        R_Printf("AppendLink epoll_ctl error!fd %d,error %d\n",fd,errno);
+        delete ptlink;
+        close(fd);
+        return LEOF;
+    }
+    dwNextReactor     = (dwNextReactor + 1) % dwReactorNum;
+    ptReactor->dwLinks ++;
+    ptSlot->dwGen     = dwGen;
+    /* 连接内容写完后再发布，无锁查找者看到的一定是完整的连接 */
+    ptlink->ptNext    = aptAddrHash[dwHash];
+    __sync_synchronize();
+    aptAddrHash[dwHash] = ptlink;
+    ptSlot->ptLink    = ptlink;
+    dwNum ++;
+    dwret = dwNum;
+    Vos_Pthread_Mutex_Unlock(&mutex);
     
-    return dwNum;
+    return dwret;
 }
 
+/* 摘除fd对应的连接并关闭fd，只在该连接所属的接收任务中调用 */
 WORD32 CCommCtl::CloseLink(WORD32 fd)
 {
-    class CCommLink     *ptlink = ptLinkItem;
+    class CCommLink     **pptlink;
     class CCommLink     *ptlinkDel;
     
-    while(1)
+    if((NULL == ptLinkSlot) || (fd >= g_max_cli))
     {
-        if(NULL == ptlink)
-        {
-            return LEOF;
-        }
-        if((ptlink->dwacfd == fd) || (ptlink->dwacfd == 0))
-        {
-            Vos_Pthread_Mutex_Lock(&mutex);
-            ptLinkItem = ptlink->ptNext;
-            ptlinkDel  = ptlink;
-            ptlink     = ptlink->ptNext;
-            dwNum --;  
-            Vos_Pthread_Mutex_Unlock(&mutex);
-            delete ptlinkDel; 
-            continue;                  
-        }
-        break;
+        return LEOF;
     }
     Vos_Pthread_Mutex_Lock(&mutex);
-    while(ptlink->ptNext != NULL)
+    ptlinkDel = ptLinkSlot[fd].ptLink;
+    if(NULL == ptlinkDel)
     {
-        if(ptlink->ptNext->dwacfd == fd)
-        {
-            ptLinkItem = ptlink->ptNext;            
-            dwNum --;
-            Vos_Pthread_Mutex_Unlock(&mutex);
-            delete   ptlink;
-            return 0;
-        }
-        if(ptlink->ptNext->dwacfd == 0)
+        Vos_Pthread_Mutex_Unlock(&mutex);
+        return LEOF;
+    }
+    ptLinkSlot[fd].ptLink = NULL;
+    /* 只改前一个连接的ptNext，被摘除连接自己的ptNext保持不变，正在遍历的查找者仍能走下去 */
+    for (pptlink = (class CCommLink **)&aptAddrHash[comm_addr_hash(ptlinkDel->dwAddr)]; \
+         *pptlink != NULL; pptlink = &((*pptlink)->ptNext))
+    {
+        if(*pptlink == ptlinkDel)
         {
-        	  /* ûĴʣ */
-            ptLinkItem = ptlink->ptNext;
-            dwNum --;            
+            *pptlink = ptlinkDel->ptNext;
+            break;
         }
-        ptlink = ptlink->ptNext;
-    }   
+    }
+    dwNum --;
+    atReactor[ptlinkDel->dwReactor].dwLinks --;
+    /* 等可能拿到该连接的查找者退出，之后引用计数不会再增加 */
+    Synchronize();
     Vos_Pthread_Mutex_Unlock(&mutex);
-    return LEOF;
+    /* 唤醒等待发送队列的任务，等正在发送的任务退出后再释放 */
+    ptlinkDel->SndClose();
+    while(0 != ptlinkDel->dwRef)
+    {
+        sched_yield();
+    }
+    epoll_ctl(atReactor[ptlinkDel->dwReactor].dwepfd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    if(dwclientfd == (INT)fd)
+    {
+        dwclientfd = 0;
+    }
+    delete ptlinkDel;
+    return 0;
 }
+
+/* 依托于本地任务的发送，查找不加锁，在读区间内引用连接，CloseLink等引用释放后才删除 */
 WORD32 CCommCtl::LinkSend(WORD32 addr, BYTE *ptbuf, WORD32 dwlen)
 {
-    class CCommLink     *ptlink = ptLinkItem;
-    WORD32              index = dwNum;
+    class CCommLink     *ptlink;
+    WORD32              dwIdx;
+    WORD32              dwret;
     
-    if(dwNum == 0)
+    dwIdx  = ReadLock();
+    ptlink = FindLink(addr);
+    if(ptlink != NULL)
+    {
+        __sync_fetch_and_add(&ptlink->dwRef, 1);
+    }
+    ReadUnlock(dwIdx);
+    if(ptlink == NULL)
     {
         return LEOF;
     }
-    /* ڱķͣҪǻ */
-    Vos_Pthread_Mutex_Lock(&mutex);
-    do
+    dwret = ptlink->send2(ptbuf,dwlen);
+    __sync_fetch_and_sub(&ptlink->dwRef, 1);
+    return dwret;
+}
+
+/* 取对端地址对应连接的句柄，之后用HandleSend发送可省去地址查找；连接重建后旧句柄失效 */
+WORD32 CCommCtl::GetLinkHandle(WORD32 addr)
+{
+    class CCommLink     *ptlink;
+    WORD32              dwIdx;
+    WORD32              dwHandle = LEOF;
+    
+    dwIdx  = ReadLock();
+    ptlink = FindLink(addr);
+    if(ptlink != NULL)
     {
-        if(ptlink->dwAddr == addr)
-        {
-            break;
-        }
-        index --;
-        ptlink = ptlink->ptNext;
-    }while((ptlink != NULL) && (index > 0));
-    Vos_Pthread_Mutex_Unlock(&mutex);
-    if(index == 0)
+        dwHandle = ptlink->dwHandle;
+    }
+    ReadUnlock(dwIdx);
+    return dwHandle;
+}
+
+/* 按句柄直接从fd表取连接，代数不符说明原连接已关闭，返回LEOF */
+WORD32 CCommCtl::HandleSend(WORD32 handle, BYTE *ptbuf, WORD32 dwlen)
+{
+    class CCommLink     *ptlink;
+    WORD32              dwIdx;
+    WORD32              dwret;
+    WORD32              fd = COMM_HANDLE_FD(handle);
+    
+    if((NULL == ptLinkSlot) || (fd >= g_max_cli))
     {
         return LEOF;
     }
-    return (ptlink->send2(ptbuf,dwlen));
+    dwIdx  = ReadLock();
+    ptlink = ptLinkSlot[fd].ptLink;
+    if((ptlink != NULL) && (ptlink->dwHandle == handle))
+    {
+        __sync_fetch_and_add(&ptlink->dwRef, 1);
+    }
+    else
+    {
+        ptlink = NULL;
+    }
+    ReadUnlock(dwIdx);
+    if(ptlink == NULL)
+    {
+        return LEOF;
+    }
+    dwret = ptlink->send2(ptbuf,dwlen);
+    __sync_fetch_and_sub(&ptlink->dwRef, 1);
+    return dwret;
 }
 
+/* 边沿触发：一直读到EAGAIN为止，返回LEOF表示链路需要关闭。
+   消息在缓存中原地派发，派发后只移动读位置，不再逐条memmove；起始位置未对齐的消息单独拷贝一份再回调 */
 WORD32 CCommLink::receive()
 {
     class msg_header     *ptMsg;
     SWORD32              sdwRcvCount;
     WORD32               dwlen   = 0;
-    
-    sdwRcvCount = recv(dwacfd,pucRcvBuf+dwRcvOff,rcvlen-dwRcvOff,0);
-    if (-1 == sdwRcvCount)
-    {   /* ·쳣߶Զ˹ر */
-        close(dwacfd);
-        return -1;
-    }
-    else if ((0 == sdwRcvCount) && (rcvlen-dwRcvOff > 0)) 
-    {   /* Զ˹ر·رձ */
-        close(dwacfd);
-        return -1;
-    }
-    R_Printf("stream socket receive len %d,error!%d\n",sdwRcvCount, errno);
+    WORD32               dwNeed;
     
     while(1)
-    {    
-        if(dwRcvOff+sdwRcvCount < sizeof(class msg_header))
-        {   /* Ϣͷ㣬Ϣ˳ */
-            dwRcvOff  += (WORD32)sdwRcvCount;
-            break;
-        }
-        ptMsg = (class msg_header *)(pucRcvBuf);
-        dwlen = ntohs(ptMsg->length);
-        if(dwRcvOff+sdwRcvCount < dwlen)
-        {   /* Ϣݲ㣬Ϣ˳ */
-            dwRcvOff  += sdwRcvCount;
-            break;
-        }
-        /* ɷϢ̣ϢͷptMsgptMsg->dwLen,עϢҪ */
-        if(pUsercall)
+    {
+        /* 已有消息头时按消息长度预留，否则至少能放下消息头 */
+        dwNeed = sizeof(class msg_header);
+        if(dwRcvOff - dwRcvHead >= sizeof(class msg_header))
         {
-
-            pUsercall((void *)ptMsg);
+            dwNeed = comm_frame_len(pucRcvBuf + dwRcvHead);
         }
-        else if(g_ptcallback)
+        if(0 != RcvReserve(dwNeed))
         {
-        	  g_ptcallback((void *)ptMsg);
+            return LEOF;
         }
-        R_Printf("packet socket receive len %d,error!%d\n",dwlen, errno);
-        /* ɷ,ʣϢƶͷ´ɷ */
-        dwRcvOff = dwRcvOff+sdwRcvCount-dwlen;
-        if(dwRcvOff)
+        sdwRcvCount = recv(dwacfd,pucRcvBuf+dwRcvOff,rcvlen-dwRcvOff,0);
+        if (-1 == sdwRcvCount)
         {
-            memmove(pucRcvBuf,pucRcvBuf+dwlen, dwRcvOff);    
-        }        
-        sdwRcvCount       = 0;
-    }    
+            if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+            {   /* 本次事件的数据已读完 */
+                break;
+            }
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            /* 链路异常 */
+            return LEOF;
+        }
+        else if (0 == sdwRcvCount) 
+        {   /* 对端关闭链路，关闭本端 */
+            return LEOF;
+        }
+        dwRcvOff += (WORD32)sdwRcvCount;
+        
+        while(1)
+        {    
+            if(dwRcvOff - dwRcvHead < sizeof(class msg_header))
+            {   /* 消息头不足，缓存消息退出 */
+                break;
+            }
+            dwlen = comm_frame_len(pucRcvBuf + dwRcvHead);
+            if((dwlen < sizeof(class msg_header)) || (dwlen > dwMaxRcv))
+            {   /* 长度非法，无法再定位后续消息 */
+                R_Printf("stream socket receive bad length %d!\n",dwlen);
+                return LEOF;
+            }
+            if(dwRcvOff - dwRcvHead < dwlen)
+            {   /* 消息内容不足，缓存消息退出 */
+                break;
+            }
+            /* 派发消息流程，消息头ptMsg，长度ptMsg->dwLen,注意消息要拷贝 */
+            if(ptOwner && ptOwner->dwWorkerNum)
+            {   /* 回调交给工作任务，消息已拷贝到对齐的位置 */
+                ptOwner->PostJob(this, pucRcvBuf + dwRcvHead, dwlen);
+                dwRcvHead += dwlen;
+                continue;
+            }
+            ptMsg = RcvAligned(pucRcvBuf + dwRcvHead, dwlen);
+            if(NULL == ptMsg)
+            {
+                return LEOF;
+            }
+            if(pUsercall)
+            {
+                pUsercall((void *)ptMsg);
+            }
+            else if(g_ptcallback)
+            {
+            	  g_ptcallback((void *)ptMsg);
+            }
+            dwRcvHead += dwlen;
+        }
+        if(dwRcvHead == dwRcvOff)
+        {   /* 全部派发完，从缓存头重新开始，不需要移动 */
+            dwRcvHead = 0;
+            dwRcvOff  = 0;
+        }
+    }
     return 0;
 }
 
-void   *rcv_thread(void *arg)
+/* 监听fd为边沿触发，一次接纳完所有排队的连接 */
+WORD32 CCommCtl::AcceptLinks()
 {
-    
-    struct timeval       tWaitForSelect;
     INT                  recvSocket;    
     struct sockaddr_in   fromAddr;
     WORD32               dwLength;
-    WORD32               dwnum;
-    class  CCommLink     *ptlink;
-    class  CCommLink     *ptnextlink;
-    class  CCommCtl      *ptCtl = (class CCommCtl *)arg;
-    WORD32               dwlen;
-    SWORD32              sdwResult;
-
-
+    WORD32               dwAccepted = 0;
     
     while(1)
-    {    
-        tWaitForSelect.tv_sec  = 0;
-        tWaitForSelect.tv_usec = 1000*1000;  /* 1 */
-        
-        FD_ZERO(&ptCtl->tRcvSock); 
-        if(ptCtl->dwservfd)
-        { 
-            FD_SET((WORD32)ptCtl->dwservfd,&ptCtl->tRcvSock);
-        }        
-        
-        if(ptCtl->dwclientfd)
-        { 
-            FD_SET((WORD32)ptCtl->dwclientfd,&ptCtl->tRcvSock);
-        }       
-        for (ptlink = ptCtl->ptLinkItem,dwnum = 0; dwnum < ptCtl->dwNum; dwnum ++,ptlink = ptlink->ptNext)
-        {            
-            if(ptlink->dwUser == 1)
+    {
+        dwLength   = sizeof(struct sockaddr);
+        recvSocket = accept(dwservfd,(struct sockaddr *)&fromAddr,(socklen_t *)&dwLength);  
+        if(recvSocket == -1)
+        {
+            if (EINTR == errno)
             {
-                FD_SET(ptlink->dwacfd, &ptCtl->tRcvSock);
+                continue;
             }
+            if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+            {
+                R_Printf("rcv_thread accept error,err %d!\n",errno);
+            }
+            break;
         }
-        sdwResult = select(FD_SETSIZE, &ptCtl->tRcvSock, NULL, NULL,&tWaitForSelect);
-        
-        if (0 == sdwResult)
+        if(dwNum < g_max_cli)
         {
-            FD_ZERO(&ptCtl->tRcvSock); 
-            R_Printf("rcv_thread failed in select,err %d!\n",errno);
-            continue;
+            AppendLink(recvSocket,ntohl(fromAddr.sin_addr.s_addr));
+            dwAccepted ++;
         }
-        else if (sdwResult < 0)
+        else
+        {
+            close(recvSocket);
+        }
+    }
+    if(dwAccepted)
+    {
+        R_Printf("rcv_thread accept %d,total %d!\n",dwAccepted,dwNum);
+    }
+    return dwAccepted;
+}
+
+/* 只处理有事件的连接，不再每轮遍历全部连接；监听fd只在0号接收任务中。
+   dwStop置位后在下一次epoll_wait返回时退出 */
+void   *rcv_thread(void *arg)
+{
+    struct epoll_event   atEvents[g_max_events];
+    class  CCommLink     *ptlink;
+    T_CommReactor        *ptReactor = (T_CommReactor *)arg;
+    class  CCommCtl      *ptCtl = ptReactor->ptCtl;
+    SWORD32              sdwResult;
+    SWORD32              sdwi;
+
+    
+    while(0 == ptCtl->dwStop)
+    {    
+        sdwResult = epoll_wait(ptReactor->dwepfd, atEvents, g_max_events, 1000);
+        if (sdwResult < 0)
         {
             if (EINTR == errno)
             {
                 continue;
             }
-            /*  */
+            R_Printf("rcv_thread failed in epoll_wait,err %d!\n",errno);
+            continue;
         }
         
-        if(FD_ISSET(ptCtl->dwservfd,&ptCtl->tRcvSock))
+        for (sdwi = 0; sdwi < sdwResult; sdwi ++)
         {
-            dwLength   = sizeof(struct sockaddr);
-            recvSocket = accept(ptCtl->dwservfd,(struct sockaddr *)&fromAddr,(socklen_t *)&dwLength);  
-            
-            if(recvSocket != -1)
+            ptlink = (class CCommLink *)atEvents[sdwi].data.ptr;
+            if(NULL == ptlink)
+            {   /* 监听fd */
+                ptCtl->AcceptLinks();
+                continue;
+            }
+            if((atEvents[sdwi].events & EPOLLOUT) && (LEOF == ptlink->SndFlush()))
             {
-                if(ptCtl->dwNum < g_max_cli)
-                {
-                    ptCtl->AppendLink(recvSocket,ntohl(fromAddr.sin_addr.s_addr));
-                    FD_SET((WORD32)recvSocket,&ptCtl->tRcvSock);
-                    R_Printf("rcv_thread accept %d,err %d!\n",ptCtl->dwNum,errno);
-                }
-                else
-                {
-                    close(recvSocket);
-                }
+                ptCtl->CloseLink(ptlink->dwacfd);
+                continue;
+            }
+            if(0 == (atEvents[sdwi].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)))
+            {
+                continue;
+            }
+            if((LEOF == ptlink->receive()) || (atEvents[sdwi].events & (EPOLLERR | EPOLLHUP)))
+            {
+                ptCtl->CloseLink(ptlink->dwacfd);
             }
         }
+    }
+    __sync_fetch_and_sub(&ptCtl->dwTasks, 1);
+    return NULL;
+}
+
+/* 回调工作任务，一次取走队列中的全部消息再逐条回调；dwStop置位后不再等新消息，未取走的由StopTasks释放 */
+void   *work_thread(void *arg)
+{
+    T_CommWorker         *ptWorker = (T_CommWorker *)arg;
+    class  CCommCtl      *ptCtl = ptWorker->ptCtl;
+    T_CommJob            *ptJob;
+    T_CommJob            *ptNextJob;
+    
+    while(1)
+    {
+        Vos_Pthread_Mutex_Lock(&ptWorker->mutex);
+        while((NULL == ptWorker->ptHead) && (0 == ptCtl->dwStop))
+        {
+            pthread_cond_wait(&ptWorker->tNotEmpty, &ptWorker->mutex);
+        }
+        if(ptCtl->dwStop)
+        {
+            Vos_Pthread_Mutex_Unlock(&ptWorker->mutex);
+            break;
+        }
+        ptJob             = ptWorker->ptHead;
+        ptWorker->ptHead  = NULL;
+        ptWorker->ptTail  = NULL;
+        ptWorker->dwCount = 0;
+        Vos_Pthread_Mutex_Unlock(&ptWorker->mutex);
         
-        for (ptlink = ptCtl->ptLinkItem,dwnum = 0; dwnum < ptCtl->dwNum; dwnum ++)
+        while(ptJob != NULL)
         {
-        	  ptnextlink =ptlink->ptNext;
-            if((ptlink->dwUser == 1) && (FD_ISSET(ptlink->dwacfd, &ptCtl->tRcvSock)))
-            {                
-                if(ptlink->receive() == -1)
-                {
-                    ptCtl->CloseLink(ptlink->dwacfd);
-                }
-            }    
-            ptlink = ptnextlink; 
+            ptNextJob = ptJob->ptNext;
+            ptJob->pcall((void *)(ptJob + 1));
+            Vos_Free((BYTE *)ptJob);
+            ptJob = ptNextJob;
         }
     }
-
+    __sync_fetch_and_sub(&ptCtl->dwTasks, 1);
     return NULL;
 }
 
+/* ServInit失败时撤销已做的部分：停掉已起的任务并释放工作任务的同步对象，关闭监听fd(随之移出epoll)，
+   清掉接收任务的序号和名字。各接收任务的epoll fd仍归CCommCtl所有，由析构关闭，之后可以再次ServInit */
+WORD32  CCommCtl::ServCleanup()
+{
+    WORD32            dwi;
+    
+    StopTasks();
+    if(dwservfd > 0)
+    {
+        epoll_ctl(atReactor[0].dwepfd, EPOLL_CTL_DEL, dwservfd, NULL);
+        close(dwservfd);
+    }
+    dwservfd = 0;
+    for (dwi = 0; dwi < COMM_MAX_REACTOR; dwi ++)
+    {
+        atReactor[dwi].dwIndex = 0;
+        memset(atReactor[dwi].acName, 0, sizeof(atReactor[dwi].acName));
+    }
+    return 0;
+}
+
 WORD32  CCommCtl::ServInit(WORD32 dwIp, WORD32 dwPort)
 {
     struct sockaddr   tSockAddr;
+    struct epoll_event tEvent;
     WORD32            dwOption;
-    WORD32            dwret;
+    WORD32            dwret = 0;
+    WORD32            dwi;
     
 
+    if(atReactor[0].dwepfd <= 0)
+    {
+        R_Printf("CCommCtl::ServInit no epoll fd!\n");
+        return -1;
+    }
     dwservfd  =  socket(AF_INET,SOCK_STREAM,IPPROTO_TCP);
     if (-1 == dwservfd)
     {
         R_Printf("packet socket error!error %d\n",errno);
+        dwservfd = 0;
         return -1;
     }
     
@@ -473,32 +1271,76 @@ WORD32  CCommCtl::ServInit(WORD32 dwIp, WORD32 dwPort)
     if (-1 == bind(dwservfd,(struct sockaddr *)&tSockAddr,sizeof(tSockAddr)))
     {
         R_Printf("packet socket bind error!error %d\n",errno);
-        close(dwservfd);
-        dwservfd = 0;
+        ServCleanup();
         return -1;
     }
     dwOption                   = 1;
     
     ioctl(dwservfd,FIONBIO,&dwOption);    
     
-    if (-1 == listen(dwservfd,5))
+    if (-1 == listen(dwservfd,SOMAXCONN))
     {
         R_Printf("packet socket listen error!error %d\n",errno);
-        close(dwservfd);
-        dwservfd = 0;
+        ServCleanup();
         return -1;
     }
     
-    FD_SET(dwservfd, &tRcvSock);
+    /* 监听fd的data.ptr为NULL，与连接区分 */
+    tEvent.events   = EPOLLIN | EPOLLET;
+    tEvent.data.ptr = NULL;
+    if (-1 == epoll_ctl(atReactor[0].dwepfd, EPOLL_CTL_ADD, dwservfd, &tEvent))
+    {
+        R_Printf("packet socket epoll_ctl error!error %d\n",errno);
+        ServCleanup();
+        return -1;
+    }
         
-    dwret = Vos_CreateTask((CHAR *)"comm_server", COMM_SERV_PRI, COMM_SERV_STACK, 0, \
-                           (TaskEntryProto)rcv_thread, (WORDPTR)this, SCHE_INVALID_CPUID);
+    /* 先起工作任务，再起接收任务；同步对象全部建好后再起任务，失败时StopTasks按dwWorkerInit释放 */
+    for (dwi = 0; dwi < dwWorkerNum; dwi ++)
+    {
+        atWorker[dwi].ptCtl = this;
+        Vos_Init_Mutex(&atWorker[dwi].mutex);
+        pthread_cond_init(&atWorker[dwi].tNotEmpty, NULL);
+        snprintf(atWorker[dwi].acName, sizeof(atWorker[dwi].acName), "comm_worker%u", (BYTE)dwi);
+    }
+    dwWorkerInit = dwWorkerNum;
+    for (dwi = 0; dwi < dwWorkerNum; dwi ++)
+    {
+        __sync_fetch_and_add(&dwTasks, 1);
+        dwret = Vos_CreateTask(atWorker[dwi].acName, COMM_SERV_PRI, COMM_SERV_STACK, 0, \
+                               (TaskEntryProto)work_thread, (WORDPTR)&atWorker[dwi], SCHE_INVALID_CPUID);
+        if(LEOF == dwret)
+        {
+            __sync_fetch_and_sub(&dwTasks, 1);
+            R_Printf("CCommCtl::ServInit failed in create worker %d,err %d!\n",dwi,errno);
+            ServCleanup();
+            return -1;
+        }
+    }
     
-    if(LEOF == dwret)
+    for (dwi = 0; dwi < dwReactorNum; dwi ++)
     {
-        R_Printf("CCommCtl::ServInit failed in pthread_create serv,err %d!\n",errno);
-        close(dwservfd);
-        return -1;
+        atReactor[dwi].ptCtl   = this;
+        atReactor[dwi].dwIndex = dwi;
+        if(0 == dwi)
+        {
+            snprintf(atReactor[dwi].acName, sizeof(atReactor[dwi].acName), "comm_server");
+        }
+        else
+        {
+            snprintf(atReactor[dwi].acName, sizeof(atReactor[dwi].acName), "comm_server%u", (BYTE)dwi);
+        }
+        __sync_fetch_and_add(&dwTasks, 1);
+        dwret = Vos_CreateTask(atReactor[dwi].acName, COMM_SERV_PRI, COMM_SERV_STACK, 0, \
+                               (TaskEntryProto)rcv_thread, (WORDPTR)&atReactor[dwi], SCHE_INVALID_CPUID);
+        
+        if(LEOF == dwret)
+        {
+            __sync_fetch_and_sub(&dwTasks, 1);
+            R_Printf("CCommCtl::ServInit failed in pthread_create serv,err %d!\n",errno);
+            ServCleanup();
+            return -1;
+        }
     }
     
     /*
@@ -541,9 +1383,12 @@ WORD32 CCommCtl::ClientInit(WORD32 dwIp, WORD32 dwPort)
         close(dwclientfd);
         return -1;
     }
-    FD_SET(dwclientfd, &tRcvSock);
-    
     dwnum = AppendLink(dwclientfd, dwIp);
+    if(LEOF == dwnum)
+    {
+        dwclientfd = 0;
+        return -1;
+    }
     
 
   
@@ -1,18 +1,18 @@
 /*********************************************************************
- * Ȩ (C)2014
+ * 版权所有 (C)2014
  *
- * ļƣ 
- * ļʶ 
- * ˵ ͨͷļ
- * ǰ汾 V1.0
- *     ߣ 
- * ڣ 
+ * 文件名称： 
+ * 文件标识： 
+ * 其它说明： 通信头文件
+ * 当前版本： V1.0
+ * 作    者： 
+ * 完成日期： 
  *
- * ޸ļ¼1
- *    ޸ڣ2014116
- *      ţV1.0
- *      ˣNew
- *    ޸ݣ
+ * 修改记录1：
+ *    修改日期：2014年1月16日
+ *    版 本 号：V1.0
+ *    修 改 人：New
+ *    修改内容：创建
  **********************************************************************/
 #ifndef _COMM_H_
 #define _COMM_H_
@@ -23,60 +23,159 @@
 extern "C" {
 #endif
 
-#define   MAX_TASK_NUM    ((WORD32)4)    /* ֧󲢷ͨѶ */ 
+#ifndef MAX_TASK_NUM
+#define   MAX_TASK_NUM    ((WORD32)4)    /* 支持最大并发的任务数，不包括通讯任务，即回调工作任务数上限；可在编译时指定 */ 
+#endif
+#define   COMM_MAX_REACTOR ((WORD32)8)   /* 通讯接收任务数上限 */
+#define   COMM_ADDR_HASH_BITS ((WORD32)12)  /* 地址哈希桶数为2的该次幂 */
+#define   COMM_ADDR_HASH   ((WORD32)1 << COMM_ADDR_HASH_BITS)
+#define   COMM_HANDLE_FD(h)   ((h) & 0xFFFF)   /* 连接句柄低16位为fd，高位为该fd的代数 */
+#define   COMM_HANDLE_GEN(h)  ((h) >> 16)
+
+class  CCommCtl;
+
+/* 通讯接收任务，每个任务一个epoll fd，只处理分配给自己的连接 */
+typedef struct tagCommReactor
+{
+    class  CCommCtl        *ptCtl;
+    INT                    dwepfd;      /* 接收事件epoll fd，边沿触发 */
+    WORD32                 dwIndex;     /* 任务序号                   */
+    WORD32                 dwLinks;     /* 分配到本任务的连接数       */
+    CHAR                   acName[16];
+}T_CommReactor;
+
+/* 交给工作任务的消息，消息内容紧跟在结构后面 */
+typedef struct tagCommJob
+{
+    struct tagCommJob      *ptNext;
+    TaskEntryProto         pcall;       /* 回调               */
+    WORD32                 dwLen;       /* 消息长度           */
+}T_CommJob;
+
+/* 回调工作任务，处理耗时回调，接收任务只负责收包和拷贝 */
+typedef struct tagCommWorker
+{
+    class  CCommCtl        *ptCtl;
+    T_CommJob              *ptHead;
+    T_CommJob              *ptTail;
+    WORD32                 dwCount;     /* 队列中的消息数     */
+    pthread_mutex_t        mutex;
+    pthread_cond_t         tNotEmpty;
+    CHAR                   acName[16];
+}T_CommWorker;
+
+/* 按fd下标的连接表项，fd每次挂上新连接代数加1，旧句柄因此失效 */
+typedef struct tagCommLinkSlot
+{
+    class  CCommLink * volatile ptLink;
+    WORD32                 dwGen;
+}T_CommLinkSlot;
+
+/* 发送队列块，数据紧跟在结构后面，[dwHead,dwTail)为待发送部分 */
+typedef struct tagCommSndBuf
+{
+    struct tagCommSndBuf   *ptNext;
+    WORD32                 dwSize;      /* 块容量             */
+    WORD32                 dwHead;      /* 已发送到的位置     */
+    WORD32                 dwTail;      /* 已写入到的位置     */
+}T_CommSndBuf;
 
 class  CCommLink
 {
 public:    
-    INT                    dwacfd;      /* ͨfd                   */
-    WORD32                 dwAddr;      /* ÷˵ַ             */    
-    WORD32                 dwUser;      /* ûʶչ       */    
-    WORD32                 dwPad;       /* չֶ                 */ 
-    WORD32                 dwRcvOff;    /* ƫ                 */ 
-    WORD32                 dwxid;       /* Ӵ             */
-    WORD32                 dwtype;      /*  */    
-    class  CCommLink       *ptNext;     /* ָһ    */
+    INT                    dwacfd;      /* 通信fd                   */
+    WORD32                 dwAddr;      /* 该服务端地址             */    
+    WORD32                 dwUser;      /* 用户标识，后续扩展       */    
+    WORD32                 dwPad;       /* 扩展字段                 */ 
+    WORD32                 dwRcvOff;    /* 接收偏移，已收数据的末尾 */ 
+    WORD32                 dwxid;       /* 连接传输编号             */
+    WORD32                 dwtype;      /* 处理类型 */    
+    WORD32                 dwReactor;   /* 所属接收任务序号 */
+    class  CCommCtl        *ptOwner;    /* 所属通信控制     */
+    class  CCommLink       *ptNext;     /* 同一地址哈希桶中的下一个连接 */
+    WORD32                 dwHandle;    /* 连接句柄，代数<<16|fd */
     WORD32 SetRcvSize(WORD32 size);
     WORD32 receive();
     WORD32 send2(BYTE *ptbuf, WORD32 dwlen);
-    TaskEntryProto         pUsercall;   /* ûص          */
+    WORD32 SndFlush();
+    WORD32 SndClose();
+    volatile WORD32        dwRef;       /* 正在使用该连接发送的任务数 */
+    TaskEntryProto         pUsercall;   /* 用户回调          */
     WORD32 SetUsercall(TaskEntryProto pcall);
     CCommLink(WORD32 type,WORD32 fd,WORD32 addr);
     ~CCommLink();    
 private:
-    BYTE                   *pucRcvBuf;  /* ûջ  */
+    WORD32 RcvReserve(WORD32 dwNeed);
+    class msg_header *RcvAligned(BYTE *pucFrame, WORD32 dwlen);
+    BYTE                   *pucRcvBuf;  /* 用户接收缓存，按需增长  */
+    BYTE                   *pucAlignBuf; /* 消息在接收缓存中未对齐时拷到这里再回调 */
+    WORD32                 dwAlignLen;
     WORD32                 rcvlen;
-    BYTE                   *pucSndBuf;  /* ûͻ  */
-    WORD32                 sndlen;
+    WORD32                 dwRcvHead;   /* 未派发数据的起始偏移  */
+    WORD32                 dwMaxRcv;    /* 最大消息长度，即接收缓存上限 */
+    WORD32 SndAppend(BYTE *ptbuf, WORD32 dwlen);
+    WORD32 SndWatch(WORD32 dwOn);
+    T_CommSndBuf           *ptSndHead;  /* 发送队列，发送和接收任务都在sndmutex下访问 */
+    T_CommSndBuf           *ptSndTail;
+    WORD32                 dwSndBytes;  /* 队列中待发送字节数 */
+    WORD32                 dwSndErr;    /* 链路发送失败或已关闭 */
+    WORD32                 dwSndWatch;  /* 是否已关注EPOLLOUT */
+    pthread_mutex_t        sndmutex;
+    pthread_cond_t         tSndCond;    /* 队列降到低水位以下时唤醒发送者 */
 };
 
 
 class  CCommCtl
 {
 public:
-    WORD32                 dwserv;      /* ÷                     */
-    WORD32                 nodeid;      /* ȫֽڵʶּȺڽڵ   */
-    WORD32                 dwUser;      /* ûʶֱض   */
-    pthread_t              serv_th;     /* ͨŷ߳                 */
-    pthread_t              cli_th;      /* ͨſͻ߳                 */
-    INT                    dwservfd;    /* fd         */
-    int                    dwclientfd;  /* ͻfd         */
-    class  CCommLink       *ptLinkItem; /* ˽fd         */
-    fd_set                 tRcvSock;    /* ׽ּ   */
-    WORD32                 dwflags;     /* ʶ                       */
-    WORD32                 dwNum;       /* ˽ */
-    WORD32                 dwType;      /*                        */    
-    pthread_mutex_t        mutex;       /* ͨѶҪܣ滻 */
+    WORD32                 dwserv;      /* 该服务类型                     */
+    WORD32                 nodeid;      /* 全局节点标识，区分集群内节点   */
+    WORD32                 dwUser;      /* 本地用户标识，区分本地多进程   */
+    pthread_t              serv_th;     /* 通信服务端线程                 */
+    pthread_t              cli_th;      /* 通信客户端线程                 */
+    INT                    dwservfd;    /* 服务端fd         */
+    int                    dwclientfd;  /* 客户端fd         */
+    T_CommLinkSlot         *ptLinkSlot; /* 按fd下标的连接表，g_max_cli项 */
+    class  CCommLink * volatile aptAddrHash[COMM_ADDR_HASH]; /* 按对端地址的哈希 */
+    T_CommReactor          atReactor[COMM_MAX_REACTOR]; /* 接收任务       */
+    WORD32                 dwReactorNum;  /* 接收任务数                     */
+    WORD32                 dwNextReactor; /* 新连接按轮转分配到接收任务     */
+    T_CommWorker           atWorker[MAX_TASK_NUM];      /* 回调工作任务   */
+    WORD32                 dwWorkerNum;   /* 工作任务数，0表示在接收任务中直接回调 */
+    WORD32                 dwWorkerInit;  /* 已建好同步对象的工作任务数   */
+    volatile WORD32        dwStop;        /* 通知接收和工作任务退出       */
+    volatile WORD32        dwTasks;       /* 正在运行的接收和工作任务数   */
+    volatile WORD32        dwDropFull;    /* 工作任务队列满丢弃的消息数   */
+    volatile WORD32        dwDropNoMem;   /* 内存不足丢弃的消息数         */
+    WORD32                 dwMaxFrame;    /* 新连接的最大消息长度           */
+    WORD32                 dwflags;     /* 标识                       */
+    WORD32                 dwNum;       /* 服务端接纳连接数量 */
+    WORD32                 dwType;      /* 进程类型                       */    
+    pthread_mutex_t        mutex;       /* 通讯要求高性能，后面可能替换成其它的 */
     WORD32   AppendLink(WORD32 fd, WORD32 addr);
     WORD32   CloseLink(WORD32 fd);
     WORD32   ClientInit(WORD32 dwIp, WORD32 dwPort);
     WORD32   ServInit(WORD32 dwIp, WORD32 dwPort);
     WORD32   LinkSend(WORD32 addr, BYTE *ptbuf, WORD32 dwlen);
+    WORD32   GetLinkHandle(WORD32 addr);
+    WORD32   HandleSend(WORD32 handle, BYTE *ptbuf, WORD32 dwlen);
+    WORD32   AcceptLinks();
+    WORD32   SetReactorNum(WORD32 num);
+    WORD32   SetWorkerNum(WORD32 num);
+    WORD32   SetMaxFrame(WORD32 size);
+    WORD32   PostJob(class CCommLink *ptlink, BYTE *ptMsg, WORD32 dwlen);
     CCommCtl();
     ~CCommCtl();
 
 private:
-
+    WORD32   StopTasks();
+    WORD32   ServCleanup();
+    class  CCommLink *FindLink(WORD32 addr);
+    WORD32   ReadLock();
+    WORD32   ReadUnlock(WORD32 dwIdx);
+    WORD32   Synchronize();
+    volatile WORD32        dwEpoch;     /* 查找纪元，摘除连接后翻转 */
+    volatile WORD32        adwReaders[2]; /* 按纪元奇偶计数的无锁查找者 */
 };
 WORD32  getipaddr();
 #ifdef __cplusplus
@@ -0,0 +1,380 @@
+// AlarmArchiverTest.cpp : CAlarmArchiver的分块迁移和断点续迁，告警表和实时库管道用进程内的假实现代替
+//
+// 假管道解析MoveChunk拼出的语句，取出每块的行数、截止日期和起始ID，在内存中的TE_ALARM_INDEX上
+// 按ID顺序取一块移到TE_ALARM_INDEX_BAK，按NET_MESSAGE_RETRECORDOFTB报文格式返回(@n, @last)。
+// 进度文件由Win32Compat.h中进程内的配置表代替。
+
+#include "alarm/stdafx.h"
+#include "TestCommon.h"
+#include "AlarmArchiver.h"
+#include <string>
+
+CLog *g_log = NULL;
+
+//每条语句的执行方式
+enum
+{
+	CHUNK_OK = 0,
+	CHUNK_FAIL,			//执行失败，事务回滚，无应答
+	CHUNK_LOST_REPLY,	//事务已提交，应答丢失
+};
+
+static std::map<std::string, std::string> g_mapIndex;	//TE_ALARM_INDEX：ID -> ALARMTIME
+static std::map<std::string, std::string> g_mapBak;		//TE_ALARM_INDEX_BAK
+static int g_nDupInserts = 0;							//备份表中ID重复的插入次数
+static std::vector<std::string> g_vecAfter;				//每条语句的起始ID(已还原转义)
+static std::vector<int> g_vecChunk;						//每条语句的执行方式，用完后一律成功
+static size_t g_nChunkPos = 0;
+static int g_nBadSql = 0;								//无法解析或三处范围条件不一致的语句数
+
+static void ResetTable()
+{
+	g_mapIndex.clear();
+	g_mapBak.clear();
+	g_nDupInserts = 0;
+	g_vecAfter.clear();
+	g_vecChunk.clear();
+	g_nChunkPos = 0;
+	g_nBadSql = 0;
+}
+
+HANDLE OpenRealDataPipe()
+{
+	return CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+BYTE* GetMessage_RecordOfSql_Ext(HANDLE /*hPipe*/, CString & /*strSql*/)
+{
+	return NULL;
+}
+
+BYTE* GetNetMessage(HANDLE /*hPipe*/, BYTE * /*pWrite*/, DWORD /*dwLen*/)
+{
+	return NULL;
+}
+
+//取pBegin之后到单引号结束的字符串，''还原为'；返回结束引号之后的位置，没有结束引号时返回NULL
+static const char *ReadQuoted(const char *pBegin, std::string &strValue)
+{
+	strValue.clear();
+	const char *p = pBegin;
+	while (*p != '\0')
+	{
+		if (*p == '\'')
+		{
+			if (p[1] != '\'')
+			{
+				return p + 1;
+			}
+			p++;
+		}
+		strValue += *p++;
+	}
+	return NULL;
+}
+
+static int CountOf(const std::string &strText, const std::string &strPart)
+{
+	int nCount = 0;
+	for (size_t nPos = strText.find(strPart); nPos != std::string::npos; nPos = strText.find(strPart, nPos + 1))
+	{
+		nCount++;
+	}
+	return nCount;
+}
+
+//(int @n, varchar @last)一行的记录集应答
+static BYTE *MakeReply(int nRows, const std::string &strLast)
+{
+	DWORD dwRecordLen = sizeof(DWORD) + ARCHIVE_ID_MAXLEN;
+	DWORD dwRecords = 1;
+	size_t nLen = sizeof(NetMessageHead) + sizeof(WORD) + sizeof(MessageRetRecordHead)*2 + sizeof(DWORD)*2 + dwRecordLen;
+	BYTE *pReply = new BYTE[nLen];
+	memset(pReply, 0, nLen);
+	BYTE *pByte = pReply;
+	NetMessageHead *pHead = (NetMessageHead*)pByte;
+	pHead->MessageType = NET_MESSAGE_RETRECORDOFTB;
+	pHead->Length = (DWORD)(nLen - sizeof(NetMessageHead));
+	pByte += sizeof(NetMessageHead);
+	*(WORD*)pByte = 2;
+	pByte += sizeof(WORD);
+	MessageRetRecordHead *pField = (MessageRetRecordHead*)pByte;
+	pField[0].DataLen = sizeof(DWORD);
+	pField[1].DataLen = ARCHIVE_ID_MAXLEN;
+	pByte += sizeof(MessageRetRecordHead)*2;
+	memcpy(pByte, &dwRecordLen, sizeof(DWORD));
+	pByte += sizeof(DWORD);
+	memcpy(pByte, &dwRecords, sizeof(DWORD));
+	pByte += sizeof(DWORD);
+	memcpy(pByte, &nRows, sizeof(DWORD));
+	memcpy(pByte + sizeof(DWORD), strLast.c_str(), strLast.size() < ARCHIVE_ID_MAXLEN ? strLast.size() : ARCHIVE_ID_MAXLEN - 1);
+	return pReply;
+}
+
+//执行MoveChunk的语句：按ID顺序取strAfter之后、ALARMTIME不晚于截止日期零点的前nTop行，插入备份表后删除
+BYTE* GetMessage_RecordOfSql(HANDLE /*hPipe*/, CString &strSql)
+{
+	std::string strText = (LPCTSTR)strSql;
+	int nMode = g_nChunkPos < g_vecChunk.size() ? g_vecChunk[g_nChunkPos++] : CHUNK_OK;
+	int nTop = 0;
+	size_t nTopPos = strText.find("SELECT TOP(");
+	const char *pCutoff = strstr(strText.c_str(), "ALARMTIME <= '");
+	if (nTopPos == std::string::npos || sscanf(strText.c_str() + nTopPos, "SELECT TOP(%d)", &nTop) != 1 || pCutoff == NULL
+		|| strText.find("BEGIN TRAN;") == std::string::npos || strText.find("COMMIT;") == std::string::npos
+		|| strText.find("INSERT INTO TE_ALARM_INDEX_BAK (ID,GROUP1,") == std::string::npos)
+	{
+		g_nBadSql++;
+		return NULL;
+	}
+	std::string strCutoff, strAfter;
+	const char *p = ReadQuoted(pCutoff + strlen("ALARMTIME <= '"), strCutoff);
+	if (p == NULL || strncmp(p, " AND ID > '", strlen(" AND ID > '")) != 0
+		|| (p = ReadQuoted(p + strlen(" AND ID > '"), strAfter)) == NULL)
+	{
+		g_nBadSql++;
+		return NULL;
+	}
+	//选取、插入和删除三处用同一个范围条件
+	if (CountOf(strText, std::string(pCutoff, p - pCutoff)) != 3)
+	{
+		g_nBadSql++;
+		return NULL;
+	}
+	g_vecAfter.push_back(strAfter);
+	if (nMode == CHUNK_FAIL)
+	{
+		return NULL;
+	}
+	strCutoff += " 00:00:00";
+	std::vector<std::string> vecChunk;
+	for (std::map<std::string, std::string>::iterator it = g_mapIndex.upper_bound(strAfter);
+		it != g_mapIndex.end() && (int)vecChunk.size() < nTop; ++it)
+	{
+		if (it->second <= strCutoff)
+		{
+			vecChunk.push_back(it->first);
+		}
+	}
+	for (size_t i=0; i<vecChunk.size(); i++)
+	{
+		if (g_mapBak.find(vecChunk[i]) != g_mapBak.end())
+		{
+			g_nDupInserts++;
+		}
+		g_mapBak[vecChunk[i]] = g_mapIndex[vecChunk[i]];
+		g_mapIndex.erase(vecChunk[i]);
+	}
+	if (nMode == CHUNK_LOST_REPLY)
+	{
+		return NULL;
+	}
+	return MakeReply((int)vecChunk.size(), vecChunk.empty() ? std::string() : vecChunk.back());
+}
+
+class CTestArchiver : public CAlarmArchiver
+{
+public:
+	CTestArchiver(int nChunkRows)
+	{
+		m_nChunkRows = nChunkRows;
+		m_nRowsPerSec = 0;
+	}
+	using CAlarmArchiver::RunArchive;
+	using CAlarmArchiver::LoadCheckpoint;
+};
+
+static std::string ReadCheckpoint(const CString &strPath, LPCTSTR szKey)
+{
+	char szValue[ARCHIVE_ID_MAXLEN];
+	GetPrivateProfileString(_T("CHECKPOINT"), szKey, _T(""), szValue, sizeof(szValue), strPath);
+	return szValue;
+}
+
+static const COleDateTime g_Cutoff(2024, 6, 1, 0, 0, 0);
+
+//nOld行早于截止日期，nNew行晚于截止日期，ID随机且两类交错
+static void FillTable(int nOld, int nNew)
+{
+	unsigned int nSeed = 7;
+	while ((int)g_mapIndex.size() < nOld + nNew)
+	{
+		char szId[40];
+		snprintf(szId, sizeof(szId), "%08X-%04X-%04X", rand_r(&nSeed), rand_r(&nSeed)&0xFFFF, rand_r(&nSeed)&0xFFFF);
+		int nDay = (int)g_mapIndex.size() < nOld ? 1 + rand_r(&nSeed)%28 : 2 + rand_r(&nSeed)%27;
+		char szTime[32];
+		snprintf(szTime, sizeof(szTime), "2024-%02d-%02d 12:00:00", (int)g_mapIndex.size() < nOld ? 5 : 6, nDay);
+		g_mapIndex[szId] = szTime;
+	}
+}
+
+static int CountIndexBefore(const std::string &strCutoff)
+{
+	int nCount = 0;
+	for (std::map<std::string, std::string>::iterator it = g_mapIndex.begin(); it != g_mapIndex.end(); ++it)
+	{
+		nCount += it->second <= strCutoff;
+	}
+	return nCount;
+}
+
+//分块参数从emscfg.ini读取，非法值取缺省值
+static void TestConfig()
+{
+	CAlarmArchiver Archiver;
+	CString strCfg = Archiver.m_strCheckpointPath;
+	strCfg.Replace(_T("AlarmArchive.ini"), _T("emscfg.ini"));
+	CHECK(!Archiver.m_strCheckpointPath.IsEmpty());
+	CHECK(Archiver.m_nChunkRows == ARCHIVE_CHUNK_ROWS && Archiver.m_nRowsPerSec == ARCHIVE_ROWS_PER_SEC);
+	WritePrivateProfileString(_T("ALARMARCHIVE"), _T("ChunkRows"), _T("700"), strCfg);
+	WritePrivateProfileString(_T("ALARMARCHIVE"), _T("RowsPerSec"), _T("0"), strCfg);
+	CAlarmArchiver Archiver2;
+	CHECK(Archiver2.m_nChunkRows == 700 && Archiver2.m_nRowsPerSec == 0);
+	WritePrivateProfileString(_T("ALARMARCHIVE"), _T("ChunkRows"), _T("-1"), strCfg);
+	CAlarmArchiver Archiver3;
+	CHECK(Archiver3.m_nChunkRows == ARCHIVE_CHUNK_ROWS);
+}
+
+//一次迁完：早于截止日期的行全部按块移到备份表，其余不动，完成后清掉进度
+static void TestFullRun()
+{
+	ResetTable();
+	FillTable(5000, 3000);
+	CTestArchiver Archiver(700);
+	Archiver.StartArchive(g_Cutoff);
+	CHECK(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("Cutoff")) == "2024-06-01");
+	CHECK(Archiver.RunArchive());
+	CHECK(g_nBadSql == 0);
+	CHECK(g_mapBak.size() == 5000 && g_mapIndex.size() == 3000);
+	CHECK(CountIndexBefore("2024-06-01 00:00:00") == 0);
+	CHECK(g_nDupInserts == 0);
+	//5000行按700行一块共8块，最后一块不满即结束，不再多发一条空语句
+	CHECK(Archiver.m_nTotalChunks == 8 && g_vecAfter.size() == 8);
+	CHECK(Archiver.m_nTotalMoved == 5000);
+	//每块从上一块的最大ID之后开始
+	BOOL bChained = g_vecAfter.size() > 0 && g_vecAfter[0].empty();
+	for (size_t i=1; i<g_vecAfter.size(); i++)
+	{
+		bChained = bChained && g_vecAfter[i] > g_vecAfter[i-1];
+	}
+	CHECK(bChained);
+	CHECK(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("Cutoff")).empty());
+	CHECK(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("LastId")).empty());
+
+	//没有可迁移的行时一条语句即结束
+	g_vecAfter.clear();
+	Archiver.StartArchive(g_Cutoff);
+	CHECK(Archiver.RunArchive());
+	CHECK(g_vecAfter.size() == 1 && g_mapBak.size() == 5000);
+
+	//正好整块时多发一条语句确认已迁完
+	ResetTable();
+	FillTable(1400, 10);
+	CTestArchiver Archiver2(700);
+	Archiver2.StartArchive(g_Cutoff);
+	CHECK(Archiver2.RunArchive());
+	CHECK(g_vecAfter.size() == 3 && g_mapBak.size() == 1400 && Archiver2.m_nTotalChunks == 2);
+}
+
+//第3块失败：前两块的进度已记下，重启后从断点继续，不重复也不遗漏
+static void TestResumeAfterFailure()
+{
+	ResetTable();
+	FillTable(3000, 500);
+	g_vecChunk.push_back(CHUNK_OK);
+	g_vecChunk.push_back(CHUNK_OK);
+	g_vecChunk.push_back(CHUNK_FAIL);
+	std::string strLastId;
+	{
+		CTestArchiver Archiver(1000);
+		Archiver.StartArchive(g_Cutoff);
+		CHECK(!Archiver.RunArchive());
+		CHECK(g_mapBak.size() == 2000);
+		strLastId = g_mapBak.empty() ? std::string() : g_mapBak.rbegin()->first;
+		CHECK(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("Cutoff")) == "2024-06-01");
+		CHECK(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("LastId")) == strLastId);
+		CHECK(atoll(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("Moved")).c_str()) == 2000);
+	}
+
+	//重启：新对象从进度文件读出未完成的任务
+	CTestArchiver Archiver(1000);
+	Archiver.LoadCheckpoint();
+	CHECK(strcmp(Archiver.m_strCutoff, "2024-06-01") == 0);
+	CHECK(strcmp(Archiver.m_strLastId, strLastId.c_str()) == 0 && Archiver.m_nMoved == 2000);
+	size_t nBefore = g_vecAfter.size();
+	CHECK(Archiver.RunArchive());
+	CHECK(g_vecAfter.size() > nBefore && g_vecAfter[nBefore] == strLastId);
+	CHECK(g_mapBak.size() == 3000 && g_mapIndex.size() == 500);
+	CHECK(g_nDupInserts == 0);
+	CHECK(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("Cutoff")).empty());
+}
+
+//事务已提交但应答丢失：进度停在上一块，重试时已迁走的行不在告警表中，不会重复插入备份表
+static void TestLostReply()
+{
+	ResetTable();
+	FillTable(2500, 100);
+	g_vecChunk.push_back(CHUNK_OK);
+	g_vecChunk.push_back(CHUNK_LOST_REPLY);
+	CTestArchiver Archiver(1000);
+	Archiver.StartArchive(g_Cutoff);
+	CHECK(!Archiver.RunArchive());
+	CHECK(g_mapBak.size() == 2000);
+	CHECK(atoll(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("Moved")).c_str()) == 1000);
+	CHECK(Archiver.RunArchive());
+	CHECK(g_mapBak.size() == 2500 && g_mapIndex.size() == 100);
+	CHECK(g_nDupInserts == 0);
+}
+
+//块间休眠时收到退出：本块的进度已保存，任务保留到下次
+static void TestExitBetweenChunks()
+{
+	ResetTable();
+	FillTable(3000, 0);
+	CTestArchiver Archiver(1000);
+	Archiver.m_nRowsPerSec = 1;
+	Archiver.StartArchive(g_Cutoff);
+	SetEvent(Archiver.m_hExitEvent);
+	CHECK(!Archiver.RunArchive());
+	CHECK(g_vecAfter.size() == 1 && g_mapBak.size() == 1000);
+	CHECK(!g_mapBak.empty() && ReadCheckpoint(Archiver.m_strCheckpointPath, _T("LastId")) == g_mapBak.rbegin()->first);
+
+	//同一截止日期再次提交时保留进度；截止日期变了则从头开始
+	Archiver.StartArchive(g_Cutoff);
+	CHECK(Archiver.m_nMoved == 1000 && !Archiver.m_strLastId.IsEmpty());
+	Archiver.StartArchive(COleDateTime(2024, 5, 20, 0, 0, 0));
+	CHECK(Archiver.m_nMoved == 0 && Archiver.m_strLastId.IsEmpty());
+	CHECK(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("Cutoff")) == "2024-05-20");
+	CHECK(ReadCheckpoint(Archiver.m_strCheckpointPath, _T("LastId")).empty());
+	ResetEvent(Archiver.m_hExitEvent);
+	Archiver.m_nRowsPerSec = 0;
+	CHECK(Archiver.RunArchive());
+	CHECK(CountIndexBefore("2024-05-20 00:00:00") == 0);
+	CHECK(g_nDupInserts == 0 && g_nBadSql == 0);
+}
+
+//ID中含单引号时起始ID按SQL转义，块的边界不错位
+static void TestQuotedId()
+{
+	ResetTable();
+	g_mapIndex["A'1"] = "2024-05-01 08:00:00";
+	g_mapIndex["B''2"] = "2024-05-02 08:00:00";
+	g_mapIndex["C3"] = "2024-05-03 08:00:00";
+	g_mapIndex["D'"] = "2024-07-01 08:00:00";
+	CTestArchiver Archiver(1);
+	Archiver.StartArchive(g_Cutoff);
+	CHECK(Archiver.RunArchive());
+	CHECK(g_nBadSql == 0);
+	CHECK(g_vecAfter.size() == 4 && g_vecAfter[1] == "A'1" && g_vecAfter[2] == "B''2" && g_vecAfter[3] == "C3");
+	CHECK(g_mapBak.size() == 3 && g_mapIndex.size() == 1 && g_mapIndex.count("D'") == 1);
+}
+
+int main()
+{
+	TestConfig();
+	TestFullRun();
+	TestResumeAfterFailure();
+	TestLostReply();
+	TestExitBetweenChunks();
+	TestQuotedId();
+	return TEST_RESULT();
+}
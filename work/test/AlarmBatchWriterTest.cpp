@@ -0,0 +1,275 @@
+// AlarmBatchWriterTest.cpp : CAlarmBatchWriter的去重、批量拼句和失败重试，实时库管道用假实现代替
+//
+
+#include "alarm/stdafx.h"
+#include "TestCommon.h"
+#include "AlarmBatchWriter.h"
+#include <string>
+
+CLog *g_log = NULL;
+
+// 管道接口的替代：记下每次往返发出的语句，按g_vecReply依次应答，用完后一律确认成功
+enum
+{
+	REPLY_ACK_OK = 0,
+	REPLY_ACK_FAIL,
+	REPLY_NONE,
+	REPLY_OTHER_TYPE,
+};
+static std::vector<int> g_vecReply;
+static size_t g_nReplyPos = 0;
+static std::vector<std::string> g_vecSent;
+static int g_nPipeOpens = 0;
+
+static void ResetPipe()
+{
+	g_vecReply.clear();
+	g_nReplyPos = 0;
+	g_vecSent.clear();
+	g_nPipeOpens = 0;
+}
+
+HANDLE OpenRealDataPipe()
+{
+	g_nPipeOpens++;
+	return CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+BYTE* GetMessage_RecordOfSql_Ext(HANDLE /*hPipe*/, CString &strSql)
+{
+	g_vecSent.push_back((LPCTSTR)strSql);
+	int nReply = g_nReplyPos < g_vecReply.size() ? g_vecReply[g_nReplyPos++] : REPLY_ACK_OK;
+	if (nReply == REPLY_NONE)
+	{
+		return NULL;
+	}
+	BYTE *pReply = new BYTE[sizeof(NetMessageHead) + sizeof(MessageAck)];
+	NetMessageHead *pHead = (NetMessageHead*)pReply;
+	pHead->MessageType = (nReply == REPLY_OTHER_TYPE) ? NET_MESSAGE_RETRECORDOFTB : NET_MESSAGE_ACK;
+	pHead->Length = sizeof(MessageAck);
+	MessageAck *pAck = (MessageAck*)&pReply[sizeof(NetMessageHead)];
+	//记录集报文的前两个字节恰好为0，与NET_MESSAGE_ACK_OK相同
+	pAck->wdAckType = (nReply == REPLY_ACK_FAIL) ? NET_MESSAGE_ACK_OK + 1 : NET_MESSAGE_ACK_OK;
+	return pReply;
+}
+
+BYTE* GetNetMessage(HANDLE /*hPipe*/, BYTE * /*pWrite*/, DWORD /*dwLen*/)
+{
+	return NULL;
+}
+
+static int CountOf(const std::string &strText, const char *pWord)
+{
+	int nCount = 0;
+	for (size_t nPos = strText.find(pWord); nPos != std::string::npos; nPos = strText.find(pWord, nPos + 1))
+	{
+		nCount++;
+	}
+	return nCount;
+}
+
+static int CountSent(const char *pWord)
+{
+	int nCount = 0;
+	for (size_t i=0; i<g_vecSent.size(); i++)
+	{
+		nCount += CountOf(g_vecSent[i], pWord);
+	}
+	return nCount;
+}
+
+static AlarmItemDef MakeAlarm(int nObjId, int nType, __time64_t tTime, const char *pContent)
+{
+	AlarmItemDef ALARMDef;
+	memset(&ALARMDef, 0, sizeof(ALARMDef));
+	snprintf(ALARMDef.alarmID, sizeof(ALARMDef.alarmID), "ID-%d-%d", nObjId, nType);
+	ALARMDef.alarmType = nType;
+	ALARMDef.alarmObjType = 31;
+	ALARMDef.alarmObjID = nObjId;
+	ALARMDef.alarmTime = tTime;
+	ALARMDef.contentTime = tTime;
+	strncpy(ALARMDef.alarmContent, pContent, sizeof(ALARMDef.alarmContent) - 1);
+	return ALARMDef;
+}
+
+//同一对象同一类型只留一条、内容取最新；实时告警按天区分；恢复之后的同一告警不再合并到恢复之前
+static void TestDedupe()
+{
+	ResetPipe();
+	CAlarmBatchWriter Writer;
+	__time64_t tNow = 1718409600;		//2024-06-15
+	Writer.AddAlarm(ALARMWRITE_UPSERT, MakeAlarm(1, 8001, tNow, "first"));
+	Writer.AddAlarm(ALARMWRITE_UPSERT, MakeAlarm(1, 8001, tNow + 60, "second"));
+	CHECK(Writer.m_vecPending.size() == 1 && Writer.m_nTotalMerged == 1);
+	CHECK(strcmp(Writer.m_vecPending[0].ALARMDef.alarmContent, "second") == 0);
+	CHECK(Writer.m_vecPending[0].ALARMDef.contentTime == tNow + 60);
+
+	Writer.AddAlarm(ALARMWRITE_INSERT, MakeAlarm(2, 9003, tNow, "rt1"));
+	Writer.AddAlarm(ALARMWRITE_INSERT, MakeAlarm(2, 9003, tNow + 60, "rt2"));
+	Writer.AddAlarm(ALARMWRITE_INSERT, MakeAlarm(2, 9003, tNow + 86400, "rt3"));
+	CHECK(Writer.m_vecPending.size() == 3 && Writer.m_nTotalMerged == 2);
+
+	Writer.AddAlarm(ALARMWRITE_UPSERT, MakeAlarm(3, 8002, tNow, "before"));
+	Writer.AddAlarm(ALARMWRITE_RECOVER, MakeAlarm(3, 8002, tNow, "recover"));
+	Writer.AddAlarm(ALARMWRITE_UPSERT, MakeAlarm(3, 8002, tNow, "after"));
+	CHECK(Writer.m_vecPending.size() == 6 && Writer.m_nTotalMerged == 2);
+
+	//一次往返：MERGE、两行insert、MERGE、恢复update、MERGE，顺序不变
+	Writer.Flush();
+	CHECK(Writer.m_vecPending.empty() && Writer.m_PendingIndex.empty());
+	CHECK(g_vecSent.size() == 1 && g_nPipeOpens == 1);
+	CHECK(Writer.m_nTotalRoundTrips == 1 && Writer.m_nTotalAlarms == 6);
+	if (g_vecSent.size() == 1)
+	{
+		const std::string &strSql = g_vecSent[0];
+		CHECK(CountOf(strSql, "MERGE") == 3);
+		CHECK(CountOf(strSql, "insert into") == 1 && CountOf(strSql, "'ID-2-9003'") == 2);
+		CHECK(CountOf(strSql, "'first'") == 0 && CountOf(strSql, "'second'") == 1);
+		size_t nBefore = strSql.find("'before'");
+		size_t nRecover = strSql.find("STATUS=2");
+		size_t nAfter = strSql.find("'after'");
+		CHECK(nBefore < nRecover && nRecover < nAfter && nAfter != std::string::npos);
+	}
+}
+
+//连续同类告警每m_nMaxRows行一条语句，短信接在最后；多条语句按m_nMaxBatchBytes拼成一次往返
+static void TestBatching()
+{
+	ResetPipe();
+	CAlarmBatchWriter Writer;
+	__time64_t tNow = 1718409600;
+	SMSConfigDef iSMSConfig;
+	memset(&iSMSConfig, 0, sizeof(iSMSConfig));
+	strcpy(iSMSConfig.PersonName, "O'Brien");
+	strcpy(iSMSConfig.PhoneNum, "13800000000");
+	for (int i=0; i<450; i++)
+	{
+		Writer.AddAlarm(ALARMWRITE_INSERT, MakeAlarm(1000 + i, 9003, tNow, "x"));
+	}
+	for (int i=0; i<5; i++)
+	{
+		Writer.AddSmsRecord(iSMSConfig, _T("sms"));
+	}
+	Writer.Flush();
+	CHECK(g_vecSent.size() == 1 && Writer.m_nTotalRoundTrips == 1);
+	CHECK(CountSent("insert into TE_ALARM_INDEX") == 3);
+	CHECK(CountSent("'ID-") == 450);
+	CHECK(CountSent("INSERT INTO TE_SMSRECORD") == 1 && CountSent("'O''Brien'") == 5);
+	CHECK(Writer.m_nTotalAlarms == 450 && Writer.m_nTotalSms == 5);
+
+	//每条语句都超过4096字节，各自一次往返，只打开一次管道
+	ResetPipe();
+	Writer.m_nMaxBatchBytes = 4096;
+	for (int i=0; i<450; i++)
+	{
+		Writer.AddAlarm(ALARMWRITE_INSERT, MakeAlarm(1000 + i, 9003, tNow, "x"));
+	}
+	Writer.Flush();
+	CHECK(g_vecSent.size() == 3 && g_nPipeOpens == 1);
+	CHECK(CountSent("'ID-") == 450);
+}
+
+//整批失败时逐条重发，只有出错语句中的告警重新排队，重试时单独成句并排在新告警之前；
+//否定应答、无应答和非确认报文都算失败，重试ALARM_BATCH_MAXRETRY次后丢弃
+static void TestRetry()
+{
+	ResetPipe();
+	CAlarmBatchWriter Writer;
+	__time64_t tNow = 1718409600;
+	for (int i=1; i<=3; i++)
+	{
+		Writer.AddAlarm(ALARMWRITE_UPSERT, MakeAlarm(i, 8001, tNow, "merge"));
+	}
+	Writer.AddAlarm(ALARMWRITE_RECOVER, MakeAlarm(9, 8001, tNow, "recover"));
+	g_vecReply.push_back(REPLY_ACK_FAIL);		//整批
+	g_vecReply.push_back(REPLY_OTHER_TYPE);		//MERGE单独重发
+	g_vecReply.push_back(REPLY_ACK_OK);			//恢复语句单独重发
+	Writer.Flush();
+	CHECK(g_vecSent.size() == 3 && Writer.m_nTotalRoundTrips == 3);
+	CHECK(Writer.m_nTotalFailed == 1);
+	CHECK(Writer.m_vecPending.size() == 3);
+	for (size_t i=0; i<Writer.m_vecPending.size(); i++)
+	{
+		CHECK(Writer.m_vecPending[i].nRetry == 1 && Writer.m_vecPending[i].nMode == ALARMWRITE_UPSERT);
+	}
+	//失败后关闭管道，下一条语句重新打开
+	CHECK(g_nPipeOpens == 3);
+
+	//重新排队的告警仍在去重索引中，新到的同一告警合并进去
+	Writer.AddAlarm(ALARMWRITE_UPSERT, MakeAlarm(2, 8001, tNow + 60, "merged again"));
+	Writer.AddAlarm(ALARMWRITE_UPSERT, MakeAlarm(4, 8001, tNow, "new"));
+	CHECK(Writer.m_vecPending.size() == 4 && Writer.m_vecPending[3].ALARMDef.alarmObjID == 4);
+	ResetPipe();
+	Writer.Flush();
+	CHECK(g_vecSent.size() == 1 && CountSent("MERGE") == 4);
+	CHECK(CountSent("'merged again'") == 1);
+	CHECK(Writer.m_vecPending.empty());
+
+	//一直失败：第4次失败时丢弃
+	ResetPipe();
+	Writer.AddAlarm(ALARMWRITE_INSERT, MakeAlarm(5, 9003, tNow, "doomed"));
+	g_vecReply.push_back(REPLY_ACK_FAIL);
+	g_vecReply.push_back(REPLY_NONE);
+	g_vecReply.push_back(REPLY_OTHER_TYPE);
+	g_vecReply.push_back(REPLY_ACK_FAIL);
+	__int64 nDropped = Writer.m_nTotalDropped;
+	for (int i=1; i<=ALARM_BATCH_MAXRETRY; i++)
+	{
+		Writer.Flush();
+		CHECK(Writer.m_vecPending.size() == 1 && Writer.m_vecPending[0].nRetry == i);
+	}
+	Writer.Flush();
+	CHECK(Writer.m_vecPending.empty() && Writer.m_nTotalDropped == nDropped + 1);
+	CHECK(g_vecSent.size() == ALARM_BATCH_MAXRETRY + 1);
+}
+
+struct FlushShared
+{
+	CAlarmBatchWriter *pWriter;
+	volatile LONG bStop;
+};
+
+static void *FlushProc(void *pParam)
+{
+	FlushShared *pShared = (FlushShared*)pParam;
+	while (!pShared->bStop)
+	{
+		pShared->pWriter->Flush();
+	}
+	return NULL;
+}
+
+//多个线程同时Flush时逐个取缓存，每条告警只写一次
+static void TestConcurrentFlush()
+{
+	ResetPipe();
+	CAlarmBatchWriter Writer;
+	FlushShared Shared = { &Writer, 0 };
+	pthread_t Threads[2];
+	for (int i=0; i<2; i++)
+	{
+		pthread_create(&Threads[i], NULL, FlushProc, &Shared);
+	}
+	__time64_t tNow = 1718409600;
+	for (int i=0; i<5000; i++)
+	{
+		Writer.AddAlarm(ALARMWRITE_INSERT, MakeAlarm(20000 + i, 9003, tNow, "c"));
+	}
+	InterlockedExchange(&Shared.bStop, 1);
+	for (int i=0; i<2; i++)
+	{
+		pthread_join(Threads[i], NULL);
+	}
+	Writer.Flush();
+	CHECK(Writer.m_nTotalAlarms == 5000);
+	CHECK(CountSent("'ID-") == 5000);
+}
+
+int main()
+{
+	TestDedupe();
+	TestBatching();
+	TestRetry();
+	TestConcurrentFlush();
+	return TEST_RESULT();
+}
@@ -0,0 +1,93 @@
+// AlarmRulesBench.cpp : 合成100万台设备，统计CAlarmRules装载和规则判断的耗时
+//
+// 设备平均分到2万个品牌，九成有当日账单，一成未占用，两成有合同到期日。品牌合计另用std::map
+// 按设备逐条累加、回填做对照，相当于原来每台设备查两次CMap的做法。
+
+#include "Win32Compat.h"
+#include "../TSAlarmServer_WD/TSAlarmServer_WD/AlarmRules.h"
+#include <map>
+
+#define BENCH_DEV_NUM		1000000
+#define BENCH_BRAND_NUM		20000
+#define BENCH_DATE			20240615
+#define BENCH_ROUNDS		5
+
+static double NowSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+int main()
+{
+	std::vector<int> vecBrandId(BENCH_DEV_NUM), vecOccupied(BENCH_DEV_NUM), vecContractEnd(BENCH_DEV_NUM);
+	std::vector<float> vecDayValue(BENCH_DEV_NUM), vecLast7Value(BENCH_DEV_NUM);
+	unsigned int nSeed = 1;
+	for (int i=0; i<BENCH_DEV_NUM; i++)
+	{
+		vecBrandId[i] = 100000 + rand_r(&nSeed)%BENCH_BRAND_NUM;
+		vecOccupied[i] = i%10 != 0;
+		vecContractEnd[i] = i%5 == 0 ? 20240000 + rand_r(&nSeed)%1231 : 0;
+		vecDayValue[i] = i%10 != 9 ? (float)(rand_r(&nSeed)%2000)/10 : -1.0f;
+		vecLast7Value[i] = (float)(rand_r(&nSeed)%1000)/10;
+	}
+
+	CAlarmRules Rules;
+	Rules.m_nMinValue = 2000;
+	Rules.m_nMaxValue = 150;
+	Rules.m_fMagnifyNum = 2.0f;
+	Rules.m_fRushMinValue = 10.0f;
+	double dLoad = 0, dEvaluate = 0;
+	int nAlarmDev = 0;
+	for (int r=0; r<BENCH_ROUNDS; r++)
+	{
+		double dBegin = NowSeconds();
+		Rules.Resize(BENCH_DEV_NUM);
+		for (int i=0; i<BENCH_DEV_NUM; i++)
+		{
+			Rules.SetDevice(i, vecBrandId[i], vecOccupied[i], vecContractEnd[i]);
+			if (vecDayValue[i] >= 0)
+			{
+				Rules.SetDayValue(i, vecDayValue[i], vecLast7Value[i]);
+			}
+		}
+		double dMid = NowSeconds();
+		nAlarmDev = Rules.Evaluate(BENCH_DATE);
+		dLoad += dMid - dBegin;
+		dEvaluate += NowSeconds() - dMid;
+	}
+
+	//对照：按设备逐条在std::map中累加品牌合计再回填
+	std::vector<float> vecBrandConsume(BENCH_DEV_NUM);
+	double dBegin = NowSeconds();
+	for (int r=0; r<BENCH_ROUNDS; r++)
+	{
+		std::map<int,float> BrandConsumeMap;
+		for (int i=0; i<BENCH_DEV_NUM; i++)
+		{
+			if (vecDayValue[i] >= 0)
+			{
+				BrandConsumeMap[vecBrandId[i]] += vecDayValue[i];
+			}
+		}
+		for (int i=0; i<BENCH_DEV_NUM; i++)
+		{
+			std::map<int,float>::iterator it = BrandConsumeMap.find(vecBrandId[i]);
+			vecBrandConsume[i] = it != BrandConsumeMap.end() ? it->second : 0.0f;
+		}
+	}
+	double dMapSum = NowSeconds() - dBegin;
+
+	int nMismatch = 0;
+	for (int i=0; i<BENCH_DEV_NUM; i++)
+	{
+		nMismatch += vecBrandConsume[i] != Rules.m_vecBrandConsume[i];
+	}
+	printf("devices=%d brands=%d alarm devices=%d\n", BENCH_DEV_NUM, BENCH_BRAND_NUM, nAlarmDev);
+	printf("load             %8.1f ms\n", dLoad*1e3/BENCH_ROUNDS);
+	printf("evaluate         %8.1f ms (%.1f ns/device, brand sum and all rules)\n",
+		dEvaluate*1e3/BENCH_ROUNDS, dEvaluate*1e9/BENCH_ROUNDS/BENCH_DEV_NUM);
+	printf("std::map sum     %8.1f ms (brand sum only)\n", dMapSum*1e3/BENCH_ROUNDS);
+	return nMismatch == 0 ? 0 : 1;
+}
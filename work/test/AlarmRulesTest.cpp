@@ -0,0 +1,148 @@
+// AlarmRulesTest.cpp : CAlarmRules的品牌用电量合计和各条用电规则
+//
+
+#include "Win32Compat.h"
+#include "TestCommon.h"
+#include "../TSAlarmServer_WD/TSAlarmServer_WD/AlarmRules.h"
+
+#define TEST_DATE		20240615
+
+static void InitRules(CAlarmRules &Rules, int nDevCount)
+{
+	Rules.m_nMinValue = 100;
+	Rules.m_nMaxValue = 50;
+	Rules.m_fMagnifyNum = 2.0f;
+	Rules.m_fRushMinValue = 10.0f;
+	Rules.Resize(nDevCount);
+}
+
+//品牌合计只算有账单的设备，同品牌设备回填同一合计，未挂品牌的为0
+static void TestBrandConsume()
+{
+	CAlarmRules Rules;
+	InitRules(Rules, 6);
+	Rules.SetDevice(0, 7, 1, 0);
+	Rules.SetDevice(1, 9, 1, 0);
+	Rules.SetDevice(2, 7, 1, 0);
+	Rules.SetDevice(3, 7, 1, 0);
+	Rules.SetDevice(4, 0, 1, 0);
+	Rules.SetDevice(5, 9, 1, 0);
+	Rules.SetDayValue(0, 30.0f, 30.0f);
+	Rules.SetDayValue(1, 120.0f, 120.0f);
+	Rules.SetDayValue(2, 40.0f, 40.0f);
+	Rules.SetDayValue(4, 500.0f, 500.0f);
+	//3号、5号没有账单，不计入合计但仍回填所属品牌的合计
+	Rules.Evaluate(TEST_DATE);
+	CHECK(Rules.m_vecBrandConsume[0] == 70.0f);
+	CHECK(Rules.m_vecBrandConsume[2] == 70.0f);
+	CHECK(Rules.m_vecBrandConsume[3] == 70.0f);
+	CHECK(Rules.m_vecBrandConsume[1] == 120.0f);
+	CHECK(Rules.m_vecBrandConsume[5] == 120.0f);
+	CHECK(Rules.m_vecBrandConsume[4] == 0.0f);
+
+	//品牌用电少：挂品牌、有账单且合计低于下限
+	CHECK(Rules.m_vecAlarmFlag[0] & ALARMRULE_BRAND_LOW);
+	CHECK(Rules.m_vecAlarmFlag[2] & ALARMRULE_BRAND_LOW);
+	CHECK(!(Rules.m_vecAlarmFlag[3] & ALARMRULE_BRAND_LOW));
+	CHECK(!(Rules.m_vecAlarmFlag[1] & ALARMRULE_BRAND_LOW));
+	CHECK(!(Rules.m_vecAlarmFlag[4] & ALARMRULE_BRAND_LOW));
+}
+
+//品牌数多于初始表长、品牌ID在哈希表中冲突时合计不串
+static void TestManyBrands()
+{
+	CAlarmRules Rules;
+	int nDevCount = 3000;
+	InitRules(Rules, nDevCount);
+	for (int i=0; i<nDevCount; i++)
+	{
+		//品牌ID间隔为表长的倍数，低位全相同
+		int iBrandId = (i%1000 + 1)*8192;
+		Rules.SetDevice(i, iBrandId, 1, 0);
+		Rules.SetDayValue(i, (float)(i%1000), 0.0f);
+	}
+	Rules.Evaluate(TEST_DATE);
+	BOOL bOk = TRUE;
+	for (int i=0; i<nDevCount && bOk; i++)
+	{
+		bOk = Rules.m_vecBrandConsume[i] == 3.0f*(i%1000);
+	}
+	CHECK(bOk);
+}
+
+static void TestRush()
+{
+	CAlarmRules Rules;
+	InitRules(Rules, 5);
+	Rules.SetDevice(0, 0, 0, 0);
+	Rules.SetDevice(1, 0, 1, 0);
+	Rules.SetDevice(2, 0, 0, 0);
+	Rules.SetDevice(3, 0, 0, 0);
+	Rules.SetDevice(4, 0, 0, 0);
+	Rules.SetDayValue(0, 30.0f, 10.0f);		//突增
+	Rules.SetDayValue(1, 30.0f, 10.0f);		//已占用不判断
+	Rules.SetDayValue(2, 8.0f, 1.0f);		//低于最小用电量
+	Rules.SetDayValue(3, 20.0f, 10.0f);		//正好两倍不算
+	//4号没有账单
+	Rules.Evaluate(TEST_DATE);
+	CHECK(Rules.m_vecAlarmFlag[0] & ALARMRULE_RUSH);
+	CHECK(!(Rules.m_vecAlarmFlag[1] & ALARMRULE_RUSH));
+	CHECK(!(Rules.m_vecAlarmFlag[2] & ALARMRULE_RUSH));
+	CHECK(!(Rules.m_vecAlarmFlag[3] & ALARMRULE_RUSH));
+	CHECK(Rules.m_vecAlarmFlag[4] == 0);
+}
+
+static void TestContractEnd()
+{
+	CAlarmRules Rules;
+	InitRules(Rules, 3);
+	Rules.SetDevice(0, 7, 1, TEST_DATE - 1);
+	Rules.SetDevice(1, 7, 1, TEST_DATE);
+	Rules.SetDevice(2, 7, 1, 0);
+	//合同到期不要求有账单
+	Rules.Evaluate(TEST_DATE);
+	CHECK(Rules.m_vecAlarmFlag[0] == ALARMRULE_CONTRACTEND);
+	CHECK(Rules.m_vecAlarmFlag[1] == 0);
+	CHECK(Rules.m_vecAlarmFlag[2] == 0);
+}
+
+static void TestBussinessHigh()
+{
+	CAlarmRules Rules;
+	InitRules(Rules, 3);
+	Rules.SetDevice(0, 0, 0, 0);
+	Rules.SetDevice(1, 0, 1, 0);
+	Rules.SetDevice(2, 0, 0, 0);
+	Rules.SetDayValue(0, 60.0f, 60.0f);
+	Rules.SetDayValue(1, 60.0f, 60.0f);
+	Rules.SetDayValue(2, 50.0f, 50.0f);
+	CHECK(Rules.Evaluate(TEST_DATE) == 1);
+	CHECK(Rules.m_vecAlarmFlag[0] == (ALARMRULE_HASVALUE|ALARMRULE_BUSSINESS_HIGH));
+	CHECK(Rules.m_vecAlarmFlag[1] == ALARMRULE_HASVALUE);
+	CHECK(Rules.m_vecAlarmFlag[2] == ALARMRULE_HASVALUE);
+}
+
+//Resize清掉上一轮的标志和合计
+static void TestReuse()
+{
+	CAlarmRules Rules;
+	InitRules(Rules, 2);
+	Rules.SetDevice(0, 7, 0, TEST_DATE - 1);
+	Rules.SetDayValue(0, 60.0f, 1.0f);
+	CHECK(Rules.Evaluate(TEST_DATE) == 1);
+	Rules.Resize(1);
+	CHECK(Rules.GetCount() == 1);
+	CHECK(Rules.Evaluate(TEST_DATE) == 0);
+	CHECK(Rules.m_vecAlarmFlag[0] == 0 && Rules.m_vecBrandConsume[0] == 0.0f);
+}
+
+int main()
+{
+	TestBrandConsume();
+	TestManyBrands();
+	TestRush();
+	TestContractEnd();
+	TestBussinessHigh();
+	TestReuse();
+	return TEST_RESULT();
+}
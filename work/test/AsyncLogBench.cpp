@@ -0,0 +1,157 @@
+// AsyncLogBench.cpp : ReguTrace经CAsyncLog输出时业务线程一侧的吞吐
+//
+// 日志写到临时目录下的log\Bench_YYYYMMDD_NNN.log。分三种情况统计每秒ReguTrace调用数：
+//	queued	级别开启，单线程每写半个队列就Flush一次(不计时)，每条都进队列，即正常负载下的开销
+//	flood	级别开启，nThreads个线程不停写，后台线程跟不上时丢弃，同时给出实际落盘的比例
+//	off		级别关闭，只做级别判断
+// 测试环境TCHAR为多字节，正文拷贝量是Unicode版的一半。
+
+#include "stdafx.h"
+#include <dirent.h>
+
+#define BENCH_CALLS		204800		//LOG_QUEUE_SIZE/2的整数倍
+
+CAsyncLog *g_log = NULL;
+
+static double NowSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+static void *LogProc(void *pParam)
+{
+	long nThread = (long)pParam;
+	for (int i=0; i<BENCH_CALLS; i++)
+	{
+		ReguTrace(Config,"thread=%ld dev=%d ym=%d value=%.2f",nThread,i/10,i%10,i*0.25);
+	}
+	return NULL;
+}
+
+//统计log目录下所有日志文件中的业务日志行数，不含丢弃统计行
+static long long CountLogLines()
+{
+	long long nLines = 0;
+	DIR *pDir = opendir("log");
+	if (pDir == NULL)
+	{
+		return 0;
+	}
+	struct dirent *pEntry;
+	while ((pEntry = readdir(pDir)) != NULL)
+	{
+		std::string strPath = std::string("log/") + pEntry->d_name;
+		FILE *fp = fopen(strPath.c_str(), "r");
+		if (fp == NULL || pEntry->d_name[0] == '.')
+		{
+			if (fp != NULL)
+			{
+				fclose(fp);
+			}
+			continue;
+		}
+		char szLine[LOG_RECORD_LEN*2];
+		while (fgets(szLine, sizeof(szLine), fp) != NULL)
+		{
+			if (strstr(szLine, "[Config]") != NULL)
+			{
+				nLines++;
+			}
+		}
+		fclose(fp);
+	}
+	closedir(pDir);
+	return nLines;
+}
+
+static void RemoveLogDir()
+{
+	DIR *pDir = opendir("log");
+	if (pDir == NULL)
+	{
+		return;
+	}
+	struct dirent *pEntry;
+	while ((pEntry = readdir(pDir)) != NULL)
+	{
+		if (pEntry->d_name[0] != '.')
+		{
+			unlink((std::string("log/") + pEntry->d_name).c_str());
+		}
+	}
+	closedir(pDir);
+	rmdir("log");
+}
+
+static double RunQueued()
+{
+	double dElapsed = 0;
+	for (int i=0; i<BENCH_CALLS; i+=LOG_QUEUE_SIZE/2)
+	{
+		double dBegin = NowSeconds();
+		for (int j=0; j<LOG_QUEUE_SIZE/2; j++)
+		{
+			ReguTrace(Config,"thread=%ld dev=%d ym=%d value=%.2f",0L,(i+j)/10,(i+j)%10,(i+j)*0.25);
+		}
+		dElapsed += NowSeconds() - dBegin;
+		g_log->Flush();
+	}
+	return BENCH_CALLS/dElapsed;
+}
+
+static double RunBench(int nThreads)
+{
+	pthread_t Threads[16];
+	double dBegin = NowSeconds();
+	for (long i=0; i<nThreads; i++)
+	{
+		pthread_create(&Threads[i], NULL, LogProc, (void*)i);
+	}
+	for (int i=0; i<nThreads; i++)
+	{
+		pthread_join(Threads[i], NULL);
+	}
+	return (double)nThreads*BENCH_CALLS/(NowSeconds() - dBegin);
+}
+
+int main()
+{
+	char szDir[] = "/tmp/asynclogbench.XXXXXX";
+	if (mkdtemp(szDir) == NULL || chdir(szDir) != 0)
+	{
+		printf("cannot create a temporary directory\n");
+		return 1;
+	}
+	g_log = new CAsyncLog(_T("\\Bench"));
+	g_log->m_nLevel = LOGLEVEL_Config;
+	double dQueued = RunQueued();
+	delete g_log;
+	g_log = NULL;
+	long long nWritten = CountLogLines();
+	RemoveLogDir();
+	printf("queued   1 thread  %12.0f call/s  written %5.1f%%\n", dQueued, 100.0*nWritten/BENCH_CALLS);
+
+	static const int ThreadNum[] = { 1, 4 };
+	for (size_t i=0; i<_countof(ThreadNum); i++)
+	{
+		g_log = new CAsyncLog(_T("\\Bench"));
+		g_log->m_nLevel = LOGLEVEL_Config;
+		double dFlood = RunBench(ThreadNum[i]);
+		g_log->m_nLevel = LOGLEVEL_ERRO + 1;
+		double dOff = RunBench(ThreadNum[i]);
+		delete g_log;
+		g_log = NULL;
+		nWritten = CountLogLines();
+		RemoveLogDir();
+		printf("flood    %d thread%s %12.0f call/s  written %5.1f%%\n", ThreadNum[i], ThreadNum[i] > 1 ? "s" : " ",
+			dFlood, 100.0*nWritten/((double)ThreadNum[i]*BENCH_CALLS));
+		printf("off      %d thread%s %12.0f call/s\n", ThreadNum[i], ThreadNum[i] > 1 ? "s" : " ", dOff);
+	}
+	if (chdir("/") == 0)
+	{
+		rmdir(szDir);
+	}
+	return 0;
+}
@@ -0,0 +1,239 @@
+// BillAgeRuleTest.cpp : 按采样表批量查询的账龄判断，采样表和实时库管道用进程内的假实现代替
+//
+// 假管道解析CBillAgeRule::BuildQuery拼出的语句，从内存中的采样表按TIMEID倒序取top(N)行，
+// 把各列折算成欠费标志后按NET_MESSAGE_RETRECORDOFTB报文格式返回。
+
+#include "Win32Compat.h"
+#include "NetMessageStub.h"
+#include "TestCommon.h"
+#include "../../inc/RecordSetReader.h"
+#include "../TSAlarmServer_WD/TSAlarmServer_WD/BillAgeRule.h"
+#include <string>
+#include <vector>
+
+#define TIMEID_LEN		20
+
+//内存中的采样表：每行一个TIMEID(按天递增)，每列一台设备
+struct FakeSampleTable
+{
+	std::string strName;
+	std::vector<std::string> vecColumn;
+	std::vector<std::vector<double> > vecRow;		//vecRow[天][列]，下标越大TIMEID越新
+};
+
+static int FindColumn(const FakeSampleTable &Table, const std::string &strColumn)
+{
+	for (size_t i=0; i<Table.vecColumn.size(); i++)
+	{
+		if (Table.vecColumn[i] == strColumn)
+		{
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+//执行BuildQuery的语句，表名或列名不对时返回NULL，与实时库查询失败时一样
+static BYTE *FakeQuery(const FakeSampleTable &Table, const char *pQuery)
+{
+	int nTop = 0;
+	if (sscanf(pQuery, "select top(%d) TIMEID", &nTop) != 1)
+	{
+		return NULL;
+	}
+	std::vector<int> vecCol;
+	const char *p = pQuery;
+	while ((p = strstr(p, "CASE WHEN ")) != NULL)
+	{
+		p += strlen("CASE WHEN ");
+		const char *pEnd = strstr(p, ">0 THEN 1 ELSE 0 END");
+		if (pEnd == NULL)
+		{
+			return NULL;
+		}
+		int nCol = FindColumn(Table, std::string(p, pEnd - p));
+		if (nCol < 0)
+		{
+			return NULL;
+		}
+		vecCol.push_back(nCol);
+	}
+	std::string strFrom = " from " + Table.strName + " order by TIMEID desc;";
+	if (strstr(pQuery, strFrom.c_str()) == NULL)
+	{
+		return NULL;
+	}
+
+	int nFields = (int)vecCol.size() + 1;
+	int nRecords = nTop < (int)Table.vecRow.size() ? nTop : (int)Table.vecRow.size();
+	DWORD dwRecordLen = TIMEID_LEN + sizeof(DWORD)*vecCol.size();
+	size_t nLen = sizeof(NetMessageHead) + sizeof(WORD) + sizeof(MessageRetRecordHead)*nFields
+		+ sizeof(DWORD)*2 + dwRecordLen*nRecords;
+	BYTE *pReply = new BYTE[nLen];
+	memset(pReply, 0, nLen);
+	BYTE *pByte = pReply;
+	NetMessageHead *pHead = (NetMessageHead*)pByte;
+	pHead->MessageType = NET_MESSAGE_RETRECORDOFTB;
+	pHead->Length = (DWORD)(nLen - sizeof(NetMessageHead));
+	pByte += sizeof(NetMessageHead);
+	*(WORD*)pByte = (WORD)nFields;
+	pByte += sizeof(WORD);
+	MessageRetRecordHead *pField = (MessageRetRecordHead*)pByte;
+	pField[0].DataLen = TIMEID_LEN;
+	for (int k=1; k<nFields; k++)
+	{
+		pField[k].DataLen = sizeof(DWORD);
+	}
+	pByte += sizeof(MessageRetRecordHead)*nFields;
+	memcpy(pByte, &dwRecordLen, sizeof(DWORD));
+	pByte += sizeof(DWORD);
+	memcpy(pByte, &nRecords, sizeof(DWORD));
+	pByte += sizeof(DWORD);
+	for (int r=0; r<nRecords; r++)
+	{
+		int nDay = (int)Table.vecRow.size() - 1 - r;
+		snprintf((char*)pByte, TIMEID_LEN, "2024-06-%02d", nDay + 1);
+		for (size_t k=0; k<vecCol.size(); k++)
+		{
+			DWORD dwFlag = Table.vecRow[nDay][vecCol[k]] > 0 ? 1 : 0;
+			memcpy(pByte + TIMEID_LEN + sizeof(DWORD)*k, &dwFlag, sizeof(DWORD));
+		}
+		pByte += dwRecordLen;
+	}
+	return pReply;
+}
+
+//按CAlarmTask::CheckBillTable的方式查询一组列并判断，返回告警列数，查询失败返回-1
+static int CheckColumns(const FakeSampleTable &Table, const std::vector<std::string> &vecColumn, BOOL *pAlarm)
+{
+	std::vector<LPCTSTR> vecName;
+	for (size_t k=0; k<vecColumn.size(); k++)
+	{
+		vecName.push_back(vecColumn[k].c_str());
+	}
+	int nCols = (int)vecName.size();
+	CString strQuery;
+	CBillAgeRule::BuildQuery(strQuery, Table.strName.c_str(), nCols > 0 ? &vecName[0] : NULL, nCols, BILL_ALARM_DAYS);
+	BYTE *pRead = FakeQuery(Table, strQuery);
+	if (pRead == NULL)
+	{
+		return -1;
+	}
+	CRecordSetReader rs;
+	int nAlarm = -1;
+	if (rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), nCols + 1))
+	{
+		nAlarm = CBillAgeRule::Evaluate(rs, nCols, BILL_ALARM_DAYS, pAlarm);
+	}
+	delete[] pRead;
+	return nAlarm;
+}
+
+//nDays天、nCols列全部欠费(正值)的表
+static FakeSampleTable MakeTable(int nDays, int nCols)
+{
+	FakeSampleTable Table;
+	Table.strName = "TB_SAMPLE_DAY_1";
+	for (int k=0; k<nCols; k++)
+	{
+		char szName[32];
+		snprintf(szName, sizeof(szName), "COL_%d", k);
+		Table.vecColumn.push_back(szName);
+	}
+	Table.vecRow.assign(nDays, std::vector<double>(nCols, 1.5));
+	return Table;
+}
+
+static void TestBasicRule()
+{
+	FakeSampleTable Table = MakeTable(30, 5);
+	//COL_1最近一天不欠费，COL_2第15新的一天为0，COL_3更早的一天为0，COL_4最近为负值
+	Table.vecRow[29][1] = 0;
+	Table.vecRow[15][2] = 0;
+	Table.vecRow[14][3] = 0;
+	Table.vecRow[29][4] = -3.0;
+	BOOL bAlarm[5];
+	CHECK(CheckColumns(Table, Table.vecColumn, bAlarm) == 2);
+	CHECK(bAlarm[0]);
+	CHECK(!bAlarm[1]);
+	CHECK(!bAlarm[2]);
+	CHECK(bAlarm[3]);
+	CHECK(!bAlarm[4]);
+}
+
+//采样表不足BILL_ALARM_DAYS天时都不告警，正好BILL_ALARM_DAYS天时可以告警
+static void TestShortTable()
+{
+	BOOL bAlarm[2] = {TRUE, TRUE};
+	FakeSampleTable Table = MakeTable(BILL_ALARM_DAYS - 1, 2);
+	CHECK(CheckColumns(Table, Table.vecColumn, bAlarm) == 0);
+	CHECK(!bAlarm[0] && !bAlarm[1]);
+
+	Table = MakeTable(BILL_ALARM_DAYS, 2);
+	CHECK(CheckColumns(Table, Table.vecColumn, bAlarm) == 2);
+
+	Table = MakeTable(0, 2);
+	CHECK(CheckColumns(Table, Table.vecColumn, bAlarm) == 0);
+}
+
+//语句中的列序与表中的列序不同，标志按语句的列序返回
+static void TestColumnOrder()
+{
+	FakeSampleTable Table = MakeTable(20, 3);
+	Table.vecRow[19][0] = 0;
+	std::vector<std::string> vecColumn;
+	vecColumn.push_back("COL_2");
+	vecColumn.push_back("COL_0");
+	BOOL bAlarm[2];
+	CHECK(CheckColumns(Table, vecColumn, bAlarm) == 1);
+	CHECK(bAlarm[0] && !bAlarm[1]);
+}
+
+//一张表的设备多于BILL_MAX_COLUMNS时分段查询，每段的结果与逐列单独查询相同
+static void TestManyColumns()
+{
+	int nCols = BILL_MAX_COLUMNS*2 + 5;
+	FakeSampleTable Table = MakeTable(20, nCols);
+	for (int k=0; k<nCols; k+=3)
+	{
+		Table.vecRow[10 + k%10][k] = 0;
+	}
+	int nTotal = 0;
+	BOOL bSame = TRUE;
+	for (int nBegin=0; nBegin<nCols; nBegin+=BILL_MAX_COLUMNS)
+	{
+		int nSeg = nCols - nBegin < BILL_MAX_COLUMNS ? nCols - nBegin : BILL_MAX_COLUMNS;
+		std::vector<std::string> vecColumn(Table.vecColumn.begin() + nBegin, Table.vecColumn.begin() + nBegin + nSeg);
+		BOOL bAlarm[BILL_MAX_COLUMNS];
+		nTotal += CheckColumns(Table, vecColumn, bAlarm);
+		for (int k=0; k<nSeg; k++)
+		{
+			std::vector<std::string> vecOne(1, vecColumn[k]);
+			BOOL bOne = FALSE;
+			CheckColumns(Table, vecOne, &bOne);
+			bSame = bSame && bOne == bAlarm[k];
+		}
+	}
+	CHECK(bSame);
+	//下标为3的倍数的列在第10+k%10天为0，总在最近BILL_ALARM_DAYS天内
+	CHECK(nTotal == nCols - (nCols + 2)/3);
+}
+
+//列名不存在时查询失败，调用者只跳过这张表
+static void TestQueryFail()
+{
+	FakeSampleTable Table = MakeTable(20, 2);
+	std::vector<std::string> vecColumn(1, "NO_SUCH_COL");
+	BOOL bAlarm[1];
+	CHECK(CheckColumns(Table, vecColumn, bAlarm) == -1);
+}
+
+int main()
+{
+	TestBasicRule();
+	TestShortTable();
+	TestColumnOrder();
+	TestManyColumns();
+	TestQueryFail();
+	return TEST_RESULT();
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+// comm.cpp各基准共用：comm.cpp直接包含进来编译，服务端在本进程，客户端放在fork出的子进程里，
+// 两边各占一半fd，连接数不受单进程打开文件数限制，也不和服务端争用同一个进程的锁和内存分配。
+// 父子进程间用两条管道传整数：父进程发命令和参数，子进程回结果。
+// 先fork子进程再起服务端，子进程不继承服务端的监听fd、epoll fd和已接纳的连接。
+
+#include "../comm.cpp"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <vector>
+
+#define LOOPBACK_ADDR	((WORD32)0x7F000001)
+#define BENCH_WAIT_MS	60000
+
+static double NowSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+//把打开文件数的软限制调到硬限制，返回调整后的软限制
+static int RaiseFdLimit()
+{
+	struct rlimit tLimit;
+	if (getrlimit(RLIMIT_NOFILE, &tLimit) != 0)
+	{
+		return 1024;
+	}
+	tLimit.rlim_cur = tLimit.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &tLimit);
+	getrlimit(RLIMIT_NOFILE, &tLimit);
+	return (int)tLimit.rlim_cur;
+}
+
+template <class Cond>
+static bool WaitUntil(Cond cond, int nMs = BENCH_WAIT_MS)
+{
+	for (int i = 0; i < nMs; i++)
+	{
+		if (cond())
+		{
+			return true;
+		}
+		usleep(1000);
+	}
+	return cond();
+}
+
+//端口按进程号错开，被占用时换下一个。服务端绑定ethname网卡的地址，这里改为lo
+static WORD32 g_dwBenchPort = 20000 + (getpid() % 20000);
+
+static bool StartServer(CCommCtl *ptCtl, WORD32 &dwPort)
+{
+	strcpy(ethname, "lo");
+	for (int i = 0; i < 50; i++)
+	{
+		dwPort = g_dwBenchPort++;
+		if (LEOF != ptCtl->ServInit(LOOPBACK_ADDR, dwPort))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//dwLocal不为0时先绑定该本地地址(127.x.x.x都是回环)，服务端可按对端地址区分连接
+static int Connect(WORD32 dwPort, WORD32 dwLocal = 0)
+{
+	struct sockaddr_in tAddr;
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	if (dwLocal != 0)
+	{
+		oss_setsockaddr(&tAddr, dwLocal, 0);
+		if (bind(fd, (struct sockaddr *)&tAddr, sizeof(tAddr)) != 0)
+		{
+			close(fd);
+			return -1;
+		}
+	}
+	oss_setsockaddr(&tAddr, LOOPBACK_ADDR, dwPort);
+	if (connect(fd, (struct sockaddr *)&tAddr, sizeof(tAddr)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool SendAll(int fd, const BYTE *pBuf, size_t nLen)
+{
+	while (nLen > 0)
+	{
+		ssize_t n = send(fd, pBuf, nLen, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			return false;
+		}
+		pBuf += n;
+		nLen -= n;
+	}
+	return true;
+}
+
+//消息头之后填dwSeq起的递增字节
+static void FillFrame(BYTE *pFrame, WORD32 dwSeq, WORD32 dwLen)
+{
+	class msg_header tHead;
+	tHead.type = htons(1);
+	tHead.length = htons((WORD16)dwLen);
+	tHead.seq = htonl(dwSeq);
+	memcpy(pFrame, &tHead, sizeof(tHead));
+	for (WORD32 i = sizeof(class msg_header); i < dwLen; i++)
+	{
+		pFrame[i] = (BYTE)(dwSeq + i);
+	}
+}
+
+//服务端回调只计数
+static volatile long g_nBenchFrames = 0;
+
+static void *OnBenchFrame(void *pMsg)
+{
+	(void)pMsg;
+	__sync_fetch_and_add(&g_nBenchFrames, 1);
+	return NULL;
+}
+
+// 子进程：pEntry(fdCmd, fdReply, pArg)，返回后子进程退出
+struct BenchChild
+{
+	pid_t nPid;
+	int fdCmd;			//父进程写
+	int fdReply;		//父进程读
+};
+
+static bool WriteInt(int fd, long nValue)
+{
+	return write(fd, &nValue, sizeof(nValue)) == (ssize_t)sizeof(nValue);
+}
+
+static bool ReadInt(int fd, long &nValue)
+{
+	return read(fd, &nValue, sizeof(nValue)) == (ssize_t)sizeof(nValue);
+}
+
+static bool ForkChild(BenchChild &tChild, void (*pEntry)(int, int, void *), void *pArg)
+{
+	int afdCmd[2], afdReply[2];
+	if (pipe(afdCmd) != 0)
+	{
+		return false;
+	}
+	if (pipe(afdReply) != 0)
+	{
+		close(afdCmd[0]);
+		close(afdCmd[1]);
+		return false;
+	}
+	tChild.nPid = fork();
+	if (tChild.nPid == 0)
+	{
+		close(afdCmd[1]);
+		close(afdReply[0]);
+		RaiseFdLimit();
+		pEntry(afdCmd[0], afdReply[1], pArg);
+		_exit(0);
+	}
+	close(afdCmd[0]);
+	close(afdReply[1]);
+	tChild.fdCmd = afdCmd[1];
+	tChild.fdReply = afdReply[0];
+	if (tChild.nPid < 0)
+	{
+		close(tChild.fdCmd);
+		close(tChild.fdReply);
+		return false;
+	}
+	return true;
+}
+
+//关闭命令管道，子进程读到EOF后收尾退出
+static void WaitChild(BenchChild &tChild)
+{
+	close(tChild.fdCmd);
+	close(tChild.fdReply);
+	waitpid(tChild.nPid, NULL, 0);
+}
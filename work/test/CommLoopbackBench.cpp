@@ -0,0 +1,132 @@
+// CommLoopbackBench.cpp : 回环地址上1000和10000个客户端连到CCommCtl服务端，统计保持的连接数和每秒收到的消息数
+//
+// 每轮在子进程中建立全部连接，服务端接纳完后子进程逐个连接轮流发小消息(每次send一条)，
+// 即大量连接各自少量活跃的负载，服务端回调计数，收齐为止。改造前的select循环最多100个连接(g_max_cli)，
+// fd不能超过FD_SETSIZE(1024)，这里两档都超出。进程打开文件数的硬限制不够时相应减少客户端数。
+
+#include "CommBench.h"
+
+#define BENCH_FRAME_LEN		64
+#define BENCH_MSG_TOTAL		200000		//每档总消息数，按客户端数分成若干轮
+
+static const int ClientNum[] = { 1000, 10000 };
+
+//子进程：收端口、客户端数、轮数，连接后回报连上的个数和耗时(微秒)；收到开始命令后发消息，回报发出的条数
+static void ClientProc(int fdCmd, int fdReply, void *pArg)
+{
+	(void)pArg;
+	long nPort = 0, nClients = 0, nRounds = 0, nGo = 0;
+	if (!ReadInt(fdCmd, nPort) || !ReadInt(fdCmd, nClients) || !ReadInt(fdCmd, nRounds))
+	{
+		return;
+	}
+	std::vector<int> vecFd;
+	double dBegin = NowSeconds();
+	for (long i = 0; i < nClients; i++)
+	{
+		int fd = Connect((WORD32)nPort);
+		if (fd < 0)
+		{
+			break;
+		}
+		vecFd.push_back(fd);
+	}
+	WriteInt(fdReply, (long)vecFd.size());
+	WriteInt(fdReply, (long)((NowSeconds() - dBegin)*1e6));
+	if (!ReadInt(fdCmd, nGo))
+	{
+		return;
+	}
+	BYTE acFrame[BENCH_FRAME_LEN];
+	long nSent = 0;
+	for (long r = 0; r < nRounds; r++)
+	{
+		for (size_t i = 0; i < vecFd.size(); i++)
+		{
+			FillFrame(acFrame, (WORD32)nSent, BENCH_FRAME_LEN);
+			if (SendAll(vecFd[i], acFrame, BENCH_FRAME_LEN))
+			{
+				nSent++;
+			}
+		}
+	}
+	WriteInt(fdReply, nSent);
+	//等父进程统计完再断开
+	ReadInt(fdCmd, nGo);
+	for (size_t i = 0; i < vecFd.size(); i++)
+	{
+		close(vecFd[i]);
+	}
+}
+
+//返回是否全部连上且消息收齐
+static bool RunOnce(int nClients)
+{
+	BenchChild tChild;
+	if (!ForkChild(tChild, ClientProc, NULL))
+	{
+		printf("%-8d fork failed\n", nClients);
+		return false;
+	}
+	CCommCtl *ptCtl = new CCommCtl;
+	WORD32 dwPort = 0;
+	if (!StartServer(ptCtl, dwPort))
+	{
+		printf("%-8d ServInit failed\n", nClients);
+		WaitChild(tChild);
+		delete ptCtl;
+		return false;
+	}
+	g_nBenchFrames = 0;
+	g_ptcallback = OnBenchFrame;
+	long nRounds = (BENCH_MSG_TOTAL + nClients - 1)/nClients;
+	long nConnected = 0, nConnectUs = 0, nSent = 0;
+	WriteInt(tChild.fdCmd, dwPort);
+	WriteInt(tChild.fdCmd, nClients);
+	WriteInt(tChild.fdCmd, nRounds);
+	ReadInt(tChild.fdReply, nConnected);
+	ReadInt(tChild.fdReply, nConnectUs);
+	//服务端接纳完全部连接
+	double dBegin = NowSeconds();
+	WaitUntil([&]{ return ptCtl->dwNum >= (WORD32)nConnected; });
+	double dAccept = NowSeconds() - dBegin;
+	WORD32 dwHeld = ptCtl->dwNum;
+
+	dBegin = NowSeconds();
+	WriteInt(tChild.fdCmd, 1);
+	ReadInt(tChild.fdReply, nSent);
+	bool bAll = WaitUntil([&]{ return g_nBenchFrames >= nSent; });
+	double dElapsed = NowSeconds() - dBegin;
+	long nFrames = g_nBenchFrames;
+	//发完以后连接仍然都在
+	bool bStill = (ptCtl->dwNum == dwHeld);
+
+	printf("%-8d %10ld %10.0f %10u %12.0f %12ld\n", nClients, nConnected, nConnectUs/1e3 + dAccept*1e3, dwHeld,
+		nFrames/dElapsed, nFrames);
+	WriteInt(tChild.fdCmd, 1);
+	WaitChild(tChild);
+	WaitUntil([&]{ return ptCtl->dwNum == 0; });
+	delete ptCtl;
+	g_ptcallback = NULL;
+	return nConnected == nClients && dwHeld == (WORD32)nClients && bAll && bStill && nFrames == nSent;
+}
+
+int main()
+{
+	int nLimit = RaiseFdLimit();
+	bool bOk = true;
+	printf("fd limit=%d frame=%d bytes, reactors=1\n", nLimit, BENCH_FRAME_LEN);
+	printf("%-8s %10s %10s %10s %12s %12s\n", "clients", "connected", "setup ms", "held", "msg/s", "received");
+	for (size_t i = 0; i < sizeof(ClientNum)/sizeof(ClientNum[0]); i++)
+	{
+		//服务端每个连接一个fd，另留一些给监听、epoll和标准输入输出
+		int nClients = ClientNum[i];
+		if (nClients > nLimit - 64)
+		{
+			nClients = nLimit - 64;
+			printf("fd limit too low for %d clients, running %d\n", ClientNum[i], nClients);
+		}
+		bOk = RunOnce(nClients) && bOk;
+	}
+	return bOk ? 0 : 1;
+}
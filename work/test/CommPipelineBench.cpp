@@ -0,0 +1,227 @@
+// CommPipelineBench.cpp : 一个连接上连续发送的小消息，CCommLink::receive每秒派发的消息数
+//
+// 子进程把整段消息流按64KB一次写入同一个连接，服务端回调校验序号并统计未对齐的消息。
+// 长度分16、64、256字节和9~63字节奇数长度混合四档，混合一档大多数消息起始位置不对齐，走拷贝派发。
+// 同样的消息流再在内存中按64KB一块喂给两种切分方式，只比较切分本身的耗时：
+//	memmove		改造前的做法：派发一条就把剩余数据移到缓存头
+//	in place	现在的做法：原地派发只移动读位置，缓存尾部用完时才把不足一条的剩余数据移到缓存头
+
+#include "CommBench.h"
+
+#define BENCH_CHUNK			65536		//每次写入和内存切分时每块的字节数
+#define BENCH_STREAM_BYTES	(64*1024*1024)
+
+struct PipelineCase
+{
+	const char *pcName;
+	WORD32 dwMinLen;
+	WORD32 dwMaxLen;
+};
+
+static const PipelineCase Cases[] =
+{
+	{ "16",       16,  16 },
+	{ "64",       64,  64 },
+	{ "256",     256, 256 },
+	{ "9..63 odd", 9,  63 },
+};
+
+//按档位拼出约BENCH_STREAM_BYTES字节的消息流，序号从0递增
+static WORD32 BuildStream(const PipelineCase &tCase, std::vector<BYTE> &vecStream)
+{
+	vecStream.clear();
+	vecStream.reserve(BENCH_STREAM_BYTES + 256);
+	WORD32 dwFrames = 0;
+	while (vecStream.size() < BENCH_STREAM_BYTES)
+	{
+		WORD32 dwLen = tCase.dwMinLen;
+		if (tCase.dwMaxLen > tCase.dwMinLen)
+		{
+			dwLen += (dwFrames*7) % (tCase.dwMaxLen - tCase.dwMinLen + 1);
+			dwLen |= 1;
+		}
+		size_t nOff = vecStream.size();
+		vecStream.resize(nOff + dwLen);
+		FillFrame(&vecStream[nOff], dwFrames, dwLen);
+		dwFrames++;
+	}
+	return dwFrames;
+}
+
+static volatile long g_nSeqBad = 0;
+static volatile long g_nMisaligned = 0;
+static WORD32 g_dwNextSeq = 0;
+
+//只有一个接收任务，回调串行执行
+static void *OnSeqFrame(void *pMsg)
+{
+	if ((unsigned long)pMsg % __alignof__(class msg_header))
+	{
+		g_nMisaligned++;
+	}
+	if (ntohl(((class msg_header *)pMsg)->seq) != g_dwNextSeq)
+	{
+		g_nSeqBad++;
+	}
+	g_dwNextSeq++;
+	g_nBenchFrames++;
+	return NULL;
+}
+
+//子进程：收端口和档位，连接后回报是否连上；收到开始命令后写完整段消息流，回报写入的字节数
+static void ClientProc(int fdCmd, int fdReply, void *pArg)
+{
+	(void)pArg;
+	long nPort = 0, nCase = 0, nGo = 0;
+	if (!ReadInt(fdCmd, nPort) || !ReadInt(fdCmd, nCase))
+	{
+		return;
+	}
+	std::vector<BYTE> vecStream;
+	BuildStream(Cases[nCase], vecStream);
+	int fd = Connect((WORD32)nPort);
+	WriteInt(fdReply, fd >= 0);
+	if (!ReadInt(fdCmd, nGo) || fd < 0)
+	{
+		return;
+	}
+	long nSent = 0;
+	for (size_t nOff = 0; nOff < vecStream.size(); nOff += BENCH_CHUNK)
+	{
+		size_t nLen = vecStream.size() - nOff < BENCH_CHUNK ? vecStream.size() - nOff : BENCH_CHUNK;
+		if (!SendAll(fd, &vecStream[nOff], nLen))
+		{
+			break;
+		}
+		nSent += nLen;
+	}
+	WriteInt(fdReply, nSent);
+	ReadInt(fdCmd, nGo);
+	close(fd);
+}
+
+static bool RunSocket(long nCase, WORD32 dwFrames, double &dRate)
+{
+	BenchChild tChild;
+	if (!ForkChild(tChild, ClientProc, NULL))
+	{
+		return false;
+	}
+	CCommCtl *ptCtl = new CCommCtl;
+	WORD32 dwPort = 0;
+	if (!StartServer(ptCtl, dwPort))
+	{
+		WaitChild(tChild);
+		delete ptCtl;
+		return false;
+	}
+	g_nBenchFrames = 0;
+	g_nSeqBad = 0;
+	g_nMisaligned = 0;
+	g_dwNextSeq = 0;
+	g_ptcallback = OnSeqFrame;
+	long nConnected = 0, nSent = 0;
+	WriteInt(tChild.fdCmd, dwPort);
+	WriteInt(tChild.fdCmd, nCase);
+	ReadInt(tChild.fdReply, nConnected);
+	bool bOk = nConnected && WaitUntil([&]{ return ptCtl->dwNum == 1; });
+	double dBegin = NowSeconds();
+	WriteInt(tChild.fdCmd, 1);
+	if (bOk)
+	{
+		ReadInt(tChild.fdReply, nSent);
+		bOk = WaitUntil([&]{ return g_nBenchFrames >= (long)dwFrames; });
+		dRate = g_nBenchFrames/(NowSeconds() - dBegin);
+		bOk = bOk && (g_nBenchFrames == (long)dwFrames) && (g_nSeqBad == 0) && (g_nMisaligned == 0);
+	}
+	WriteInt(tChild.fdCmd, 1);
+	WaitChild(tChild);
+	WaitUntil([&]{ return ptCtl->dwNum == 0; });
+	delete ptCtl;
+	g_ptcallback = NULL;
+	return bOk;
+}
+
+//内存中切分：bMove为真时每派发一条就memmove剩余数据。返回派发的条数
+static WORD32 SplitStream(const std::vector<BYTE> &vecStream, bool bMove, double &dSeconds)
+{
+	std::vector<BYTE> vecBuf(g_max_rcv);
+	BYTE *pucBuf = &vecBuf[0];
+	WORD32 dwHead = 0, dwOff = 0, dwFrames = 0;
+	volatile WORD32 dwSink = 0;
+	double dBegin = NowSeconds();
+	for (size_t nIn = 0; nIn < vecStream.size(); )
+	{
+		//尾部用完时把剩余数据移到缓存头
+		if (dwOff == vecBuf.size())
+		{
+			memmove(pucBuf, pucBuf + dwHead, dwOff - dwHead);
+			dwOff -= dwHead;
+			dwHead = 0;
+		}
+		size_t nLen = vecBuf.size() - dwOff;
+		if (nLen > BENCH_CHUNK)
+		{
+			nLen = BENCH_CHUNK;
+		}
+		if (nLen > vecStream.size() - nIn)
+		{
+			nLen = vecStream.size() - nIn;
+		}
+		memcpy(pucBuf + dwOff, &vecStream[nIn], nLen);
+		nIn += nLen;
+		dwOff += (WORD32)nLen;
+		while (dwOff - dwHead >= sizeof(class msg_header))
+		{
+			WORD32 dwLen = comm_frame_len(pucBuf + dwHead);
+			if (dwOff - dwHead < dwLen)
+			{
+				break;
+			}
+			dwSink += pucBuf[dwHead + dwLen - 1];
+			dwFrames++;
+			if (bMove)
+			{
+				memmove(pucBuf, pucBuf + dwHead + dwLen, dwOff - dwHead - dwLen);
+				dwOff -= dwHead + dwLen;
+				dwHead = 0;
+			}
+			else
+			{
+				dwHead += dwLen;
+			}
+		}
+		if (dwHead == dwOff)
+		{
+			dwHead = 0;
+			dwOff = 0;
+		}
+	}
+	dSeconds = NowSeconds() - dBegin;
+	return dwFrames;
+}
+
+int main()
+{
+	bool bOk = true;
+	printf("stream=%d MB per case, written %d KB at a time\n", BENCH_STREAM_BYTES >> 20, BENCH_CHUNK >> 10);
+	printf("%-10s %10s %14s %10s %16s %16s\n", "frame", "frames", "socket fr/s", "MB/s", "memmove ns/fr", "in place ns/fr");
+	for (long c = 0; c < (long)(sizeof(Cases)/sizeof(Cases[0])); c++)
+	{
+		std::vector<BYTE> vecStream;
+		WORD32 dwFrames = BuildStream(Cases[c], vecStream);
+		double dRate = 0, dMove = 0, dInPlace = 0;
+		bool bSocket = RunSocket(c, dwFrames, dRate);
+		bool bSplit = (SplitStream(vecStream, true, dMove) == dwFrames) && (SplitStream(vecStream, false, dInPlace) == dwFrames);
+		if (!bSocket || !bSplit)
+		{
+			printf("%-10s failed (socket %d, split %d, seq errors %ld, misaligned %ld)\n", Cases[c].pcName, bSocket, bSplit,
+				g_nSeqBad, g_nMisaligned);
+			bOk = false;
+			continue;
+		}
+		printf("%-10s %10u %14.0f %10.1f %16.1f %16.1f\n", Cases[c].pcName, dwFrames, dRate,
+			dRate*vecStream.size()/dwFrames/1e6, dMove*1e9/dwFrames, dInPlace*1e9/dwFrames);
+	}
+	return bOk ? 0 : 1;
+}
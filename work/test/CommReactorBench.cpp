@@ -0,0 +1,173 @@
+// CommReactorBench.cpp : 1/2/4/8个接收任务(SetReactorNum)时CCommCtl服务端在回环地址上每秒收到的消息数
+//
+// 子进程建64个连接，8个发送线程各管8个连接，每次send一批32条128字节的消息，发满总数为止。
+// 服务端回调在接收任务中直接执行，对消息正文做一遍校验和，代替实际的消息处理。
+// 连接按轮转分到各接收任务；接收任务数超过CPU核数后不会再变快，结果里给出本机核数。
+
+#include "CommBench.h"
+
+#define BENCH_CLIENTS		64
+#define BENCH_SENDERS		8
+#define BENCH_FRAME_LEN		128
+#define BENCH_PIPELINE		32			//每次send的消息条数
+#define BENCH_MSG_TOTAL		4096000
+
+static const WORD32 ReactorNum[] = { 1, 2, 4, 8 };
+
+static volatile long g_nChecksum = 0;
+
+static void *OnFrameWork(void *pMsg)
+{
+	class msg_header tHead;
+	memcpy(&tHead, pMsg, sizeof(tHead));
+	WORD32 dwLen = ntohs(tHead.length);
+	const BYTE *pucByte = (const BYTE *)pMsg;
+	long nSum = 0;
+	for (WORD32 i = sizeof(class msg_header); i < dwLen; i++)
+	{
+		nSum = nSum*31 + pucByte[i];
+	}
+	__sync_fetch_and_add(&g_nChecksum, nSum & 0xFF);
+	__sync_fetch_and_add(&g_nBenchFrames, 1);
+	return NULL;
+}
+
+struct SenderArg
+{
+	const int *pFd;
+	int nFds;
+	long nBatches;		//每个连接发的批数
+	long nSent;
+};
+
+static void *SenderProc(void *pParam)
+{
+	SenderArg *pArg = (SenderArg *)pParam;
+	BYTE acBatch[BENCH_FRAME_LEN*BENCH_PIPELINE];
+	for (int i = 0; i < BENCH_PIPELINE; i++)
+	{
+		FillFrame(acBatch + i*BENCH_FRAME_LEN, (WORD32)i, BENCH_FRAME_LEN);
+	}
+	for (long b = 0; b < pArg->nBatches; b++)
+	{
+		for (int i = 0; i < pArg->nFds; i++)
+		{
+			if (SendAll(pArg->pFd[i], acBatch, sizeof(acBatch)))
+			{
+				pArg->nSent += BENCH_PIPELINE;
+			}
+		}
+	}
+	return NULL;
+}
+
+//子进程：收端口，连接后回报连上的个数；收到开始命令后各线程发送，回报发出的条数
+static void ClientProc(int fdCmd, int fdReply, void *pArg)
+{
+	(void)pArg;
+	long nPort = 0, nGo = 0;
+	if (!ReadInt(fdCmd, nPort))
+	{
+		return;
+	}
+	int afd[BENCH_CLIENTS];
+	int nFds = 0;
+	for (; nFds < BENCH_CLIENTS; nFds++)
+	{
+		afd[nFds] = Connect((WORD32)nPort);
+		if (afd[nFds] < 0)
+		{
+			break;
+		}
+	}
+	WriteInt(fdReply, nFds);
+	if (!ReadInt(fdCmd, nGo) || nFds < BENCH_CLIENTS)
+	{
+		return;
+	}
+	pthread_t atThread[BENCH_SENDERS];
+	SenderArg atArg[BENCH_SENDERS];
+	int nPerSender = BENCH_CLIENTS/BENCH_SENDERS;
+	for (int t = 0; t < BENCH_SENDERS; t++)
+	{
+		atArg[t].pFd = afd + t*nPerSender;
+		atArg[t].nFds = nPerSender;
+		atArg[t].nBatches = BENCH_MSG_TOTAL/BENCH_PIPELINE/BENCH_CLIENTS;
+		atArg[t].nSent = 0;
+		pthread_create(&atThread[t], NULL, SenderProc, &atArg[t]);
+	}
+	long nSent = 0;
+	for (int t = 0; t < BENCH_SENDERS; t++)
+	{
+		pthread_join(atThread[t], NULL);
+		nSent += atArg[t].nSent;
+	}
+	WriteInt(fdReply, nSent);
+	ReadInt(fdCmd, nGo);
+	for (int i = 0; i < nFds; i++)
+	{
+		close(afd[i]);
+	}
+}
+
+static bool RunOnce(WORD32 dwReactors, double &dRate)
+{
+	BenchChild tChild;
+	if (!ForkChild(tChild, ClientProc, NULL))
+	{
+		return false;
+	}
+	CCommCtl *ptCtl = new CCommCtl;
+	WORD32 dwPort = 0;
+	if ((LEOF == ptCtl->SetReactorNum(dwReactors)) || !StartServer(ptCtl, dwPort))
+	{
+		WaitChild(tChild);
+		delete ptCtl;
+		return false;
+	}
+	g_nBenchFrames = 0;
+	g_ptcallback = OnFrameWork;
+	long nConnected = 0, nSent = 0;
+	WriteInt(tChild.fdCmd, dwPort);
+	ReadInt(tChild.fdReply, nConnected);
+	bool bOk = (nConnected == BENCH_CLIENTS) && WaitUntil([&]{ return ptCtl->dwNum == BENCH_CLIENTS; });
+	double dBegin = NowSeconds();
+	WriteInt(tChild.fdCmd, 1);
+	if (bOk)
+	{
+		ReadInt(tChild.fdReply, nSent);
+		bOk = WaitUntil([&]{ return g_nBenchFrames >= nSent; }) && (g_nBenchFrames == nSent) && (nSent > 0);
+		dRate = g_nBenchFrames/(NowSeconds() - dBegin);
+	}
+	WriteInt(tChild.fdCmd, 1);
+	WaitChild(tChild);
+	WaitUntil([&]{ return ptCtl->dwNum == 0; });
+	delete ptCtl;
+	g_ptcallback = NULL;
+	return bOk;
+}
+
+int main()
+{
+	bool bOk = true;
+	double dBase = 0;
+	printf("clients=%d senders=%d frame=%d bytes x%d per send, cpus=%ld\n", BENCH_CLIENTS, BENCH_SENDERS,
+		BENCH_FRAME_LEN, BENCH_PIPELINE, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("%-9s %12s %8s\n", "reactors", "msg/s", "vs 1");
+	for (size_t i = 0; i < sizeof(ReactorNum)/sizeof(ReactorNum[0]); i++)
+	{
+		double dRate = 0;
+		if (!RunOnce(ReactorNum[i], dRate))
+		{
+			printf("%-9u failed\n", ReactorNum[i]);
+			bOk = false;
+			continue;
+		}
+		if (dBase == 0)
+		{
+			dBase = dRate;
+		}
+		printf("%-9u %12.0f %8.2f\n", ReactorNum[i], dRate, dRate/dBase);
+	}
+	return bOk ? 0 : 1;
+}
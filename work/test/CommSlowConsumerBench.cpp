@@ -0,0 +1,259 @@
+// CommSlowConsumerBench.cpp : 有一个慢接收端时，1~1000个发送线程经HandleSend向其他连接发送的吞吐
+//
+// 子进程建8个正常接收的连接和1个慢连接(每10ms只读4KB)，各自绑定不同的127.x地址，服务端按地址取句柄。
+// 服务端一侧nSenders个线程轮流向8个正常连接发64字节的消息，另有一个线程不停向慢连接发1KB的消息。
+// 慢连接的发送队列很快涨到高水位，向它发送的线程等待后超时失败；其他连接的发送不受影响，
+// 统计正常连接每秒收到的消息数和单次HandleSend的最长耗时，以及慢连接发送成功和超时的次数。
+
+#include "CommBench.h"
+
+#define BENCH_FAST_LINKS	8
+#define BENCH_FAST_BASE		((WORD32)0x7F000101)	//127.0.1.1起
+#define BENCH_SLOW_ADDR		((WORD32)0x7F000201)	//127.0.2.1
+#define BENCH_FRAME_LEN		64
+#define BENCH_SLOW_FRAME	1024
+#define BENCH_MSG_TOTAL		1000000		//每档发往正常连接的消息总数
+#define BENCH_SLOW_READ		4096		//慢连接每次读的字节数
+#define BENCH_SLOW_SLEEP	10000		//慢连接两次读之间的间隔(微秒)
+#define BENCH_STACK			(128*1024)
+
+static const int SenderNum[] = { 1, 10, 100, 1000 };
+
+static volatile int g_bSlowStop = 0;
+
+static void *SlowReaderProc(void *pParam)
+{
+	int fd = *(int *)pParam;
+	BYTE acBuf[BENCH_SLOW_READ];
+	struct timeval tTimeout = {0, 100000};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tTimeout, sizeof(tTimeout));
+	while (!g_bSlowStop)
+	{
+		recv(fd, acBuf, sizeof(acBuf), 0);
+		usleep(BENCH_SLOW_SLEEP);
+	}
+	return NULL;
+}
+
+//正常连接一直读到收齐nExpect字节，超时返回已收到的字节数
+static long ReadFast(const int *pFd, long nExpect)
+{
+	static BYTE acBuf[65536];
+	struct pollfd atPoll[BENCH_FAST_LINKS];
+	long nRecv = 0;
+	double dDeadline = NowSeconds() + BENCH_WAIT_MS/1000;
+	for (int i = 0; i < BENCH_FAST_LINKS; i++)
+	{
+		atPoll[i].fd = pFd[i];
+		atPoll[i].events = POLLIN;
+	}
+	while (nRecv < nExpect && NowSeconds() < dDeadline)
+	{
+		if (poll(atPoll, BENCH_FAST_LINKS, 100) <= 0)
+		{
+			continue;
+		}
+		for (int i = 0; i < BENCH_FAST_LINKS; i++)
+		{
+			if (atPoll[i].revents == 0)
+			{
+				continue;
+			}
+			ssize_t n = recv(pFd[i], acBuf, sizeof(acBuf), MSG_DONTWAIT);
+			if (n > 0)
+			{
+				nRecv += n;
+			}
+		}
+	}
+	return nRecv;
+}
+
+//子进程：收端口，连接后回报连上的个数；收到应收字节数后读正常连接，回报收到的字节数；收到停止命令后停慢连接
+static void ClientProc(int fdCmd, int fdReply, void *pArg)
+{
+	(void)pArg;
+	long nPort = 0, nExpect = 0, nStop = 0;
+	if (!ReadInt(fdCmd, nPort))
+	{
+		return;
+	}
+	int afd[BENCH_FAST_LINKS];
+	int fdSlow = Connect((WORD32)nPort, BENCH_SLOW_ADDR);
+	int nConnected = (fdSlow >= 0);
+	for (int i = 0; i < BENCH_FAST_LINKS; i++)
+	{
+		afd[i] = Connect((WORD32)nPort, BENCH_FAST_BASE + i);
+		nConnected += (afd[i] >= 0);
+	}
+	WriteInt(fdReply, nConnected);
+	pthread_t tSlow;
+	if (nConnected == BENCH_FAST_LINKS + 1)
+	{
+		pthread_create(&tSlow, NULL, SlowReaderProc, &fdSlow);
+		if (ReadInt(fdCmd, nExpect))
+		{
+			WriteInt(fdReply, ReadFast(afd, nExpect));
+		}
+		ReadInt(fdCmd, nStop);
+		g_bSlowStop = 1;
+		pthread_join(tSlow, NULL);
+	}
+	close(fdSlow);
+	for (int i = 0; i < BENCH_FAST_LINKS; i++)
+	{
+		close(afd[i]);
+	}
+}
+
+struct SenderArg
+{
+	CCommCtl *ptCtl;
+	const WORD32 *pdwHandle;
+	int nIndex;
+	long nFrames;
+	long nFailed;
+	double dMaxSend;		//单次HandleSend最长耗时(秒)
+};
+
+static void *FastSenderProc(void *pParam)
+{
+	SenderArg *pArg = (SenderArg *)pParam;
+	BYTE acFrame[BENCH_FRAME_LEN];
+	FillFrame(acFrame, (WORD32)pArg->nIndex, BENCH_FRAME_LEN);
+	for (long i = 0; i < pArg->nFrames; i++)
+	{
+		WORD32 dwHandle = pArg->pdwHandle[(pArg->nIndex + i) % BENCH_FAST_LINKS];
+		double dBegin = NowSeconds();
+		if (pArg->ptCtl->HandleSend(dwHandle, acFrame, sizeof(acFrame)) != 0)
+		{
+			pArg->nFailed++;
+		}
+		double dSend = NowSeconds() - dBegin;
+		if (dSend > pArg->dMaxSend)
+		{
+			pArg->dMaxSend = dSend;
+		}
+	}
+	return NULL;
+}
+
+struct SlowArg
+{
+	CCommCtl *ptCtl;
+	WORD32 dwHandle;
+	volatile int bStop;
+	long nOk;
+	long nFailed;
+};
+
+static void *SlowSenderProc(void *pParam)
+{
+	SlowArg *pArg = (SlowArg *)pParam;
+	BYTE acFrame[BENCH_SLOW_FRAME];
+	FillFrame(acFrame, 0, BENCH_SLOW_FRAME);
+	while (!pArg->bStop)
+	{
+		if (pArg->ptCtl->HandleSend(pArg->dwHandle, acFrame, sizeof(acFrame)) == 0)
+		{
+			pArg->nOk++;
+		}
+		else
+		{
+			pArg->nFailed++;
+		}
+	}
+	return NULL;
+}
+
+static bool RunOnce(int nSenders)
+{
+	BenchChild tChild;
+	if (!ForkChild(tChild, ClientProc, NULL))
+	{
+		return false;
+	}
+	CCommCtl *ptCtl = new CCommCtl;
+	WORD32 dwPort = 0;
+	if (!StartServer(ptCtl, dwPort))
+	{
+		WaitChild(tChild);
+		delete ptCtl;
+		return false;
+	}
+	long nConnected = 0;
+	WriteInt(tChild.fdCmd, dwPort);
+	ReadInt(tChild.fdReply, nConnected);
+	bool bOk = (nConnected == BENCH_FAST_LINKS + 1) && WaitUntil([&]{ return ptCtl->dwNum == BENCH_FAST_LINKS + 1; });
+	WORD32 adwHandle[BENCH_FAST_LINKS];
+	for (int i = 0; i < BENCH_FAST_LINKS; i++)
+	{
+		adwHandle[i] = ptCtl->GetLinkHandle(BENCH_FAST_BASE + i);
+		bOk = bOk && (adwHandle[i] != LEOF);
+	}
+	SlowArg tSlow = { ptCtl, ptCtl->GetLinkHandle(BENCH_SLOW_ADDR), 0, 0, 0 };
+	if (!bOk || tSlow.dwHandle == LEOF)
+	{
+		printf("%-8d setup failed\n", nSenders);
+		WaitChild(tChild);
+		delete ptCtl;
+		return false;
+	}
+
+	long nPerSender = BENCH_MSG_TOTAL/nSenders;
+	WriteInt(tChild.fdCmd, nPerSender*nSenders*BENCH_FRAME_LEN);
+	pthread_attr_t tAttr;
+	pthread_attr_init(&tAttr);
+	pthread_attr_setstacksize(&tAttr, BENCH_STACK);
+	pthread_t tSlowThread;
+	pthread_create(&tSlowThread, &tAttr, SlowSenderProc, &tSlow);
+	//先让慢连接的队列涨到高水位
+	usleep(200000);
+	std::vector<pthread_t> vecThread(nSenders);
+	std::vector<SenderArg> vecArg(nSenders);
+	double dBegin = NowSeconds();
+	for (int t = 0; t < nSenders; t++)
+	{
+		SenderArg tArg = { ptCtl, adwHandle, t, nPerSender, 0, 0 };
+		vecArg[t] = tArg;
+		pthread_create(&vecThread[t], &tAttr, FastSenderProc, &vecArg[t]);
+	}
+	long nFailed = 0;
+	double dMaxSend = 0;
+	for (int t = 0; t < nSenders; t++)
+	{
+		pthread_join(vecThread[t], NULL);
+		nFailed += vecArg[t].nFailed;
+		dMaxSend = vecArg[t].dMaxSend > dMaxSend ? vecArg[t].dMaxSend : dMaxSend;
+	}
+	long nRecv = 0;
+	ReadInt(tChild.fdReply, nRecv);
+	double dElapsed = NowSeconds() - dBegin;
+	tSlow.bStop = 1;
+	pthread_join(tSlowThread, NULL);
+	pthread_attr_destroy(&tAttr);
+	long nExpect = nPerSender*nSenders*BENCH_FRAME_LEN;
+	printf("%-8d %12.0f %14.2f %10ld %10ld %10ld\n", nSenders, nRecv/BENCH_FRAME_LEN/dElapsed, dMaxSend*1e3, nFailed,
+		tSlow.nOk, tSlow.nFailed);
+
+	WriteInt(tChild.fdCmd, 1);
+	WaitChild(tChild);
+	WaitUntil([&]{ return ptCtl->dwNum == 0; });
+	delete ptCtl;
+	//正常连接的消息全部送达，慢连接的发送在高水位处超时而不是无限等待
+	return (nFailed == 0) && (nRecv == nExpect) && (tSlow.nFailed > 0);
+}
+
+int main()
+{
+	bool bOk = true;
+	RaiseFdLimit();
+	printf("fast links=%d frame=%d bytes, slow link reads %d bytes every %d ms, high/low watermark %u/%u KB\n",
+		BENCH_FAST_LINKS, BENCH_FRAME_LEN, BENCH_SLOW_READ, BENCH_SLOW_SLEEP/1000, g_snd_high >> 10, g_snd_low >> 10);
+	printf("%-8s %12s %14s %10s %10s %10s\n", "senders", "fast msg/s", "max send ms", "fast fail", "slow ok", "slow fail");
+	for (size_t i = 0; i < sizeof(SenderNum)/sizeof(SenderNum[0]); i++)
+	{
+		bOk = RunOnce(SenderNum[i]) && bOk;
+	}
+	return bOk ? 0 : 1;
+}
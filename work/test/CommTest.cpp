@@ -0,0 +1,785 @@
+// CommTest.cpp : comm.cpp通讯组件在回环地址上的收发测试
+//
+// comm.cpp直接包含进来编译，pub.hpp用本目录的替代。服务端绑定ethname网卡的地址，测试中改为lo。
+
+#include "../comm.cpp"
+#include "TestCommon.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <vector>
+
+#define LOOPBACK_ADDR	((WORD32)0x7F000001)
+#define WAIT_MS			10000
+
+//收到的消息按连接对端不分，只按序号和内容校验
+static pthread_mutex_t g_tRcvMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int g_nRcvFrames = 0;
+static volatile int g_nRcvBad = 0;
+static volatile int g_nRcvMisaligned = 0;	//回调拿到的消息未按msg_header对齐
+static WORD32 g_dwRcvNextSeq = 0;
+
+//消息在流中不一定对齐，消息头一律拷出来读写
+static void FillFrame(std::vector<BYTE> &vecFrame, WORD32 dwSeq, WORD32 dwLen)
+{
+	vecFrame.resize(dwLen);
+	class msg_header tHead;
+	tHead.type = htons(1);
+	tHead.length = htons((WORD16)dwLen);
+	tHead.seq = htonl(dwSeq);
+	memcpy(&vecFrame[0], &tHead, sizeof(tHead));
+	for (WORD32 i = sizeof(class msg_header); i < dwLen; i++)
+	{
+		vecFrame[i] = (BYTE)(dwSeq + i);
+	}
+}
+
+static bool CheckFrame(const BYTE *pFrame, WORD32 dwLen, WORD32 dwSeq)
+{
+	class msg_header tHead;
+	memcpy(&tHead, pFrame, sizeof(tHead));
+	if (ntohs(tHead.length) != dwLen || ntohl(tHead.seq) != dwSeq)
+	{
+		return false;
+	}
+	for (WORD32 i = sizeof(class msg_header); i < dwLen; i++)
+	{
+		if (pFrame[i] != (BYTE)(dwSeq + i))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void *OnFrame(void *pMsg)
+{
+	class msg_header tHead;
+	memcpy(&tHead, pMsg, sizeof(tHead));
+	WORD32 dwLen = ntohs(tHead.length);
+	pthread_mutex_lock(&g_tRcvMutex);
+	if (!CheckFrame((const BYTE *)pMsg, dwLen, g_dwRcvNextSeq))
+	{
+		g_nRcvBad++;
+	}
+	if ((unsigned long)pMsg % __alignof__(class msg_header))
+	{
+		g_nRcvMisaligned++;
+	}
+	g_dwRcvNextSeq = ntohl(tHead.seq) + 1;
+	g_nRcvFrames++;
+	pthread_mutex_unlock(&g_tRcvMutex);
+	return NULL;
+}
+
+static void ResetRcv()
+{
+	pthread_mutex_lock(&g_tRcvMutex);
+	g_nRcvFrames = 0;
+	g_nRcvBad = 0;
+	g_nRcvMisaligned = 0;
+	g_dwRcvNextSeq = 0;
+	pthread_mutex_unlock(&g_tRcvMutex);
+}
+
+template <class Cond>
+static bool WaitFor(Cond cond, int nMs = WAIT_MS)
+{
+	for (int i = 0; i < nMs; i++)
+	{
+		if (cond())
+		{
+			return true;
+		}
+		usleep(1000);
+	}
+	return cond();
+}
+
+static int CountFds()
+{
+	int nCount = 0;
+	DIR *pDir = opendir("/proc/self/fd");
+	if (pDir == NULL)
+	{
+		return -1;
+	}
+	while (readdir(pDir) != NULL)
+	{
+		nCount++;
+	}
+	closedir(pDir);
+	return nCount;
+}
+
+//端口按进程号错开，被占用时换下一个
+static WORD32 g_dwPort = 20000 + (getpid() % 20000);
+
+static bool StartServer(CCommCtl *ptCtl, WORD32 &dwPort)
+{
+	for (int i = 0; i < 50; i++)
+	{
+		dwPort = g_dwPort++;
+		if (LEOF != ptCtl->ServInit(LOOPBACK_ADDR, dwPort))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static int Connect(WORD32 dwPort)
+{
+	struct sockaddr_in tAddr;
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	oss_setsockaddr(&tAddr, LOOPBACK_ADDR, dwPort);
+	if (connect(fd, (struct sockaddr *)&tAddr, sizeof(tAddr)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool SendAll(int fd, const BYTE *pBuf, size_t nLen)
+{
+	while (nLen > 0)
+	{
+		ssize_t n = send(fd, pBuf, nLen, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			return false;
+		}
+		pBuf += n;
+		nLen -= n;
+	}
+	return true;
+}
+
+static bool RecvAll(int fd, BYTE *pBuf, size_t nLen)
+{
+	while (nLen > 0)
+	{
+		ssize_t n = recv(fd, pBuf, nLen, 0);
+		if (n <= 0)
+		{
+			return false;
+		}
+		pBuf += n;
+		nLen -= n;
+	}
+	return true;
+}
+
+//从fd收一条消息，按消息头中的序号校验内容，序号由dwSeq带回
+static bool RecvAnyFrame(int fd, WORD32 &dwSeq)
+{
+	class msg_header tHead;
+	if (!RecvAll(fd, (BYTE *)&tHead, sizeof(tHead)))
+	{
+		return false;
+	}
+	WORD32 dwLen = ntohs(tHead.length);
+	if (dwLen < sizeof(class msg_header))
+	{
+		return false;
+	}
+	std::vector<BYTE> vecFrame(dwLen);
+	memcpy(&vecFrame[0], &tHead, sizeof(tHead));
+	if (!RecvAll(fd, &vecFrame[sizeof(tHead)], dwLen - sizeof(tHead)))
+	{
+		return false;
+	}
+	dwSeq = ntohl(tHead.seq);
+	return CheckFrame(&vecFrame[0], dwLen, dwSeq);
+}
+
+//从fd收一条消息并校验序号和内容
+static bool RecvFrame(int fd, WORD32 dwSeq)
+{
+	WORD32 dwRcvSeq = 0;
+	return RecvAnyFrame(fd, dwRcvSeq) && dwRcvSeq == dwSeq;
+}
+
+//客户端发、服务端回调收；服务端按句柄和地址发、客户端收；客户端断开后服务端摘除连接
+static void TestLoopback()
+{
+	CCommCtl *ptCtl = new CCommCtl;
+	WORD32 dwPort = 0;
+	CHECK(StartServer(ptCtl, dwPort));
+	ResetRcv();
+	g_ptcallback = OnFrame;
+
+	int fd = Connect(dwPort);
+	CHECK(fd >= 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 1; }));
+
+	//各种长度的消息连续发出，服务端按流重新切分；长度多为奇数，回调拿到的消息仍须对齐
+	const int nFrames = 2000;
+	std::vector<BYTE> vecStream;
+	std::vector<BYTE> vecFrame;
+	for (int i = 0; i < nFrames; i++)
+	{
+		FillFrame(vecFrame, i, sizeof(class msg_header) + (i*37) % 1500);
+		vecStream.insert(vecStream.end(), vecFrame.begin(), vecFrame.end());
+	}
+	int nPrintf = g_nPrintfCount;
+	CHECK(SendAll(fd, &vecStream[0], vecStream.size()));
+	CHECK(WaitFor([&]{ return g_nRcvFrames == nFrames; }));
+	CHECK(g_nRcvBad == 0);
+	CHECK(g_nRcvMisaligned == 0);
+	//收包和派发路径上不打印
+	CHECK(g_nPrintfCount == nPrintf);
+
+	WORD32 dwHandle = ptCtl->GetLinkHandle(LOOPBACK_ADDR);
+	CHECK(dwHandle != LEOF);
+	for (int i = 0; i < 100; i++)
+	{
+		FillFrame(vecFrame, i, sizeof(class msg_header) + i*10);
+		if (i % 2)
+		{
+			CHECK(ptCtl->HandleSend(dwHandle, &vecFrame[0], vecFrame.size()) == 0);
+		}
+		else
+		{
+			CHECK(ptCtl->LinkSend(LOOPBACK_ADDR, &vecFrame[0], vecFrame.size()) == 0);
+		}
+		CHECK(RecvFrame(fd, i));
+	}
+
+	close(fd);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 0; }));
+	CHECK(ptCtl->GetLinkHandle(LOOPBACK_ADDR) == LEOF);
+	CHECK(ptCtl->HandleSend(dwHandle, &vecFrame[0], vecFrame.size()) == LEOF);
+	CHECK(ptCtl->LinkSend(LOOPBACK_ADDR, &vecFrame[0], vecFrame.size()) == LEOF);
+	delete ptCtl;
+	g_ptcallback = NULL;
+}
+
+//等对端关闭：recv返回0，或者对端关闭时还有未读数据而收到RST；超时返回false
+static bool WaitPeerClose(int fd)
+{
+	struct timeval tTimeout = {WAIT_MS / 1000, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tTimeout, sizeof(tTimeout));
+	BYTE acBuf[256];
+	while (1)
+	{
+		ssize_t n = recv(fd, acBuf, sizeof(acBuf), 0);
+		if (n == 0)
+		{
+			return true;
+		}
+		if (n < 0)
+		{
+			return errno == ECONNRESET;
+		}
+	}
+}
+
+//消息长度字段为16位，最长65535字节；接收缓存从g_init_rcv起按需增长，超过SetMaxFrame的消息断开连接
+static void TestLargeFrame()
+{
+	CCommCtl *ptCtl = new CCommCtl;
+	WORD32 dwPort = 0;
+	CHECK(StartServer(ptCtl, dwPort));
+	ResetRcv();
+	g_ptcallback = OnFrame;
+
+	int fd = Connect(dwPort);
+	CHECK(fd >= 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 1; }));
+
+	//缓存边界附近和最长的消息与短消息交错，整体一次发出
+	const WORD32 adwLen[] = {g_init_rcv - 1, g_init_rcv, 20, g_init_rcv + 1, 3*g_init_rcv + 5, 8,
+							 20000, 0xFFFF, 100, 0xFFFF, 0xFFFF - 1, 9};
+	const int nLens = sizeof(adwLen) / sizeof(adwLen[0]);
+	std::vector<BYTE> vecStream;
+	std::vector<BYTE> vecFrame;
+	for (int i = 0; i < nLens; i++)
+	{
+		FillFrame(vecFrame, i, adwLen[i]);
+		vecStream.insert(vecStream.end(), vecFrame.begin(), vecFrame.end());
+	}
+	int nPrintf = g_nPrintfCount;
+	CHECK(SendAll(fd, &vecStream[0], vecStream.size()));
+	CHECK(WaitFor([&]{ return g_nRcvFrames == nLens; }));
+	CHECK(g_nRcvBad == 0);
+
+	//最长的消息分成小段慢慢发，每段都在消息中间断开
+	FillFrame(vecFrame, nLens, 0xFFFF);
+	for (WORD32 dwOff = 0; dwOff < vecFrame.size(); dwOff += 997)
+	{
+		WORD32 dwChunk = vecFrame.size() - dwOff < 997 ? vecFrame.size() - dwOff : 997;
+		CHECK(SendAll(fd, &vecFrame[dwOff], dwChunk));
+		if (dwOff % (16*997) == 0)
+		{
+			usleep(1000);
+		}
+	}
+	CHECK(WaitFor([&]{ return g_nRcvFrames == nLens + 1; }));
+	CHECK(g_nRcvBad == 0);
+	CHECK(g_nPrintfCount == nPrintf);
+	close(fd);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 0; }));
+	delete ptCtl;
+
+	//最大消息长度设为10000：不超过的照常派发，超过的断开连接，之前的消息不受影响
+	ptCtl = new CCommCtl;
+	CHECK(ptCtl->SetMaxFrame(sizeof(class msg_header) - 1) == LEOF);
+	CHECK(ptCtl->SetMaxFrame(10000) == 0);
+	CHECK(StartServer(ptCtl, dwPort));
+	ResetRcv();
+	fd = Connect(dwPort);
+	CHECK(fd >= 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 1; }));
+	FillFrame(vecFrame, 0, 10000);
+	CHECK(SendAll(fd, &vecFrame[0], vecFrame.size()));
+	CHECK(WaitFor([&]{ return g_nRcvFrames == 1; }));
+	FillFrame(vecFrame, 1, 10001);
+	CHECK(SendAll(fd, &vecFrame[0], vecFrame.size()));
+	CHECK(WaitPeerClose(fd));
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 0; }));
+	CHECK(g_nRcvFrames == 1);
+	CHECK(g_nRcvBad == 0);
+	close(fd);
+
+	//长度小于消息头的同样断开
+	fd = Connect(dwPort);
+	CHECK(fd >= 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 1; }));
+	FillFrame(vecFrame, 2, 16);
+	class msg_header tHead;
+	memcpy(&tHead, &vecFrame[0], sizeof(tHead));
+	tHead.length = htons(sizeof(class msg_header) - 1);
+	memcpy(&vecFrame[0], &tHead, sizeof(tHead));
+	CHECK(SendAll(fd, &vecFrame[0], vecFrame.size()));
+	CHECK(WaitPeerClose(fd));
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 0; }));
+	CHECK(g_nRcvFrames == 1);
+	close(fd);
+	delete ptCtl;
+	g_ptcallback = NULL;
+}
+
+//并发发送任务：序号高8位为任务号，低24位从0递增
+#define SEND_THREADS		4
+#define SEND_PER_THREAD		300
+
+struct T_SendArg
+{
+	CCommCtl *ptCtl;
+	WORD32 dwHandle;
+	WORD32 dwThread;
+	int nFailed;
+};
+
+static void *SendThread(void *arg)
+{
+	T_SendArg *ptArg = (T_SendArg *)arg;
+	std::vector<BYTE> vecFrame;
+	for (WORD32 i = 0; i < SEND_PER_THREAD; i++)
+	{
+		FillFrame(vecFrame, (ptArg->dwThread << 24) | i, sizeof(class msg_header) + (i*131 + ptArg->dwThread*17) % 9000);
+		if (ptArg->ptCtl->HandleSend(ptArg->dwHandle, &vecFrame[0], vecFrame.size()) != 0)
+		{
+			ptArg->nFailed++;
+		}
+	}
+	return NULL;
+}
+
+static long ElapsedMs(const struct timeval &tStart)
+{
+	struct timeval tNow;
+	gettimeofday(&tNow, NULL);
+	return (tNow.tv_sec - tStart.tv_sec)*1000 + (tNow.tv_usec - tStart.tv_usec)/1000;
+}
+
+//对端不收时消息进发送队列，发送者不阻塞；超过g_snd_high后等g_snd_wait超时失败。
+//对端开始收后排队的消息按序送达，多个任务并发发送的消息整条到达、互不交错
+static void TestSendBackpressure()
+{
+	CCommCtl *ptCtl = new CCommCtl;
+	WORD32 dwPort = 0;
+	CHECK(StartServer(ptCtl, dwPort));
+
+	//对端接收缓存设小，发送很快进入队列
+	struct sockaddr_in tAddr;
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	int nRcvBuf = 4096;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &nRcvBuf, sizeof(nRcvBuf));
+	struct timeval tTimeout = {WAIT_MS / 1000, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tTimeout, sizeof(tTimeout));
+	oss_setsockaddr(&tAddr, LOOPBACK_ADDR, dwPort);
+	CHECK(connect(fd, (struct sockaddr *)&tAddr, sizeof(tAddr)) == 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 1; }));
+	WORD32 dwHandle = ptCtl->GetLinkHandle(LOOPBACK_ADDR);
+	CHECK(dwHandle != LEOF);
+
+	//队列低于高水位时立即返回，超过后等满g_snd_wait返回失败；本端内核发送缓存先吃掉一部分，上限按64MB算
+	const WORD32 dwLen = 16000;
+	const WORD32 dwMaxSent = 64*1024*1024 / dwLen;
+	std::vector<BYTE> vecFrame;
+	WORD32 dwSent = 0;
+	long lLastMs = 0;
+	int nPrintf = g_nPrintfCount;
+	while (dwSent < dwMaxSent)
+	{
+		FillFrame(vecFrame, dwSent, dwLen);
+		struct timeval tStart;
+		gettimeofday(&tStart, NULL);
+		WORD32 dwRet = ptCtl->HandleSend(dwHandle, &vecFrame[0], vecFrame.size());
+		lLastMs = ElapsedMs(tStart);
+		if (dwRet != 0)
+		{
+			break;
+		}
+		CHECK(lLastMs < (long)g_snd_wait / 2);
+		dwSent++;
+	}
+	CHECK(dwSent * dwLen >= g_snd_high);
+	CHECK(dwSent < dwMaxSent);
+	CHECK(lLastMs >= (long)g_snd_wait - 50);
+	CHECK(g_nPrintfCount - nPrintf == 1);
+
+	//对端开始收的同时几个任务并发发送
+	pthread_t atThread[SEND_THREADS];
+	T_SendArg atArg[SEND_THREADS];
+	for (WORD32 i = 0; i < SEND_THREADS; i++)
+	{
+		atArg[i].ptCtl = ptCtl;
+		atArg[i].dwHandle = dwHandle;
+		atArg[i].dwThread = i + 1;
+		atArg[i].nFailed = 0;
+		CHECK(pthread_create(&atThread[i], NULL, SendThread, &atArg[i]) == 0);
+	}
+
+	//先到的是超时前排队的消息，之后各任务的消息按各自序号递增
+	bool bOk = true;
+	for (WORD32 i = 0; bOk && i < dwSent; i++)
+	{
+		bOk = RecvFrame(fd, i);
+	}
+	CHECK(bOk);
+	WORD32 adwNext[SEND_THREADS + 1] = {0};
+	for (int i = 0; bOk && i < SEND_THREADS*SEND_PER_THREAD; i++)
+	{
+		WORD32 dwSeq = 0;
+		bOk = RecvAnyFrame(fd, dwSeq);
+		WORD32 dwThread = dwSeq >> 24;
+		bOk = bOk && dwThread >= 1 && dwThread <= SEND_THREADS && (dwSeq & 0xFFFFFF) == adwNext[dwThread];
+		if (bOk)
+		{
+			adwNext[dwThread]++;
+		}
+	}
+	CHECK(bOk);
+	for (WORD32 i = 0; i < SEND_THREADS; i++)
+	{
+		pthread_join(atThread[i], NULL);
+		CHECK(atArg[i].nFailed == 0);
+		CHECK(adwNext[i + 1] == SEND_PER_THREAD);
+	}
+
+	close(fd);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 0; }));
+	delete ptCtl;
+}
+
+//工作任务回调卡住时，第一条消息进入回调后等g_nGateOpen置位
+static volatile int g_nGateOpen = 1;
+static volatile int g_nGateEntered = 0;
+
+static void *OnFrameGate(void *pMsg)
+{
+	OnFrame(pMsg);
+	__sync_fetch_and_add(&g_nGateEntered, 1);
+	while (0 == __sync_fetch_and_add(&g_nGateOpen, 0))
+	{
+		usleep(1000);
+	}
+	return NULL;
+}
+
+//工作任务队列满时接收任务不等待，丢弃后来的消息并计数；内存不足也丢弃并计数
+static void TestPostJobDrop()
+{
+	CCommCtl *ptCtl = new CCommCtl;
+	CHECK(ptCtl->SetWorkerNum(1) == 0);
+	WORD32 dwPort = 0;
+	CHECK(StartServer(ptCtl, dwPort));
+	ResetRcv();
+	g_nGateOpen = 0;
+	g_nGateEntered = 0;
+	g_ptcallback = OnFrameGate;
+
+	int fd = Connect(dwPort);
+	CHECK(fd >= 0);
+	std::vector<BYTE> vecFrame;
+	FillFrame(vecFrame, 0, sizeof(class msg_header) + 4);
+	CHECK(SendAll(fd, &vecFrame[0], vecFrame.size()));
+	CHECK(WaitFor([&]{ return g_nGateEntered == 1; }));
+
+	//回调卡住，队列排满g_max_jobs条后多出的nExtra条丢弃
+	const int nExtra = 100;
+	std::vector<BYTE> vecStream;
+	for (WORD32 i = 1; i <= g_max_jobs + nExtra; i++)
+	{
+		FillFrame(vecFrame, i, sizeof(class msg_header) + 4);
+		vecStream.insert(vecStream.end(), vecFrame.begin(), vecFrame.end());
+	}
+	CHECK(SendAll(fd, &vecStream[0], vecStream.size()));
+	CHECK(WaitFor([&]{ return ptCtl->dwDropFull == (WORD32)nExtra; }));
+	CHECK(ptCtl->dwDropNoMem == 0);
+
+	//接收任务没有阻塞，仍能接纳新连接
+	int fd2 = Connect(dwPort);
+	CHECK(fd2 >= 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 2; }));
+	close(fd2);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 1; }));
+
+	//放开回调，排队的消息按序全部送达
+	g_nGateOpen = 1;
+	CHECK(WaitFor([&]{ return g_nRcvFrames == (int)g_max_jobs + 1; }));
+	CHECK(g_nRcvBad == 0);
+
+	//拷贝消息的内存申请失败时丢弃该消息
+	g_nMallocFailAfter = 0;
+	FillFrame(vecFrame, g_max_jobs + 1, sizeof(class msg_header) + 4);
+	CHECK(SendAll(fd, &vecFrame[0], vecFrame.size()));
+	CHECK(WaitFor([&]{ return ptCtl->dwDropNoMem == 1; }));
+	g_nMallocFailAfter = -1;
+	CHECK(ptCtl->dwDropFull == (WORD32)nExtra);
+
+	//之后的消息照常送达
+	FillFrame(vecFrame, g_max_jobs + 1, sizeof(class msg_header) + 4);
+	CHECK(SendAll(fd, &vecFrame[0], vecFrame.size()));
+	CHECK(WaitFor([&]{ return g_nRcvFrames == (int)g_max_jobs + 2; }));
+	CHECK(g_nRcvBad == 0);
+
+	close(fd);
+	delete ptCtl;
+	g_ptcallback = NULL;
+}
+
+static int SumReactorLinks(CCommCtl *ptCtl)
+{
+	int nLinks = 0;
+	for (WORD32 i = 0; i < ptCtl->dwReactorNum; i++)
+	{
+		nLinks += ptCtl->atReactor[i].dwLinks;
+	}
+	return nLinks;
+}
+
+//加入epoll失败时连接不发布：返回LEOF，fd已关闭，查不到连接，连接数不变
+static void TestAppendLinkFail()
+{
+	CCommCtl *ptCtl = new CCommCtl;
+	WORD32 dwPort = 0;
+	CHECK(StartServer(ptCtl, dwPort));
+	int fd = Connect(dwPort);
+	CHECK(fd >= 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 1; }));
+	WORD32 dwHandle = ptCtl->GetLinkHandle(LOOPBACK_ADDR);
+
+	//普通文件和/dev/null都不支持epoll，EPOLL_CTL_ADD返回EPERM
+	const WORD32 dwAddr = 0x0A000001;
+	char acPath[] = "/tmp/CommTestXXXXXX";
+	int fdFile = mkstemp(acPath);
+	CHECK(fdFile >= 0);
+	unlink(acPath);
+	int fdNull = open("/dev/null", O_RDWR);
+	CHECK(fdNull >= 0);
+	int afd[] = {fdFile, fdNull};
+	for (int i = 0; i < 2; i++)
+	{
+		CHECK(ptCtl->AppendLink(afd[i], dwAddr) == LEOF);
+		CHECK(fcntl(afd[i], F_GETFD) == -1 && errno == EBADF);
+		CHECK(ptCtl->GetLinkHandle(dwAddr) == LEOF);
+		CHECK(ptCtl->ptLinkSlot[afd[i]].ptLink == NULL);
+		CHECK(ptCtl->dwNum == 1);
+		CHECK(SumReactorLinks(ptCtl) == 1);
+	}
+
+	//原有连接不受影响，之后的连接照常加入
+	CHECK(ptCtl->GetLinkHandle(LOOPBACK_ADDR) == dwHandle);
+	int fd2 = Connect(dwPort);
+	CHECK(fd2 >= 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 2; }));
+	close(fd);
+	close(fd2);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 0; }));
+	CHECK(SumReactorLinks(ptCtl) == 0);
+	delete ptCtl;
+}
+
+//连接反复建立断开的同时按地址和句柄发送，连接在加入和摘除的任何时刻都不能被用到已释放的内存
+#define CHURN_THREADS		3
+#define CHURN_LINKS			200
+
+struct T_ChurnArg
+{
+	CCommCtl *ptCtl;
+	WORD32 dwPort;
+	int nConnected;
+};
+
+static volatile int g_nChurnStop = 0;
+
+//监听fd上已完成握手、还没有accept的连接数
+static int ListenBacklog(int fd)
+{
+	struct tcp_info tInfo;
+	socklen_t nLen = sizeof(tInfo);
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &tInfo, &nLen) != 0)
+	{
+		return -1;
+	}
+	return (int)tInfo.tcpi_unacked;
+}
+
+static void *ChurnThread(void *arg)
+{
+	T_ChurnArg *ptArg = (T_ChurnArg *)arg;
+	std::vector<BYTE> vecFrame;
+	FillFrame(vecFrame, 0, sizeof(class msg_header) + 32);
+	for (int i = 0; i < CHURN_LINKS; i++)
+	{
+		int fd = Connect(ptArg->dwPort);
+		if (fd < 0)
+		{
+			continue;
+		}
+		ptArg->nConnected++;
+		if (i % 2)
+		{
+			SendAll(fd, &vecFrame[0], vecFrame.size());
+		}
+		close(fd);
+	}
+	return NULL;
+}
+
+static void *ChurnSendThread(void *arg)
+{
+	CCommCtl *ptCtl = (CCommCtl *)arg;
+	std::vector<BYTE> vecFrame;
+	FillFrame(vecFrame, 0, sizeof(class msg_header) + 64);
+	while (0 == __sync_fetch_and_add(&g_nChurnStop, 0))
+	{
+		ptCtl->LinkSend(LOOPBACK_ADDR, &vecFrame[0], vecFrame.size());
+		WORD32 dwHandle = ptCtl->GetLinkHandle(LOOPBACK_ADDR);
+		if (dwHandle != LEOF)
+		{
+			ptCtl->HandleSend(dwHandle, &vecFrame[0], vecFrame.size());
+		}
+	}
+	return NULL;
+}
+
+static void TestLinkChurn()
+{
+	CCommCtl *ptCtl = new CCommCtl;
+	CHECK(ptCtl->SetReactorNum(2) == 0);
+	WORD32 dwPort = 0;
+	CHECK(StartServer(ptCtl, dwPort));
+	g_nChurnStop = 0;
+
+	pthread_t atSend[2];
+	for (int i = 0; i < 2; i++)
+	{
+		CHECK(pthread_create(&atSend[i], NULL, ChurnSendThread, ptCtl) == 0);
+	}
+	pthread_t atChurn[CHURN_THREADS];
+	T_ChurnArg atArg[CHURN_THREADS];
+	for (int i = 0; i < CHURN_THREADS; i++)
+	{
+		atArg[i].ptCtl = ptCtl;
+		atArg[i].dwPort = dwPort;
+		atArg[i].nConnected = 0;
+		CHECK(pthread_create(&atChurn[i], NULL, ChurnThread, &atArg[i]) == 0);
+	}
+	int nConnected = 0;
+	for (int i = 0; i < CHURN_THREADS; i++)
+	{
+		pthread_join(atChurn[i], NULL);
+		nConnected += atArg[i].nConnected;
+	}
+	CHECK(nConnected == CHURN_THREADS*CHURN_LINKS);
+	//客户端都已关闭，但最后几个连接可能还在监听队列里没接纳：等队列为空且连接数持续为0
+	int nIdle = 0;
+	CHECK(WaitFor([&]{ nIdle = (ListenBacklog(ptCtl->dwservfd) == 0 && ptCtl->dwNum == 0) ? nIdle + 1 : 0; return nIdle >= 50; }));
+	g_nChurnStop = 1;
+	for (int i = 0; i < 2; i++)
+	{
+		pthread_join(atSend[i], NULL);
+	}
+	CHECK(SumReactorLinks(ptCtl) == 0);
+	CHECK(ptCtl->GetLinkHandle(LOOPBACK_ADDR) == LEOF);
+
+	//之后的连接照常收发
+	ResetRcv();
+	g_ptcallback = OnFrame;
+	int fd = Connect(dwPort);
+	CHECK(fd >= 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 1; }));
+	std::vector<BYTE> vecFrame;
+	FillFrame(vecFrame, 0, sizeof(class msg_header) + 100);
+	CHECK(SendAll(fd, &vecFrame[0], vecFrame.size()));
+	CHECK(WaitFor([&]{ return g_nRcvFrames == 1; }));
+	CHECK(ptCtl->LinkSend(LOOPBACK_ADDR, &vecFrame[0], vecFrame.size()) == 0);
+	CHECK(RecvFrame(fd, 0));
+	close(fd);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 0; }));
+	delete ptCtl;
+	g_ptcallback = NULL;
+}
+
+//ServInit中途失败时停掉已起的任务、关闭监听fd，之后可以再次ServInit；析构关闭全部fd
+static void TestServInitCleanup()
+{
+	int nFds = CountFds();
+	CCommCtl *ptCtl = new CCommCtl;
+	CHECK(ptCtl->SetReactorNum(3) == 0);
+	CHECK(ptCtl->SetWorkerNum(2) == 0);
+
+	//两个工作任务和0号接收任务起来后，1号接收任务创建失败
+	g_nTaskFailAfter = 3;
+	WORD32 dwPort = g_dwPort++;
+	CHECK(ptCtl->ServInit(LOOPBACK_ADDR, dwPort) == LEOF);
+	g_nTaskFailAfter = -1;
+	CHECK(ptCtl->dwTasks == 0);
+	CHECK(ptCtl->dwservfd == 0);
+	CHECK(ptCtl->dwWorkerInit == 0);
+	CHECK(ptCtl->atReactor[0].acName[0] == 0);
+
+	//监听fd已关闭，同一端口可以重新监听
+	CHECK(ptCtl->ServInit(LOOPBACK_ADDR, dwPort) != LEOF);
+	CHECK(ptCtl->dwTasks == 5);
+	int fd = Connect(dwPort);
+	CHECK(fd >= 0);
+	CHECK(WaitFor([&]{ return ptCtl->dwNum == 1; }));
+	delete ptCtl;
+	close(fd);
+	CHECK(CountFds() == nFds);
+
+	//没有ServInit过也要关闭构造时建的epoll fd
+	ptCtl = new CCommCtl;
+	CHECK(ptCtl->SetReactorNum(4) == 0);
+	delete ptCtl;
+	CHECK(CountFds() == nFds);
+}
+
+int main()
+{
+	strcpy(ethname, "lo");
+	TestLoopback();
+	TestLargeFrame();
+	TestPostJobDrop();
+	TestSendBackpressure();
+	TestAppendLinkFail();
+	TestLinkChurn();
+	TestServInitCleanup();
+	return TEST_RESULT();
+}
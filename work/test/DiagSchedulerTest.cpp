@@ -0,0 +1,215 @@
+// DiagSchedulerTest.cpp : CDiagScheduler的依赖调度
+//
+// 用模拟数据源代替数据库加载和诊断：每个任务睡眠若干毫秒，记下开始、结束时刻，
+// 可以指定某个任务号失败，检查执行顺序、并发和失败后依赖任务不再执行。
+
+#include "Win32Compat.h"
+#include "MfcCompat.h"
+#include "TestCommon.h"
+#include "../TSAlarmServer_WD/TSAlarmServer_WD/DiagScheduler.h"
+
+//与AlarmTask.h中的任务号对应的模拟任务
+enum
+{
+	SIM_LOAD_YM = 0,
+	SIM_LOAD_BILL,
+	SIM_LOAD_BRAND,
+	SIM_DIAG_BILL,
+	SIM_DIAG_BRAND,
+	SIM_REPORT,
+	SIM_TASK_NUM,
+};
+
+#define SIM_MAX_SHARDS		4
+
+struct SimSource
+{
+	int nSleepMs[SIM_TASK_NUM];
+	int nFailTask;				//执行失败的任务号，-1为都成功
+	double dStart[SIM_TASK_NUM][SIM_MAX_SHARDS];
+	double dEnd[SIM_TASK_NUM][SIM_MAX_SHARDS];
+	int nRunCount[SIM_TASK_NUM][SIM_MAX_SHARDS];
+	int nRunning;
+	int nMaxRunning;
+	CRITICAL_SECTION cs;
+};
+
+static double NowSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+static void InitSource(SimSource &Source, int nSleepMs, int nFailTask)
+{
+	memset(&Source, 0, sizeof(Source));
+	for (int i=0; i<SIM_TASK_NUM; i++)
+	{
+		Source.nSleepMs[i] = nSleepMs;
+	}
+	Source.nFailTask = nFailTask;
+	InitializeCriticalSection(&Source.cs);
+}
+
+static BOOL SimTaskProc(LPVOID pParam, int nTaskId, int nShard)
+{
+	SimSource *pSource = (SimSource*)pParam;
+	EnterCriticalSection(&pSource->cs);
+	pSource->dStart[nTaskId][nShard] = NowSeconds();
+	pSource->nRunCount[nTaskId][nShard]++;
+	if (++pSource->nRunning > pSource->nMaxRunning)
+	{
+		pSource->nMaxRunning = pSource->nRunning;
+	}
+	LeaveCriticalSection(&pSource->cs);
+
+	Sleep(pSource->nSleepMs[nTaskId]);
+
+	EnterCriticalSection(&pSource->cs);
+	pSource->nRunning--;
+	pSource->dEnd[nTaskId][nShard] = NowSeconds();
+	LeaveCriticalSection(&pSource->cs);
+	return nTaskId != pSource->nFailTask;
+}
+
+//三个加载任务互不依赖，账单诊断分nBillShards片，报表依赖两个诊断
+static void AddSimTasks(CDiagScheduler &Scheduler, int nBillShards)
+{
+	Scheduler.Reset();
+	Scheduler.AddTask(SIM_LOAD_YM, 0, 0);
+	Scheduler.AddTask(SIM_LOAD_BILL, 0, 0);
+	Scheduler.AddTask(SIM_LOAD_BRAND, 0, 0);
+	for (int i=0; i<nBillShards; i++)
+	{
+		Scheduler.AddTask(SIM_DIAG_BILL, i, DIAGTASK_BIT(SIM_LOAD_YM)|DIAGTASK_BIT(SIM_LOAD_BILL));
+	}
+	Scheduler.AddTask(SIM_DIAG_BRAND, 0, DIAGTASK_BIT(SIM_LOAD_YM)|DIAGTASK_BIT(SIM_LOAD_BRAND));
+	Scheduler.AddTask(SIM_REPORT, 0, DIAGTASK_BIT(SIM_DIAG_BILL)|DIAGTASK_BIT(SIM_DIAG_BRAND));
+}
+
+//任务在所依赖的任务全部分片结束之后才开始
+static BOOL StartsAfter(const SimSource &Source, int nTaskId, int nShards, int nDependId, int nDependShards)
+{
+	for (int i=0; i<nShards; i++)
+	{
+		for (int j=0; j<nDependShards; j++)
+		{
+			if (Source.dStart[nTaskId][i] < Source.dEnd[nDependId][j])
+			{
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+static void TestOrder(int nWorkers)
+{
+	SimSource Source;
+	InitSource(Source, 20, -1);
+	CDiagScheduler Scheduler;
+	AddSimTasks(Scheduler, SIM_MAX_SHARDS);
+	Scheduler.Run(nWorkers, SimTaskProc, &Source);
+
+	for (int i=0; i<Scheduler.GetTaskNum(); i++)
+	{
+		CHECK(Scheduler.GetTask(i).nState == DIAGSTATE_DONE);
+	}
+	//每个分片都执行且只执行一次
+	BOOL bOnce = TRUE;
+	for (int i=0; i<SIM_MAX_SHARDS; i++)
+	{
+		bOnce = bOnce && Source.nRunCount[SIM_DIAG_BILL][i] == 1;
+	}
+	CHECK(bOnce);
+	CHECK(Source.nRunCount[SIM_REPORT][0] == 1);
+
+	CHECK(StartsAfter(Source, SIM_DIAG_BILL, SIM_MAX_SHARDS, SIM_LOAD_YM, 1));
+	CHECK(StartsAfter(Source, SIM_DIAG_BILL, SIM_MAX_SHARDS, SIM_LOAD_BILL, 1));
+	CHECK(StartsAfter(Source, SIM_DIAG_BRAND, 1, SIM_LOAD_BRAND, 1));
+	CHECK(StartsAfter(Source, SIM_REPORT, 1, SIM_DIAG_BILL, SIM_MAX_SHARDS));
+	CHECK(StartsAfter(Source, SIM_REPORT, 1, SIM_DIAG_BRAND, 1));
+
+	CHECK(Source.nMaxRunning <= nWorkers);
+	if (nWorkers > 1)
+	{
+		//三个加载任务和账单诊断的各分片能同时执行
+		CHECK(Source.nMaxRunning > 1);
+	}
+	DeleteCriticalSection(&Source.cs);
+}
+
+//多线程的总耗时接近关键路径，不是各任务耗时之和
+static void TestParallel()
+{
+	SimSource Source;
+	InitSource(Source, 50, -1);
+	CDiagScheduler Scheduler;
+	AddSimTasks(Scheduler, SIM_MAX_SHARDS);
+	double dBegin = NowSeconds();
+	Scheduler.Run(DIAG_MAX_WORKERS, SimTaskProc, &Source);
+	double dElapsed = NowSeconds() - dBegin;
+	//关键路径为加载、诊断、报表三段，共150ms；顺序执行要450ms
+	CHECK(dElapsed < 0.35);
+	DeleteCriticalSection(&Source.cs);
+}
+
+//加载失败：依赖它的诊断全部跳过，经诊断间接依赖的报表也跳过，不相关的任务照常执行
+static void TestFailure(int nWorkers)
+{
+	SimSource Source;
+	InitSource(Source, 5, SIM_LOAD_BILL);
+	CDiagScheduler Scheduler;
+	AddSimTasks(Scheduler, SIM_MAX_SHARDS);
+	Scheduler.Run(nWorkers, SimTaskProc, &Source);
+
+	for (int i=0; i<Scheduler.GetTaskNum(); i++)
+	{
+		const DiagTask &iTask = Scheduler.GetTask(i);
+		switch (iTask.nTaskId)
+		{
+		case SIM_LOAD_BILL:
+			CHECK(iTask.nState == DIAGSTATE_FAILED);
+			break;
+		case SIM_DIAG_BILL:
+		case SIM_REPORT:
+			CHECK(iTask.nState == DIAGSTATE_SKIPPED);
+			CHECK(Source.nRunCount[iTask.nTaskId][iTask.nShard] == 0);
+			break;
+		default:
+			CHECK(iTask.nState == DIAGSTATE_DONE);
+			CHECK(Source.nRunCount[iTask.nTaskId][iTask.nShard] == 1);
+			break;
+		}
+	}
+	DeleteCriticalSection(&Source.cs);
+}
+
+//Reset后可以重新登记执行
+static void TestReuse()
+{
+	SimSource Source;
+	InitSource(Source, 1, -1);
+	CDiagScheduler Scheduler;
+	AddSimTasks(Scheduler, 1);
+	Scheduler.Run(2, SimTaskProc, &Source);
+	AddSimTasks(Scheduler, 2);
+	CHECK(Scheduler.GetTaskNum() == 7);
+	Scheduler.Run(2, SimTaskProc, &Source);
+	CHECK(Source.nRunCount[SIM_DIAG_BILL][0] == 2);
+	CHECK(Source.nRunCount[SIM_DIAG_BILL][1] == 1);
+	CHECK(Source.nRunCount[SIM_REPORT][0] == 2);
+	DeleteCriticalSection(&Source.cs);
+}
+
+int main()
+{
+	TestOrder(1);
+	TestOrder(3);
+	TestParallel();
+	TestFailure(1);
+	TestFailure(3);
+	TestReuse();
+	return TEST_RESULT();
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+// 充值记录对账的测试替代：内存中的TE_PAYMENT_PAYRECORD，按CPayReconRule::BuildQuery语句的SQL语义
+// 逐设备算出COUNT和SUM(DISTINCT POWER(...))，按NET_MESSAGE_RETRECORDOFTB报文格式返回；
+// 以及改造前逐台查询、按[COUNT]倒序取前10条的判断，用来对照。PayReconRuleTest和PayReconBench共用。
+
+#include "Win32Compat.h"
+#include "NetMessageStub.h"
+#include "../../inc/RecordSetReader.h"
+#include "../TSSampleDataSvr_new(920)/TSSampleDataSvr/PayReconRule.h"
+#include <map>
+#include <vector>
+#include <algorithm>
+
+typedef std::map<int, std::vector<int> > FakePayRecordTable;	//设备ID -> 各条充值记录的[COUNT]
+
+//每行若干个DWORD字段的记录集应答
+inline BYTE *MakeDwordReply(const std::vector<DWORD> &vecValue, int nFields)
+{
+	DWORD dwRecordLen = sizeof(DWORD)*nFields;
+	DWORD dwRecords = (DWORD)vecValue.size()/nFields;
+	size_t nLen = sizeof(NetMessageHead) + sizeof(WORD) + sizeof(MessageRetRecordHead)*nFields + sizeof(DWORD)*2 + dwRecordLen*dwRecords;
+	BYTE *pReply = new BYTE[nLen];
+	memset(pReply, 0, nLen);
+	BYTE *pByte = pReply;
+	NetMessageHead *pHead = (NetMessageHead*)pByte;
+	pHead->MessageType = NET_MESSAGE_RETRECORDOFTB;
+	pHead->Length = (DWORD)(nLen - sizeof(NetMessageHead));
+	pByte += sizeof(NetMessageHead);
+	*(WORD*)pByte = (WORD)nFields;
+	pByte += sizeof(WORD);
+	MessageRetRecordHead *pField = (MessageRetRecordHead*)pByte;
+	for (int k=0; k<nFields; k++)
+	{
+		pField[k].DataLen = sizeof(DWORD);
+	}
+	pByte += sizeof(MessageRetRecordHead)*nFields;
+	memcpy(pByte, &dwRecordLen, sizeof(DWORD));
+	pByte += sizeof(DWORD);
+	memcpy(pByte, &dwRecords, sizeof(DWORD));
+	pByte += sizeof(DWORD);
+	if (!vecValue.empty())
+	{
+		memcpy(pByte, &vecValue[0], sizeof(DWORD)*vecValue.size());
+	}
+	return pReply;
+}
+
+//执行BuildQuery的语句，语句不认识时返回NULL，与实时库查询失败时一样
+inline BYTE *FakePayReconQuery(const FakePayRecordTable &Table, const char *pQuery)
+{
+	const char *p = strstr(pQuery, "FROM (VALUES ");
+	if (p == NULL || strstr(pQuery, ") AS v(D,M) LEFT JOIN TE_PAYMENT_PAYRECORD p") == NULL)
+	{
+		return NULL;
+	}
+	p += strlen("FROM (VALUES ");
+	std::vector<DWORD> vecValue;
+	int nDevId = 0, nMax = 0, nRead = 0;
+	while (sscanf(p, "(%d,%d)%n", &nDevId, &nMax, &nRead) == 2)
+	{
+		p += nRead;
+		//COUNT(p.[COUNT])：0<[COUNT]<=M的记录数，重复的也计入；SUM(DISTINCT ...)：同一次购电只算一次
+		DWORD dwCount = 0, dwMask = 0;
+		FakePayRecordTable::const_iterator it = Table.find(nDevId);
+		for (size_t i=0; it!=Table.end() && i<it->second.size(); i++)
+		{
+			int nCount = it->second[i];
+			if (nCount > 0 && nCount <= nMax)
+			{
+				dwCount++;
+				if (nCount > nMax - 10)
+				{
+					dwMask |= (DWORD)1 << (nMax - nCount);
+				}
+			}
+		}
+		vecValue.push_back((DWORD)nDevId);
+		vecValue.push_back(dwCount);
+		vecValue.push_back(dwMask);
+		if (*p != ',')
+		{
+			break;
+		}
+		p++;
+	}
+	return MakeDwordReply(vecValue, 3);
+}
+
+//改造前CheckPaymentRecord的判断：逐台查询0<[COUNT]<=MaxBuyNum的记录，按[COUNT]倒序只看前10条。
+//原代码中MaxBuyNum-[COUNT]超过9时越界写ChargeCnt，这里跳过
+inline int LegacyCallNum(const std::vector<int> &vecCount, int MaxBuyNum)
+{
+	std::vector<int> vecDesc;
+	for (size_t i=0; i<vecCount.size(); i++)
+	{
+		if (vecCount[i] > 0 && vecCount[i] <= MaxBuyNum)
+		{
+			vecDesc.push_back(vecCount[i]);
+		}
+	}
+	std::sort(vecDesc.rbegin(), vecDesc.rend());
+	DWORD dwRecordNum = (DWORD)vecDesc.size();
+	if (dwRecordNum == 0)
+	{
+		return (MaxBuyNum<10)?MaxBuyNum:10;
+	}
+	if (dwRecordNum == (DWORD)MaxBuyNum || (MaxBuyNum - dwRecordNum) > 10)
+	{
+		return 0;
+	}
+	int ChargeCnt[10] = {0};
+	for (int i=0; i<(int)dwRecordNum && i<10; i++)
+	{
+		int nIndex = MaxBuyNum - vecDesc[i];
+		if (nIndex >= 0 && nIndex < 10)
+		{
+			ChargeCnt[nIndex] = vecDesc[i];
+		}
+	}
+	int CallNum = 0;
+	for (int i=0; i<MaxBuyNum && i<10; i++)
+	{
+		if (ChargeCnt[i] == 0)
+		{
+			CallNum = i + 1;
+		}
+	}
+	return CallNum;
+}
+
+//按QueryPaymentBatch的方式查询一批设备并判断，返回应答中匹配的设备数，查询失败返回-1
+inline int FakePayReconBatch(const FakePayRecordTable &Table, PayReconItem *pItems, int nItems)
+{
+	CString strQuery;
+	CPayReconRule::BuildQuery(strQuery, pItems, nItems);
+	BYTE *pRead = FakePayReconQuery(Table, strQuery);
+	if (pRead == NULL)
+	{
+		return -1;
+	}
+	CRecordSetReader rs;
+	int nMatched = -1;
+	if (rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), 3))
+	{
+		nMatched = CPayReconRule::Evaluate(rs, pItems, nItems);
+	}
+	delete[] pRead;
+	return nMatched;
+}
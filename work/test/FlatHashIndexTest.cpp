@@ -0,0 +1,94 @@
+// FlatHashIndexTest.cpp : CFlatHashIndex插入、覆盖、扩容、清空和查找
+//
+
+#include "Win32Compat.h"
+#include "TestCommon.h"
+#include "../TSSampleDataSvr_new(920)/TSSampleDataSvr/FlatHashIndex.h"
+#include <map>
+
+static void TestEmpty()
+{
+	CFlatHashIndex Index;
+	int nValue = -1;
+	CHECK(Index.GetCount() == 0);
+	CHECK(!Index.Find(0, nValue));
+	CHECK(nValue == -1);
+}
+
+static void TestInsertFind()
+{
+	CFlatHashIndex Index;
+	Index.Init(4);
+	CHECK(Index.Insert(7, 70));
+	CHECK(Index.Insert(-1, 10));
+	CHECK(Index.Insert(0, 0));
+	//重复插入只更新值
+	CHECK(!Index.Insert(7, 71));
+	CHECK(Index.GetCount() == 3);
+	int nValue = 0;
+	CHECK(Index.Find(7, nValue) && nValue == 71);
+	CHECK(Index.Find(-1, nValue) && nValue == 10);
+	CHECK(Index.Find(0, nValue) && nValue == 0);
+	CHECK(!Index.Find(8, nValue));
+}
+
+//与std::map对照：大量键(含高位不同、低位相同的打包键)插入后逐个查找，装载因子始终不超过0.5
+static void TestGrowAgainstMap()
+{
+	CFlatHashIndex Index;
+	std::map<__int64,int> Expect;
+	unsigned __int64 nSeed = 12345;
+	int nOverLoad = 0;
+	for (int i=0; i<50000; i++)
+	{
+		nSeed = nSeed*6364136223846793005ULL + 1442695040888963407ULL;
+		__int64 nKey = (i%2) ? (__int64)nSeed : (((__int64)(i%97)<<32)|(DWORD)i);
+		Index.Insert(nKey, i);
+		Expect[nKey] = i;
+		if (Index.GetCount()*2 > Index.GetCapacity())
+		{
+			nOverLoad++;
+		}
+	}
+	CHECK(nOverLoad == 0);
+	CHECK(Index.GetCount() == (int)Expect.size());
+	int nMismatch = 0;
+	for (std::map<__int64,int>::const_iterator it=Expect.begin(); it!=Expect.end(); ++it)
+	{
+		int nValue = -1;
+		if (!Index.Find(it->first, nValue) || nValue != it->second)
+		{
+			nMismatch++;
+		}
+	}
+	CHECK(nMismatch == 0);
+	int nValue = 0;
+	CHECK(!Index.Find(((__int64)1000<<32)|5, nValue));
+}
+
+//清空后保留容量，可重新插入
+static void TestClear()
+{
+	CFlatHashIndex Index;
+	Index.Clear();
+	CHECK(Index.GetCount() == 0);
+	for (int i=0; i<100; i++)
+	{
+		Index.Insert(i, i);
+	}
+	int nCapacity = Index.GetCapacity();
+	Index.Clear();
+	int nValue = -1;
+	CHECK(Index.GetCount() == 0 && Index.GetCapacity() == nCapacity);
+	CHECK(!Index.Find(5, nValue));
+	CHECK(Index.Insert(5, 50) && Index.Find(5, nValue) && nValue == 50);
+}
+
+int main()
+{
+	TestEmpty();
+	TestInsertFind();
+	TestGrowAgainstMap();
+	TestClear();
+	return TEST_RESULT();
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+// 测试用的MFC类替代，只实现经stdafx.h替代编译的实现文件(如AsyncLog.cpp)用到的成员。
+// 文件用POSIX文件描述符实现，线程用pthread实现。
+
+#include "Win32Compat.h"
+
+#define THREAD_PRIORITY_NORMAL			0
+#define THREAD_PRIORITY_BELOW_NORMAL	(-1)
+#define CREATE_SUSPENDED				0x00000004
+
+#define TRY				try
+#define CATCH(cls, e)	catch (cls *e)
+#define END_CATCH
+
+class CFileException
+{
+};
+
+#define DECLARE_DYNCREATE(class_name)
+#define IMPLEMENT_DYNCREATE(class_name, base_class_name)
+#define DECLARE_MESSAGE_MAP()
+#define BEGIN_MESSAGE_MAP(theClass, baseClass)
+#define END_MESSAGE_MAP()
+
+class CTime
+{
+public:
+	CTime(const SYSTEMTIME &st) : m_st(st)
+	{
+		struct tm tmTime;
+		memset(&tmTime, 0, sizeof(tmTime));
+		tmTime.tm_year = st.wYear - 1900;
+		tmTime.tm_mon = st.wMonth - 1;
+		tmTime.tm_mday = st.wDay;
+		tmTime.tm_hour = st.wHour;
+		tmTime.tm_min = st.wMinute;
+		tmTime.tm_sec = st.wSecond;
+		tmTime.tm_isdst = -1;
+		m_t = mktime(&tmTime);
+	}
+	CTime(__time64_t t) : m_t(t)
+	{
+		time_t tt = (time_t)t;
+		struct tm tmTime;
+		localtime_r(&tt, &tmTime);
+		memset(&m_st, 0, sizeof(m_st));
+		m_st.wYear = tmTime.tm_year + 1900;
+		m_st.wMonth = tmTime.tm_mon + 1;
+		m_st.wDayOfWeek = tmTime.tm_wday;
+		m_st.wDay = tmTime.tm_mday;
+		m_st.wHour = tmTime.tm_hour;
+		m_st.wMinute = tmTime.tm_min;
+		m_st.wSecond = tmTime.tm_sec;
+	}
+	static CTime GetCurrentTime() { return CTime((__time64_t)time(NULL)); }
+	__time64_t GetTime() const { return m_t; }
+	int GetYear() const { return m_st.wYear; }
+	int GetMonth() const { return m_st.wMonth; }
+	int GetDay() const { return m_st.wDay; }
+	int GetHour() const { return m_st.wHour; }
+	int GetMinute() const { return m_st.wMinute; }
+	int GetSecond() const { return m_st.wSecond; }
+private:
+	SYSTEMTIME m_st;
+	__time64_t m_t;
+};
+
+//只保存年月日时分秒，不做日期运算
+class COleDateTime
+{
+public:
+	COleDateTime(int nYear, int nMonth, int nDay, int nHour, int nMin, int nSec)
+	{
+		m_nYear = nYear;
+		m_nMonth = nMonth;
+		m_nDay = nDay;
+		m_nHour = nHour;
+		m_nMinute = nMin;
+		m_nSecond = nSec;
+	}
+	int GetYear() const { return m_nYear; }
+	int GetMonth() const { return m_nMonth; }
+	int GetDay() const { return m_nDay; }
+	int GetHour() const { return m_nHour; }
+	int GetMinute() const { return m_nMinute; }
+	int GetSecond() const { return m_nSecond; }
+private:
+	int m_nYear, m_nMonth, m_nDay, m_nHour, m_nMinute, m_nSecond;
+};
+
+class CFile
+{
+public:
+	enum { hFileNull = -1 };
+	enum
+	{
+		modeReadWrite = 0x0002,
+		shareDenyNone = 0x0040,
+		modeCreate = 0x1000,
+		modeNoTruncate = 0x2000,
+	};
+
+	CFile() : m_hFile(hFileNull) {}
+	~CFile() { Close(); }
+
+	BOOL Open(LPCTSTR pFileName, UINT nOpenFlags)
+	{
+		int nFlags = O_RDWR;
+		if (nOpenFlags & modeCreate)
+		{
+			nFlags |= O_CREAT;
+			if (!(nOpenFlags & modeNoTruncate))
+			{
+				nFlags |= O_TRUNC;
+			}
+		}
+		m_hFile = open(ToPosixPath(pFileName).c_str(), nFlags, 0644);
+		return m_hFile != hFileNull;
+	}
+
+	void Write(const void *pBuf, UINT nCount)
+	{
+		const char *p = (const char*)pBuf;
+		while (nCount > 0)
+		{
+			ssize_t nWritten = write(m_hFile, p, nCount);
+			if (nWritten <= 0)
+			{
+				throw new CFileException;
+			}
+			p += nWritten;
+			nCount -= (UINT)nWritten;
+		}
+	}
+
+	//与FlushFileBuffers一样落到磁盘
+	void Flush()
+	{
+		fdatasync(m_hFile);
+	}
+
+	ULONGLONG SeekToEnd()
+	{
+		return (ULONGLONG)lseek(m_hFile, 0, SEEK_END);
+	}
+
+	void Close()
+	{
+		if (m_hFile != hFileNull)
+		{
+			close(m_hFile);
+			m_hFile = hFileNull;
+		}
+	}
+
+	int m_hFile;
+};
+
+//只支持不带通配符的完整路径
+class CFileFind
+{
+public:
+	BOOL FindFile(LPCTSTR pName)
+	{
+		return access(ToPosixPath(pName).c_str(), F_OK) == 0;
+	}
+	void Close() {}
+};
+
+typedef UINT (*AFX_THREADPROC)(LPVOID);
+
+//m_hThread为线程结束时置位的手动事件，可以用WaitForSingleObject等待。
+//派生类(如CAlarmBatchWriter)只在测试中直接调用其成员，不启动线程，m_hThread为NULL
+class CWinThread
+{
+public:
+	CWinThread()
+		: m_hThread(NULL), m_bAutoDelete(TRUE), m_pfnProc(NULL), m_pParam(NULL), m_bStarted(FALSE)
+	{
+	}
+
+	CWinThread(AFX_THREADPROC pfnProc, LPVOID pParam)
+		: m_hThread(CreateEvent(NULL, TRUE, FALSE, NULL)), m_bAutoDelete(TRUE),
+		m_pfnProc(pfnProc), m_pParam(pParam), m_bStarted(FALSE)
+	{
+	}
+
+	virtual ~CWinThread()
+	{
+		if (m_bStarted)
+		{
+			pthread_join(m_Thread, NULL);
+		}
+		CloseHandle(m_hThread);
+	}
+
+	virtual BOOL InitInstance() { return FALSE; }
+	virtual int ExitInstance() { return 0; }
+
+	DWORD ResumeThread()
+	{
+		if (!m_bStarted)
+		{
+			m_bStarted = pthread_create(&m_Thread, NULL, ThreadProc, this) == 0;
+		}
+		return 0;
+	}
+
+	HANDLE m_hThread;
+	BOOL m_bAutoDelete;
+
+private:
+	static void *ThreadProc(void *pParam)
+	{
+		CWinThread *pThread = (CWinThread*)pParam;
+		pThread->m_pfnProc(pThread->m_pParam);
+		SetEvent(pThread->m_hThread);
+		return NULL;
+	}
+
+	AFX_THREADPROC m_pfnProc;
+	LPVOID m_pParam;
+	pthread_t m_Thread;
+	BOOL m_bStarted;
+};
+
+//不支持m_bAutoDelete为TRUE时线程结束自动释放，调用者都在创建后改为FALSE
+inline CWinThread *AfxBeginThread(AFX_THREADPROC pfnProc, LPVOID pParam, int /*nPriority*/, UINT /*nStackSize*/, DWORD dwCreateFlags)
+{
+	CWinThread *pThread = new CWinThread(pfnProc, pParam);
+	if (!(dwCreateFlags & CREATE_SUSPENDED))
+	{
+		pThread->ResumeThread();
+	}
+	return pThread;
+}
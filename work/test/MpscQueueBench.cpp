@@ -0,0 +1,126 @@
+// MpscQueueBench.cpp : CMpscQueue与改造前"临界区+指针链表"在多生产者竞争下的吞吐对比
+//
+// 每轮nProducer个生产者各投递ITEMS_PER_PRODUCER个指针，一个消费者批量取出，
+// 统计从启动到消费者取完的耗时。加锁队列按原CPtrList用法：入队加锁AddTail，出队加锁RemoveHead。
+
+#include "Win32Compat.h"
+#include "../TSSampleDataSvr_new(920)/TSSampleDataSvr/MpscQueue.h"
+#include <pthread.h>
+#include <list>
+
+#define ITEMS_PER_PRODUCER	500000
+#define QUEUE_CAPACITY		65536
+#define POP_BATCH			256
+
+// 改造前的做法
+class CLockedPtrList
+{
+public:
+	CLockedPtrList() { InitializeCriticalSection(&m_cs); }
+	~CLockedPtrList() { DeleteCriticalSection(&m_cs); }
+
+	BOOL Push(void *pData)
+	{
+		EnterCriticalSection(&m_cs);
+		m_List.push_back(pData);
+		LeaveCriticalSection(&m_cs);
+		return TRUE;
+	}
+
+	int PopBatch(void **pData, int nMax)
+	{
+		int nCount = 0;
+		EnterCriticalSection(&m_cs);
+		while (nCount < nMax && !m_List.empty())
+		{
+			pData[nCount++] = m_List.front();
+			m_List.pop_front();
+		}
+		LeaveCriticalSection(&m_cs);
+		return nCount;
+	}
+
+private:
+	CRITICAL_SECTION m_cs;
+	std::list<void*> m_List;
+};
+
+template<class Q>
+struct BenchArg
+{
+	Q *pQueue;
+	volatile LONG *pStart;
+};
+
+template<class Q>
+static void *ProducerProc(void *pParam)
+{
+	BenchArg<Q> *pArg = (BenchArg<Q>*)pParam;
+	while (*pArg->pStart == 0)
+	{
+		sched_yield();
+	}
+	for (size_t i=1; i<=ITEMS_PER_PRODUCER; i++)
+	{
+		while (!pArg->pQueue->Push((void*)i))
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static double NowSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+//返回每秒出队个数
+template<class Q>
+static double RunBench(Q &Queue, int nProducer)
+{
+	volatile LONG nStart = 0;
+	BenchArg<Q> Arg = { &Queue, &nStart };
+	pthread_t Threads[64];
+	for (int i=0; i<nProducer; i++)
+	{
+		pthread_create(&Threads[i], NULL, ProducerProc<Q>, &Arg);
+	}
+	double dBegin = NowSeconds();
+	InterlockedExchange(&nStart, 1);
+	long long nTotal = (long long)nProducer*ITEMS_PER_PRODUCER;
+	long long nPopped = 0;
+	void *Items[POP_BATCH];
+	while (nPopped < nTotal)
+	{
+		int nCount = Queue.PopBatch(Items, POP_BATCH);
+		if (nCount == 0)
+		{
+			sched_yield();
+		}
+		nPopped += nCount;
+	}
+	double dElapsed = NowSeconds() - dBegin;
+	for (int i=0; i<nProducer; i++)
+	{
+		pthread_join(Threads[i], NULL);
+	}
+	return nTotal/dElapsed;
+}
+
+int main()
+{
+	static const int ProducerNum[] = { 1, 2, 4, 8 };
+	printf("%-10s %16s %16s %8s\n", "producers", "mutex+list/s", "mpsc/s", "ratio");
+	for (size_t i=0; i<_countof(ProducerNum); i++)
+	{
+		CLockedPtrList LockedList;
+		CMpscQueue<void*> MpscQueue(QUEUE_CAPACITY);
+		double dLocked = RunBench(LockedList, ProducerNum[i]);
+		double dMpsc = RunBench(MpscQueue, ProducerNum[i]);
+		printf("%-10d %16.0f %16.0f %8.2f\n", ProducerNum[i], dLocked, dMpsc, dMpsc/dLocked);
+	}
+	return 0;
+}
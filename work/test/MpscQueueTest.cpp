@@ -0,0 +1,216 @@
+// MpscQueueTest.cpp : CMpscQueue单线程语义和多生产者竞争下的正确性
+//
+
+#include "Win32Compat.h"
+#include "TestCommon.h"
+#include "../TSSampleDataSvr_new(920)/TSSampleDataSvr/MpscQueue.h"
+#include <pthread.h>
+#include <vector>
+
+#define PRODUCER_NUM		4
+#define ITEMS_PER_PRODUCER	200000
+
+struct ProducerArg
+{
+	CMpscQueue<DWORD> *pQueue;
+	DWORD nProducer;
+};
+
+static void *ProducerProc(void *pParam)
+{
+	ProducerArg *pArg = (ProducerArg*)pParam;
+	for (DWORD i=0; i<ITEMS_PER_PRODUCER; i++)
+	{
+		//高8位为生产者号，低24位为序号
+		while (!pArg->pQueue->Push((pArg->nProducer<<24)|i))
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void TestSingleThread()
+{
+	CMpscQueue<int> Queue(5);
+	CHECK(Queue.GetCapacity() == 8);
+	CHECK(Queue.GetSize() == 0);
+	int nValue = 0;
+	CHECK(!Queue.Pop(nValue));
+	for (int i=0; i<8; i++)
+	{
+		CHECK(Queue.Push(i));
+	}
+	CHECK(!Queue.Push(100));
+	CHECK(Queue.GetSize() == 8);
+	CHECK(Queue.GetHighWater() == 8);
+	CHECK(!Queue.PushWait(100, 10));
+	CHECK(Queue.GetDropped() == 1);
+
+	int Values[8];
+	CHECK(Queue.PopBatch(Values, 3) == 3);
+	CHECK(Values[0] == 0 && Values[1] == 1 && Values[2] == 2);
+	//环绕后继续按先进先出
+	for (int i=8; i<11; i++)
+	{
+		CHECK(Queue.Push(i));
+	}
+	CHECK(Queue.PopBatch(Values, 8) == 8);
+	for (int i=0; i<8; i++)
+	{
+		CHECK(Values[i] == i + 3);
+	}
+	CHECK(Queue.GetSize() == 0);
+}
+
+static void TestContention()
+{
+	CMpscQueue<DWORD> Queue(64);
+	pthread_t Threads[PRODUCER_NUM];
+	ProducerArg Args[PRODUCER_NUM];
+	for (DWORD n=0; n<PRODUCER_NUM; n++)
+	{
+		Args[n].pQueue = &Queue;
+		Args[n].nProducer = n;
+		pthread_create(&Threads[n], NULL, ProducerProc, &Args[n]);
+	}
+
+	//每个生产者的数据必须按序、不重不漏地出队
+	std::vector<DWORD> NextSeq(PRODUCER_NUM, 0);
+	DWORD nTotal = 0;
+	DWORD nDisorder = 0;
+	DWORD Batch[32];
+	while (nTotal < PRODUCER_NUM*ITEMS_PER_PRODUCER)
+	{
+		int nCount = Queue.PopBatch(Batch, 32);
+		if (nCount == 0)
+		{
+			sched_yield();
+			continue;
+		}
+		for (int i=0; i<nCount; i++)
+		{
+			DWORD nProducer = Batch[i]>>24;
+			DWORD nSeq = Batch[i]&0xFFFFFF;
+			if (nProducer >= PRODUCER_NUM || nSeq != NextSeq[nProducer])
+			{
+				nDisorder++;
+				continue;
+			}
+			NextSeq[nProducer]++;
+		}
+		nTotal += nCount;
+	}
+	for (DWORD n=0; n<PRODUCER_NUM; n++)
+	{
+		pthread_join(Threads[n], NULL);
+		CHECK(NextSeq[n] == ITEMS_PER_PRODUCER);
+	}
+	CHECK(nDisorder == 0);
+	CHECK(Queue.GetSize() == 0);
+	DWORD nExtra = 0;
+	CHECK(!Queue.Pop(nExtra));
+	CHECK(Queue.GetHighWater() <= Queue.GetCapacity());
+}
+
+struct TextRecord
+{
+	DWORD nId;
+	char szText[120];
+};
+
+static void *InPlaceProducerProc(void *pParam)
+{
+	CMpscQueue<TextRecord> *pQueue = (CMpscQueue<TextRecord>*)pParam;
+	static volatile LONG nNextProducer = 0;
+	DWORD nProducer = InterlockedIncrement(&nNextProducer) - 1;
+	for (DWORD i=0; i<ITEMS_PER_PRODUCER/4; i++)
+	{
+		LONG nPos = 0;
+		TextRecord *pRecord = NULL;
+		while ((pRecord = pQueue->BeginPush(nPos)) == NULL)
+		{
+			sched_yield();
+		}
+		pRecord->nId = (nProducer<<24)|i;
+		snprintf(pRecord->szText, sizeof(pRecord->szText), "%u", pRecord->nId);
+		pQueue->CommitPush(nPos);
+	}
+	return NULL;
+}
+
+//原地入队/出队：未提交的槽挡住后面已提交的槽；多生产者下正文完整、按序
+static void TestInPlace()
+{
+	CMpscQueue<TextRecord> Queue(4);
+	CHECK(Queue.Front() == NULL);
+	LONG nPos1 = 0, nPos2 = 0;
+	TextRecord *pFirst = Queue.BeginPush(nPos1);
+	TextRecord *pSecond = Queue.BeginPush(nPos2);
+	CHECK(pFirst != NULL && pSecond != NULL && pFirst != pSecond);
+	strcpy(pSecond->szText, "second");
+	Queue.CommitPush(nPos2);
+	CHECK(Queue.Front() == NULL);
+	strcpy(pFirst->szText, "first");
+	Queue.CommitPush(nPos1);
+	CHECK(Queue.Front() != NULL && strcmp(Queue.Front()->szText, "first") == 0);
+	Queue.PopFront();
+	CHECK(Queue.Front() != NULL && strcmp(Queue.Front()->szText, "second") == 0);
+	Queue.PopFront();
+	CHECK(Queue.Front() == NULL);
+	for (int i=0; i<4; i++)
+	{
+		LONG nPos = 0;
+		CHECK(Queue.BeginPush(nPos) != NULL);
+		Queue.CommitPush(nPos);
+	}
+	LONG nPos = 0;
+	CHECK(Queue.BeginPush(nPos) == NULL);
+	CHECK(Queue.GetHighWater() == 4);
+
+	CMpscQueue<TextRecord> Shared(64);
+	pthread_t Threads[PRODUCER_NUM];
+	for (int n=0; n<PRODUCER_NUM; n++)
+	{
+		pthread_create(&Threads[n], NULL, InPlaceProducerProc, &Shared);
+	}
+	std::vector<DWORD> NextSeq(PRODUCER_NUM, 0);
+	DWORD nBad = 0;
+	for (DWORD nTotal=0; nTotal<PRODUCER_NUM*ITEMS_PER_PRODUCER/4; )
+	{
+		TextRecord *pRecord = Shared.Front();
+		if (pRecord == NULL)
+		{
+			sched_yield();
+			continue;
+		}
+		char szExpect[sizeof(pRecord->szText)];
+		snprintf(szExpect, sizeof(szExpect), "%u", pRecord->nId);
+		DWORD nProducer = pRecord->nId>>24;
+		if (nProducer >= PRODUCER_NUM || (pRecord->nId&0xFFFFFF) != NextSeq[nProducer] || strcmp(pRecord->szText, szExpect) != 0)
+		{
+			nBad++;
+		}
+		else
+		{
+			NextSeq[nProducer]++;
+		}
+		Shared.PopFront();
+		nTotal++;
+	}
+	for (int n=0; n<PRODUCER_NUM; n++)
+	{
+		pthread_join(Threads[n], NULL);
+		CHECK(NextSeq[n] == ITEMS_PER_PRODUCER/4);
+	}
+	CHECK(nBad == 0);
+	CHECK(Shared.Front() == NULL);
+}
+
+int main()
+{
+	TestSingleThread();
+	TestContention();
+	TestInPlace();
+	return TEST_RESULT();
+}
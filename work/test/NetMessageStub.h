@@ -0,0 +1,95 @@
+#pragma once
+
+// 测试用的协议结构替代。真实定义在NetMessage.h/SOCKETDEF.H中(不在本仓库)，
+// 这里只声明被测头文件用到的字段，按1字节对齐。
+
+#define NET_MESSAGE_RETRECORDOFTB	0x0105
+#define NET_MESSAGE_UPDATARECORD	0x0106
+#define NET_MESSAGE_ACK				0x0001
+#define NET_MESSAGE_ACK_OK			0
+#define UPDATARECORD_TYPE_UPDATA	1
+
+#define SOCKET_MSG_GROUP_YXDATA			0x21
+#define SOCKET_MSG_GROUP_YMDATA_EX_DATE	0x88
+#define SOCKET_MSG_PREPAYRECORD			0x90
+
+#pragma pack(push, 1)
+
+struct NetMessageHead
+{
+	WORD MessageType;
+	DWORD Length;
+};
+
+struct MessageRetRecordHead
+{
+	char FieldName[32];
+	WORD DataType;
+	DWORD DataLen;
+};
+
+struct UpdataRecordStruct
+{
+	WORD TableNo;
+	BYTE ColFlag[256];
+	BYTE UpdataType;
+	DWORD RecordLen;
+	BYTE RecordData[1];
+};
+
+struct MessageAck
+{
+	WORD wdAckType;
+};
+
+struct SocketMsgHead
+{
+	BYTE btType;
+	WORD wdLen;
+	DWORD dwSyncCode;
+};
+
+struct SocketGroupYxUnit
+{
+	WORD wdYxNo;
+	BYTE btYxValue;
+};
+
+struct SocketMsgGroupYxEx
+{
+	BYTE btRtuNo;
+	BYTE btForeNo;
+	WORD wdYxNum;
+	SocketGroupYxUnit YxUnit[1];
+};
+
+struct SocketGroupYmUnitEx
+{
+	WORD wdYmNo;
+	DWORD dwYmValue;
+	BYTE btTime[7];
+};
+
+struct SocketMsgGroupYmDataEx_DATE
+{
+	BYTE btRtuNo;
+	BYTE btForeNo;
+	WORD wdYmNum;
+	SocketGroupYmUnitEx YmUnitEx[1];
+};
+
+struct SocketPrepayRecordUnit
+{
+	DWORD dwRecordNo;
+	double dMoney;
+};
+
+struct SocketMsgPrepayRecord
+{
+	BYTE btForeNo;
+	BYTE btRtuNo;
+	WORD wdYjNum;
+	SocketPrepayRecordUnit prUnit[1];
+};
+
+#pragma pack(pop)
@@ -0,0 +1,96 @@
+// PayReconBench.cpp : 5万台设备的充值记录对账，统计分批拼语句、解析应答和判断的耗时
+//
+// 每台设备购电次数1~60次，七成记录齐全，其余零星或大段缺失。假表按语句现算COUNT和位图，耗时单独列出，
+// 相当于实时库执行查询的时间；对照为改造前每台设备一条查询语句、按[COUNT]倒序判断。
+
+#include "FakePayRecord.h"
+#include <time.h>
+
+#define BENCH_DEV_NUM		50000
+#define BENCH_ROUNDS		5
+#define BENCH_BATCH_DEVICES	500		//与PAYRECON_BATCH_DEVICES相同
+
+static double NowSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+int main()
+{
+	FakePayRecordTable Table;
+	std::vector<PayReconItem> vecItem(BENCH_DEV_NUM);
+	unsigned int nSeed = 11;
+	for (int d=0; d<BENCH_DEV_NUM; d++)
+	{
+		PayReconItem &iItem = vecItem[d];
+		memset(&iItem, 0, sizeof(iItem));
+		iItem.iDevId = 100000 + d;
+		iItem.MaxBuyNum = 1 + rand_r(&nSeed)%60;
+		std::vector<int> &vecCount = Table[iItem.iDevId];
+		int nKind = rand_r(&nSeed)%10;
+		for (int c=1; c<=iItem.MaxBuyNum; c++)
+		{
+			if (nKind < 7 || (nKind < 9 && rand_r(&nSeed)%8 != 0) || rand_r(&nSeed)%2 != 0)
+			{
+				vecCount.push_back(c);
+			}
+		}
+	}
+
+	double dBuild = 0, dQuery = 0, dEvaluate = 0;
+	int nBatches = 0;
+	for (int r=0; r<BENCH_ROUNDS; r++)
+	{
+		for (int nBegin=0; nBegin<BENCH_DEV_NUM; nBegin+=BENCH_BATCH_DEVICES)
+		{
+			int nItems = BENCH_DEV_NUM - nBegin < BENCH_BATCH_DEVICES ? BENCH_DEV_NUM - nBegin : BENCH_BATCH_DEVICES;
+			double dBegin = NowSeconds();
+			CString strQuery;
+			CPayReconRule::BuildQuery(strQuery, &vecItem[nBegin], nItems);
+			double dBuilt = NowSeconds();
+			BYTE *pRead = FakePayReconQuery(Table, strQuery);
+			double dQueried = NowSeconds();
+			CRecordSetReader rs;
+			if (rs.Attach(pRead, CRecordSetReader::GetReplyLen(pRead), 3))
+			{
+				CPayReconRule::Evaluate(rs, &vecItem[nBegin], nItems);
+			}
+			delete[] pRead;
+			dBuild += dBuilt - dBegin;
+			dQuery += dQueried - dBuilt;
+			dEvaluate += NowSeconds() - dQueried;
+			nBatches += r == 0;
+		}
+	}
+
+	//对照：每台设备拼一条查询语句，按倒序记录判断
+	double dBegin = NowSeconds();
+	int nMismatch = 0, nCall = 0;
+	for (int r=0; r<BENCH_ROUNDS; r++)
+	{
+		for (int d=0; d<BENCH_DEV_NUM; d++)
+		{
+			CString strQuery;
+			strQuery.Format(_T("select [COUNT] from TE_PAYMENT_PAYRECORD where DEVICEID=%d and [COUNT]>0 and [COUNT]<= %d order by [COUNT] desc;"),
+				vecItem[d].iDevId, vecItem[d].MaxBuyNum);
+			int nLegacy = LegacyCallNum(Table[vecItem[d].iDevId], vecItem[d].MaxBuyNum);
+			if (r == 0)
+			{
+				nMismatch += nLegacy != vecItem[d].CallNum;
+				nCall += nLegacy > 0;
+			}
+		}
+	}
+	double dLegacy = NowSeconds() - dBegin;
+
+	printf("devices=%d recall devices=%d\n", BENCH_DEV_NUM, nCall);
+	printf("batched: %d statements (%d devices each)\n", nBatches, BENCH_BATCH_DEVICES);
+	printf("  build sql      %8.2f ms\n", dBuild*1e3/BENCH_ROUNDS);
+	printf("  fake table     %8.2f ms (stands in for the database)\n", dQuery*1e3/BENCH_ROUNDS);
+	printf("  evaluate       %8.2f ms (%.0f ns/device)\n", dEvaluate*1e3/BENCH_ROUNDS, dEvaluate*1e9/BENCH_ROUNDS/BENCH_DEV_NUM);
+	printf("per device: %d statements\n", BENCH_DEV_NUM);
+	printf("  build + judge  %8.2f ms, plus one pipe round trip per device\n", dLegacy*1e3/BENCH_ROUNDS);
+	return nMismatch == 0 ? 0 : 1;
+}
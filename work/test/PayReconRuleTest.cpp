@@ -0,0 +1,167 @@
+// PayReconRuleTest.cpp : 充值记录对账的招测条数判断和批量查询，充值记录表用进程内的假实现代替
+//
+
+#include "FakePayRecord.h"
+#include "TestCommon.h"
+
+//购电次数nMax，最近10次中除pMissing所列(购电次数-i中的i)外都有记录的位图
+static DWORD RecentMask(int nMax, const int *pMissing, int nMissing)
+{
+	DWORD dwMask = 0;
+	for (int i=0; i<nMax && i<PAYRECON_CALL_MAX; i++)
+	{
+		dwMask |= (DWORD)1 << i;
+	}
+	for (int k=0; k<nMissing; k++)
+	{
+		dwMask &= ~((DWORD)1 << pMissing[k]);
+	}
+	return dwMask;
+}
+
+//一条记录都没有：招最近PAYRECON_CALL_MAX条，购电次数更少时全招
+static void TestNoRecords()
+{
+	CHECK(CPayReconRule::CalcCallNum(1, 0, 0) == 1);
+	CHECK(CPayReconRule::CalcCallNum(3, 0, 0) == 3);
+	CHECK(CPayReconRule::CalcCallNum(PAYRECON_CALL_MAX, 0, 0) == PAYRECON_CALL_MAX);
+	CHECK(CPayReconRule::CalcCallNum(PAYRECON_CALL_MAX + 1, 0, 0) == PAYRECON_CALL_MAX);
+	CHECK(CPayReconRule::CalcCallNum(500, 0, 0) == PAYRECON_CALL_MAX);
+}
+
+//记录齐全不招；记录数多于购电次数(有重复记录)也按齐全处理
+static void TestComplete()
+{
+	CHECK(CPayReconRule::CalcCallNum(1, 1, 0x1) == 0);
+	CHECK(CPayReconRule::CalcCallNum(10, 10, RecentMask(10, NULL, 0)) == 0);
+	CHECK(CPayReconRule::CalcCallNum(200, 200, RecentMask(200, NULL, 0)) == 0);
+	CHECK(CPayReconRule::CalcCallNum(5, 7, 0x1F) == 0);
+	//计数已齐时不看位图
+	CHECK(CPayReconRule::CalcCallNum(20, 20, 0) == 0);
+}
+
+//缺的超过PAYRECON_CALL_MAX条不招，正好缺PAYRECON_CALL_MAX条时仍按位图招
+static void TestTooManyMissing()
+{
+	CHECK(CPayReconRule::CalcCallNum(30, 30 - PAYRECON_CALL_MAX - 1, 0) == 0);
+	CHECK(CPayReconRule::CalcCallNum(100, 1, 0) == 0);
+	CHECK(CPayReconRule::CalcCallNum(30, 30 - PAYRECON_CALL_MAX, 0) == PAYRECON_CALL_MAX);
+	int nMissing[] = {2};
+	CHECK(CPayReconRule::CalcCallNum(30, 30 - PAYRECON_CALL_MAX, RecentMask(30, nMissing, 1)) == 3);
+}
+
+//有缺口：招到最近10次中最早缺的那一次为止，更早的缺口不招
+static void TestGaps()
+{
+	int nLatest[] = {0};
+	CHECK(CPayReconRule::CalcCallNum(20, 19, RecentMask(20, nLatest, 1)) == 1);
+	int nOldest[] = {PAYRECON_CALL_MAX - 1};
+	CHECK(CPayReconRule::CalcCallNum(20, 19, RecentMask(20, nOldest, 1)) == PAYRECON_CALL_MAX);
+	int nTwo[] = {1, 6};
+	CHECK(CPayReconRule::CalcCallNum(20, 18, RecentMask(20, nTwo, 2)) == 7);
+	//缺的是最近10次之前的，不招
+	CHECK(CPayReconRule::CalcCallNum(20, 15, RecentMask(20, NULL, 0)) == 0);
+	//位图中超出最近10次的位不影响结果
+	CHECK(CPayReconRule::CalcCallNum(20, 19, RecentMask(20, nLatest, 1) | 0xFFFFFC00) == 1);
+	//购电次数不足10次时只看前购电次数位
+	int nSmall[] = {2};
+	CHECK(CPayReconRule::CalcCallNum(5, 4, RecentMask(5, nSmall, 1)) == 3);
+	CHECK(CPayReconRule::CalcCallNum(3, 2, 0x3) == 3);
+}
+
+//经假管道批量查询：结果与改造前逐台查询的判断一致
+static void TestBatchAgainstLegacy()
+{
+	FakePayRecordTable Table;
+	std::vector<PayReconItem> vecItem;
+	unsigned int nSeed = 3;
+	for (int d=0; d<2000; d++)
+	{
+		PayReconItem iItem;
+		memset(&iItem, 0, sizeof(iItem));
+		iItem.iDevId = 1000 + d*7;
+		iItem.MaxBuyNum = 1 + rand_r(&nSeed)%40;
+		iItem.CallNum = -1;
+		std::vector<int> &vecCount = Table[iItem.iDevId];
+		int nKind = rand_r(&nSeed)%4;
+		for (int c=1; c<=iItem.MaxBuyNum + 2; c++)
+		{
+			//齐全、全无、零星缺失、大段缺失；还有超出购电次数的记录
+			BOOL bHave = nKind == 0 || (nKind == 2 && rand_r(&nSeed)%6 != 0) || (nKind == 3 && rand_r(&nSeed)%2 != 0);
+			if (bHave || c > iItem.MaxBuyNum)
+			{
+				vecCount.push_back(c);
+			}
+		}
+		vecCount.push_back(0);
+		vecItem.push_back(iItem);
+	}
+	int nMatched = 0;
+	for (int nBegin=0; nBegin<(int)vecItem.size(); nBegin+=500)
+	{
+		nMatched += FakePayReconBatch(Table, &vecItem[nBegin], 500);
+	}
+	CHECK(nMatched == (int)vecItem.size());
+	int nMismatch = 0, nCall = 0;
+	for (size_t i=0; i<vecItem.size(); i++)
+	{
+		nMismatch += vecItem[i].CallNum != LegacyCallNum(Table[vecItem[i].iDevId], vecItem[i].MaxBuyNum);
+		nCall += vecItem[i].CallNum > 0;
+	}
+	CHECK(nMismatch == 0);
+	CHECK(nCall > 0 && nCall < (int)vecItem.size());
+}
+
+//同一次购电有重复记录时：位图按购电次数去重，不会把最近10次内的记录挤出去
+static void TestDuplicateRecords()
+{
+	FakePayRecordTable Table;
+	std::vector<int> &vecCount = Table[1];
+	vecCount.push_back(15);
+	vecCount.push_back(15);
+	vecCount.push_back(15);
+	for (int c=6; c<=14; c++)
+	{
+		vecCount.push_back(c);
+	}
+	PayReconItem iItem;
+	memset(&iItem, 0, sizeof(iItem));
+	iItem.iDevId = 1;
+	iItem.MaxBuyNum = 15;
+	CHECK(FakePayReconBatch(Table, &iItem, 1) == 1);
+	//6..15都有，缺的1..5在最近10次之前；原来按倒序只看前10条，会把7、6当成缺失而招10条
+	CHECK(iItem.CallNum == 0);
+	CHECK(LegacyCallNum(vecCount, 15) == PAYRECON_CALL_MAX);
+}
+
+//应答中没有的设备不改动，语句不认识时整批失败
+static void TestReplyMismatch()
+{
+	FakePayRecordTable Table;
+	PayReconItem iItem[2];
+	memset(iItem, 0, sizeof(iItem));
+	iItem[0].iDevId = 5;
+	iItem[0].MaxBuyNum = 3;
+	iItem[1].iDevId = 6;
+	iItem[1].MaxBuyNum = 4;
+	iItem[1].CallNum = -1;
+	CHECK(FakePayReconBatch(Table, iItem, 1) == 1);
+	CHECK(iItem[0].CallNum == 3 && iItem[1].CallNum == -1);
+
+	CString strQuery;
+	CPayReconRule::BuildQuery(strQuery, iItem, 2);
+	CHECK(strstr(strQuery, "(VALUES (5,3),(6,4)) AS v(D,M)") != NULL);
+	CHECK(FakePayReconQuery(Table, "SELECT 1;") == NULL);
+}
+
+int main()
+{
+	TestNoRecords();
+	TestComplete();
+	TestTooManyMissing();
+	TestGaps();
+	TestBatchAgainstLegacy();
+	TestDuplicateRecords();
+	TestReplyMismatch();
+	return TEST_RESULT();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// 遥信/遥脉点定义的替代，字段名与PublicStruct.h一致，类型和长度不影响被测逻辑。
+// YxConfigDef按自然对齐也没有填充字节，逐字段写入的记录与结构体逐字节相同
+struct YxConfigDef
+{
+	int nYxIndex;
+	int nProjectNo;
+	int nStationNo;
+	int nDeviceNo;
+	int nYxNum;
+	char cYxName[16];
+	char cDescription[16];
+	BYTE bYxRaw;
+	BYTE bYxType;
+	BYTE bYxValue;
+	BYTE bIdentifier;
+	int nCountExchange;
+	int nCountTrip;
+	int nAlarmType;
+	int nAlarmLevel;
+	int nYxProp;
+};
+
+struct YmConfigDef
+{
+	int nYmIndex;
+	int nProjectNo;
+	int nStationNo;
+	int nDeviceNo;
+	int nYmNum;
+	char cYmName[16];
+	char cDescription[16];
+	__int64 nYmRaw;
+	double dYmQuotiety;
+	double dYmValue;
+	BYTE bIdentifier;
+};
+
+//告警索引记录
+struct AlarmItemDef
+{
+	TCHAR alarmID[64];
+	int groupID1;
+	int groupID2;
+	int alarmType;
+	TCHAR alarmTypeName[128];
+	int alarmLevel;
+	TCHAR alarmSource[128];
+	int alarmObjType;
+	int projectID;
+	int systemID;
+	int alarmObjID;
+	int devID;
+	int stationID;
+	TCHAR alarmObjName[128];
+	TCHAR devName[65];
+	TCHAR stationName[128];
+	TCHAR alarmContent[512];
+	TCHAR projectName[128];
+	int rtAlarm;
+	int status;
+	__time64_t alarmTime;
+	__time64_t contentTime;
+	int reserve1;
+	int reserve2;
+	float reserve3;
+	float reserve4;
+	TCHAR reserve5[128];
+	TCHAR reserve6[128];
+};
@@ -0,0 +1,147 @@
+// ReadEpochTest.cpp : CReadEpoch的等待语义，以及按CRedisRecvSample的方式并发查找与重建发布CDevLookupIndex
+//
+
+#include "stdafx.h"
+#include "TestCommon.h"
+#include "YmLookupIndex.h"
+#include "ReadEpoch.h"
+
+#define READER_NUM		4
+#define RELOAD_NUM		300
+#define DEV_NUM			2000
+#define BENCH_RTU		1
+
+struct SyncArg
+{
+	CReadEpoch *pEpoch;
+	volatile LONG nDone;
+};
+
+static void *SyncProc(void *pParam)
+{
+	SyncArg *pArg = (SyncArg*)pParam;
+	pArg->pEpoch->Synchronize();
+	InterlockedExchange(&pArg->nDone, 1);
+	return NULL;
+}
+
+//旧纪元的读者未退出时Synchronize不返回；新纪元的读者不挡Synchronize
+static void TestSynchronizeWaits()
+{
+	CReadEpoch Epoch;
+	Epoch.Synchronize();
+
+	LONG nIdx = Epoch.ReadLock();
+	SyncArg Arg = { &Epoch, 0 };
+	pthread_t Thread;
+	pthread_create(&Thread, NULL, SyncProc, &Arg);
+	Sleep(50);
+	CHECK(Arg.nDone == 0);
+	//翻转后登记的读者属于新纪元
+	LONG nNewIdx = Epoch.ReadLock();
+	CHECK(nNewIdx != nIdx);
+	Epoch.ReadUnlock(nIdx);
+	pthread_join(Thread, NULL);
+	CHECK(Arg.nDone == 1);
+	Epoch.ReadUnlock(nNewIdx);
+	Epoch.Synchronize();
+}
+
+//第nGen份设备表：前置设备号n对应设备ID nGen*100000+n
+static CDevLookupIndex *BuildDevIndex(int nGen)
+{
+	DeviceRecordDefMap DevMap;
+	CString strKey;
+	for (int n=0; n<DEV_NUM; n++)
+	{
+		strKey.Format(_T("%d+%d"), BENCH_RTU, n);
+		DevMap[strKey] = nGen*100000 + n;
+	}
+	CDevLookupIndex *pIndex = new CDevLookupIndex;
+	pIndex->Build(DevMap);
+	return pIndex;
+}
+
+struct ReloadShared
+{
+	CReadEpoch Epoch;
+	CDevLookupIndex * volatile pDevIndex;
+	volatile LONG bStop;
+	volatile LONG nLookups;
+	volatile LONG nErrors;
+};
+
+//读者：一次读区间内用同一份快照解析一组设备号，结果必须都来自同一代且不缺
+static void *ReaderProc(void *pParam)
+{
+	ReloadShared *pShared = (ReloadShared*)pParam;
+	int DevNo[16];
+	int DevId[16];
+	unsigned int nSeed = (unsigned int)(size_t)&DevNo;
+	while (!pShared->bStop)
+	{
+		for (int i=0; i<16; i++)
+		{
+			DevNo[i] = rand_r(&nSeed)%DEV_NUM;
+		}
+		LONG nIdx = pShared->Epoch.ReadLock();
+		CDevLookupIndex *pIndex = pShared->pDevIndex;
+		int nFound = pIndex->GetDevIds(BENCH_RTU, DevNo, 16, DevId);
+		int nDevId = 0;
+		BOOL bFound = pIndex->GetDevId(BENCH_RTU, DevNo[0], nDevId);
+		pShared->Epoch.ReadUnlock(nIdx);
+
+		BOOL bOk = nFound == 16 && bFound && nDevId == DevId[0];
+		for (int i=0; i<16 && bOk; i++)
+		{
+			bOk = DevId[i]%100000 == DevNo[i] && DevId[i]/100000 == DevId[0]/100000;
+		}
+		if (!bOk)
+		{
+			InterlockedIncrement(&pShared->nErrors);
+		}
+		InterlockedIncrement(&pShared->nLookups);
+	}
+	return NULL;
+}
+
+//发布者：换上新快照，Synchronize后先把旧快照清空再释放，读者若还在旧快照上会查不到而计错
+static void TestLookupVsReload()
+{
+	ReloadShared Shared;
+	Shared.pDevIndex = BuildDevIndex(1);
+	Shared.bStop = 0;
+	Shared.nLookups = 0;
+	Shared.nErrors = 0;
+	pthread_t Threads[READER_NUM];
+	for (int i=0; i<READER_NUM; i++)
+	{
+		pthread_create(&Threads[i], NULL, ReaderProc, &Shared);
+	}
+	DeviceRecordDefMap EmptyMap;
+	for (int nGen=2; nGen<RELOAD_NUM+2; nGen++)
+	{
+		CDevLookupIndex *pNewIndex = BuildDevIndex(nGen);
+		CDevLookupIndex *pOldIndex = (CDevLookupIndex*)InterlockedExchangePointer((PVOID volatile*)&Shared.pDevIndex, pNewIndex);
+		Shared.Epoch.Synchronize();
+		pOldIndex->Build(EmptyMap);
+		delete pOldIndex;
+	}
+	InterlockedExchange(&Shared.bStop, 1);
+	for (int i=0; i<READER_NUM; i++)
+	{
+		pthread_join(Threads[i], NULL);
+	}
+	CHECK(Shared.nLookups > 0);
+	CHECK(Shared.nErrors == 0);
+	int nDevId = 0;
+	CHECK(Shared.pDevIndex->GetDevId(BENCH_RTU, 7, nDevId) && nDevId == (RELOAD_NUM+1)*100000 + 7);
+	delete Shared.pDevIndex;
+}
+
+int main()
+{
+	TestSynchronizeWaits();
+	TestLookupVsReload();
+	return TEST_RESULT();
+}
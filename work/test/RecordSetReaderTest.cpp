@@ -0,0 +1,178 @@
+// RecordSetReaderTest.cpp : CRecordSetReader对合法报文的读取和对截断、越界报文的拒绝
+//
+
+#include "Win32Compat.h"
+#include "NetMessageStub.h"
+#include "TestCommon.h"
+#include "../../inc/RecordSetReader.h"
+#include <vector>
+
+#define NAME_LEN	8
+
+//构造一个两字段(DWORD编号, char[NAME_LEN]名称)的返回报文，头中Length按不含消息头计
+static std::vector<BYTE> BuildReply(int nRecordNum)
+{
+	DWORD dwRecordLen = sizeof(DWORD) + NAME_LEN;
+	std::vector<BYTE> vecBuf(sizeof(NetMessageHead) + sizeof(WORD) + sizeof(MessageRetRecordHead)*2
+		+ sizeof(DWORD)*2 + dwRecordLen*nRecordNum);
+	BYTE *pByte = &vecBuf[0];
+	NetMessageHead *pHead = (NetMessageHead*)pByte;
+	pHead->MessageType = NET_MESSAGE_RETRECORDOFTB;
+	pHead->Length = (DWORD)(vecBuf.size() - sizeof(NetMessageHead));
+	pByte += sizeof(NetMessageHead);
+	*(WORD*)pByte = 2;
+	pByte += sizeof(WORD);
+	MessageRetRecordHead *pField = (MessageRetRecordHead*)pByte;
+	pField[0].DataLen = sizeof(DWORD);
+	pField[1].DataLen = NAME_LEN;
+	pByte += sizeof(MessageRetRecordHead)*2;
+	*(DWORD*)pByte = dwRecordLen;
+	pByte += sizeof(DWORD);
+	*(DWORD*)pByte = (DWORD)nRecordNum;
+	pByte += sizeof(DWORD);
+	for (int i=0; i<nRecordNum; i++)
+	{
+		*(DWORD*)pByte = 100 + i;
+		//名称占满字段，不以0结尾
+		memset(pByte + sizeof(DWORD), 'a' + i, NAME_LEN);
+		pByte += dwRecordLen;
+	}
+	return vecBuf;
+}
+
+//记录数和记录长度所在位置
+static DWORD *RecordLenOf(std::vector<BYTE> &vecBuf)
+{
+	return (DWORD*)&vecBuf[sizeof(NetMessageHead) + sizeof(WORD) + sizeof(MessageRetRecordHead)*2];
+}
+
+static void TestValid()
+{
+	std::vector<BYTE> vecBuf = BuildReply(3);
+	CRecordSetReader rs;
+	CHECK(CRecordSetReader::GetReplyLen(&vecBuf[0]) == vecBuf.size());
+	CHECK(rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+	CHECK(rs.GetFieldNum() == 2);
+	CHECK(rs.GetRecordNum() == 3);
+	int nIndex = 0;
+	BOOL bValuesOk = TRUE;
+	while (rs.NextRecord())
+	{
+		TCHAR szName[NAME_LEN + 1];
+		rs.GetString(1, szName, _countof(szName));
+		CString strName;
+		rs.GetString(1, strName);
+		if (rs.GetInt(0) != 100 + nIndex || strlen(szName) != NAME_LEN || szName[0] != 'a' + nIndex
+			|| strName.GetLength() != NAME_LEN)
+		{
+			bValuesOk = FALSE;
+		}
+		nIndex++;
+	}
+	CHECK(bValuesOk);
+	CHECK(nIndex == 3);
+	CHECK(!rs.NextRecord());
+
+	//目标缓冲区比字段短时截断并以0结尾
+	rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2);
+	rs.NextRecord();
+	TCHAR szShort[4];
+	rs.GetString(1, szShort, _countof(szShort));
+	CHECK(strcmp(szShort, "aaa") == 0);
+	//越界字段号
+	int nLen = -1;
+	CHECK(rs.GetField(2, nLen) == NULL && nLen == 0);
+	CHECK(rs.GetInt(-1) == 0);
+
+	//没有记录的结果集
+	std::vector<BYTE> vecEmpty = BuildReply(0);
+	CHECK(rs.Attach(&vecEmpty[0], (DWORD)vecEmpty.size(), 2));
+	CHECK(rs.GetRecordNum() == 0);
+	CHECK(!rs.NextRecord());
+}
+
+//每个截断长度都拷贝到恰好这么大的缓冲区再解析，越界读能被内存检查工具发现
+static void TestTruncated()
+{
+	std::vector<BYTE> vecBuf = BuildReply(3);
+	CRecordSetReader rs;
+	int nAccepted = 0;
+	for (DWORD dwLen=0; dwLen<vecBuf.size(); dwLen++)
+	{
+		BYTE *pCopy = new BYTE[dwLen > 0 ? dwLen : 1];
+		memcpy(pCopy, &vecBuf[0], dwLen);
+		if (rs.Attach(pCopy, dwLen, 2))
+		{
+			nAccepted++;
+		}
+		delete [] pCopy;
+	}
+	CHECK(nAccepted == 0);
+	CHECK(rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+	CHECK(!rs.Attach(NULL, 100, 2));
+}
+
+static void TestMalformed()
+{
+	CRecordSetReader rs;
+	//消息类型不符
+	std::vector<BYTE> vecBuf = BuildReply(2);
+	((NetMessageHead*)&vecBuf[0])->MessageType = NET_MESSAGE_RETRECORDOFTB + 1;
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+
+	//字段数与期望不符，或超出上限
+	vecBuf = BuildReply(2);
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 3));
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 0));
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), RECORDSET_MAX_FIELDS + 1));
+
+	//各字段长度之和超过记录长度
+	vecBuf = BuildReply(2);
+	((MessageRetRecordHead*)&vecBuf[sizeof(NetMessageHead) + sizeof(WORD)])[1].DataLen = NAME_LEN + 1;
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+
+	//字段长度之和溢出DWORD
+	vecBuf = BuildReply(2);
+	((MessageRetRecordHead*)&vecBuf[sizeof(NetMessageHead) + sizeof(WORD)])[0].DataLen = 0xFFFFFFF0;
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+
+	//记录长度为0
+	vecBuf = BuildReply(2);
+	RecordLenOf(vecBuf)[0] = 0;
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+
+	//记录数超出报文，包括乘积溢出32位的情况
+	vecBuf = BuildReply(2);
+	RecordLenOf(vecBuf)[1] = 3;
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+	RecordLenOf(vecBuf)[1] = 0xFFFFFFFF;
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+	RecordLenOf(vecBuf)[0] = 0x10000;
+	RecordLenOf(vecBuf)[1] = 0x10000;
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+
+	//消息头声称的长度比实际收到的长：按收到的字节数拒绝
+	vecBuf = BuildReply(2);
+	((NetMessageHead*)&vecBuf[0])->Length += 1000;
+	RecordLenOf(vecBuf)[1] = 50;
+	CHECK(!rs.Attach(&vecBuf[0], (DWORD)vecBuf.size(), 2));
+
+	//消息头长度超过上限时GetReplyLen返回0，Attach随之失败
+	vecBuf = BuildReply(2);
+	((NetMessageHead*)&vecBuf[0])->Length = RECORDSET_MAX_REPLY_LEN + 1;
+	CHECK(CRecordSetReader::GetReplyLen(&vecBuf[0]) == 0);
+	CHECK(!rs.Attach(&vecBuf[0], CRecordSetReader::GetReplyLen(&vecBuf[0]), 2));
+	CHECK(CRecordSetReader::GetReplyLen(NULL) == 0);
+
+	//失败后游标处于未绑定状态
+	CHECK(!rs.NextRecord());
+	CHECK(rs.GetRecordNum() == 0);
+}
+
+int main()
+{
+	TestValid();
+	TestTruncated();
+	TestMalformed();
+	return TEST_RESULT();
+}
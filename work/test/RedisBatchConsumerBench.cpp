@@ -0,0 +1,277 @@
+// RedisBatchConsumerBench.cpp : 本机redis-server上CRedisBatchConsumer的取数吞吐和消息延迟
+//
+// 启动一个临时redis-server(默认../redis_Chinese_notated_3.0/src/redis-server，可用环境变量REDIS_SERVER指定)，
+// 生产者线程用另一条连接流水线RPUSH，消息头8字节为入队时刻；消费者按处理线程的用法PopBatch/ReleaseBatch。
+// 每种批量大小跑两轮：不限速灌入统计每秒取出条数，按固定速率投递统计入队到取出的p50/p99延迟。
+// nMaxCount=1即改造前逐条取数的往返次数。开始前先核对PushBack放回后的顺序(两端取数各一遍)。
+// 找不到或启动不了redis-server时打印原因并跳过。
+
+#include "stdafx.h"
+#include "RedisBatchConsumer.h"
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <algorithm>
+
+#define BENCH_QUEUE			"SampleMessage"
+#define BENCH_MSG_LEN		200			//与一帧采样报文量级相当
+#define BENCH_FLOOD_NUM		100000
+#define BENCH_PACED_RATE	20000		//条/秒
+#define BENCH_PACED_NUM		40000
+#define BENCH_PUSH_CHUNK	100
+
+static long long NowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+struct ProducerArg
+{
+	int nPort;
+	int nCount;
+	int nRate;			//0表示不限速
+	BOOL bOk;
+};
+
+static void *ProducerProc(void *pParam)
+{
+	ProducerArg *pArg = (ProducerArg*)pParam;
+	pArg->bOk = FALSE;
+	redisContext *pContext = redisConnect("127.0.0.1", pArg->nPort);
+	if (pContext == NULL || pContext->err)
+	{
+		if (pContext != NULL)
+		{
+			redisFree(pContext);
+		}
+		return NULL;
+	}
+	char Msg[BENCH_MSG_LEN];
+	memset(Msg, 'x', sizeof(Msg));
+	long long nBegin = NowNs();
+	int nSent = 0;
+	while (nSent < pArg->nCount)
+	{
+		int nChunk = std::min(BENCH_PUSH_CHUNK, pArg->nCount - nSent);
+		if (pArg->nRate > 0)
+		{
+			//按速率投递：到时刻才发下一条，每条单独一个往返
+			nChunk = 1;
+			long long nDue = nBegin + (long long)nSent*1000000000LL/pArg->nRate;
+			while (NowNs() < nDue)
+			{
+				sched_yield();
+			}
+		}
+		for (int i=0; i<nChunk; i++)
+		{
+			long long nNow = NowNs();
+			memcpy(Msg, &nNow, sizeof(nNow));
+			redisAppendCommand(pContext, "RPUSH %s %b", BENCH_QUEUE, Msg, sizeof(Msg));
+		}
+		for (int i=0; i<nChunk; i++)
+		{
+			redisReply *pReply = NULL;
+			if (redisGetReply(pContext, (void**)&pReply) != REDIS_OK || pReply == NULL)
+			{
+				redisFree(pContext);
+				return NULL;
+			}
+			freeReplyObject(pReply);
+		}
+		nSent += nChunk;
+	}
+	redisFree(pContext);
+	pArg->bOk = TRUE;
+	return NULL;
+}
+
+//返回是否成功；dRate为每秒取出条数，nP50/nP99为延迟(微秒)
+static BOOL RunOnce(int nPort, int nMaxCount, int nCount, int nRate, double &dRate, long long &nP50, long long &nP99)
+{
+	CRedisBatchConsumer Consumer;
+	if (!Consumer.Connect("127.0.0.1", nPort))
+	{
+		return FALSE;
+	}
+	ProducerArg Arg = { nPort, nCount, nRate, FALSE };
+	pthread_t Thread;
+	long long nBegin = NowNs();
+	pthread_create(&Thread, NULL, ProducerProc, &Arg);
+	std::vector<long long> vecDelay;
+	vecDelay.reserve(nCount);
+	BOOL bOk = TRUE;
+	while ((int)vecDelay.size() < nCount)
+	{
+		int nPopped = Consumer.PopBatch(BENCH_QUEUE, nMaxCount, 1);
+		if (nPopped < 0)
+		{
+			bOk = FALSE;
+			break;
+		}
+		if (nPopped == 0 && NowNs() - nBegin > 60*1000000000LL)
+		{
+			bOk = FALSE;
+			break;
+		}
+		long long nNow = NowNs();
+		for (int i=0; i<nPopped; i++)
+		{
+			int nLen = 0;
+			const BYTE *pMsg = Consumer.GetMessage(i, nLen);
+			long long nPushed = 0;
+			if (nLen == BENCH_MSG_LEN)
+			{
+				memcpy(&nPushed, pMsg, sizeof(nPushed));
+			}
+			vecDelay.push_back((nNow - nPushed)/1000);
+		}
+		Consumer.ReleaseBatch();
+	}
+	double dElapsed = (NowNs() - nBegin)/1e9;
+	pthread_join(Thread, NULL);
+	if (!bOk || !Arg.bOk)
+	{
+		return FALSE;
+	}
+	std::sort(vecDelay.begin(), vecDelay.end());
+	dRate = nCount/dElapsed;
+	nP50 = vecDelay[vecDelay.size()/2];
+	nP99 = vecDelay[vecDelay.size()*99/100];
+	return TRUE;
+}
+
+static void PushInt(redisContext *pContext, const char *szPush, int nValue)
+{
+	redisReply *pReply = (redisReply*)redisCommand(pContext, szPush, BENCH_QUEUE, nValue);
+	if (pReply != NULL)
+	{
+		freeReplyObject(pReply);
+	}
+}
+
+//入队0~4，取一批后从第2条起放回，再入队5；再取时应按原顺序拿到2、3、4、5
+static BOOL CheckPushBack(int nPort, BOOL bPopRight)
+{
+	redisContext *pContext = redisConnect("127.0.0.1", nPort);
+	if (pContext == NULL || pContext->err)
+	{
+		if (pContext != NULL)
+		{
+			redisFree(pContext);
+		}
+		return FALSE;
+	}
+	//生产者从另一端入队
+	const char *szPush = bPopRight ? "LPUSH %s %d" : "RPUSH %s %d";
+	for (int i=0; i<5; i++)
+	{
+		PushInt(pContext, szPush, i);
+	}
+	CRedisBatchConsumer Consumer;
+	Consumer.m_bPopRight = bPopRight;
+	BOOL bOk = Consumer.Connect("127.0.0.1", nPort) && Consumer.PopBatch(BENCH_QUEUE, 5, 0) == 5
+		&& Consumer.PushBack(BENCH_QUEUE, 2);
+	Consumer.ReleaseBatch();
+	PushInt(pContext, szPush, 5);
+	static const char *Expect[] = { "2", "3", "4", "5" };
+	for (int i=0; i<4 && bOk; i++)
+	{
+		int nLen = 0;
+		bOk = Consumer.PopBatch(BENCH_QUEUE, 1, 0) == 1;
+		const BYTE *pMsg = Consumer.GetMessage(0, nLen);
+		bOk = bOk && nLen == 1 && pMsg[0] == Expect[i][0];
+		Consumer.ReleaseBatch();
+	}
+	bOk = bOk && Consumer.PopBatch(BENCH_QUEUE, 1, 0) == 0;
+	redisFree(pContext);
+	return bOk;
+}
+
+static BOOL WaitServer(int nPort)
+{
+	for (int i=0; i<100; i++)
+	{
+		redisContext *pContext = redisConnect("127.0.0.1", nPort);
+		if (pContext != NULL && !pContext->err)
+		{
+			redisReply *pReply = (redisReply*)redisCommand(pContext, "PING");
+			BOOL bOk = pReply != NULL && pReply->type == REDIS_REPLY_STATUS;
+			if (pReply != NULL)
+			{
+				freeReplyObject(pReply);
+			}
+			redisFree(pContext);
+			if (bOk)
+			{
+				return TRUE;
+			}
+		}
+		else if (pContext != NULL)
+		{
+			redisFree(pContext);
+		}
+		usleep(50000);
+	}
+	return FALSE;
+}
+
+int main()
+{
+	const char *szServer = getenv("REDIS_SERVER");
+	if (szServer == NULL || szServer[0] == 0)
+	{
+		szServer = "../redis_Chinese_notated_3.0/src/redis-server";
+	}
+	if (access(szServer, X_OK) != 0)
+	{
+		printf("%s not found, skipped (build it with make -C ../redis_Chinese_notated_3.0 or set REDIS_SERVER)\n", szServer);
+		return 0;
+	}
+
+	int nPort = 20000 + getpid()%20000;
+	char szPort[16];
+	snprintf(szPort, sizeof(szPort), "%d", nPort);
+	pid_t nPid = fork();
+	if (nPid == 0)
+	{
+		freopen("/dev/null", "w", stdout);
+		execl(szServer, szServer, "--port", szPort, "--bind", "127.0.0.1", "--save", "", "--appendonly", "no", (char*)NULL);
+		_exit(127);
+	}
+	if (nPid < 0 || !WaitServer(nPort))
+	{
+		printf("cannot start %s on port %d, skipped\n", szServer, nPort);
+		if (nPid > 0)
+		{
+			kill(nPid, SIGTERM);
+			waitpid(nPid, NULL, 0);
+		}
+		return 0;
+	}
+
+	static const int BatchSize[] = { 1, 16, 64, 256 };
+	BOOL bOk = CheckPushBack(nPort, FALSE) && CheckPushBack(nPort, TRUE);
+	printf("PushBack order: %s\n", bOk ? "ok" : "FAILED");
+	printf("%-8s %14s %14s %14s\n", "batch", "flood msg/s", "paced p50 us", "paced p99 us");
+	for (size_t i=0; i<_countof(BatchSize) && bOk; i++)
+	{
+		double dFloodRate = 0, dPacedRate = 0;
+		long long nP50 = 0, nP99 = 0, nPacedP50 = 0, nPacedP99 = 0;
+		bOk = RunOnce(nPort, BatchSize[i], BENCH_FLOOD_NUM, 0, dFloodRate, nP50, nP99)
+			&& RunOnce(nPort, BatchSize[i], BENCH_PACED_NUM, BENCH_PACED_RATE, dPacedRate, nPacedP50, nPacedP99);
+		if (bOk)
+		{
+			printf("%-8d %14.0f %14lld %14lld\n", BatchSize[i], dFloodRate, nPacedP50, nPacedP99);
+		}
+	}
+	if (!bOk)
+	{
+		printf("redis connection failed during the run\n");
+	}
+	kill(nPid, SIGTERM);
+	waitpid(nPid, NULL, 0);
+	return bOk ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+// RtdbUpdateFrameTest.cpp : CRtdbUpdateFrame多记录报文的编码和应答校验
+//
+
+#include "Win32Compat.h"
+#include "NetMessageStub.h"
+#include "PublicStructStub.h"
+#include "TestCommon.h"
+#include <vector>
+
+// 管道接口的替代：记下发出的报文，按g_nReplyMode返回应答
+enum
+{
+	REPLY_ACK_OK = 0,
+	REPLY_ACK_FAIL,
+	REPLY_NONE,
+	REPLY_OTHER_TYPE,
+};
+static int g_nReplyMode = REPLY_ACK_OK;
+static std::vector<BYTE> g_vecSent;
+
+static BYTE* GetNetMessage(HANDLE hPipe, BYTE *pWrite, DWORD dwLen)
+{
+	(void)hPipe;
+	g_vecSent.assign(pWrite, pWrite + dwLen);
+	if (g_nReplyMode == REPLY_NONE)
+	{
+		return NULL;
+	}
+	BYTE *pReply = new BYTE[sizeof(NetMessageHead) + sizeof(MessageAck)];
+	NetMessageHead *pHead = (NetMessageHead*)pReply;
+	pHead->MessageType = (g_nReplyMode == REPLY_OTHER_TYPE) ? NET_MESSAGE_RETRECORDOFTB : NET_MESSAGE_ACK;
+	pHead->Length = sizeof(MessageAck);
+	MessageAck *pAck = (MessageAck*)&pReply[sizeof(NetMessageHead)];
+	pAck->wdAckType = (g_nReplyMode == REPLY_ACK_FAIL) ? NET_MESSAGE_ACK_OK + 1 : NET_MESSAGE_ACK_OK;
+	return pReply;
+}
+
+#include "../../inc/RtdbUpdateFrame.h"
+
+#define TABLE_NO_TEST	42
+
+static const DWORD RECORDS_OFFSET = sizeof(NetMessageHead) + offsetof(UpdataRecordStruct, RecordData);
+
+static YxConfigDef MakeYx(int nIndex)
+{
+	YxConfigDef iYx;
+	memset(&iYx, 0, sizeof(iYx));
+	iYx.nYxIndex = nIndex;
+	iYx.nDeviceNo = nIndex + 1;
+	strcpy(iYx.cYxName, "yx");
+	iYx.bYxRaw = 1;
+	iYx.bYxValue = 1;
+	iYx.nYxProp = 0x5a5a;
+	return iYx;
+}
+
+//按记录数生成帧，检查报文头、ColFlag和每条记录的内容
+static void TestMultiRecordFrame()
+{
+	int nCols[] = {7, 9, 300, -1};
+	CRtdbUpdateFrame Frame;
+	CHECK(Frame.Init(TABLE_NO_TEST, sizeof(YxConfigDef), nCols, 4, 3));
+	CHECK(Frame.GetCount() == 0);
+	DWORD dwLen = 123;
+	CHECK(Frame.GetFrame(dwLen) == NULL);
+	CHECK(dwLen == 0);
+
+	CHECK(Frame.PutYx(MakeYx(100)));
+	CHECK(Frame.PutYx(MakeYx(200)));
+	CHECK(Frame.GetCount() == 2);
+	CHECK(!Frame.IsFull());
+	const BYTE *pFrame = Frame.GetFrame(dwLen);
+	CHECK(pFrame != NULL);
+	CHECK(dwLen == RECORDS_OFFSET + 2*sizeof(YxConfigDef));
+
+	const NetMessageHead *pHead = (const NetMessageHead*)pFrame;
+	CHECK(pHead->MessageType == NET_MESSAGE_UPDATARECORD);
+	CHECK(pHead->Length == 2*sizeof(YxConfigDef) + sizeof(UpdataRecordStruct) - 1);
+	const UpdataRecordStruct *pUpdata = (const UpdataRecordStruct*)&pFrame[sizeof(NetMessageHead)];
+	CHECK(pUpdata->TableNo == TABLE_NO_TEST);
+	CHECK(pUpdata->UpdataType == UPDATARECORD_TYPE_UPDATA);
+	CHECK(pUpdata->RecordLen == sizeof(YxConfigDef));
+	int nFlags = 0;
+	for (int i=0; i<256; i++)
+	{
+		nFlags += pUpdata->ColFlag[i];
+	}
+	CHECK(nFlags == 2);
+	CHECK(pUpdata->ColFlag[7] == 1 && pUpdata->ColFlag[9] == 1);
+
+	YxConfigDef iExpect = MakeYx(100);
+	CHECK(memcmp(pFrame + RECORDS_OFFSET, &iExpect, sizeof(YxConfigDef)) == 0);
+	iExpect = MakeYx(200);
+	CHECK(memcmp(pFrame + RECORDS_OFFSET + sizeof(YxConfigDef), &iExpect, sizeof(YxConfigDef)) == 0);
+
+	//第三条写满，第四条拒绝且不改变已有内容
+	CHECK(Frame.PutYx(MakeYx(300)));
+	CHECK(Frame.IsFull());
+	CHECK(!Frame.PutYx(MakeYx(400)));
+	CHECK(Frame.GetCount() == 3);
+	pFrame = Frame.GetFrame(dwLen);
+	CHECK(dwLen == RECORDS_OFFSET + 3*sizeof(YxConfigDef));
+	iExpect = MakeYx(300);
+	CHECK(memcmp(pFrame + RECORDS_OFFSET + 2*sizeof(YxConfigDef), &iExpect, sizeof(YxConfigDef)) == 0);
+
+	//清空后从记录区起点重新写，报文头保留
+	Frame.Reset();
+	CHECK(Frame.GetCount() == 0);
+	CHECK(Frame.GetFrame(dwLen) == NULL);
+	CHECK(Frame.PutYx(MakeYx(500)));
+	pFrame = Frame.GetFrame(dwLen);
+	CHECK(dwLen == RECORDS_OFFSET + sizeof(YxConfigDef));
+	CHECK(((const NetMessageHead*)pFrame)->Length == sizeof(YxConfigDef) + sizeof(UpdataRecordStruct) - 1);
+	CHECK(((const UpdataRecordStruct*)&pFrame[sizeof(NetMessageHead)])->TableNo == TABLE_NO_TEST);
+	iExpect = MakeYx(500);
+	CHECK(memcmp(pFrame + RECORDS_OFFSET, &iExpect, sizeof(YxConfigDef)) == 0);
+}
+
+//记录长度小于字段总长时截断，不写到下一条记录
+static void TestShortRecord()
+{
+	int nCols[] = {7};
+	CRtdbUpdateFrame Frame;
+	const int nShort = 6;
+	CHECK(Frame.Init(TABLE_NO_TEST, nShort, nCols, 1, 2));
+	YmConfigDef iYm;
+	memset(&iYm, 0xab, sizeof(iYm));
+	iYm.nYmIndex = 7;
+	CHECK(Frame.PutYm(iYm));
+	iYm.nYmIndex = 8;
+	CHECK(Frame.PutYm(iYm));
+	DWORD dwLen = 0;
+	const BYTE *pFrame = Frame.GetFrame(dwLen);
+	CHECK(dwLen == RECORDS_OFFSET + 2*nShort);
+	int nIndex = 0;
+	memcpy(&nIndex, pFrame + RECORDS_OFFSET, sizeof(int));
+	CHECK(nIndex == 7);
+	memcpy(&nIndex, pFrame + RECORDS_OFFSET + nShort, sizeof(int));
+	CHECK(nIndex == 8);
+}
+
+static void TestInitRejects()
+{
+	int nCols[] = {7};
+	CRtdbUpdateFrame Frame;
+	CHECK(!Frame.Init(TABLE_NO_TEST, 0, nCols, 1, 4));
+	CHECK(!Frame.Init(TABLE_NO_TEST, sizeof(YxConfigDef), nCols, 1, 0));
+	CHECK(!Frame.PutYx(MakeYx(1)));
+	DWORD dwLen = 0;
+	CHECK(Frame.GetFrame(dwLen) == NULL);
+}
+
+//整帧原样发出，只有NET_MESSAGE_ACK且应答成功才算确认
+static void TestSendFrame()
+{
+	int nCols[] = {7, 9};
+	CRtdbUpdateFrame Frame;
+	CHECK(Frame.Init(TABLE_NO_TEST, sizeof(YxConfigDef), nCols, 2, 8));
+	for (int i=0; i<5; i++)
+	{
+		Frame.PutYx(MakeYx(i));
+	}
+	DWORD dwLen = 0;
+	const BYTE *pFrame = Frame.GetFrame(dwLen);
+	HANDLE hPipe = (HANDLE)1;
+
+	g_nReplyMode = REPLY_ACK_OK;
+	CHECK(CRtdbUpdateFrame::SendFrame(hPipe, pFrame, dwLen));
+	CHECK(g_vecSent.size() == dwLen);
+	CHECK(memcmp(&g_vecSent[0], pFrame, dwLen) == 0);
+
+	g_nReplyMode = REPLY_ACK_FAIL;
+	CHECK(!CRtdbUpdateFrame::SendFrame(hPipe, pFrame, dwLen));
+	g_nReplyMode = REPLY_NONE;
+	CHECK(!CRtdbUpdateFrame::SendFrame(hPipe, pFrame, dwLen));
+	g_nReplyMode = REPLY_OTHER_TYPE;
+	CHECK(!CRtdbUpdateFrame::SendFrame(hPipe, pFrame, dwLen));
+
+	g_nReplyMode = REPLY_ACK_OK;
+	g_vecSent.clear();
+	CHECK(!CRtdbUpdateFrame::SendFrame(NULL, pFrame, dwLen));
+	CHECK(!CRtdbUpdateFrame::SendFrame(hPipe, NULL, 0));
+	CHECK(g_vecSent.empty());
+}
+
+int main()
+{
+	TestMultiRecordFrame();
+	TestShortRecord();
+	TestInitRejects();
+	TestSendFrame();
+	return TEST_RESULT();
+}
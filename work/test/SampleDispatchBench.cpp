@@ -0,0 +1,324 @@
+// SampleDispatchBench.cpp : 遥信报文在1/4/10/32个处理线程下的吞吐，按厂站分区与各线程共用状态表对比
+//
+// 共用：各处理线程从同一个来源批量取报文(代替各自读Redis)，每个遥信点在m_csDevStateMap一把锁内查改状态表。
+// 分区：一个分派线程校验报文、按厂站号取模投递到各线程的CMpscQueue，处理线程只改自己分片的状态表，不加锁。
+// 两种方式都按CSampleDispatcher的做法为每条报文拷贝一份，由处理线程解析后释放。
+// 每条报文的dwSyncCode为该厂站内的序号，统计处理顺序与到达顺序不一致的报文数；分区模式必须为0。
+// 处理线程空闲时让出CPU，不等m_ProcessDataEvent：Win32Compat的事件共用一把锁，会把等待本身变成争用点。
+// 线程数超过CPU核数时分区模式也不会再变快，结果里给出本机核数。
+
+#include "Win32Compat.h"
+#include "NetMessageStub.h"
+#include "../TSSampleDataSvr_new(920)/TSSampleDataSvr/MpscQueue.h"
+#include "../TSSampleDataSvr_new(920)/TSSampleDataSvr/SocketFrame.h"
+#include <pthread.h>
+#include <map>
+#include <vector>
+
+#define BENCH_FORE_NUM		8
+#define BENCH_RTU_NUM		250
+#define BENCH_STATION_NUM	(BENCH_FORE_NUM*BENCH_RTU_NUM)
+#define BENCH_FRAME_NUM		200000
+#define BENCH_YX_PER_FRAME	16
+#define BENCH_YX_PER_RTU	64
+#define BENCH_POP_BATCH		64			//共用模式每次取的报文数，与m_nBatchPop的常用值相当
+#define BENCH_QUEUE_SIZE	1024		//与PROCESS_QUEUE_SIZE相同
+#define BENCH_WORKER_MAX	32			//与THREAD_NUM_MAX相同
+
+static const int FRAME_HEAD_LEN = sizeof(NetMessageHead) + sizeof(SocketMsgHead);
+static const int YX_UNIT_OFFSET = offsetof(SocketMsgGroupYxEx, YxUnit);
+
+static std::vector<std::vector<BYTE> > g_vecFrames;
+
+static double NowSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+//按1字节对齐拼一条遥信报文，dwSyncCode为厂站内序号
+static void MakeYxFrame(std::vector<BYTE> &vecFrame, int nStation, DWORD dwSeq, unsigned int &nSeed)
+{
+	int nMsgLen = YX_UNIT_OFFSET + BENCH_YX_PER_FRAME*(int)sizeof(SocketGroupYxUnit);
+	vecFrame.assign(FRAME_HEAD_LEN + nMsgLen, 0);
+	NetMessageHead iNetHead;
+	iNetHead.MessageType = 0;
+	iNetHead.Length = sizeof(SocketMsgHead) + nMsgLen;
+	memcpy(&vecFrame[0], &iNetHead, sizeof(iNetHead));
+	SocketMsgHead iHead;
+	iHead.btType = SOCKET_MSG_GROUP_YXDATA;
+	iHead.wdLen = (WORD)nMsgLen;
+	iHead.dwSyncCode = dwSeq;
+	memcpy(&vecFrame[sizeof(NetMessageHead)], &iHead, sizeof(iHead));
+	BYTE *pMsg = &vecFrame[FRAME_HEAD_LEN];
+	pMsg[offsetof(SocketMsgGroupYxEx, btRtuNo)] = (BYTE)(nStation % BENCH_RTU_NUM);
+	pMsg[offsetof(SocketMsgGroupYxEx, btForeNo)] = (BYTE)(nStation / BENCH_RTU_NUM);
+	WORD wdCount = BENCH_YX_PER_FRAME;
+	memcpy(pMsg + offsetof(SocketMsgGroupYxEx, wdYxNum), &wdCount, sizeof(WORD));
+	for (int i=0; i<BENCH_YX_PER_FRAME; i++)
+	{
+		SocketGroupYxUnit iUnit;
+		iUnit.wdYxNo = (WORD)(rand_r(&nSeed) % BENCH_YX_PER_RTU);
+		iUnit.btYxValue = (BYTE)(rand_r(&nSeed) & 1);
+		memcpy(pMsg + YX_UNIT_OFFSET + i*sizeof(SocketGroupYxUnit), &iUnit, sizeof(iUnit));
+	}
+}
+
+static BYTE *CopyFrame(int nIndex)
+{
+	const std::vector<BYTE> &vecFrame = g_vecFrames[nIndex];
+	BYTE *pBuf = new BYTE[vecFrame.size()];
+	memcpy(pBuf, &vecFrame[0], vecFrame.size());
+	return pBuf;
+}
+
+//报文头按1字节对齐，不直接取DWORD
+static DWORD GetSeq(const SocketFrameView &Frame)
+{
+	DWORD dwSeq = 0;
+	memcpy(&dwSeq, (const BYTE*)Frame.pHead + offsetof(SocketMsgHead, dwSyncCode), sizeof(DWORD));
+	return dwSeq;
+}
+
+// 各模式共用的统计
+struct BenchResult
+{
+	LONG nProcessed;
+	LONG nOutOfOrder;
+};
+
+//共用模式
+struct SharedBench
+{
+	CRITICAL_SECTION csSource;
+	int nNext;
+	CRITICAL_SECTION csDevStateMap;
+	std::map<int, BYTE> DevStateMap;
+	DWORD dwLastSeq[BENCH_STATION_NUM];
+	BenchResult Result;
+};
+
+static void *SharedWorkerProc(void *pParam)
+{
+	SharedBench *pBench = (SharedBench*)pParam;
+	while (true)
+	{
+		EnterCriticalSection(&pBench->csSource);
+		int nBegin = pBench->nNext;
+		int nEnd = nBegin + BENCH_POP_BATCH < BENCH_FRAME_NUM ? nBegin + BENCH_POP_BATCH : BENCH_FRAME_NUM;
+		pBench->nNext = nEnd;
+		LeaveCriticalSection(&pBench->csSource);
+		if (nBegin >= nEnd)
+		{
+			return NULL;
+		}
+		for (int f=nBegin; f<nEnd; f++)
+		{
+			BYTE *pBuf = CopyFrame(f);
+			SocketFrameView Frame;
+			if (CSocketFrameParser::Parse(pBuf, SOCKETFRAME_LEN_UNKNOWN, Frame) == SOCKETFRAME_OK)
+			{
+				int nStation = CSocketFrameParser::GetRtuNo(Frame);
+				int nStationIndex = (nStation/256)*BENCH_RTU_NUM + nStation%256;
+				for (int i=0; i<Frame.Units.nCount; i++)
+				{
+					SocketGroupYxUnit iUnit;
+					memcpy(&iUnit, Frame.Units.At<SocketGroupYxUnit>(i), sizeof(iUnit));
+					int nYxIndex = nStation*BENCH_YX_PER_RTU + iUnit.wdYxNo;
+					EnterCriticalSection(&pBench->csDevStateMap);
+					pBench->DevStateMap.find(nYxIndex)->second = iUnit.btYxValue;
+					LeaveCriticalSection(&pBench->csDevStateMap);
+				}
+				EnterCriticalSection(&pBench->csDevStateMap);
+				DWORD dwSeq = GetSeq(Frame);
+				if (dwSeq < pBench->dwLastSeq[nStationIndex])
+				{
+					pBench->Result.nOutOfOrder++;
+				}
+				else
+				{
+					pBench->dwLastSeq[nStationIndex] = dwSeq;
+				}
+				pBench->Result.nProcessed++;
+				LeaveCriticalSection(&pBench->csDevStateMap);
+			}
+			delete [] pBuf;
+		}
+	}
+}
+
+static void InitStateMap(std::map<int, BYTE> &StateMap, int nWorker, int nWorkerNum)
+{
+	for (int s=0; s<BENCH_STATION_NUM; s++)
+	{
+		int nStation = (s/BENCH_RTU_NUM)*256 + s%BENCH_RTU_NUM;
+		if (nWorkerNum > 0 && nStation % nWorkerNum != nWorker)
+		{
+			continue;
+		}
+		for (int y=0; y<BENCH_YX_PER_RTU; y++)
+		{
+			StateMap[nStation*BENCH_YX_PER_RTU + y] = 0;
+		}
+	}
+}
+
+static void RunShared(int nWorkerNum, double &dSeconds, BenchResult &Result)
+{
+	SharedBench *pBench = new SharedBench;
+	InitializeCriticalSection(&pBench->csSource);
+	InitializeCriticalSection(&pBench->csDevStateMap);
+	pBench->nNext = 0;
+	InitStateMap(pBench->DevStateMap, 0, 0);
+	memset(pBench->dwLastSeq, 0, sizeof(pBench->dwLastSeq));
+	memset(&pBench->Result, 0, sizeof(pBench->Result));
+	pthread_t Threads[BENCH_WORKER_MAX];
+	double dBegin = NowSeconds();
+	for (int i=0; i<nWorkerNum; i++)
+	{
+		pthread_create(&Threads[i], NULL, SharedWorkerProc, pBench);
+	}
+	for (int i=0; i<nWorkerNum; i++)
+	{
+		pthread_join(Threads[i], NULL);
+	}
+	dSeconds = NowSeconds() - dBegin;
+	Result = pBench->Result;
+	DeleteCriticalSection(&pBench->csSource);
+	DeleteCriticalSection(&pBench->csDevStateMap);
+	delete pBench;
+}
+
+//分区模式：每个处理线程一个队列和一份状态分片
+struct PartitionWorker
+{
+	PartitionWorker() : FrameQueue(BENCH_QUEUE_SIZE) {}
+	CMpscQueue<BYTE*> FrameQueue;
+	std::map<int, BYTE> DevStateShard;
+	std::map<int, DWORD> LastSeq;
+	BenchResult Result;
+	volatile LONG *pDone;
+};
+
+static void *PartitionWorkerProc(void *pParam)
+{
+	PartitionWorker *pWorker = (PartitionWorker*)pParam;
+	while (true)
+	{
+		BYTE *pBuf = NULL;
+		if (!pWorker->FrameQueue.Pop(pBuf))
+		{
+			if (*pWorker->pDone && pWorker->FrameQueue.GetSize() == 0)
+			{
+				return NULL;
+			}
+			sched_yield();
+			continue;
+		}
+		SocketFrameView Frame;
+		if (CSocketFrameParser::Parse(pBuf, SOCKETFRAME_LEN_UNKNOWN, Frame) == SOCKETFRAME_OK)
+		{
+			int nStation = CSocketFrameParser::GetRtuNo(Frame);
+			for (int i=0; i<Frame.Units.nCount; i++)
+			{
+				SocketGroupYxUnit iUnit;
+				memcpy(&iUnit, Frame.Units.At<SocketGroupYxUnit>(i), sizeof(iUnit));
+				pWorker->DevStateShard.find(nStation*BENCH_YX_PER_RTU + iUnit.wdYxNo)->second = iUnit.btYxValue;
+			}
+			DWORD &dwLastSeq = pWorker->LastSeq[nStation];
+			DWORD dwSeq = GetSeq(Frame);
+			if (dwSeq < dwLastSeq)
+			{
+				pWorker->Result.nOutOfOrder++;
+			}
+			else
+			{
+				dwLastSeq = dwSeq;
+			}
+			pWorker->Result.nProcessed++;
+		}
+		delete [] pBuf;
+	}
+}
+
+static void RunPartition(int nWorkerNum, double &dSeconds, BenchResult &Result)
+{
+	volatile LONG nDone = 0;
+	PartitionWorker *pWorkers = new PartitionWorker[nWorkerNum];
+	for (int i=0; i<nWorkerNum; i++)
+	{
+		InitStateMap(pWorkers[i].DevStateShard, i, nWorkerNum);
+		memset(&pWorkers[i].Result, 0, sizeof(BenchResult));
+		pWorkers[i].pDone = &nDone;
+	}
+	pthread_t Threads[BENCH_WORKER_MAX];
+	double dBegin = NowSeconds();
+	for (int i=0; i<nWorkerNum; i++)
+	{
+		pthread_create(&Threads[i], NULL, PartitionWorkerProc, &pWorkers[i]);
+	}
+	//本线程即分派线程：校验、按厂站号选线程、队列满时等待
+	for (int f=0; f<BENCH_FRAME_NUM; f++)
+	{
+		BYTE *pBuf = CopyFrame(f);
+		SocketFrameView Frame;
+		if (CSocketFrameParser::Parse(pBuf, (int)g_vecFrames[f].size(), Frame) != SOCKETFRAME_OK)
+		{
+			delete [] pBuf;
+			continue;
+		}
+		PartitionWorker &Worker = pWorkers[CSocketFrameParser::GetRtuNo(Frame) % nWorkerNum];
+		while (!Worker.FrameQueue.PushWait(pBuf, 1000))
+		{
+			//处理线程跟不上，继续等，不丢报文
+		}
+	}
+	InterlockedExchange(&nDone, 1);
+	memset(&Result, 0, sizeof(Result));
+	for (int i=0; i<nWorkerNum; i++)
+	{
+		pthread_join(Threads[i], NULL);
+		Result.nProcessed += pWorkers[i].Result.nProcessed;
+		Result.nOutOfOrder += pWorkers[i].Result.nOutOfOrder;
+	}
+	dSeconds = NowSeconds() - dBegin;
+	delete [] pWorkers;
+}
+
+int main()
+{
+	//四分之一的报文集中在16个大站，分区时负责大站的线程偏忙
+	unsigned int nSeed = 7;
+	std::vector<DWORD> vecSeq(BENCH_STATION_NUM, 0);
+	g_vecFrames.resize(BENCH_FRAME_NUM);
+	for (int f=0; f<BENCH_FRAME_NUM; f++)
+	{
+		int nStation = rand_r(&nSeed) % BENCH_STATION_NUM;
+		if (rand_r(&nSeed) % 4 == 0)
+		{
+			nStation = rand_r(&nSeed) % 16;
+		}
+		MakeYxFrame(g_vecFrames[f], nStation, ++vecSeq[nStation], nSeed);
+	}
+
+	static const int WorkerNum[] = { 1, 4, 10, 32 };
+	BOOL bOk = TRUE;
+	printf("frames=%d stations=%d yx/frame=%d cpus=%ld\n", BENCH_FRAME_NUM, BENCH_STATION_NUM, BENCH_YX_PER_FRAME, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("%-8s %14s %10s %14s %10s %8s\n", "workers", "shared fr/s", "reordered", "partition fr/s", "reordered", "ratio");
+	for (size_t i=0; i<_countof(WorkerNum); i++)
+	{
+		double dShared = 0, dPartition = 0;
+		BenchResult Shared, Partition;
+		RunShared(WorkerNum[i], dShared, Shared);
+		RunPartition(WorkerNum[i], dPartition, Partition);
+		printf("%-8d %14.0f %10d %14.0f %10d %8.2f\n", WorkerNum[i], BENCH_FRAME_NUM/dShared, (int)Shared.nOutOfOrder,
+			BENCH_FRAME_NUM/dPartition, (int)Partition.nOutOfOrder, dShared/dPartition);
+		//报文都须处理到；分区模式不得乱序
+		if (Shared.nProcessed != BENCH_FRAME_NUM || Partition.nProcessed != BENCH_FRAME_NUM || Partition.nOutOfOrder != 0)
+		{
+			bOk = FALSE;
+		}
+	}
+	return bOk ? 0 : 1;
+}
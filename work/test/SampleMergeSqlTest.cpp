@@ -0,0 +1,133 @@
+// SampleMergeSqlTest.cpp : 采样表批量MERGE语句的拼接
+//
+
+#include "Win32Compat.h"
+#include "TestCommon.h"
+#include <string>
+
+#define SAMPLE_FIELDNUM		128
+
+#include "../TSSampleDataSvr_new(920)/TSSampleDataSvr/SampleMergeSql.h"
+
+static SampleRowKey MakeKey(int iType, int nTableNo, const char *pTimeId)
+{
+	SampleRowKey iKey;
+	memset(&iKey, 0, sizeof(iKey));
+	iKey.iType = iType;
+	iKey.nTableNo = nTableNo;
+	snprintf(iKey.TimeId, sizeof(iKey.TimeId), "%s", pTimeId);
+	return iKey;
+}
+
+static void SetValue(SampleRow &iRow, int nCol, double dbValue)
+{
+	iRow.ColMask[nCol/32] |= (DWORD)1 << (nCol%32);
+	iRow.dbValue[nCol] = dbValue;
+}
+
+static SampleRow EmptyRow()
+{
+	SampleRow iRow;
+	memset(&iRow, 0, sizeof(iRow));
+	return iRow;
+}
+
+//一行两列：首列和末列，列名按V%03d从1编号
+static void TestSingleRow()
+{
+	SampleRowMap RowMap;
+	SampleRow iRow = EmptyRow();
+	SetValue(iRow, 0, 1.5);
+	SetValue(iRow, SAMPLE_FIELDNUM - 1, 2.25);
+	RowMap[MakeKey(0, 7, "2024091710")] = iRow;
+
+	CString strSql;
+	CHECK(BuildSampleMergeSql(RowMap.begin(), RowMap.end(), strSql) == 1);
+	std::string strExpect =
+		"MERGE TS_H1_007 AS t USING (VALUES ('2024091710',1.500000,2.250000)) AS s(TIMEID,V001,V128)"
+		" ON t.TIMEID=s.TIMEID WHEN MATCHED THEN UPDATE SET V001=ISNULL(s.V001,t.V001),V128=ISNULL(s.V128,t.V128)"
+		" WHEN NOT MATCHED THEN INSERT (TIMEID,V001,V128) VALUES (s.TIMEID,s.V001,s.V128); ";
+	CHECK(std::string((LPCTSTR)strSql) == strExpect);
+}
+
+//各行赋值的列不同：列取并集，某行没有的列写NULL，天表用TS_DAY
+static void TestColumnUnion()
+{
+	SampleRowMap RowMap;
+	SampleRow iRow = EmptyRow();
+	SetValue(iRow, 2, 10);
+	RowMap[MakeKey(1, 12, "20240917")] = iRow;
+	iRow = EmptyRow();
+	SetValue(iRow, 40, -3);
+	RowMap[MakeKey(1, 12, "20240918")] = iRow;
+
+	CString strSql;
+	strSql.Append("SELECT 1; ");
+	CHECK(BuildSampleMergeSql(RowMap.begin(), RowMap.end(), strSql) == 2);
+	std::string strExpect =
+		"SELECT 1; "
+		"MERGE TS_DAY_012 AS t USING (VALUES ('20240917',10.000000,NULL),('20240918',NULL,-3.000000)) AS s(TIMEID,V003,V041)"
+		" ON t.TIMEID=s.TIMEID WHEN MATCHED THEN UPDATE SET V003=ISNULL(s.V003,t.V003),V041=ISNULL(s.V041,t.V041)"
+		" WHEN NOT MATCHED THEN INSERT (TIMEID,V003,V041) VALUES (s.TIMEID,s.V003,s.V041); ";
+	CHECK(std::string((LPCTSTR)strSql) == strExpect);
+}
+
+//只取[itBegin,itEnd)的行；没有赋值的列时不生成语句
+static void TestRangeAndEmpty()
+{
+	SampleRowMap RowMap;
+	for (int i=0; i<5; i++)
+	{
+		char szTimeId[20];
+		snprintf(szTimeId, sizeof(szTimeId), "20240917%02d", i);
+		SampleRow iRow = EmptyRow();
+		SetValue(iRow, 5, i);
+		RowMap[MakeKey(0, 1, szTimeId)] = iRow;
+	}
+	SampleRowMap::const_iterator itBegin = RowMap.begin();
+	++itBegin;
+	SampleRowMap::const_iterator itEnd = itBegin;
+	++itEnd;
+	++itEnd;
+	CString strSql;
+	CHECK(BuildSampleMergeSql(itBegin, itEnd, strSql) == 2);
+	std::string strSqlText = (LPCTSTR)strSql;
+	CHECK(strSqlText.find("('2024091701',1.000000),('2024091702',2.000000))") != std::string::npos);
+	CHECK(strSqlText.find("2024091700") == std::string::npos);
+	CHECK(strSqlText.find("2024091703") == std::string::npos);
+
+	SampleRowMap EmptyMap;
+	EmptyMap[MakeKey(0, 1, "2024091700")] = EmptyRow();
+	strSql.Empty();
+	CHECK(BuildSampleMergeSql(EmptyMap.begin(), EmptyMap.end(), strSql) == 0);
+	CHECK(strSql.IsEmpty());
+}
+
+//最长的double不截断；超出栈上缓冲区的文本退回CString格式化，同样不截断
+static void TestLongText()
+{
+	SampleRowMap RowMap;
+	SampleRow iRow = EmptyRow();
+	SetValue(iRow, 0, -1.7e308);
+	RowMap[MakeKey(0, 0, "2024091700")] = iRow;
+	CString strSql;
+	CHECK(BuildSampleMergeSql(RowMap.begin(), RowMap.end(), strSql) == 1);
+	char szValue[SQL_TEXT_MAXLEN];
+	snprintf(szValue, sizeof(szValue), ",%2f)", -1.7e308);
+	CHECK(std::string((LPCTSTR)strSql).find(szValue) != std::string::npos);
+
+	std::string strLong(SQL_TEXT_MAXLEN*3, 'x');
+	strSql.Empty();
+	AppendSqlText(strSql, "<%s>", strLong.c_str());
+	CHECK(strSql.GetLength() == (int)strLong.size() + 2);
+	CHECK(std::string((LPCTSTR)strSql) == "<" + strLong + ">");
+}
+
+int main()
+{
+	TestSingleRow();
+	TestColumnUnion();
+	TestRangeAndEmpty();
+	TestLongText();
+	return TEST_RESULT();
+}
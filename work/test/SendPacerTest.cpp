@@ -0,0 +1,170 @@
+// SendPacerTest.cpp : CSendPacer的接口限速和退避等待，除TestWait外时刻都由测试给出，不依赖真实时钟
+//
+
+#include "Win32Compat.h"
+#include "TestCommon.h"
+#include "../TSAlarmServer_WD/TSAlarmServer_WD/SendPacer.h"
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
+
+//同一时刻的连续调用依次排到后面的时间片，到时再来的不用等
+static void TestPacing()
+{
+	CSendPacer Pacer;
+	Pacer.SetRate(10);
+	CHECK(Pacer.Reserve(1000) == 0);
+	CHECK(Pacer.Reserve(1000) == 100);
+	CHECK(Pacer.Reserve(1000) == 200);
+	//已预订到1300，1150时再来要等150
+	CHECK(Pacer.Reserve(1150) == 150);
+	CHECK(Pacer.Reserve(1400) == 0);
+}
+
+//空闲期间不攒额度：长时间没有调用后第一次不等，第二次仍按速率等待
+static void TestNoBurstAfterIdle()
+{
+	CSendPacer Pacer;
+	Pacer.SetRate(10);
+	Pacer.Reserve(1000);
+	CHECK(Pacer.Reserve(60000) == 0);
+	CHECK(Pacer.Reserve(60000) == 100);
+	//空闲超过GetTickCount半个环绕周期后，旧时刻看起来在很久以后，也按空闲处理
+	CHECK(Pacer.Reserve(60000 + 0xC0000000) == 0);
+}
+
+static void TestUnlimited()
+{
+	CSendPacer Pacer;
+	Pacer.SetRate(0);
+	BOOL bNoWait = TRUE;
+	for (int i=0; i<100; i++)
+	{
+		bNoWait = bNoWait && Pacer.Reserve(1000) == 0;
+	}
+	CHECK(bNoWait);
+	Pacer.SetRate(-5);
+	CHECK(Pacer.Reserve(1000) == 0 && Pacer.Reserve(1000) == 0);
+}
+
+//每秒超过1000次时按微秒排时间片，1000/nRatePerSec不会变成0而不限速
+static void TestHighRate()
+{
+	CSendPacer Pacer;
+	Pacer.SetRate(4000);
+	DWORD dwWait[8];
+	for (int i=0; i<8; i++)
+	{
+		dwWait[i] = Pacer.Reserve(500);
+	}
+	CHECK(dwWait[0] == 0 && dwWait[1] == 1 && dwWait[4] == 1 && dwWait[5] == 2 && dwWait[7] == 2);
+
+	//一秒内的4000次调用，最后一次排在约1秒后
+	Pacer.SetRate(4000);
+	DWORD dwLast = 0;
+	for (int i=0; i<4000; i++)
+	{
+		dwLast = Pacer.Reserve(10000);
+	}
+	CHECK(dwLast == 1000);
+}
+
+//GetTickCount约49.7天环绕一次，环绕前后的预订照常衔接
+static void TestTickWrap()
+{
+	CSendPacer Pacer;
+	Pacer.SetRate(10);
+	DWORD dwNow = 0xFFFFFFF0;
+	CHECK(Pacer.Reserve(dwNow) == 0);
+	CHECK(Pacer.Reserve(dwNow) == 100);
+	//已预订到环绕后的184ms，环绕后5ms时要等179
+	CHECK(Pacer.Reserve(5) == 179);
+	CHECK(Pacer.Reserve(10000) == 0);
+}
+
+#define PACER_THREADS		4
+#define PACER_CALLS			250
+
+struct PacerParam
+{
+	CSendPacer *pPacer;
+	DWORD dwWait[PACER_CALLS];
+};
+
+static void *ReserveProc(void *pParam)
+{
+	PacerParam *pPacerParam = (PacerParam*)pParam;
+	for (int i=0; i<PACER_CALLS; i++)
+	{
+		pPacerParam->dwWait[i] = pPacerParam->pPacer->Reserve(2000);
+	}
+	return NULL;
+}
+
+//多个发送线程同时预订：每个时间片只给出一次，没有重叠也没有空档
+static void TestConcurrent()
+{
+	CSendPacer Pacer;
+	Pacer.SetRate(1000);
+	PacerParam Params[PACER_THREADS];
+	pthread_t Threads[PACER_THREADS];
+	for (int i=0; i<PACER_THREADS; i++)
+	{
+		Params[i].pPacer = &Pacer;
+		pthread_create(&Threads[i], NULL, ReserveProc, &Params[i]);
+	}
+	std::vector<DWORD> vecWait;
+	for (int i=0; i<PACER_THREADS; i++)
+	{
+		pthread_join(Threads[i], NULL);
+		vecWait.insert(vecWait.end(), Params[i].dwWait, Params[i].dwWait + PACER_CALLS);
+	}
+	std::sort(vecWait.begin(), vecWait.end());
+	BOOL bDistinct = TRUE;
+	for (size_t i=0; i<vecWait.size(); i++)
+	{
+		bDistinct = bDistinct && vecWait[i] == (DWORD)i;
+	}
+	CHECK(bDistinct);
+}
+
+//Wait按真实时钟睡眠：10次调用至少经过9个时间片
+static void TestWait()
+{
+	CSendPacer Pacer;
+	Pacer.SetRate(100);
+	DWORD dwBegin = GetTickCount();
+	for (int i=0; i<10; i++)
+	{
+		Pacer.Wait();
+	}
+	DWORD dwSpan = GetTickCount() - dwBegin;
+	CHECK(dwSpan >= 85 && dwSpan < 1000);
+}
+
+static void TestRetryDelay()
+{
+	CHECK(CSendPacer::GetRetryDelay(1000, 0) == 0);
+	CHECK(CSendPacer::GetRetryDelay(1000, 1) == 1000);
+	CHECK(CSendPacer::GetRetryDelay(1000, 2) == 2000);
+	CHECK(CSendPacer::GetRetryDelay(1000, 3) == 4000);
+	CHECK(CSendPacer::GetRetryDelay(1000, 6) == 32000);
+	//加倍后超过上限的取上限，重试次数很大时也不溢出
+	CHECK(CSendPacer::GetRetryDelay(1000, 7) == MSGSEND_MAX_RETRYDELAY);
+	CHECK(CSendPacer::GetRetryDelay(50000, 2) == MSGSEND_MAX_RETRYDELAY);
+	CHECK(CSendPacer::GetRetryDelay(1000, 40) == MSGSEND_MAX_RETRYDELAY);
+	CHECK(CSendPacer::GetRetryDelay(0, 3) == 0);
+}
+
+int main()
+{
+	TestPacing();
+	TestNoBurstAfterIdle();
+	TestUnlimited();
+	TestHighRate();
+	TestTickWrap();
+	TestConcurrent();
+	TestWait();
+	TestRetryDelay();
+	return TEST_RESULT();
+}
@@ -0,0 +1,72 @@
+// SmsTemplateBench.cpp : 生成10万条告警短信，对比CSmsTemplate按片段拼接与原来每条复制模板后三次Replace的耗时
+//
+// 模板取典型的短信格式，三个占位符各出现一次；负责人、告警对象按条变化，相当于逐条告警生成短信。
+
+#include "alarm/stdafx.h"
+#include "../TSAlarmServer_WD/TSAlarmServer_WD/SmsTemplate.h"
+#include <time.h>
+
+#define BENCH_SMS_NUM		100000
+#define BENCH_ROUNDS		5
+
+static const char *g_szTemplate = "【能耗平台】尊敬的[owner]您好：[object]于今日发生[alarmtype]告警，请尽快登录平台查看并处理。";
+
+static double NowSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+int main()
+{
+	std::vector<CString> vecOwner(BENCH_SMS_NUM), vecObject(BENCH_SMS_NUM);
+	for (int i=0; i<BENCH_SMS_NUM; i++)
+	{
+		vecOwner[i].Format("负责人%d", i%500);
+		vecObject[i].Format("%d号广场B品牌下的电表%d", i%50, i);
+	}
+	CString strTemplate = g_szTemplate;
+	CSmsTemplate Template;
+	Template.Compile(strTemplate);
+
+	double dRender = 0, dReplace = 0;
+	size_t nRenderLen = 0, nReplaceLen = 0;
+	int nMismatch = 0;
+	CString strFields[SMSFIELD_NUM];
+	strFields[SMSFIELD_ALARMTYPE] = "余额不足";
+	for (int r=0; r<BENCH_ROUNDS; r++)
+	{
+		double dBegin = NowSeconds();
+		CString strOut;
+		for (int i=0; i<BENCH_SMS_NUM; i++)
+		{
+			strFields[SMSFIELD_OWNER] = vecOwner[i];
+			strFields[SMSFIELD_OBJECT] = vecObject[i];
+			Template.Render(strFields, strOut);
+			nRenderLen += strOut.GetLength();
+		}
+		double dMid = NowSeconds();
+		for (int i=0; i<BENCH_SMS_NUM; i++)
+		{
+			CString strContent = strTemplate;
+			strContent.Replace("[owner]", vecOwner[i]);
+			strContent.Replace("[object]", vecObject[i]);
+			strContent.Replace("[alarmtype]", strFields[SMSFIELD_ALARMTYPE]);
+			nReplaceLen += strContent.GetLength();
+			if (i%1000 == 0)
+			{
+				strFields[SMSFIELD_OWNER] = vecOwner[i];
+				strFields[SMSFIELD_OBJECT] = vecObject[i];
+				Template.Render(strFields, strOut);
+				nMismatch += strcmp(strOut, strContent) != 0;
+			}
+		}
+		dRender += dMid - dBegin;
+		dReplace += NowSeconds() - dMid;
+	}
+	printf("messages=%d template=%d bytes\n", BENCH_SMS_NUM, strTemplate.GetLength());
+	printf("render           %8.1f ms (%.0f ns/message)\n", dRender*1e3/BENCH_ROUNDS, dRender*1e9/BENCH_ROUNDS/BENCH_SMS_NUM);
+	printf("3x Replace       %8.1f ms (%.0f ns/message)\n", dReplace*1e3/BENCH_ROUNDS, dReplace*1e9/BENCH_ROUNDS/BENCH_SMS_NUM);
+	return nMismatch == 0 && nRenderLen == nReplaceLen ? 0 : 1;
+}
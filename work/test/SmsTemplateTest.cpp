@@ -0,0 +1,133 @@
+// SmsTemplateTest.cpp : CSmsTemplate拆分模板和拼接短信，结果与原来对整段模板做三次Replace相同
+//
+
+#include "alarm/stdafx.h"
+#include "TestCommon.h"
+#include "../TSAlarmServer_WD/TSAlarmServer_WD/SmsTemplate.h"
+
+//改造前的做法：复制模板后依次替换三个占位符
+static CString ReplaceRender(const CString &strTemplate, const CString *pFields)
+{
+	CString strOut = strTemplate;
+	strOut.Replace(_T("[owner]"), pFields[SMSFIELD_OWNER]);
+	strOut.Replace(_T("[object]"), pFields[SMSFIELD_OBJECT]);
+	strOut.Replace(_T("[alarmtype]"), pFields[SMSFIELD_ALARMTYPE]);
+	return strOut;
+}
+
+static CString Render(LPCTSTR szTemplate, const CString *pFields)
+{
+	CSmsTemplate Template;
+	Template.Compile(szTemplate);
+	CString strOut;
+	Template.Render(pFields, strOut);
+	return strOut;
+}
+
+static BOOL SameAsReplace(LPCTSTR szTemplate, const CString *pFields)
+{
+	return strcmp(Render(szTemplate, pFields), ReplaceRender(szTemplate, pFields)) == 0;
+}
+
+static void SetFields(CString *pFields)
+{
+	pFields[SMSFIELD_OWNER] = _T("张三");
+	pFields[SMSFIELD_OBJECT] = _T("一号广场A品牌下的电表1");
+	pFields[SMSFIELD_ALARMTYPE] = _T("余额不足");
+}
+
+static void TestBasic()
+{
+	CString strFields[SMSFIELD_NUM];
+	SetFields(strFields);
+	CHECK(strcmp(Render(_T("尊敬的[owner]，[object]发生[alarmtype]，请及时处理"), strFields),
+		_T("尊敬的张三，一号广场A品牌下的电表1发生余额不足，请及时处理")) == 0);
+	//同一占位符出现多次，每处都替换
+	CHECK(strcmp(Render(_T("[owner]/[owner]"), strFields), _T("张三/张三")) == 0);
+}
+
+//占位符在开头、结尾或整段只有占位符时没有多余的空文本
+static void TestEdges()
+{
+	CString strFields[SMSFIELD_NUM];
+	SetFields(strFields);
+	CHECK(strcmp(Render(_T("[owner]您好"), strFields), _T("张三您好")) == 0);
+	CHECK(strcmp(Render(_T("告警：[alarmtype]"), strFields), _T("告警：余额不足")) == 0);
+	CHECK(strcmp(Render(_T("[object]"), strFields), _T("一号广场A品牌下的电表1")) == 0);
+	CHECK(SameAsReplace(_T("[owner]您好，[alarmtype]"), strFields));
+}
+
+static void TestAdjacent()
+{
+	CString strFields[SMSFIELD_NUM];
+	SetFields(strFields);
+	CHECK(strcmp(Render(_T("[owner][object][alarmtype]"), strFields), _T("张三一号广场A品牌下的电表1余额不足")) == 0);
+	CHECK(strcmp(Render(_T("[[owner]]"), strFields), _T("[张三]")) == 0);
+	CHECK(SameAsReplace(_T("x[alarmtype][owner]y"), strFields));
+}
+
+//不认识的标签、不完整的占位符和大小写不同的写法都原样保留
+static void TestUnknownTags()
+{
+	CString strFields[SMSFIELD_NUM];
+	SetFields(strFields);
+	CHECK(strcmp(Render(_T("[name]发生[alarmtype]"), strFields), _T("[name]发生余额不足")) == 0);
+	CHECK(strcmp(Render(_T("[owner"), strFields), _T("[owner")) == 0);
+	CHECK(strcmp(Render(_T("[]["), strFields), _T("[][")) == 0);
+	CHECK(strcmp(Render(_T("[OWNER]"), strFields), _T("[OWNER]")) == 0);
+	CHECK(strcmp(Render(_T("[ownerx][object"), strFields), _T("[ownerx][object")) == 0);
+	CHECK(SameAsReplace(_T("[a][owner[object]]"), strFields));
+}
+
+static void TestEmpty()
+{
+	CString strFields[SMSFIELD_NUM];
+	SetFields(strFields);
+	CHECK(Render(_T(""), strFields).IsEmpty());
+	//取值为空时占位符处什么都不留
+	CString strEmpty[SMSFIELD_NUM];
+	CHECK(strcmp(Render(_T("[owner]:[object]:[alarmtype]"), strEmpty), _T("::")) == 0);
+	//输出串中原有的内容被清掉
+	CSmsTemplate Template;
+	Template.Compile(_T("abc"));
+	CString strOut = _T("old content");
+	Template.Render(strFields, strOut);
+	CHECK(strcmp(strOut, _T("abc")) == 0);
+}
+
+//取值中含占位符文字时不再展开；原来的Replace会把负责人名中的[object]也替换掉
+static void TestFieldNotExpanded()
+{
+	CString strFields[SMSFIELD_NUM];
+	SetFields(strFields);
+	strFields[SMSFIELD_OWNER] = _T("[object]");
+	CHECK(strcmp(Render(_T("[owner]-[object]"), strFields), _T("[object]-一号广场A品牌下的电表1")) == 0);
+}
+
+//同一对象重新Compile时丢掉旧模板
+static void TestRecompile()
+{
+	CString strFields[SMSFIELD_NUM];
+	SetFields(strFields);
+	CSmsTemplate Template;
+	Template.Compile(_T("[owner]您好，很长的旧模板内容"));
+	Template.Compile(_T("[alarmtype]"));
+	CString strOut;
+	Template.Render(strFields, strOut);
+	CHECK(strcmp(strOut, _T("余额不足")) == 0);
+	Template.Compile(_T(""));
+	Template.Render(strFields, strOut);
+	CHECK(strOut.IsEmpty());
+}
+
+int main()
+{
+	TestBasic();
+	TestEdges();
+	TestAdjacent();
+	TestUnknownTags();
+	TestEmpty();
+	TestFieldNotExpanded();
+	TestRecompile();
+	return TEST_RESULT();
+}
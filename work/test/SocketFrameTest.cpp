@@ -0,0 +1,208 @@
+// SocketFrameTest.cpp : CSocketFrameParser对截断、超长和随机报文的校验
+//
+
+#include "Win32Compat.h"
+#include "NetMessageStub.h"
+#include "TestCommon.h"
+#include <stdlib.h>
+#include <vector>
+
+#include "../TSSampleDataSvr_new(920)/TSSampleDataSvr/SocketFrame.h"
+
+#define RTU_NO_TEST		5
+#define FORE_NO_TEST	2
+
+static const int FRAME_HEAD_LEN = sizeof(NetMessageHead) + sizeof(SocketMsgHead);
+static const int YX_UNIT_OFFSET = offsetof(SocketMsgGroupYxEx, YxUnit);
+
+//按1字节对齐拼一条遥信报文：nUnits个单元，wdYxNum写nCount
+static std::vector<BYTE> MakeYxFrame(int nUnits, int nCount)
+{
+	int nMsgLen = YX_UNIT_OFFSET + nUnits*(int)sizeof(SocketGroupYxUnit);
+	std::vector<BYTE> vecFrame(FRAME_HEAD_LEN + nMsgLen, 0);
+	NetMessageHead iNetHead;
+	iNetHead.MessageType = 0;
+	iNetHead.Length = sizeof(SocketMsgHead) + nMsgLen;
+	memcpy(&vecFrame[0], &iNetHead, sizeof(iNetHead));
+	SocketMsgHead iHead;
+	iHead.btType = SOCKET_MSG_GROUP_YXDATA;
+	iHead.wdLen = (WORD)nMsgLen;
+	iHead.dwSyncCode = 0;
+	memcpy(&vecFrame[sizeof(NetMessageHead)], &iHead, sizeof(iHead));
+	BYTE *pMsg = &vecFrame[FRAME_HEAD_LEN];
+	pMsg[offsetof(SocketMsgGroupYxEx, btRtuNo)] = RTU_NO_TEST;
+	pMsg[offsetof(SocketMsgGroupYxEx, btForeNo)] = FORE_NO_TEST;
+	WORD wdCount = (WORD)nCount;
+	memcpy(pMsg + offsetof(SocketMsgGroupYxEx, wdYxNum), &wdCount, sizeof(WORD));
+	for (int i=0; i<nUnits; i++)
+	{
+		pMsg[YX_UNIT_OFFSET + i*sizeof(SocketGroupYxUnit)] = (BYTE)i;
+	}
+	return vecFrame;
+}
+
+static void SetLength(std::vector<BYTE> &vecFrame, DWORD dwLength)
+{
+	memcpy(&vecFrame[offsetof(NetMessageHead, Length)], &dwLength, sizeof(DWORD));
+}
+
+//按nLen字节单独分配一份再解析，解析越过nLen时在ASan下能发现
+static int ParseCopy(const std::vector<BYTE> &vecFrame, int nLen, SocketFrameView &Frame)
+{
+	BYTE *pBuf = new BYTE[nLen > 0 ? nLen : 1];
+	if (nLen > 0)
+	{
+		memcpy(pBuf, &vecFrame[0], nLen);
+	}
+	int nParse = CSocketFrameParser::Parse(pBuf, nLen, Frame);
+	if (nParse == SOCKETFRAME_OK)
+	{
+		//单元视图必须落在收到的字节内
+		CHECK(Frame.Units.pData + Frame.Units.nCount*Frame.Units.nStride <= pBuf + nLen);
+	}
+	CHECK(Frame.nFrameLen <= nLen);
+	delete[] pBuf;
+	return nParse;
+}
+
+static void TestValidFrame()
+{
+	std::vector<BYTE> vecFrame = MakeYxFrame(3, 3);
+	int nLen = (int)vecFrame.size();
+	SocketFrameView Frame;
+	CHECK(ParseCopy(vecFrame, nLen, Frame) == SOCKETFRAME_OK);
+	CHECK(CSocketFrameParser::Parse(&vecFrame[0], nLen, Frame) == SOCKETFRAME_OK);
+	CHECK(Frame.btType == SOCKET_MSG_GROUP_YXDATA);
+	CHECK(Frame.nFrameLen == nLen);
+	CHECK(Frame.Units.nCount == 3);
+	CHECK(Frame.Units.nStride == (int)sizeof(SocketGroupYxUnit));
+	CHECK(Frame.Units.pData[2*sizeof(SocketGroupYxUnit)] == 2);
+	CHECK(CSocketFrameParser::GetRtuNo(Frame) == FORE_NO_TEST*256 + RTU_NO_TEST);
+
+	//收到的字节多于报文长度时只按报文长度解析
+	vecFrame.resize(nLen + 10, 0xee);
+	CHECK(ParseCopy(vecFrame, nLen + 10, Frame) == SOCKETFRAME_OK);
+	CHECK(CSocketFrameParser::Parse(&vecFrame[0], nLen + 10, Frame) == SOCKETFRAME_OK);
+	CHECK(Frame.nFrameLen == nLen);
+
+	//长度未知时按报文头解析
+	CHECK(CSocketFrameParser::Parse(&vecFrame[0], SOCKETFRAME_LEN_UNKNOWN, Frame) == SOCKETFRAME_OK);
+	CHECK(Frame.Units.nCount == 3);
+}
+
+//每一种截断长度都不能解析成功，也不能读到收到的字节之外
+static void TestTruncated()
+{
+	std::vector<BYTE> vecFrame = MakeYxFrame(4, 4);
+	int nLen = (int)vecFrame.size();
+	int nOk = 0;
+	for (int i=0; i<nLen; i++)
+	{
+		SocketFrameView Frame;
+		int nParse = ParseCopy(vecFrame, i, Frame);
+		if (nParse == SOCKETFRAME_OK)
+		{
+			nOk++;
+		}
+		CHECK(CSocketFrameParser::GetDumpLen(Frame, i) <= i);
+	}
+	CHECK(nOk == 0);
+
+	SocketFrameView Frame;
+	CHECK(CSocketFrameParser::Parse(NULL, 0, Frame) == SOCKETFRAME_SHORT);
+	CHECK(ParseCopy(vecFrame, 0, Frame) == SOCKETFRAME_SHORT);
+	CHECK(ParseCopy(vecFrame, sizeof(NetMessageHead) - 1, Frame) == SOCKETFRAME_SHORT);
+	CHECK(Frame.nFrameLen == 0);
+}
+
+static void TestOversize()
+{
+	std::vector<BYTE> vecFrame = MakeYxFrame(2, 2);
+	int nLen = (int)vecFrame.size();
+	SocketFrameView Frame;
+
+	SetLength(vecFrame, 0xFFFFFFFF);
+	CHECK(ParseCopy(vecFrame, nLen, Frame) == SOCKETFRAME_OVERSIZE);
+	CHECK(CSocketFrameParser::Parse(&vecFrame[0], SOCKETFRAME_LEN_UNKNOWN, Frame) == SOCKETFRAME_OVERSIZE);
+	CHECK(Frame.nFrameLen == 0);
+	CHECK(CSocketFrameParser::GetDumpLen(Frame, SOCKETFRAME_LEN_UNKNOWN) == (int)sizeof(NetMessageHead));
+	CHECK(CSocketFrameParser::GetDumpLen(Frame, nLen) == nLen);
+
+	SetLength(vecFrame, (DWORD)SOCKETFRAME_MAXLEN + 1);
+	CHECK(ParseCopy(vecFrame, nLen, Frame) == SOCKETFRAME_OVERSIZE);
+
+	//Length在上限内但超出收到的字节数
+	SetLength(vecFrame, (DWORD)SOCKETFRAME_MAXLEN);
+	CHECK(ParseCopy(vecFrame, nLen, Frame) == SOCKETFRAME_SHORT);
+	CHECK(Frame.nFrameLen == 0);
+	SetLength(vecFrame, nLen - sizeof(NetMessageHead) + 1);
+	CHECK(ParseCopy(vecFrame, nLen, Frame) == SOCKETFRAME_SHORT);
+
+	//输出长度不超过SOCKETFRAME_DUMP_MAX
+	CHECK(CSocketFrameParser::GetDumpLen(Frame, 100000) == SOCKETFRAME_DUMP_MAX);
+}
+
+static void TestBadBody()
+{
+	SocketFrameView Frame;
+
+	//正文长度超出Length
+	std::vector<BYTE> vecFrame = MakeYxFrame(2, 2);
+	int nLen = (int)vecFrame.size();
+	WORD wdLen = (WORD)(nLen - FRAME_HEAD_LEN + 1);
+	memcpy(&vecFrame[sizeof(NetMessageHead) + offsetof(SocketMsgHead, wdLen)], &wdLen, sizeof(WORD));
+	CHECK(ParseCopy(vecFrame, nLen, Frame) == SOCKETFRAME_SHORT);
+	CHECK(Frame.nFrameLen == nLen);
+
+	//单元个数超出正文
+	vecFrame = MakeYxFrame(2, 3);
+	CHECK(ParseCopy(vecFrame, (int)vecFrame.size(), Frame) == SOCKETFRAME_BADCOUNT);
+	vecFrame = MakeYxFrame(2, 0xFFFF);
+	CHECK(ParseCopy(vecFrame, (int)vecFrame.size(), Frame) == SOCKETFRAME_BADCOUNT);
+
+	//不认识的类型
+	vecFrame = MakeYxFrame(2, 2);
+	vecFrame[sizeof(NetMessageHead) + offsetof(SocketMsgHead, btType)] = 0x7f;
+	CHECK(ParseCopy(vecFrame, (int)vecFrame.size(), Frame) == SOCKETFRAME_UNKNOWN);
+	CHECK(CSocketFrameParser::GetRtuNo(Frame) == -1);
+}
+
+//随机改写报文头和正文中的长度字段，任何输入都不能读到收到的字节之外
+static void TestFuzz()
+{
+	srand(20240917);
+	std::vector<BYTE> vecBase = MakeYxFrame(8, 8);
+	int nOk = 0;
+	for (int n=0; n<20000; n++)
+	{
+		std::vector<BYTE> vecFrame = vecBase;
+		int nMutations = 1 + rand()%4;
+		for (int i=0; i<nMutations; i++)
+		{
+			vecFrame[rand()%vecFrame.size()] = (BYTE)rand();
+		}
+		if (rand()%2)
+		{
+			SetLength(vecFrame, (DWORD)rand() | ((DWORD)(rand()%2) << 31));
+		}
+		int nLen = rand()%(int)(vecFrame.size() + 1);
+		SocketFrameView Frame;
+		int nParse = ParseCopy(vecFrame, nLen, Frame);
+		if (nParse == SOCKETFRAME_OK)
+		{
+			nOk++;
+		}
+		CHECK(CSocketFrameParser::GetDumpLen(Frame, nLen) <= nLen);
+	}
+	CHECK(nOk > 0);
+}
+
+int main()
+{
+	TestValidFrame();
+	TestTruncated();
+	TestOversize();
+	TestBadBody();
+	TestFuzz();
+	return TEST_RESULT();
+}
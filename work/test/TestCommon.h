@@ -0,0 +1,22 @@
+#pragma once
+
+// 极简测试框架：CHECK失败时打印位置并计数，main最后用TEST_RESULT()返回进程退出码
+
+#include <stdio.h>
+
+static int g_nTestFailed = 0;
+static int g_nTestChecked = 0;
+
+#define CHECK(cond) \
+	do \
+	{ \
+		g_nTestChecked++; \
+		if (!(cond)) \
+		{ \
+			g_nTestFailed++; \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		} \
+	} while (0)
+
+#define TEST_RESULT() \
+	(printf("%s: %d checks, %d failed\n", __FILE__, g_nTestChecked, g_nTestFailed), g_nTestFailed ? 1 : 0)
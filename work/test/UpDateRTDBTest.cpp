@@ -0,0 +1,293 @@
+// UpDateRTDBTest.cpp : CUpDateRTDB遥脉写回缓存的合并、分批、应答检查和并发投递，实时库管道用假实现代替
+//
+
+#include "stdafx.h"
+#include "TestCommon.h"
+#include "UpDateRTDB.h"
+#include <string>
+
+CAsyncLog *g_log = NULL;
+
+// 管道接口的替代：按语句中的(ID,原始值,工程值)更新假的TB_PULSE，按g_vecReply依次应答，用完后一律确认成功
+enum
+{
+	REPLY_ACK_OK = 0,
+	REPLY_ACK_FAIL,
+	REPLY_NONE,
+	REPLY_OTHER_TYPE,
+};
+
+struct SinkRow
+{
+	__int64 nRaw;
+	double dValue;
+	int nWrites;
+};
+
+static std::vector<int> g_vecReply;
+static size_t g_nReplyPos = 0;
+static std::map<int, SinkRow> g_mapPulse;		//确认成功的语句写入的行
+static std::vector<int> g_vecStatementRows;		//每条语句的点数
+static BOOL g_bPipeFail = FALSE;
+static CUpDateRTDB *g_pSinkWriter = NULL;		//不为NULL时每条语句执行中途投递一个新值，模拟处理线程
+static int g_nSinkUpdateId = 0;
+
+static void ResetSink()
+{
+	g_vecReply.clear();
+	g_nReplyPos = 0;
+	g_mapPulse.clear();
+	g_vecStatementRows.clear();
+	g_bPipeFail = FALSE;
+	g_pSinkWriter = NULL;
+}
+
+HANDLE OpenRealDataPipe()
+{
+	return g_bPipeFail ? NULL : CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+BYTE* GetMessage_RecordOfSql_Ext(HANDLE /*hPipe*/, CString &strSql)
+{
+	int nReply = g_nReplyPos < g_vecReply.size() ? g_vecReply[g_nReplyPos++] : REPLY_ACK_OK;
+	std::vector<int> vecId;
+	std::vector<SinkRow> vecRow;
+	const char *p = strstr((LPCTSTR)strSql, "(VALUES ");
+	while (p != NULL && (p = strchr(p + 1, '(')) != NULL)
+	{
+		int nId = 0;
+		SinkRow iRow = {0, 0.0, 0};
+		if (sscanf(p, "(%d,%lld,%lf)", &nId, &iRow.nRaw, &iRow.dValue) != 3)
+		{
+			break;
+		}
+		vecId.push_back(nId);
+		vecRow.push_back(iRow);
+	}
+	g_vecStatementRows.push_back((int)vecId.size());
+	if (g_pSinkWriter != NULL)
+	{
+		g_pSinkWriter->UpdateYm(g_nSinkUpdateId, 999, 99.9);
+	}
+	if (nReply == REPLY_NONE)
+	{
+		return NULL;
+	}
+	if (nReply == REPLY_ACK_OK)
+	{
+		for (size_t i=0; i<vecId.size(); i++)
+		{
+			SinkRow &iRow = g_mapPulse[vecId[i]];
+			iRow.nRaw = vecRow[i].nRaw;
+			iRow.dValue = vecRow[i].dValue;
+			iRow.nWrites++;
+		}
+	}
+	BYTE *pReply = new BYTE[sizeof(NetMessageHead) + sizeof(MessageAck)];
+	NetMessageHead *pHead = (NetMessageHead*)pReply;
+	pHead->MessageType = (nReply == REPLY_OTHER_TYPE) ? NET_MESSAGE_RETRECORDOFTB : NET_MESSAGE_ACK;
+	pHead->Length = sizeof(MessageAck);
+	MessageAck *pAck = (MessageAck*)&pReply[sizeof(NetMessageHead)];
+	//记录集报文的前两个字节恰好为0，与NET_MESSAGE_ACK_OK相同
+	pAck->wdAckType = (nReply == REPLY_ACK_FAIL) ? NET_MESSAGE_ACK_OK + 1 : NET_MESSAGE_ACK_OK;
+	return pReply;
+}
+
+BYTE* GetNetMessage(HANDLE /*hPipe*/, BYTE * /*pWrite*/, DWORD /*dwLen*/)
+{
+	return NULL;
+}
+
+static BOOL SinkHas(int nId, __int64 nRaw, int nWrites)
+{
+	std::map<int, SinkRow>::iterator it = g_mapPulse.find(nId);
+	return it != g_mapPulse.end() && it->second.nRaw == nRaw && it->second.nWrites == nWrites;
+}
+
+//同一点多次更新只入库最新值，合并省掉的次数计入统计
+static void TestCoalesce()
+{
+	ResetSink();
+	CUpDateRTDB Writer;
+	for (int n=1; n<=10; n++)
+	{
+		for (int nId=1; nId<=3; nId++)
+		{
+			Writer.UpdateYm(nId, nId*100 + n, n*1.5);
+		}
+	}
+	Writer.Flush();
+	CHECK(g_vecStatementRows.size() == 1 && g_vecStatementRows[0] == 3);
+	CHECK(SinkHas(1, 110, 1) && SinkHas(2, 210, 1) && SinkHas(3, 310, 1));
+	CHECK(g_mapPulse[1].dValue == 15.0);
+	CHECK(Writer.m_nTotalUpdates == 30);
+	CHECK(Writer.m_nTotalCoalesced == 27);
+	CHECK(Writer.m_nTotalRows == 3);
+
+	//没有脏点时不发语句
+	Writer.Flush();
+	CHECK(g_vecStatementRows.size() == 1);
+}
+
+//脏点按m_nMaxBatch分成多条语句
+static void TestBatching()
+{
+	ResetSink();
+	CUpDateRTDB Writer;
+	Writer.m_nMaxBatch = 4;
+	for (int nId=1; nId<=10; nId++)
+	{
+		Writer.UpdateYm(nId, nId, nId);
+	}
+	Writer.Flush();
+	CHECK(g_vecStatementRows.size() == 3);
+	CHECK(g_vecStatementRows.size() == 3 && g_vecStatementRows[0] == 4 && g_vecStatementRows[1] == 4 && g_vecStatementRows[2] == 2);
+	CHECK((int)g_mapPulse.size() == 10);
+	CHECK(Writer.m_nTotalStatements == 3 && Writer.m_nTotalRows == 10);
+}
+
+//执行失败、非确认应答和无应答的语句中的点都重新置脏，下次入库时重发
+static void TestRetry()
+{
+	ResetSink();
+	CUpDateRTDB Writer;
+	Writer.m_nMaxBatch = 2;
+	for (int nId=1; nId<=8; nId++)
+	{
+		Writer.UpdateYm(nId, nId, nId);
+	}
+	//第1条成功，第2条执行失败，第3条回的不是确认报文，第4条无应答
+	g_vecReply.push_back(REPLY_ACK_OK);
+	g_vecReply.push_back(REPLY_ACK_FAIL);
+	g_vecReply.push_back(REPLY_OTHER_TYPE);
+	g_vecReply.push_back(REPLY_NONE);
+	Writer.Flush();
+	CHECK(g_vecStatementRows.size() == 4);
+	CHECK((int)g_mapPulse.size() == 2);
+	CHECK(Writer.m_nTotalRows == 2);
+	CHECK(Writer.m_nTotalFailed == 3);
+	CHECK((int)Writer.m_vecDirtySlot.size() == 6);
+
+	//重发的是失败的6个点，已入库的不再重发
+	Writer.Flush();
+	CHECK(g_vecStatementRows.size() == 7);
+	CHECK((int)g_mapPulse.size() == 8);
+	BOOL bOnce = TRUE;
+	for (int nId=1; nId<=8; nId++)
+	{
+		bOnce = bOnce && SinkHas(nId, nId, 1);
+	}
+	CHECK(bOnce);
+	CHECK(Writer.m_nTotalRows == 8);
+	CHECK(Writer.m_vecDirtySlot.empty());
+
+	//管道打不开时全部留待下次
+	Writer.UpdateYm(1, 11, 11);
+	g_bPipeFail = TRUE;
+	Writer.Flush();
+	CHECK(Writer.m_vecDirtySlot.size() == 1);
+	g_bPipeFail = FALSE;
+	Writer.Flush();
+	CHECK(SinkHas(1, 11, 2));
+}
+
+//入库失败期间同一点到了新值：重新置脏时不重复加入，下次只入库新值一次
+static void TestUpdateDuringFlush()
+{
+	ResetSink();
+	CUpDateRTDB Writer;
+	Writer.UpdateYm(5, 1, 1);
+	g_vecReply.push_back(REPLY_ACK_FAIL);
+	g_pSinkWriter = &Writer;
+	g_nSinkUpdateId = 5;
+	Writer.Flush();
+	g_pSinkWriter = NULL;
+	CHECK(Writer.m_vecDirtySlot.size() == 1);
+	Writer.Flush();
+	CHECK(g_vecStatementRows.size() == 2 && g_vecStatementRows[1] == 1);
+	CHECK(SinkHas(5, 999, 1));
+}
+
+#define PRODUCER_NUM		4
+#define PRODUCER_POINTS		500
+#define PRODUCER_ROUNDS		100
+
+struct ProducerParam
+{
+	CUpDateRTDB *pWriter;
+	int nProducer;
+};
+
+//每个生产者更新自己的一组点，原始值逐轮递增，最后一轮的值为PRODUCER_ROUNDS
+static UINT ProducerProc(LPVOID pParam)
+{
+	ProducerParam *pProducer = (ProducerParam*)pParam;
+	for (int r=1; r<=PRODUCER_ROUNDS; r++)
+	{
+		for (int i=0; i<PRODUCER_POINTS; i++)
+		{
+			pProducer->pWriter->UpdateYm(pProducer->nProducer*PRODUCER_POINTS + i + 1, r, r);
+		}
+	}
+	return 0;
+}
+
+static UINT WriterProc(LPVOID pParam)
+{
+	((CUpDateRTDB*)pParam)->InitInstance();
+	return 0;
+}
+
+//多个处理线程并发投递，入库线程按周期和批量入库，退出时把剩下的写完
+static void TestConcurrent()
+{
+	ResetSink();
+	CUpDateRTDB Writer;
+	Writer.m_nFlushInterval = 5;
+	CWinThread *pWriterThread = AfxBeginThread(WriterProc, &Writer, THREAD_PRIORITY_NORMAL, 0, 0);
+	pWriterThread->m_bAutoDelete = FALSE;
+	ProducerParam Params[PRODUCER_NUM];
+	CWinThread *pThreads[PRODUCER_NUM];
+	for (int i=0; i<PRODUCER_NUM; i++)
+	{
+		Params[i].pWriter = &Writer;
+		Params[i].nProducer = i;
+		pThreads[i] = AfxBeginThread(ProducerProc, &Params[i], THREAD_PRIORITY_NORMAL, 0, 0);
+		pThreads[i]->m_bAutoDelete = FALSE;
+	}
+	for (int i=0; i<PRODUCER_NUM; i++)
+	{
+		WaitForSingleObject(pThreads[i]->m_hThread, INFINITE);
+		delete pThreads[i];
+	}
+	SetEvent(Writer.m_hExitEvent);
+	WaitForSingleObject(pWriterThread->m_hThread, INFINITE);
+	delete pWriterThread;
+
+	int nPoints = PRODUCER_NUM*PRODUCER_POINTS;
+	CHECK((int)g_mapPulse.size() == nPoints);
+	BOOL bLatest = TRUE;
+	for (int nId=1; nId<=nPoints; nId++)
+	{
+		bLatest = bLatest && g_mapPulse[nId].nRaw == PRODUCER_ROUNDS;
+	}
+	CHECK(bLatest);
+	CHECK(Writer.m_nTotalUpdates == (__int64)nPoints*PRODUCER_ROUNDS);
+	CHECK(Writer.m_nTotalRows + Writer.m_nTotalCoalesced == Writer.m_nTotalUpdates);
+	CHECK(Writer.m_UpdateQueue.GetDropped() == 0);
+	CHECK(Writer.m_vecDirtySlot.empty());
+}
+
+int main()
+{
+	g_log = new CAsyncLog(_T("\\UpDateRTDBTest"));
+	g_log->m_nLevel = LOGLEVEL_ERRO + 1;
+	TestCoalesce();
+	TestBatching();
+	TestRetry();
+	TestUpdateDuringFlush();
+	TestConcurrent();
+	delete g_log;
+	g_log = NULL;
+	return TEST_RESULT();
+}
@@ -0,0 +1,450 @@
+#pragma once
+
+// 测试用的Win32类型和函数替代，只覆盖被测头文件(MpscQueue.h、FlatHashIndex.h、RecordSetReader.h、
+// RtdbUpdateFrame.h、SocketFrame.h、SampleMergeSql.h等)及经stdafx.h替代编译的实现文件用到的部分，
+// 使其能在Linux下用g++编译运行。TCHAR按多字节处理，路径中的'\\'按'/'处理。
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <string>
+#include <map>
+#include <stdlib.h>
+
+typedef int BOOL;
+#define TRUE	1
+#define FALSE	0
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+#define __int64 long long
+typedef unsigned long long ULONGLONG;
+typedef long long __time64_t;
+typedef unsigned int UINT;
+typedef void *HANDLE;
+typedef void *LPVOID;
+typedef char TCHAR;
+typedef const char *LPCTSTR;
+#define _T(x)			x
+#define _tcscmp			strcmp
+#define _tcslen			strlen
+#define _tcsncmp		strncmp
+#define _tcsnlen		strnlen
+#define _tcsncpy		strncpy
+#define _ttoi64			atoll
+#define _vsntprintf		vsnprintf
+#define _stprintf		sprintf
+#define _countof(a)		(sizeof(a)/sizeof((a)[0]))
+#define _sntprintf_s	_snprintf_s
+#define MAX_PATH		260
+#define INFINITE		0xFFFFFFFF
+#define WAIT_OBJECT_0	0
+#define WAIT_TIMEOUT	258
+#define _TRUNCATE		((size_t)-1)
+
+inline LONG InterlockedCompareExchange(volatile LONG *pDest, LONG nExchange, LONG nComparand)
+{
+	return __sync_val_compare_and_swap(pDest, nComparand, nExchange);
+}
+
+inline LONG InterlockedExchange(volatile LONG *pDest, LONG nValue)
+{
+	return __atomic_exchange_n(pDest, nValue, __ATOMIC_SEQ_CST);
+}
+
+inline LONG InterlockedIncrement(volatile LONG *pDest)
+{
+	return __sync_add_and_fetch(pDest, 1);
+}
+
+inline LONG InterlockedDecrement(volatile LONG *pDest)
+{
+	return __sync_sub_and_fetch(pDest, 1);
+}
+
+inline DWORD GetTickCount()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (DWORD)(ts.tv_sec*1000 + ts.tv_nsec/1000000);
+}
+
+inline void Sleep(DWORD dwMilliseconds)
+{
+	if (dwMilliseconds == 0)
+	{
+		sched_yield();
+		return;
+	}
+	usleep(dwMilliseconds*1000);
+}
+
+// 只支持nCount为_TRUNCATE的截断用法：放不下时截断并返回-1
+inline int _snprintf_s(char *pBuf, size_t nSize, size_t /*nCount*/, const char *pFormat, ...)
+{
+	va_list args;
+	va_start(args, pFormat);
+	int nLen = vsnprintf(pBuf, nSize, pFormat, args);
+	va_end(args);
+	return (nLen < 0 || (size_t)nLen >= nSize) ? -1 : nLen;
+}
+
+inline int strncpy_s(char *pDst, size_t nSize, const char *pSrc, size_t /*nCount*/)
+{
+	snprintf(pDst, nSize, "%s", pSrc);
+	return 0;
+}
+
+inline std::string ToPosixPath(const char *pPath)
+{
+	std::string strPath(pPath);
+	for (size_t i=0; i<strPath.size(); i++)
+	{
+		if (strPath[i] == '\\')
+		{
+			strPath[i] = '/';
+		}
+	}
+	return strPath;
+}
+
+struct SYSTEMTIME
+{
+	WORD wYear;
+	WORD wMonth;
+	WORD wDayOfWeek;
+	WORD wDay;
+	WORD wHour;
+	WORD wMinute;
+	WORD wSecond;
+	WORD wMilliseconds;
+};
+
+inline void GetLocalTime(SYSTEMTIME *pSt)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	struct tm tmNow;
+	localtime_r(&ts.tv_sec, &tmNow);
+	pSt->wYear = tmNow.tm_year + 1900;
+	pSt->wMonth = tmNow.tm_mon + 1;
+	pSt->wDayOfWeek = tmNow.tm_wday;
+	pSt->wDay = tmNow.tm_mday;
+	pSt->wHour = tmNow.tm_hour;
+	pSt->wMinute = tmNow.tm_min;
+	pSt->wSecond = tmNow.tm_sec;
+	pSt->wMilliseconds = ts.tv_nsec/1000000;
+}
+
+// 事件和信号量对象：所有对象共用一把锁和一个条件变量，够测试用。nMaxCount为0的是事件
+struct Win32Event
+{
+	BOOL bManualReset;
+	BOOL bSignaled;
+	LONG nCount;
+	LONG nMaxCount;
+};
+
+inline pthread_mutex_t &Win32EventMutex()
+{
+	static pthread_mutex_t Mutex = PTHREAD_MUTEX_INITIALIZER;
+	return Mutex;
+}
+
+inline pthread_cond_t &Win32EventCond()
+{
+	static pthread_cond_t Cond = PTHREAD_COND_INITIALIZER;
+	return Cond;
+}
+
+inline HANDLE CreateEvent(LPVOID /*pAttr*/, BOOL bManualReset, BOOL bInitialState, const char * /*pName*/)
+{
+	Win32Event *pEvent = new Win32Event;
+	pEvent->bManualReset = bManualReset;
+	pEvent->bSignaled = bInitialState;
+	pEvent->nCount = 0;
+	pEvent->nMaxCount = 0;
+	return pEvent;
+}
+
+inline HANDLE CreateSemaphore(LPVOID /*pAttr*/, LONG nInitialCount, LONG nMaximumCount, const char * /*pName*/)
+{
+	Win32Event *pEvent = new Win32Event;
+	pEvent->bManualReset = FALSE;
+	pEvent->bSignaled = FALSE;
+	pEvent->nCount = nInitialCount;
+	pEvent->nMaxCount = nMaximumCount;
+	return pEvent;
+}
+
+inline BOOL ReleaseSemaphore(HANDLE hSemaphore, LONG nReleaseCount, LONG *pPreviousCount)
+{
+	Win32Event *pEvent = (Win32Event*)hSemaphore;
+	pthread_mutex_lock(&Win32EventMutex());
+	if (pPreviousCount != NULL)
+	{
+		*pPreviousCount = pEvent->nCount;
+	}
+	BOOL bOk = nReleaseCount > 0 && pEvent->nCount <= pEvent->nMaxCount - nReleaseCount;
+	if (bOk)
+	{
+		pEvent->nCount += nReleaseCount;
+		pthread_cond_broadcast(&Win32EventCond());
+	}
+	pthread_mutex_unlock(&Win32EventMutex());
+	return bOk;
+}
+
+inline BOOL SetEvent(HANDLE hEvent)
+{
+	pthread_mutex_lock(&Win32EventMutex());
+	((Win32Event*)hEvent)->bSignaled = TRUE;
+	pthread_cond_broadcast(&Win32EventCond());
+	pthread_mutex_unlock(&Win32EventMutex());
+	return TRUE;
+}
+
+inline BOOL ResetEvent(HANDLE hEvent)
+{
+	pthread_mutex_lock(&Win32EventMutex());
+	((Win32Event*)hEvent)->bSignaled = FALSE;
+	pthread_mutex_unlock(&Win32EventMutex());
+	return TRUE;
+}
+
+inline BOOL CloseHandle(HANDLE hEvent)
+{
+	delete (Win32Event*)hEvent;
+	return TRUE;
+}
+
+//只支持bWaitAll为FALSE
+inline DWORD WaitForMultipleObjects(DWORD nCount, const HANDLE *pHandles, BOOL /*bWaitAll*/, DWORD dwMilliseconds)
+{
+	struct timespec tsEnd;
+	clock_gettime(CLOCK_REALTIME, &tsEnd);
+	if (dwMilliseconds != INFINITE)
+	{
+		tsEnd.tv_sec += dwMilliseconds/1000;
+		tsEnd.tv_nsec += (dwMilliseconds%1000)*1000000L;
+		if (tsEnd.tv_nsec >= 1000000000L)
+		{
+			tsEnd.tv_sec++;
+			tsEnd.tv_nsec -= 1000000000L;
+		}
+	}
+	DWORD dwResult = WAIT_TIMEOUT;
+	pthread_mutex_lock(&Win32EventMutex());
+	while (1)
+	{
+		for (DWORD i=0; i<nCount && dwResult==WAIT_TIMEOUT; i++)
+		{
+			Win32Event *pEvent = (Win32Event*)pHandles[i];
+			if (pEvent->nMaxCount > 0)
+			{
+				if (pEvent->nCount > 0)
+				{
+					pEvent->nCount--;
+					dwResult = WAIT_OBJECT_0 + i;
+				}
+			}
+			else if (pEvent->bSignaled)
+			{
+				if (!pEvent->bManualReset)
+				{
+					pEvent->bSignaled = FALSE;
+				}
+				dwResult = WAIT_OBJECT_0 + i;
+			}
+		}
+		if (dwResult != WAIT_TIMEOUT)
+		{
+			break;
+		}
+		if (dwMilliseconds == INFINITE)
+		{
+			pthread_cond_wait(&Win32EventCond(), &Win32EventMutex());
+		}
+		else if (pthread_cond_timedwait(&Win32EventCond(), &Win32EventMutex(), &tsEnd) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+	pthread_mutex_unlock(&Win32EventMutex());
+	return dwResult;
+}
+
+inline DWORD WaitForSingleObject(HANDLE hEvent, DWORD dwMilliseconds)
+{
+	return WaitForMultipleObjects(1, &hEvent, FALSE, dwMilliseconds);
+}
+
+//可执行文件路径取当前目录下的test.exe，日志等相对路径都落在当前目录
+inline DWORD GetModuleFileName(HANDLE /*hModule*/, char *pFileName, DWORD nSize)
+{
+	char szDir[MAX_PATH - 16];
+	if (getcwd(szDir, sizeof(szDir)) == NULL)
+	{
+		return 0;
+	}
+	return snprintf(pFileName, nSize, "%s\\test.exe", szDir);
+}
+
+inline BOOL CreateDirectory(const char *pPath, LPVOID /*pAttr*/)
+{
+	return mkdir(ToPosixPath(pPath).c_str(), 0755) == 0;
+}
+
+//配置文件不落盘，放在进程内按文件、段、键区分的表中；没有写过的键取缺省值。不加锁，只在测试的主线程中读写
+inline std::map<std::string, std::string> &ProfileStore()
+{
+	static std::map<std::string, std::string> mapProfile;
+	return mapProfile;
+}
+
+inline std::string ProfileKey(const char *pSection, const char *pKey, const char *pFile)
+{
+	return std::string(pFile) + "\n[" + pSection + "]\n" + pKey;
+}
+
+inline BOOL WritePrivateProfileString(const char *pSection, const char *pKey, const char *pValue, const char *pFile)
+{
+	ProfileStore()[ProfileKey(pSection, pKey, pFile)] = pValue != NULL ? pValue : "";
+	return TRUE;
+}
+
+inline DWORD GetPrivateProfileString(const char *pSection, const char *pKey, const char *pDefault, char *pReturned, DWORD nSize, const char *pFile)
+{
+	std::map<std::string, std::string>::const_iterator it = ProfileStore().find(ProfileKey(pSection, pKey, pFile));
+	const char *pValue = it != ProfileStore().end() ? it->second.c_str() : (pDefault != NULL ? pDefault : "");
+	if (nSize == 0)
+	{
+		return 0;
+	}
+	snprintf(pReturned, nSize, "%s", pValue);
+	return (DWORD)strlen(pReturned);
+}
+
+inline UINT GetPrivateProfileInt(const char *pSection, const char *pKey, int nDefault, const char *pFile)
+{
+	std::map<std::string, std::string>::const_iterator it = ProfileStore().find(ProfileKey(pSection, pKey, pFile));
+	return it != ProfileStore().end() ? (UINT)atoi(it->second.c_str()) : (UINT)nDefault;
+}
+
+// 临界区用pthread互斥量实现，基准程序用它还原改造前的加锁队列
+typedef pthread_mutex_t CRITICAL_SECTION;
+inline void InitializeCriticalSection(CRITICAL_SECTION *pCs) { pthread_mutex_init(pCs, NULL); }
+inline void DeleteCriticalSection(CRITICAL_SECTION *pCs) { pthread_mutex_destroy(pCs); }
+inline void EnterCriticalSection(CRITICAL_SECTION *pCs) { pthread_mutex_lock(pCs); }
+inline void LeaveCriticalSection(CRITICAL_SECTION *pCs) { pthread_mutex_unlock(pCs); }
+
+// 只实现被测头文件用到的几个成员
+class CString
+{
+public:
+	CString() {}
+	CString(const TCHAR *pStr) : m_str(pStr != NULL ? pStr : "") {}
+	void SetString(const TCHAR *pStr, int nLen) { m_str.assign(pStr, nLen); }
+	void Empty() { m_str.clear(); }
+	BOOL IsEmpty() const { return m_str.empty(); }
+	int GetLength() const { return (int)m_str.size(); }
+	bool operator<(const CString &Other) const { return m_str < Other.m_str; }
+	//没有这两个运算符时CString之间比较会经LPCTSTR转换成指针比较
+	bool operator==(const CString &Other) const { return m_str == Other.m_str; }
+	bool operator!=(const CString &Other) const { return m_str != Other.m_str; }
+	operator LPCTSTR() const { return m_str.c_str(); }
+	void Append(const TCHAR *pStr, int nLen) { m_str.append(pStr, nLen); }
+	void Append(const TCHAR *pStr) { m_str.append(pStr); }
+	void AppendChar(TCHAR ch) { m_str.push_back(ch); }
+	void Truncate(int nLen) { m_str.resize(nLen); }
+	void Preallocate(int nLen) { m_str.reserve(nLen); }
+	TCHAR *GetBuffer(int nMinLen) { m_str.resize(nMinLen + 1); return &m_str[0]; }
+	void ReleaseBuffer() { m_str.resize(strlen(m_str.c_str())); }
+	int Replace(const TCHAR *pOld, const TCHAR *pNew)
+	{
+		size_t nOldLen = strlen(pOld), nNewLen = strlen(pNew);
+		int nCount = 0;
+		for (size_t nPos = m_str.find(pOld); nOldLen > 0 && nPos != std::string::npos; nPos = m_str.find(pOld, nPos + nNewLen))
+		{
+			m_str.replace(nPos, nOldLen, pNew);
+			nCount++;
+		}
+		return nCount;
+	}
+	CString Left(int nCount) const { return CString(m_str.substr(0, nCount < 0 ? 0 : nCount).c_str()); }
+	CString Mid(int nFirst) const { return Mid(nFirst, GetLength()); }
+	CString Mid(int nFirst, int nCount) const
+	{
+		if (nFirst < 0 || nFirst >= GetLength() || nCount <= 0)
+		{
+			return CString();
+		}
+		return CString(m_str.substr(nFirst, nCount).c_str());
+	}
+	TCHAR operator[](int nIndex) const { return m_str[nIndex]; }
+	int ReverseFind(TCHAR ch) const { size_t nPos = m_str.rfind(ch); return nPos == std::string::npos ? -1 : (int)nPos; }
+	CString &operator+=(const TCHAR *pStr) { m_str.append(pStr); return *this; }
+	friend CString operator+(const CString &str1, const TCHAR *pStr2) { CString str(str1); str += pStr2; return str; }
+	friend CString operator+(const CString &str1, const CString &str2) { return str1 + (LPCTSTR)str2; }
+	//MSVC的%I64d在glibc中会被当成宽度64，先换成%lld
+	static std::string PosixFormat(const TCHAR *pFormat)
+	{
+		std::string strFormat = pFormat;
+		for (size_t nPos = strFormat.find('%'); nPos != std::string::npos; nPos = strFormat.find('%', nPos + 1))
+		{
+			size_t nSpec = strFormat.find_first_not_of("-+ #0123456789.", nPos + 1);
+			if (nSpec != std::string::npos && strFormat.compare(nSpec, 3, "I64") == 0)
+			{
+				strFormat.replace(nSpec, 3, "ll");
+			}
+			else if (nSpec != std::string::npos && strFormat[nSpec] == '%')
+			{
+				nPos = nSpec;
+			}
+		}
+		return strFormat;
+	}
+	void AppendFormatV(const TCHAR *pFormat, va_list args)
+	{
+		std::string strFormat = PosixFormat(pFormat);
+		pFormat = strFormat.c_str();
+		va_list argsCopy;
+		va_copy(argsCopy, args);
+		int nLen = vsnprintf(NULL, 0, pFormat, argsCopy);
+		va_end(argsCopy);
+		if (nLen > 0)
+		{
+			size_t nOld = m_str.size();
+			m_str.resize(nOld + nLen + 1);
+			vsnprintf(&m_str[nOld], nLen + 1, pFormat, args);
+			m_str.resize(nOld + nLen);
+		}
+	}
+	void Format(const TCHAR *pFormat, ...)
+	{
+		m_str.clear();
+		va_list args;
+		va_start(args, pFormat);
+		AppendFormatV(pFormat, args);
+		va_end(args);
+	}
+	void AppendFormat(const TCHAR *pFormat, ...)
+	{
+		va_list args;
+		va_start(args, pFormat);
+		AppendFormatV(pFormat, args);
+		va_end(args);
+	}
+private:
+	std::string m_str;
+};
@@ -0,0 +1,126 @@
+// YmLookupIndexBench.cpp : 合成20万遥脉点配置，对比原"格式化CString键+std::map+临界区"查找与整型键索引快照
+//
+// 配置为2万台设备各10个遥脉，采样序号表同样20万项。统计建立索引、带旧快照重建的耗时，
+// 以及处理线程按设备号+遥脉序号查找一个点(先查设备ID再查遥脉)的平均耗时。
+
+#include "stdafx.h"
+#include "YmLookupIndex.h"
+#include <vector>
+
+#define BENCH_RTU			1
+#define BENCH_DEV_NUM		20000
+#define BENCH_YM_PER_DEV	10
+#define BENCH_ROUNDS		5
+
+static double NowSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+int main()
+{
+	DeviceRecordDefMap DevMap;
+	YmConfigDefMap YmMap;
+	SampleDayNo SampleMap;
+	CString strKey;
+	int nYmIndex = 0;
+	for (int nDev=0; nDev<BENCH_DEV_NUM; nDev++)
+	{
+		int nDevId = 100000 + nDev;
+		strKey.Format(_T("%d+%d"), BENCH_RTU, nDev);
+		DevMap[strKey] = nDevId;
+		for (int nYm=1; nYm<=BENCH_YM_PER_DEV; nYm++)
+		{
+			SimpleYmDef ymDef;
+			memset(&ymDef, 0, sizeof(ymDef));
+			ymDef.nYmIndex = ++nYmIndex;
+			ymDef.nDeviceNo = nDevId;
+			ymDef.nYmNum = nYm;
+			ymDef.dYmQuotiety = 1.0f;
+			strKey.Format(_T("%d+%d"), nDevId, nYm);
+			YmMap[strKey] = ymDef;
+			strKey.Format(_T("%d+%d+%d"), 1, nDev/1000, nYmIndex);
+			SampleMap[strKey] = nYmIndex;
+		}
+	}
+	int nPoints = (int)YmMap.size();
+
+	//按报文顺序逐设备逐点查找
+	std::vector<int> vecDevNo, vecYmNum;
+	for (int nDev=0; nDev<BENCH_DEV_NUM; nDev++)
+	{
+		for (int nYm=1; nYm<=BENCH_YM_PER_DEV; nYm++)
+		{
+			vecDevNo.push_back(nDev);
+			vecYmNum.push_back(nYm);
+		}
+	}
+
+	//原做法：每个点格式化两个键，在临界区内查两棵红黑树
+	CRITICAL_SECTION csYmConfigDefMap;
+	InitializeCriticalSection(&csYmConfigDefMap);
+	long long nFound = 0;
+	double dBegin = NowSeconds();
+	for (int r=0; r<BENCH_ROUNDS; r++)
+	{
+		for (int i=0; i<nPoints; i++)
+		{
+			EnterCriticalSection(&csYmConfigDefMap);
+			strKey.Format(_T("%d+%d"), BENCH_RTU, vecDevNo[i]);
+			DeviceRecordDefMap::iterator itd = DevMap.find(strKey);
+			if (itd != DevMap.end())
+			{
+				strKey.Format(_T("%d+%d"), itd->second, vecYmNum[i]);
+				YmConfigDefMap::iterator itym = YmMap.find(strKey);
+				if (itym != YmMap.end())
+				{
+					SimpleYmDef ymDef = itym->second;
+					nFound += ymDef.nYmNum != 0;
+				}
+			}
+			LeaveCriticalSection(&csYmConfigDefMap);
+		}
+	}
+	double dMapLookup = (NowSeconds() - dBegin)/((double)nPoints*BENCH_ROUNDS);
+	DeleteCriticalSection(&csYmConfigDefMap);
+
+	dBegin = NowSeconds();
+	CDevLookupIndex *pDevIndex = new CDevLookupIndex;
+	pDevIndex->Build(DevMap);
+	CYmLookupIndex *pIndex = new CYmLookupIndex;
+	pIndex->Build(YmMap, SampleMap, NULL);
+	double dBuild = NowSeconds() - dBegin;
+
+	dBegin = NowSeconds();
+	CYmLookupIndex *pNewIndex = new CYmLookupIndex;
+	pNewIndex->Build(YmMap, SampleMap, pIndex);
+	double dRebuild = NowSeconds() - dBegin;
+	delete pIndex;
+	pIndex = pNewIndex;
+
+	dBegin = NowSeconds();
+	for (int r=0; r<BENCH_ROUNDS; r++)
+	{
+		for (int i=0; i<nPoints; i++)
+		{
+			int nDevId = 0;
+			SimpleYmDef ymDef;
+			if (pDevIndex->GetDevId(BENCH_RTU, vecDevNo[i], nDevId) && pIndex->GetYmDef(nDevId, vecYmNum[i], ymDef))
+			{
+				nFound += ymDef.nYmNum != 0;
+			}
+		}
+	}
+	double dIndexLookup = (NowSeconds() - dBegin)/((double)nPoints*BENCH_ROUNDS);
+
+	printf("points=%d found=%lld\n", nPoints, nFound);
+	printf("index build      %8.1f ms\n", dBuild*1e3);
+	printf("index rebuild    %8.1f ms (carrying runtime values)\n", dRebuild*1e3);
+	printf("map lookup       %8.1f ns/point\n", dMapLookup*1e9);
+	printf("index lookup     %8.1f ns/point\n", dIndexLookup*1e9);
+	delete pIndex;
+	delete pDevIndex;
+	return nFound == (long long)nPoints*BENCH_ROUNDS*2 ? 0 : 1;
+}
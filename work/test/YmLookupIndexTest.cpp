@@ -0,0 +1,115 @@
+// YmLookupIndexTest.cpp : CYmLookupIndex/CDevLookupIndex的建立、查找和重建时运行值的沿用
+//
+
+#include "stdafx.h"
+#include "TestCommon.h"
+#include "YmLookupIndex.h"
+
+static SimpleYmDef MakeYmDef(int nYmIndex, int nDevId, int nYmNum, float dQuotiety)
+{
+	SimpleYmDef ymDef;
+	memset(&ymDef, 0, sizeof(ymDef));
+	ymDef.nYmIndex = nYmIndex;
+	ymDef.nDeviceNo = nDevId;
+	ymDef.nYmNum = nYmNum;
+	ymDef.dYmQuotiety = dQuotiety;
+	return ymDef;
+}
+
+static void AddYm(YmConfigDefMap &YmMap, const SimpleYmDef &ymDef)
+{
+	CString strKey;
+	strKey.Format(_T("%d+%d"), ymDef.nDeviceNo, ymDef.nYmNum);
+	YmMap[strKey] = ymDef;
+}
+
+static void TestDevIndex()
+{
+	DeviceRecordDefMap DevMap;
+	CString strKey;
+	strKey.Format(_T("%d+%d"), 3, 10);
+	DevMap[strKey] = 1001;
+	strKey.Format(_T("%d+%d"), 3, 11);
+	DevMap[strKey] = 1002;
+	strKey.Format(_T("bad"));
+	DevMap[strKey] = 9999;
+
+	CDevLookupIndex DevIndex;
+	DevIndex.Build(DevMap);
+	CHECK(DevIndex.GetCount() == 2);
+	int nDevId = 0;
+	CHECK(DevIndex.GetDevId(3, 10, nDevId) && nDevId == 1001);
+	CHECK(!DevIndex.GetDevId(4, 10, nDevId));
+
+	//相邻相同设备号沿用上一次结果，找不到的置0
+	int DevNo[5] = { 10, 10, 12, 11, 10 };
+	int DevId[5];
+	CHECK(DevIndex.GetDevIds(3, DevNo, 5, DevId) == 4);
+	CHECK(DevId[0] == 1001 && DevId[1] == 1001 && DevId[2] == 0 && DevId[3] == 1002 && DevId[4] == 1001);
+}
+
+static void TestYmIndex()
+{
+	YmConfigDefMap YmMap;
+	AddYm(YmMap, MakeYmDef(1, 1001, 1, 1.0f));
+	AddYm(YmMap, MakeYmDef(2, 1001, 2, 2.0f));
+	SampleDayNo SampleMap;
+	CString strKey;
+	strKey.Format(_T("%d+%d+%d"), 5, 2, 300);
+	SampleMap[strKey] = 17;
+
+	CYmLookupIndex Index;
+	Index.Build(YmMap, SampleMap, NULL);
+	CHECK(Index.GetYmCount() == 2);
+	SimpleYmDef ymDef;
+	CHECK(Index.GetYmDef(1001, 2, ymDef) && ymDef.nYmIndex == 2 && ymDef.dYmQuotiety == 2.0f);
+	CHECK(!Index.GetYmDef(1001, 3, ymDef));
+	int nSampleNo = 0;
+	CHECK(Index.GetSampleNo(5, 2, 300, nSampleNo) && nSampleNo == 17);
+	CHECK(!Index.GetSampleNo(5, 2, 301, nSampleNo));
+
+	ymDef.nYmRaw = 12345;
+	ymDef.dYmValue = 24690;
+	CHECK(Index.UpdateYmDef(ymDef));
+	SimpleYmDef ymRead;
+	CHECK(Index.GetYmDef(1001, 2, ymRead) && ymRead.nYmRaw == 12345 && ymRead.dYmValue == 24690);
+	CHECK(!Index.UpdateYmDef(MakeYmDef(9, 1001, 9, 1.0f)));
+}
+
+//重建时只沿用原始值、遥脉值和数据时间，系数、遥脉序号等配置取新加载的
+static void TestRebuildKeepsRuntime()
+{
+	YmConfigDefMap YmMap;
+	AddYm(YmMap, MakeYmDef(1, 1001, 1, 1.0f));
+	SampleDayNo SampleMap;
+	CYmLookupIndex OldIndex;
+	OldIndex.Build(YmMap, SampleMap, NULL);
+	SimpleYmDef ymDef = MakeYmDef(1, 1001, 1, 1.0f);
+	ymDef.nYmRaw = 500;
+	ymDef.dYmValue = 50.5;
+	ymDef.DataTime.year = 2024;
+	ymDef.DataTime.hour = 13;
+	CHECK(OldIndex.UpdateYmDef(ymDef));
+
+	YmMap.clear();
+	AddYm(YmMap, MakeYmDef(7, 1001, 1, 10.0f));
+	AddYm(YmMap, MakeYmDef(8, 1002, 1, 3.0f));
+	CYmLookupIndex NewIndex;
+	NewIndex.Build(YmMap, SampleMap, &OldIndex);
+	SimpleYmDef ymRead;
+	CHECK(NewIndex.GetYmDef(1001, 1, ymRead));
+	CHECK(ymRead.nYmIndex == 7 && ymRead.dYmQuotiety == 10.0f);
+	CHECK(ymRead.nYmRaw == 500 && ymRead.dYmValue == 50.5);
+	CHECK(ymRead.DataTime.year == 2024 && ymRead.DataTime.hour == 13);
+	//旧快照中没有的点保持新配置，运行值为0
+	CHECK(NewIndex.GetYmDef(1002, 1, ymRead));
+	CHECK(ymRead.nYmIndex == 8 && ymRead.dYmQuotiety == 3.0f && ymRead.nYmRaw == 0);
+}
+
+int main()
+{
+	TestDevIndex();
+	TestYmIndex();
+	TestRebuildKeepsRuntime();
+	return TEST_RESULT();
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+// 告警服务应用类头文件的测试替代，实现文件包含它只为取得CTSAlarmServer_WDApp，测试中不需要
@@ -0,0 +1,50 @@
+#pragma once
+
+// 告警服务stdafx.h的测试替代。实现文件(如AlarmBatchWriter.cpp、AlarmArchiver.cpp)由Makefile从标准输入编译，
+// 其中的#include "stdafx.h"在送入编译器前改为本文件；测试文件直接#include "alarm/stdafx.h"。
+// 这里只声明这些实现文件用到的类型和函数，实时库管道函数由测试文件实现。
+
+#include "Win32Compat.h"
+#include "MfcCompat.h"
+#include "NetMessageStub.h"
+#include "PublicStructStub.h"
+#include <map>
+#include <vector>
+
+using std::map;
+using std::vector;
+
+//与告警服务stdafx.h中的定义相同
+struct SMSConfigDef
+{
+	int iPlazaId;
+	int type;
+	int TemplateNum;
+	BYTE IsShield;
+	TCHAR PersonName[65];
+	TCHAR PhoneNum[65];
+};
+
+//实时库管道，由测试文件实现
+HANDLE OpenRealDataPipe();
+BYTE* GetMessage_RecordOfSql(HANDLE hPipe, CString &strSql);
+BYTE* GetMessage_RecordOfSql_Ext(HANDLE hPipe, CString &strSql);
+BYTE* GetNetMessage(HANDLE hPipe, BYTE *pWrite, DWORD dwLen);
+
+#include "RecordSetReader.h"
+#include "RtdbUpdateFrame.h"
+
+class CLog
+{
+public:
+	CLog(LPCTSTR /*pName*/) {}
+	void Log(LPCTSTR /*pText*/) {}
+};
+
+//告警服务的ReguTrace用CString::Format格式化，参数中直接传CString；测试中只求值参数，不格式化
+template<typename... Args> inline void ReguTraceArgs(const Args&...) {}
+
+#define  ReguTrace(type,fmt,...)     do{\
+	ReguTraceArgs(__VA_ARGS__);\
+	g_log->Log(_T("[" #type "]" fmt));\
+	}while(0)
@@ -0,0 +1,135 @@
+/*********************************************************************
+ * 测试用的pub.hpp替代：只提供comm.cpp/comm.hpp用到的类型、宏和Vos_*接口，
+ * 真实的pub.hpp不在本仓库。Vos_Malloc和Vos_CreateTask可按计数注入失败，
+ * R_Printf只计数，设置g_bCommTestVerbose后才输出。
+ **********************************************************************/
+#ifndef _PUB_H_
+#define _PUB_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+typedef unsigned char   BYTE;
+typedef unsigned short  WORD16;
+typedef unsigned int    WORD32;
+typedef int             SWORD32;
+typedef int             INT;
+typedef char            CHAR;
+typedef uintptr_t       WORDPTR;
+
+#define LEOF                ((WORD32)0xFFFFFFFF)
+#define MEM_COMM_TYPE       ((WORD32)1)
+#define COMM_SERV_PRI       ((WORD32)0)
+#define COMM_SERV_STACK     ((WORD32)(256*1024))
+#define SCHE_INVALID_CPUID  ((WORD32)0xFFFFFFFF)
+
+typedef void *(*TaskEntryProto)(void *);
+
+/* 通讯消息头，length为含消息头的整条消息长度，网络字节序 */
+class msg_header
+{
+public:
+    WORD16      type;
+    WORD16      length;
+    WORD32      seq;
+};
+
+static volatile int g_bCommTestVerbose = 0;
+static volatile int g_nPrintfCount     = 0;
+static volatile int g_nMallocFailAfter = -1;   /* >=0时再成功这么多次后失败一次 */
+static volatile int g_nTaskFailAfter   = -1;   /* >=0时再创建这么多个任务后失败一次 */
+
+static inline void R_Printf(const char *fmt, ...)
+{
+    __sync_fetch_and_add(&g_nPrintfCount, 1);
+    if (g_bCommTestVerbose)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        vfprintf(stderr, fmt, ap);
+        va_end(ap);
+    }
+}
+
+static inline int FailNext(volatile int *pnAfter)
+{
+    int nAfter;
+    while (1)
+    {
+        nAfter = *pnAfter;
+        if (nAfter < 0)
+        {
+            return 0;
+        }
+        if (__sync_bool_compare_and_swap(pnAfter, nAfter, nAfter - 1))
+        {
+            return (0 == nAfter);
+        }
+    }
+}
+
+static inline void *Vos_Malloc(WORD32 dwType, WORD32 dwSize)
+{
+    (void)dwType;
+    if (FailNext(&g_nMallocFailAfter))
+    {
+        return NULL;
+    }
+    return malloc(dwSize);
+}
+
+static inline void Vos_Free(void *p)
+{
+    free(p);
+}
+
+static inline void Vos_Init_Mutex(pthread_mutex_t *ptMutex)
+{
+    pthread_mutex_init(ptMutex, NULL);
+}
+
+static inline void Vos_Pthread_Mutex_Lock(pthread_mutex_t *ptMutex)
+{
+    pthread_mutex_lock(ptMutex);
+}
+
+static inline void Vos_Pthread_Mutex_Unlock(pthread_mutex_t *ptMutex)
+{
+    pthread_mutex_unlock(ptMutex);
+}
+
+/* 创建分离的任务线程，失败返回LEOF */
+static inline WORD32 Vos_CreateTask(const CHAR *pcName, WORD32 dwPri, WORD32 dwStack, WORD32 dwFlag,
+                                    TaskEntryProto pEntry, WORDPTR dwArg, WORD32 dwCpu)
+{
+    pthread_t       tid;
+    pthread_attr_t  attr;
+    int             ret;
+
+    (void)pcName; (void)dwPri; (void)dwFlag; (void)dwCpu;
+    if (FailNext(&g_nTaskFailAfter))
+    {
+        errno = EAGAIN;
+        return LEOF;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, dwStack);
+    ret = pthread_create(&tid, &attr, pEntry, (void *)dwArg);
+    pthread_attr_destroy(&attr);
+    return (0 == ret) ? 0 : LEOF;
+}
+
+#endif
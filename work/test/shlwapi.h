@@ -0,0 +1,10 @@
+#pragma once
+
+// 测试用的shlwapi.h替代
+
+#include "Win32Compat.h"
+
+inline BOOL PathFileExists(LPCTSTR pPath)
+{
+	return access(ToPosixPath(pPath).c_str(), F_OK) == 0;
+}
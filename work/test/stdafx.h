@@ -0,0 +1,77 @@
+#pragma once
+
+// 采样服务stdafx.h的测试替代。不带头文件的.cpp(如YmLookupIndex.cpp)由Makefile从标准输入编译，
+// 其中的#include "stdafx.h"在当前目录找到本文件；这里只声明这些实现文件用到的类型和函数。
+
+#include "Win32Compat.h"
+#include "MfcCompat.h"
+#include <map>
+#include <vector>
+#include <algorithm>
+#include "NetMessageStub.h"
+#include "PublicStructStub.h"
+#include "MpscQueue.h"
+#include "AsyncLog.h"
+
+typedef void *PVOID;
+#define _stscanf_s		sscanf
+#define YieldProcessor()	sched_yield()
+#define MemoryBarrier()		__sync_synchronize()
+using std::min;			//windef.h的min宏
+
+#define QUEUE_PUSH_TIMEOUT		1000	//与采样服务stdafx.h中的定义相同
+
+inline PVOID InterlockedExchangePointer(PVOID volatile *pDest, PVOID pValue)
+{
+	return __atomic_exchange_n(pDest, pValue, __ATOMIC_SEQ_CST);
+}
+
+#pragma pack(1)
+struct TIMESTAMP_STRUCT
+{
+	short year;
+	unsigned short month;
+	unsigned short day;
+	unsigned short hour;
+	unsigned short minute;
+	unsigned short second;
+	DWORD fraction;
+};
+
+struct	SimpleYmDef
+{
+	int			nYmIndex;
+	int			nDeviceNo;
+	int			nYmNum;
+	__int64		nYmRaw;
+	float		dYmQuotiety;
+	double		dYmValue;
+	TIMESTAMP_STRUCT DataTime;
+};
+#pragma pack()
+
+typedef std::map<CString, SimpleYmDef>	YmConfigDefMap;		//其中键类型CString由"设备ID+遥脉序号"组合生成
+typedef std::map<CString, int>	DeviceRecordDefMap;		//其中键类型CString由"厂站ID+前置设备号"组合生成
+typedef std::map<CString, int> SampleDayNo;
+
+//与采样服务stdafx.h中的定义相同
+#define  ReguTrace(type,fmt,...)     do{\
+	if (g_log->IsEnabled(LOGLEVEL_##type))\
+	{\
+		TCHAR szLog[LOG_RECORD_LEN];\
+		int nPos = _sntprintf_s(szLog,LOG_RECORD_LEN,_TRUNCATE,_T("[%s][%20s:%-4d]"),_T(#type),_T(__FUNCTION__),__LINE__);\
+		if (nPos>0)\
+		{\
+			_sntprintf_s(szLog+nPos,LOG_RECORD_LEN-nPos,_TRUNCATE,_T(fmt),__VA_ARGS__);\
+		}\
+		g_log->Log(szLog);\
+	}\
+	}while(0)
+
+//实时库管道，由用到它的测试提供假的实现
+HANDLE OpenRealDataPipe();
+BYTE* GetMessage_RecordOfSql_Ext(HANDLE hPipe, CString &strSql);
+BYTE* GetNetMessage(HANDLE hPipe, BYTE *pSend, DWORD dwLen);
+
+#include "SqlText.h"
+#include "RtdbUpdateFrame.h"